@@ -0,0 +1,60 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef API06_CHANGESET_UPLOAD_LOCK_PLAN_HPP
+#define API06_CHANGESET_UPLOAD_LOCK_PLAN_HPP
+
+#include "cgimap/types.hpp"
+
+#include <vector>
+
+namespace api06 {
+
+/*
+ * Collects the ids of all existing elements an osmChange message touches,
+ * so that their rows can be locked up front in a single pass per table.
+ *
+ * Locks are always requested in the same order (nodes, ways, relations,
+ * each by ascending id), regardless of the layout of the osmChange message.
+ * Concurrent uploads therefore cannot deadlock on each other's row locks.
+ */
+class Lock_Plan {
+
+public:
+  struct table_locks_t {
+    // modified or deleted elements
+    std::vector<osm_nwr_id_t> exclusive_ids;
+    // elements which are only referenced as way node or relation member
+    std::vector<osm_nwr_id_t> shared_ids;
+
+    [[nodiscard]] bool empty() const {
+      return exclusive_ids.empty() && shared_ids.empty();
+    }
+  };
+
+  void add_exclusive(object_type type, osm_nwr_signed_id_t id);
+
+  void add_shared(object_type type, osm_nwr_signed_id_t id);
+
+  // Sorted and duplicate free id lists for one table. Ids which need an
+  // exclusive lock are not repeated in the list of shared locks.
+  [[nodiscard]] table_locks_t locks(object_type type) const;
+
+private:
+  table_locks_t& table(object_type type);
+  const table_locks_t& table(object_type type) const;
+
+  table_locks_t m_nodes;
+  table_locks_t m_ways;
+  table_locks_t m_relations;
+};
+
+} // namespace api06
+
+#endif /* API06_CHANGESET_UPLOAD_LOCK_PLAN_HPP */
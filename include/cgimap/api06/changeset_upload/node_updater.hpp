@@ -15,6 +15,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 
@@ -42,6 +43,11 @@ public:
   virtual void delete_node(osm_changeset_id_t changeset_id, osm_nwr_id_t id,
                            osm_version_t version, bool if_unused) = 0;
 
+  // Lock all existing nodes touched by an upload in one pass, in ascending
+  // id order, before any change is applied
+  virtual void lock_nodes(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                          const std::vector<osm_nwr_id_t> &shared_ids) = 0;
+
   virtual void process_new_nodes() = 0;
 
   virtual void process_modify_nodes() = 0;
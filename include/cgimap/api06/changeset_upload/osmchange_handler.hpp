@@ -10,6 +10,7 @@
 #ifndef OSMCHANGE_HANDLER_HPP
 #define OSMCHANGE_HANDLER_HPP
 
+#include "cgimap/api06/changeset_upload/lock_plan.hpp"
 #include "cgimap/api06/changeset_upload/node_updater.hpp"
 #include "cgimap/api06/changeset_upload/relation_updater.hpp"
 #include "cgimap/api06/changeset_upload/way_updater.hpp"
@@ -23,6 +24,9 @@
 #include "relation.hpp"
 #include "way.hpp"
 
+#include <variant>
+#include <vector>
+
 namespace api06 {
 
 class OSMChange_Handler : public Parser_Callback {
@@ -48,6 +52,10 @@ public:
 
   void process_relation(const Relation &relation, operation op, bool if_unused) override;
 
+  // Lock and apply all changes collected while parsing. All validations not
+  // requiring database access have already happened at this point.
+  void process_changes();
+
   unsigned int get_num_changes() const;
 
   bbox_t get_bbox() const;
@@ -65,12 +73,31 @@ private:
     st_finished
   };
 
+  // Parsed objects are kept until the end of the document, so that all
+  // affected rows can be locked in a deterministic order before the first
+  // change is sent to the database
+  struct change_t {
+    operation op;
+    bool if_unused;
+    std::variant<Node, Way, Relation> element;
+  };
+
+  void apply_node(const Node &node, operation op, bool if_unused);
+
+  void apply_way(const Way &way, operation op, bool if_unused);
+
+  void apply_relation(const Relation &relation, operation op, bool if_unused);
+
   void handle_new_state(state new_state);
 
-  void finish_processing();
+  // checks on the complete upload, before any database access
+  void validate_changes() const;
 
   state current_state{ state::st_initial };
 
+  std::vector<change_t> changes;
+  Lock_Plan lock_plan;
+
   Node_Updater& node_updater;
   Way_Updater& way_updater;
   Relation_Updater& relation_updater;
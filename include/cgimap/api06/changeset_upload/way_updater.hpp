@@ -47,6 +47,11 @@ public:
                           osm_version_t version,
                           bool if_unused) = 0;
 
+  // Lock all existing ways touched by an upload in one pass, in ascending
+  // id order, before any change is applied
+  virtual void lock_ways(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                         const std::vector<osm_nwr_id_t> &shared_ids) = 0;
+
   virtual void process_new_ways() = 0;
 
   virtual void process_modify_ways() = 0;
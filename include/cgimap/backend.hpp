@@ -30,6 +30,9 @@ struct backend {
   // variables_map.
   virtual const boost::program_options::options_description &
   options() const = 0;
+  // called once before forking the daemon instances, e.g. to load data
+  // which is then shared by all of them.
+  virtual void prepare(const boost::program_options::variables_map &) {}
   // create a data selection factory from the arguments passed to cgimap.
   virtual std::unique_ptr<data_selection::factory>
   create(const boost::program_options::variables_map &) = 0;
@@ -44,6 +47,8 @@ void setup_backend_options(int argc, char *argv[],
                            boost::program_options::options_description &);
 // prints the options for all backends.
 void output_backend_options(std::ostream &);
+// prepares the selected backend, before forking any daemon instances.
+void prepare_backend(const boost::program_options::variables_map &);
 // singleton call to create a backend from a given set of options.
 std::unique_ptr<data_selection::factory>
 create_backend(const boost::program_options::variables_map &);
@@ -53,7 +58,8 @@ std::unique_ptr<data_update::factory>
 create_update_backend(const boost::program_options::variables_map &);
 
 // this function registers a backend for use when creating backends
-// from user-provided options.
+// from user-provided options. the backend with the alphabetically first
+// name is the default one.
 bool register_backend(std::unique_ptr<backend>);
 
 #endif /* BACKEND_HPP */
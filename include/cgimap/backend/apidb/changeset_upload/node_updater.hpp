@@ -47,6 +47,9 @@ public:
   void delete_node(osm_changeset_id_t changeset_id, osm_nwr_id_t id,
                    osm_version_t version, bool if_unused) override;
 
+  void lock_nodes(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                  const std::vector<osm_nwr_id_t> &shared_ids) override;
+
   void process_new_nodes() override;
 
   void process_modify_nodes() override;
@@ -46,6 +46,9 @@ public:
   void delete_relation(osm_changeset_id_t changeset_id, osm_nwr_id_t id,
                        osm_version_t version, bool if_unused) override;
 
+  void lock_relations(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                      const std::vector<osm_nwr_id_t> &shared_ids) override;
+
   void process_new_relations() override;
 
   void process_modify_relations() override;
@@ -0,0 +1,36 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef APIDB_ROW_LOCKS
+#define APIDB_ROW_LOCKS
+
+#include "cgimap/types.hpp"
+
+#include <string>
+#include <vector>
+
+class Transaction_Manager;
+
+/**
+ * Lock the rows of table (one of the current_* tables) with the given ids,
+ * those to be changed in exclusive_ids and those only referenced in
+ * shared_ids.
+ *
+ * All rows are locked FOR UPDATE by a single statement, in ascending id
+ * order. Concurrent uploads acquire their locks in the same global order
+ * and thus cannot deadlock. As a statement only takes one lock mode, rows
+ * which are only referenced are locked exclusively as well. Unknown or
+ * deleted ids are silently skipped here, they get reported later on when
+ * the individual changes are processed.
+ */
+void lock_rows(Transaction_Manager &m, const std::string &table,
+               const std::vector<osm_nwr_id_t> &exclusive_ids,
+               const std::vector<osm_nwr_id_t> &shared_ids);
+
+#endif /* APIDB_ROW_LOCKS */
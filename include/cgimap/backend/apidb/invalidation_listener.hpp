@@ -0,0 +1,56 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef INVALIDATION_LISTENER_HPP
+#define INVALIDATION_LISTENER_HPP
+
+#include "cgimap/cache_invalidation.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+/**
+ * Listens for cache invalidation notifications on a PostgreSQL channel,
+ * in a background thread with its own connection, and passes the changes
+ * they list to a callback.
+ *
+ * Notifications aren't sent to hot standby servers, so the connection
+ * is made to the database used for updates. If the connection is lost,
+ * it is made again after a short delay; notifications sent in the
+ * meantime are missed, and the cached copies expire with their TTL.
+ */
+class invalidation_listener {
+public:
+  using callback = std::function<void(const cache_invalidation::changes &)>;
+
+  invalidation_listener(std::string connect_str, std::string channel, callback on_change);
+  ~invalidation_listener();
+
+  invalidation_listener(const invalidation_listener &) = delete;
+  invalidation_listener &operator=(const invalidation_listener &) = delete;
+
+private:
+  void run(std::stop_token stop);
+  void listen(std::stop_token stop);
+
+  const std::string m_connect_str;
+  const std::string m_channel;
+  const callback m_on_change;
+  // the thread only exists in the process which started the listener,
+  // not in forked daemon instances
+  pid_t m_owner;
+  std::unique_ptr<std::jthread> m_thread;
+};
+
+#endif /* INVALIDATION_LISTENER_HPP */
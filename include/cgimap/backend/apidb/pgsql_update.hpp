@@ -15,6 +15,7 @@
 #include "cgimap/api06/changeset_upload/changeset_updater.hpp"
 
 #include <memory>
+#include <string>
 #include <pqxx/pqxx>
 #include <boost/program_options.hpp>
 
@@ -23,7 +24,8 @@ struct RequestContext;
 class pgsql_update : public data_update {
 
 public:
-  pgsql_update(Transaction_Owner_Base& to, bool is_readonly);
+  pgsql_update(Transaction_Owner_Base& to, bool is_readonly,
+               std::string invalidation_channel);
 
   ~pgsql_update() override = default;
 
@@ -39,6 +41,8 @@ public:
   std::unique_ptr<api06::Relation_Updater>
   get_relation_updater(const RequestContext& ctx, api06::OSMChange_Tracking &ct) override;
 
+  void notify_changes(const cache_invalidation::changes &changes) override;
+
   void commit() override;
 
   bool is_api_write_disabled() const override;
@@ -62,6 +66,7 @@ public:
   private:
     pqxx::connection m_connection;
     bool m_api_write_disabled;
+    std::string m_invalidation_channel;
     pqxx::quiet_errorhandler m_errorhandler;
     std::set<std::string> m_prep_stmt;  // keeps track of already prepared statements
   };
@@ -69,6 +74,10 @@ public:
 private:
   Transaction_Manager m;
   bool m_readonly;
+  std::string m_invalidation_channel;
 };
 
+// connection string for the database receiving updates
+std::string connect_update_db_str(const boost::program_options::variables_map &options);
+
 #endif
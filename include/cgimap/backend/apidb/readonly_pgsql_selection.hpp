@@ -43,6 +43,7 @@ public:
   visibility_t check_node_visibility(osm_nwr_id_t id) override;
   visibility_t check_way_visibility(osm_nwr_id_t id) override;
   visibility_t check_relation_visibility(osm_nwr_id_t id) override;
+  std::optional<osm_nwr_id_t> max_element_id(element_type type) override;
 
   int select_nodes(const std::vector<osm_nwr_id_t> &)override ;
   int select_ways(const std::vector<osm_nwr_id_t> &) override;
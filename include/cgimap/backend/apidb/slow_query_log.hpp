@@ -0,0 +1,74 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef SLOW_QUERY_LOG_HPP
+#define SLOW_QUERY_LOG_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <fmt/core.h>
+
+/**
+ * Log of prepared statements exceeding a time threshold, kept separate
+ * from the main log file.
+ *
+ * Each entry lists the statement, its execution time, the number of rows
+ * and the cardinality of its parameters. A sample of the slow statements
+ * executed in read only transactions is run a second time with EXPLAIN
+ * (ANALYZE, BUFFERS, SETTINGS), so that the entry also shows the plan,
+ * including planner settings changed for the session, such as
+ * enable_mergejoin for the map call.
+ */
+namespace slow_query_log {
+
+/**
+ * Enable the slow query log. explain_rate is the share of slow statements
+ * (0 to 1) which are explained. An empty filename disables the log.
+ */
+void initialise(const std::string &filename = "",
+                std::chrono::milliseconds threshold = std::chrono::milliseconds(1000),
+                double explain_rate = 0.1);
+
+[[nodiscard]] bool enabled() noexcept;
+
+[[nodiscard]] bool is_slow(std::chrono::steady_clock::duration elapsed) noexcept;
+
+// whether this slow statement should be explained
+[[nodiscard]] bool sample_explain();
+
+void write(std::string_view statement, std::chrono::steady_clock::duration elapsed,
+           std::size_t rows, std::string_view parameters, std::string_view plan) noexcept;
+
+// arrays are described by their length, values are never logged
+template <typename T>
+std::string describe_parameter(const T &value) {
+  if constexpr (std::is_convertible_v<const T &, std::string_view>)
+    return "text";
+  else if constexpr (std::ranges::sized_range<T>)
+    return fmt::format("array[{}]", std::ranges::size(value));
+  else
+    return "scalar";
+}
+
+template <typename... Args>
+std::string describe_parameters(const Args &...args) {
+  std::string result;
+  int n = 0;
+  ((result += fmt::format("{}${} {}", n > 0 ? ", " : "", n + 1, describe_parameter(args)), ++n), ...);
+  return result;
+}
+
+} // namespace slow_query_log
+
+#endif /* SLOW_QUERY_LOG_HPP */
@@ -0,0 +1,54 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef STATEMENT_CATALOG_HPP
+#define STATEMENT_CATALOG_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pqxx/pqxx>
+
+/**
+ * A prepared statement, defined at namespace scope next to the code
+ * executing it. Each definition adds itself to a catalog of all the
+ * statements, so that a new connection can prepare them in a single
+ * round trip, rather than one at a time as requests first use them.
+ */
+class prepared_statement {
+public:
+  // read statements are used on both the read only and the update
+  // connection, update statements only on the update connection
+  enum use { read, update };
+
+  prepared_statement(std::string name, std::string definition, use used_on = read);
+
+  prepared_statement(const prepared_statement &) = delete;
+  prepared_statement &operator=(const prepared_statement &) = delete;
+
+  const std::string name;
+  const std::string definition;
+  const use used_on;
+
+  // all statements, in the order they were defined
+  [[nodiscard]] static const std::vector<const prepared_statement *> &catalog();
+};
+
+/**
+ * Prepare the statements in the catalog used on a connection, up to
+ * used_on, and add the names of those prepared to the set of statements
+ * Transaction_Manager doesn't need to prepare again. Should preparing
+ * fail, e.g. because a statement refers to a missing function, the
+ * remaining statements are prepared when first used.
+ */
+void prepare_statements(pqxx::connection &c, std::set<std::string> &prepared,
+                        prepared_statement::use used_on);
+
+#endif /* STATEMENT_CATALOG_HPP */
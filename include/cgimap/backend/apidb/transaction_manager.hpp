@@ -11,8 +11,15 @@
 #define TRANSACTION_MANAGER_HPP
 
 #include "cgimap/logger.hpp"
+#include "cgimap/metrics.hpp"
+#include "cgimap/request_memory.hpp"
+#include "cgimap/request_timing.hpp"
+#include "cgimap/backend/apidb/slow_query_log.hpp"
+#include "cgimap/backend/apidb/statement_catalog.hpp"
 
 #include <chrono>
+#include <map>
+#include <optional>
 #include <set>
 #include <string_view>
 #include <string>
@@ -27,24 +34,32 @@ class pqxx_stats {
   public:
     pqxx_stats() = default;
 
-    void log_statement_stats(std::string_view statement, const pqxx::result &res) const {
-      logger::message(fmt::format("Executed prepared statement {} in {:d} ms, returning {:d} rows, {:d} affected rows",
-        statement, get_elapsed(), res.size(), res.affected_rows()));
+    void log_statement_stats(std::string_view statement, const pqxx::result &res) {
+      m_elapsed = std::chrono::steady_clock::now() - start;
+      metrics::observe_statement(statement, m_elapsed);
+      if (!logger::enabled(logger::level::debug))
+        return;
+      logger::message(logger::level::debug, fmt::format("Executed prepared statement {} in {:d} ms, returning {:d} rows, {:d} affected rows",
+        statement, to_ms(m_elapsed), res.size(), res.affected_rows()));
     }
 
+    // as measured by log_statement_stats
+    [[nodiscard]] std::chrono::steady_clock::duration elapsed() const { return m_elapsed; }
+
     void log_commit_stats() const {
-      logger::message(fmt::format("COMMIT transaction in {:d} ms", get_elapsed()));
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      metrics::observe_statement("COMMIT", elapsed);
+      logger::message(logger::level::debug, fmt::format("COMMIT transaction in {:d} ms", to_ms(elapsed)));
     }
 
   private:
 
-    int64_t get_elapsed() const {
-      const auto end = std::chrono::steady_clock::now();
-      const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-      return elapsed.count();
+    static int64_t to_ms(std::chrono::steady_clock::duration elapsed) {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
     }
 
     std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+    std::chrono::steady_clock::duration m_elapsed{};
 };
 
 #if PQXX_VERSION_MAJOR >= 7
@@ -87,7 +102,7 @@ private:
     const auto end = std::chrono::steady_clock::now();
     const auto elapsed = std::chrono::duration_cast < std::chrono::milliseconds > (end - m_start);
 
-    logger::message(fmt::format(
+    logger::message(logger::level::debug, fmt::format(
             "Executed COPY statement for table {} in {:d} ms, inserted {:d} rows",
             m_table, elapsed.count(), row_count));
   }
@@ -105,6 +120,8 @@ public:
   Transaction_Owner_Base() = default;
   virtual pqxx::transaction_base& get_transaction() = 0;
   virtual std::set<std::string>& get_prep_stmt() = 0;
+  // statements in read only transactions can safely be run twice
+  virtual bool is_read_only() const { return false; }
   virtual ~Transaction_Owner_Base() = default;
 };
 
@@ -115,6 +132,7 @@ public:
   explicit Transaction_Owner_ReadOnly(pqxx::connection &conn, std::set<std::string> &prep_stmt);
   pqxx::transaction_base& get_transaction() override;
   std::set<std::string>& get_prep_stmt() override;
+  bool is_read_only() const override { return true; }
   ~Transaction_Owner_ReadOnly() override = default;
 
 private:
@@ -123,6 +141,8 @@ private:
 };
 
 
+// The read/write transaction is only started on first use. Requests which
+// fail early on, e.g. due to an invalid payload, don't touch the database.
 class Transaction_Owner_ReadWrite : public Transaction_Owner_Base
 {
 public:
@@ -132,7 +152,8 @@ public:
   ~Transaction_Owner_ReadWrite() override = default;
 
 private:
-  pqxx::work m_txn;
+  pqxx::connection& m_conn;
+  std::optional<pqxx::work> m_txn;
   std::set<std::string>& m_prep_stmt;
 };
 
@@ -149,43 +170,96 @@ public:
   explicit Transaction_Manager(Transaction_Owner_Base &to);
 
   void prepare(const std::string &name, const std::string &);
+  void prepare(const prepared_statement &s) { prepare(s.name, s.definition); }
 
   pqxx::result exec(const std::string &query,
                     const std::string &description = std::string());
 
   void commit() {
+    auto span = request_timing::measure_statement();
     pqxx_stats stats;
 
-    m_txn.commit();
+    txn().commit();
 
     stats.log_commit_stats();
   }
 
+  // parameters are taken by reference, as slow statements may need them
+  // a second time to be explained
   template<typename... Args>
-  [[nodiscard]] pqxx::result exec_prepared(const std::string &statement, Args&&... args) {
+  [[nodiscard]] pqxx::result exec_prepared(const std::string &statement, const Args&... args) {
 
+    auto span = request_timing::measure_statement();
     pqxx_stats stats;
 
 #if PQXX_LIBRARY_VERSION_COMPARE(PQXX_VERSION_MAJOR, PQXX_VERSION_MINOR, PQXX_VERSION_PATCH, 7, 9, 3)
-    auto res(m_txn.exec_prepared(statement, std::forward<Args>(args)...));
+    auto res(txn().exec_prepared(statement, args...));
 #else
-    auto res(m_txn.exec(pqxx::prepped{statement}, pqxx::params{std::forward<Args>(args)...}));
+    auto res(txn().exec(pqxx::prepped{statement}, pqxx::params{args...}));
 #endif
 
     stats.log_statement_stats(statement, res);
 
+    if (slow_query_log::is_slow(stats.elapsed())) [[unlikely]]
+      log_slow_statement(statement, stats.elapsed(), res.size(), args...);
+
+    // by now, the selection built from earlier results has been accounted
+    request_memory::check();
+
     return res;
   }
 
 #if PQXX_VERSION_MAJOR >= 7
   Stream_Wrapper to_stream(std::string_view table, std::string_view columns) {
-    return Stream_Wrapper(m_txn, table, columns);
+    return Stream_Wrapper(txn(), table, columns);
   }
 #endif
 
 private:
-  pqxx::transaction_base & m_txn;
+  pqxx::transaction_base& txn() { return m_to.get_transaction(); }
+
+  template<typename... Args>
+  void log_slow_statement(const std::string &statement,
+                          std::chrono::steady_clock::duration elapsed,
+                          std::size_t rows, const Args&... args) {
+    std::string plan;
+    const auto definition = m_definitions.find(statement);
+    if (m_to.is_read_only() && definition != m_definitions.end() &&
+        slow_query_log::sample_explain()) {
+      plan = explain(definition->second, args...);
+    }
+    slow_query_log::write(statement, elapsed, rows,
+                          slow_query_log::describe_parameters(args...), plan);
+  }
+
+  // runs the statement once more, in a subtransaction so that errors
+  // don't abort the request's transaction
+  template<typename... Args>
+  std::string explain(const std::string &definition, const Args&... args) {
+    std::string plan;
+    try {
+      pqxx::subtransaction sub(dynamic_cast<pqxx::dbtransaction &>(txn()), "explain");
+      const auto query = "EXPLAIN (ANALYZE, BUFFERS, SETTINGS) " + definition;
+#if PQXX_LIBRARY_VERSION_COMPARE(PQXX_VERSION_MAJOR, PQXX_VERSION_MINOR, PQXX_VERSION_PATCH, 7, 9, 3)
+      const auto res = sub.exec_params(query, args...);
+#else
+      const auto res = sub.exec(query, pqxx::params{args...});
+#endif
+      for (const auto &row : res) {
+        plan += row[0].c_str();
+        plan += '\n';
+      }
+      sub.commit();
+    } catch (const std::exception &e) {
+      plan = fmt::format("EXPLAIN failed: {}", e.what());
+    }
+    return plan;
+  }
+
+  Transaction_Owner_Base& m_to;
   std::set<std::string>& m_prep_stmt;
+  // only kept while the slow query log is enabled, for EXPLAIN
+  std::map<std::string, std::string, std::less<>> m_definitions;
 };
 
 #undef PQXX_LIBRARY_VERSION_COMPARE
@@ -0,0 +1,40 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include <sys/mman.h>
+
+// read only mapping of a whole file. pages are shared with all other
+// processes mapping the same file, including forked children.
+class mapped_file {
+public:
+  // advice is passed to madvise, e.g. MADV_SEQUENTIAL when the file is
+  // only read once
+  explicit mapped_file(const std::string &filename, int advice = MADV_NORMAL);
+  ~mapped_file();
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  [[nodiscard]] std::string_view data() const noexcept {
+    return {static_cast<const char *>(m_data), m_size};
+  }
+
+private:
+  void *m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
+#endif /* MAPPED_FILE_HPP */
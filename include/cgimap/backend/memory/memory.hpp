@@ -0,0 +1,23 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef MEMORY_BACKEND_HPP
+#define MEMORY_BACKEND_HPP
+
+#include "cgimap/backend.hpp"
+
+#include <memory>
+
+// serves an OSM XML or PBF file loaded into memory
+std::unique_ptr<backend> make_memory_backend();
+
+// serves a snapshot file written by openstreetmap-cgimap-snapshot
+std::unique_ptr<backend> make_snapshot_backend();
+
+#endif /* MEMORY_BACKEND_HPP */
@@ -0,0 +1,146 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef MEMORY_SELECTION_HPP
+#define MEMORY_SELECTION_HPP
+
+#include "cgimap/data_selection.hpp"
+#include "cgimap/backend/apidb/transaction_manager.hpp"
+#include "cgimap/backend/memory/osm_dataset.hpp"
+
+#include <chrono>
+#include <memory>
+#include <set>
+
+// the memory backend doesn't use any transactions
+class Transaction_Owner_Memory : public Transaction_Owner_Base
+{
+public:
+  Transaction_Owner_Memory() = default;
+  pqxx::transaction_base& get_transaction() override;
+  std::set<std::string>& get_prep_stmt() override;
+  bool is_read_only() const override { return true; }
+  ~Transaction_Owner_Memory() override = default;
+};
+
+/**
+ * a selection which operates against an osm_dataset, shared by all
+ * selections of the process. the selected elements are kept in the
+ * same way as in readonly_pgsql_selection, and results are the same
+ * as for a database containing the same data.
+ */
+class memory_selection : public data_selection {
+
+public:
+  explicit memory_selection(std::shared_ptr<const osm_dataset> dataset);
+  explicit memory_selection(std::shared_ptr<const osm_store> store);
+  ~memory_selection() override = default;
+
+  void write_nodes(output_formatter &formatter) override;
+  void write_ways(output_formatter &formatter) override;
+  void write_relations(output_formatter &formatter) override;
+  void write_changesets(output_formatter &formatter, const std::chrono::system_clock::time_point &now) override;
+
+  visibility_t check_node_visibility(osm_nwr_id_t id) override;
+  visibility_t check_way_visibility(osm_nwr_id_t id) override;
+  visibility_t check_relation_visibility(osm_nwr_id_t id) override;
+
+  int select_nodes(const std::vector<osm_nwr_id_t> &) override;
+  int select_ways(const std::vector<osm_nwr_id_t> &) override;
+  int select_relations(const std::vector<osm_nwr_id_t> &) override;
+  int select_nodes_from_bbox(const bbox &bounds, int max_nodes) override;
+  void select_nodes_from_relations() override;
+  void select_ways_from_nodes() override;
+  void select_ways_from_relations() override;
+  void select_relations_from_ways() override;
+  void select_nodes_from_way_nodes() override;
+  void select_relations_from_nodes() override;
+  void select_relations_from_relations(bool drop_relations = false) override;
+  void select_relations_members_of_relations() override;
+
+  int select_changesets(const std::vector<osm_changeset_id_t> &) override;
+  void select_changeset_discussions() override;
+
+  void drop_nodes() override;
+  void drop_ways() override;
+  void drop_relations() override;
+
+  int select_historical_nodes(const std::vector<osm_edition_t> &) override;
+  int select_historical_ways(const std::vector<osm_edition_t> &) override;
+  int select_historical_relations(const std::vector<osm_edition_t> &) override;
+  int select_nodes_with_history(const std::vector<osm_nwr_id_t> &) override;
+  int select_ways_with_history(const std::vector<osm_nwr_id_t> &) override;
+  int select_relations_with_history(const std::vector<osm_nwr_id_t> &) override;
+  void set_redactions_visible(bool) override;
+  int select_historical_by_changesets(const std::vector<osm_changeset_id_t> &) override;
+
+  // user accounts aren't part of OSM files
+  bool supports_user_details() const override;
+  bool is_user_blocked(const osm_user_id_t) override;
+  std::set< osm_user_role_t > get_roles_for_user(osm_user_id_t id) override;
+  std::optional< osm_user_id_t > get_user_id_for_oauth2_token(
+      const std::string &token_id, bool &expired, bool &revoked,
+      bool &allow_api_write) override;
+  bool is_user_active(const osm_user_id_t id) override;
+
+  // time of the last replication diff applied to the dataset
+  std::optional<std::chrono::system_clock::time_point> data_timestamp() const override;
+
+  /**
+   * a factory for the creation of selections on the dataset currently
+   * published.
+   */
+  class factory : public data_selection::factory {
+  public:
+    explicit factory(std::shared_ptr<const published_dataset> dataset);
+    ~factory() override = default;
+    std::unique_ptr<data_selection> make_selection(Transaction_Owner_Base&) const override;
+    std::unique_ptr<Transaction_Owner_Base> get_default_transaction() override;
+
+  private:
+    std::shared_ptr<const published_dataset> m_dataset;
+  };
+
+private:
+  static element_info info(const osm_store &store, const osm_store::element_table &table,
+                           osm_store::entry_t i);
+  static tags_t tags(const osm_store &store, const osm_store::element_table &table,
+                     osm_store::entry_t i);
+
+  int select_current(element_type type, const std::vector<osm_nwr_id_t> &ids,
+                     std::set<osm_nwr_id_t> &sel);
+  int select_historical(element_type type, const std::vector<osm_edition_t> &eds,
+                        std::set<osm_edition_t> &sel);
+  int select_with_history(element_type type, const std::vector<osm_nwr_id_t> &ids,
+                          std::set<osm_edition_t> &sel);
+  int select_by_changesets(element_type type, const std::vector<osm_changeset_id_t> &ids,
+                           std::set<osm_edition_t> &sel);
+  void select_members(element_type type, std::set<osm_nwr_id_t> &sel);
+  void select_parents(osm_store::parent_index osm_store::*index, element_type parent_type,
+                      const std::set<osm_nwr_id_t> &children, std::set<osm_nwr_id_t> &sel);
+
+  // kept for the lifetime of the selection, even if a newer dataset is
+  // published in the meantime
+  std::shared_ptr<const osm_dataset> m_dataset;
+
+  // true if we want to include changeset discussions along with
+  // the changesets themselves.
+  bool include_changeset_discussions { false };
+
+  // true if the user is a moderator and we should include redacted historical
+  // versions in the responses.
+  bool m_redactions_visible { false };
+
+  // the set of selected nodes, ways and relations
+  std::set<osm_changeset_id_t> sel_changesets;
+  std::set<osm_nwr_id_t> sel_nodes, sel_ways, sel_relations;
+  std::set<osm_edition_t> sel_historic_nodes, sel_historic_ways, sel_historic_relations;
+};
+
+#endif /* MEMORY_SELECTION_HPP */
@@ -0,0 +1,91 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef OSM_DATASET_HPP
+#define OSM_DATASET_HPP
+
+#include "cgimap/backend/memory/osm_store.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * The data served by the memory backends: the store loaded from a file,
+ * followed by the stores built from the replication diffs applied since.
+ * A store only contains versions newer than those in the stores before
+ * it, so the current version of an element is in the last store which
+ * has the element.
+ *
+ * Datasets are never modified, applying a diff creates a new dataset
+ * sharing the existing stores.
+ */
+class osm_dataset {
+public:
+  struct entry_ref {
+    const osm_store *store;
+    osm_store::entry_t i;
+  };
+
+  explicit osm_dataset(std::shared_ptr<const osm_store> store);
+  osm_dataset(std::vector<std::shared_ptr<const osm_store>> layers,
+              uint64_t sequence,
+              std::optional<std::chrono::system_clock::time_point> timestamp);
+
+  [[nodiscard]] const std::vector<std::shared_ptr<const osm_store>> &layers() const noexcept {
+    return m_layers;
+  }
+
+  // sequence number of the last replication diff applied, 0 if none
+  [[nodiscard]] uint64_t sequence() const noexcept { return m_sequence; }
+
+  // time of the last replication diff applied
+  [[nodiscard]] std::optional<std::chrono::system_clock::time_point> timestamp() const noexcept {
+    return m_timestamp;
+  }
+
+  static const osm_store::element_table &table(const osm_store &store, element_type type);
+
+  [[nodiscard]] std::optional<entry_ref> current(element_type type, osm_nwr_id_t id) const;
+  [[nodiscard]] std::optional<entry_ref> find(element_type type, osm_nwr_id_t id,
+                                              osm_version_t version) const;
+
+  // whether the element isn't replaced by a later store than the given one
+  [[nodiscard]] bool is_newest(const osm_store &store, element_type type, osm_nwr_id_t id) const;
+
+  // first store which has the changeset, or nullptr
+  [[nodiscard]] const osm_store::changeset *changeset(osm_changeset_id_t id) const;
+
+private:
+  std::vector<std::shared_ptr<const osm_store>> m_layers;
+  uint64_t m_sequence = 0;
+  std::optional<std::chrono::system_clock::time_point> m_timestamp;
+};
+
+/**
+ * The dataset currently served. Selections take the current dataset when
+ * they are made and keep it until they are done, so publishing a new
+ * dataset never waits for requests, and requests never wait for updates.
+ */
+class published_dataset {
+public:
+  explicit published_dataset(std::shared_ptr<const osm_dataset> dataset)
+      : m_dataset(std::move(dataset)) {}
+
+  [[nodiscard]] std::shared_ptr<const osm_dataset> get() const { return m_dataset.load(); }
+  void publish(std::shared_ptr<const osm_dataset> dataset) { m_dataset.store(std::move(dataset)); }
+
+private:
+  std::atomic<std::shared_ptr<const osm_dataset>> m_dataset;
+};
+
+#endif /* OSM_DATASET_HPP */
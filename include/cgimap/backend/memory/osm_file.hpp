@@ -0,0 +1,38 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef OSM_FILE_HPP
+#define OSM_FILE_HPP
+
+#include "cgimap/backend/memory/osm_store.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// loads an OSM XML or PBF file, the format is detected from the contents.
+// compressed XML files aren't supported.
+std::unique_ptr<osm_store> load_osm_file(const std::string &filename);
+
+// loads an uncompressed OSM XML document, including changesets with their
+// discussions if present. documents must be smaller than 2 GB.
+std::unique_ptr<osm_store> load_osm_xml(std::string_view data);
+
+// loads an osmChange document, such as a replication diff. elements in
+// delete blocks are added as deleted versions, and elements for which
+// accept returns false are skipped.
+std::unique_ptr<osm_store> load_osm_change(
+    std::string_view data,
+    const std::function<bool(element_type, osm_nwr_id_t, osm_version_t)> &accept);
+
+// loads an OSM PBF file, including the history if it has any
+std::unique_ptr<osm_store> load_osm_pbf(std::string_view data);
+
+#endif /* OSM_FILE_HPP */
@@ -0,0 +1,338 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef OSM_STORE_HPP
+#define OSM_STORE_HPP
+
+#include "cgimap/output_formatter.hpp"
+#include "cgimap/types.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * A column of the store. Columns are either built in memory, or refer to
+ * a part of a memory mapped snapshot file.
+ */
+template <typename T>
+class column {
+public:
+  using value_type = T;
+  using const_iterator = const T *;
+
+  column() = default;
+  column(std::initializer_list<T> values) : m_values(values) {}
+
+  [[nodiscard]] std::span<const T> view() const noexcept {
+    return m_mapped.data() != nullptr ? m_mapped : std::span<const T>(m_values);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return view().size(); }
+  [[nodiscard]] bool empty() const noexcept { return view().empty(); }
+  [[nodiscard]] const T &operator[](std::size_t i) const noexcept { return view()[i]; }
+  [[nodiscard]] const T &back() const noexcept { return view().back(); }
+  [[nodiscard]] const T *data() const noexcept { return view().data(); }
+  [[nodiscard]] const_iterator begin() const noexcept { return data(); }
+  [[nodiscard]] const_iterator end() const noexcept { return data() + size(); }
+
+  // the values of a column which is being built
+  [[nodiscard]] std::vector<T> &values() noexcept { return m_values; }
+
+  // refers to mapped memory instead, which has to outlive the column
+  void map(std::span<const T> mapped) noexcept {
+    m_values = std::vector<T>();
+    m_mapped = mapped;
+  }
+
+  friend bool operator==(const column &a, const column &b) {
+    return std::ranges::equal(a.view(), b.view());
+  }
+
+  // heap memory only, mapped columns are part of the page cache
+  [[nodiscard]] std::size_t memory_usage() const noexcept {
+    return m_values.capacity() * sizeof(T);
+  }
+
+private:
+  std::vector<T> m_values;
+  std::span<const T> m_mapped;
+};
+
+/**
+ * Read only, in-memory copy of OSM data, as used by the memory backend.
+ *
+ * Elements are kept in one table per type, with one entry per version and
+ * a column per attribute. Entries are sorted by id and version, so that
+ * the current version of an element is the last entry with its id.
+ * Variable length data (tags, way nodes, relation members) is stored in
+ * a single array per table, with an offset per entry. Strings are stored
+ * once and referenced by their index.
+ *
+ * Way nodes and relation members are indexed by child id, and visible
+ * nodes by tile, covering the current versions only.
+ *
+ * All columns can be written to a snapshot file and mapped from there,
+ * see snapshot.hpp.
+ */
+class osm_store {
+public:
+  // index of a string in the string table
+  using string_id = uint32_t;
+  // index of an element version in its table
+  using entry_t = uint32_t;
+
+  struct tag_ref {
+    string_id key;
+    string_id value;
+  };
+
+  struct member_ref {
+    osm_nwr_id_t ref;
+    string_id role;
+    element_type type;
+  };
+
+  struct user {
+    osm_user_id_t id;
+    string_id name;
+  };
+
+  struct changeset {
+    changeset_info info;
+    tags_t tags;
+    comments_t comments;
+  };
+
+  // (child id, parent id), sorted
+  using parent_index = column<std::pair<osm_nwr_id_t, osm_nwr_id_t>>;
+
+  enum entry_flags : uint8_t {
+    visible_flag = 1,
+    redacted_flag = 2
+  };
+
+  struct element_table {
+    column<osm_nwr_id_t> ids;
+    column<osm_version_t> versions;
+    column<osm_changeset_id_t> changesets;
+    // seconds since the epoch
+    column<int64_t> timestamps;
+    // index into users, 0 for anonymous edits
+    column<uint32_t> users;
+    column<uint8_t> flags;
+    // the tags of entry i are tags[tag_offsets[i], tag_offsets[i + 1])
+    column<uint64_t> tag_offsets;
+    column<tag_ref> tags;
+    // (changeset, entry) of all versions, sorted
+    column<std::pair<osm_changeset_id_t, entry_t>> by_changeset;
+
+    [[nodiscard]] std::size_t size() const noexcept { return ids.size(); }
+
+    // range of entries with the given id, empty if there are none
+    [[nodiscard]] std::pair<entry_t, entry_t> versions_of(osm_nwr_id_t id) const;
+    [[nodiscard]] std::optional<entry_t> current(osm_nwr_id_t id) const;
+    [[nodiscard]] std::optional<entry_t> find(osm_nwr_id_t id, osm_version_t version) const;
+    // (changeset, entry) of the versions created in a changeset
+    [[nodiscard]] std::span<const std::pair<osm_changeset_id_t, entry_t>>
+    in_changeset(osm_changeset_id_t changeset) const;
+
+    // whether entry i is the current version of its element
+    [[nodiscard]] bool is_current(entry_t i) const noexcept {
+      return i + 1 == ids.size() || ids[i + 1] != ids[i];
+    }
+    [[nodiscard]] bool visible(entry_t i) const noexcept { return flags[i] & visible_flag; }
+    [[nodiscard]] bool redacted(entry_t i) const noexcept { return flags[i] & redacted_flag; }
+    [[nodiscard]] std::span<const tag_ref> tags_of(entry_t i) const noexcept {
+      return {tags.data() + tag_offsets[i], tags.data() + tag_offsets[i + 1]};
+    }
+  };
+
+  struct node_table : element_table {
+    // scaled by global_settings::get_scale()
+    column<int32_t> lats;
+    column<int32_t> lons;
+  };
+
+  struct way_table : element_table {
+    column<uint64_t> node_offsets;
+    column<osm_nwr_id_t> way_nodes;
+
+    [[nodiscard]] std::span<const osm_nwr_id_t> nodes_of(entry_t i) const noexcept {
+      return {way_nodes.data() + node_offsets[i], way_nodes.data() + node_offsets[i + 1]};
+    }
+  };
+
+  struct relation_table : element_table {
+    column<uint64_t> member_offsets;
+    column<member_ref> members;
+
+    [[nodiscard]] std::span<const member_ref> members_of(entry_t i) const noexcept {
+      return {members.data() + member_offsets[i], members.data() + member_offsets[i + 1]};
+    }
+  };
+
+  node_table nodes;
+  way_table ways;
+  relation_table relations;
+
+  // changesets are only available if the file contained them
+  std::map<osm_changeset_id_t, changeset> changesets;
+
+  parent_index node_ways;
+  parent_index node_relations;
+  parent_index way_relations;
+  parent_index relation_relations;
+
+  // (tile, entry) of the current, visible nodes, sorted
+  column<std::pair<tile_id_t, entry_t>> node_tiles;
+
+  [[nodiscard]] std::string_view string(string_id id) const noexcept {
+    return {m_strings.data() + m_string_offsets[id],
+            m_string_offsets[id + 1] - m_string_offsets[id]};
+  }
+
+  // uid and display name of the author of entry i, if not anonymous
+  [[nodiscard]] const user *user_of(const element_table &table, entry_t i) const noexcept {
+    return table.users[i] == 0 ? nullptr : &m_users[table.users[i]];
+  }
+
+  // calls f with the id of each parent of child in the index
+  template <typename F>
+  static void for_each_parent(const parent_index &index, osm_nwr_id_t child, F &&f) {
+    for (auto itr = lower_bound(index, child); itr != index.end() && itr->first == child; ++itr)
+      f(itr->second);
+  }
+
+  // heap memory used by the columns
+  [[nodiscard]] std::size_t memory_usage() const noexcept;
+
+  // calls f with each column, always in the same order. changesets aren't
+  // stored in columns.
+  template <typename F>
+  void for_each_column(F &&f) { visit_columns(*this, f); }
+  template <typename F>
+  void for_each_column(F &&f) const { visit_columns(*this, f); }
+
+  // keeps the memory the columns are mapped from alive
+  void set_mapping(std::shared_ptr<const void> mapping) noexcept { m_mapping = std::move(mapping); }
+
+private:
+  friend class osm_store_builder;
+
+  static parent_index::const_iterator lower_bound(const parent_index &index, osm_nwr_id_t child);
+
+  template <typename Table, typename F>
+  static void visit_table(Table &t, F &f) {
+    f(t.ids);
+    f(t.versions);
+    f(t.changesets);
+    f(t.timestamps);
+    f(t.users);
+    f(t.flags);
+    f(t.tag_offsets);
+    f(t.tags);
+    f(t.by_changeset);
+  }
+
+  template <typename Store, typename F>
+  static void visit_columns(Store &s, F &f) {
+    visit_table(s.nodes, f);
+    f(s.nodes.lats);
+    f(s.nodes.lons);
+    visit_table(s.ways, f);
+    f(s.ways.node_offsets);
+    f(s.ways.way_nodes);
+    visit_table(s.relations, f);
+    f(s.relations.member_offsets);
+    f(s.relations.members);
+    f(s.node_ways);
+    f(s.node_relations);
+    f(s.way_relations);
+    f(s.relation_relations);
+    f(s.node_tiles);
+    f(s.m_strings);
+    f(s.m_string_offsets);
+    f(s.m_users);
+  }
+
+  column<char> m_strings;
+  column<uint64_t> m_string_offsets{0};
+  column<user> m_users;
+  // keeps the snapshot file mapped, if the store was loaded from one
+  std::shared_ptr<const void> m_mapping;
+};
+
+/**
+ * Builds an osm_store from elements in any order. Tags, way nodes and
+ * members are added to the element added last.
+ */
+class osm_store_builder {
+public:
+  struct entity {
+    osm_nwr_id_t id = 0;
+    osm_version_t version = 0;
+    osm_changeset_id_t changeset = 0;
+    // seconds since the epoch
+    int64_t timestamp = 0;
+    std::optional<osm_user_id_t> uid;
+    std::string_view user;
+    bool visible = true;
+    bool redacted = false;
+  };
+
+  osm_store_builder();
+
+  void add_node(const entity &e, double lat, double lon);
+  void add_way(const entity &e);
+  void add_relation(const entity &e);
+
+  void add_tag(std::string_view key, std::string_view value);
+  void add_way_node(osm_nwr_id_t ref);
+  void add_member(element_type type, osm_nwr_id_t ref, std::string_view role);
+
+  void add_changeset(osm_store::changeset cs);
+
+  // adds all entries and changesets of another store
+  void add_store(const osm_store &store);
+
+  // sorts the tables and builds the indexes. the builder can't be used
+  // afterwards.
+  [[nodiscard]] std::unique_ptr<osm_store> finish();
+
+private:
+  struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  osm_store::string_id intern(std::string_view s);
+  osm_store::element_table &begin_entry(osm_store::element_table &table, const entity &e);
+  void end_entry();
+
+  std::unique_ptr<osm_store> m_store;
+  std::unordered_map<std::string, osm_store::string_id, string_hash, std::equal_to<>> m_string_ids;
+  std::unordered_map<osm_user_id_t, uint32_t> m_user_ids;
+  // table of the element added last
+  osm_store::element_table *m_current = nullptr;
+  element_type m_current_type = element_type::node;
+};
+
+#endif /* OSM_STORE_HPP */
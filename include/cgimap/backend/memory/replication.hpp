@@ -0,0 +1,74 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef REPLICATION_HPP
+#define REPLICATION_HPP
+
+#include "cgimap/backend/memory/osm_dataset.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+/**
+ * Applies OSM replication diffs to the data of the memory backends.
+ *
+ * Diffs are read from a local directory with the same layout as the
+ * replication directories of planet.openstreetmap.org, i.e. the diff with
+ * sequence number 1234567 is 001/234/567.osc.gz (or .osc) with its state in
+ * 001/234/567.state.txt. How the directory is kept up to date, e.g. by
+ * mirroring the minutely diffs, is up to the operator.
+ *
+ * Each diff becomes a new store on top of the existing ones, containing
+ * only versions newer than those already present, so diffs can safely be
+ * applied more than once. Smaller stores are merged once they get too
+ * many, keeping the number of stores logarithmic in the number of diffs.
+ */
+
+struct replication_state {
+  uint64_t sequence = 0;
+  std::chrono::system_clock::time_point timestamp;
+};
+
+// parses the contents of a state.txt file
+replication_state parse_replication_state(std::string_view data);
+
+// the file with the given sequence number and extension, such as
+// dir/001/234/567.state.txt
+std::filesystem::path replication_file(const std::filesystem::path &dir, uint64_t sequence,
+                                       std::string_view extension);
+
+// returns a dataset with an osmChange document applied on top of dataset
+std::shared_ptr<const osm_dataset> apply_diff(const osm_dataset &dataset, std::string_view osc,
+                                              const replication_state &state);
+
+/**
+ * Applies the diffs of a replication directory in order of their sequence
+ * numbers, starting with first_sequence, and publishes the resulting
+ * datasets.
+ */
+class replication_applier {
+public:
+  replication_applier(std::filesystem::path dir, uint64_t first_sequence,
+                      std::shared_ptr<published_dataset> dataset);
+
+  // applies all diffs whose state file exists, returns the number of
+  // diffs applied. throws if a diff can't be applied, in which case the
+  // diffs before it remain applied.
+  int apply_available();
+
+private:
+  std::filesystem::path m_dir;
+  uint64_t m_next_sequence;
+  std::shared_ptr<published_dataset> m_dataset;
+};
+
+#endif /* REPLICATION_HPP */
@@ -0,0 +1,45 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "cgimap/backend/memory/osm_store.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Snapshot files contain the columns of an osm_store with the same layout
+ * as in memory, so that a store can be used directly from a memory mapped
+ * file. Loading a snapshot only checks its header, pages are read on
+ * demand and shared by all processes mapping the same file.
+ *
+ * A snapshot starts with a header (magic, format version, byte order mark,
+ * coordinate scale and number of columns), followed by the offset, number
+ * of values and value size of each column. Column data is aligned to 64
+ * bytes. Everything is stored in native byte order, so snapshots can only
+ * be used on the platform they were written on.
+ *
+ * Changesets aren't stored in snapshots.
+ */
+
+// incremented whenever the layout of the store changes
+constexpr uint32_t snapshot_format_version = 1;
+
+// writes a snapshot to a temporary file first and renames it afterwards,
+// processes which have mapped an older snapshot can continue to use it.
+void write_snapshot(const osm_store &store, const std::string &filename);
+
+// maps a snapshot file, throws if it was written by an incompatible
+// version or with a different coordinate scale.
+std::unique_ptr<osm_store> load_snapshot(const std::string &filename);
+
+#endif /* SNAPSHOT_HPP */
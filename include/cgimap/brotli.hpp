@@ -19,6 +19,7 @@
 #include <brotli/decode.h>
 #include <brotli/encode.h>
 
+#include "cgimap/decompressor.hpp"
 #include "cgimap/output_buffer.hpp"
 
 
@@ -53,6 +54,24 @@ private:
   bool flushed{false};
 };
 
+/**
+ * Streaming decompression of brotli encoded request bodies.
+ */
+class BrotliDecompressor : public Decompressor {
+public:
+  BrotliDecompressor();
+  ~BrotliDecompressor() override;
+
+  void decompress(std::string_view input, std::string& output,
+                  std::size_t max_output) override;
+
+private:
+  static constexpr size_t min_output_window = 16384;
+
+  BrotliDecoderState *state_ = nullptr;
+  bool finished{false};
+};
+
 #endif
 
 #endif
@@ -0,0 +1,70 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef CACHE_INVALIDATION_HPP
+#define CACHE_INVALIDATION_HPP
+
+#include "cgimap/bbox.hpp"
+#include "cgimap/output_formatter.hpp"
+#include "cgimap/types.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace api06 {
+  class OSMChange_Tracking;
+}
+class bbox_t;
+
+/**
+ * Notifications about changed data, so that caches can drop their copies
+ * of it. Uploads send them on a PostgreSQL channel in the same transaction
+ * as the changes, so they are only delivered once the changes are
+ * committed.
+ *
+ * A notification's payload lists items separated by spaces, each either
+ * type/id for the current version of an element or changeset, or
+ * type/id/version for a historic version, e.g. "node/1 way/2/3". Areas
+ * in which current elements changed are listed as
+ * area/minlon,minlat,maxlon,maxlat.
+ */
+namespace cache_invalidation {
+
+struct item {
+  element_type type;
+  osm_nwr_id_t id;
+  // 0 for the current version
+  osm_version_t version = 0;
+
+  bool operator==(const item &) const = default;
+};
+
+struct changes {
+  std::vector<item> items;
+  std::vector<bbox> areas;
+
+  [[nodiscard]] bool empty() const { return items.empty() && areas.empty(); }
+  bool operator==(const changes &) const = default;
+};
+
+// payloads listing all changes, each short enough for NOTIFY
+[[nodiscard]] std::vector<std::string> payloads(const changes &c);
+
+// changes listed in a payload, skipping any which can't be parsed
+[[nodiscard]] changes parse(std::string_view payload);
+
+// elements created, modified or deleted by an upload, and the area they
+// are in as computed for the changeset's bounding box
+[[nodiscard]] changes changed_by(const api06::OSMChange_Tracking &tracking,
+                                 const bbox_t &bounds);
+
+} // namespace cache_invalidation
+
+#endif /* CACHE_INVALIDATION_HPP */
@@ -0,0 +1,135 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef CACHE_STORE_HPP
+#define CACHE_STORE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <libmemcached/memcached.h>
+
+/**
+ * Key value store for the caches of cgimap. Values may be evicted at any
+ * time, so a missing value never means more than a cache miss.
+ */
+class cache_store {
+public:
+  virtual ~cache_store() = default;
+
+  [[nodiscard]] virtual std::optional<std::string> get(std::string_view key) = 0;
+
+  // stores the value for at most ttl
+  virtual void put(std::string_view key, std::string_view value, std::chrono::seconds ttl) = 0;
+
+  virtual void erase(std::string_view key) = 0;
+};
+
+/**
+ * Cache in the memory of the process. Once the keys and values exceed
+ * max_bytes, the least recently used entries are evicted.
+ */
+class lru_cache_store : public cache_store {
+public:
+  explicit lru_cache_store(std::size_t max_bytes);
+  ~lru_cache_store() override = default;
+
+  [[nodiscard]] std::optional<std::string> get(std::string_view key) override;
+  void put(std::string_view key, std::string_view value, std::chrono::seconds ttl) override;
+  void erase(std::string_view key) override;
+
+  // size of the keys and values currently stored
+  [[nodiscard]] std::size_t bytes() const;
+
+private:
+  struct entry {
+    std::string key;
+    std::string value;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  using list_t = std::list<entry>;
+
+  void erase_entry(list_t::iterator itr);
+
+  std::size_t m_max_bytes;
+  std::size_t m_bytes = 0;
+  mutable std::mutex m_mutex;
+  // most recently used first
+  list_t m_entries;
+  std::unordered_map<std::string_view, list_t::iterator, string_hash, std::equal_to<>> m_index;
+};
+
+/**
+ * Cache in memcached, shared by all hosts using the same servers. Keys are
+ * prefixed with "cgimap:".
+ *
+ * A memcached_st must not be used by several threads at the same time, so
+ * each call borrows a client of its own, which is cloned from the one
+ * created with the store when no other is idle. There are thus at most as
+ * many clients as threads using the store at the same time.
+ */
+class memcached_cache_store : public cache_store {
+public:
+  explicit memcached_cache_store(const std::string &servers);
+  ~memcached_cache_store() override;
+
+  memcached_cache_store(const memcached_cache_store &) = delete;
+  memcached_cache_store &operator=(const memcached_cache_store &) = delete;
+
+  [[nodiscard]] std::optional<std::string> get(std::string_view key) override;
+  void put(std::string_view key, std::string_view value, std::chrono::seconds ttl) override;
+  void erase(std::string_view key) override;
+
+private:
+  // a client borrowed for the lifetime of the object
+  class client {
+  public:
+    explicit client(memcached_cache_store &store);
+    ~client();
+
+    client(const client &) = delete;
+    client &operator=(const client &) = delete;
+
+    [[nodiscard]] memcached_st *get() const { return m_ptr; }
+
+  private:
+    memcached_cache_store &m_store;
+    memcached_st *m_ptr;
+  };
+
+  // configured with the servers, only used for cloning clients
+  memcached_st *m_ptr = nullptr;
+  std::mutex m_mutex;
+  // clients not borrowed at the moment
+  std::vector<memcached_st *> m_idle;
+};
+
+// the store selected with --selection-cache, nullptr if caching is disabled.
+// shared is the cache shared by all daemon instances, if there is one.
+std::shared_ptr<cache_store> create_cache_store(const boost::program_options::variables_map &options,
+                                                cache_store *shared);
+
+#endif /* CACHE_STORE_HPP */
@@ -0,0 +1,213 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef CACHING_DATA_SELECTION_HPP
+#define CACHING_DATA_SELECTION_HPP
+
+#include "cgimap/cache_invalidation.hpp"
+#include "cgimap/cache_store.hpp"
+#include "cgimap/data_selection.hpp"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+/**
+ * Read-through cache in front of any data selection, for the data which
+ * doesn't change once it exists:
+ *
+ *  - historic element versions selected with select_historical_*,
+ *  - changesets which are closed,
+ *  - and, for a short time, the visibility of current elements.
+ *
+ * Lookups of a single current element which doesn't exist are answered
+ * without asking the wrapped selection, if the element was found not to
+ * exist before with an id below the highest id of its type. The highest
+ * id is cached for as long as the visibility. Ids above it look it up
+ * again, which is cheaper than selecting the element, and are answered
+ * as missing if they are still above it. This keeps clients asking for
+ * elements which never existed away from the database, while elements
+ * created since are found right away.
+ *
+ * Cached versions and changesets aren't selected in the wrapped selection,
+ * they are written from the cache along with the ones the wrapped
+ * selection writes. Everything else is passed through.
+ *
+ * Redacting a version or commenting on a changeset does change them, the
+ * cached copies are only replaced once they expire, unless they are
+ * invalidated earlier. Versions selected while redactions are visible are
+ * never cached.
+ *
+ * Optionally, the current data returned by map calls is cached for the
+ * cells of a fixed grid. Each cell holds what a map call for the whole
+ * cell returns, selected in a separate selection. As the map call's
+ * selections only ever add the parents and members of what is selected,
+ * the result for a smaller bounding box is contained in the results of
+ * the cells it overlaps, and is found by applying the same selections to
+ * the cells' elements. Cells are erased when data in their area changes;
+ * changes without a known area, such as to relations with only relation
+ * members, show up once the cells expire.
+ */
+class caching_data_selection : public data_selection {
+public:
+  struct settings {
+    // historic versions and closed changesets
+    std::chrono::seconds ttl{3600};
+    // cache historic versions, which is only safe if redactions drop them
+    // from the cache through cache invalidation
+    bool history = false;
+    // cache closed changesets, which is only safe if comments drop them
+    // from the cache through cache invalidation, as their discussion and
+    // comment count still change
+    bool changesets = false;
+    // visibility of current elements and the highest element ids, 0 to
+    // not cache them
+    std::chrono::seconds visibility_ttl{10};
+    // edge length in degrees of the cells caching map calls, 0 to not
+    // cache them
+    double map_cell_size = 0;
+    std::chrono::seconds map_ttl{300};
+  };
+
+  // make_selection returns the selections map cells are filled with,
+  // which should use the same transaction as selection
+  caching_data_selection(std::unique_ptr<data_selection> selection, cache_store &cache,
+                         settings s,
+                         std::function<std::unique_ptr<data_selection>()> make_selection = {});
+  ~caching_data_selection() override;
+
+  void write_nodes(output_formatter &formatter) override;
+  void write_ways(output_formatter &formatter) override;
+  void write_relations(output_formatter &formatter) override;
+  void write_changesets(output_formatter &formatter, const std::chrono::system_clock::time_point &now) override;
+
+  visibility_t check_node_visibility(osm_nwr_id_t id) override;
+  visibility_t check_way_visibility(osm_nwr_id_t id) override;
+  visibility_t check_relation_visibility(osm_nwr_id_t id) override;
+  std::optional<osm_nwr_id_t> max_element_id(element_type type) override;
+
+  int select_nodes(const std::vector<osm_nwr_id_t> &) override;
+  int select_ways(const std::vector<osm_nwr_id_t> &) override;
+  int select_relations(const std::vector<osm_nwr_id_t> &) override;
+  int select_nodes_from_bbox(const bbox &bounds, int max_nodes) override;
+  void select_nodes_from_relations() override;
+  void select_ways_from_nodes() override;
+  void select_ways_from_relations() override;
+  void select_relations_from_ways() override;
+  void select_nodes_from_way_nodes() override;
+  void select_relations_from_nodes() override;
+  void select_relations_from_relations(bool drop_relations = false) override;
+  void select_relations_members_of_relations() override;
+
+  int select_changesets(const std::vector<osm_changeset_id_t> &) override;
+  void select_changeset_discussions() override;
+
+  void drop_nodes() override;
+  void drop_ways() override;
+  void drop_relations() override;
+
+  int select_historical_nodes(const std::vector<osm_edition_t> &) override;
+  int select_historical_ways(const std::vector<osm_edition_t> &) override;
+  int select_historical_relations(const std::vector<osm_edition_t> &) override;
+  int select_nodes_with_history(const std::vector<osm_nwr_id_t> &) override;
+  int select_ways_with_history(const std::vector<osm_nwr_id_t> &) override;
+  int select_relations_with_history(const std::vector<osm_nwr_id_t> &) override;
+  void set_redactions_visible(bool) override;
+  int select_historical_by_changesets(const std::vector<osm_changeset_id_t> &) override;
+
+  bool supports_user_details() const override;
+  bool is_user_blocked(const osm_user_id_t) override;
+  std::set< osm_user_role_t > get_roles_for_user(osm_user_id_t id) override;
+  std::optional< osm_user_id_t > get_user_id_for_oauth2_token(
+      const std::string &token_id, bool &expired, bool &revoked,
+      bool &allow_api_write) override;
+  bool is_user_active(const osm_user_id_t id) override;
+
+  std::optional<std::chrono::system_clock::time_point> data_timestamp() const override;
+
+  // drops the cached copies of changed data, see cache_invalidation
+  static void invalidate(cache_store &cache, const settings &s,
+                         const cache_invalidation::changes &changes);
+
+  /**
+   * wraps the selections of another factory, all sharing the same cache.
+   */
+  class factory : public data_selection::factory {
+  public:
+    factory(std::unique_ptr<data_selection::factory> factory,
+            std::shared_ptr<cache_store> cache, settings s);
+    ~factory() override = default;
+    std::unique_ptr<data_selection> make_selection(Transaction_Owner_Base&) const override;
+    std::unique_ptr<Transaction_Owner_Base> get_default_transaction() override;
+
+  private:
+    std::unique_ptr<data_selection::factory> m_factory;
+    std::shared_ptr<cache_store> m_cache;
+    settings m_settings;
+  };
+
+private:
+  // result of a map call, assembled from cached cells
+  struct map_selection;
+
+  // historic versions of one element type
+  struct historic_versions {
+    element_type type;
+    // serialized versions found in the cache
+    std::map<osm_edition_t, std::string> cached;
+    // versions selected in the wrapped selection, which are cached once
+    // they are written
+    std::set<osm_edition_t> uncached;
+  };
+
+  int select_historical(historic_versions &versions, const std::vector<osm_edition_t> &eds,
+                        int (data_selection::*select)(const std::vector<osm_edition_t> &));
+  void write_elements(historic_versions &versions, output_formatter &formatter,
+                      void (data_selection::*write)(output_formatter &));
+  visibility_t check_visibility(element_type type, osm_nwr_id_t id,
+                                visibility_t (data_selection::*check)(osm_nwr_id_t));
+  std::optional<visibility_t> cached_visibility(element_type type, osm_nwr_id_t id);
+  int select_current(element_type type, const std::vector<osm_nwr_id_t> &ids,
+                     int (data_selection::*select)(const std::vector<osm_nwr_id_t> &),
+                     visibility_t (data_selection::*check)(osm_nwr_id_t));
+  // true if the element is known not to exist without asking the wrapped
+  // selection
+  bool known_absent(element_type type, osm_nwr_id_t id);
+  // the cached highest id of the type, which is nullopt itself if the
+  // wrapped selection doesn't know it. nullopt if it isn't cached.
+  std::optional<std::optional<osm_nwr_id_t>> cached_highest_id(element_type type);
+  // looks up the highest id of the type in the wrapped selection, and
+  // caches it
+  std::optional<osm_nwr_id_t> lookup_highest_id(element_type type);
+  // nullptr if the map call can't be answered from cached cells
+  std::unique_ptr<map_selection> select_map(const bbox &bounds, int max_nodes);
+
+  std::unique_ptr<data_selection> m_selection;
+  cache_store &m_cache;
+  settings m_settings;
+  std::function<std::unique_ptr<data_selection>()> m_make_selection;
+  std::unique_ptr<map_selection> m_map;
+
+  bool m_redactions_visible = false;
+  bool m_include_discussions = false;
+
+  historic_versions m_nodes{element_type::node, {}, {}};
+  historic_versions m_ways{element_type::way, {}, {}};
+  historic_versions m_relations{element_type::relation, {}, {}};
+
+  // serialized changesets found in the cache, and the ones selected in the
+  // wrapped selection
+  std::map<osm_changeset_id_t, std::string> m_cached_changesets;
+  std::set<osm_changeset_id_t> m_uncached_changesets;
+};
+
+#endif /* CACHING_DATA_SELECTION_HPP */
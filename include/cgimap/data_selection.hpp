@@ -15,6 +15,7 @@
 
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <set>
 #include <vector>
 #include <string>
@@ -66,6 +67,10 @@ public:
   // check if the relation is visible, deleted or has never existed
   virtual visibility_t check_relation_visibility(osm_nwr_id_t id) = 0;
 
+  // highest id of any current node, way or relation, so that elements
+  // with higher ids don't exist. empty if it isn't known.
+  virtual std::optional<osm_nwr_id_t> max_element_id(element_type) { return {}; }
+
   /******************* manipulation functions ******************/
 
   /// select the nodes in the vector, returning the number of nodes
@@ -181,6 +186,13 @@ public:
   // is user status confirmed or active?
   virtual bool is_user_active(const osm_user_id_t) = 0;
 
+  /// time up to which the data is known to be complete, for selections
+  /// which serve a replicated copy of the database. empty if the data is
+  /// always up to date.
+  virtual std::optional<std::chrono::system_clock::time_point> data_timestamp() const {
+    return {};
+  }
+
   /**
    * factory for the creation of data selections. this abstracts away
    * the creation process of transactions, and allows some up-front
@@ -10,6 +10,7 @@
 #ifndef DATA_UPDATE_HPP
 #define DATA_UPDATE_HPP
 
+#include "cgimap/cache_invalidation.hpp"
 #include "cgimap/types.hpp"
 
 #include "cgimap/api06/changeset_upload/changeset_updater.hpp"
@@ -51,6 +52,9 @@ public:
   virtual std::unique_ptr<api06::Relation_Updater>
   get_relation_updater(const RequestContext& ctx, api06::OSMChange_Tracking &ct) = 0;
 
+  // tells caches about the changes, once they are committed
+  virtual void notify_changes(const cache_invalidation::changes &changes) = 0;
+
   virtual void
   commit() = 0;
 
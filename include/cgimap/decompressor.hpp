@@ -0,0 +1,61 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef DECOMPRESSOR_HPP
+#define DECOMPRESSOR_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * Streaming decompression of HTTP request bodies according to their
+ * Content-Encoding.
+ */
+class Decompressor {
+public:
+  Decompressor() = default;
+  virtual ~Decompressor() = default;
+
+  Decompressor(const Decompressor&) = delete;
+  Decompressor& operator=(const Decompressor&) = delete;
+  Decompressor(Decompressor&&) = delete;
+  Decompressor& operator=(Decompressor&&) = delete;
+
+  /**
+   * Decompresses the next chunk of input and appends the result to output.
+   * Call repeatedly with consecutive chunks of the request body. Data is
+   * written straight into output, without any intermediate buffers.
+   *
+   * Decompression stops as soon as output holds max_output bytes, so that
+   * a small, highly compressed body can't be inflated beyond that size.
+   * Callers pass one byte more than they accept to detect an oversized
+   * payload.
+   *
+   * Throws std::runtime_error, if input is not valid for this encoding.
+   */
+  virtual void decompress(std::string_view input, std::string& output,
+                          std::size_t max_output) = 0;
+
+protected:
+  /**
+   * Extends output by at least min_size bytes of writable space and returns
+   * a pointer to it. Callers shrink output again to the number of bytes
+   * actually written. Capacity grows geometrically.
+   */
+  static char* grow_output(std::string& output, std::size_t min_size);
+};
+
+class IdentityDecompressor : public Decompressor {
+public:
+  void decompress(std::string_view input, std::string& output,
+                  std::size_t max_output) override;
+};
+
+#endif /* DECOMPRESSOR_HPP */
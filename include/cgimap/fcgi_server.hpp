@@ -0,0 +1,56 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef FCGI_SERVER_HPP
+#define FCGI_SERVER_HPP
+
+#include "cgimap/request.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+/**
+ * Event driven FastCGI front end, as an alternative to fcgi_request,
+ * which blocks in libfcgi and handles a single request at a time.
+ *
+ * One thread accepts connections on the listening socket and reads and
+ * writes all of them through epoll, with nonblocking sockets. It parses
+ * the FastCGI records itself, so that connections can be kept open by
+ * the web server across requests, and can carry several requests at
+ * the same time. Requests are handed to a pool of worker threads once
+ * their parameters and body have been received completely. Responses
+ * are queued as the workers write them and sent as fast as the web
+ * server accepts them, so that a slow client doesn't hold up a worker.
+ * Once a megabyte is queued on a connection, workers writing to it wait
+ * for the web server to catch up, so that memory use stays bounded.
+ */
+class fcgi_server {
+public:
+  using handler = std::function<void(request &)>;
+  // called once for each worker thread, to set up the state it needs
+  // for processing requests, e.g. its own database connections
+  using handler_factory = std::function<handler()>;
+
+  fcgi_server(int socket, std::size_t workers, const handler_factory &make_handler);
+  ~fcgi_server();
+
+  fcgi_server(const fcgi_server &) = delete;
+  fcgi_server &operator=(const fcgi_server &) = delete;
+
+  // serve requests until proceed, called at least once a second, returns
+  // false. requests received by then are completed before returning.
+  void run(const std::function<bool()> &proceed);
+
+private:
+  struct impl;
+  std::unique_ptr<impl> m_impl;
+};
+
+#endif /* FCGI_SERVER_HPP */
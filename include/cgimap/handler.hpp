@@ -29,6 +29,12 @@ class responder {
 public:
   explicit responder(mime::type);
   virtual ~responder() = default;
+
+  // called before the response header is sent. Responders which fetch all
+  // of their data before writing any of it do so here, so that errors such
+  // as exceeding the request memory limit still get their own status code.
+  virtual void prepare() {}
+
   virtual void write(output_formatter& f,
                      const std::string &generator,
                      const std::chrono::system_clock::time_point &now) = 0;
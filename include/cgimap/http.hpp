@@ -23,6 +23,7 @@
 #include "cgimap/brotli.hpp"
 #endif
 
+#include "cgimap/decompressor.hpp"
 #include "cgimap/output_buffer.hpp"
 
 /**
@@ -314,7 +315,7 @@ public:
  */
 std::unique_ptr<http::encoding> choose_encoding(const std::string &accept_encoding);
 
-std::unique_ptr<ZLibBaseDecompressor> get_content_encoding_handler(std::string_view content_encoding);
+std::unique_ptr<Decompressor> get_content_encoding_handler(std::string_view content_encoding);
 
 
 
@@ -10,23 +10,67 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include <optional>
 #include <string>
 #include <string_view>
 
 /**
  * Contains support for logging.
+ *
+ * Messages are queued in a lock-free ring buffer, and written to the log
+ * file in batches by a background thread. Should the queue fill up, the
+ * thread logging a message drains the queue itself.
  */
 namespace logger {
 
+enum class level {
+  debug,
+  info,
+  warning,
+  error
+};
+
+enum class format {
+  text,  // [timestamp #pid] message
+  json   // one JSON object per line
+};
+
+/**
+ * Initialise logging, replacing any previous log file after writing all
+ * pending messages. An empty filename disables logging, as does a file
+ * which can't be opened. Threads may log concurrently with reinitialising.
+ *
+ * Messages are written by a background thread, unless background is
+ * false, in which case they are written right away. As the background
+ * thread doesn't survive a fork, a process forking children has to log
+ * without it, and the children have to call this again.
+ */
+void initialise(const std::string &filename = "",
+                level min_level = level::info,
+                format output = format::text,
+                bool background = true);
+
 /**
- * Initialise logging.
+ * Whether messages of the given level are written to the log file. Use
+ * this to avoid formatting messages which would be discarded anyway.
  */
-void initialise(const std::string &filename = "");
+[[nodiscard]] bool enabled(level l) noexcept;
 
 /**
  * Log a message.
  */
 void message(std::string_view m) noexcept;
+
+void message(level l, std::string_view m) noexcept;
+
+/**
+ * Write all pending messages to the log file.
+ */
+void flush() noexcept;
+
+[[nodiscard]] std::optional<level> parse_level(std::string_view s);
+
+[[nodiscard]] std::optional<format> parse_format(std::string_view s);
 }
 
 #endif /* LOGGER_HPP */
@@ -0,0 +1,116 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/types.h>
+
+/**
+ * Contains support for collecting metrics, and exposing them in the
+ * Prometheus text format.
+ *
+ * All metrics are kept in shared memory, so that the numbers reported
+ * include all daemon instances. As long as metrics haven't been
+ * initialised, recording metrics doesn't do anything.
+ */
+namespace metrics {
+
+/**
+ * Set up the metrics registry. This has to be called before forking the
+ * daemon instances. Once the registry is full, new series are dropped.
+ */
+void initialise(std::size_t max_series = 4096);
+
+/**
+ * Request count and latency by route, see route_name.
+ */
+void observe_request(std::string_view route, int status,
+                     std::chrono::steady_clock::duration elapsed);
+
+/**
+ * Execution time of a prepared statement, or of a COMMIT.
+ */
+void observe_statement(std::string_view statement,
+                       std::chrono::steady_clock::duration elapsed);
+
+/**
+ * Response body size before and after applying the content encoding.
+ */
+void add_response_bytes(std::string_view encoding, std::size_t uncompressed,
+                        std::size_t encoded);
+
+/**
+ * Request rejected by the rate limiter.
+ */
+void count_rate_limited();
+
+/**
+ * Lookup in one of the caches, identified by name.
+ */
+void count_cache_lookup(std::string_view cache, bool hit);
+
+/**
+ * Entry of a cache replaced before it expired, to make room for another.
+ */
+void count_cache_eviction(std::string_view cache);
+
+/**
+ * Age of a cache entry when it was used, i.e. for how long it may have
+ * been stale.
+ */
+void observe_cache_age(std::string_view cache, std::chrono::seconds age);
+
+/**
+ * Route name for a handler's log_name, without any request specific
+ * details like ids or bounding boxes.
+ */
+[[nodiscard]] std::string_view route_name(std::string_view log_name);
+
+/**
+ * Current state of all metrics in the Prometheus text exposition format.
+ */
+[[nodiscard]] std::string render();
+
+/**
+ * Minimal HTTP server answering GET /metrics requests on a separate
+ * socket, in a background thread. The address is given as host:port, with
+ * the host defaulting to 127.0.0.1.
+ */
+class server {
+public:
+  explicit server(const std::string &address);
+  ~server();
+
+  server(const server &) = delete;
+  server &operator=(const server &) = delete;
+
+  // port the server is listening on
+  [[nodiscard]] int port() const;
+
+private:
+  void run(std::stop_token stop);
+
+  int m_socket = -1;
+  // the thread only exists in the process which started the server, not
+  // in forked daemon instances
+  pid_t m_owner;
+  std::unique_ptr<std::jthread> m_thread;
+};
+
+} // namespace metrics
+
+#endif /* METRICS_HPP */
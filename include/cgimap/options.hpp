@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <optional>
+#include <set>
 #include <string>
 #include <cstdint>
 
@@ -38,6 +39,8 @@ public:
   [[nodiscard]] virtual uint32_t get_ratelimiter_maxdebt(bool) const = 0;
   [[nodiscard]] virtual bool get_ratelimiter_upload() const = 0;
   [[nodiscard]] virtual bool get_bbox_size_limiter_upload() const = 0;
+  [[nodiscard]] virtual const std::set<std::string>& get_server_timing_clients() const = 0;
+  [[nodiscard]] virtual std::optional<uint64_t> get_request_memory_max() const = 0;
 };
 
 class global_settings_default : public global_settings_base {
@@ -104,6 +107,15 @@ public:
   [[nodiscard]] bool get_bbox_size_limiter_upload() const override {
     return false;
   }
+
+  [[nodiscard]] const std::set<std::string>& get_server_timing_clients() const override {
+    static const std::set<std::string> none{};
+    return none;
+  }
+
+  [[nodiscard]] std::optional<uint64_t> get_request_memory_max() const override {
+    return {};  // default: unlimited
+  }
 };
 
 class global_settings_via_options : public global_settings_base {
@@ -186,6 +198,14 @@ public:
     return m_bbox_size_limiter_upload;
   }
 
+  [[nodiscard]] const std::set<std::string>& get_server_timing_clients() const override {
+    return m_server_timing_clients;
+  }
+
+  [[nodiscard]] std::optional<uint64_t> get_request_memory_max() const override {
+    return m_request_memory_max;
+  }
+
 private:
   void init_fallback_values(const global_settings_base &def);
   void set_new_options(const po::variables_map &options);
@@ -203,6 +223,8 @@ private:
   void set_ratelimiter_maxdebt(const po::variables_map &options);
   void set_ratelimiter_upload(const po::variables_map &options);
   void set_bbox_size_limiter_upload(const po::variables_map &options);
+  void set_server_timing_clients(const po::variables_map &options);
+  void set_request_memory_max(const po::variables_map &options);
   bool validate_timeout(const std::string &timeout) const;
 
   uint32_t m_payload_max_size;
@@ -221,6 +243,8 @@ private:
   uint32_t m_moderator_ratelimiter_maxdebt;
   bool m_ratelimiter_upload;
   bool m_bbox_size_limiter_upload;
+  std::set<std::string> m_server_timing_clients;
+  std::optional<uint64_t> m_request_memory_max;
 };
 
 class global_settings final {
@@ -272,6 +296,12 @@ public:
   // Use bbox size limiter for changeset uploads
   static bool get_bbox_size_limiter_upload() { return settings->get_bbox_size_limiter_upload(); }
 
+  // Client addresses which receive a Server-Timing header
+  static const std::set<std::string>& get_server_timing_clients() { return settings->get_server_timing_clients(); }
+
+  // Maximum number of bytes allocated while processing a single request (may be unlimited)
+  static std::optional<uint64_t> get_request_memory_max() { return settings->get_request_memory_max(); }
+
 private:
   static std::unique_ptr<global_settings_base> settings;  // gets initialized with global_settings_default instance
 };
@@ -12,6 +12,9 @@
 
 #include "cgimap/osm_responder.hpp"
 
+#include <exception>
+#include <memory>
+
 class data_selection;
 
 /**
@@ -24,14 +27,17 @@ public:
   // optional bounds are stored at this level, but available to derived classes.
   osmchange_responder(mime::type, data_selection &s);
 
-  ~osmchange_responder() override = default;
+  ~osmchange_responder() override;
 
   // lists the standard types that OSM format can respond in, currently only XML,
   // as the osmChange format is undefined for JSON
   std::vector<mime::type> types_available() const override;
 
-  // takes the stuff in the tmp_nodes/ways/relations tables and sorts them by
-  // timestamp, then wraps them in <create>/<modify>/<delete> to create an
+  // fetches the selected elements and sorts them by timestamp, before the
+  // response header is sent.
+  void prepare() override;
+
+  // wraps the sorted elements in <create>/<modify>/<delete> to create an
   // approximation of a diff. the reliance on timestamp means it's entirely
   // likely that some documents may be poorly formed.
   void write(output_formatter& f,
@@ -41,6 +47,13 @@ public:
 protected:
   // selection of elements to be written out
   data_selection& sel;
+
+private:
+  struct sorting_formatter;
+
+  // elements fetched by prepare(), or the error which occurred doing so
+  std::unique_ptr<sorting_formatter> sorter;
+  std::exception_ptr error;
 };
 
 #endif /* OSMCHANGE_RESPONDER_HPP */
@@ -0,0 +1,85 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef RATE_LIMIT_TABLE_HPP
+#define RATE_LIMIT_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+/**
+ * Fixed size hash table of rate limiting state, placed in an anonymous
+ * shared memory mapping. Creating the table before forking the daemon
+ * instances makes the same state visible to all processes on the host.
+ *
+ * Each entry keeps the number of bytes served to a client (decaying at the
+ * client's rate limit), and the number of bytes which haven't been
+ * reported to memcached yet. Keys are hashed to buckets of a few entries,
+ * each protected by a spin lock which is only ever held for a few
+ * instructions. A lock held by a process which died is taken over.
+ *
+ * When a bucket is full, its least recently updated entry is replaced.
+ */
+class rate_limit_table {
+public:
+  // longest client key stored in the table, longer keys are truncated
+  static constexpr std::size_t max_key_length = 63;
+
+  explicit rate_limit_table(std::size_t entries);
+  ~rate_limit_table();
+
+  rate_limit_table(const rate_limit_table &) = delete;
+  rate_limit_table &operator=(const rate_limit_table &) = delete;
+  rate_limit_table(rate_limit_table &&) = delete;
+  rate_limit_table &operator=(rate_limit_table &&) = delete;
+
+  // number of bytes served to key, decayed until now. Returns 0 for unknown keys.
+  [[nodiscard]] uint32_t bytes_served(std::string_view key, time_t now,
+                                      uint32_t bytes_per_sec);
+
+  // record that bytes were served to key. The bytes are also added to the
+  // entry's pending bytes, which are waiting to be reported to memcached.
+  void add(std::string_view key, time_t now, uint32_t bytes,
+           uint32_t bytes_per_sec);
+
+  // remove and return the pending bytes for key
+  [[nodiscard]] uint32_t take_pending(std::string_view key);
+
+  // return pending bytes, which couldn't be reported to memcached
+  void restore_pending(std::string_view key, uint32_t bytes);
+
+  // merge the decayed number of bytes served according to memcached, which
+  // includes the usage of all hosts. The pending bytes, which memcached
+  // doesn't know about yet, are added on top.
+  void merge(std::string_view key, time_t now, uint32_t global_bytes_served,
+             uint32_t bytes_per_sec);
+
+  // total number of entries in the table
+  [[nodiscard]] std::size_t size() const;
+
+  // number of bytes still left to be served at time now, given bytes_served
+  // at time last_update
+  [[nodiscard]] static uint32_t decay(uint32_t bytes_served, time_t last_update,
+                                      time_t now, uint32_t bytes_per_sec);
+
+private:
+  struct entry;
+  struct bucket;
+  class bucket_lock;
+
+  bucket &bucket_for(std::string_view key) const;
+
+  bucket *m_buckets = nullptr;
+  std::size_t m_bucket_count = 0;
+  std::size_t m_mapping_size = 0;
+};
+
+#endif /* RATE_LIMIT_TABLE_HPP */
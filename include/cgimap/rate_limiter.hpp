@@ -10,11 +10,19 @@
 #ifndef RATE_LIMITER_HPP
 #define RATE_LIMITER_HPP
 
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <libmemcached/memcached.h>
 #include <boost/program_options.hpp>
 
+#include "cgimap/rate_limit_table.hpp"
+
 struct rate_limiter {
   virtual ~rate_limiter() = default;
 
@@ -32,20 +40,45 @@ struct null_rate_limiter : public rate_limiter {
   void update(const std::string &key, uint32_t bytes, bool moderator) override;
 };
 
-class memcached_rate_limiter : public rate_limiter {
+/**
+ * Rate limiter keeping its state in a rate_limit_table shared by all
+ * processes on the host, so that checking and updating limits never
+ * involves a network round trip.
+ *
+ * If a memcache server is configured, a background thread periodically
+ * reports the bytes served by this process to memcached and fetches the
+ * usage of other hosts, in one batch for all recently seen clients.
+ * Updates in memcached use CAS, so concurrent updates from several hosts
+ * don't get lost.
+ */
+class shm_rate_limiter : public rate_limiter {
 public:
-  /**
-   * Methods.
-   */
-  explicit memcached_rate_limiter(const boost::program_options::variables_map &options);
-  ~memcached_rate_limiter() override;
+  shm_rate_limiter(rate_limit_table &table,
+                   const boost::program_options::variables_map &options);
+  ~shm_rate_limiter() override;
   std::tuple<bool, int> check(const std::string &key, bool moderator) override;
   void update(const std::string &key, uint32_t bytes, bool moderator) override;
 
+  // exchange state with memcached for all clients seen since the last call
+  void reconcile();
+
 private:
+  struct pending_update;
+
+  void mark_dirty(const std::string &key, bool moderator);
+  std::vector<pending_update> reconcile_batch(std::vector<pending_update> batch);
+  void reconcile_loop(std::stop_token stop);
+
+  rate_limit_table &table;
   memcached_st *ptr = nullptr;
 
-  struct state;
+  std::mutex mutex;
+  std::condition_variable_any cv;
+  // clients seen by this process since the last reconciliation, along with
+  // their moderator flag
+  std::unordered_map<std::string, bool> dirty_keys;
+
+  std::jthread reconciler;
 };
 
 #endif
@@ -56,6 +56,9 @@ struct request {
   // first call to any of the output functions.
   request& status(int code);
 
+  // get the status set for the response so far.
+  int response_status() const { return m_status; }
+
   // add a key-value header to the response. there may be some pre-existing
   // headers which are set by the output system, and some (e.g: CORS headers)
   // which are on by default for CGImap. it is an error to call this function
@@ -0,0 +1,104 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef REQUEST_CAPTURE_HPP
+#define REQUEST_CAPTURE_HPP
+
+#include "cgimap/request.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * Captures a sample of the requests served, so that production traffic
+ * can be replayed against a test database later on.
+ *
+ * Only what is needed to replay a request is kept: method, path, query
+ * string, the headers affecting the response, and the status and latency
+ * of the original response. Credentials, cookies and payloads are never
+ * written, authenticated requests are merely flagged as such.
+ *
+ * The capture file starts with the 8 byte magic "CGIMAPRQ" and a 32 bit
+ * format version, followed by the records. Each record is a 32 bit length
+ * of the rest of the record, the request time in microseconds since the
+ * epoch (64 bit), the duration in microseconds (32 bit), the status (16
+ * bit), flags (8 bit), and the method, route, path, query, Accept,
+ * Accept-Encoding and X-Error-Format as strings with a 16 bit length.
+ * All integers are little endian.
+ *
+ * Every record is appended with a single write, so that all processes
+ * of a daemon can share the file.
+ */
+namespace request_capture {
+
+constexpr uint32_t format_version = 1;
+
+struct record {
+  std::chrono::system_clock::time_point time;
+  std::chrono::microseconds duration{0};
+  uint16_t status = 0;
+  bool authenticated = false;
+  std::string method;
+  std::string route;
+  std::string path;
+  std::string query;
+  std::string accept;
+  std::string accept_encoding;
+  std::string error_format;
+
+  bool operator==(const record &) const = default;
+};
+
+/**
+ * Start capturing a share of sample_rate (0 to 1) of all requests to the
+ * given file, which is created if needed. An empty filename disables
+ * capturing. Call this before forking, the file is shared by all
+ * processes.
+ */
+void initialise(const std::string &filename = "", double sample_rate = 1.0);
+
+[[nodiscard]] bool enabled() noexcept;
+
+/**
+ * Capture the answered request, if it is part of the sample.
+ */
+void capture(const request &req, std::string_view route,
+             std::chrono::steady_clock::duration elapsed) noexcept;
+
+[[nodiscard]] record make_record(const request &req, std::string_view route,
+                                 std::chrono::steady_clock::duration elapsed);
+
+[[nodiscard]] std::string encode(const record &r);
+
+[[nodiscard]] std::string file_header();
+
+/**
+ * Reads a capture file, record by record.
+ */
+class reader {
+public:
+  explicit reader(const std::string &filename);
+
+  /**
+   * The next record, if any. A truncated record at the end of the file,
+   * as left behind by a process being killed, ends the file.
+   */
+  [[nodiscard]] std::optional<record> next();
+
+private:
+  std::ifstream m_in;
+};
+
+} // namespace request_capture
+
+#endif /* REQUEST_CAPTURE_HPP */
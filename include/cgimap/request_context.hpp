@@ -10,6 +10,8 @@
 #ifndef REQUEST_CONTEXT_HPP
 #define REQUEST_CONTEXT_HPP
 
+#include "cgimap/request_memory.hpp"
+#include "cgimap/request_timing.hpp"
 #include "cgimap/types.hpp"
 
 #include <optional>
@@ -29,6 +31,8 @@ struct RequestContext
 {
     request& req;
     std::optional<UserInfo> user = {};
+    request_timing timing = {};
+    request_memory memory = {};
 
     bool is_moderator() const { return user && user->has_role(osm_user_role_t::moderator); }
 };
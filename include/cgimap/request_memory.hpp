@@ -0,0 +1,80 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef REQUEST_MEMORY_HPP
+#define REQUEST_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * Accounting of the memory allocated while processing a request.
+ *
+ * The replacement operator new and delete in request_memory_hooks.cpp
+ * report all allocations of the thread to the request currently processed
+ * by it, if any. Memory allocated by C libraries via malloc, such as
+ * libpq's query results, isn't included.
+ *
+ * Exceeding the limit doesn't make allocations fail. Instead, check() is
+ * called at points where the request can be aborted safely, e.g. after
+ * each database statement, and throws once the limit has been exceeded.
+ */
+class request_memory {
+public:
+  // makes a request_memory the current one for this thread, while in scope
+  class [[nodiscard]] scope {
+  public:
+    explicit scope(request_memory &memory) noexcept;
+    ~scope();
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+  private:
+    request_memory *m_previous;
+  };
+
+  request_memory() = default;
+
+  request_memory(const request_memory &) = delete;
+  request_memory &operator=(const request_memory &) = delete;
+
+  // called by the allocation hooks. Do nothing if there is no current request.
+  static void allocated(std::size_t bytes) noexcept;
+  static void released(std::size_t bytes) noexcept;
+
+  // throws http::payload_too_large if the current request has exceeded its
+  // limit. Only throws once per request, so that the error response can
+  // still be written.
+  static void check();
+
+  [[nodiscard]] static request_memory *current() noexcept;
+
+  // bytes allocated by the request and not released yet
+  [[nodiscard]] std::size_t in_use() const noexcept;
+
+  [[nodiscard]] std::size_t peak() const noexcept { return m_peak; }
+
+  // peak memory for the log file, empty if nothing was accounted
+  [[nodiscard]] std::string summary() const;
+
+  // in bytes, unlimited if not set
+  std::optional<uint64_t> limit;
+
+private:
+  // memory allocated before the request may be released during the
+  // request, so this may become negative
+  int64_t m_in_use = 0;
+  std::size_t m_peak = 0;
+  bool m_exceeded = false;
+};
+
+#endif /* REQUEST_MEMORY_HPP */
@@ -0,0 +1,118 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef REQUEST_TIMING_HPP
+#define REQUEST_TIMING_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * Breakdown of the time spent processing a request into phases.
+ *
+ * Spans may be nested, e.g. writing to the socket while compressing while
+ * serializing the response. Time is always attributed to the innermost
+ * span only, so that phases add up to the time covered by all spans.
+ *
+ * Code deep down in the call stack (database access, compression, socket
+ * writes) doesn't know about the request. It records its spans via the
+ * static functions below, which use the timing of the request currently
+ * processed by this thread, if any.
+ */
+class request_timing {
+public:
+  enum class phase : uint8_t {
+    auth,
+    ratelimit,
+    selection,
+    fetch,
+    serialize,
+    compress,
+    write
+  };
+
+  static constexpr std::size_t phase_count = 7;
+
+  using clock = std::chrono::steady_clock;
+
+  class [[nodiscard]] span {
+  public:
+    span(request_timing *timing, phase p) noexcept;
+    ~span();
+
+    span(const span &) = delete;
+    span &operator=(const span &) = delete;
+    span(span &&) = delete;
+    span &operator=(span &&) = delete;
+
+  private:
+    request_timing *m_timing;
+  };
+
+  // makes a request_timing the current one for this thread, while in scope
+  class [[nodiscard]] scope {
+  public:
+    explicit scope(request_timing &timing);
+    ~scope();
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+  private:
+    request_timing *m_previous;
+  };
+
+  request_timing();
+
+  request_timing(const request_timing &) = delete;
+  request_timing &operator=(const request_timing &) = delete;
+
+  // time a phase of the current request. Does nothing if there is none.
+  static span measure(phase p);
+
+  // time a database statement of the current request. Statements run while
+  // serializing the response fetch the data to be written, and are
+  // reported separately. Otherwise they count towards the current phase.
+  static span measure_statement();
+
+  [[nodiscard]] static request_timing *current();
+
+  [[nodiscard]] clock::duration elapsed(phase p) const;
+
+  // summary of all phases measured so far, for the log file
+  [[nodiscard]] std::string summary() const;
+
+  // value of a Server-Timing header, covering all phases measured so far
+  [[nodiscard]] std::string server_timing() const;
+
+  // whether the client should receive a Server-Timing header
+  bool send_server_timing = false;
+
+private:
+  void enter(phase p) noexcept;
+  void leave() noexcept;
+  void charge(clock::time_point now) noexcept;
+  [[nodiscard]] std::optional<phase> active() const noexcept;
+
+  static constexpr std::size_t max_depth = 8;
+
+  const clock::time_point m_start;
+  clock::time_point m_last;
+  // spans nested deeper than max_depth count towards their parent
+  std::array<phase, max_depth> m_active{};
+  std::size_t m_depth = 0;
+  std::array<clock::duration, phase_count> m_elapsed{};
+  std::array<bool, phase_count> m_measured{};
+};
+
+#endif /* REQUEST_TIMING_HPP */
@@ -0,0 +1,106 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#ifndef SHM_CACHE_HPP
+#define SHM_CACHE_HPP
+
+#include "cgimap/cache_store.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Cache placed in an anonymous shared memory mapping. Creating it before
+ * forking the daemon instances makes the same entries visible to all
+ * processes on the host, and lets them outlive the instances which
+ * stored them.
+ *
+ * The mapping is divided into slabs of slab_size bytes, which are assigned
+ * to a size class when first needed and split into slots of that class,
+ * from 256 bytes up to a whole slab. An entry, with its key and value,
+ * takes up a single slot. Once all slabs are assigned, a size class reuses
+ * its own slots, picked by the CLOCK algorithm: expired entries are reused
+ * first, entries which were read since the hand last passed them get a
+ * second chance.
+ *
+ * Keys are hashed to buckets chaining their slots, protected by a fixed
+ * number of striped spin locks. A lock records the pid of its holder, so
+ * that a lock held by an instance which died is taken over rather than
+ * blocking all the others.
+ */
+class shm_cache : public cache_store {
+public:
+  static constexpr std::size_t slab_size = 1024 * 1024;
+
+  struct statistics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    // unexpired entries replaced to make room
+    uint64_t evictions = 0;
+    // expired entries replaced
+    uint64_t expirations = 0;
+    // values not stored, being too large or lacking a slab of their size
+    uint64_t rejected = 0;
+    std::size_t slabs = 0;
+    std::size_t slabs_used = 0;
+  };
+
+  explicit shm_cache(std::size_t bytes);
+  ~shm_cache() override;
+
+  shm_cache(const shm_cache &) = delete;
+  shm_cache &operator=(const shm_cache &) = delete;
+  shm_cache(shm_cache &&) = delete;
+  shm_cache &operator=(shm_cache &&) = delete;
+
+  [[nodiscard]] std::optional<std::string> get(std::string_view key) override;
+  void put(std::string_view key, std::string_view value, std::chrono::seconds ttl) override;
+  void erase(std::string_view key) override;
+
+  // largest key and value stored together, larger ones are rejected
+  [[nodiscard]] static std::size_t max_entry_size();
+
+  [[nodiscard]] statistics stats() const;
+
+private:
+  struct header;
+  struct size_class;
+  struct slot;
+  class spin_lock;
+
+  using slot_ref = uint32_t;
+
+  slot &slot_at(slot_ref ref) const;
+  slot_ref claim(std::size_t cls, int64_t now);
+  bool grow(std::size_t cls);
+  bool unlink(slot_ref ref, slot &s);
+  // frees the entries for key, with the lock of its bucket held
+  void remove(std::size_t bucket, uint64_t hash, std::string_view key);
+  std::size_t bucket_for(uint64_t hash) const;
+  std::atomic<uint32_t> &lock_for(std::size_t bucket) const;
+
+  void *m_mapping = nullptr;
+  std::size_t m_mapping_size = 0;
+  std::size_t m_slab_count = 0;
+  std::size_t m_bucket_count = 0;
+
+  header *m_header = nullptr;
+  // slabs of each size class, in the order they were assigned
+  uint32_t *m_class_slabs = nullptr;
+  // size class of each slab
+  uint8_t *m_slab_classes = nullptr;
+  std::atomic<uint32_t> *m_locks = nullptr;
+  // first slot of each bucket, 0 if empty
+  slot_ref *m_buckets = nullptr;
+  char *m_slabs = nullptr;
+};
+
+#endif /* SHM_CACHE_HPP */
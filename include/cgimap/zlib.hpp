@@ -17,6 +17,7 @@
 const unsigned int ZLIB_COMPLETE_CHUNK = 16384;
 
 #include <zlib.h>
+#include "cgimap/decompressor.hpp"
 #include "cgimap/output_buffer.hpp"
 
 /**
@@ -63,31 +64,26 @@ private:
 
 // parts adopted from https://github.com/rudi-cilibrasi/zlibcomplete
 
-class ZLibBaseDecompressor {
+class ZLibBaseDecompressor : public Decompressor {
 public:
   /**
-  * @brief Decompression function for gzip using std::string.
+  * @brief Streaming decompression for zlib and gzip.
   *
-  * Accepts a std::string of any size containing compressed data.  Returns
-  * as much gzip uncompressed data as possible.  Call this function over
-  * and over with all the compressed data in a stream in order to decompress
-  * the entire stream.
-  * @param input Any amount of data to decompress.
-  * @retval std::string containing the decompressed data.
+  * Accepts any amount of compressed data and inflates as much as possible
+  * directly into output. Call this function over and over with all the
+  * compressed data in a stream in order to decompress the entire stream.
+  * Stops once output holds max_output bytes.
   */
-  std::string decompress(const std::string& input);
-  ~ZLibBaseDecompressor();
+  void decompress(std::string_view input, std::string& output,
+                  std::size_t max_output) override;
+  ~ZLibBaseDecompressor() override;
 
 protected:
-  ZLibBaseDecompressor() = default;
   explicit ZLibBaseDecompressor(int windowBits);
 
-
 private:
-  char inbuf[ZLIB_COMPLETE_CHUNK];
-  char outbuf[ZLIB_COMPLETE_CHUNK];
   z_stream stream{};
-  bool use_decompression{false};
+  bool stream_end{false};
 };
 
 class ZLibDecompressor : public ZLibBaseDecompressor {
@@ -100,9 +96,4 @@ public:
   GZipDecompressor();
 };
 
-class IdentityDecompressor : public ZLibBaseDecompressor {
-public:
-  IdentityDecompressor();
-};
-
 #endif /* ZLIB_HPP */
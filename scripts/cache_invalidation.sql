@@ -0,0 +1,102 @@
+-- Triggers sending cache invalidation notifications for changes which are
+-- not made by cgimap, e.g. uploads to the Rails port, changeset
+-- discussions and redactions. cgimap notifies about its own changes.
+--
+-- The channel has to match --cache-invalidation-channel. Notifications are
+-- delivered once the transaction commits, and identical ones sent in the
+-- same transaction are delivered only once.
+--
+-- Areas are notified for the map cell cache: the old and new position of
+-- changed nodes, and the bounding box of changesets, which covers all
+-- the elements changed in them.
+
+CREATE OR REPLACE FUNCTION cgimap_notify_current() RETURNS trigger AS $$
+BEGIN
+  PERFORM pg_notify('cgimap_invalidate', TG_ARGV[0] || '/' || NEW.id);
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE FUNCTION cgimap_area(min_lat bigint, min_lon bigint,
+                                       max_lat bigint, max_lon bigint) RETURNS text AS $$
+  SELECT format('area/%s,%s,%s,%s', min_lon / 10000000.0, min_lat / 10000000.0,
+                max_lon / 10000000.0, max_lat / 10000000.0);
+$$ LANGUAGE sql IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION cgimap_notify_node_area() RETURNS trigger AS $$
+BEGIN
+  PERFORM pg_notify('cgimap_invalidate',
+                    cgimap_area(NEW.latitude, NEW.longitude, NEW.latitude, NEW.longitude));
+  IF TG_OP = 'UPDATE' THEN
+    PERFORM pg_notify('cgimap_invalidate',
+                      cgimap_area(OLD.latitude, OLD.longitude, OLD.latitude, OLD.longitude));
+  END IF;
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE FUNCTION cgimap_notify_changeset_area() RETURNS trigger AS $$
+BEGIN
+  IF NEW.min_lat IS NOT NULL THEN
+    PERFORM pg_notify('cgimap_invalidate',
+                      cgimap_area(NEW.min_lat, NEW.min_lon, NEW.max_lat, NEW.max_lon));
+  END IF;
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+-- comments don't update the changeset row, but are cached with it
+CREATE OR REPLACE FUNCTION cgimap_notify_changeset_comment() RETURNS trigger AS $$
+BEGIN
+  PERFORM pg_notify('cgimap_invalidate', 'changeset/' || NEW.changeset_id);
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE FUNCTION cgimap_notify_redaction() RETURNS trigger AS $$
+BEGIN
+  PERFORM pg_notify('cgimap_invalidate',
+                    TG_ARGV[0] || '/' || (to_jsonb(NEW) ->> (TG_ARGV[0] || '_id')) || '/' || NEW.version);
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_current_nodes
+  AFTER INSERT OR UPDATE ON current_nodes
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_current('node');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_current_ways
+  AFTER INSERT OR UPDATE ON current_ways
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_current('way');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_current_relations
+  AFTER INSERT OR UPDATE ON current_relations
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_current('relation');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_changesets
+  AFTER UPDATE ON changesets
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_current('changeset');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_changeset_comments
+  AFTER INSERT OR UPDATE ON changeset_comments
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_changeset_comment();
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_node_areas
+  AFTER INSERT OR UPDATE ON current_nodes
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_node_area();
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_changeset_areas
+  AFTER UPDATE OF min_lat, min_lon, max_lat, max_lon ON changesets
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_changeset_area();
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_node_redactions
+  AFTER UPDATE OF redaction_id ON nodes
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_redaction('node');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_way_redactions
+  AFTER UPDATE OF redaction_id ON ways
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_redaction('way');
+
+CREATE OR REPLACE TRIGGER cgimap_invalidate_relation_redactions
+  AFTER UPDATE OF redaction_id ON relations
+  FOR EACH ROW EXECUTE FUNCTION cgimap_notify_redaction('relation');
@@ -29,6 +29,7 @@ changeset_close_responder::changeset_close_responder(mime::type mt,
 
   auto changeset_updater = upd.get_changeset_updater(req_ctx, changeset);
   changeset_updater->api_close_changeset();
+  upd.notify_changes({.items = {{element_type::changeset, static_cast<osm_nwr_id_t>(changeset)}}});
   upd.commit();
 }
 
@@ -35,6 +35,7 @@ changeset_update_responder::changeset_update_responder(
 
   changeset_updater->api_update_changeset(tags);
 
+  upd.notify_changes({.items = {{element_type::changeset, static_cast<osm_nwr_id_t>(changeset_id)}}});
   upd.commit();
 }
 
@@ -0,0 +1,76 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/api06/changeset_upload/lock_plan.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace api06 {
+
+namespace {
+
+void sort_unique(std::vector<osm_nwr_id_t> &ids) {
+  std::ranges::sort(ids);
+  auto new_end = std::ranges::unique(ids);
+  ids.erase(new_end.begin(), new_end.end());
+}
+
+} // anonymous namespace
+
+void Lock_Plan::add_exclusive(object_type type, osm_nwr_signed_id_t id) {
+
+  // placeholder ids refer to elements created by the same upload, which
+  // don't exist in the database yet
+  if (id <= 0)
+    return;
+
+  table(type).exclusive_ids.push_back(static_cast<osm_nwr_id_t>(id));
+}
+
+void Lock_Plan::add_shared(object_type type, osm_nwr_signed_id_t id) {
+
+  if (id <= 0)
+    return;
+
+  table(type).shared_ids.push_back(static_cast<osm_nwr_id_t>(id));
+}
+
+Lock_Plan::table_locks_t Lock_Plan::locks(object_type type) const {
+
+  auto result = table(type);
+
+  sort_unique(result.exclusive_ids);
+  sort_unique(result.shared_ids);
+
+  // an exclusive lock already covers any shared lock on the same row
+  std::erase_if(result.shared_ids, [&](osm_nwr_id_t id) {
+    return std::ranges::binary_search(result.exclusive_ids, id);
+  });
+
+  return result;
+}
+
+Lock_Plan::table_locks_t& Lock_Plan::table(object_type type) {
+  return const_cast<table_locks_t&>(std::as_const(*this).table(type));
+}
+
+const Lock_Plan::table_locks_t& Lock_Plan::table(object_type type) const {
+  switch (type) {
+  case object_type::node:
+    return m_nodes;
+  case object_type::way:
+    return m_ways;
+  case object_type::relation:
+    return m_relations;
+  }
+  return m_nodes; // unreachable
+}
+
+} // namespace api06
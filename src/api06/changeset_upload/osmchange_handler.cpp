@@ -10,6 +10,12 @@
 #include "cgimap/api06/changeset_upload/osmchange_handler.hpp"
 
 #include "cgimap/http.hpp"
+#include "cgimap/options.hpp"
+
+#include <ctime>
+#include <iomanip>
+#include <set>
+#include <sstream>
 
 #include <fmt/core.h>
 
@@ -27,7 +33,7 @@ OSMChange_Handler::OSMChange_Handler(Node_Updater& node_updater,
 
 void OSMChange_Handler::start_document() {}
 
-void OSMChange_Handler::end_document() { finish_processing(); }
+void OSMChange_Handler::end_document() { validate_changes(); }
 
 // checks common to all objects
 void OSMChange_Handler::check_osm_object(const OSMObject &o) const {
@@ -47,6 +53,60 @@ void OSMChange_Handler::process_node(const Node &node,
 
   check_osm_object(node);
 
+  if (op != operation::op_create)
+    lock_plan.add_exclusive(object_type::node, node.id());
+
+  changes.push_back({op, if_unused, node});
+}
+
+void OSMChange_Handler::process_way(const Way &way, operation op,
+                                    bool if_unused) {
+
+  assert(op != operation::op_undefined);
+
+  check_osm_object(way);
+
+  if (op != operation::op_create)
+    lock_plan.add_exclusive(object_type::way, way.id());
+
+  if (op != operation::op_delete) {
+    for (const auto node_id : way.nodes())
+      lock_plan.add_shared(object_type::node, node_id);
+  }
+
+  changes.push_back({op, if_unused, way});
+}
+
+void OSMChange_Handler::process_relation(const Relation &relation,
+                                         operation op,
+                                         bool if_unused) {
+
+  assert(op != operation::op_undefined);
+
+  check_osm_object(relation);
+
+  if (op != operation::op_create)
+    lock_plan.add_exclusive(object_type::relation, relation.id());
+
+  if (op != operation::op_delete) {
+    for (const auto &member : relation.members()) {
+      const auto type = member.type();
+      if (type == "Node")
+        lock_plan.add_shared(object_type::node, member.ref());
+      else if (type == "Way")
+        lock_plan.add_shared(object_type::way, member.ref());
+      else if (type == "Relation")
+        lock_plan.add_shared(object_type::relation, member.ref());
+    }
+  }
+
+  changes.push_back({op, if_unused, relation});
+}
+
+void OSMChange_Handler::apply_node(const Node &node,
+                                   operation op,
+                                   bool if_unused) {
+
   switch (op) {
   case operation::op_create:
     handle_new_state(state::st_create_node);
@@ -72,12 +132,8 @@ void OSMChange_Handler::process_node(const Node &node,
   }
 }
 
-void OSMChange_Handler::process_way(const Way &way, operation op,
-                                    bool if_unused) {
-
-  assert(op != operation::op_undefined);
-
-  check_osm_object(way);
+void OSMChange_Handler::apply_way(const Way &way, operation op,
+                                  bool if_unused) {
 
   switch (op) {
   case operation::op_create:
@@ -102,13 +158,9 @@ void OSMChange_Handler::process_way(const Way &way, operation op,
   }
 }
 
-void OSMChange_Handler::process_relation(const Relation &relation,
-                                         operation op,
-                                         bool if_unused) {
-
-  assert(op != operation::op_undefined);
-
-  check_osm_object(relation);
+void OSMChange_Handler::apply_relation(const Relation &relation,
+                                       operation op,
+                                       bool if_unused) {
 
   switch (op) {
   case operation::op_create:
@@ -135,7 +187,134 @@ void OSMChange_Handler::process_relation(const Relation &relation,
   }
 }
 
-void OSMChange_Handler::finish_processing() {
+void OSMChange_Handler::validate_changes() const {
+
+  std::set<osm_nwr_signed_id_t> created_nodes;
+  std::set<osm_nwr_signed_id_t> created_ways;
+  std::set<osm_nwr_signed_id_t> created_relations;
+
+  // number of changes, which will end up in the changeset for sure.
+  // Deletions with if-unused may still be skipped later on.
+  uint32_t min_num_changes = 0;
+
+  auto check_created = [](std::set<osm_nwr_signed_id_t> &created,
+                          osm_nwr_signed_id_t id) {
+    if (id >= 0)
+      throw http::bad_request(
+          "Placeholder IDs must be negative for created elements.");
+
+    auto [_, inserted] = created.insert(id);
+    if (!inserted)
+      throw http::bad_request(
+          "Placeholder IDs must be unique for created elements.");
+  };
+
+  auto check_reference = [](const std::set<osm_nwr_signed_id_t> &created,
+                            osm_nwr_signed_id_t id, const std::string &type) {
+    if (id < 0 && !created.contains(id))
+      throw http::bad_request(fmt::format(
+          "Placeholder id not found for {} reference {:d}", type, id));
+  };
+
+  // Placeholder ids can only be referenced after the element was created,
+  // i.e. earlier in the document. This also rules out forward references
+  // and self references in relations.
+  for (const auto &change : changes) {
+
+    if (!(change.op == operation::op_delete && change.if_unused))
+      ++min_num_changes;
+
+    if (const auto *node = std::get_if<Node>(&change.element)) {
+      if (change.op == operation::op_create)
+        check_created(created_nodes, node->id());
+      else
+        check_reference(created_nodes, node->id(), "node");
+    }
+    else if (const auto *way = std::get_if<Way>(&change.element)) {
+      if (change.op == operation::op_create)
+        check_created(created_ways, way->id());
+      else
+        check_reference(created_ways, way->id(), "way");
+
+      if (change.op == operation::op_delete)
+        continue;
+
+      for (const auto node_id : way->nodes()) {
+        if (node_id < 0 && !created_nodes.contains(node_id))
+          throw http::bad_request(fmt::format(
+              "Placeholder node not found for reference {:d} in way {:d}",
+              node_id, way->id()));
+      }
+    }
+    else if (const auto *relation = std::get_if<Relation>(&change.element)) {
+      if (change.op != operation::op_create)
+        check_reference(created_relations, relation->id(), "relation");
+
+      if (change.op != operation::op_delete) {
+        for (const auto &member : relation->members()) {
+          if (member.ref() >= 0)
+            continue;
+
+          const auto type = member.type();
+          const auto &created = (type == "Node") ? created_nodes :
+                                (type == "Way")  ? created_ways :
+                                                   created_relations;
+          if (!created.contains(member.ref()))
+            throw http::bad_request(fmt::format(
+                "Placeholder {} not found for reference {:d} in relation {:d}",
+                (type == "Node") ? "node" : (type == "Way") ? "way" : "relation",
+                member.ref(), relation->id()));
+        }
+      }
+
+      // registered only after checking members to rule out self references
+      if (change.op == operation::op_create)
+        check_created(created_relations, relation->id());
+    }
+  }
+
+  // The upload alone exceeds the changeset limit, no need to check the
+  // number of changes already stored in the changeset
+  if (min_num_changes > global_settings::get_changeset_max_elements()) {
+    const auto now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    std::ostringstream current_time;
+    current_time << std::put_time(&tm, "%F %T UTC");
+
+    throw http::conflict(fmt::format("The changeset {:d} was closed at {}",
+                                     changeset, current_time.str()));
+  }
+}
+
+void OSMChange_Handler::process_changes() {
+
+  // Lock all existing rows upfront, always in the same order: nodes, ways,
+  // relations, each table by ascending id
+  {
+    const auto locks = lock_plan.locks(object_type::node);
+    node_updater.lock_nodes(locks.exclusive_ids, locks.shared_ids);
+  }
+  {
+    const auto locks = lock_plan.locks(object_type::way);
+    way_updater.lock_ways(locks.exclusive_ids, locks.shared_ids);
+  }
+  {
+    const auto locks = lock_plan.locks(object_type::relation);
+    relation_updater.lock_relations(locks.exclusive_ids, locks.shared_ids);
+  }
+
+  for (const auto &change : changes) {
+    if (const auto *node = std::get_if<Node>(&change.element))
+      apply_node(*node, change.op, change.if_unused);
+    else if (const auto *way = std::get_if<Way>(&change.element))
+      apply_way(*way, change.op, change.if_unused);
+    else if (const auto *relation = std::get_if<Relation>(&change.element))
+      apply_relation(*relation, change.op, change.if_unused);
+  }
+
+  changes.clear();
+
   handle_new_state(state::st_finished);
 }
 
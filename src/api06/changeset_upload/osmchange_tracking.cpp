@@ -13,167 +13,188 @@
 
 #include <fmt/core.h>
 
-#include <set>
-#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
 
 namespace api06 {
 
+namespace {
+
+  /*
+   * Flat lookup table: entries are collected in a single pre-sized vector
+   * and sorted once, lookups use binary search. For equal keys, the entry
+   * added first wins.
+   */
+  template <typename Value>
+  class flat_index {
+
+  public:
+    using key_t = std::tuple< object_type, osm_nwr_signed_id_t, osm_version_t >;
+
+    void reserve(std::size_t size) { entries.reserve(size); }
+
+    void add(object_type type, osm_nwr_signed_id_t id, osm_version_t version, const Value &value) {
+      entries.emplace_back(key_t{ type, id, version }, value);
+    }
+
+    void sort() {
+      std::ranges::stable_sort(entries, {}, &entry_t::first);
+    }
+
+    const Value* find(object_type type, osm_nwr_signed_id_t id, osm_version_t version) const {
+      const key_t key{ type, id, version };
+      auto it = std::ranges::lower_bound(entries, key, {}, &entry_t::first);
+      if (it == entries.end() || it->first != key)
+        return nullptr;
+      return &it->second;
+    }
+
+  private:
+    using entry_t = std::pair< key_t, Value >;
+
+    std::vector< entry_t > entries;
+  };
+
+} // anonymous namespace
+
   std::vector<diffresult_t> OSMChange_Tracking::assemble_diffresult() {
 
     // For compatibility reasons, diffResult output matches the exact object sequence provided in the osmChange message.
     // OSM API documentation doesn't provide any guarantees wrt the actual sequence. However, some clients might
     // implicitly rely on osmChange entries to be processed in the sequence given.
 
-    // Prepare maps for faster lookup
+    // Prepare lookup tables. Only modifications are keyed by version, all other tables use version 0.
 
-    using object_type_id_pair_t = std::pair< object_type, osm_nwr_signed_id_t >;
-    using object_type_id_version_tuple_t = std::tuple< object_type, osm_nwr_signed_id_t, osm_version_t>;
-
-    std::map< object_type_id_pair_t, object_id_mapping_t > map_create_ids;
-    std::map< object_type_id_version_tuple_t, object_id_mapping_t > map_modify_ids;
-    std::map< object_type_id_pair_t, object_id_mapping_t > map_skip_delete_ids;
-    std::set< object_type_id_pair_t > set_delete_ids;
+    flat_index< object_id_mapping_t > index_create_ids;
+    flat_index< object_id_mapping_t > index_modify_ids;
+    flat_index< object_id_mapping_t > index_skip_delete_ids;
+    flat_index< osm_nwr_signed_id_t > index_delete_ids;
 
     // Create
+    index_create_ids.reserve(created_node_ids.size() + created_way_ids.size() + created_relation_ids.size());
+
     for (const auto &id : created_node_ids)
-      map_create_ids.insert({ { object_type::node, id.old_id }, id });
+      index_create_ids.add(object_type::node, id.old_id, 0, id);
 
     for (const auto &id : created_way_ids)
-      map_create_ids.insert({ { object_type::way, id.old_id }, id });
+      index_create_ids.add(object_type::way, id.old_id, 0, id);
 
     for (const auto &id : created_relation_ids)
-      map_create_ids.insert({ { object_type::relation, id.old_id }, id });
-
+      index_create_ids.add(object_type::relation, id.old_id, 0, id);
 
     // Modify
+    index_modify_ids.reserve(modified_node_ids.size() + modified_way_ids.size() + modified_relation_ids.size());
+
     for (const auto &id : modified_node_ids)
-      map_modify_ids.insert({ { object_type::node, id.old_id, id.new_version }, id });
+      index_modify_ids.add(object_type::node, id.old_id, id.new_version, id);
 
     for (const auto &id : modified_way_ids)
-      map_modify_ids.insert({ { object_type::way, id.old_id, id.new_version }, id });
+      index_modify_ids.add(object_type::way, id.old_id, id.new_version, id);
 
     for (const auto &id : modified_relation_ids)
-      map_modify_ids.insert({ { object_type::relation, id.old_id, id.new_version}, id });
+      index_modify_ids.add(object_type::relation, id.old_id, id.new_version, id);
 
     // Delete (if-unused)
+    index_skip_delete_ids.reserve(skip_deleted_node_ids.size() + skip_deleted_way_ids.size() + skip_deleted_relation_ids.size());
+
     for (const auto &id : skip_deleted_node_ids)
-      map_skip_delete_ids.insert({ { object_type::node, id.old_id }, id });
+      index_skip_delete_ids.add(object_type::node, id.old_id, 0, id);
 
     for (const auto &id : skip_deleted_way_ids)
-      map_skip_delete_ids.insert({ { object_type::way, id.old_id }, id });
+      index_skip_delete_ids.add(object_type::way, id.old_id, 0, id);
 
     for (const auto &id : skip_deleted_relation_ids)
-      map_skip_delete_ids.insert({ { object_type::relation, id.old_id }, id });
+      index_skip_delete_ids.add(object_type::relation, id.old_id, 0, id);
 
     // Deleted object ids
+    index_delete_ids.reserve(deleted_node_ids.size() + deleted_way_ids.size() + deleted_relation_ids.size());
+
     for (const auto &id : deleted_node_ids)
-      set_delete_ids.insert({ object_type::node, id });
+      index_delete_ids.add(object_type::node, id, 0, id);
 
     for (const auto &id : deleted_way_ids)
-      set_delete_ids.insert({ object_type::way, id });
+      index_delete_ids.add(object_type::way, id, 0, id);
 
     for (const auto &id : deleted_relation_ids)
-      set_delete_ids.insert({ object_type::relation, id });
+      index_delete_ids.add(object_type::relation, id, 0, id);
 
+    index_create_ids.sort();
+    index_modify_ids.sort();
+    index_skip_delete_ids.sort();
+    index_delete_ids.sort();
 
     std::vector<diffresult_t> result;
+    result.reserve(osmchange_orig_sequence.size());
+
+    auto add_row = [&result](const osmchange_t &item, const object_id_mapping_t &id, bool deletion_skipped) {
+      result.push_back({ .op = item.op,
+                         .obj_type = item.obj_type,
+                         .old_id = id.old_id,
+                         .new_id = id.new_id,
+                         .new_version = id.new_version,
+                         .deletion_skipped = deletion_skipped });
+    };
+
+    auto add_deleted_row = [&](const osmchange_t &item) {
+      const auto *id = index_delete_ids.find(item.obj_type, item.orig_id, 0);
+      if (id == nullptr) {
+        throw std::runtime_error ("Element in osmChange message was not processed");
+      }
+
+      diffresult_t row{};
+      row.op = item.op;
+      row.obj_type = item.obj_type;
+      row.old_id = *id;
+      row.deletion_skipped = false;
+      result.push_back(row);
+    };
 
     // Iterate over all elements in the sequence defined in the osmChange message
 
     for (const auto &item : osmchange_orig_sequence) {
 
-	switch (item.op) {
-
-	  case operation::op_create:
-	    {
-	      auto it = map_create_ids.find({ item.obj_type, item.orig_id });
-	      if (it == map_create_ids.end()) {
-	        throw std::runtime_error ("Element in osmChange message was not processed");
-	      }
-
-              diffresult_t row{};
-              const auto & id = it->second;
-              row.op = item.op;
-              row.obj_type = item.obj_type;
-              row.old_id = id.old_id;
-              row.new_id = id.new_id;
-              row.new_version = id.new_version;
-              row.deletion_skipped = false;
-              result.push_back(row);
-	    }
-	    break;
-
-	  case operation::op_modify:
-	    {
-	      auto it = map_modify_ids.find({ item.obj_type, item.orig_id, item.orig_version + 1 });
-	      if (it == map_modify_ids.end()) {
-	        throw std::runtime_error ("Element in osmChange message was not processed");
-	      }
-
-              diffresult_t row{};
-              const auto & id = it->second;
-              row.op = item.op;
-              row.obj_type = item.obj_type;
-              row.old_id = id.old_id;
-              row.new_id = id.new_id;
-              row.new_version = id.new_version;
-              row.deletion_skipped = false;
-              result.push_back(row);
-	    }
-	    break;
-
-	  case operation::op_delete:
-
-	    if (item.if_unused) {
-		auto it = map_skip_delete_ids.find({ item.obj_type, item.orig_id });
-		if (it != map_skip_delete_ids.end()) {
-		    diffresult_t row{};
-		    const auto & id = it->second;
-		    row.op  = item.op;
-		    row.obj_type = item.obj_type;
-		    row.old_id = id.old_id;
-		    row.new_id = id.new_id;
-		    row.new_version = id.new_version;
-		    row.deletion_skipped = true;
-		    result.push_back(row);
-		}
-		else {
-		    auto it = set_delete_ids.find({ item.obj_type, item.orig_id });
-		    if (it == set_delete_ids.end()) {
-		      throw std::runtime_error ("Element in osmChange message was not processed");
-		    }
-
-                    diffresult_t row{};
-                    row.op = item.op;
-                    row.obj_type = item.obj_type;
-                    row.old_id = it->second;
-                    row.deletion_skipped = false;
-                    result.push_back(row);
-		}
-	    }
-
-	    if (!item.if_unused) {
-		auto it = set_delete_ids.find({ item.obj_type, item.orig_id });
-		if (it == set_delete_ids.end()) {
-		  throw std::runtime_error ("Element in osmChange message was not processed");
-		}
-
-                diffresult_t row{};
-                row.op = item.op;
-                row.obj_type = item.obj_type;
-                row.old_id = it->second;
-                row.deletion_skipped = false;
-                result.push_back(row);
-	    }
-
-	    break;
-
-	  case operation::op_undefined:
-
-	    throw std::runtime_error ("Unexpected operation in original sequence mapping. This should not happen!");
-
-	}
+      switch (item.op) {
+
+        case operation::op_create:
+          {
+            const auto *id = index_create_ids.find(item.obj_type, item.orig_id, 0);
+            if (id == nullptr) {
+              throw std::runtime_error ("Element in osmChange message was not processed");
+            }
+            add_row(item, *id, false);
+          }
+          break;
+
+        case operation::op_modify:
+          {
+            const auto *id = index_modify_ids.find(item.obj_type, item.orig_id, item.orig_version + 1);
+            if (id == nullptr) {
+              throw std::runtime_error ("Element in osmChange message was not processed");
+            }
+            add_row(item, *id, false);
+          }
+          break;
+
+        case operation::op_delete:
+
+          if (item.if_unused) {
+            const auto *id = index_skip_delete_ids.find(item.obj_type, item.orig_id, 0);
+            if (id != nullptr) {
+              add_row(item, *id, true);
+              break;
+            }
+          }
+
+          add_deleted_row(item);
+          break;
+
+        case operation::op_undefined:
+
+          throw std::runtime_error ("Unexpected operation in original sequence mapping. This should not happen!");
+
+      }
     }
 
     return result;
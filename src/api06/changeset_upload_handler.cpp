@@ -12,6 +12,7 @@
 #include "cgimap/http.hpp"
 #include "cgimap/logger.hpp"
 #include "cgimap/request_context.hpp"
+#include "cgimap/cache_invalidation.hpp"
 
 #include "cgimap/api06/changeset_upload/osmchange_handler.hpp"
 #include "cgimap/api06/changeset_upload/osmchange_xml_input_format.hpp"
@@ -47,15 +48,20 @@ changeset_upload_responder::changeset_upload_responder(mime::type mt,
   auto way_updater = upd.get_way_updater(req_ctx, change_tracking);
   auto relation_updater = upd.get_relation_updater(req_ctx, change_tracking);
 
-  changeset_updater->lock_current_changeset(true);
-
   OSMChange_Handler handler(*node_updater, *way_updater, *relation_updater, changeset);
 
+  // Parse and validate the complete upload first, invalid uploads are
+  // rejected without any database access
   // TODO: check HTTP Accept header
   if (mt != mime::type::application_json) {
     OSMChangeXMLParser(handler).process_message(payload);
   }
 
+  // keep the changeset locked for as short as possible
+  changeset_updater->lock_current_changeset(true);
+
+  handler.process_changes();
+
   // store diffresult for output handling in class osm_diffresult_responder
   m_diffresult = change_tracking.assemble_diffresult();
 
@@ -96,6 +102,10 @@ changeset_upload_responder::changeset_upload_responder(mime::type mt,
     }
   }
 
+  auto changed = cache_invalidation::changed_by(change_tracking, handler.get_bbox());
+  changed.items.push_back({element_type::changeset, static_cast<osm_nwr_id_t>(changeset)});
+  upd.notify_changes(changed);
+
   upd.commit();
 }
 
@@ -49,7 +49,7 @@ void relation_full_responder::check_visibility(osm_nwr_id_t id) {
 
 relation_full_handler::relation_full_handler(const request &, osm_nwr_id_t id)
     : id(id) {
-  logger::message(
+  logger::message(logger::level::debug,
       fmt::format("starting relation/full handler with id = {:d}", id));
 }
 
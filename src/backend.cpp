@@ -10,7 +10,9 @@
 #include "cgimap/backend.hpp"
 
 #include <fmt/core.h>
+#include <map>
 #include <memory>
+#include <stdexcept>
 
 namespace po = boost::program_options;
 
@@ -39,43 +41,92 @@ po::variables_map first_pass_arguments(int argc, char *argv[],
 struct registry {
   registry() = default;
 
-  bool set_backend(std::unique_ptr<backend> ptr);
+  bool add(std::unique_ptr<backend> ptr);
   void setup_options(int argc, char *argv[], po::options_description &desc);
   void output_options(std::ostream &out);
+  void prepare(const po::variables_map &options);
   std::unique_ptr<data_selection::factory> create(const po::variables_map &options);
   std::unique_ptr<data_update::factory> create_data_update(const po::variables_map &options);
 
 private:
-  std::unique_ptr<backend> backend_ptr;
+  backend &selected(const po::variables_map &options);
+  std::string all_backends() const;
+
+  std::map<std::string, std::unique_ptr<backend>, std::less<>> backends;
 };
 
-bool registry::set_backend(std::unique_ptr<backend> ptr) {
-  backend_ptr = std::move(ptr);
+bool registry::add(std::unique_ptr<backend> ptr) {
+  std::string name = ptr->name();
+  backends.insert_or_assign(std::move(name), std::move(ptr));
   return true;
 }
 
+std::string registry::all_backends() const {
+  std::string result;
+  for (const auto &[name, ptr] : backends) {
+    if (!result.empty())
+      result += ", ";
+    result += name;
+  }
+  return result;
+}
+
 void registry::setup_options(int argc, char *argv[],
                              po::options_description &desc) {
 
+  if (backends.empty()) {
+    throw std::runtime_error("No backends available - this is most likely a "
+                             "compile-time configuration error.");
+  }
+
+  const std::string description =
+      fmt::format("backend to use, available options are: {}", all_backends());
+  desc.add_options()("backend",
+                     po::value<std::string>()->default_value(backends.begin()->first),
+                     description.c_str());
+
   po::variables_map vm = first_pass_arguments(argc, argv, desc);
 
+  // the options of all backends are shown with --help, so only the selected
+  // backend's options are added here.
   if (!vm.contains("help")) {
-    desc.add(backend_ptr->options());
+    desc.add(selected(vm).options());
   }
 }
 
 void registry::output_options(std::ostream &out) {
-    out << backend_ptr->options() << std::endl;
+  for (const auto &[name, ptr] : backends)
+    out << ptr->options() << std::endl;
+}
+
+backend &registry::selected(const po::variables_map &options) {
+  if (backends.empty())
+    throw std::runtime_error("No backends available");
+
+  if (!options.contains("backend"))
+    return *backends.begin()->second;
+
+  const auto name = options["backend"].as<std::string>();
+  auto itr = backends.find(name);
+  if (itr == backends.end()) {
+    throw std::runtime_error(fmt::format(
+        "Unknown backend {}, available options are: {}", name, all_backends()));
+  }
+  return *itr->second;
+}
+
+void registry::prepare(const po::variables_map &options) {
+  selected(options).prepare(options);
 }
 
 std::unique_ptr<data_selection::factory>
 registry::create(const po::variables_map &options) {
-  return backend_ptr->create(options);
+  return selected(options).create(options);
 }
 
 std::unique_ptr<data_update::factory>
 registry::create_data_update(const po::variables_map &options) {
-  return backend_ptr->create_data_update(options);
+  return selected(options).create_data_update(options);
 }
 
 std::unique_ptr<registry> registry_ptr = std::make_unique<registry>();
@@ -85,9 +136,9 @@ std::unique_ptr<registry> registry_ptr = std::make_unique<registry>();
 
 backend::~backend() = default;
 
-// Registers a single backend, replacing an existing backend
+// Registers a backend, replacing an existing backend of the same name
 bool register_backend(std::unique_ptr<backend> ptr) {
-  return registry_ptr->set_backend(std::move(ptr));
+  return registry_ptr->add(std::move(ptr));
 }
 
 void setup_backend_options(int argc, char *argv[],
@@ -100,6 +151,10 @@ void output_backend_options(std::ostream &out) {
   registry_ptr->output_options(out);
 }
 
+void prepare_backend(const po::variables_map &options) {
+  registry_ptr->prepare(options);
+}
+
 std::unique_ptr<data_selection::factory>
 create_backend(const po::variables_map &options) {
   return registry_ptr->create(options);
@@ -10,9 +10,12 @@
 #include "cgimap/backend/apidb/apidb.hpp"
 #include "cgimap/backend/apidb/readonly_pgsql_selection.hpp"
 #include "cgimap/backend/apidb/pgsql_update.hpp"
+#include "cgimap/backend/apidb/slow_query_log.hpp"
 #include "cgimap/backend.hpp"
 
+#include <chrono>
 #include <memory>
+#include <mutex>
 
 namespace po = boost::program_options;
 
@@ -38,7 +41,13 @@ struct apidb_backend : public backend {
       ("update-password", po::value<std::string>(),
        "database password for API write operations, if different from --password")
       ("update-dbport", po::value<std::string>(),
-       "database port for API write operations, if different from --dbport");
+       "database port for API write operations, if different from --dbport")
+      ("slow-query-log", po::value<std::string>(),
+       "file to log prepared statements exceeding --slow-query-threshold to")
+      ("slow-query-threshold", po::value<long>()->default_value(1000),
+       "execution time in milliseconds above which statements are logged")
+      ("slow-query-explain-rate", po::value<double>()->default_value(0.1),
+       "share of slow read only statements (0 to 1) which are run again with EXPLAIN ANALYZE");
     // clang-format on
   }
   ~apidb_backend() override = default;
@@ -47,15 +56,38 @@ struct apidb_backend : public backend {
   [[nodiscard]] const po::options_description &options() const override { return m_options; }
 
   std::unique_ptr<data_selection::factory> create(const po::variables_map &opts) override {
+    init_slow_query_log(opts);
     return std::make_unique<readonly_pgsql_selection::factory>(opts);
   }
 
   std::unique_ptr<data_update::factory> create_data_update(const po::variables_map &opts) override {
+    init_slow_query_log(opts);
     return std::make_unique<pgsql_update::factory>(opts);
   }
 
 private:
+  // each process opens the log on its own, entries are appended
+  void init_slow_query_log(const po::variables_map &opts) {
+    std::call_once(m_slow_query_log_once, [&] {
+      if (!opts.count("slow-query-log"))
+        return;
+
+      const auto threshold = opts["slow-query-threshold"].as<long>();
+      if (threshold < 0)
+        throw po::validation_error(po::validation_error::invalid_option_value,
+                                   "slow-query-threshold");
+      const auto explain_rate = opts["slow-query-explain-rate"].as<double>();
+      if (explain_rate < 0 || explain_rate > 1)
+        throw po::validation_error(po::validation_error::invalid_option_value,
+                                   "slow-query-explain-rate");
+
+      slow_query_log::initialise(opts["slow-query-log"].as<std::string>(),
+                                 std::chrono::milliseconds(threshold), explain_rate);
+    });
+  }
+
   std::string m_name{"apidb"};
+  std::once_flag m_slow_query_log_once;
   po::options_description m_options{"ApiDB backend options"};
 };
 }
@@ -56,6 +56,46 @@ void ApiDB_Changeset_Updater::lock_current_changeset(bool check_max_elements_lim
 
 }
 
+const prepared_statement changeset_update_w_bbox_statement{
+  "changeset_update_w_bbox",
+  R"(
+       UPDATE changesets
+       SET num_changes = ($1 :: integer),
+           min_lat = $2,
+           min_lon = $3,
+           max_lat = $4,
+           max_lon = $5,
+           closed_at =
+             CASE
+                WHEN (closed_at - created_at) >
+                     (($6 ::interval) - ($7 ::interval)) THEN
+                  created_at + ($6 ::interval)
+                ELSE
+                  now() at time zone 'utc' + ($7 ::interval)
+             END
+       WHERE id = $8
+
+       )"_M,
+  prepared_statement::update};
+
+const prepared_statement changeset_update_statement{
+  "changeset_update",
+  R"(
+       UPDATE changesets
+       SET num_changes = ($1 :: integer),
+           closed_at =
+             CASE
+                WHEN (closed_at - created_at) >
+                     (($2 ::interval) - ($3 ::interval)) THEN
+                  created_at + ($2 ::interval)
+                ELSE
+                  now() at time zone 'utc' + ($3 ::interval)
+             END
+       WHERE id = $4
+
+       )"_M,
+  prepared_statement::update};
+
 void ApiDB_Changeset_Updater::update_changeset(const uint32_t num_new_changes,
                                                const bbox_t bbox) {
 
@@ -87,41 +127,9 @@ void ApiDB_Changeset_Updater::update_changeset(const uint32_t num_new_changes,
 
    */
 
-  m.prepare("changeset_update_w_bbox",
-	    R"(
-       UPDATE changesets
-       SET num_changes = ($1 :: integer),
-           min_lat = $2,
-           min_lon = $3,
-           max_lat = $4,
-           max_lon = $5,
-           closed_at =
-             CASE
-                WHEN (closed_at - created_at) >
-                     (($6 ::interval) - ($7 ::interval)) THEN
-                  created_at + ($6 ::interval)
-                ELSE
-                  now() at time zone 'utc' + ($7 ::interval)
-             END
-       WHERE id = $8
-
-       )"_M);
-
-  m.prepare("changeset_update",
-	    R"(
-       UPDATE changesets
-       SET num_changes = ($1 :: integer),
-           closed_at =
-             CASE
-                WHEN (closed_at - created_at) >
-                     (($2 ::interval) - ($3 ::interval)) THEN
-                  created_at + ($2 ::interval)
-                ELSE
-                  now() at time zone 'utc' + ($3 ::interval)
-             END
-       WHERE id = $4
+  m.prepare(changeset_update_w_bbox_statement);
 
-       )"_M);
+  m.prepare(changeset_update_statement);
 
   if (valid_bbox) {
       auto r = m.exec_prepared("changeset_update_w_bbox", cs_num_changes, cs_bbox.minlat, cs_bbox.minlon,
@@ -175,16 +183,20 @@ void ApiDB_Changeset_Updater::api_update_changeset(const std::map<std::string, s
   update_changeset(0, {});
 }
 
+const prepared_statement changeset_close_statement{
+  "changeset_close",
+  R"(
+       UPDATE changesets
+       SET closed_at = now() at time zone 'utc'
+           WHERE id = $1 AND user_id = $2 )"_M,
+  prepared_statement::update};
+
 void ApiDB_Changeset_Updater::api_close_changeset()
 {
   lock_current_changeset(false);
 
   // Set closed_at timestamp to now() to indicate that the changeset is closed
-  m.prepare("changeset_close",
-	    R"(
-       UPDATE changesets
-       SET closed_at = now() at time zone 'utc'
-           WHERE id = $1 AND user_id = $2 )"_M);
+  m.prepare(changeset_close_statement);
 
   auto r = m.exec_prepared("changeset_close", changeset, req_ctx.user->id);
 
@@ -192,12 +204,9 @@ void ApiDB_Changeset_Updater::api_close_changeset()
     throw http::server_error("Cannot close changeset");
 }
 
-void ApiDB_Changeset_Updater::lock_cs(bool& is_closed, std::string& closed_at, std::string& current_time)
-{
-  // Only lock changeset if it belongs to user_id = uid
-  m.prepare(
-      "changeset_current_lock",
-      R"( SELECT id,
+const prepared_statement changeset_current_lock_statement{
+  "changeset_current_lock",
+  R"( SELECT id,
 		 user_id,
 		 created_at,
 		 min_lat,
@@ -210,7 +219,13 @@ void ApiDB_Changeset_Updater::lock_cs(bool& is_closed, std::string& closed_at, s
 		 to_char((now() at time zone 'utc'),'YYYY-MM-DD HH24:MI:SS "UTC"') as current_time
 	  FROM changesets WHERE id = $1 AND user_id = $2
 	  FOR UPDATE NOWAIT
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+void ApiDB_Changeset_Updater::lock_cs(bool& is_closed, std::string& closed_at, std::string& current_time)
+{
+  // Only lock changeset if it belongs to user_id = uid
+  m.prepare(changeset_current_lock_statement);
 
   auto r = [&] {
     try {
@@ -240,12 +255,16 @@ void ApiDB_Changeset_Updater::lock_cs(bool& is_closed, std::string& closed_at, s
   }
 }
 
+const prepared_statement changeset_exists_statement{
+  "changeset_exists",
+  R"( SELECT id, user_id
+		FROM changesets
+		WHERE id = $1)"_M,
+  prepared_statement::update};
+
 void ApiDB_Changeset_Updater::check_user_owns_changeset()
 {
-  m.prepare("changeset_exists",
-	    R"( SELECT id, user_id
-		FROM changesets
-		WHERE id = $1)"_M);
+  m.prepare(changeset_exists_statement);
 
   auto r = m.exec_prepared ("changeset_exists", changeset);
 
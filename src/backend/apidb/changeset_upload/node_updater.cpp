@@ -9,6 +9,7 @@
 
 #include "cgimap/api06/changeset_upload/osmchange_tracking.hpp"
 #include "cgimap/backend/apidb/changeset_upload/node_updater.hpp"
+#include "cgimap/backend/apidb/changeset_upload/row_locks.hpp"
 #include "cgimap/backend/apidb/pqxx_string_traits.hpp"
 #include "cgimap/backend/apidb/quad_tile.hpp"
 #include "cgimap/backend/apidb/utils.hpp"
@@ -105,6 +106,13 @@ void ApiDB_Node_Updater::delete_node(osm_changeset_id_t changeset_id,
                                           delete_node.version, if_unused);
 }
 
+void ApiDB_Node_Updater::lock_nodes(
+    const std::vector<osm_nwr_id_t> &exclusive_ids,
+    const std::vector<osm_nwr_id_t> &shared_ids) {
+
+  lock_rows(m, "current_nodes", exclusive_ids, shared_ids);
+}
+
 void ApiDB_Node_Updater::process_new_nodes() {
 
   std::vector<osm_nwr_id_t> ids;
@@ -282,17 +290,9 @@ void ApiDB_Node_Updater::check_unique_placeholder_ids(
   }
 }
 
-void ApiDB_Node_Updater::insert_new_nodes_to_current_table(
-    const std::vector<node_t> &create_nodes) {
-
-  if (create_nodes.empty())
-    return;
-
-  // Note: fetching next sequence values has been moved from CTE tmp_nodes
-  // to a dedicated CTE ids_mapping in order to avoid small gaps in the sequence.
-  // Postgresql appears to have called nextval() once too often otherwise.
-
-  m.prepare("insert_new_nodes_to_current_table", R"(
+const prepared_statement insert_new_nodes_to_current_table_statement{
+  "insert_new_nodes_to_current_table",
+  R"(
 
        WITH ids_mapping AS (
         SELECT nextval('current_nodes_id_seq'::regclass) AS id,
@@ -321,7 +321,20 @@ void ApiDB_Node_Updater::insert_new_nodes_to_current_table(
       )
       SELECT id, old_id
         FROM ids_mapping
-  )"_M);
+  )"_M,
+  prepared_statement::update};
+
+void ApiDB_Node_Updater::insert_new_nodes_to_current_table(
+    const std::vector<node_t> &create_nodes) {
+
+  if (create_nodes.empty())
+    return;
+
+  // Note: fetching next sequence values has been moved from CTE tmp_nodes
+  // to a dedicated CTE ids_mapping in order to avoid small gaps in the sequence.
+  // Postgresql appears to have called nextval() once too often otherwise.
+
+  m.prepare(insert_new_nodes_to_current_table_statement);
 
   std::vector<int64_t> lats;
   std::vector<int64_t> lons;
@@ -359,13 +372,9 @@ void ApiDB_Node_Updater::insert_new_nodes_to_current_table(
 
 }
 
-void ApiDB_Node_Updater::lock_current_nodes(
-    const std::vector<osm_nwr_id_t> &ids) {
-
-  if (ids.empty())
-    return;
-
-  m.prepare("lock_current_nodes", R"(
+const prepared_statement lock_current_nodes_statement{
+  "lock_current_nodes",
+  R"(
       WITH locked AS (
         SELECT id FROM current_nodes WHERE id = ANY($1) FOR UPDATE
       )
@@ -373,7 +382,16 @@ void ApiDB_Node_Updater::lock_current_nodes(
       EXCEPT
       SELECT id FROM locked
       ORDER BY id
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+void ApiDB_Node_Updater::lock_current_nodes(
+    const std::vector<osm_nwr_id_t> &ids) {
+
+  if (ids.empty())
+    return;
+
+  m.prepare(lock_current_nodes_statement);
 
   // Query returns only node ids, which could not be locked
   auto r = m.exec_prepared("lock_current_nodes", ids);
@@ -421,6 +439,27 @@ ApiDB_Node_Updater::build_packages(const std::vector<node_t> &nodes) const {
   return result;
 }
 
+const prepared_statement check_current_node_versions_statement{
+  "check_current_node_versions",
+  R"(
+
+        WITH tmp_node_versions(id, version) AS (
+            SELECT * FROM
+            UNNEST( CAST($1 as bigint[]),
+                    CAST($2 as bigint[])
+           )
+        )
+        SELECT t.id,
+              t.version AS expected_version,
+              cn.version AS actual_version
+        FROM tmp_node_versions t
+        INNER JOIN current_nodes cn
+           ON t.id = cn.id
+        WHERE t.version <> cn.version
+        LIMIT 1
+          )"_M,
+  prepared_statement::update};
+
 void ApiDB_Node_Updater::check_current_node_versions(
     const std::vector<node_t> &nodes) {
   // Assumption: All nodes exist on database, and are already locked by
@@ -440,24 +479,7 @@ void ApiDB_Node_Updater::check_current_node_versions(
     versions.emplace_back(n.version);
   }
 
-  m.prepare("check_current_node_versions",
-            R"(
-
-        WITH tmp_node_versions(id, version) AS (
-            SELECT * FROM
-            UNNEST( CAST($1 as bigint[]),
-                    CAST($2 as bigint[])
-           )
-        )
-        SELECT t.id,
-              t.version AS expected_version,
-              cn.version AS actual_version
-        FROM tmp_node_versions t
-        INNER JOIN current_nodes cn
-           ON t.id = cn.id
-        WHERE t.version <> cn.version
-        LIMIT 1
-          )"_M);
+  m.prepare(check_current_node_versions_statement);
 
   auto r = m.exec_prepared("check_current_node_versions", ids, versions);
 
@@ -472,6 +494,12 @@ void ApiDB_Node_Updater::check_current_node_versions(
   }
 }
 
+const prepared_statement already_deleted_nodes_statement{
+  "already_deleted_nodes",
+  "SELECT id, version FROM current_nodes "
+  "WHERE id = ANY($1) AND visible = false",
+  prepared_statement::update};
+
 // for if-unused - determine nodes to be excluded from deletion, regardless of
 // their current version
 std::set<osm_nwr_id_t> ApiDB_Node_Updater::determine_already_deleted_nodes(
@@ -500,8 +528,7 @@ std::set<osm_nwr_id_t> ApiDB_Node_Updater::determine_already_deleted_nodes(
   if (ids_to_be_deleted.empty())
     return result;
 
-  m.prepare("already_deleted_nodes", "SELECT id, version FROM current_nodes "
-                                     "WHERE id = ANY($1) AND visible = false");
+  m.prepare(already_deleted_nodes_statement);
 
   auto r = m.exec_prepared("already_deleted_nodes", ids_to_be_deleted);
 
@@ -538,6 +565,17 @@ std::set<osm_nwr_id_t> ApiDB_Node_Updater::determine_already_deleted_nodes(
   return result;
 }
 
+const prepared_statement calc_node_bbox_statement{
+  "calc_node_bbox",
+  R"(
+      SELECT MIN(latitude)  AS minlat,
+             MIN(longitude) AS minlon,
+             MAX(latitude)  AS maxlat,
+             MAX(longitude) AS maxlon
+      FROM current_nodes WHERE id = ANY($1)
+       )"_M,
+  prepared_statement::update};
+
 bbox_t
 ApiDB_Node_Updater::calc_node_bbox(const std::vector<osm_nwr_id_t> &ids) {
 
@@ -546,14 +584,7 @@ ApiDB_Node_Updater::calc_node_bbox(const std::vector<osm_nwr_id_t> &ids) {
   if (ids.empty())
     return bbox;
 
-  m.prepare("calc_node_bbox",
-            R"(
-      SELECT MIN(latitude)  AS minlat,
-             MIN(longitude) AS minlon,
-             MAX(latitude)  AS maxlat,
-             MAX(longitude) AS maxlon
-      FROM current_nodes WHERE id = ANY($1)
-       )"_M);
+  m.prepare(calc_node_bbox_statement);
 
   auto r = m.exec_prepared("calc_node_bbox", ids);
 
@@ -564,13 +595,9 @@ ApiDB_Node_Updater::calc_node_bbox(const std::vector<osm_nwr_id_t> &ids) {
   return bbox;
 }
 
-void ApiDB_Node_Updater::update_current_nodes(
-    const std::vector<node_t> &nodes) {
-  if (nodes.empty())
-    return;
-
-  m.prepare("update_current_nodes",
-            R"(
+const prepared_statement update_current_nodes_statement{
+  "update_current_nodes",
+  R"(
        WITH u(id, latitude, longitude, changeset_id, tile, version) AS (
           SELECT * FROM
           UNNEST( CAST($1 as bigint[]),
@@ -593,7 +620,15 @@ void ApiDB_Node_Updater::update_current_nodes(
         WHERE n.id = u.id
         AND   n.version = u.version
         RETURNING n.id, n.version
-       )"_M);
+       )"_M,
+  prepared_statement::update};
+
+void ApiDB_Node_Updater::update_current_nodes(
+    const std::vector<node_t> &nodes) {
+  if (nodes.empty())
+    return;
+
+  m.prepare(update_current_nodes_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<int64_t> lats;
@@ -655,13 +690,9 @@ void ApiDB_Node_Updater::update_current_nodes(
             row[version_col].as<osm_version_t>());
 }
 
-void ApiDB_Node_Updater::delete_current_nodes(
-    const std::vector<node_t> &nodes) {
-
-  if (nodes.empty())
-    return;
-
-  m.prepare("delete_current_nodes", R"(
+const prepared_statement delete_current_nodes_statement{
+  "delete_current_nodes",
+  R"(
 
          WITH u(id, changeset_id, version) AS (
             SELECT * FROM
@@ -679,7 +710,16 @@ void ApiDB_Node_Updater::delete_current_nodes(
          WHERE n.id = u.id
          AND   n.version = u.version
          RETURNING n.id, n.version
-   )"_M);
+   )"_M,
+  prepared_statement::update};
+
+void ApiDB_Node_Updater::delete_current_nodes(
+    const std::vector<node_t> &nodes) {
+
+  if (nodes.empty())
+    return;
+
+  m.prepare(delete_current_nodes_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<osm_changeset_id_t> cs;
@@ -710,17 +750,9 @@ void ApiDB_Node_Updater::delete_current_nodes(
     ct.deleted_node_ids.push_back({ id_to_old_id[row[id_col].as<osm_nwr_id_t>()] });
 }
 
-std::vector<osm_nwr_id_t> ApiDB_Node_Updater::insert_new_current_node_tags(
-    const std::vector<node_t> &nodes) {
-
-  if (nodes.empty())
-    return {};
-
-#if PQXX_VERSION_MAJOR < 7
-
-  m.prepare("insert_new_current_node_tags",
-
-            R"(
+const prepared_statement insert_new_current_node_tags_statement{
+  "insert_new_current_node_tags",
+  R"(
       WITH tmp_tag(node_id, k, v) AS (
          SELECT * FROM
          UNNEST( CAST($1 AS bigint[]),
@@ -730,7 +762,18 @@ std::vector<osm_nwr_id_t> ApiDB_Node_Updater::insert_new_current_node_tags(
       )
       INSERT INTO current_node_tags(node_id, k, v)
       SELECT * FROM tmp_tag
-         )"_M);
+         )"_M,
+  prepared_statement::update};
+
+std::vector<osm_nwr_id_t> ApiDB_Node_Updater::insert_new_current_node_tags(
+    const std::vector<node_t> &nodes) {
+
+  if (nodes.empty())
+    return {};
+
+#if PQXX_VERSION_MAJOR < 7
+
+  m.prepare(insert_new_current_node_tags_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<std::string> ks;
@@ -781,6 +824,18 @@ std::vector<osm_nwr_id_t> ApiDB_Node_Updater::insert_new_current_node_tags(
   return ids;
 }
 
+const prepared_statement current_nodes_to_history_statement{
+  "current_nodes_to_history",
+  R"(
+         INSERT INTO nodes (node_id, latitude, longitude, changeset_id,
+                   visible, timestamp, tile, version)
+              SELECT id, latitude, longitude,
+                   changeset_id, visible, timestamp, tile, version
+              FROM current_nodes
+              WHERE id = ANY($1)
+       )"_M,
+  prepared_statement::update};
+
 void ApiDB_Node_Updater::save_current_nodes_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
   // current_nodes -> nodes
@@ -788,15 +843,7 @@ void ApiDB_Node_Updater::save_current_nodes_to_history(
   if (ids.empty())
     return;
 
-  m.prepare("current_nodes_to_history",
-            R"(
-         INSERT INTO nodes (node_id, latitude, longitude, changeset_id,
-                   visible, timestamp, tile, version)
-              SELECT id, latitude, longitude,
-                   changeset_id, visible, timestamp, tile, version
-              FROM current_nodes
-              WHERE id = ANY($1)
-       )"_M);
+  m.prepare(current_nodes_to_history_statement);
 
   auto r = m.exec_prepared("current_nodes_to_history", ids);
 
@@ -804,6 +851,18 @@ void ApiDB_Node_Updater::save_current_nodes_to_history(
     throw http::server_error("Could not save current nodes to history");
 }
 
+const prepared_statement current_node_tags_to_history_statement{
+  "current_node_tags_to_history",
+  R"(
+            INSERT INTO node_tags (node_id, version, k, v)
+                SELECT node_id, version, k, v
+                FROM current_node_tags t
+                  INNER JOIN current_nodes n
+                     ON t.node_id = n.id
+                WHERE id = ANY($1)
+           )"_M,
+  prepared_statement::update};
+
 void ApiDB_Node_Updater::save_current_node_tags_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
   // current_node_tags -> node_tags
@@ -811,19 +870,39 @@ void ApiDB_Node_Updater::save_current_node_tags_to_history(
   if (ids.empty())
     return;
 
-  m.prepare("current_node_tags_to_history",
-            R"(
-            INSERT INTO node_tags (node_id, version, k, v)
-                SELECT node_id, version, k, v
-                FROM current_node_tags t
-                  INNER JOIN current_nodes n
-                     ON t.node_id = n.id
-                WHERE id = ANY($1)
-           )"_M);
+  m.prepare(current_node_tags_to_history_statement);
 
   auto r = m.exec_prepared("current_node_tags_to_history", ids);
 }
 
+const prepared_statement node_still_referenced_by_way_statement{
+  "node_still_referenced_by_way",
+  R"(
+            SELECT node_id,
+                   string_agg(distinct way_id::text,',') AS way_ids
+                   FROM current_way_nodes
+                   WHERE node_id = ANY($1)
+                   GROUP BY node_id
+            )"_M,
+  prepared_statement::update};
+
+const prepared_statement node_still_referenced_by_relation_statement{
+  "node_still_referenced_by_relation",
+  R"(
+             SELECT member_id,
+                    string_agg(distinct relation_id::text,',') AS relation_ids
+                    FROM current_relation_members
+                    WHERE member_type = 'Node'
+                      AND member_id = ANY($1)
+                    GROUP BY member_id
+             )"_M,
+  prepared_statement::update};
+
+const prepared_statement still_referenced_nodes_statement{
+  "still_referenced_nodes",
+  "SELECT id, version FROM current_nodes WHERE id = ANY($1)",
+  prepared_statement::update};
+
 std::vector<ApiDB_Node_Updater::node_t>
 ApiDB_Node_Updater::is_node_still_referenced(const std::vector<node_t> &nodes) {
   // check if node id is still referenced in ways or relations
@@ -850,14 +929,7 @@ ApiDB_Node_Updater::is_node_still_referenced(const std::vector<node_t> &nodes) {
   std::set<osm_nwr_id_t> nodes_to_exclude_from_deletion;
 
   {
-    m.prepare("node_still_referenced_by_way",
-              R"(
-            SELECT node_id,
-                   string_agg(distinct way_id::text,',') AS way_ids
-                   FROM current_way_nodes
-                   WHERE node_id = ANY($1)
-                   GROUP BY node_id
-            )"_M);
+    m.prepare(node_still_referenced_by_way_statement);
 
     auto r = m.exec_prepared("node_still_referenced_by_way", ids);
 
@@ -891,15 +963,7 @@ ApiDB_Node_Updater::is_node_still_referenced(const std::vector<node_t> &nodes) {
   }
 
   {
-    m.prepare("node_still_referenced_by_relation",
-              R"(
-             SELECT member_id,
-                    string_agg(distinct relation_id::text,',') AS relation_ids
-                    FROM current_relation_members
-                    WHERE member_type = 'Node'
-                      AND member_id = ANY($1)
-                    GROUP BY member_id
-             )"_M);
+    m.prepare(node_still_referenced_by_relation_statement);
 
     auto r = m.exec_prepared("node_still_referenced_by_relation", ids);
 
@@ -937,8 +1001,7 @@ ApiDB_Node_Updater::is_node_still_referenced(const std::vector<node_t> &nodes) {
     // if-unused, so it's clear that the delete operation was *not* executed,
     // but simply skipped
 
-    m.prepare("still_referenced_nodes",
-              "SELECT id, version FROM current_nodes WHERE id = ANY($1)");
+    m.prepare(still_referenced_nodes_statement);
 
     auto r = m.exec_prepared("still_referenced_nodes", nodes_to_exclude_from_deletion);
 
@@ -966,14 +1029,18 @@ ApiDB_Node_Updater::is_node_still_referenced(const std::vector<node_t> &nodes) {
   return updated_nodes;
 }
 
+const prepared_statement delete_current_node_tags_statement{
+  "delete_current_node_tags",
+  "DELETE FROM current_node_tags WHERE node_id = ANY($1)",
+  prepared_statement::update};
+
 void ApiDB_Node_Updater::delete_current_node_tags(
     const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return;
 
-  m.prepare("delete_current_node_tags",
-            "DELETE FROM current_node_tags WHERE node_id = ANY($1)");
+  m.prepare(delete_current_node_tags_statement);
 
   auto r = m.exec_prepared("delete_current_node_tags", ids);
 }
@@ -9,6 +9,7 @@
 
 #include "cgimap/api06/changeset_upload/osmchange_tracking.hpp"
 #include "cgimap/backend/apidb/changeset_upload/relation_updater.hpp"
+#include "cgimap/backend/apidb/changeset_upload/row_locks.hpp"
 #include "cgimap/backend/apidb/pqxx_string_traits.hpp"
 #include "cgimap/backend/apidb/utils.hpp"
 #include "cgimap/backend/apidb/transaction_manager.hpp"
@@ -123,6 +124,13 @@ void ApiDB_Relation_Updater::delete_relation(osm_changeset_id_t changeset_id,
         delete_relation.version, if_unused);
 }
 
+void ApiDB_Relation_Updater::lock_relations(
+    const std::vector<osm_nwr_id_t> &exclusive_ids,
+    const std::vector<osm_nwr_id_t> &shared_ids) {
+
+  lock_rows(m, "current_relations", exclusive_ids, shared_ids);
+}
+
 void ApiDB_Relation_Updater::process_new_relations() {
 
   check_unique_placeholder_ids(create_relations);
@@ -473,10 +481,9 @@ void ApiDB_Relation_Updater::check_forward_relation_placeholders(
 }
 
 
-void ApiDB_Relation_Updater::insert_new_relations_to_current_table(
-    const std::vector<relation_t> &create_relations) {
-
-  m.prepare("insert_new_relations_to_current_table", R"(
+const prepared_statement insert_new_relations_to_current_table_statement{
+  "insert_new_relations_to_current_table",
+  R"(
 
        WITH ids_mapping AS (
         SELECT nextval('current_relations_id_seq'::regclass) AS id,
@@ -501,7 +508,13 @@ void ApiDB_Relation_Updater::insert_new_relations_to_current_table(
       )
       SELECT id, old_id
         FROM ids_mapping
-    )"_M);
+    )"_M,
+  prepared_statement::update};
+
+void ApiDB_Relation_Updater::insert_new_relations_to_current_table(
+    const std::vector<relation_t> &create_relations) {
+
+  m.prepare(insert_new_relations_to_current_table_statement);
 
   std::vector<osm_changeset_id_t> cs;
   std::vector<osm_nwr_signed_id_t> oldids;
@@ -531,13 +544,9 @@ void ApiDB_Relation_Updater::insert_new_relations_to_current_table(
   }
 }
 
-void ApiDB_Relation_Updater::lock_current_relations(
-    const std::vector<osm_nwr_id_t> &ids) {
-
-  if (ids.empty())
-    return;
-
-  m.prepare("lock_current_relations", R"(
+const prepared_statement lock_current_relations_statement{
+  "lock_current_relations",
+  R"(
       WITH locked AS (
         SELECT id FROM current_relations WHERE id = ANY($1) FOR UPDATE
       )
@@ -545,7 +554,16 @@ void ApiDB_Relation_Updater::lock_current_relations(
       EXCEPT
       SELECT id FROM locked
       ORDER BY id
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+void ApiDB_Relation_Updater::lock_current_relations(
+    const std::vector<osm_nwr_id_t> &ids) {
+
+  if (ids.empty())
+    return;
+
+  m.prepare(lock_current_relations_statement);
 
   auto r = m.exec_prepared("lock_current_relations", ids);
 
@@ -593,6 +611,24 @@ ApiDB_Relation_Updater::build_packages(
   return result;
 }
 
+const prepared_statement check_current_relation_versions_statement{
+  "check_current_relation_versions",
+  R"(   WITH tmp_relation_versions(id, version) AS (
+                  SELECT * FROM
+                       UNNEST( CAST($1 as bigint[]),
+                               CAST($2 as bigint[]))
+                  )
+                  SELECT t.id,
+                         t.version  AS expected_version,
+                         cr.version AS actual_version
+                  FROM tmp_relation_versions t
+                  INNER JOIN current_relations cr
+                     ON t.id = cr.id
+                  WHERE t.version <> cr.version
+                  LIMIT 1
+       )"_M,
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::check_current_relation_versions(
     const std::vector<relation_t> &relations) {
   // Assumption: All nodes exist on database, and are already locked by
@@ -612,21 +648,7 @@ void ApiDB_Relation_Updater::check_current_relation_versions(
     versions.push_back(r.version);
   }
 
-  m.prepare("check_current_relation_versions",
-            R"(   WITH tmp_relation_versions(id, version) AS (
-                  SELECT * FROM
-                       UNNEST( CAST($1 as bigint[]),
-                               CAST($2 as bigint[]))
-                  )
-                  SELECT t.id,
-                         t.version  AS expected_version,
-                         cr.version AS actual_version
-                  FROM tmp_relation_versions t
-                  INNER JOIN current_relations cr
-                     ON t.id = cr.id
-                  WHERE t.version <> cr.version
-                  LIMIT 1
-       )"_M);
+  m.prepare(check_current_relation_versions_statement);
 
   auto r = m.exec_prepared("check_current_relation_versions", ids, versions);
 
@@ -639,6 +661,13 @@ void ApiDB_Relation_Updater::check_current_relation_versions(
   }
 }
 
+const prepared_statement already_deleted_relations_statement{
+  "already_deleted_relations",
+  "SELECT id, version FROM "
+  "current_relations WHERE id = ANY($1) "
+  "AND visible = false",
+  prepared_statement::update};
+
 // for if-unused - determine ways to be excluded from deletion, regardless of
 // their current version
 std::set<osm_nwr_id_t>
@@ -668,9 +697,7 @@ ApiDB_Relation_Updater::determine_already_deleted_relations(
   if (ids_to_be_deleted.empty())
     return result;
 
-  m.prepare("already_deleted_relations", "SELECT id, version FROM "
-                                         "current_relations WHERE id = ANY($1) "
-                                         "AND visible = false");
+  m.prepare(already_deleted_relations_statement);
 
   auto r =
       m.exec_prepared("already_deleted_relations", ids_to_be_deleted);
@@ -704,6 +731,22 @@ ApiDB_Relation_Updater::determine_already_deleted_relations(
   return result;
 }
 
+const prepared_statement lock_future_nodes_in_relations_statement{
+  "lock_future_nodes_in_relations",
+  R"(
+              WITH locked AS (
+                SELECT id
+                FROM current_nodes
+                WHERE visible = true
+                AND id = ANY($1) FOR SHARE
+              )
+              SELECT t.id FROM UNNEST($1) AS t(id)
+              EXCEPT
+              SELECT id FROM locked
+              ORDER BY id
+            )"_M,
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::lock_future_members_nodes(
     std::vector< osm_nwr_id_t >& node_ids,
     const std::vector< relation_t > &relations)
@@ -715,19 +758,7 @@ void ApiDB_Relation_Updater::lock_future_members_nodes(
   auto new_end = std::ranges::unique(node_ids);
   node_ids.erase(new_end.begin(), new_end.end());
 
-  m.prepare("lock_future_nodes_in_relations",
-            R"(
-              WITH locked AS (
-                SELECT id
-                FROM current_nodes
-                WHERE visible = true
-                AND id = ANY($1) FOR SHARE
-              )
-              SELECT t.id FROM UNNEST($1) AS t(id)
-              EXCEPT
-              SELECT id FROM locked
-              ORDER BY id
-            )"_M);
+  m.prepare(lock_future_nodes_in_relations_statement);
 
   auto r = m.exec_prepared("lock_future_nodes_in_relations", node_ids);
 
@@ -755,6 +786,22 @@ void ApiDB_Relation_Updater::lock_future_members_nodes(
   }
 }
 
+const prepared_statement lock_future_ways_in_relations_statement{
+  "lock_future_ways_in_relations",
+  R"(
+              WITH locked AS (
+                SELECT id
+                FROM current_ways
+                WHERE visible = true
+                AND id = ANY($1) FOR SHARE
+              )
+              SELECT t.id FROM UNNEST($1) AS t(id)
+              EXCEPT
+              SELECT id FROM locked
+              ORDER BY id
+           )"_M,
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::lock_future_members_ways(
     std::vector< osm_nwr_id_t >& way_ids,
     const std::vector< relation_t > &relations)
@@ -766,19 +813,7 @@ void ApiDB_Relation_Updater::lock_future_members_ways(
   auto new_end = std::ranges::unique(way_ids);
   way_ids.erase(new_end.begin(), new_end.end());
 
-  m.prepare("lock_future_ways_in_relations",
-            R"(
-              WITH locked AS (
-                SELECT id
-                FROM current_ways
-                WHERE visible = true
-                AND id = ANY($1) FOR SHARE
-              )
-              SELECT t.id FROM UNNEST($1) AS t(id)
-              EXCEPT
-              SELECT id FROM locked
-              ORDER BY id
-           )"_M);
+  m.prepare(lock_future_ways_in_relations_statement);
 
   auto r = m.exec_prepared("lock_future_ways_in_relations", way_ids);
 
@@ -809,6 +844,22 @@ void ApiDB_Relation_Updater::lock_future_members_ways(
 }
 
 
+const prepared_statement lock_future_relations_in_relations_statement{
+  "lock_future_relations_in_relations",
+  R"(
+              WITH locked AS (
+                SELECT id
+                FROM current_relations
+                WHERE visible = true
+                AND id = ANY($1) FOR SHARE
+              )
+              SELECT t.id FROM UNNEST($1) AS t(id)
+              EXCEPT
+              SELECT id FROM locked
+              ORDER BY id
+            )"_M,
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::lock_future_members_relations(
     std::vector< osm_nwr_id_t >& relation_ids,
     const std::vector< relation_t > &relations)
@@ -820,19 +871,7 @@ void ApiDB_Relation_Updater::lock_future_members_relations(
   auto new_end = std::ranges::unique(relation_ids);
   relation_ids.erase(new_end.begin(), new_end.end());
 
-  m.prepare("lock_future_relations_in_relations",
-            R"(
-              WITH locked AS (
-                SELECT id
-                FROM current_relations
-                WHERE visible = true
-                AND id = ANY($1) FOR SHARE
-              )
-              SELECT t.id FROM UNNEST($1) AS t(id)
-              EXCEPT
-              SELECT id FROM locked
-              ORDER BY id
-            )"_M);
+  m.prepare(lock_future_relations_in_relations_statement);
 
   auto r = m.exec_prepared("lock_future_relations_in_relations", relation_ids);
 
@@ -908,6 +947,26 @@ void ApiDB_Relation_Updater::lock_future_members(
 // as it compares the future state in a temporary structure with the state
 // before the database update
 
+const prepared_statement relations_with_new_relation_members_statement{
+  "relations_with_new_relation_members",
+  R"(
+          WITH tmp_relation_members(relation_id, member_id) AS
+             ( SELECT * FROM
+                  UNNEST( CAST($1 as bigint[]),
+                          CAST($2 as bigint[])
+             )
+          )
+          SELECT t.relation_id
+          FROM   tmp_relation_members t
+          LEFT OUTER JOIN current_relation_members m
+            ON t.relation_id = m.relation_id
+           AND t.member_id   = m.member_id
+           AND m.member_type = 'Relation'
+          WHERE m.member_id IS NULL
+          GROUP BY t.relation_id
+     )"_M,
+  prepared_statement::update};
+
 std::set<osm_nwr_id_t>
 ApiDB_Relation_Updater::relations_with_new_relation_members(
     const std::vector<relation_t> &relations) {
@@ -928,23 +987,7 @@ ApiDB_Relation_Updater::relations_with_new_relation_members(
     }
   }
 
-  m.prepare("relations_with_new_relation_members",
-            R"(
-          WITH tmp_relation_members(relation_id, member_id) AS
-             ( SELECT * FROM
-                  UNNEST( CAST($1 as bigint[]),
-                          CAST($2 as bigint[])
-             )
-          )
-          SELECT t.relation_id
-          FROM   tmp_relation_members t
-          LEFT OUTER JOIN current_relation_members m
-            ON t.relation_id = m.relation_id
-           AND t.member_id   = m.member_id
-           AND m.member_type = 'Relation'
-          WHERE m.member_id IS NULL
-          GROUP BY t.relation_id
-     )"_M);
+  m.prepare(relations_with_new_relation_members_statement);
 
   auto r = m.exec_prepared("relations_with_new_relation_members", relation_ids, member_ids);
 
@@ -961,28 +1004,9 @@ ApiDB_Relation_Updater::relations_with_new_relation_members(
 // as it compares the future state in a temporary structure with the state
 // before the database update
 
-std::set<osm_nwr_id_t>
-ApiDB_Relation_Updater::relations_with_changed_relation_tags(
-    const std::vector<relation_t> &relations) {
-
-  std::set<osm_nwr_id_t> result;
-
-  if (relations.empty())
-    return result;
-
-  std::vector<osm_nwr_id_t> ids;
-  std::vector<std::string> ks;
-  std::vector<std::string> vs;
-
-  for (const auto &relation : relations)
-    for (const auto &[key, value] : relation.tags) {
-      ids.push_back(relation.id);
-      ks.push_back(escape(key));
-      vs.push_back(escape(value));
-    }
-
-  m.prepare("relations_with_changed_relation_tags",
-            R"(
+const prepared_statement relations_with_changed_relation_tags_statement{
+  "relations_with_changed_relation_tags",
+  R"(
             WITH tmp_relation_tags(relation_id, k, v) AS
                  ( SELECT * FROM
                       UNNEST( CAST($1 as bigint[]),
@@ -1014,7 +1038,30 @@ ApiDB_Relation_Updater::relations_with_changed_relation_tags(
                   AND t.v IS NULL
             ) AS all_relations
             GROUP BY all_relations.relation_id
-         )"_M);
+         )"_M,
+  prepared_statement::update};
+
+std::set<osm_nwr_id_t>
+ApiDB_Relation_Updater::relations_with_changed_relation_tags(
+    const std::vector<relation_t> &relations) {
+
+  std::set<osm_nwr_id_t> result;
+
+  if (relations.empty())
+    return result;
+
+  std::vector<osm_nwr_id_t> ids;
+  std::vector<std::string> ks;
+  std::vector<std::string> vs;
+
+  for (const auto &relation : relations)
+    for (const auto &[key, value] : relation.tags) {
+      ids.push_back(relation.id);
+      ks.push_back(escape(key));
+      vs.push_back(escape(value));
+    }
+
+  m.prepare(relations_with_changed_relation_tags_statement);
 
   auto r = m.exec_prepared("relations_with_changed_relation_tags", ids, ks, vs);
 
@@ -1031,6 +1078,52 @@ ApiDB_Relation_Updater::relations_with_changed_relation_tags(
 // as it compares the future state in a temporary structure with the state
 // before the database update
 
+const prepared_statement relations_with_added_way_node_members_statement{
+  "relations_with_added_way_node_members",
+  R"(
+            WITH tmp_member(relation_id, member_type, member_id) AS (
+                 SELECT * FROM
+                 UNNEST( CAST($1 as bigint[]),
+                         CAST($2 as nwr_enum[]),
+                         CAST($3 as bigint[])
+                 )
+              )
+            SELECT tm.member_type, tm.member_id, true as new_member
+                   FROM tmp_member tm
+                   LEFT OUTER JOIN current_relation_members cm
+                     ON tm.relation_id = cm.relation_id
+                    AND tm.member_type = cm.member_type
+                    AND tm.member_id   = cm.member_id
+                 WHERE cm.relation_id IS NULL AND
+                       cm.member_type IS NULL AND
+                       cm.member_id   IS NULL
+         )"_M,
+  prepared_statement::update};
+
+const prepared_statement relations_with_removed_way_node_members_statement{
+  "relations_with_removed_way_node_members",
+  R"(
+            WITH tmp_member(relation_id, member_type, member_id) AS (
+                 SELECT * FROM
+                 UNNEST( CAST($1 as bigint[]),
+                         CAST($2 as nwr_enum[]),
+                         CAST($3 as bigint[])
+                 )
+              )
+            SELECT cm.member_type, cm.member_id, false as new_member
+               FROM current_relation_members cm
+               LEFT OUTER JOIN tmp_member tm
+                  ON cm.relation_id = tm.relation_id
+                 AND cm.member_type = tm.member_type
+                 AND cm.member_id   = tm.member_id
+            WHERE cm.relation_id IN (SELECT DISTINCT relation_id FROM tmp_member) AND
+                  tm.relation_id IS NULL AND
+                  tm.member_type IS NULL AND
+                  tm.member_id   IS NULL
+
+         )"_M,
+  prepared_statement::update};
+
 std::vector<ApiDB_Relation_Updater::rel_member_difference_t>
 ApiDB_Relation_Updater::relations_with_changed_way_node_members(
     const std::vector<relation_t> &relations) {
@@ -1055,25 +1148,7 @@ ApiDB_Relation_Updater::relations_with_changed_way_node_members(
     }
 
   // new member was added in tmp
-  m.prepare("relations_with_added_way_node_members",
-            R"(
-            WITH tmp_member(relation_id, member_type, member_id) AS (
-                 SELECT * FROM
-                 UNNEST( CAST($1 as bigint[]),
-                         CAST($2 as nwr_enum[]),
-                         CAST($3 as bigint[])
-                 )
-              )
-            SELECT tm.member_type, tm.member_id, true as new_member
-                   FROM tmp_member tm
-                   LEFT OUTER JOIN current_relation_members cm
-                     ON tm.relation_id = cm.relation_id
-                    AND tm.member_type = cm.member_type
-                    AND tm.member_id   = cm.member_id
-                 WHERE cm.relation_id IS NULL AND
-                       cm.member_type IS NULL AND
-                       cm.member_id   IS NULL
-         )"_M);
+  m.prepare(relations_with_added_way_node_members_statement);
 
   auto r_added = m.exec_prepared("relations_with_added_way_node_members", ids, membertypes, memberids);
 
@@ -1086,27 +1161,7 @@ ApiDB_Relation_Updater::relations_with_changed_way_node_members(
   }
 
   // existing member was removed in tmp
-  m.prepare("relations_with_removed_way_node_members",
-            R"(
-            WITH tmp_member(relation_id, member_type, member_id) AS (
-                 SELECT * FROM
-                 UNNEST( CAST($1 as bigint[]),
-                         CAST($2 as nwr_enum[]),
-                         CAST($3 as bigint[])
-                 )
-              )
-            SELECT cm.member_type, cm.member_id, false as new_member
-               FROM current_relation_members cm
-               LEFT OUTER JOIN tmp_member tm
-                  ON cm.relation_id = tm.relation_id
-                 AND cm.member_type = tm.member_type
-                 AND cm.member_id   = tm.member_id
-            WHERE cm.relation_id IN (SELECT DISTINCT relation_id FROM tmp_member) AND
-                  tm.relation_id IS NULL AND
-                  tm.member_type IS NULL AND
-                  tm.member_id   IS NULL
-
-         )"_M);
+  m.prepare(relations_with_removed_way_node_members_statement);
 
   auto r_removed = m.exec_prepared("relations_with_removed_way_node_members", ids, membertypes, memberids);
 
@@ -1121,6 +1176,33 @@ ApiDB_Relation_Updater::relations_with_changed_way_node_members(
   return result;
 }
 
+const prepared_statement calc_node_bbox_rel_member_statement{
+  "calc_node_bbox_rel_member",
+  R"(
+      SELECT MIN(latitude)  AS minlat,
+             MIN(longitude) AS minlon,
+             MAX(latitude)  AS maxlat,
+             MAX(longitude) AS maxlon
+      FROM current_nodes WHERE id = ANY($1)
+       )"_M,
+  prepared_statement::update};
+
+const prepared_statement calc_way_bbox_rel_member_statement{
+  "calc_way_bbox_rel_member",
+  R"(
+      SELECT MIN(latitude)  AS minlat,
+             MIN(longitude) AS minlon,
+             MAX(latitude)  AS maxlat,
+             MAX(longitude) AS maxlon
+      FROM current_nodes cn
+      INNER JOIN current_way_nodes wn
+        ON cn.id = wn.node_id
+      INNER JOIN current_ways w
+        ON wn.way_id = w.id
+      WHERE w.id = ANY($1)
+       )"_M,
+  prepared_statement::update};
+
 bbox_t ApiDB_Relation_Updater::calc_rel_member_difference_bbox(
     const std::vector<ApiDB_Relation_Updater::rel_member_difference_t> &diff,
     bool process_new_elements) {
@@ -1146,14 +1228,7 @@ bbox_t ApiDB_Relation_Updater::calc_rel_member_difference_bbox(
 
     bbox_t bbox_nodes;
 
-    m.prepare("calc_node_bbox_rel_member",
-              R"(
-      SELECT MIN(latitude)  AS minlat,
-             MIN(longitude) AS minlon,
-             MAX(latitude)  AS maxlat,
-             MAX(longitude) AS maxlon
-      FROM current_nodes WHERE id = ANY($1)
-       )"_M);
+    m.prepare(calc_node_bbox_rel_member_statement);
 
     auto r = m.exec_prepared("calc_node_bbox_rel_member", node_ids);
 
@@ -1168,19 +1243,7 @@ bbox_t ApiDB_Relation_Updater::calc_rel_member_difference_bbox(
 
     bbox_t bbox_ways;
 
-    m.prepare("calc_way_bbox_rel_member",
-              R"(
-      SELECT MIN(latitude)  AS minlat,
-             MIN(longitude) AS minlon,
-             MAX(latitude)  AS maxlat,
-             MAX(longitude) AS maxlon
-      FROM current_nodes cn
-      INNER JOIN current_way_nodes wn
-        ON cn.id = wn.node_id
-      INNER JOIN current_ways w
-        ON wn.way_id = w.id
-      WHERE w.id = ANY($1)
-       )"_M);
+    m.prepare(calc_way_bbox_rel_member_statement);
 
     auto r = m.exec_prepared("calc_way_bbox_rel_member", way_ids);
 
@@ -1194,6 +1257,40 @@ bbox_t ApiDB_Relation_Updater::calc_rel_member_difference_bbox(
   return result;
 }
 
+const prepared_statement calc_relation_bbox_nodes_statement{
+  "calc_relation_bbox_nodes",
+  R"(
+                SELECT MIN(latitude)  AS minlat,
+                       MIN(longitude) AS minlon,
+                       MAX(latitude)  AS maxlat,
+                       MAX(longitude) AS maxlon
+                FROM current_nodes cn
+                INNER JOIN current_relation_members crm
+                        ON crm.member_id = cn.id
+                 WHERE crm.member_type = 'Node'
+                   AND crm.relation_id = ANY($1)
+            )"_M,
+  prepared_statement::update};
+
+const prepared_statement calc_relation_bbox_ways_statement{
+  "calc_relation_bbox_ways",
+  R"(
+                SELECT MIN(latitude)  AS minlat,
+                       MIN(longitude) AS minlon,
+                       MAX(latitude)  AS maxlat,
+                       MAX(longitude) AS maxlon
+                FROM current_nodes cn
+                INNER JOIN current_way_nodes wn
+                  ON cn.id = wn.node_id
+                INNER JOIN current_ways w
+                  ON wn.way_id = w.id
+                INNER JOIN current_relation_members crm
+                        ON crm.member_id = w.id
+                 WHERE crm.member_type = 'Way'
+                   AND crm.relation_id = ANY($1)
+              )"_M,
+  prepared_statement::update};
+
 bbox_t ApiDB_Relation_Updater::calc_relation_bbox(
     const std::vector<osm_nwr_id_t> &ids) {
 
@@ -1219,18 +1316,7 @@ bbox_t ApiDB_Relation_Updater::calc_relation_bbox(
   if (ids.empty())
     return bbox;
 
-  m.prepare("calc_relation_bbox_nodes",
-            R"(
-                SELECT MIN(latitude)  AS minlat,
-                       MIN(longitude) AS minlon,
-                       MAX(latitude)  AS maxlat,
-                       MAX(longitude) AS maxlon
-                FROM current_nodes cn
-                INNER JOIN current_relation_members crm
-                        ON crm.member_id = cn.id
-                 WHERE crm.member_type = 'Node'
-                   AND crm.relation_id = ANY($1)
-            )"_M);
+  m.prepare(calc_relation_bbox_nodes_statement);
 
   auto rn = m.exec_prepared("calc_relation_bbox_nodes", ids);
 
@@ -1238,22 +1324,7 @@ bbox_t ApiDB_Relation_Updater::calc_relation_bbox(
     extract_bbox_from_row(rn[0], bbox);
   }
 
-  m.prepare("calc_relation_bbox_ways",
-            R"(
-                SELECT MIN(latitude)  AS minlat,
-                       MIN(longitude) AS minlon,
-                       MAX(latitude)  AS maxlat,
-                       MAX(longitude) AS maxlon
-                FROM current_nodes cn
-                INNER JOIN current_way_nodes wn
-                  ON cn.id = wn.node_id
-                INNER JOIN current_ways w
-                  ON wn.way_id = w.id
-                INNER JOIN current_relation_members crm
-                        ON crm.member_id = w.id
-                 WHERE crm.member_type = 'Way'
-                   AND crm.relation_id = ANY($1)
-              )"_M);
+  m.prepare(calc_relation_bbox_ways_statement);
 
   auto rw = m.exec_prepared("calc_relation_bbox_ways", ids);
 
@@ -1266,13 +1337,9 @@ bbox_t ApiDB_Relation_Updater::calc_relation_bbox(
   return bbox;
 }
 
-void ApiDB_Relation_Updater::update_current_relations(
-    const std::vector<relation_t> &relations, bool visible) {
-  if (relations.empty())
-    return;
-
-  m.prepare("update_current_relations",
-            R"(
+const prepared_statement update_current_relations_statement{
+  "update_current_relations",
+  R"(
         WITH u(id, changeset_id, version) AS (
                 SELECT * FROM
                 UNNEST( CAST($1 AS bigint[]),
@@ -1289,7 +1356,15 @@ void ApiDB_Relation_Updater::update_current_relations(
         WHERE r.id = u.id
           AND r.version = u.version
         RETURNING r.id, r.version
-    )"_M);
+    )"_M,
+  prepared_statement::update};
+
+void ApiDB_Relation_Updater::update_current_relations(
+    const std::vector<relation_t> &relations, bool visible) {
+  if (relations.empty())
+    return;
+
+  m.prepare(update_current_relations_statement);
 
   std::vector<osm_nwr_signed_id_t> ids;
   std::vector<osm_changeset_id_t> cs;
@@ -1325,17 +1400,9 @@ void ApiDB_Relation_Updater::update_current_relations(
   }
 }
 
-std::vector<osm_nwr_id_t>  ApiDB_Relation_Updater::insert_new_current_relation_tags(
-    const std::vector<relation_t> &relations) {
-
-  if (relations.empty())
-    return {};
-
-#if PQXX_VERSION_MAJOR < 7
-
-  m.prepare("insert_new_current_relation_tags",
-
-            R"(
+const prepared_statement insert_new_current_relation_tags_statement{
+  "insert_new_current_relation_tags",
+  R"(
                 WITH tmp_tag(relation_id, k, v) AS (
                    SELECT * FROM
                    UNNEST( CAST($1 AS bigint[]),
@@ -1345,7 +1412,18 @@ std::vector<osm_nwr_id_t>  ApiDB_Relation_Updater::insert_new_current_relation_t
                 )
                 INSERT INTO current_relation_tags(relation_id, k, v)
                 SELECT * FROM tmp_tag
-            )"_M);
+            )"_M,
+  prepared_statement::update};
+
+std::vector<osm_nwr_id_t>  ApiDB_Relation_Updater::insert_new_current_relation_tags(
+    const std::vector<relation_t> &relations) {
+
+  if (relations.empty())
+    return {};
+
+#if PQXX_VERSION_MAJOR < 7
+
+  m.prepare(insert_new_current_relation_tags_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<std::string> ks;
@@ -1396,17 +1474,9 @@ std::vector<osm_nwr_id_t>  ApiDB_Relation_Updater::insert_new_current_relation_t
 
 }
 
-void ApiDB_Relation_Updater::insert_new_current_relation_members(
-    const std::vector<relation_t> &relations) {
-
-  if (relations.empty())
-    return;
-
-#if PQXX_VERSION_MAJOR < 7
-
-  m.prepare("insert_new_current_relation_members",
-
-            R"(
+const prepared_statement insert_new_current_relation_members_statement{
+  "insert_new_current_relation_members",
+  R"(
          WITH tmp_member(relation_id, member_type, member_id, member_role, sequence_id) AS (
                  SELECT * FROM
                  UNNEST( CAST($1 as bigint[]),
@@ -1418,7 +1488,18 @@ void ApiDB_Relation_Updater::insert_new_current_relation_members(
          )
          INSERT INTO current_relation_members(relation_id, member_type, member_id, member_role, sequence_id)
          SELECT * FROM tmp_member
-      )"_M);
+      )"_M,
+  prepared_statement::update};
+
+void ApiDB_Relation_Updater::insert_new_current_relation_members(
+    const std::vector<relation_t> &relations) {
+
+  if (relations.empty())
+    return;
+
+#if PQXX_VERSION_MAJOR < 7
+
+  m.prepare(insert_new_current_relation_members_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<std::string> membertypes;
@@ -1452,19 +1533,23 @@ void ApiDB_Relation_Updater::insert_new_current_relation_members(
 #endif
 }
 
+const prepared_statement current_relations_to_history_statement{
+  "current_relations_to_history",
+  R"(
+                INSERT INTO relations (relation_id, changeset_id, timestamp, version, visible)
+                SELECT id AS relation_id, changeset_id, timestamp, version, visible
+                FROM current_relations
+                WHERE id = ANY($1)
+            )"_M,
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::save_current_relations_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return;
 
-  m.prepare("current_relations_to_history",
-            R"(
-                INSERT INTO relations (relation_id, changeset_id, timestamp, version, visible)
-                SELECT id AS relation_id, changeset_id, timestamp, version, visible
-                FROM current_relations
-                WHERE id = ANY($1)
-            )"_M);
+  m.prepare(current_relations_to_history_statement);
 
   auto r = m.exec_prepared("current_relations_to_history", ids);
 
@@ -1472,31 +1557,30 @@ void ApiDB_Relation_Updater::save_current_relations_to_history(
     throw http::server_error("Could not save current relations to history");
 }
 
-void ApiDB_Relation_Updater::save_current_relation_tags_to_history(
-    const std::vector<osm_nwr_id_t> &ids) {
-  if (ids.empty())
-    return;
-
-  m.prepare("current_relation_tags_to_history",
-            R"(
+const prepared_statement current_relation_tags_to_history_statement{
+  "current_relation_tags_to_history",
+  R"(
                 INSERT INTO relation_tags (relation_id, k, v, version)
                  SELECT relation_id, k, v, version FROM current_relation_tags rt
                  INNER JOIN current_relations cr
                  ON rt.relation_id = cr.id
                  WHERE id = ANY($1)
-             )"_M);
-
-  auto r = m.exec_prepared("current_relation_tags_to_history", ids);
-}
+             )"_M,
+  prepared_statement::update};
 
-void ApiDB_Relation_Updater::save_current_relation_members_to_history(
+void ApiDB_Relation_Updater::save_current_relation_tags_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
-
   if (ids.empty())
     return;
 
-  m.prepare("current_relation_members_to_history",
-            R"(
+  m.prepare(current_relation_tags_to_history_statement);
+
+  auto r = m.exec_prepared("current_relation_tags_to_history", ids);
+}
+
+const prepared_statement current_relation_members_to_history_statement{
+  "current_relation_members_to_history",
+  R"(
                 INSERT INTO relation_members (relation_id, member_type, member_id, member_role,
                         version, sequence_id)
                  SELECT relation_id, member_type, member_id, member_role,
@@ -1505,12 +1589,26 @@ void ApiDB_Relation_Updater::save_current_relation_members_to_history(
                  INNER JOIN current_relations cr
                  ON crm.relation_id = cr.id
                  WHERE id = ANY($1)
-                          )"_M);
+                          )"_M,
+  prepared_statement::update};
+
+void ApiDB_Relation_Updater::save_current_relation_members_to_history(
+    const std::vector<osm_nwr_id_t> &ids) {
+
+  if (ids.empty())
+    return;
+
+  m.prepare(current_relation_members_to_history_statement);
 
   auto r =
       m.exec_prepared("current_relation_members_to_history", ids);
 }
 
+const prepared_statement still_referenced_relations_statement{
+  "still_referenced_relations",
+  "SELECT id, version FROM current_relations WHERE id = ANY($1)",
+  prepared_statement::update};
+
 void
 ApiDB_Relation_Updater::remove_blocked_relations_from_deletion_list (
     std::set<osm_nwr_id_t> relations_to_exclude_from_deletion,
@@ -1529,7 +1627,7 @@ ApiDB_Relation_Updater::remove_blocked_relations_from_deletion_list (
   // Return old_id, new_id and current version to the caller in case of
   // if-unused, so it's clear that the delete operation was *not* executed,
   // but simply skipped
-  m.prepare("still_referenced_relations", "SELECT id, version FROM current_relations WHERE id = ANY($1)");
+  m.prepare(still_referenced_relations_statement);
 
   auto r = m.exec_prepared ("still_referenced_relations", relations_to_exclude_from_deletion);
 
@@ -1549,6 +1647,23 @@ ApiDB_Relation_Updater::remove_blocked_relations_from_deletion_list (
   }
 }
 
+const prepared_statement calc_child_relation_ids_for_relation_ids_statement{
+  "calc_child_relation_ids_for_relation_ids",
+  R"(
+           WITH relations_to_check (id) AS (
+              SELECT * FROM
+                UNNEST( CAST($1 AS bigint[]) )
+           )
+           SELECT DISTINCT crm.member_id
+           FROM current_relations cr
+             INNER JOIN relations_to_check c
+                     ON cr.id = c.id
+             INNER JOIN current_relation_members crm
+                     ON crm.relation_id = cr.id
+                    AND crm.member_type = 'Relation'
+       )"_M,
+  prepared_statement::update};
+
 std::set<osm_nwr_id_t>
 ApiDB_Relation_Updater::collect_recursive_relation_rel_member_ids (
     const std::set<osm_nwr_id_t> &direct_relation_ids)
@@ -1563,20 +1678,7 @@ ApiDB_Relation_Updater::collect_recursive_relation_rel_member_ids (
 
   calc_relation_children_ids = direct_relation_ids;
 
-  m.prepare("calc_child_relation_ids_for_relation_ids",
-      R"(
-           WITH relations_to_check (id) AS (
-              SELECT * FROM
-                UNNEST( CAST($1 AS bigint[]) )
-           )
-           SELECT DISTINCT crm.member_id
-           FROM current_relations cr
-             INNER JOIN relations_to_check c
-                     ON cr.id = c.id
-             INNER JOIN current_relation_members crm
-                     ON crm.relation_id = cr.id
-                    AND crm.member_type = 'Relation'
-       )"_M);
+  m.prepare(calc_child_relation_ids_for_relation_ids_statement);
 
   // Recursively iterate over list of relation ids and extract relation member ids
   do {
@@ -1642,6 +1744,29 @@ ApiDB_Relation_Updater::extend_deletion_block_to_relation_children (
   }
 }
 
+const prepared_statement relation_still_referenced_by_relation_statement{
+  "relation_still_referenced_by_relation",
+  R"(
+           WITH relations_to_check (id) AS (
+               SELECT * FROM
+                  UNNEST( CAST($1 AS bigint[]) )
+           )
+           SELECT current_relation_members.member_id,
+                  string_agg(current_relations.id::text,',') AS relation_ids
+           FROM current_relations
+             INNER JOIN current_relation_members
+                    ON current_relation_members.relation_id = current_relations.id
+             INNER JOIN relations_to_check c
+                    ON current_relation_members.member_id = c.id
+             LEFT OUTER JOIN relations_to_check
+                    ON current_relations.id = relations_to_check.id
+           WHERE current_relations.visible = true
+             AND current_relation_members.member_type = 'Relation'
+             AND relations_to_check.id IS NULL
+           GROUP BY current_relation_members.member_id
+       )"_M,
+  prepared_statement::update};
+
 std::vector<ApiDB_Relation_Updater::relation_t>
 ApiDB_Relation_Updater::is_relation_still_referenced(
     const std::vector<relation_t> &relations) {
@@ -1694,26 +1819,7 @@ ApiDB_Relation_Updater::is_relation_still_referenced(
   // in relations outside of our list of relations
   // (direct external dependencies for our list of relations)
 
-  m.prepare("relation_still_referenced_by_relation",
-            R"(
-           WITH relations_to_check (id) AS (
-               SELECT * FROM
-                  UNNEST( CAST($1 AS bigint[]) )
-           )
-           SELECT current_relation_members.member_id,
-                  string_agg(current_relations.id::text,',') AS relation_ids
-           FROM current_relations
-             INNER JOIN current_relation_members
-                    ON current_relation_members.relation_id = current_relations.id
-             INNER JOIN relations_to_check c
-                    ON current_relation_members.member_id = c.id
-             LEFT OUTER JOIN relations_to_check
-                    ON current_relations.id = relations_to_check.id
-           WHERE current_relations.visible = true
-             AND current_relation_members.member_type = 'Relation'
-             AND relations_to_check.id IS NULL
-           GROUP BY current_relation_members.member_id
-       )"_M);
+  m.prepare(relation_still_referenced_by_relation_statement);
 
   auto r = m.exec_prepared("relation_still_referenced_by_relation", ids);
 
@@ -1763,25 +1869,33 @@ ApiDB_Relation_Updater::is_relation_still_referenced(
   return updated_relations;
 }
 
+const prepared_statement delete_current_relation_members_statement{
+  "delete_current_relation_members",
+  "DELETE FROM current_relation_members WHERE relation_id = ANY($1)",
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::delete_current_relation_members(
     const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return;
 
-  m.prepare("delete_current_relation_members",
-            "DELETE FROM current_relation_members WHERE relation_id = ANY($1)");
+  m.prepare(delete_current_relation_members_statement);
 
   auto r = m.exec_prepared("delete_current_relation_members", ids);
 }
 
+const prepared_statement delete_current_relation_tags_statement{
+  "delete_current_relation_tags",
+  "DELETE FROM current_relation_tags WHERE relation_id = ANY($1)",
+  prepared_statement::update};
+
 void ApiDB_Relation_Updater::delete_current_relation_tags(
     const std::vector<osm_nwr_id_t> &ids) {
   if (ids.empty())
     return;
 
-  m.prepare("delete_current_relation_tags",
-            "DELETE FROM current_relation_tags WHERE relation_id = ANY($1)");
+  m.prepare(delete_current_relation_tags_statement);
 
   auto r = m.exec_prepared("delete_current_relation_tags", ids);
 }
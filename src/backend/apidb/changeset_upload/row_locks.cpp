@@ -0,0 +1,78 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/apidb/changeset_upload/row_locks.hpp"
+#include "cgimap/backend/apidb/pqxx_string_traits.hpp"
+#include "cgimap/backend/apidb/statement_catalog.hpp"
+#include "cgimap/backend/apidb/transaction_manager.hpp"
+#include "cgimap/backend/apidb/utils.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+// table names can't be parameters, so there is a statement for each table.
+// with ORDER BY, the rows are locked in the order they are sorted in.
+const prepared_statement lock_current_nodes{
+  "lock_current_nodes",
+  R"(
+      SELECT id FROM current_nodes
+      WHERE id = ANY($1)
+      ORDER BY id
+      FOR UPDATE
+     )"_M,
+  prepared_statement::update};
+
+const prepared_statement lock_current_ways{
+  "lock_current_ways",
+  R"(
+      SELECT id FROM current_ways
+      WHERE id = ANY($1)
+      ORDER BY id
+      FOR UPDATE
+     )"_M,
+  prepared_statement::update};
+
+const prepared_statement lock_current_relations{
+  "lock_current_relations",
+  R"(
+      SELECT id FROM current_relations
+      WHERE id = ANY($1)
+      ORDER BY id
+      FOR UPDATE
+     )"_M,
+  prepared_statement::update};
+
+const prepared_statement &lock_statement(const std::string &table) {
+  for (const auto *s : {&lock_current_nodes, &lock_current_ways, &lock_current_relations}) {
+    if (s->name == "lock_" + table)
+      return *s;
+  }
+  throw std::invalid_argument("Unknown table " + table);
+}
+
+} // anonymous namespace
+
+void lock_rows(Transaction_Manager &m, const std::string &table,
+               const std::vector<osm_nwr_id_t> &exclusive_ids,
+               const std::vector<osm_nwr_id_t> &shared_ids) {
+
+  if (exclusive_ids.empty() && shared_ids.empty())
+    return;
+
+  std::vector<osm_nwr_id_t> ids;
+  ids.reserve(exclusive_ids.size() + shared_ids.size());
+  ids.insert(ids.end(), exclusive_ids.begin(), exclusive_ids.end());
+  ids.insert(ids.end(), shared_ids.begin(), shared_ids.end());
+
+  const auto &statement = lock_statement(table);
+  m.prepare(statement);
+
+  auto r = m.exec_prepared(statement.name, ids);
+}
@@ -9,6 +9,7 @@
 
 #include "cgimap/api06/changeset_upload/osmchange_tracking.hpp"
 #include "cgimap/backend/apidb/changeset_upload/way_updater.hpp"
+#include "cgimap/backend/apidb/changeset_upload/row_locks.hpp"
 #include "cgimap/backend/apidb/pqxx_string_traits.hpp"
 #include "cgimap/backend/apidb/utils.hpp"
 #include "cgimap/backend/apidb/transaction_manager.hpp"
@@ -122,6 +123,13 @@ void ApiDB_Way_Updater::delete_way(osm_changeset_id_t changeset_id,
                                          delete_way.version, if_unused);
 }
 
+void ApiDB_Way_Updater::lock_ways(
+    const std::vector<osm_nwr_id_t> &exclusive_ids,
+    const std::vector<osm_nwr_id_t> &shared_ids) {
+
+  lock_rows(m, "current_ways", exclusive_ids, shared_ids);
+}
+
 void ApiDB_Way_Updater::process_new_ways() {
 
   std::vector<osm_nwr_id_t> ids;
@@ -343,10 +351,9 @@ void ApiDB_Way_Updater::check_unique_placeholder_ids(
   }
 }
 
-void ApiDB_Way_Updater::insert_new_ways_to_current_table(
-    const std::vector<way_t> &create_ways) {
-
-  m.prepare("insert_new_ways_to_current_table", R"(
+const prepared_statement insert_new_ways_to_current_table_statement{
+  "insert_new_ways_to_current_table",
+  R"(
 
        WITH ids_mapping AS (
         SELECT nextval('current_ways_id_seq'::regclass) AS id,
@@ -371,7 +378,13 @@ void ApiDB_Way_Updater::insert_new_ways_to_current_table(
       )
       SELECT id, old_id
         FROM ids_mapping
-  )"_M);
+  )"_M,
+  prepared_statement::update};
+
+void ApiDB_Way_Updater::insert_new_ways_to_current_table(
+    const std::vector<way_t> &create_ways) {
+
+  m.prepare(insert_new_ways_to_current_table_statement);
 
   std::vector<osm_changeset_id_t> cs;
   std::vector<osm_nwr_signed_id_t> oldids;
@@ -397,15 +410,9 @@ void ApiDB_Way_Updater::insert_new_ways_to_current_table(
                                     row[id_col].as<osm_nwr_id_t>(), 1);
 }
 
-bbox_t ApiDB_Way_Updater::calc_way_bbox(const std::vector<osm_nwr_id_t> &ids) {
-
-  bbox_t bbox;
-
-  if (ids.empty())
-    return bbox;
-
-  m.prepare("calc_way_bbox",
-            R"(
+const prepared_statement calc_way_bbox_statement{
+  "calc_way_bbox",
+  R"(
       SELECT MIN(latitude)  AS minlat,
              MIN(longitude) AS minlon,
              MAX(latitude)  AS maxlat,
@@ -416,7 +423,17 @@ bbox_t ApiDB_Way_Updater::calc_way_bbox(const std::vector<osm_nwr_id_t> &ids) {
       INNER JOIN current_ways w
         ON wn.way_id = w.id
       WHERE w.id = ANY($1)
-       )"_M);
+       )"_M,
+  prepared_statement::update};
+
+bbox_t ApiDB_Way_Updater::calc_way_bbox(const std::vector<osm_nwr_id_t> &ids) {
+
+  bbox_t bbox;
+
+  if (ids.empty())
+    return bbox;
+
+  m.prepare(calc_way_bbox_statement);
 
   auto r = m.exec_prepared("calc_way_bbox", ids);
 
@@ -427,13 +444,9 @@ bbox_t ApiDB_Way_Updater::calc_way_bbox(const std::vector<osm_nwr_id_t> &ids) {
   return bbox;
 }
 
-void ApiDB_Way_Updater::lock_current_ways(
-    const std::vector<osm_nwr_id_t> &ids) {
-
-  if (ids.empty())
-    return;
-
-  m.prepare("lock_current_ways", R"(
+const prepared_statement lock_current_ways_statement{
+  "lock_current_ways",
+  R"(
       WITH locked AS (
         SELECT id FROM current_ways WHERE id = ANY($1) FOR UPDATE
       )
@@ -441,7 +454,16 @@ void ApiDB_Way_Updater::lock_current_ways(
       EXCEPT
       SELECT id FROM locked
       ORDER BY id
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+void ApiDB_Way_Updater::lock_current_ways(
+    const std::vector<osm_nwr_id_t> &ids) {
+
+  if (ids.empty())
+    return;
+
+  m.prepare(lock_current_ways_statement);
 
   auto r = m.exec_prepared("lock_current_ways", ids);
 
@@ -488,6 +510,26 @@ ApiDB_Way_Updater::build_packages(const std::vector<way_t> &ways) const {
   return result;
 }
 
+const prepared_statement check_current_way_versions_statement{
+  "check_current_way_versions",
+  R"(
+         WITH tmp_way_versions(id, version) AS (
+           SELECT * FROM
+             UNNEST( CAST($1 as bigint[]),
+                     CAST($2 as bigint[])
+           )
+        )
+        SELECT t.id,
+              t.version   AS expected_version,
+              cw.version  AS actual_version
+        FROM tmp_way_versions t
+        INNER JOIN current_ways cw
+           ON t.id = cw.id
+        WHERE t.version <> cw.version
+        LIMIT 1
+      )"_M,
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::check_current_way_versions(
     const std::vector<way_t> &ways) {
   // Assumption: All ways exist on database, and are already locked by
@@ -507,23 +549,7 @@ void ApiDB_Way_Updater::check_current_way_versions(
     versions.push_back(w.version);
   }
 
-  m.prepare("check_current_way_versions",
-            R"(
-         WITH tmp_way_versions(id, version) AS (
-           SELECT * FROM
-             UNNEST( CAST($1 as bigint[]),
-                     CAST($2 as bigint[])
-           )
-        )
-        SELECT t.id,
-              t.version   AS expected_version,
-              cw.version  AS actual_version
-        FROM tmp_way_versions t
-        INNER JOIN current_ways cw
-           ON t.id = cw.id
-        WHERE t.version <> cw.version
-        LIMIT 1
-      )"_M);
+  m.prepare(check_current_way_versions_statement);
 
   auto r =
       m.exec_prepared("check_current_way_versions", ids, versions);
@@ -539,6 +565,12 @@ void ApiDB_Way_Updater::check_current_way_versions(
   }
 }
 
+const prepared_statement already_deleted_ways_statement{
+  "already_deleted_ways",
+  "SELECT id, version FROM current_ways "
+  "WHERE id = ANY($1) AND visible = false",
+  prepared_statement::update};
+
 // for if-unused - determine ways to be excluded from deletion, regardless of
 // their current version
 std::set<osm_nwr_id_t> ApiDB_Way_Updater::determine_already_deleted_ways(
@@ -567,8 +599,7 @@ std::set<osm_nwr_id_t> ApiDB_Way_Updater::determine_already_deleted_ways(
   if (ids_to_be_deleted.empty())
     return result;
 
-  m.prepare("already_deleted_ways", "SELECT id, version FROM current_ways "
-                                    "WHERE id = ANY($1) AND visible = false");
+  m.prepare(already_deleted_ways_statement);
 
   auto r = m.exec_prepared("already_deleted_ways", ids_to_be_deleted);
 
@@ -604,6 +635,22 @@ std::set<osm_nwr_id_t> ApiDB_Way_Updater::determine_already_deleted_ways(
   return result;
 }
 
+const prepared_statement lock_future_nodes_in_ways_statement{
+  "lock_future_nodes_in_ways",
+  R"(
+        WITH locked AS (
+           SELECT id
+           FROM current_nodes
+           WHERE visible = true
+           AND id = ANY($1) FOR SHARE
+        )
+        SELECT t.id FROM UNNEST($1) AS t(id)
+        EXCEPT
+        SELECT id FROM locked
+        ORDER BY id
+      )"_M,
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::lock_future_nodes(const std::vector<way_t> &ways) {
 
   // Acquire a shared lock on all node ids we want to include in a future
@@ -629,19 +676,7 @@ void ApiDB_Way_Updater::lock_future_nodes(const std::vector<way_t> &ways) {
   auto new_end = std::ranges::unique(node_ids);
   node_ids.erase(new_end.begin(), new_end.end());
 
-  m.prepare("lock_future_nodes_in_ways",
-            R"(
-        WITH locked AS (
-           SELECT id
-           FROM current_nodes
-           WHERE visible = true
-           AND id = ANY($1) FOR SHARE
-        )
-        SELECT t.id FROM UNNEST($1) AS t(id)
-        EXCEPT
-        SELECT id FROM locked
-        ORDER BY id
-      )"_M);
+  m.prepare(lock_future_nodes_in_ways_statement);
 
   auto r = m.exec_prepared("lock_future_nodes_in_ways", node_ids);
 
@@ -669,12 +704,9 @@ void ApiDB_Way_Updater::lock_future_nodes(const std::vector<way_t> &ways) {
   }
 }
 
-void ApiDB_Way_Updater::update_current_ways(const std::vector<way_t> &ways,
-                                            bool visible) {
-  if (ways.empty())
-    return;
-
-  m.prepare("update_current_ways", R"(
+const prepared_statement update_current_ways_statement{
+  "update_current_ways",
+  R"(
       WITH u(id, changeset_id, version) AS (
          SELECT * FROM
          UNNEST( CAST($1 AS bigint[]),
@@ -691,7 +723,15 @@ void ApiDB_Way_Updater::update_current_ways(const std::vector<way_t> &ways,
       WHERE w.id = u.id
       AND   w.version = u.version
       RETURNING w.id, w.version
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+void ApiDB_Way_Updater::update_current_ways(const std::vector<way_t> &ways,
+                                            bool visible) {
+  if (ways.empty())
+    return;
+
+  m.prepare(update_current_ways_statement);
 
   std::vector<osm_nwr_signed_id_t> ids;
   std::vector<osm_changeset_id_t> cs;
@@ -728,17 +768,9 @@ void ApiDB_Way_Updater::update_current_ways(const std::vector<way_t> &ways,
   }
 }
 
-std::vector<osm_nwr_id_t> ApiDB_Way_Updater::insert_new_current_way_tags(
-    const std::vector<way_t> &ways) {
-
- if (ways.empty())
-   return {};
-
-#if PQXX_VERSION_MAJOR < 7
-
-  m.prepare("insert_new_current_way_tags",
-
-            R"(
+const prepared_statement insert_new_current_way_tags_statement{
+  "insert_new_current_way_tags",
+  R"(
       WITH tmp_tag(way_id, k, v) AS (
          SELECT * FROM
          UNNEST( CAST($1 AS bigint[]),
@@ -748,7 +780,18 @@ std::vector<osm_nwr_id_t> ApiDB_Way_Updater::insert_new_current_way_tags(
       )
       INSERT INTO current_way_tags(way_id, k, v)
       SELECT * FROM tmp_tag
-     )"_M);
+     )"_M,
+  prepared_statement::update};
+
+std::vector<osm_nwr_id_t> ApiDB_Way_Updater::insert_new_current_way_tags(
+    const std::vector<way_t> &ways) {
+
+ if (ways.empty())
+   return {};
+
+#if PQXX_VERSION_MAJOR < 7
+
+  m.prepare(insert_new_current_way_tags_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<std::string> ks;
@@ -797,17 +840,9 @@ std::vector<osm_nwr_id_t> ApiDB_Way_Updater::insert_new_current_way_tags(
   return ids;
 }
 
-void ApiDB_Way_Updater::insert_new_current_way_nodes(
-    const std::vector<way_t> &ways) {
-
-  if (ways.empty())
-    return;
-
-#if PQXX_VERSION_MAJOR < 7
-
-  m.prepare("insert_new_current_way_nodes",
-
-            R"(
+const prepared_statement insert_new_current_way_nodes_statement{
+  "insert_new_current_way_nodes",
+  R"(
       WITH new_way_nodes(way_id, node_id, sequence_id) AS (
          SELECT * FROM
          UNNEST( CAST($1 AS bigint[]),
@@ -817,7 +852,18 @@ void ApiDB_Way_Updater::insert_new_current_way_nodes(
       )
       INSERT INTO current_way_nodes (way_id, node_id, sequence_id)
       SELECT * FROM new_way_nodes
-       )"_M);
+       )"_M,
+  prepared_statement::update};
+
+void ApiDB_Way_Updater::insert_new_current_way_nodes(
+    const std::vector<way_t> &ways) {
+
+  if (ways.empty())
+    return;
+
+#if PQXX_VERSION_MAJOR < 7
+
+  m.prepare(insert_new_current_way_nodes_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<osm_nwr_id_t> nodeids;
@@ -846,6 +892,16 @@ void ApiDB_Way_Updater::insert_new_current_way_nodes(
 #endif
 }
 
+const prepared_statement current_ways_to_history_statement{
+  "current_ways_to_history",
+  R"(
+       INSERT INTO ways (way_id, changeset_id, timestamp, version, visible)
+        SELECT id, changeset_id, timestamp, version, visible
+        FROM current_ways
+        WHERE id = ANY($1)
+    )"_M,
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::save_current_ways_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
   // current_ways -> ways
@@ -853,13 +909,7 @@ void ApiDB_Way_Updater::save_current_ways_to_history(
   if (ids.empty())
     return;
 
-  m.prepare("current_ways_to_history",
-            R"(
-       INSERT INTO ways (way_id, changeset_id, timestamp, version, visible)
-        SELECT id, changeset_id, timestamp, version, visible
-        FROM current_ways
-        WHERE id = ANY($1)
-    )"_M);
+  m.prepare(current_ways_to_history_statement);
 
   auto r = m.exec_prepared("current_ways_to_history", ids);
 
@@ -867,6 +917,17 @@ void ApiDB_Way_Updater::save_current_ways_to_history(
     throw http::server_error("Could not save current ways to history");
 }
 
+const prepared_statement current_way_nodes_to_history_statement{
+  "current_way_nodes_to_history",
+  R"(
+   INSERT INTO way_nodes (way_id, node_id, version, sequence_id)
+       SELECT  way_id, node_id, version, sequence_id
+       FROM current_way_nodes wn
+       INNER JOIN current_ways w
+       ON wn.way_id = w.id
+       WHERE id = ANY($1) )"_M,
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::save_current_way_nodes_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
   // current_way_nodes -> way_nodes
@@ -874,18 +935,23 @@ void ApiDB_Way_Updater::save_current_way_nodes_to_history(
   if (ids.empty())
     return;
 
-  m.prepare("current_way_nodes_to_history",
-            R"(
-   INSERT INTO way_nodes (way_id, node_id, version, sequence_id)
-       SELECT  way_id, node_id, version, sequence_id
-       FROM current_way_nodes wn
-       INNER JOIN current_ways w
-       ON wn.way_id = w.id
-       WHERE id = ANY($1) )"_M);
+  m.prepare(current_way_nodes_to_history_statement);
 
   auto r = m.exec_prepared("current_way_nodes_to_history", ids);
 }
 
+const prepared_statement current_way_tags_to_history_statement{
+  "current_way_tags_to_history",
+  R"(
+         INSERT INTO way_tags (way_id, k, v, version)
+             SELECT way_id, k, v, version
+             FROM current_way_tags wt
+             INNER JOIN current_ways w
+                ON wt.way_id = w.id
+             WHERE id = ANY($1)
+     )"_M,
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::save_current_way_tags_to_history(
     const std::vector<osm_nwr_id_t> &ids) {
   // current_way_tags -> way_tags
@@ -893,19 +959,28 @@ void ApiDB_Way_Updater::save_current_way_tags_to_history(
   if (ids.empty())
     return;
 
-  m.prepare("current_way_tags_to_history",
-            R"(
-         INSERT INTO way_tags (way_id, k, v, version)
-             SELECT way_id, k, v, version
-             FROM current_way_tags wt
-             INNER JOIN current_ways w
-                ON wt.way_id = w.id
-             WHERE id = ANY($1)
-     )"_M);
+  m.prepare(current_way_tags_to_history_statement);
 
   auto r = m.exec_prepared("current_way_tags_to_history", ids);
 }
 
+const prepared_statement way_still_referenced_by_relation_statement{
+  "way_still_referenced_by_relation",
+  R"(
+      SELECT member_id,
+             string_agg(distinct relation_id::text,',') AS relation_ids
+         FROM current_relation_members
+         WHERE member_type = 'Way'
+           AND member_id = ANY($1)
+         GROUP BY member_id
+      )"_M,
+  prepared_statement::update};
+
+const prepared_statement still_referenced_ways_statement{
+  "still_referenced_ways",
+  "SELECT id, version FROM current_ways WHERE id = ANY($1)",
+  prepared_statement::update};
+
 std::vector<ApiDB_Way_Updater::way_t>
 ApiDB_Way_Updater::is_way_still_referenced(const std::vector<way_t> &ways) {
   // check if way id is still referenced in relations
@@ -931,15 +1006,7 @@ ApiDB_Way_Updater::is_way_still_referenced(const std::vector<way_t> &ways) {
   std::vector<way_t> updated_ways = ways;
   std::set<osm_nwr_id_t> ways_to_exclude_from_deletion;
 
-  m.prepare("way_still_referenced_by_relation",
-            R"(
-      SELECT member_id,
-             string_agg(distinct relation_id::text,',') AS relation_ids
-         FROM current_relation_members
-         WHERE member_type = 'Way'
-           AND member_id = ANY($1)
-         GROUP BY member_id
-      )"_M);
+  m.prepare(way_still_referenced_by_relation_statement);
 
   auto r = m.exec_prepared("way_still_referenced_by_relation", ids);
 
@@ -984,8 +1051,7 @@ ApiDB_Way_Updater::is_way_still_referenced(const std::vector<way_t> &ways) {
     // if-unused, so it's clear that the delete operation was *not* executed,
     // but simply skipped
 
-    m.prepare("still_referenced_ways",
-              "SELECT id, version FROM current_ways WHERE id = ANY($1)");
+    m.prepare(still_referenced_ways_statement);
 
     auto r = m.exec_prepared("still_referenced_ways", ways_to_exclude_from_deletion);
 
@@ -1016,26 +1082,34 @@ ApiDB_Way_Updater::is_way_still_referenced(const std::vector<way_t> &ways) {
   return updated_ways;
 }
 
+const prepared_statement delete_current_way_tags_statement{
+  "delete_current_way_tags",
+  "DELETE FROM current_way_tags WHERE way_id = ANY($1)",
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::delete_current_way_tags(
     const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return;
 
-  m.prepare("delete_current_way_tags",
-            "DELETE FROM current_way_tags WHERE way_id = ANY($1)");
+  m.prepare(delete_current_way_tags_statement);
 
   auto r = m.exec_prepared("delete_current_way_tags", ids);
 }
 
+const prepared_statement delete_current_way_nodes_statement{
+  "delete_current_way_nodes",
+  "DELETE FROM current_way_nodes WHERE way_id = ANY($1)",
+  prepared_statement::update};
+
 void ApiDB_Way_Updater::delete_current_way_nodes(
     const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return;
 
-  m.prepare("delete_current_way_nodes",
-            "DELETE FROM current_way_nodes WHERE way_id = ANY($1)");
+  m.prepare(delete_current_way_nodes_statement);
 
   auto r = m.exec_prepared("delete_current_way_nodes", ids);
 }
@@ -0,0 +1,90 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/apidb/invalidation_listener.hpp"
+#include "cgimap/logger.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <pqxx/pqxx>
+
+namespace {
+
+// delay before connecting again after an error
+constexpr std::chrono::seconds reconnect_delay{5};
+
+class receiver : public pqxx::notification_receiver {
+public:
+  receiver(pqxx::connection &c, const std::string &channel,
+           const invalidation_listener::callback &on_change)
+    : pqxx::notification_receiver(c, channel), m_on_change(on_change) {}
+
+  void operator()(const std::string &payload, int) override {
+    const auto changes = cache_invalidation::parse(payload);
+    if (!changes.empty())
+      m_on_change(changes);
+  }
+
+private:
+  const invalidation_listener::callback &m_on_change;
+};
+
+} // anonymous namespace
+
+invalidation_listener::invalidation_listener(std::string connect_str, std::string channel,
+                                             callback on_change)
+  : m_connect_str(std::move(connect_str)),
+    m_channel(std::move(channel)),
+    m_on_change(std::move(on_change)),
+    m_owner(getpid()) {
+
+  m_thread = std::make_unique<std::jthread>([this](std::stop_token stop) { run(stop); });
+}
+
+invalidation_listener::~invalidation_listener() {
+  if (getpid() != m_owner) {
+    // joining isn't possible here, as the thread isn't part of this process
+    (void)m_thread.release();
+  }
+  m_thread.reset();
+}
+
+void invalidation_listener::run(std::stop_token stop) {
+  std::mutex mutex;
+  std::condition_variable_any wakeup;
+
+  while (!stop.stop_requested()) {
+    try {
+      listen(stop);
+    } catch (const std::exception &e) {
+      logger::message(logger::level::warning,
+                      fmt::format("Cache invalidation listener failed, reconnecting: {}", e.what()));
+    }
+
+    std::unique_lock lock(mutex);
+    wakeup.wait_for(lock, stop, reconnect_delay, [] { return false; });
+  }
+}
+
+void invalidation_listener::listen(std::stop_token stop) {
+  pqxx::connection connection(m_connect_str);
+  receiver r(connection, m_channel, m_on_change);
+
+  logger::message(fmt::format("Listening for cache invalidations on channel {}", m_channel));
+
+  // wake up regularly to check for shutdown
+  while (!stop.stop_requested())
+    connection.await_notification(1, 0);
+}
@@ -40,7 +40,9 @@ void connopt(std::ostringstream &ostr, const po::variables_map &options,
   }
 }
 
-std::string connect_db_str(const po::variables_map &options) {
+} // anonymous namespace
+
+std::string connect_update_db_str(const po::variables_map &options) {
   // build the connection string.
   std::ostringstream ostr;
 
@@ -62,11 +64,11 @@ std::string connect_db_str(const po::variables_map &options) {
   return ostr.str();
 }
 
-} // anonymous namespace
-
-pgsql_update::pgsql_update(Transaction_Owner_Base& to, bool readonly)
+pgsql_update::pgsql_update(Transaction_Owner_Base& to, bool readonly,
+                           std::string invalidation_channel)
     : m{ to },
-      m_readonly{ readonly } {
+      m_readonly{ readonly },
+      m_invalidation_channel{ std::move(invalidation_channel) } {
 
 }
 
@@ -98,14 +100,36 @@ pgsql_update::get_relation_updater(const RequestContext& req_ctx, api06::OSMChan
   return std::make_unique<ApiDB_Relation_Updater>(m, req_ctx, ct);
 }
 
+const prepared_statement cache_invalidation_notify_statement{
+  "cache_invalidation_notify",
+  "SELECT pg_notify($1, $2)",
+  prepared_statement::update};
+
+void pgsql_update::notify_changes(const cache_invalidation::changes &changes)
+{
+  if (m_invalidation_channel.empty())
+    return;
+
+  m.prepare(cache_invalidation_notify_statement);
+
+  // delivered to listeners only once the transaction is committed
+  for (const auto &payload : cache_invalidation::payloads(changes)) {
+    auto r = m.exec_prepared("cache_invalidation_notify", m_invalidation_channel, payload);
+  }
+}
+
 void pgsql_update::commit() {
   m.commit();
 }
 
+const prepared_statement api_rate_limit_statement{
+  "api_rate_limit",
+  R"(SELECT * FROM api_rate_limit($1) LIMIT 1 )",
+  prepared_statement::update};
+
 uint32_t pgsql_update::get_rate_limit(osm_user_id_t uid)
 {
-  m.prepare("api_rate_limit",
-    R"(SELECT * FROM api_rate_limit($1) LIMIT 1 )");
+  m.prepare(api_rate_limit_statement);
 
   auto res = m.exec_prepared("api_rate_limit", uid);
 
@@ -119,11 +143,15 @@ uint32_t pgsql_update::get_rate_limit(osm_user_id_t uid)
   return std::max(0, rate_limit);
 }
 
+const prepared_statement api_size_limit_statement{
+  "api_size_limit",
+  R"(SELECT * FROM api_size_limit($1) LIMIT 1 )",
+  prepared_statement::update};
+
 uint64_t pgsql_update::get_bbox_size_limit(osm_user_id_t uid)
 {
   {
-    m.prepare("api_size_limit",
-      R"(SELECT * FROM api_size_limit($1) LIMIT 1 )");
+    m.prepare(api_size_limit_statement);
 
     auto res = m.exec_prepared("api_size_limit", uid);
 
@@ -140,13 +168,16 @@ uint64_t pgsql_update::get_bbox_size_limit(osm_user_id_t uid)
 
 
 pgsql_update::factory::factory(const po::variables_map &opts)
-  : m_connection(connect_db_str(opts)),
+  : m_connection(connect_update_db_str(opts)),
     m_api_write_disabled(false),
     m_errorhandler(m_connection) {
 
   check_postgres_version(m_connection);
   m_connection.set_client_encoding("utf8");
 
+  if (opts.contains("cache-invalidation-channel"))
+    m_invalidation_channel = opts["cache-invalidation-channel"].as<std::string>();
+
   // set the connection to readonly transaction, if disable-api-write flag is set
   if (opts.contains("disable-api-write") != 0) {
     m_api_write_disabled = true;
@@ -156,11 +187,15 @@ pgsql_update::factory::factory(const po::variables_map &opts)
     m_connection.set_session_var("default_transaction_read_only", "true");
 #endif
   }
+
+  // the connection is also used for read only transactions
+  prepare_statements(m_connection, m_prep_stmt,
+                     m_api_write_disabled ? prepared_statement::read : prepared_statement::update);
 }
 
 std::unique_ptr<data_update>
 pgsql_update::factory::make_data_update(Transaction_Owner_Base& to) const {
-  return std::make_unique<pgsql_update>(to, m_api_write_disabled);
+  return std::make_unique<pgsql_update>(to, m_api_write_disabled, m_invalidation_channel);
 }
 
 std::unique_ptr<Transaction_Owner_Base>
@@ -106,19 +106,49 @@ readonly_pgsql_selection::readonly_pgsql_selection(
     Transaction_Owner_Base& to)
     : m(to) {}
 
+const prepared_statement lookup_node_versions_statement{
+  "lookup_node_versions",
+  R"(SELECT n.id, n.version
+           FROM current_nodes n
+           WHERE n.id = ANY($1)
+        )"_M};
+
+const prepared_statement extract_nodes_statement{
+  "extract_nodes",
+  R"(SELECT n.id, n.latitude, n.longitude, n.visible,
+          to_char(n.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
+          n.changeset_id, n.version,
+          array_agg(t.k ORDER BY k) as tag_k,
+          array_agg(t.v ORDER BY k) as tag_v
+        FROM current_nodes n
+          LEFT JOIN current_node_tags t ON n.id=t.node_id
+        WHERE n.id = ANY($1)
+        GROUP BY n.id ORDER BY n.id)"_M};
+
+const prepared_statement extract_historic_nodes_statement{
+  "extract_historic_nodes",
+  R"(WITH wanted(id, version) AS (
+        SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
+      )
+      SELECT n.node_id AS id, n.latitude, n.longitude, n.visible,
+          to_char(n.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
+          n.changeset_id, n.version,
+          array_agg(t.k ORDER BY k) as tag_k,
+          array_agg(t.v ORDER BY k) as tag_v
+        FROM nodes n
+          INNER JOIN wanted x ON n.node_id = x.id AND n.version = x.version
+          LEFT JOIN node_tags t ON n.node_id = t.node_id AND n.version = t.version
+        GROUP BY n.node_id, n.version ORDER BY n.node_id, n.version)"_M};
+
 void readonly_pgsql_selection::write_nodes(output_formatter &formatter) {
 
   if (!sel_nodes.empty() && !sel_historic_nodes.empty()) {
     // both current nodes and historic nodes were selected,
     // lookup object versions, and handle request via historic nodes
 
-    logger::message("Fetching current_node versions");
+    logger::message(logger::level::debug, "Fetching current_node versions");
 
-    m.prepare("lookup_node_versions",
-        R"(SELECT n.id, n.version
-           FROM current_nodes n
-           WHERE n.id = ANY($1)
-        )"_M);
+    m.prepare(lookup_node_versions_statement);
 
     auto res = m.exec_prepared("lookup_node_versions", sel_nodes);
 
@@ -128,22 +158,13 @@ void readonly_pgsql_selection::write_nodes(output_formatter &formatter) {
     sel_nodes.clear();
   }
 
-  logger::message("Fetching nodes");
+  logger::message(logger::level::debug, "Fetching nodes");
 
   // get all nodes - they already contain their own tags, so
   // we don't need to do anything else.
   if (!sel_nodes.empty()) {
 
-    m.prepare("extract_nodes",
-      R"(SELECT n.id, n.latitude, n.longitude, n.visible,
-          to_char(n.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
-          n.changeset_id, n.version,
-          array_agg(t.k ORDER BY k) as tag_k,
-          array_agg(t.v ORDER BY k) as tag_v
-        FROM current_nodes n
-          LEFT JOIN current_node_tags t ON n.id=t.node_id
-        WHERE n.id = ANY($1)
-        GROUP BY n.id ORDER BY n.id)"_M);
+    m.prepare(extract_nodes_statement);
 
     auto result = m.exec_prepared("extract_nodes", sel_nodes);
     fetch_changesets(extract_changeset_ids(result), cc);
@@ -151,19 +172,7 @@ void readonly_pgsql_selection::write_nodes(output_formatter &formatter) {
   }
   else if (!sel_historic_nodes.empty()) {
 
-    m.prepare("extract_historic_nodes",
-      R"(WITH wanted(id, version) AS (
-        SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
-      )
-      SELECT n.node_id AS id, n.latitude, n.longitude, n.visible,
-          to_char(n.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
-          n.changeset_id, n.version,
-          array_agg(t.k ORDER BY k) as tag_k,
-          array_agg(t.v ORDER BY k) as tag_v
-        FROM nodes n
-          INNER JOIN wanted x ON n.node_id = x.id AND n.version = x.version
-          LEFT JOIN node_tags t ON n.node_id = t.node_id AND n.version = t.version
-        GROUP BY n.node_id, n.version ORDER BY n.node_id, n.version)"_M);
+    m.prepare(extract_historic_nodes_statement);
 
     std::vector<osm_nwr_id_t> ids;
     std::vector<osm_nwr_id_t> versions;
@@ -179,38 +188,16 @@ void readonly_pgsql_selection::write_nodes(output_formatter &formatter) {
   }
 }
 
-void readonly_pgsql_selection::write_ways(output_formatter &formatter) {
-
-  if (!sel_ways.empty() && !sel_historic_ways.empty()) {
-    // both current ways and historic ways were selected,
-    // lookup object versions, and handle request via historic ways
-
-    logger::message("Fetching current_way versions");
-
-    m.prepare("lookup_way_versions",
-        R"(SELECT w.id, w.version
+const prepared_statement lookup_way_versions_statement{
+  "lookup_way_versions",
+  R"(SELECT w.id, w.version
            FROM current_ways w
            WHERE w.id = ANY($1)
-        )"_M);
-
-    auto res = m.exec_prepared("lookup_way_versions", sel_ways);
-
-    for (const auto & row : res) {
-      sel_historic_ways.insert({row[0].as<osm_nwr_id_t>(), row[1].as<osm_version_t>()});
-    }
-    sel_ways.clear();
-  }
-
-  // grab the ways, way nodes and tags
-  // way nodes and tags are on a separate connections so that the
-  // entire result set can be streamed from a single query.
+        )"_M};
 
-  logger::message("Fetching ways");
-
-  if (!sel_ways.empty()) {
-
-    m.prepare("extract_ways",
-      R"(SELECT w.id, w.visible,
+const prepared_statement extract_ways_statement{
+  "extract_ways",
+  R"(SELECT w.id, w.visible,
           to_char(w.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
           w.changeset_id, w.version, t.keys as tag_k, t.values as tag_v,
           wn.node_ids as node_ids
@@ -226,16 +213,11 @@ void readonly_pgsql_selection::write_ways(output_formatter &formatter) {
                 (SELECT node_id FROM current_way_nodes WHERE w.id=way_id
                 ORDER BY sequence_id) x) wn ON true
         WHERE w.id = ANY($1)
-        ORDER BY w.id)"_M);
-
-    auto result = m.exec_prepared("extract_ways", sel_ways);
-    fetch_changesets(extract_changeset_ids(result), cc);
-    extract_ways(result, formatter, cc);
-  }
-  else if (!sel_historic_ways.empty()) {
+        ORDER BY w.id)"_M};
 
-    m.prepare("extract_historic_ways",
-      R"(WITH wanted(id, version) AS (
+const prepared_statement extract_historic_ways_statement{
+  "extract_historic_ways",
+  R"(WITH wanted(id, version) AS (
         SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
       )
       SELECT w.way_id AS id, w.visible,
@@ -255,7 +237,43 @@ void readonly_pgsql_selection::write_ways(output_formatter &formatter) {
                 (SELECT node_id FROM way_nodes
                 WHERE w.way_id=way_id AND w.version=version
                 ORDER BY sequence_id) x) wn ON true
-        ORDER BY w.way_id, w.version)"_M);
+        ORDER BY w.way_id, w.version)"_M};
+
+void readonly_pgsql_selection::write_ways(output_formatter &formatter) {
+
+  if (!sel_ways.empty() && !sel_historic_ways.empty()) {
+    // both current ways and historic ways were selected,
+    // lookup object versions, and handle request via historic ways
+
+    logger::message(logger::level::debug, "Fetching current_way versions");
+
+    m.prepare(lookup_way_versions_statement);
+
+    auto res = m.exec_prepared("lookup_way_versions", sel_ways);
+
+    for (const auto & row : res) {
+      sel_historic_ways.insert({row[0].as<osm_nwr_id_t>(), row[1].as<osm_version_t>()});
+    }
+    sel_ways.clear();
+  }
+
+  // grab the ways, way nodes and tags
+  // way nodes and tags are on a separate connections so that the
+  // entire result set can be streamed from a single query.
+
+  logger::message(logger::level::debug, "Fetching ways");
+
+  if (!sel_ways.empty()) {
+
+    m.prepare(extract_ways_statement);
+
+    auto result = m.exec_prepared("extract_ways", sel_ways);
+    fetch_changesets(extract_changeset_ids(result), cc);
+    extract_ways(result, formatter, cc);
+  }
+  else if (!sel_historic_ways.empty()) {
+
+    m.prepare(extract_historic_ways_statement);
 
     std::vector<osm_nwr_id_t> ids;
     std::vector<osm_nwr_id_t> versions;
@@ -273,34 +291,16 @@ void readonly_pgsql_selection::write_ways(output_formatter &formatter) {
   }
 }
 
-void readonly_pgsql_selection::write_relations(output_formatter &formatter) {
-
-  if (!sel_relations.empty() && !sel_historic_relations.empty()) {
-    // both current relation and historic relation were selected,
-    // lookup object versions, and handle request via historic relations
-
-    logger::message("Fetching current_relation versions");
-
-    m.prepare("lookup_relation_versions",
-        R"(SELECT r.id, r.version
+const prepared_statement lookup_relation_versions_statement{
+  "lookup_relation_versions",
+  R"(SELECT r.id, r.version
            FROM current_relations r
            WHERE r.id = ANY($1)
-        )"_M);
-
-    auto res = m.exec_prepared("lookup_relation_versions", sel_relations);
-
-    for (const auto & row : res) {
-      sel_historic_relations.insert({row[0].as<osm_nwr_id_t>(), row[1].as<osm_version_t>()});
-    }
-    sel_relations.clear();
-  }
-
-  logger::message("Fetching relations");
-
-  if (!sel_relations.empty()) {
+        )"_M};
 
-    m.prepare("extract_relations",
-      R"(SELECT r.id, r.visible,
+const prepared_statement extract_relations_statement{
+  "extract_relations",
+  R"(SELECT r.id, r.visible,
           to_char(r.timestamp,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp,
           r.changeset_id, r.version, t.keys as tag_k, t.values as tag_v,
           rm.types as member_types, rm.ids as member_ids, rm.roles as member_roles
@@ -317,17 +317,11 @@ void readonly_pgsql_selection::write_relations(output_formatter &formatter) {
                 (SELECT * FROM current_relation_members WHERE r.id=relation_id
                 ORDER BY sequence_id) x) rm ON true
         WHERE r.id = ANY($1)
-        ORDER BY r.id)"_M);
+        ORDER BY r.id)"_M};
 
-    auto result = m.exec_prepared("extract_relations", sel_relations);
-
-    fetch_changesets(extract_changeset_ids(result), cc);
-    extract_relations(result, formatter, cc);
-  }
-  else if (!sel_historic_relations.empty()) {
-
-    m.prepare("extract_historic_relations",
-      R"(WITH wanted(id, version) AS (
+const prepared_statement extract_historic_relations_statement{
+  "extract_historic_relations",
+  R"(WITH wanted(id, version) AS (
         SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
       )
       SELECT r.relation_id AS id, r.visible,
@@ -347,7 +341,40 @@ void readonly_pgsql_selection::write_relations(output_formatter &formatter) {
               FROM
                 (SELECT * FROM relation_members WHERE r.relation_id=relation_id AND r.version=version
                 ORDER BY sequence_id) x) rm ON true
-        ORDER BY r.relation_id, r.version)"_M);
+        ORDER BY r.relation_id, r.version)"_M};
+
+void readonly_pgsql_selection::write_relations(output_formatter &formatter) {
+
+  if (!sel_relations.empty() && !sel_historic_relations.empty()) {
+    // both current relation and historic relation were selected,
+    // lookup object versions, and handle request via historic relations
+
+    logger::message(logger::level::debug, "Fetching current_relation versions");
+
+    m.prepare(lookup_relation_versions_statement);
+
+    auto res = m.exec_prepared("lookup_relation_versions", sel_relations);
+
+    for (const auto & row : res) {
+      sel_historic_relations.insert({row[0].as<osm_nwr_id_t>(), row[1].as<osm_version_t>()});
+    }
+    sel_relations.clear();
+  }
+
+  logger::message(logger::level::debug, "Fetching relations");
+
+  if (!sel_relations.empty()) {
+
+    m.prepare(extract_relations_statement);
+
+    auto result = m.exec_prepared("extract_relations", sel_relations);
+
+    fetch_changesets(extract_changeset_ids(result), cc);
+    extract_relations(result, formatter, cc);
+  }
+  else if (!sel_historic_relations.empty()) {
+
+    m.prepare(extract_historic_relations_statement);
 
     std::vector<osm_nwr_id_t> ids;
     std::vector<osm_nwr_id_t> versions;
@@ -365,14 +392,9 @@ void readonly_pgsql_selection::write_relations(output_formatter &formatter) {
   }
 }
 
-void readonly_pgsql_selection::write_changesets(output_formatter &formatter,
-                                                const std::chrono::system_clock::time_point &now) {
-
-  if (sel_changesets.empty())
-    return;
-
-  m.prepare("extract_changesets",
-      R"(SELECT c.id,
+const prepared_statement extract_changesets_statement{
+  "extract_changesets",
+  R"(SELECT c.id,
         to_char(c.created_at,'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS created_at,
         to_char(c.closed_at, 'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS closed_at,
         c.min_lat, c.max_lat, c.min_lon, c.max_lon,
@@ -400,7 +422,15 @@ void readonly_pgsql_selection::write_changesets(output_formatter &formatter,
            FROM changeset_comments cc JOIN users u ON cc.author_id = u.id
            where cc.changeset_id=c.id AND cc.visible ORDER BY cc.created_at) x
          )cc ON true
-      WHERE c.id = ANY($1))"_M);
+      WHERE c.id = ANY($1))"_M};
+
+void readonly_pgsql_selection::write_changesets(output_formatter &formatter,
+                                                const std::chrono::system_clock::time_point &now) {
+
+  if (sel_changesets.empty())
+    return;
+
+  m.prepare(extract_changesets_statement);
 
   pqxx::result changesets = m.exec_prepared("extract_changesets", sel_changesets);
 
@@ -409,75 +439,127 @@ void readonly_pgsql_selection::write_changesets(output_formatter &formatter,
   extract_changesets(changesets, formatter, cc, now, include_changeset_discussions);
 }
 
+const prepared_statement visible_node_statement{
+  "visible_node",
+  R"(SELECT visible FROM current_nodes WHERE id = $1)"};
+
 data_selection::visibility_t
 readonly_pgsql_selection::check_node_visibility(osm_nwr_id_t id) {
-  m.prepare("visible_node",
-     R"(SELECT visible FROM current_nodes WHERE id = $1)");
+  m.prepare(visible_node_statement);
   return check_table_visibility(m, id, "visible_node");
 }
 
+const prepared_statement visible_way_statement{
+  "visible_way",
+  R"(SELECT visible FROM current_ways WHERE id = $1)"};
+
 data_selection::visibility_t
 readonly_pgsql_selection::check_way_visibility(osm_nwr_id_t id) {
-  m.prepare("visible_way",
-     R"(SELECT visible FROM current_ways WHERE id = $1)");
+  m.prepare(visible_way_statement);
   return check_table_visibility(m, id, "visible_way");
 }
 
+const prepared_statement visible_relation_statement{
+  "visible_relation",
+  R"(SELECT visible FROM current_relations WHERE id = $1)"};
+
 data_selection::visibility_t
 readonly_pgsql_selection::check_relation_visibility(osm_nwr_id_t id) {
 
-  m.prepare("visible_relation", R"(SELECT visible FROM current_relations WHERE id = $1)");
+  m.prepare(visible_relation_statement);
 
   return check_table_visibility(m, id, "visible_relation");
 }
 
+const prepared_statement max_node_id_statement{
+  "max_node_id",
+  R"(SELECT COALESCE(MAX(id), 0) FROM current_nodes)"};
+
+const prepared_statement max_way_id_statement{
+  "max_way_id",
+  R"(SELECT COALESCE(MAX(id), 0) FROM current_ways)"};
+
+const prepared_statement max_relation_id_statement{
+  "max_relation_id",
+  R"(SELECT COALESCE(MAX(id), 0) FROM current_relations)"};
+
+std::optional<osm_nwr_id_t>
+readonly_pgsql_selection::max_element_id(element_type type) {
+
+  // the primary keys make these a lookup of the last index entry
+  switch (type) {
+  case element_type::node:
+    m.prepare(max_node_id_statement);
+    return m.exec_prepared("max_node_id")[0][0].as<osm_nwr_id_t>();
+  case element_type::way:
+    m.prepare(max_way_id_statement);
+    return m.exec_prepared("max_way_id")[0][0].as<osm_nwr_id_t>();
+  case element_type::relation:
+    m.prepare(max_relation_id_statement);
+    return m.exec_prepared("max_relation_id")[0][0].as<osm_nwr_id_t>();
+  default:
+    return {};
+  }
+}
+
+const prepared_statement select_nodes_statement{
+  "select_nodes",
+  R"(SELECT id FROM current_nodes WHERE id = ANY($1))"};
+
 int readonly_pgsql_selection::select_nodes(const std::vector<osm_nwr_id_t> &ids) {
   if (ids.empty())
     return 0;
 
-  m.prepare("select_nodes", R"(SELECT id FROM current_nodes WHERE id = ANY($1))");
+  m.prepare(select_nodes_statement);
 
   return insert_results(m.exec_prepared("select_nodes", ids), sel_nodes);
 }
 
+const prepared_statement select_ways_statement{
+  "select_ways",
+  R"(SELECT id FROM current_ways WHERE id = ANY($1))"};
+
 int readonly_pgsql_selection::select_ways(const std::vector<osm_nwr_id_t> &ids) {
   if (ids.empty())
     return 0;
 
-  m.prepare("select_ways", R"(SELECT id FROM current_ways WHERE id = ANY($1))");
+  m.prepare(select_ways_statement);
 
   return insert_results(m.exec_prepared("select_ways", ids), sel_ways);
 }
 
+const prepared_statement select_relations_statement{
+  "select_relations",
+  R"(SELECT id FROM current_relations WHERE id = ANY($1))"};
+
 int readonly_pgsql_selection::select_relations(const std::vector<osm_nwr_id_t> &ids) {
   if (ids.empty())
     return 0;
 
-  m.prepare("select_relations", R"(SELECT id FROM current_relations WHERE id = ANY($1))");
+  m.prepare(select_relations_statement);
 
   return insert_results(m.exec_prepared("select_relations", ids),
                         sel_relations);
 }
 
-int readonly_pgsql_selection::select_nodes_from_bbox(const bbox &bounds,
-                                                     int max_nodes) {
-  const std::vector<tile_id_t> tiles = tiles_for_area(
-      bounds.minlat, bounds.minlon, bounds.maxlat, bounds.maxlon);
-
-  // select nodes with bbox
- m.prepare("visible_node_in_bbox",
-    R"(SELECT id
+const prepared_statement visible_node_in_bbox_statement{
+  "visible_node_in_bbox",
+  R"(SELECT id
       FROM current_nodes
       WHERE tile = ANY($1)
         AND latitude BETWEEN $2 AND $3
         AND longitude BETWEEN $4 AND $5
         AND visible = true
-      LIMIT $6)"_M);
+      LIMIT $6)"_M};
 
-  // hack around problem with postgres' statistics, which was
-  // making it do seq scans all the time on smaug...
-  m.exec("set enable_mergejoin=false");
-  m.exec("set enable_hashjoin=false");
+int readonly_pgsql_selection::select_nodes_from_bbox(const bbox &bounds,
+                                                     int max_nodes) {
+  const std::vector<tile_id_t> tiles = tiles_for_area(
+      bounds.minlat, bounds.minlon, bounds.maxlat, bounds.maxlon);
+
+  // select nodes with bbox, merge and hash joins are disabled for
+  // the session by the factory
+  m.prepare(visible_node_in_bbox_statement);
 
   return insert_results(
       m.exec_prepared("visible_node_in_bbox", tiles,
@@ -489,89 +571,114 @@ int readonly_pgsql_selection::select_nodes_from_bbox(const bbox &bounds,
       sel_nodes);
 }
 
+const prepared_statement nodes_from_relations_statement{
+  "nodes_from_relations",
+  R"(SELECT DISTINCT rm.member_id AS id
+	 FROM current_relation_members rm
+	 WHERE rm.member_type = 'Node'
+	   AND rm.relation_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_nodes_from_relations() {
-  logger::message("Filling sel_nodes (from relations)");
+  logger::message(logger::level::debug, "Filling sel_nodes (from relations)");
 
   if (!sel_relations.empty()) {
 
-    m.prepare("nodes_from_relations",
-       R"(SELECT DISTINCT rm.member_id AS id
-	 FROM current_relation_members rm
-	 WHERE rm.member_type = 'Node'
-	   AND rm.relation_id = ANY($1) ORDER by id)"_M);
+    m.prepare(nodes_from_relations_statement);
 
     insert_results(m.exec_prepared("nodes_from_relations", sel_relations),
                    sel_nodes);
   }
 }
 
+const prepared_statement ways_from_nodes_statement{
+  "ways_from_nodes",
+  R"(SELECT DISTINCT wn.way_id AS id
+	 FROM current_way_nodes wn
+	 WHERE wn.node_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_ways_from_nodes() {
-  logger::message("Filling sel_ways (from nodes)");
+  logger::message(logger::level::debug, "Filling sel_ways (from nodes)");
 
   if (!sel_nodes.empty()) {
-    m.prepare("ways_from_nodes",
-       R"(SELECT DISTINCT wn.way_id AS id
-	 FROM current_way_nodes wn
-	 WHERE wn.node_id = ANY($1) ORDER by id)"_M);
+    m.prepare(ways_from_nodes_statement);
 
     insert_results(m.exec_prepared("ways_from_nodes", sel_nodes), sel_ways);
   }
 }
 
+const prepared_statement ways_from_relations_statement{
+  "ways_from_relations",
+  R"(SELECT DISTINCT rm.member_id AS id
+	 FROM current_relation_members rm
+	 WHERE rm.member_type = 'Way'
+	   AND rm.relation_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_ways_from_relations() {
-  logger::message("Filling sel_ways (from relations)");
+  logger::message(logger::level::debug, "Filling sel_ways (from relations)");
 
   if (!sel_relations.empty()) {
-    m.prepare("ways_from_relations",
-       R"(SELECT DISTINCT rm.member_id AS id
-	 FROM current_relation_members rm
-	 WHERE rm.member_type = 'Way'
-	   AND rm.relation_id = ANY($1) ORDER by id)"_M);
+    m.prepare(ways_from_relations_statement);
 
     insert_results(m.exec_prepared("ways_from_relations", sel_relations),
                    sel_ways);
   }
 }
 
+const prepared_statement relation_parents_of_ways_statement{
+  "relation_parents_of_ways",
+  R"(SELECT DISTINCT rm.relation_id AS id
+	 FROM current_relation_members rm
+	 WHERE rm.member_type = 'Way'
+	   AND rm.member_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_relations_from_ways() {
-  logger::message("Filling sel_relations (from ways)");
+  logger::message(logger::level::debug, "Filling sel_relations (from ways)");
 
   if (!sel_ways.empty()) {
-    m.prepare("relation_parents_of_ways",
-       R"(SELECT DISTINCT rm.relation_id AS id
-	 FROM current_relation_members rm
-	 WHERE rm.member_type = 'Way'
-	   AND rm.member_id = ANY($1) ORDER by id)"_M);
+    m.prepare(relation_parents_of_ways_statement);
 
     insert_results(m.exec_prepared("relation_parents_of_ways", sel_ways),
                    sel_relations);
   }
 }
 
+const prepared_statement nodes_from_ways_statement{
+  "nodes_from_ways",
+  R"(SELECT DISTINCT wn.node_id AS id
+	 FROM current_way_nodes wn
+	 WHERE wn.way_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_nodes_from_way_nodes() {
   if (!sel_ways.empty()) {
-    m.prepare("nodes_from_ways",
-       R"(SELECT DISTINCT wn.node_id AS id
-	 FROM current_way_nodes wn
-	 WHERE wn.way_id = ANY($1) ORDER by id)"_M);
+    m.prepare(nodes_from_ways_statement);
 
     insert_results(m.exec_prepared("nodes_from_ways", sel_ways), sel_nodes);
   }
 }
 
-void readonly_pgsql_selection::select_relations_from_nodes() {
-  if (!sel_nodes.empty()) {
-    m.prepare("relation_parents_of_nodes",
-       R"(SELECT DISTINCT rm.relation_id AS id
+const prepared_statement relation_parents_of_nodes_statement{
+  "relation_parents_of_nodes",
+  R"(SELECT DISTINCT rm.relation_id AS id
 	 FROM current_relation_members rm
 	 WHERE rm.member_type = 'Node'
-	   AND rm.member_id = ANY($1) ORDER by id)"_M);
+	   AND rm.member_id = ANY($1) ORDER by id)"_M};
+
+void readonly_pgsql_selection::select_relations_from_nodes() {
+  if (!sel_nodes.empty()) {
+    m.prepare(relation_parents_of_nodes_statement);
 
     insert_results(m.exec_prepared("relation_parents_of_nodes", sel_nodes),
                    sel_relations);
   }
 }
 
+const prepared_statement relation_parents_of_relations_statement{
+  "relation_parents_of_relations",
+  R"(SELECT DISTINCT rm.relation_id AS id
+         FROM current_relation_members rm
+         WHERE rm.member_type = 'Relation'
+           AND rm.member_id = ANY($1) ORDER by id)"_M};
+
 void readonly_pgsql_selection::select_relations_from_relations(bool drop_relations) {
   if (!sel_relations.empty()) {
 
@@ -581,11 +688,7 @@ void readonly_pgsql_selection::select_relations_from_relations(bool drop_relatio
     else
       sel = sel_relations;
 
-    m.prepare("relation_parents_of_relations",
-       R"(SELECT DISTINCT rm.relation_id AS id
-         FROM current_relation_members rm
-         WHERE rm.member_type = 'Relation'
-           AND rm.member_id = ANY($1) ORDER by id)"_M);
+    m.prepare(relation_parents_of_relations_statement);
 
     insert_results(
         m.exec_prepared("relation_parents_of_relations", sel),
@@ -593,13 +696,16 @@ void readonly_pgsql_selection::select_relations_from_relations(bool drop_relatio
   }
 }
 
-void readonly_pgsql_selection::select_relations_members_of_relations() {
-  if (!sel_relations.empty()) {
-    m.prepare("relation_members_of_relations",
-       R"(SELECT DISTINCT rm.member_id AS id
+const prepared_statement relation_members_of_relations_statement{
+  "relation_members_of_relations",
+  R"(SELECT DISTINCT rm.member_id AS id
 	 FROM current_relation_members rm
 	 WHERE rm.member_type = 'Relation'
-	   AND rm.relation_id = ANY($1) ORDER by id)"_M);
+	   AND rm.relation_id = ANY($1) ORDER by id)"_M};
+
+void readonly_pgsql_selection::select_relations_members_of_relations() {
+  if (!sel_relations.empty()) {
+    m.prepare(relation_members_of_relations_statement);
 
     insert_results(
         m.exec_prepared("relation_members_of_relations", sel_relations),
@@ -607,20 +713,23 @@ void readonly_pgsql_selection::select_relations_members_of_relations() {
   }
 }
 
+const prepared_statement select_historical_nodes_statement{
+  "select_historical_nodes",
+  R"(WITH wanted(id, version) AS (
+       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
+     )
+     SELECT n.node_id AS id, n.version
+       FROM nodes n
+       INNER JOIN wanted w ON n.node_id = w.id AND n.version = w.version
+       WHERE (n.redaction_id IS NULL OR $3 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_historical_nodes(
   const std::vector<osm_edition_t> &eds) {
 
   if (eds.empty())
     return 0;
 
-  m.prepare("select_historical_nodes",
-     R"(WITH wanted(id, version) AS (
-       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
-     )
-     SELECT n.node_id AS id, n.version
-       FROM nodes n
-       INNER JOIN wanted w ON n.node_id = w.id AND n.version = w.version
-       WHERE (n.redaction_id IS NULL OR $3 = TRUE))"_M);
+  m.prepare(select_historical_nodes_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<osm_version_t> vers;
@@ -637,20 +746,23 @@ int readonly_pgsql_selection::select_historical_nodes(
     sel_historic_nodes);
 }
 
+const prepared_statement select_historical_ways_statement{
+  "select_historical_ways",
+  R"(WITH wanted(id, version) AS (
+       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
+     )
+     SELECT w.way_id AS id, w.version
+       FROM ways w
+       INNER JOIN wanted x ON w.way_id = x.id AND w.version = x.version
+       WHERE (w.redaction_id IS NULL OR $3 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_historical_ways(
   const std::vector<osm_edition_t> &eds) {
 
   if (eds.empty())
     return 0;
 
-  m.prepare("select_historical_ways",
-     R"(WITH wanted(id, version) AS (
-       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
-     )
-     SELECT w.way_id AS id, w.version
-       FROM ways w
-       INNER JOIN wanted x ON w.way_id = x.id AND w.version = x.version
-       WHERE (w.redaction_id IS NULL OR $3 = TRUE))"_M);
+  m.prepare(select_historical_ways_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<osm_version_t> vers;
@@ -667,20 +779,23 @@ int readonly_pgsql_selection::select_historical_ways(
     sel_historic_ways);
 }
 
+const prepared_statement select_historical_relations_statement{
+  "select_historical_relations",
+  R"(WITH wanted(id, version) AS (
+       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
+     )
+     SELECT r.relation_id AS id, r.version
+       FROM relations r
+       INNER JOIN wanted x ON r.relation_id = x.id AND r.version = x.version
+       WHERE (r.redaction_id IS NULL OR $3 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_historical_relations(
   const std::vector<osm_edition_t> &eds) {
 
   if (eds.empty())
     return 0;
 
-  m.prepare("select_historical_relations",
-     R"(WITH wanted(id, version) AS (
-       SELECT * FROM unnest(CAST($1 AS bigint[]), CAST($2 AS bigint[]))
-     )
-     SELECT r.relation_id AS id, r.version
-       FROM relations r
-       INNER JOIN wanted x ON r.relation_id = x.id AND r.version = x.version
-       WHERE (r.redaction_id IS NULL OR $3 = TRUE))"_M);
+  m.prepare(select_historical_relations_statement);
 
   std::vector<osm_nwr_id_t> ids;
   std::vector<osm_version_t> vers;
@@ -697,51 +812,60 @@ int readonly_pgsql_selection::select_historical_relations(
     sel_historic_relations);
 }
 
+const prepared_statement select_nodes_history_statement{
+  "select_nodes_history",
+  R"(SELECT node_id AS id, version
+       FROM nodes
+       WHERE node_id = ANY($1) AND
+             (redaction_id IS NULL OR $2 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_nodes_with_history(
   const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return 0;
 
-  m.prepare("select_nodes_history",
-     R"(SELECT node_id AS id, version
-       FROM nodes
-       WHERE node_id = ANY($1) AND
-             (redaction_id IS NULL OR $2 = TRUE))"_M);
+  m.prepare(select_nodes_history_statement);
 
   return insert_results(
     m.exec_prepared("select_nodes_history", ids, m_redactions_visible),
     sel_historic_nodes);
 }
 
+const prepared_statement select_ways_history_statement{
+  "select_ways_history",
+  R"(SELECT way_id AS id, version
+       FROM ways
+       WHERE way_id = ANY($1) AND
+             (redaction_id IS NULL OR $2 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_ways_with_history(
   const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return 0;
 
-  m.prepare("select_ways_history",
-     R"(SELECT way_id AS id, version
-       FROM ways
-       WHERE way_id = ANY($1) AND
-             (redaction_id IS NULL OR $2 = TRUE))"_M);
+  m.prepare(select_ways_history_statement);
 
   return insert_results(
     m.exec_prepared("select_ways_history", ids, m_redactions_visible),
     sel_historic_ways);
 }
 
+const prepared_statement select_relations_history_statement{
+  "select_relations_history",
+  R"(SELECT relation_id AS id, version
+       FROM relations
+       WHERE relation_id = ANY($1) AND
+             (redaction_id IS NULL OR $2 = TRUE))"_M};
+
 int readonly_pgsql_selection::select_relations_with_history(
   const std::vector<osm_nwr_id_t> &ids) {
 
   if (ids.empty())
     return 0;
 
-  m.prepare("select_relations_history",
-     R"(SELECT relation_id AS id, version
-       FROM relations
-       WHERE relation_id = ANY($1) AND
-             (redaction_id IS NULL OR $2 = TRUE))"_M);
+  m.prepare(select_relations_history_statement);
 
   return insert_results(m.exec_prepared("select_relations_history", ids, m_redactions_visible),
     sel_historic_relations);
@@ -751,29 +875,38 @@ void readonly_pgsql_selection::set_redactions_visible(bool visible) {
   m_redactions_visible = visible;
 }
 
-int readonly_pgsql_selection::select_historical_by_changesets(
-  const std::vector<osm_changeset_id_t> &ids) {
-
-  if (ids.empty())
-    return 0;
-
-  m.prepare("select_nodes_by_changesets",
-       R"(SELECT n.node_id AS id, n.version
+const prepared_statement select_nodes_by_changesets_statement{
+  "select_nodes_by_changesets",
+  R"(SELECT n.node_id AS id, n.version
        FROM nodes n
        WHERE n.changeset_id = ANY($1)
-         AND (n.redaction_id IS NULL OR $2 = TRUE))"_M);
+         AND (n.redaction_id IS NULL OR $2 = TRUE))"_M};
 
-  m.prepare("select_ways_by_changesets",
-      R"(SELECT w.way_id AS id, w.version
+const prepared_statement select_ways_by_changesets_statement{
+  "select_ways_by_changesets",
+  R"(SELECT w.way_id AS id, w.version
       FROM ways w
       WHERE w.changeset_id = ANY($1)
-        AND (w.redaction_id IS NULL OR $2 = TRUE))"_M);
+        AND (w.redaction_id IS NULL OR $2 = TRUE))"_M};
 
-  m.prepare("select_relations_by_changesets",
-      R"(SELECT r.relation_id AS id, r.version
+const prepared_statement select_relations_by_changesets_statement{
+  "select_relations_by_changesets",
+  R"(SELECT r.relation_id AS id, r.version
       FROM relations r
       WHERE r.changeset_id = ANY($1)
-        AND (r.redaction_id IS NULL OR $2 = TRUE))"_M);
+        AND (r.redaction_id IS NULL OR $2 = TRUE))"_M};
+
+int readonly_pgsql_selection::select_historical_by_changesets(
+  const std::vector<osm_changeset_id_t> &ids) {
+
+  if (ids.empty())
+    return 0;
+
+  m.prepare(select_nodes_by_changesets_statement);
+
+  m.prepare(select_ways_by_changesets_statement);
+
+  m.prepare(select_relations_by_changesets_statement);
 
 
   int selected = insert_results(m.exec_prepared("select_nodes_by_changesets", ids, m_redactions_visible),
@@ -799,15 +932,18 @@ void readonly_pgsql_selection::drop_relations() {
 }
 
 
+const prepared_statement select_changesets_statement{
+  "select_changesets",
+  R"(SELECT id
+       FROM changesets
+       WHERE id = ANY($1))"_M};
+
 int readonly_pgsql_selection::select_changesets(const std::vector<osm_changeset_id_t> &ids) {
 
   if (ids.empty())
     return 0;
 
-  m.prepare("select_changesets",
-     R"(SELECT id
-       FROM changesets
-       WHERE id = ANY($1))"_M);
+  m.prepare(select_changesets_statement);
 
   return insert_results(m.exec_prepared("select_changesets", ids), sel_changesets);
 }
@@ -820,24 +956,30 @@ bool readonly_pgsql_selection::supports_user_details() const {
   return true;
 }
 
+const prepared_statement check_user_blocked_statement{
+  "check_user_blocked",
+  R"(SELECT id FROM "user_blocks"
+          WHERE "user_blocks"."user_id" = $1
+            AND (needs_view or ends_at > (now() at time zone 'utc')) LIMIT 1 )"_M};
+
 bool readonly_pgsql_selection::is_user_blocked(const osm_user_id_t id) {
 
-  m.prepare("check_user_blocked",
-    R"(SELECT id FROM "user_blocks"
-          WHERE "user_blocks"."user_id" = $1
-            AND (needs_view or ends_at > (now() at time zone 'utc')) LIMIT 1 )"_M);
+  m.prepare(check_user_blocked_statement);
 
   auto res = m.exec_prepared("check_user_blocked", id);
   return !res.empty();
 }
 
+const prepared_statement roles_for_user_statement{
+  "roles_for_user",
+  R"(SELECT role FROM user_roles WHERE user_id = $1)"};
+
 std::set< osm_user_role_t > readonly_pgsql_selection::get_roles_for_user(osm_user_id_t id)
 {
   std::set<osm_user_role_t> roles;
 
   // return all the roles to which the user belongs.
-  m.prepare("roles_for_user",
-    R"(SELECT role FROM user_roles WHERE user_id = $1)");
+  m.prepare(roles_for_user_statement);
 
   auto res = m.exec_prepared("roles_for_user", id);
 
@@ -855,13 +997,9 @@ std::set< osm_user_role_t > readonly_pgsql_selection::get_roles_for_user(osm_use
   return roles;
 }
 
-std::optional< osm_user_id_t > readonly_pgsql_selection::get_user_id_for_oauth2_token(
-    const std::string &token_id, bool &expired, bool &revoked,
-    bool &allow_api_write)
-{
-  // return details for OAuth 2.0 access token
-  m.prepare("oauth2_access_token",
-    R"(SELECT resource_owner_id as user_id,
+const prepared_statement oauth2_access_token_statement{
+  "oauth2_access_token",
+  R"(SELECT resource_owner_id as user_id,
          CASE WHEN expires_in IS NULL THEN false
               ELSE (created_at + expires_in * interval '1' second) < now() at time zone 'utc'
          END as expired,
@@ -869,7 +1007,14 @@ std::optional< osm_user_id_t > readonly_pgsql_selection::get_user_id_for_oauth2_
          'write_api' = any(string_to_array(coalesce(scopes,''), ' ')) as allow_api_write
        FROM oauth_access_tokens
        WHERE token = $1
-          OR token = encode(sha256($1::bytea), 'hex'))"_M);
+          OR token = encode(sha256($1::bytea), 'hex'))"_M};
+
+std::optional< osm_user_id_t > readonly_pgsql_selection::get_user_id_for_oauth2_token(
+    const std::string &token_id, bool &expired, bool &revoked,
+    bool &allow_api_write)
+{
+  // return details for OAuth 2.0 access token
+  m.prepare(oauth2_access_token_statement);
 
   auto res = m.exec_prepared("oauth2_access_token", token_id);
 
@@ -888,12 +1033,15 @@ std::optional< osm_user_id_t > readonly_pgsql_selection::get_user_id_for_oauth2_
   }
 }
 
+const prepared_statement is_user_active_statement{
+  "is_user_active",
+  R"(SELECT id FROM users
+            WHERE id = $1
+            AND (status = 'active' or status = 'confirmed'))"_M};
+
 bool readonly_pgsql_selection::is_user_active(const osm_user_id_t id)
 {
-  m.prepare("is_user_active",
-         R"(SELECT id FROM users
-            WHERE id = $1
-            AND (status = 'active' or status = 'confirmed'))"_M);
+  m.prepare(is_user_active_statement);
 
   auto res = m.exec_prepared("is_user_active", id);
   return (!res.empty());
@@ -910,6 +1058,11 @@ std::set< osm_changeset_id_t > readonly_pgsql_selection::extract_changeset_ids(c
   return changeset_ids;
 }
 
+const prepared_statement extract_changeset_userdetails_statement{
+  "extract_changeset_userdetails",
+  R"(SELECT c.id, u.data_public, u.display_name, u.id from users u
+                   join changesets c on u.id=c.user_id where c.id = ANY($1))"_M};
+
 void readonly_pgsql_selection::fetch_changesets(const std::set< osm_changeset_id_t >& all_ids, std::map<osm_changeset_id_t, changeset>& cc ) {
 
   std::set< osm_changeset_id_t> ids;
@@ -924,9 +1077,7 @@ void readonly_pgsql_selection::fetch_changesets(const std::set< osm_changeset_id
   if (ids.empty())
     return;
 
-  m.prepare("extract_changeset_userdetails",
-      R"(SELECT c.id, u.data_public, u.display_name, u.id from users u
-                   join changesets c on u.id=c.user_id where c.id = ANY($1))"_M);
+  m.prepare(extract_changeset_userdetails_statement);
 
   pqxx::result res = m.exec_prepared("extract_changeset_userdetails", ids);
 
@@ -936,7 +1087,7 @@ void readonly_pgsql_selection::fetch_changesets(const std::set< osm_changeset_id
 
     // Multiple results for one changeset?
     if (cc.contains(cs)) {
-      logger::message(
+      logger::message(logger::level::error,
           fmt::format("ERROR: Request for user data associated with changeset {:d} failed: returned multiple rows.", cs));
       throw http::server_error(
           fmt::format("Possible database inconsistency with changeset {:d}.", cs));
@@ -961,7 +1112,7 @@ void readonly_pgsql_selection::fetch_changesets(const std::set< osm_changeset_id
   // Missing changeset in query result?
   for (const auto & id : ids) {
     if (!cc.contains(id)) {
-      logger::message(
+      logger::message(logger::level::error,
           fmt::format("ERROR: Request for user data associated with changeset {:d} failed: returned 0 rows.", id));
       throw http::server_error(
           fmt::format("Possible database inconsistency with changeset {:d}.", id));
@@ -984,6 +1135,19 @@ readonly_pgsql_selection::factory::factory(const po::variables_map &opts)
 #else
   m_connection.set_session_var("default_transaction_read_only", "true");
 #endif
+
+  // hack around problem with postgres' statistics, which was
+  // making it do seq scans all the time on smaug... set once for
+  // the session, rather than before each bbox query
+#if PQXX_VERSION_MAJOR < 7
+  m_connection.set_variable("enable_mergejoin", "false");
+  m_connection.set_variable("enable_hashjoin", "false");
+#else
+  m_connection.set_session_var("enable_mergejoin", "false");
+  m_connection.set_session_var("enable_hashjoin", "false");
+#endif
+
+  prepare_statements(m_connection, m_prep_stmt, prepared_statement::read);
 }
 
 
@@ -0,0 +1,102 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/apidb/slow_query_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace slow_query_log {
+
+namespace {
+
+int log_fd = -1;
+std::chrono::steady_clock::duration log_threshold{};
+double log_explain_rate = 0;
+
+} // anonymous namespace
+
+void initialise(const std::string &filename, std::chrono::milliseconds threshold,
+                double explain_rate) {
+  if (log_fd >= 0) {
+    close(log_fd);
+    log_fd = -1;
+  }
+  if (filename.empty())
+    return;
+
+  log_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (log_fd < 0)
+    throw std::runtime_error(fmt::format("Failed to open slow query log {}: {}",
+                                         filename, std::strerror(errno)));
+  log_threshold = threshold;
+  log_explain_rate = std::clamp(explain_rate, 0.0, 1.0);
+}
+
+bool enabled() noexcept {
+  return log_fd >= 0;
+}
+
+bool is_slow(std::chrono::steady_clock::duration elapsed) noexcept {
+  return enabled() && elapsed >= log_threshold;
+}
+
+bool sample_explain() {
+  if (log_explain_rate <= 0)
+    return false;
+  thread_local std::minstd_rand gen(std::random_device{}());
+  return std::uniform_real_distribution<double>(0.0, 1.0)(gen) < log_explain_rate;
+}
+
+void write(std::string_view statement, std::chrono::steady_clock::duration elapsed,
+           std::size_t rows, std::string_view parameters, std::string_view plan) noexcept {
+  if (!enabled())
+    return;
+
+  try {
+    const time_t now = time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%FT%T", &tm);
+
+    // plan lines are indented, so that entries are easy to tell apart
+    std::string entry = fmt::format("[{} #{}] Slow statement {} took {:d} ms, returning {:d} rows, parameters: {}\n",
+        timestamp, getpid(), statement,
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), rows,
+        parameters.empty() ? "none" : parameters);
+    for (auto line : std::views::split(plan, '\n')) {
+      if (!line.empty())
+        entry += fmt::format("    {}\n", std::string_view(line.begin(), line.end()));
+    }
+
+    // a single write, so that entries of several processes don't interleave
+    std::string_view data(entry);
+    while (!data.empty()) {
+      const auto written = ::write(log_fd, data.data(), data.size());
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      data.remove_prefix(written);
+    }
+  } catch (...) {
+    // logging must never cause a request to fail
+  }
+}
+
+} // namespace slow_query_log
@@ -0,0 +1,73 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/apidb/statement_catalog.hpp"
+#include "cgimap/logger.hpp"
+
+#include <utility>
+
+#include <fmt/core.h>
+
+namespace {
+
+std::vector<const prepared_statement *> &statements() {
+  // statements are defined during static initialisation of other
+  // translation units, so the catalog has to exist before them
+  static std::vector<const prepared_statement *> catalog;
+  return catalog;
+}
+
+} // anonymous namespace
+
+prepared_statement::prepared_statement(std::string name, std::string definition, use used_on)
+  : name(std::move(name)), definition(std::move(definition)), used_on(used_on) {
+
+  statements().push_back(this);
+}
+
+const std::vector<const prepared_statement *> &prepared_statement::catalog() {
+  return statements();
+}
+
+void prepare_statements(pqxx::connection &c, std::set<std::string> &prepared,
+                        prepared_statement::use used_on) {
+#if PQXX_VERSION_MAJOR >= 7
+  // libpqxx doesn't pipeline PQprepare, so the statements are prepared
+  // with a single query made up of PREPARE commands instead
+  std::string query;
+  for (const auto *s : prepared_statement::catalog()) {
+    if (s->used_on <= used_on && !prepared.contains(s->name))
+      query += fmt::format("PREPARE {} AS {};\n", s->name, s->definition);
+  }
+
+  if (query.empty())
+    return;
+
+  try {
+    pqxx::nontransaction txn(c);
+    txn.exec(query);
+  } catch (const pqxx::sql_error &e) {
+    logger::message(logger::level::warning,
+                    fmt::format("Preparing statements failed, they are prepared when first used instead: {}", e.what()));
+  }
+
+  // the commands before a failing one may still have been successful
+  pqxx::nontransaction txn(c);
+  for (const auto &row : txn.exec("SELECT name FROM pg_prepared_statements"))
+    prepared.insert(row[0].as<std::string>());
+
+  logger::message(fmt::format("Prepared {:d} statements", prepared.size()));
+#else
+  // with libpqxx 6, statements need to be registered with the connection
+  // by Transaction_Manager::prepare before they can be executed
+  (void)c;
+  (void)prepared;
+  (void)used_on;
+#endif
+}
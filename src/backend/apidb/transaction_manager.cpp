@@ -30,13 +30,16 @@ std::set<std::string>& Transaction_Owner_ReadOnly::get_prep_stmt()
 
 Transaction_Owner_ReadWrite::Transaction_Owner_ReadWrite(pqxx::connection &conn,
     std::set< std::string > &prep_stmt) :
-    m_txn { conn }, m_prep_stmt { prep_stmt }
+    m_conn { conn }, m_prep_stmt { prep_stmt }
 {
 }
 
 pqxx::transaction_base& Transaction_Owner_ReadWrite::get_transaction()
 {
-  return m_txn;
+  if (!m_txn)
+    m_txn.emplace(m_conn);
+
+  return *m_txn;
 }
 
 std::set<std::string>& Transaction_Owner_ReadWrite::get_prep_stmt()
@@ -45,21 +48,27 @@ std::set<std::string>& Transaction_Owner_ReadWrite::get_prep_stmt()
 }
 
 Transaction_Manager::Transaction_Manager(Transaction_Owner_Base &to) :
-    m_txn { to.get_transaction() }, m_prep_stmt(to.get_prep_stmt())
+    m_to { to }, m_prep_stmt(to.get_prep_stmt())
 {
 }
 
 void Transaction_Manager::prepare(const std::string &name,
                                   const std::string &definition) {
-  if (!m_prep_stmt.contains(name))
+  const bool prepared = m_prep_stmt.contains(name);
+  metrics::count_cache_lookup("prepared_statements", prepared);
+
+  if (!prepared)
   {
-    m_txn.conn().prepare(name, definition);
+    txn().conn().prepare(name, definition);
     m_prep_stmt.insert(name);
   }
+
+  if (slow_query_log::enabled())
+    m_definitions.try_emplace(name, definition);
 }
 
 pqxx::result Transaction_Manager::exec(const std::string &query,
                                        const std::string &) {
-  return m_txn.exec(query);
+  return txn().exec(query);
 }
 
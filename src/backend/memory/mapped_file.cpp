@@ -0,0 +1,50 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+mapped_file::mapped_file(const std::string &filename, int advice) {
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error(fmt::format("Failed to open {}: {}", filename, std::strerror(errno)));
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0) {
+    const int err = errno;
+    close(fd);
+    throw std::runtime_error(fmt::format("Failed to read {}: {}", filename, std::strerror(err)));
+  }
+
+  m_size = st.st_size;
+  if (m_size > 0) {
+    m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m_data == MAP_FAILED) {
+      const int err = errno;
+      close(fd);
+      throw std::runtime_error(fmt::format("Failed to map {}: {}", filename, std::strerror(err)));
+    }
+    madvise(m_data, m_size, advice);
+  }
+  close(fd);
+}
+
+mapped_file::~mapped_file() {
+  if (m_size > 0)
+    munmap(m_data, m_size);
+}
@@ -0,0 +1,148 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/memory.hpp"
+#include "cgimap/backend/memory/memory_selection.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/backend/memory/replication.hpp"
+#include "cgimap/backend/memory/snapshot.hpp"
+#include "cgimap/backend.hpp"
+#include "cgimap/logger.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+using loader_t = std::unique_ptr<osm_store> (*)(const std::string &);
+
+// serves the data of a single file, which is either loaded into memory
+// or mapped, optionally with replication diffs applied on top.
+struct memory_backend : public backend {
+  memory_backend(std::string name, const std::string &caption, std::string file_option,
+                 const char *description, loader_t loader)
+    : m_name(std::move(name)),
+      m_file_option(std::move(file_option)),
+      m_loader(loader),
+      m_options(caption) {
+    m_options.add_options()
+      (m_file_option.c_str(), po::value<std::string>()->required(), description)
+      ("replication-dir", po::value<std::string>(), "directory with replication diffs to apply")
+      ("replication-sequence", po::value<uint64_t>(), "sequence number of the first diff to apply")
+      ("replication-interval", po::value<int>()->default_value(60),
+       "seconds between checks for new replication diffs");
+  }
+
+  ~memory_backend() override = default;
+
+  [[nodiscard]] const std::string &name() const override { return m_name; }
+  [[nodiscard]] const po::options_description &options() const override { return m_options; }
+
+  // loading the file before forking shares the data between all daemon
+  // instances, as long as it isn't modified. diffs are applied by each
+  // instance itself, as threads don't survive a fork.
+  void prepare(const po::variables_map &opts) override {
+    load(opts);
+  }
+
+  std::unique_ptr<data_selection::factory> create(const po::variables_map &opts) override {
+    load(opts);
+    std::call_once(m_replication_once, [&] { start_replication(opts); });
+    return std::make_unique<memory_selection::factory>(m_dataset);
+  }
+
+  // the data is read only, API write calls are answered with an error.
+  std::unique_ptr<data_update::factory> create_data_update(const po::variables_map &) override {
+    return nullptr;
+  }
+
+private:
+  void load(const po::variables_map &opts) {
+    std::call_once(m_load_once, [&] {
+      const auto filename = opts[m_file_option].as<std::string>();
+      const auto start = std::chrono::steady_clock::now();
+
+      std::shared_ptr<const osm_store> store = m_loader(filename);
+
+      const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+      logger::message(fmt::format(
+          "Loaded {} node, {} way and {} relation versions and {} changesets from {} "
+          "in {:d} ms, using {:.1f} MB of heap memory",
+          store->nodes.size(), store->ways.size(), store->relations.size(),
+          store->changesets.size(), filename, elapsed.count(),
+          store->memory_usage() / (1024.0 * 1024.0)));
+
+      m_dataset = std::make_shared<published_dataset>(std::make_shared<osm_dataset>(std::move(store)));
+    });
+  }
+
+  void start_replication(const po::variables_map &opts) {
+    if (!opts.contains("replication-dir"))
+      return;
+
+    if (!opts.contains("replication-sequence"))
+      throw std::runtime_error("--replication-sequence is required with --replication-dir");
+    const std::chrono::seconds interval(opts["replication-interval"].as<int>());
+    if (interval.count() < 1)
+      throw std::runtime_error("--replication-interval must be at least 1 second");
+
+    auto applier = std::make_shared<replication_applier>(
+        opts["replication-dir"].as<std::string>(),
+        opts["replication-sequence"].as<uint64_t>(), m_dataset);
+
+    m_replication = std::jthread([applier, interval](std::stop_token stop) {
+      std::mutex mutex;
+      std::condition_variable_any wakeup;
+      while (!stop.stop_requested()) {
+        try {
+          applier->apply_available();
+        } catch (const std::exception &e) {
+          // retried with the next check, the current data is still served
+          logger::message(logger::level::error, e.what());
+        }
+        std::unique_lock lock(mutex);
+        wakeup.wait_for(lock, stop, interval, [] { return false; });
+      }
+    });
+  }
+
+  std::string m_name;
+  std::string m_file_option;
+  loader_t m_loader;
+  std::once_flag m_load_once;
+  std::once_flag m_replication_once;
+  std::shared_ptr<published_dataset> m_dataset;
+  std::jthread m_replication;
+  po::options_description m_options;
+};
+}
+
+std::unique_ptr<backend> make_memory_backend() {
+  return std::make_unique<memory_backend>(
+      "memory", "Memory backend options", "osm-file", "OSM XML or PBF file to load and serve read only",
+      &load_osm_file);
+}
+
+std::unique_ptr<backend> make_snapshot_backend() {
+  return std::make_unique<memory_backend>(
+      "snapshot", "Snapshot backend options", "snapshot-file", "snapshot file to map and serve read only",
+      &load_snapshot);
+}
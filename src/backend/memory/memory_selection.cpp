@@ -0,0 +1,490 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/memory_selection.hpp"
+#include "cgimap/backend/apidb/quad_tile.hpp"
+#include "cgimap/logger.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/request_memory.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <stdexcept>
+
+namespace {
+
+std::string format_timestamp(int64_t seconds) {
+  const auto t = static_cast<time_t>(seconds);
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+  return buf;
+}
+
+// if both current and historic elements were selected, the request is
+// handled via the historic ones, same as in readonly_pgsql_selection
+void merge_current_versions(const osm_dataset &dataset, element_type type,
+                            std::set<osm_nwr_id_t> &current,
+                            std::set<osm_edition_t> &historic) {
+  if (current.empty() || historic.empty())
+    return;
+
+  for (auto id : current) {
+    if (auto ref = dataset.current(type, id))
+      historic.emplace(id, osm_dataset::table(*ref->store, type).versions[ref->i]);
+  }
+  current.clear();
+}
+
+// calls f with the store and entry of each selected element
+template <typename F>
+void for_each_selected(const osm_dataset &dataset, element_type type,
+                       const std::set<osm_nwr_id_t> &current,
+                       const std::set<osm_edition_t> &historic, F &&f) {
+  if (!current.empty()) {
+    for (auto id : current) {
+      if (auto ref = dataset.current(type, id))
+        f(*ref->store, ref->i);
+    }
+  } else {
+    for (const auto &[id, version] : historic) {
+      if (auto ref = dataset.find(type, id, version))
+        f(*ref->store, ref->i);
+    }
+  }
+}
+
+data_selection::visibility_t check_visibility(const osm_dataset &dataset, element_type type,
+                                              osm_nwr_id_t id) {
+  auto ref = dataset.current(type, id);
+  if (!ref)
+    return data_selection::non_exist;
+  return osm_dataset::table(*ref->store, type).visible(ref->i) ? data_selection::exists
+                                                               : data_selection::deleted;
+}
+
+} // anonymous namespace
+
+pqxx::transaction_base& Transaction_Owner_Memory::get_transaction() {
+  throw std::runtime_error("get_transaction is not supported by Transaction_Owner_Memory");
+}
+
+std::set<std::string>& Transaction_Owner_Memory::get_prep_stmt() {
+  throw std::runtime_error("get_prep_stmt is not supported by Transaction_Owner_Memory");
+}
+
+memory_selection::memory_selection(std::shared_ptr<const osm_dataset> dataset)
+    : m_dataset(std::move(dataset)) {}
+
+memory_selection::memory_selection(std::shared_ptr<const osm_store> store)
+    : m_dataset(std::make_shared<osm_dataset>(std::move(store))) {}
+
+element_info memory_selection::info(const osm_store &store, const osm_store::element_table &table,
+                                    osm_store::entry_t i) {
+  element_info elem;
+  elem.id = table.ids[i];
+  elem.version = table.versions[i];
+  elem.changeset = table.changesets[i];
+  elem.timestamp = format_timestamp(table.timestamps[i]);
+  if (const auto *user = store.user_of(table, i)) {
+    elem.uid = user->id;
+    elem.display_name = std::string(store.string(user->name));
+  }
+  elem.visible = table.visible(i);
+  return elem;
+}
+
+tags_t memory_selection::tags(const osm_store &store, const osm_store::element_table &table,
+                              osm_store::entry_t i) {
+  tags_t result;
+  const auto refs = table.tags_of(i);
+  result.reserve(refs.size());
+  for (const auto &[key, value] : refs)
+    result.emplace_back(store.string(key), store.string(value));
+  return result;
+}
+
+void memory_selection::write_nodes(output_formatter &formatter) {
+
+  logger::message(logger::level::debug, "Fetching nodes");
+
+  merge_current_versions(*m_dataset, element_type::node, sel_nodes, sel_historic_nodes);
+
+  const auto scale = static_cast<double>(global_settings::get_scale());
+  for_each_selected(*m_dataset, element_type::node, sel_nodes, sel_historic_nodes,
+                    [&](const osm_store &store, auto i) {
+    const auto &nodes = store.nodes;
+    formatter.write_node(info(store, nodes, i), nodes.lons[i] / scale, nodes.lats[i] / scale,
+                         tags(store, nodes, i));
+  });
+}
+
+void memory_selection::write_ways(output_formatter &formatter) {
+
+  logger::message(logger::level::debug, "Fetching ways");
+
+  merge_current_versions(*m_dataset, element_type::way, sel_ways, sel_historic_ways);
+
+  for_each_selected(*m_dataset, element_type::way, sel_ways, sel_historic_ways,
+                    [&](const osm_store &store, auto i) {
+    const auto &ways = store.ways;
+    const auto refs = ways.nodes_of(i);
+    formatter.write_way(info(store, ways, i), nodes_t(refs.begin(), refs.end()),
+                        tags(store, ways, i));
+  });
+}
+
+void memory_selection::write_relations(output_formatter &formatter) {
+
+  logger::message(logger::level::debug, "Fetching relations");
+
+  merge_current_versions(*m_dataset, element_type::relation, sel_relations,
+                         sel_historic_relations);
+
+  for_each_selected(*m_dataset, element_type::relation, sel_relations, sel_historic_relations,
+                    [&](const osm_store &store, auto i) {
+    const auto &relations = store.relations;
+    members_t members;
+    for (const auto &member : relations.members_of(i))
+      members.emplace_back(member.type, member.ref, std::string(store.string(member.role)));
+    formatter.write_relation(info(store, relations, i), members, tags(store, relations, i));
+  });
+}
+
+void memory_selection::write_changesets(output_formatter &formatter,
+                                        const std::chrono::system_clock::time_point &now) {
+
+  for (auto id : sel_changesets) {
+    const auto *cs = m_dataset->changeset(id);
+    if (cs == nullptr)
+      continue;
+
+    auto elem = cs->info;
+    elem.comments_count = cs->comments.size();
+    formatter.write_changeset(elem, cs->tags, include_changeset_discussions, cs->comments, now);
+  }
+}
+
+data_selection::visibility_t
+memory_selection::check_node_visibility(osm_nwr_id_t id) {
+  return check_visibility(*m_dataset, element_type::node, id);
+}
+
+data_selection::visibility_t
+memory_selection::check_way_visibility(osm_nwr_id_t id) {
+  return check_visibility(*m_dataset, element_type::way, id);
+}
+
+data_selection::visibility_t
+memory_selection::check_relation_visibility(osm_nwr_id_t id) {
+  return check_visibility(*m_dataset, element_type::relation, id);
+}
+
+int memory_selection::select_current(element_type type, const std::vector<osm_nwr_id_t> &ids,
+                                     std::set<osm_nwr_id_t> &sel) {
+  const auto old_size = sel.size();
+  for (auto id : ids) {
+    if (m_dataset->current(type, id))
+      sel.insert(id);
+  }
+  return sel.size() - old_size;
+}
+
+int memory_selection::select_nodes(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::node, ids, sel_nodes);
+}
+
+int memory_selection::select_ways(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::way, ids, sel_ways);
+}
+
+int memory_selection::select_relations(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::relation, ids, sel_relations);
+}
+
+int memory_selection::select_nodes_from_bbox(const bbox &bounds, int max_nodes) {
+
+  auto tiles = tiles_for_area(bounds.minlat, bounds.minlon, bounds.maxlat, bounds.maxlon);
+  std::sort(tiles.begin(), tiles.end());
+  tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+  // same bounds as in the database query
+  const auto scale = global_settings::get_scale();
+  const int64_t minlat = int(bounds.minlat * scale);
+  const int64_t maxlat = int(bounds.maxlat * scale);
+  const int64_t minlon = int(bounds.minlon * scale);
+  const int64_t maxlon = int(bounds.maxlon * scale);
+
+  const auto old_size = sel_nodes.size();
+  int found = 0;
+
+  // nodes which were moved or deleted by a later store are skipped, they
+  // are in the index of that store if they are still in the area.
+  for (const auto &layer : m_dataset->layers()) {
+    const auto &nodes = layer->nodes;
+    const auto &index = layer->node_tiles;
+
+    auto itr = index.begin();
+    for (auto tile : tiles) {
+      itr = std::lower_bound(itr, index.end(), std::pair<tile_id_t, osm_store::entry_t>(tile, 0));
+      for (; itr != index.end() && itr->first == tile; ++itr) {
+        const auto i = itr->second;
+        if (nodes.lats[i] < minlat || nodes.lats[i] > maxlat ||
+            nodes.lons[i] < minlon || nodes.lons[i] > maxlon)
+          continue;
+
+        if (!m_dataset->is_newest(*layer, element_type::node, nodes.ids[i]))
+          continue;
+
+        sel_nodes.insert(nodes.ids[i]);
+        if (++found > max_nodes) {
+          request_memory::check();
+          return sel_nodes.size() - old_size;
+        }
+      }
+    }
+  }
+
+  request_memory::check();
+  return sel_nodes.size() - old_size;
+}
+
+void memory_selection::select_members(element_type type, std::set<osm_nwr_id_t> &sel) {
+  for (auto id : sel_relations) {
+    auto ref = m_dataset->current(element_type::relation, id);
+    if (!ref)
+      continue;
+    for (const auto &member : ref->store->relations.members_of(ref->i)) {
+      if (member.type == type)
+        sel.insert(member.ref);
+    }
+  }
+  request_memory::check();
+}
+
+// each store indexes the current versions of its own parents, entries
+// of parents which were modified by a later store are skipped.
+void memory_selection::select_parents(osm_store::parent_index osm_store::*index,
+                                      element_type parent_type,
+                                      const std::set<osm_nwr_id_t> &children,
+                                      std::set<osm_nwr_id_t> &sel) {
+  for (const auto &layer : m_dataset->layers()) {
+    for (auto child : children) {
+      osm_store::for_each_parent((*layer).*index, child, [&](auto parent) {
+        if (m_dataset->is_newest(*layer, parent_type, parent))
+          sel.insert(parent);
+      });
+    }
+  }
+  request_memory::check();
+}
+
+void memory_selection::select_nodes_from_relations() {
+  logger::message(logger::level::debug, "Filling sel_nodes (from relations)");
+  select_members(element_type::node, sel_nodes);
+}
+
+void memory_selection::select_ways_from_nodes() {
+  logger::message(logger::level::debug, "Filling sel_ways (from nodes)");
+  select_parents(&osm_store::node_ways, element_type::way, sel_nodes, sel_ways);
+}
+
+void memory_selection::select_ways_from_relations() {
+  logger::message(logger::level::debug, "Filling sel_ways (from relations)");
+  select_members(element_type::way, sel_ways);
+}
+
+void memory_selection::select_relations_from_ways() {
+  logger::message(logger::level::debug, "Filling sel_relations (from ways)");
+  select_parents(&osm_store::way_relations, element_type::relation, sel_ways, sel_relations);
+}
+
+void memory_selection::select_nodes_from_way_nodes() {
+  for (auto id : sel_ways) {
+    if (auto ref = m_dataset->current(element_type::way, id)) {
+      for (auto node : ref->store->ways.nodes_of(ref->i))
+        sel_nodes.insert(node);
+    }
+  }
+  request_memory::check();
+}
+
+void memory_selection::select_relations_from_nodes() {
+  select_parents(&osm_store::node_relations, element_type::relation, sel_nodes, sel_relations);
+}
+
+void memory_selection::select_relations_from_relations(bool drop_relations) {
+  if (sel_relations.empty())
+    return;
+
+  std::set<osm_nwr_id_t> sel;
+  if (drop_relations)
+    sel_relations.swap(sel);
+  else
+    sel = sel_relations;
+
+  select_parents(&osm_store::relation_relations, element_type::relation, sel, sel_relations);
+}
+
+void memory_selection::select_relations_members_of_relations() {
+  std::set<osm_nwr_id_t> members;
+  select_members(element_type::relation, members);
+  sel_relations.merge(members);
+}
+
+int memory_selection::select_historical(element_type type, const std::vector<osm_edition_t> &eds,
+                                        std::set<osm_edition_t> &sel) {
+  const auto old_size = sel.size();
+  for (const auto &[id, version] : eds) {
+    auto ref = m_dataset->find(type, id, version);
+    if (ref && (!osm_dataset::table(*ref->store, type).redacted(ref->i) || m_redactions_visible))
+      sel.emplace(id, version);
+  }
+  return sel.size() - old_size;
+}
+
+// stores never contain the same version of an element, so the history is
+// the versions of all stores.
+int memory_selection::select_with_history(element_type type, const std::vector<osm_nwr_id_t> &ids,
+                                          std::set<osm_edition_t> &sel) {
+  const auto old_size = sel.size();
+  for (const auto &layer : m_dataset->layers()) {
+    const auto &table = osm_dataset::table(*layer, type);
+    for (auto id : ids) {
+      auto [first, last] = table.versions_of(id);
+      for (auto i = first; i < last; ++i) {
+        if (!table.redacted(i) || m_redactions_visible)
+          sel.emplace(id, table.versions[i]);
+      }
+    }
+  }
+  return sel.size() - old_size;
+}
+
+int memory_selection::select_by_changesets(element_type type,
+                                           const std::vector<osm_changeset_id_t> &ids,
+                                           std::set<osm_edition_t> &sel) {
+  const auto old_size = sel.size();
+  for (const auto &layer : m_dataset->layers()) {
+    const auto &table = osm_dataset::table(*layer, type);
+    for (auto changeset : ids) {
+      for (const auto &[cs, i] : table.in_changeset(changeset)) {
+        if (!table.redacted(i) || m_redactions_visible)
+          sel.emplace(table.ids[i], table.versions[i]);
+      }
+    }
+  }
+  return sel.size() - old_size;
+}
+
+int memory_selection::select_historical_nodes(const std::vector<osm_edition_t> &eds) {
+  return select_historical(element_type::node, eds, sel_historic_nodes);
+}
+
+int memory_selection::select_historical_ways(const std::vector<osm_edition_t> &eds) {
+  return select_historical(element_type::way, eds, sel_historic_ways);
+}
+
+int memory_selection::select_historical_relations(const std::vector<osm_edition_t> &eds) {
+  return select_historical(element_type::relation, eds, sel_historic_relations);
+}
+
+int memory_selection::select_nodes_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return select_with_history(element_type::node, ids, sel_historic_nodes);
+}
+
+int memory_selection::select_ways_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return select_with_history(element_type::way, ids, sel_historic_ways);
+}
+
+int memory_selection::select_relations_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return select_with_history(element_type::relation, ids, sel_historic_relations);
+}
+
+void memory_selection::set_redactions_visible(bool visible) {
+  m_redactions_visible = visible;
+}
+
+int memory_selection::select_historical_by_changesets(
+  const std::vector<osm_changeset_id_t> &ids) {
+
+  int selected = select_by_changesets(element_type::node, ids, sel_historic_nodes);
+  selected += select_by_changesets(element_type::way, ids, sel_historic_ways);
+  selected += select_by_changesets(element_type::relation, ids, sel_historic_relations);
+  request_memory::check();
+  return selected;
+}
+
+void memory_selection::drop_nodes() {
+  sel_nodes.clear();
+}
+
+void memory_selection::drop_ways() {
+  sel_ways.clear();
+}
+
+void memory_selection::drop_relations() {
+  sel_relations.clear();
+}
+
+int memory_selection::select_changesets(const std::vector<osm_changeset_id_t> &ids) {
+  const auto old_size = sel_changesets.size();
+  for (auto id : ids) {
+    if (m_dataset->changeset(id) != nullptr)
+      sel_changesets.insert(id);
+  }
+  return sel_changesets.size() - old_size;
+}
+
+void memory_selection::select_changeset_discussions() {
+  include_changeset_discussions = true;
+}
+
+bool memory_selection::supports_user_details() const {
+  return false;
+}
+
+bool memory_selection::is_user_blocked(const osm_user_id_t) {
+  return false;
+}
+
+std::set< osm_user_role_t > memory_selection::get_roles_for_user(osm_user_id_t) {
+  return {};
+}
+
+std::optional< osm_user_id_t > memory_selection::get_user_id_for_oauth2_token(
+    const std::string &, bool &expired, bool &revoked,
+    bool &allow_api_write) {
+  expired = true;
+  revoked = true;
+  allow_api_write = false;
+  return {};
+}
+
+bool memory_selection::is_user_active(const osm_user_id_t) {
+  return false;
+}
+
+std::optional<std::chrono::system_clock::time_point> memory_selection::data_timestamp() const {
+  return m_dataset->timestamp();
+}
+
+memory_selection::factory::factory(std::shared_ptr<const published_dataset> dataset)
+    : m_dataset(std::move(dataset)) {}
+
+std::unique_ptr<data_selection>
+memory_selection::factory::make_selection(Transaction_Owner_Base &) const {
+  return std::make_unique<memory_selection>(m_dataset->get());
+}
+
+std::unique_ptr<Transaction_Owner_Base>
+memory_selection::factory::get_default_transaction() {
+  return std::make_unique<Transaction_Owner_Memory>();
+}
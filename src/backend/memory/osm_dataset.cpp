@@ -0,0 +1,67 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/osm_dataset.hpp"
+
+#include <stdexcept>
+
+osm_dataset::osm_dataset(std::shared_ptr<const osm_store> store)
+    : m_layers{std::move(store)} {}
+
+osm_dataset::osm_dataset(std::vector<std::shared_ptr<const osm_store>> layers,
+                         uint64_t sequence,
+                         std::optional<std::chrono::system_clock::time_point> timestamp)
+    : m_layers(std::move(layers)), m_sequence(sequence), m_timestamp(timestamp) {}
+
+const osm_store::element_table &osm_dataset::table(const osm_store &store, element_type type) {
+  switch (type) {
+  case element_type::node:
+    return store.nodes;
+  case element_type::way:
+    return store.ways;
+  case element_type::relation:
+    return store.relations;
+  default:
+    throw std::logic_error("Changesets don't have an element table");
+  }
+}
+
+std::optional<osm_dataset::entry_ref>
+osm_dataset::current(element_type type, osm_nwr_id_t id) const {
+  for (auto layer = m_layers.rbegin(); layer != m_layers.rend(); ++layer) {
+    if (auto i = table(**layer, type).current(id))
+      return entry_ref{layer->get(), *i};
+  }
+  return {};
+}
+
+std::optional<osm_dataset::entry_ref>
+osm_dataset::find(element_type type, osm_nwr_id_t id, osm_version_t version) const {
+  for (auto layer = m_layers.rbegin(); layer != m_layers.rend(); ++layer) {
+    if (auto i = table(**layer, type).find(id, version))
+      return entry_ref{layer->get(), *i};
+  }
+  return {};
+}
+
+bool osm_dataset::is_newest(const osm_store &store, element_type type, osm_nwr_id_t id) const {
+  for (auto layer = m_layers.rbegin(); layer != m_layers.rend() && layer->get() != &store; ++layer) {
+    if (table(**layer, type).current(id))
+      return false;
+  }
+  return true;
+}
+
+const osm_store::changeset *osm_dataset::changeset(osm_changeset_id_t id) const {
+  for (const auto &layer : m_layers) {
+    if (auto itr = layer->changesets.find(id); itr != layer->changesets.end())
+      return &itr->second;
+  }
+  return nullptr;
+}
@@ -0,0 +1,38 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/backend/memory/mapped_file.hpp"
+
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+namespace {
+
+bool is_xml(std::string_view data) {
+  if (data.starts_with("\xEF\xBB\xBF"))
+    data.remove_prefix(3);
+  const auto pos = data.find_first_not_of(" \t\r\n");
+  return pos != std::string_view::npos && data[pos] == '<';
+}
+
+} // anonymous namespace
+
+std::unique_ptr<osm_store> load_osm_file(const std::string &filename) {
+  mapped_file file(filename, MADV_SEQUENTIAL);
+
+  try {
+    if (is_xml(file.data()))
+      return load_osm_xml(file.data());
+    return load_osm_pbf(file.data());
+  } catch (const std::exception &e) {
+    throw std::runtime_error(fmt::format("Failed to load {}: {}", filename, e.what()));
+  }
+}
@@ -0,0 +1,385 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/osm_store.hpp"
+#include "cgimap/backend/apidb/quad_tile.hpp"
+#include "cgimap/options.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+#include <fmt/core.h>
+
+namespace {
+
+template <typename T>
+void permute(std::vector<T> &v, const std::vector<osm_store::entry_t> &order) {
+  std::vector<T> result;
+  result.reserve(v.size());
+  for (auto i : order)
+    result.push_back(v[i]);
+  v.swap(result);
+}
+
+// reorders variable length data, offsets has one more entry than order
+template <typename T>
+void permute(std::vector<uint64_t> &offsets, std::vector<T> &values,
+             const std::vector<osm_store::entry_t> &order) {
+  std::vector<uint64_t> new_offsets;
+  std::vector<T> new_values;
+  new_offsets.reserve(offsets.size());
+  new_values.reserve(values.size());
+  new_offsets.push_back(0);
+  for (auto i : order) {
+    new_values.insert(new_values.end(), values.begin() + offsets[i], values.begin() + offsets[i + 1]);
+    new_offsets.push_back(new_values.size());
+  }
+  offsets.swap(new_offsets);
+  values.swap(new_values);
+}
+
+// sorts the entries by id and version, returning the new order of the
+// entries if they weren't sorted already
+std::vector<osm_store::entry_t> sort_order(const osm_store::element_table &table, element_type type) {
+  auto less = [&](osm_store::entry_t a, osm_store::entry_t b) {
+    return std::tie(table.ids[a], table.versions[a]) < std::tie(table.ids[b], table.versions[b]);
+  };
+
+  std::vector<osm_store::entry_t> order(table.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (!std::is_sorted(order.begin(), order.end(), less))
+    std::sort(order.begin(), order.end(), less);
+
+  for (std::size_t i = 1; i < order.size(); ++i) {
+    if (!less(order[i - 1], order[i]))
+      throw std::runtime_error(fmt::format("Duplicate {} {} version {} in input file",
+          element_type_name(type), table.ids[order[i]], table.versions[order[i]]));
+  }
+
+  if (std::is_sorted(order.begin(), order.end()))
+    order.clear();
+  return order;
+}
+
+void sort_common(osm_store::element_table &table, const std::vector<osm_store::entry_t> &order) {
+  permute(table.ids.values(), order);
+  permute(table.versions.values(), order);
+  permute(table.changesets.values(), order);
+  permute(table.timestamps.values(), order);
+  permute(table.users.values(), order);
+  permute(table.flags.values(), order);
+  permute(table.tag_offsets.values(), table.tags.values(), order);
+}
+
+void build_changeset_index(osm_store::element_table &table) {
+  auto &index = table.by_changeset.values();
+  index.reserve(table.size());
+  for (osm_store::entry_t i = 0; i < table.size(); ++i)
+    index.emplace_back(table.changesets[i], i);
+  std::sort(index.begin(), index.end());
+}
+
+void sort_unique(osm_store::parent_index &index) {
+  auto &values = index.values();
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+} // anonymous namespace
+
+std::pair<osm_store::entry_t, osm_store::entry_t>
+osm_store::element_table::versions_of(osm_nwr_id_t id) const {
+  auto [first, last] = std::equal_range(ids.begin(), ids.end(), id);
+  return {static_cast<entry_t>(first - ids.begin()), static_cast<entry_t>(last - ids.begin())};
+}
+
+std::optional<osm_store::entry_t> osm_store::element_table::current(osm_nwr_id_t id) const {
+  auto [first, last] = versions_of(id);
+  if (first == last)
+    return {};
+  return last - 1;
+}
+
+std::optional<osm_store::entry_t>
+osm_store::element_table::find(osm_nwr_id_t id, osm_version_t version) const {
+  auto [first, last] = versions_of(id);
+  auto itr = std::lower_bound(versions.begin() + first, versions.begin() + last, version);
+  if (itr == versions.begin() + last || *itr != version)
+    return {};
+  return static_cast<entry_t>(itr - versions.begin());
+}
+
+std::span<const std::pair<osm_changeset_id_t, osm_store::entry_t>>
+osm_store::element_table::in_changeset(osm_changeset_id_t changeset) const {
+  auto first = std::lower_bound(by_changeset.begin(), by_changeset.end(),
+                                std::pair<osm_changeset_id_t, entry_t>(changeset, 0));
+  auto last = std::upper_bound(first, by_changeset.end(),
+                               std::pair(changeset, std::numeric_limits<entry_t>::max()));
+  return {first, last};
+}
+
+std::size_t osm_store::memory_usage() const noexcept {
+  std::size_t result = 0;
+  for_each_column([&](const auto &col) { result += col.memory_usage(); });
+  return result;
+}
+
+osm_store::parent_index::const_iterator
+osm_store::lower_bound(const parent_index &index, osm_nwr_id_t child) {
+  return std::lower_bound(index.begin(), index.end(), child,
+                          [](const auto &entry, osm_nwr_id_t id) { return entry.first < id; });
+}
+
+osm_store_builder::osm_store_builder() : m_store(std::make_unique<osm_store>()) {
+  for (auto *table : std::initializer_list<osm_store::element_table *>{
+           &m_store->nodes, &m_store->ways, &m_store->relations})
+    table->tag_offsets.values().push_back(0);
+  m_store->ways.node_offsets.values().push_back(0);
+  m_store->relations.member_offsets.values().push_back(0);
+
+  // user 0 stands for anonymous edits
+  m_store->m_users.values().push_back({0, intern("")});
+}
+
+osm_store::string_id osm_store_builder::intern(std::string_view s) {
+  if (auto itr = m_string_ids.find(s); itr != m_string_ids.end())
+    return itr->second;
+
+  if (m_string_ids.size() >= std::numeric_limits<osm_store::string_id>::max())
+    throw std::runtime_error("Too many distinct strings in input file");
+
+  const auto id = static_cast<osm_store::string_id>(m_store->m_string_offsets.size() - 1);
+  auto &strings = m_store->m_strings.values();
+  strings.insert(strings.end(), s.begin(), s.end());
+  m_store->m_string_offsets.values().push_back(strings.size());
+  m_string_ids.emplace(s, id);
+  return id;
+}
+
+osm_store::element_table &osm_store_builder::begin_entry(osm_store::element_table &table,
+                                                         const entity &e) {
+  end_entry();
+
+  if (table.size() >= std::numeric_limits<osm_store::entry_t>::max())
+    throw std::runtime_error("Too many element versions in input file");
+
+  uint32_t user = 0;
+  if (e.uid) {
+    auto [itr, inserted] = m_user_ids.try_emplace(*e.uid, m_store->m_users.size());
+    auto &users = m_store->m_users.values();
+    if (inserted)
+      users.push_back({*e.uid, intern(e.user)});
+    else
+      // keep the most recent display name
+      users[itr->second].name = intern(e.user);
+    user = itr->second;
+  }
+
+  table.ids.values().push_back(e.id);
+  table.versions.values().push_back(e.version);
+  table.changesets.values().push_back(e.changeset);
+  table.timestamps.values().push_back(e.timestamp);
+  table.users.values().push_back(user);
+  table.flags.values().push_back((e.visible ? osm_store::visible_flag : 0) |
+                        (e.redacted ? osm_store::redacted_flag : 0));
+  m_current = &table;
+  return table;
+}
+
+void osm_store_builder::end_entry() {
+  if (m_current == nullptr)
+    return;
+
+  // tags are written in key order, same as the apidb backend
+  auto &tags = m_current->tags.values();
+  std::sort(tags.begin() + m_current->tag_offsets.back(), tags.end(),
+            [this](const auto &a, const auto &b) {
+              return m_store->string(a.key) < m_store->string(b.key);
+            });
+  m_current->tag_offsets.values().push_back(tags.size());
+
+  if (m_current_type == element_type::way)
+    m_store->ways.node_offsets.values().push_back(m_store->ways.way_nodes.size());
+  else if (m_current_type == element_type::relation)
+    m_store->relations.member_offsets.values().push_back(m_store->relations.members.size());
+
+  m_current = nullptr;
+}
+
+void osm_store_builder::add_node(const entity &e, double lat, double lon) {
+  if (std::abs(lat) > 90.0 || std::abs(lon) > 180.0)
+    throw std::runtime_error(fmt::format("Node {} version {} has invalid coordinates", e.id, e.version));
+
+  begin_entry(m_store->nodes, e);
+  m_current_type = element_type::node;
+  const auto scale = static_cast<double>(global_settings::get_scale());
+  m_store->nodes.lats.values().push_back(static_cast<int32_t>(std::round(lat * scale)));
+  m_store->nodes.lons.values().push_back(static_cast<int32_t>(std::round(lon * scale)));
+}
+
+void osm_store_builder::add_way(const entity &e) {
+  begin_entry(m_store->ways, e);
+  m_current_type = element_type::way;
+}
+
+void osm_store_builder::add_relation(const entity &e) {
+  begin_entry(m_store->relations, e);
+  m_current_type = element_type::relation;
+}
+
+void osm_store_builder::add_tag(std::string_view key, std::string_view value) {
+  if (m_current != nullptr)
+    m_current->tags.values().push_back({intern(key), intern(value)});
+}
+
+void osm_store_builder::add_way_node(osm_nwr_id_t ref) {
+  if (m_current != nullptr && m_current_type == element_type::way)
+    m_store->ways.way_nodes.values().push_back(ref);
+}
+
+void osm_store_builder::add_member(element_type type, osm_nwr_id_t ref, std::string_view role) {
+  if (m_current != nullptr && m_current_type == element_type::relation)
+    m_store->relations.members.values().push_back({ref, intern(role), type});
+}
+
+void osm_store_builder::add_changeset(osm_store::changeset cs) {
+  end_entry();
+  std::sort(cs.tags.begin(), cs.tags.end());
+  const auto id = cs.info.id;
+  m_store->changesets.insert_or_assign(id, std::move(cs));
+}
+
+void osm_store_builder::add_store(const osm_store &store) {
+  auto add_entries = [&](const osm_store::element_table &table, auto add_element) {
+    for (osm_store::entry_t i = 0; i < table.size(); ++i) {
+      entity e;
+      e.id = table.ids[i];
+      e.version = table.versions[i];
+      e.changeset = table.changesets[i];
+      e.timestamp = table.timestamps[i];
+      if (const auto *user = store.user_of(table, i)) {
+        e.uid = user->id;
+        e.user = store.string(user->name);
+      }
+      e.visible = table.visible(i);
+      e.redacted = table.redacted(i);
+
+      add_element(e, i);
+      for (const auto &[key, value] : table.tags_of(i))
+        add_tag(store.string(key), store.string(value));
+    }
+  };
+
+  const auto scale = static_cast<double>(global_settings::get_scale());
+  add_entries(store.nodes, [&](const entity &e, osm_store::entry_t i) {
+    add_node(e, store.nodes.lats[i] / scale, store.nodes.lons[i] / scale);
+  });
+  add_entries(store.ways, [&](const entity &e, osm_store::entry_t i) {
+    add_way(e);
+    for (auto node : store.ways.nodes_of(i))
+      add_way_node(node);
+  });
+  add_entries(store.relations, [&](const entity &e, osm_store::entry_t i) {
+    add_relation(e);
+    for (const auto &member : store.relations.members_of(i))
+      add_member(member.type, member.ref, store.string(member.role));
+  });
+
+  for (const auto &[id, cs] : store.changesets)
+    add_changeset(cs);
+}
+
+std::unique_ptr<osm_store> osm_store_builder::finish() {
+  end_entry();
+  m_string_ids.clear();
+  m_user_ids.clear();
+
+  auto &store = *m_store;
+
+  if (auto order = sort_order(store.nodes, element_type::node); !order.empty()) {
+    sort_common(store.nodes, order);
+    permute(store.nodes.lats.values(), order);
+    permute(store.nodes.lons.values(), order);
+  }
+  if (auto order = sort_order(store.ways, element_type::way); !order.empty()) {
+    sort_common(store.ways, order);
+    permute(store.ways.node_offsets.values(), store.ways.way_nodes.values(), order);
+  }
+  if (auto order = sort_order(store.relations, element_type::relation); !order.empty()) {
+    sort_common(store.relations, order);
+    permute(store.relations.member_offsets.values(), store.relations.members.values(), order);
+  }
+
+  const auto scale = static_cast<double>(global_settings::get_scale());
+  auto &node_tiles = store.node_tiles.values();
+  for (osm_store::entry_t i = 0; i < store.nodes.size(); ++i) {
+    if (!store.nodes.is_current(i) || !store.nodes.visible(i))
+      continue;
+    const double lat = store.nodes.lats[i] / scale;
+    const double lon = store.nodes.lons[i] / scale;
+    node_tiles.emplace_back(xy2tile(lon2x(lon), lat2y(lat)), i);
+  }
+  std::sort(node_tiles.begin(), node_tiles.end());
+
+  for (osm_store::entry_t i = 0; i < store.ways.size(); ++i) {
+    if (!store.ways.is_current(i) || !store.ways.visible(i))
+      continue;
+    for (auto node : store.ways.nodes_of(i))
+      store.node_ways.values().emplace_back(node, store.ways.ids[i]);
+  }
+
+  for (osm_store::entry_t i = 0; i < store.relations.size(); ++i) {
+    if (!store.relations.is_current(i) || !store.relations.visible(i))
+      continue;
+    const auto id = store.relations.ids[i];
+    for (const auto &member : store.relations.members_of(i)) {
+      switch (member.type) {
+      case element_type::node:
+        store.node_relations.values().emplace_back(member.ref, id);
+        break;
+      case element_type::way:
+        store.way_relations.values().emplace_back(member.ref, id);
+        break;
+      case element_type::relation:
+        store.relation_relations.values().emplace_back(member.ref, id);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  for (auto *index : {&store.node_ways, &store.node_relations,
+                      &store.way_relations, &store.relation_relations})
+    sort_unique(*index);
+
+  for (auto *table : std::initializer_list<osm_store::element_table *>{
+           &store.nodes, &store.ways, &store.relations})
+    build_changeset_index(*table);
+
+  store.for_each_column([](auto &col) { col.values().shrink_to_fit(); });
+
+  // same as the apidb import, the number of changes is derived from the
+  // element versions where there are any
+  for (auto &[id, cs] : store.changesets) {
+    std::size_t changes = 0;
+    for (const auto *table : std::initializer_list<const osm_store::element_table *>{
+             &store.nodes, &store.ways, &store.relations}) {
+      changes += table->in_changeset(id).size();
+    }
+    if (changes > 0)
+      cs.info.num_changes = changes;
+  }
+
+  return std::move(m_store);
+}
@@ -0,0 +1,645 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Reader for the OSM PBF format, see
+ * https://wiki.openstreetmap.org/wiki/PBF_Format
+ *
+ * Only the few protobuf messages of the format are needed, so they are
+ * decoded by hand, field numbers as in fileformat.proto and osmformat.proto.
+ */
+
+#include "cgimap/backend/memory/osm_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#include <zlib.h>
+
+namespace {
+
+constexpr std::size_t max_blob_header_size = 64 * 1024;
+constexpr std::size_t max_uncompressed_blob_size = 32 * 1024 * 1024;
+
+[[noreturn]] void format_error(std::string_view what) {
+  throw std::runtime_error(fmt::format("Invalid PBF file: {}", what));
+}
+
+// a protobuf message, or the contents of a packed repeated field
+class pbf_message {
+public:
+  enum wire_type { varint_type = 0, fixed64_type = 1, length_type = 2, fixed32_type = 5 };
+
+  explicit pbf_message(std::string_view data) : m_data(data) {}
+
+  [[nodiscard]] bool empty() const noexcept { return m_data.empty(); }
+
+  // moves to the next field, false at the end of the message
+  bool next() {
+    if (m_data.empty())
+      return false;
+    const auto key = read_varint();
+    m_field = static_cast<uint32_t>(key >> 3);
+    m_wire_type = static_cast<int>(key & 7);
+    return true;
+  }
+
+  [[nodiscard]] uint32_t field() const noexcept { return m_field; }
+
+  uint64_t varint() {
+    expect(varint_type);
+    return read_varint();
+  }
+
+  int64_t svarint() {
+    return zigzag(varint());
+  }
+
+  std::string_view bytes() {
+    expect(length_type);
+    const auto size = read_varint();
+    if (size > m_data.size())
+      format_error("truncated message");
+    auto result = m_data.substr(0, size);
+    m_data.remove_prefix(size);
+    return result;
+  }
+
+  void skip() {
+    switch (m_wire_type) {
+    case varint_type:
+      read_varint();
+      break;
+    case fixed64_type:
+      advance(8);
+      break;
+    case length_type:
+      bytes();
+      break;
+    case fixed32_type:
+      advance(4);
+      break;
+    default:
+      format_error("unknown wire type");
+    }
+  }
+
+  // for packed fields
+  uint64_t read_varint() {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (m_data.empty())
+        format_error("truncated varint");
+      const auto byte = static_cast<uint8_t>(m_data.front());
+      m_data.remove_prefix(1);
+      result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return result;
+    }
+    format_error("varint too long");
+  }
+
+  int64_t read_svarint() {
+    return zigzag(read_varint());
+  }
+
+private:
+  static int64_t zigzag(uint64_t value) noexcept {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  void expect(int type) const {
+    if (m_wire_type != type)
+      format_error(fmt::format("unexpected wire type for field {}", m_field));
+  }
+
+  void advance(std::size_t n) {
+    if (n > m_data.size())
+      format_error("truncated message");
+    m_data.remove_prefix(n);
+  }
+
+  std::string_view m_data;
+  uint32_t m_field = 0;
+  int m_wire_type = 0;
+};
+
+template <typename T, typename F>
+std::vector<T> packed(std::string_view data, F read) {
+  std::vector<T> result;
+  pbf_message values(data);
+  while (!values.empty())
+    result.push_back(static_cast<T>((values.*read)()));
+  return result;
+}
+
+std::vector<int64_t> packed_delta(std::string_view data) {
+  std::vector<int64_t> result;
+  pbf_message values(data);
+  int64_t value = 0;
+  while (!values.empty()) {
+    value += values.read_svarint();
+    result.push_back(value);
+  }
+  return result;
+}
+
+struct block_context {
+  std::vector<std::string_view> strings;
+  int64_t granularity = 100;
+  int64_t lat_offset = 0;
+  int64_t lon_offset = 0;
+  int64_t date_granularity = 1000;
+
+  [[nodiscard]] std::string_view string(uint64_t index) const {
+    if (index >= strings.size())
+      format_error("string index out of range");
+    return strings[index];
+  }
+
+  [[nodiscard]] double lat(int64_t value) const noexcept {
+    return 1e-9 * static_cast<double>(lat_offset + granularity * value);
+  }
+
+  [[nodiscard]] double lon(int64_t value) const noexcept {
+    return 1e-9 * static_cast<double>(lon_offset + granularity * value);
+  }
+
+  [[nodiscard]] int64_t timestamp(int64_t value) const noexcept {
+    return value * date_granularity / 1000;
+  }
+};
+
+class pbf_loader {
+public:
+  std::unique_ptr<osm_store> load(std::string_view data) {
+    bool has_header = false;
+
+    while (!data.empty()) {
+      if (data.size() < 4)
+        format_error("truncated blob header length");
+      const auto header_size = (uint32_t(uint8_t(data[0])) << 24) | (uint32_t(uint8_t(data[1])) << 16) |
+                               (uint32_t(uint8_t(data[2])) << 8) | uint32_t(uint8_t(data[3]));
+      data.remove_prefix(4);
+      if (header_size > max_blob_header_size || header_size > data.size())
+        format_error("invalid blob header length");
+
+      std::string_view type;
+      uint64_t blob_size = 0;
+      pbf_message header(data.substr(0, header_size));
+      while (header.next()) {
+        if (header.field() == 1)
+          type = header.bytes();
+        else if (header.field() == 3)
+          blob_size = header.varint();
+        else
+          header.skip();
+      }
+      data.remove_prefix(header_size);
+      if (blob_size > data.size())
+        format_error("truncated blob");
+
+      const auto blob = data.substr(0, blob_size);
+      data.remove_prefix(blob_size);
+
+      if (type == "OSMHeader") {
+        check_header(decode_blob(blob));
+        has_header = true;
+      } else if (type == "OSMData") {
+        if (!has_header)
+          format_error("data before header");
+        read_block(decode_blob(blob));
+      }
+      // other blob types are skipped, as required by the format
+    }
+
+    if (!has_header)
+      format_error("missing header");
+    return m_builder.finish();
+  }
+
+private:
+  std::string_view decode_blob(std::string_view blob) {
+    std::string_view raw;
+    std::string_view zlib_data;
+    uint64_t raw_size = 0;
+
+    pbf_message msg(blob);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        raw = msg.bytes();
+        break;
+      case 2:
+        raw_size = msg.varint();
+        break;
+      case 3:
+        zlib_data = msg.bytes();
+        break;
+      case 4:
+      case 5:
+      case 6:
+      case 7:
+        format_error("only uncompressed and zlib compressed blobs are supported");
+      default:
+        msg.skip();
+      }
+    }
+
+    if (zlib_data.empty())
+      return raw;
+
+    if (raw_size > max_uncompressed_blob_size)
+      format_error("blob too large");
+
+    m_buffer.resize(raw_size);
+    uLongf size = raw_size;
+    if (uncompress(reinterpret_cast<Bytef *>(m_buffer.data()), &size,
+                   reinterpret_cast<const Bytef *>(zlib_data.data()), zlib_data.size()) != Z_OK ||
+        size != raw_size)
+      format_error("failed to decompress blob");
+    return m_buffer;
+  }
+
+  static void check_header(std::string_view data) {
+    static constexpr std::array<std::string_view, 3> supported{
+        "OsmSchema-V0.6", "DenseNodes", "HistoricalInformation"};
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      if (msg.field() == 4) {
+        const auto feature = msg.bytes();
+        if (std::find(supported.begin(), supported.end(), feature) == supported.end())
+          throw std::runtime_error(fmt::format("Unsupported PBF feature {}", feature));
+      } else {
+        msg.skip();
+      }
+    }
+  }
+
+  void read_block(std::string_view data) {
+    block_context ctx;
+    std::vector<std::string_view> groups;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1: {
+        pbf_message table(msg.bytes());
+        while (table.next()) {
+          if (table.field() == 1)
+            ctx.strings.push_back(table.bytes());
+          else
+            table.skip();
+        }
+        break;
+      }
+      case 2:
+        groups.push_back(msg.bytes());
+        break;
+      case 17:
+        ctx.granularity = static_cast<int32_t>(msg.varint());
+        break;
+      case 18:
+        ctx.date_granularity = static_cast<int32_t>(msg.varint());
+        break;
+      case 19:
+        ctx.lat_offset = static_cast<int64_t>(msg.varint());
+        break;
+      case 20:
+        ctx.lon_offset = static_cast<int64_t>(msg.varint());
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    for (auto group : groups) {
+      pbf_message elements(group);
+      while (elements.next()) {
+        switch (elements.field()) {
+        case 1:
+          read_node(ctx, elements.bytes());
+          break;
+        case 2:
+          read_dense_nodes(ctx, elements.bytes());
+          break;
+        case 3:
+          read_way(ctx, elements.bytes());
+          break;
+        case 4:
+          read_relation(ctx, elements.bytes());
+          break;
+        default:
+          elements.skip();
+        }
+      }
+    }
+  }
+
+  static void read_info(const block_context &ctx, std::string_view data,
+                        osm_store_builder::entity &e) {
+    int64_t uid = 0;
+    uint64_t user = 0;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        e.version = static_cast<osm_version_t>(msg.varint());
+        break;
+      case 2:
+        e.timestamp = ctx.timestamp(static_cast<int64_t>(msg.varint()));
+        break;
+      case 3:
+        e.changeset = msg.varint();
+        break;
+      case 4:
+        uid = static_cast<int32_t>(msg.varint());
+        break;
+      case 5:
+        user = msg.varint();
+        break;
+      case 6:
+        e.visible = msg.varint() != 0;
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    set_user(ctx, e, uid, user);
+  }
+
+  // anonymous edits have no uid or a negative one
+  static void set_user(const block_context &ctx, osm_store_builder::entity &e,
+                       int64_t uid, uint64_t user) {
+    if (uid > 0) {
+      e.uid = uid;
+      e.user = ctx.string(user);
+    } else {
+      e.uid.reset();
+      e.user = {};
+    }
+  }
+
+  void add_tags(const block_context &ctx, const std::vector<uint32_t> &keys,
+                const std::vector<uint32_t> &values) {
+    if (keys.size() != values.size())
+      format_error("tag keys and values differ in length");
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      m_builder.add_tag(ctx.string(keys[i]), ctx.string(values[i]));
+  }
+
+  void read_node(const block_context &ctx, std::string_view data) {
+    osm_store_builder::entity e;
+    e.version = 1;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> values;
+    int64_t lat = 0;
+    int64_t lon = 0;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        e.id = static_cast<osm_nwr_id_t>(msg.svarint());
+        break;
+      case 2:
+        keys = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 3:
+        values = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 4:
+        read_info(ctx, msg.bytes(), e);
+        break;
+      case 8:
+        lat = msg.svarint();
+        break;
+      case 9:
+        lon = msg.svarint();
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    m_builder.add_node(e, ctx.lat(lat), ctx.lon(lon));
+    add_tags(ctx, keys, values);
+  }
+
+  void read_dense_nodes(const block_context &ctx, std::string_view data) {
+    std::vector<int64_t> ids;
+    std::vector<int64_t> lats;
+    std::vector<int64_t> lons;
+    std::string_view keys_vals;
+    std::vector<uint32_t> versions;
+    std::vector<int64_t> timestamps;
+    std::vector<int64_t> changesets;
+    std::vector<int64_t> uids;
+    std::vector<int64_t> users;
+    std::vector<uint32_t> visible;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        ids = packed_delta(msg.bytes());
+        break;
+      case 5: {
+        pbf_message info(msg.bytes());
+        while (info.next()) {
+          switch (info.field()) {
+          case 1:
+            versions = packed<uint32_t>(info.bytes(), &pbf_message::read_varint);
+            break;
+          case 2:
+            timestamps = packed_delta(info.bytes());
+            break;
+          case 3:
+            changesets = packed_delta(info.bytes());
+            break;
+          case 4:
+            uids = packed_delta(info.bytes());
+            break;
+          case 5:
+            users = packed_delta(info.bytes());
+            break;
+          case 6:
+            visible = packed<uint32_t>(info.bytes(), &pbf_message::read_varint);
+            break;
+          default:
+            info.skip();
+          }
+        }
+        break;
+      }
+      case 8:
+        lats = packed_delta(msg.bytes());
+        break;
+      case 9:
+        lons = packed_delta(msg.bytes());
+        break;
+      case 10:
+        keys_vals = msg.bytes();
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    const auto n = ids.size();
+    if (lats.size() != n || lons.size() != n ||
+        (!versions.empty() && versions.size() != n) ||
+        (!timestamps.empty() && timestamps.size() != n) ||
+        (!changesets.empty() && changesets.size() != n) ||
+        (!uids.empty() && uids.size() != n) ||
+        (!users.empty() && users.size() != n) ||
+        (!visible.empty() && visible.size() != n))
+      format_error("dense nodes differ in length");
+
+    pbf_message tags(keys_vals);
+    for (std::size_t i = 0; i < n; ++i) {
+      osm_store_builder::entity e;
+      e.id = static_cast<osm_nwr_id_t>(ids[i]);
+      e.version = versions.empty() ? 1 : versions[i];
+      e.timestamp = timestamps.empty() ? 0 : ctx.timestamp(timestamps[i]);
+      e.changeset = changesets.empty() ? 0 : static_cast<osm_changeset_id_t>(changesets[i]);
+      e.visible = visible.empty() || visible[i] != 0;
+      set_user(ctx, e, uids.empty() ? 0 : uids[i], users.empty() ? 0 : users[i]);
+
+      m_builder.add_node(e, ctx.lat(lats[i]), ctx.lon(lons[i]));
+
+      // tags of all nodes, each terminated by a 0
+      while (!tags.empty()) {
+        const auto key = tags.read_varint();
+        if (key == 0)
+          break;
+        if (tags.empty())
+          format_error("dense node tag without value");
+        m_builder.add_tag(ctx.string(key), ctx.string(tags.read_varint()));
+      }
+    }
+  }
+
+  void read_way(const block_context &ctx, std::string_view data) {
+    osm_store_builder::entity e;
+    e.version = 1;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<int64_t> refs;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        e.id = msg.varint();
+        break;
+      case 2:
+        keys = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 3:
+        values = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 4:
+        read_info(ctx, msg.bytes(), e);
+        break;
+      case 8:
+        refs = packed_delta(msg.bytes());
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    m_builder.add_way(e);
+    add_tags(ctx, keys, values);
+    for (auto ref : refs)
+      m_builder.add_way_node(static_cast<osm_nwr_id_t>(ref));
+  }
+
+  void read_relation(const block_context &ctx, std::string_view data) {
+    osm_store_builder::entity e;
+    e.version = 1;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> roles;
+    std::vector<int64_t> refs;
+    std::vector<uint32_t> types;
+
+    pbf_message msg(data);
+    while (msg.next()) {
+      switch (msg.field()) {
+      case 1:
+        e.id = msg.varint();
+        break;
+      case 2:
+        keys = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 3:
+        values = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 4:
+        read_info(ctx, msg.bytes(), e);
+        break;
+      case 8:
+        roles = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      case 9:
+        refs = packed_delta(msg.bytes());
+        break;
+      case 10:
+        types = packed<uint32_t>(msg.bytes(), &pbf_message::read_varint);
+        break;
+      default:
+        msg.skip();
+      }
+    }
+
+    if (roles.size() != refs.size() || types.size() != refs.size())
+      format_error("relation members differ in length");
+
+    m_builder.add_relation(e);
+    add_tags(ctx, keys, values);
+    for (std::size_t i = 0; i < refs.size(); ++i) {
+      element_type type;
+      switch (types[i]) {
+      case 0:
+        type = element_type::node;
+        break;
+      case 1:
+        type = element_type::way;
+        break;
+      case 2:
+        type = element_type::relation;
+        break;
+      default:
+        format_error("unknown member type");
+      }
+      m_builder.add_member(type, static_cast<osm_nwr_id_t>(refs[i]), ctx.string(roles[i]));
+    }
+  }
+
+  osm_store_builder m_builder;
+  std::string m_buffer;
+};
+
+} // anonymous namespace
+
+std::unique_ptr<osm_store> load_osm_pbf(std::string_view data) {
+  pbf_loader loader;
+  return loader.load(data);
+}
@@ -0,0 +1,180 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/replication.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/logger.hpp"
+#include "cgimap/time.hpp"
+#include "cgimap/zlib.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+
+std::string read_file(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error(fmt::format("Failed to open {}", path.string()));
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// state files are Java properties files, which escape ':' and '='
+std::string unescape_property(std::string_view value) {
+  std::string result;
+  result.reserve(value.size());
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' && i + 1 < value.size())
+      ++i;
+    result += value[i];
+  }
+  return result;
+}
+
+std::size_t entries(const osm_store &store) {
+  return store.nodes.size() + store.ways.size() + store.relations.size();
+}
+
+// merges the newest store into the one before while that one isn't more
+// than twice as large, similar to the levels of an LSM tree. the store
+// loaded from the file is never merged.
+void compact(std::vector<std::shared_ptr<const osm_store>> &layers) {
+  while (layers.size() > 2 &&
+         entries(*layers[layers.size() - 2]) <= 2 * entries(*layers.back())) {
+    osm_store_builder builder;
+    builder.add_store(*layers[layers.size() - 2]);
+    builder.add_store(*layers.back());
+    layers.pop_back();
+    layers.back() = builder.finish();
+  }
+}
+
+} // anonymous namespace
+
+replication_state parse_replication_state(std::string_view data) {
+  std::optional<uint64_t> sequence;
+  std::optional<std::chrono::system_clock::time_point> timestamp;
+
+  while (!data.empty()) {
+    const auto eol = data.find('\n');
+    auto line = data.substr(0, eol);
+    data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+    if (line.empty() || line.starts_with('#'))
+      continue;
+
+    const auto eq = line.find('=');
+    if (eq == std::string_view::npos)
+      continue;
+
+    const auto key = line.substr(0, eq);
+    const auto value = unescape_property(line.substr(eq + 1));
+
+    if (key == "sequenceNumber") {
+      uint64_t n = 0;
+      const auto *end = value.data() + value.size();
+      auto [ptr, ec] = std::from_chars(value.data(), end, n);
+      if (ec != std::errc() || ptr != end)
+        throw std::runtime_error(fmt::format("Invalid sequence number '{}'", value));
+      sequence = n;
+    } else if (key == "timestamp") {
+      timestamp = parse_time(value);
+    }
+  }
+
+  if (!sequence || !timestamp)
+    throw std::runtime_error("Replication state without sequence number or timestamp");
+  return {*sequence, *timestamp};
+}
+
+std::filesystem::path replication_file(const std::filesystem::path &dir, uint64_t sequence,
+                                       std::string_view extension) {
+  return dir / fmt::format("{:03d}/{:03d}/{:03d}{}", sequence / 1'000'000,
+                           sequence / 1'000 % 1'000, sequence % 1'000, extension);
+}
+
+std::shared_ptr<const osm_dataset> apply_diff(const osm_dataset &dataset, std::string_view osc,
+                                              const replication_state &state) {
+  auto store = load_osm_change(osc, [&](element_type type, osm_nwr_id_t id, osm_version_t version) {
+    auto ref = dataset.current(type, id);
+    return !ref || osm_dataset::table(*ref->store, type).versions[ref->i] < version;
+  });
+
+  auto layers = dataset.layers();
+  if (entries(*store) > 0) {
+    layers.push_back(std::move(store));
+    compact(layers);
+  }
+  return std::make_shared<osm_dataset>(std::move(layers), state.sequence, state.timestamp);
+}
+
+replication_applier::replication_applier(std::filesystem::path dir, uint64_t first_sequence,
+                                         std::shared_ptr<published_dataset> dataset)
+    : m_dir(std::move(dir)),
+      m_next_sequence(first_sequence),
+      m_dataset(std::move(dataset)) {}
+
+int replication_applier::apply_available() {
+  int applied = 0;
+
+  while (true) {
+    const auto sequence = m_next_sequence;
+
+    // the state file is written after the diff, so the diff is complete
+    // once the state file exists
+    const auto state_file = replication_file(m_dir, sequence, ".state.txt");
+    if (!std::filesystem::exists(state_file))
+      break;
+
+    const auto state = parse_replication_state(read_file(state_file));
+    if (state.sequence != sequence)
+      throw std::runtime_error(fmt::format("{} has sequence number {}, expected {}",
+                                           state_file.string(), state.sequence, sequence));
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::string osc;
+    if (const auto gz = replication_file(m_dir, sequence, ".osc.gz"); std::filesystem::exists(gz)) {
+      // replication files are local and trusted, no need to limit their size
+      GZipDecompressor decompressor;
+      decompressor.decompress(read_file(gz), osc, std::numeric_limits<std::size_t>::max());
+    } else {
+      osc = read_file(replication_file(m_dir, sequence, ".osc"));
+    }
+
+    // the applier is the only one publishing datasets
+    const auto dataset = m_dataset->get();
+    std::shared_ptr<const osm_dataset> next;
+    try {
+      next = apply_diff(*dataset, osc, state);
+    } catch (const std::exception &e) {
+      throw std::runtime_error(fmt::format("Failed to apply diff {}: {}", sequence, e.what()));
+    }
+    m_dataset->publish(next);
+    ++m_next_sequence;
+    ++applied;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logger::message(fmt::format("Applied replication diff {} in {:d} ms, serving {} stores",
+                                sequence, elapsed.count(), next->layers().size()));
+  }
+
+  return applied;
+}
@@ -0,0 +1,191 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/snapshot.hpp"
+#include "cgimap/backend/memory/mapped_file.hpp"
+#include "cgimap/options.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+
+constexpr std::array<char, 8> snapshot_magic{'C', 'G', 'I', 'M', 'A', 'P', 'S', 'N'};
+constexpr uint32_t byte_order_mark = 0x01020304;
+constexpr uint64_t column_alignment = 64;
+
+struct file_header {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t byte_order;
+  int64_t scale;
+  uint32_t columns;
+  uint32_t reserved;
+};
+
+struct column_entry {
+  uint64_t offset;
+  uint64_t count;
+  uint32_t value_size;
+  uint32_t reserved;
+};
+
+template <typename Column>
+using value_type_of = typename std::remove_cvref_t<Column>::value_type;
+
+constexpr uint64_t aligned(uint64_t offset) {
+  return (offset + column_alignment - 1) / column_alignment * column_alignment;
+}
+
+std::size_t num_columns(const osm_store &store) {
+  std::size_t result = 0;
+  store.for_each_column([&](const auto &) { ++result; });
+  return result;
+}
+
+template <typename T>
+void write(std::ofstream &out, std::span<const T> values) {
+  static_assert(std::is_standard_layout_v<T>);
+  out.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(values.size_bytes()));
+}
+
+void pad(std::ofstream &out, uint64_t offset) {
+  static constexpr std::array<char, column_alignment> zeros{};
+  const auto pos = static_cast<uint64_t>(out.tellp());
+  out.write(zeros.data(), static_cast<std::streamsize>(offset - pos));
+}
+
+// checks the sizes of the columns, so that a truncated or otherwise
+// inconsistent file can't cause reads outside of the mapping. the values
+// themselves aren't checked, that would have to read the whole file.
+void check_table(const osm_store::element_table &table, std::string_view name) {
+  const auto n = table.size();
+  if (table.versions.size() != n || table.changesets.size() != n ||
+      table.timestamps.size() != n || table.users.size() != n ||
+      table.flags.size() != n || table.by_changeset.size() != n ||
+      table.tag_offsets.size() != n + 1 || table.tag_offsets.back() != table.tags.size())
+    throw std::runtime_error(fmt::format("Inconsistent {} table", name));
+}
+
+void check_offsets(const column<uint64_t> &offsets, std::size_t entries,
+                   std::size_t values, std::string_view name) {
+  if (offsets.size() != entries + 1 || offsets.back() != values)
+    throw std::runtime_error(fmt::format("Inconsistent {}", name));
+}
+
+void check_store(const osm_store &store) {
+  check_table(store.nodes, "node");
+  check_table(store.ways, "way");
+  check_table(store.relations, "relation");
+
+  if (store.nodes.lats.size() != store.nodes.size() ||
+      store.nodes.lons.size() != store.nodes.size())
+    throw std::runtime_error("Inconsistent node coordinates");
+  check_offsets(store.ways.node_offsets, store.ways.size(),
+                store.ways.way_nodes.size(), "way nodes");
+  check_offsets(store.relations.member_offsets, store.relations.size(),
+                store.relations.members.size(), "relation members");
+}
+
+} // anonymous namespace
+
+void write_snapshot(const osm_store &store, const std::string &filename) {
+  const auto tmp_filename = filename + ".tmp";
+
+  std::vector<column_entry> directory;
+  uint64_t offset = aligned(sizeof(file_header) + num_columns(store) * sizeof(column_entry));
+  store.for_each_column([&](const auto &col) {
+    using T = value_type_of<decltype(col)>;
+    directory.push_back({offset, col.size(), sizeof(T), 0});
+    offset = aligned(offset + col.size() * sizeof(T));
+  });
+
+  const file_header header{snapshot_magic, snapshot_format_version, byte_order_mark,
+                           global_settings::get_scale(),
+                           static_cast<uint32_t>(directory.size()), 0};
+
+  std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+  if (!out)
+    throw std::runtime_error(fmt::format("Failed to create {}: {}", tmp_filename, std::strerror(errno)));
+
+  write(out, std::span(&header, 1));
+  write(out, std::span<const column_entry>(directory));
+
+  std::size_t index = 0;
+  store.for_each_column([&](const auto &col) {
+    pad(out, directory[index++].offset);
+    write(out, col.view());
+  });
+  pad(out, offset);
+
+  out.close();
+  if (!out)
+    throw std::runtime_error(fmt::format("Failed to write {}", tmp_filename));
+
+  std::filesystem::rename(tmp_filename, filename);
+}
+
+std::unique_ptr<osm_store> load_snapshot(const std::string &filename) {
+  auto file = std::make_shared<mapped_file>(filename, MADV_RANDOM);
+  const auto data = file->data();
+
+  try {
+    file_header header{};
+    if (data.size() < sizeof(header))
+      throw std::runtime_error("Not a snapshot file");
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.magic != snapshot_magic)
+      throw std::runtime_error("Not a snapshot file");
+    if (header.byte_order != byte_order_mark)
+      throw std::runtime_error("Snapshot was written on a platform with a different byte order");
+    if (header.version != snapshot_format_version)
+      throw std::runtime_error(fmt::format("Unsupported snapshot format version {}, expected {}",
+                                           header.version, snapshot_format_version));
+    if (header.scale != global_settings::get_scale())
+      throw std::runtime_error(fmt::format("Snapshot uses coordinate scale {}, expected {}",
+                                           header.scale, global_settings::get_scale()));
+
+    auto store = std::make_unique<osm_store>();
+    if (header.columns != num_columns(*store) ||
+        data.size() < sizeof(header) + header.columns * sizeof(column_entry))
+      throw std::runtime_error("Unexpected number of columns");
+
+    std::size_t index = 0;
+    store->for_each_column([&](auto &col) {
+      using T = value_type_of<decltype(col)>;
+
+      column_entry entry{};
+      std::memcpy(&entry, data.data() + sizeof(header) + index * sizeof(entry), sizeof(entry));
+      if (entry.value_size != sizeof(T) || entry.offset % alignof(T) != 0 ||
+          entry.offset > data.size() || entry.count > (data.size() - entry.offset) / sizeof(T))
+        throw std::runtime_error(fmt::format("Invalid column {}", index));
+
+      col.map({reinterpret_cast<const T *>(data.data() + entry.offset), entry.count});
+      ++index;
+    });
+
+    check_store(*store);
+    store->set_mapping(std::move(file));
+    return store;
+
+  } catch (const std::exception &e) {
+    throw std::runtime_error(fmt::format("Failed to load {}: {}", filename, e.what()));
+  }
+}
@@ -0,0 +1,280 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/time.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include <fmt/core.h>
+#include <libxml/parser.h>
+
+#include "parsers/saxparser.hpp"
+
+namespace {
+
+template <typename T>
+T parse_number(std::string_view value, std::string_view name) {
+  T result{};
+  const auto *end = value.data() + value.size();
+  auto [ptr, ec] = std::from_chars(value.data(), end, result);
+  if (ec != std::errc() || ptr != end)
+    throw std::runtime_error(fmt::format("Invalid value '{}' for attribute {}", value, name));
+  return result;
+}
+
+int64_t parse_timestamp(std::string_view value) {
+  return std::chrono::system_clock::to_time_t(parse_time(std::string(value)));
+}
+
+element_type parse_member_type(std::string_view value) {
+  if (value == "node")
+    return element_type::node;
+  if (value == "way")
+    return element_type::way;
+  if (value == "relation")
+    return element_type::relation;
+  throw std::runtime_error(fmt::format("Unknown member type '{}'", value));
+}
+
+class osm_xml_loader : private xmlpp::SaxParser {
+public:
+  using accept_t = std::function<bool(element_type, osm_nwr_id_t, osm_version_t)>;
+
+  explicit osm_xml_loader(accept_t accept = {}) : m_accept(std::move(accept)) {}
+
+  std::unique_ptr<osm_store> load(std::string_view data) {
+    if (data.size() > std::numeric_limits<int>::max())
+      throw std::runtime_error("XML files larger than 2 GB aren't supported, please use PBF instead");
+
+    // node ids and tag values of large files may exceed libxml's default limits
+    set_parser_options(XML_PARSE_HUGE);
+
+    try {
+      parse_memory_raw(reinterpret_cast<const unsigned char *>(data.data()),
+                       static_cast<size_type>(data.size()));
+    } catch (const xmlpp::exception &e) {
+      throw std::runtime_error(e.what());
+    }
+    return m_builder.finish();
+  }
+
+protected:
+  void on_start_element(const char *elem, const char **attributes) override {
+    const std::string_view name(elem);
+
+    if (name == "node") {
+      double lat = 0;
+      double lon = 0;
+      auto e = parse_entity(attributes, &lat, &lon);
+      if (accept(element_type::node, e))
+        m_builder.add_node(e, lat, lon);
+    } else if (name == "way") {
+      auto e = parse_entity(attributes);
+      if (accept(element_type::way, e))
+        m_builder.add_way(e);
+    } else if (name == "relation") {
+      auto e = parse_entity(attributes);
+      if (accept(element_type::relation, e))
+        m_builder.add_relation(e);
+    } else if (m_skip && (name == "tag" || name == "nd" || name == "member")) {
+      // belongs to a skipped element
+    } else if (name == "tag") {
+      std::string_view k;
+      std::string_view v;
+      for (; *attributes != nullptr; attributes += 2) {
+        const std::string_view attr(attributes[0]);
+        if (attr == "k")
+          k = attributes[1];
+        else if (attr == "v")
+          v = attributes[1];
+      }
+      if (m_changeset)
+        m_changeset->tags.emplace_back(k, v);
+      else
+        m_builder.add_tag(k, v);
+    } else if (name == "nd") {
+      for (; *attributes != nullptr; attributes += 2) {
+        if (std::string_view(attributes[0]) == "ref")
+          m_builder.add_way_node(parse_number<osm_nwr_id_t>(attributes[1], "ref"));
+      }
+    } else if (name == "member") {
+      element_type type = element_type::node;
+      osm_nwr_id_t ref = 0;
+      std::string_view role;
+      for (; *attributes != nullptr; attributes += 2) {
+        const std::string_view attr(attributes[0]);
+        if (attr == "type")
+          type = parse_member_type(attributes[1]);
+        else if (attr == "ref")
+          ref = parse_number<osm_nwr_id_t>(attributes[1], attr);
+        else if (attr == "role")
+          role = attributes[1];
+      }
+      m_builder.add_member(type, ref, role);
+    } else if (name == "changeset") {
+      m_changeset = parse_changeset(attributes);
+    } else if (name == "comment") {
+      if (m_changeset)
+        m_changeset->comments.push_back(parse_comment(attributes));
+    } else if (name == "text") {
+      m_in_text = m_changeset && !m_changeset->comments.empty();
+    } else if (name == "delete") {
+      m_in_delete = true;
+    }
+  }
+
+  void on_end_element(const char *elem) override {
+    m_in_text = false;
+    if (std::string_view(elem) == "delete")
+      m_in_delete = false;
+    if (m_changeset && std::string_view(elem) == "changeset") {
+      m_changeset->info.comments_count = m_changeset->comments.size();
+      m_builder.add_changeset(std::move(*m_changeset));
+      m_changeset.reset();
+    }
+  }
+
+  void on_characters(const std::string &characters) override {
+    if (m_in_text)
+      m_changeset->comments.back().body.append(characters);
+  }
+
+private:
+  // elements deleted by an osmChange are added as deleted versions, the
+  // diffs don't contain their tags or coordinates.
+  bool accept(element_type type, osm_store_builder::entity &e) {
+    if (m_in_delete)
+      e.visible = false;
+    m_skip = m_accept && !m_accept(type, e.id, e.version);
+    return !m_skip;
+  }
+
+  // files without metadata are accepted, with version 1 for all elements
+  static osm_store_builder::entity parse_entity(const char **attributes,
+                                                double *lat = nullptr,
+                                                double *lon = nullptr) {
+    osm_store_builder::entity e;
+    e.version = 1;
+    bool has_id = false;
+
+    for (; *attributes != nullptr; attributes += 2) {
+      const std::string_view attr(attributes[0]);
+      const std::string_view value(attributes[1]);
+
+      if (attr == "id") {
+        e.id = parse_number<osm_nwr_id_t>(value, attr);
+        has_id = true;
+      } else if (attr == "version") {
+        e.version = parse_number<osm_version_t>(value, attr);
+      } else if (attr == "changeset") {
+        e.changeset = parse_number<osm_changeset_id_t>(value, attr);
+      } else if (attr == "timestamp") {
+        e.timestamp = parse_timestamp(value);
+      } else if (attr == "uid") {
+        e.uid = parse_number<osm_user_id_t>(value, attr);
+      } else if (attr == "user") {
+        e.user = value;
+      } else if (attr == "visible") {
+        e.visible = value == "true";
+      } else if (attr == "redaction") {
+        e.redacted = true;
+      } else if (attr == "lat" && lat != nullptr) {
+        *lat = parse_number<double>(value, attr);
+      } else if (attr == "lon" && lon != nullptr) {
+        *lon = parse_number<double>(value, attr);
+      }
+    }
+
+    if (!has_id)
+      throw std::runtime_error("Element without id attribute");
+    return e;
+  }
+
+  static osm_store::changeset parse_changeset(const char **attributes) {
+    osm_store::changeset cs;
+    std::optional<double> min_lat, min_lon, max_lat, max_lon;
+
+    for (; *attributes != nullptr; attributes += 2) {
+      const std::string_view attr(attributes[0]);
+      const std::string_view value(attributes[1]);
+
+      if (attr == "id")
+        cs.info.id = parse_number<osm_changeset_id_t>(value, attr);
+      else if (attr == "created_at")
+        cs.info.created_at = value;
+      else if (attr == "closed_at")
+        cs.info.closed_at = value;
+      else if (attr == "uid")
+        cs.info.uid = parse_number<osm_user_id_t>(value, attr);
+      else if (attr == "user")
+        cs.info.display_name = std::string(value);
+      else if (attr == "num_changes")
+        cs.info.num_changes = parse_number<std::size_t>(value, attr);
+      else if (attr == "min_lat")
+        min_lat = parse_number<double>(value, attr);
+      else if (attr == "min_lon")
+        min_lon = parse_number<double>(value, attr);
+      else if (attr == "max_lat")
+        max_lat = parse_number<double>(value, attr);
+      else if (attr == "max_lon")
+        max_lon = parse_number<double>(value, attr);
+    }
+
+    if (min_lat && min_lon && max_lat && max_lon)
+      cs.info.bounding_box = bbox(*min_lat, *min_lon, *max_lat, *max_lon);
+    return cs;
+  }
+
+  static changeset_comment_info parse_comment(const char **attributes) {
+    changeset_comment_info info{};
+
+    for (; *attributes != nullptr; attributes += 2) {
+      const std::string_view attr(attributes[0]);
+      const std::string_view value(attributes[1]);
+
+      if (attr == "id")
+        info.id = parse_number<osm_changeset_comment_id_t>(value, attr);
+      else if (attr == "uid")
+        info.author_id = parse_number<osm_user_id_t>(value, attr);
+      else if (attr == "user")
+        info.author_display_name = value;
+      else if (attr == "date")
+        info.created_at = value;
+    }
+    return info;
+  }
+
+  accept_t m_accept;
+  osm_store_builder m_builder;
+  std::optional<osm_store::changeset> m_changeset;
+  bool m_in_text = false;
+  bool m_in_delete = false;
+  // the element started last was skipped
+  bool m_skip = false;
+};
+
+} // anonymous namespace
+
+std::unique_ptr<osm_store> load_osm_xml(std::string_view data) {
+  osm_xml_loader loader;
+  return loader.load(data);
+}
+
+std::unique_ptr<osm_store> load_osm_change(std::string_view data,
+                                           const osm_xml_loader::accept_t &accept) {
+  osm_xml_loader loader(accept);
+  return loader.load(data);
+}
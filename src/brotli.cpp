@@ -9,8 +9,12 @@
 
 
 #include "cgimap/brotli.hpp"
+#include "cgimap/request_timing.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <new>
+#include <stdexcept>
 
 #if HAVE_BROTLI
 
@@ -25,6 +29,7 @@ brotli_output_buffer::brotli_output_buffer(output_buffer& o)
 
 int brotli_output_buffer::compress(const char *data, int data_length, bool last)
 {
+  auto span = request_timing::measure(request_timing::phase::compress);
   auto operation = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
   size_t available_in = data_length;
   auto next_in = reinterpret_cast<const uint8_t *>(data);
@@ -81,4 +86,60 @@ int brotli_output_buffer::flush() noexcept {
   return 0;
 }
 
+
+/*******************************************************************************/
+
+BrotliDecompressor::BrotliDecompressor() {
+
+  state_ = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+  if (state_ == nullptr)
+    throw std::bad_alloc();
+}
+
+BrotliDecompressor::~BrotliDecompressor() {
+  BrotliDecoderDestroyInstance(state_);
+}
+
+void BrotliDecompressor::decompress(std::string_view input, std::string& output,
+                                    std::size_t max_output) {
+
+  // any data after the end of the compressed stream is ignored
+  if (finished)
+    return;
+
+  size_t available_in = input.size();
+  auto next_in = reinterpret_cast<const uint8_t *>(input.data());
+
+  while (true) {
+    // never decompress beyond max_output, the remaining input is left unused
+    if (output.size() >= max_output)
+      return;
+
+    const size_t window = std::min<size_t>(
+        std::max<size_t>(min_output_window, 4 * available_in),
+        max_output - output.size());
+
+    size_t available_out = window;
+    auto next_out = reinterpret_cast<uint8_t *>(grow_output(output, window));
+
+    auto result = BrotliDecoderDecompressStream(state_, &available_in, &next_in,
+                                                &available_out, &next_out, nullptr);
+
+    // drop the unused part of the output window
+    output.resize(output.size() - available_out);
+
+    switch (result) {
+    case BROTLI_DECODER_RESULT_ERROR:
+      throw std::runtime_error("Brotli decompression failed");
+    case BROTLI_DECODER_RESULT_SUCCESS:
+      finished = true;
+      return;
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+      return;
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+      break;
+    }
+  }
+}
+
 #endif
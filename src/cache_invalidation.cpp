@@ -0,0 +1,159 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/cache_invalidation.hpp"
+#include "cgimap/util.hpp"
+#include "cgimap/api06/changeset_upload/osmchange_tracking.hpp"
+
+#include <charconv>
+#include <optional>
+
+#include <fmt/core.h>
+
+namespace cache_invalidation {
+
+namespace {
+
+// PostgreSQL rejects NOTIFY payloads of 8000 bytes or more
+constexpr std::size_t max_payload_size = 7900;
+
+std::optional<element_type> parse_type(std::string_view type) {
+  for (auto t : {element_type::node, element_type::way, element_type::relation,
+                 element_type::changeset}) {
+    if (type == element_type_name(t))
+      return t;
+  }
+  return {};
+}
+
+template <typename T>
+std::optional<T> parse_number(std::string_view s) {
+  T value{};
+  const auto *end = s.data() + s.size();
+  auto [ptr, ec] = std::from_chars(s.data(), end, value);
+  if (ec != std::errc() || ptr != end || s.empty())
+    return {};
+  return value;
+}
+
+std::optional<bbox> parse_area(std::string_view token) {
+  bbox bounds;
+  if (!bounds.parse(std::string(token)) || !bounds.valid())
+    return {};
+  return bounds;
+}
+
+std::optional<item> parse_item(std::string_view token) {
+  const auto slash = token.find('/');
+  if (slash == std::string_view::npos)
+    return {};
+
+  const auto type = parse_type(token.substr(0, slash));
+  auto rest = token.substr(slash + 1);
+  const auto version_slash = rest.find('/');
+
+  const auto id = parse_number<osm_nwr_id_t>(rest.substr(0, version_slash));
+  if (!type || !id)
+    return {};
+
+  if (version_slash == std::string_view::npos)
+    return item{*type, *id};
+
+  const auto version = parse_number<osm_version_t>(rest.substr(version_slash + 1));
+  if (!version || *version == 0)
+    return {};
+  return item{*type, *id, *version};
+}
+
+} // anonymous namespace
+
+std::vector<std::string> payloads(const changes &c) {
+  std::vector<std::string> result;
+  std::string current;
+
+  auto add = [&](const std::string &token) {
+    if (!current.empty() && current.size() + 1 + token.size() > max_payload_size) {
+      result.push_back(std::move(current));
+      current.clear();
+    }
+    if (!current.empty())
+      current += ' ';
+    current += token;
+  };
+
+  for (const auto &i : c.items) {
+    add(i.version == 0
+            ? fmt::format("{}/{}", element_type_name(i.type), i.id)
+            : fmt::format("{}/{}/{}", element_type_name(i.type), i.id, i.version));
+  }
+
+  for (const auto &a : c.areas)
+    add(fmt::format("area/{:.7f},{:.7f},{:.7f},{:.7f}", a.minlon, a.minlat, a.maxlon, a.maxlat));
+
+  if (!current.empty())
+    result.push_back(std::move(current));
+  return result;
+}
+
+changes parse(std::string_view payload) {
+  changes result;
+
+  while (!payload.empty()) {
+    const auto space = payload.find(' ');
+    const auto token = payload.substr(0, space);
+    payload.remove_prefix(space == std::string_view::npos ? payload.size() : space + 1);
+
+    if (token.starts_with("area/")) {
+      if (auto a = parse_area(token.substr(5)))
+        result.areas.push_back(*a);
+    } else if (auto i = parse_item(token)) {
+      result.items.push_back(*i);
+    }
+  }
+  return result;
+}
+
+changes changed_by(const api06::OSMChange_Tracking &tracking, const bbox_t &bounds) {
+  changes result;
+
+  auto add_ids = [&](element_type type, const auto &mappings) {
+    for (const auto &m : mappings)
+      result.items.push_back({type, m.new_id});
+  };
+
+  // deletions are tracked by the ids in the upload, placeholder ids of
+  // elements created in the same upload are already covered above
+  auto add_deleted = [&](element_type type, const auto &ids) {
+    for (auto id : ids) {
+      if (id > 0)
+        result.items.push_back({type, static_cast<osm_nwr_id_t>(id)});
+    }
+  };
+
+  add_ids(element_type::node, tracking.created_node_ids);
+  add_ids(element_type::way, tracking.created_way_ids);
+  add_ids(element_type::relation, tracking.created_relation_ids);
+  add_ids(element_type::node, tracking.modified_node_ids);
+  add_ids(element_type::way, tracking.modified_way_ids);
+  add_ids(element_type::relation, tracking.modified_relation_ids);
+  add_deleted(element_type::node, tracking.deleted_node_ids);
+  add_deleted(element_type::way, tracking.deleted_way_ids);
+  add_deleted(element_type::relation, tracking.deleted_relation_ids);
+
+  // undefined if no element with a location changed
+  if (!(bounds == bbox_t())) {
+    const double scale = global_settings::get_scale();
+    result.areas.emplace_back(bounds.minlat / scale, bounds.minlon / scale,
+                              bounds.maxlat / scale, bounds.maxlon / scale);
+  }
+
+  return result;
+}
+
+} // namespace cache_invalidation
@@ -0,0 +1,199 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/cache_store.hpp"
+#include "cgimap/logger.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+// memcached treats relative expiry times longer than 30 days as absolute
+// timestamps
+constexpr std::chrono::seconds max_memcached_ttl{60L * 60L * 24L * 30L};
+
+std::string memcached_key(std::string_view key) {
+  return fmt::format("cgimap:{}", key);
+}
+
+} // anonymous namespace
+
+lru_cache_store::lru_cache_store(std::size_t max_bytes)
+  : m_max_bytes(max_bytes) {}
+
+std::optional<std::string> lru_cache_store::get(std::string_view key) {
+  std::scoped_lock lock(m_mutex);
+
+  auto itr = m_index.find(key);
+  if (itr == m_index.end())
+    return {};
+
+  auto entry = itr->second;
+  if (entry->expires <= std::chrono::steady_clock::now()) {
+    erase_entry(entry);
+    return {};
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, entry);
+  return entry->value;
+}
+
+void lru_cache_store::put(std::string_view key, std::string_view value,
+                          std::chrono::seconds ttl) {
+  const auto size = key.size() + value.size();
+  if (size > m_max_bytes)
+    return;
+
+  std::scoped_lock lock(m_mutex);
+
+  if (auto itr = m_index.find(key); itr != m_index.end())
+    erase_entry(itr->second);
+
+  while (m_bytes + size > m_max_bytes)
+    erase_entry(std::prev(m_entries.end()));
+
+  m_entries.push_front({std::string(key), std::string(value),
+                        std::chrono::steady_clock::now() + ttl});
+  // the key of the entry never moves, even if the entry is spliced
+  m_index.emplace(m_entries.front().key, m_entries.begin());
+  m_bytes += size;
+}
+
+std::size_t lru_cache_store::bytes() const {
+  std::scoped_lock lock(m_mutex);
+  return m_bytes;
+}
+
+void lru_cache_store::erase(std::string_view key) {
+  std::scoped_lock lock(m_mutex);
+
+  if (auto itr = m_index.find(key); itr != m_index.end())
+    erase_entry(itr->second);
+}
+
+void lru_cache_store::erase_entry(list_t::iterator itr) {
+  m_bytes -= itr->key.size() + itr->value.size();
+  m_index.erase(itr->key);
+  m_entries.erase(itr);
+}
+
+memcached_cache_store::memcached_cache_store(const std::string &servers)
+  : m_ptr(memcached_create(nullptr)) {
+
+  if (m_ptr == nullptr)
+    throw std::runtime_error("Failed to create memcached client");
+
+  memcached_behavior_set(m_ptr, MEMCACHED_BEHAVIOR_NO_BLOCK, 1);
+  memcached_behavior_set(m_ptr, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 1);
+
+  memcached_server_st *server_list = memcached_servers_parse(servers.c_str());
+  memcached_server_push(m_ptr, server_list);
+  memcached_server_list_free(server_list);
+}
+
+memcached_cache_store::~memcached_cache_store() {
+  for (auto *ptr : m_idle)
+    memcached_free(ptr);
+  memcached_free(m_ptr);
+}
+
+memcached_cache_store::client::client(memcached_cache_store &store)
+  : m_store(store) {
+
+  std::scoped_lock lock(store.m_mutex);
+
+  if (!store.m_idle.empty()) {
+    m_ptr = store.m_idle.back();
+    store.m_idle.pop_back();
+    return;
+  }
+
+  m_ptr = memcached_clone(nullptr, store.m_ptr);
+  if (m_ptr == nullptr)
+    throw std::runtime_error("Failed to create memcached client");
+}
+
+memcached_cache_store::client::~client() {
+  std::scoped_lock lock(m_store.m_mutex);
+  m_store.m_idle.push_back(m_ptr);
+}
+
+std::optional<std::string> memcached_cache_store::get(std::string_view key) {
+  const auto mc_key = memcached_key(key);
+  size_t length = 0;
+  uint32_t flags = 0;
+  memcached_return_t error{};
+
+  client c(*this);
+  char *value = memcached_get(c.get(), mc_key.data(), mc_key.size(), &length, &flags, &error);
+  if (value == nullptr)
+    return {};
+
+  std::string result(value, length);
+  free(value);
+  return result;
+}
+
+void memcached_cache_store::put(std::string_view key, std::string_view value,
+                                std::chrono::seconds ttl) {
+  const auto mc_key = memcached_key(key);
+  // failures only mean that the value isn't cached
+  client c(*this);
+  memcached_set(c.get(), mc_key.data(), mc_key.size(), value.data(), value.size(),
+                std::min(ttl, max_memcached_ttl).count(), 0);
+}
+
+void memcached_cache_store::erase(std::string_view key) {
+  const auto mc_key = memcached_key(key);
+  client c(*this);
+  memcached_delete(c.get(), mc_key.data(), mc_key.size(), 0);
+}
+
+std::shared_ptr<cache_store> create_cache_store(const po::variables_map &options,
+                                                cache_store *shared) {
+
+  const auto type = options.contains("selection-cache")
+                        ? options["selection-cache"].as<std::string>()
+                        : std::string("none");
+
+  if (type == "none")
+    return nullptr;
+
+  if (type == "lru") {
+    const auto size = options["selection-cache-size"].as<long>();
+    if (size <= 0)
+      throw std::runtime_error("--selection-cache-size must be a positive number of MB");
+    logger::message(fmt::format("In-process selection cache enabled ({} MB)", size));
+    return std::make_shared<lru_cache_store>(size * 1024 * 1024);
+  }
+
+  if (type == "shm") {
+    if (shared == nullptr)
+      throw std::runtime_error("--selection-cache shm requires --shm-cache-size");
+    logger::message("Shared memory selection cache enabled");
+    // owned by main, outliving all selections
+    return std::shared_ptr<cache_store>(std::shared_ptr<cache_store>(), shared);
+  }
+
+  if (type == "memcache") {
+    if (!options.contains("memcache"))
+      throw std::runtime_error("--selection-cache memcache requires --memcache");
+    const auto servers = options["memcache"].as<std::string>();
+    logger::message(fmt::format("memcached selection cache enabled ({})", servers));
+    return std::make_shared<memcached_cache_store>(servers);
+  }
+
+  throw std::runtime_error(fmt::format(
+      "Unknown selection cache '{}', available options are: none, lru, shm, memcache", type));
+}
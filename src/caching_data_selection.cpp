@@ -0,0 +1,1237 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/caching_data_selection.hpp"
+#include "cgimap/metrics.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/backend/apidb/transaction_manager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fmt/core.h>
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+namespace {
+
+// bump when the serialization below changes, so that values written by
+// older versions are never read
+constexpr int cache_format = 1;
+
+std::string history_key(element_type type, const osm_edition_t &ed) {
+  return fmt::format("history{}/{}/{}/{}", cache_format, element_type_name(type), ed.first,
+                     ed.second);
+}
+
+std::string changeset_key(osm_changeset_id_t id) {
+  return fmt::format("changeset{}/{}", cache_format, id);
+}
+
+std::string visibility_key(element_type type, osm_nwr_id_t id) {
+  return fmt::format("visible{}/{}/{}", cache_format, element_type_name(type), id);
+}
+
+std::string max_id_key(element_type type) {
+  return fmt::format("maxid{}/{}", cache_format, element_type_name(type));
+}
+
+// map cells are only valid for the generation they were filled in
+std::string map_generation_key() {
+  return fmt::format("mapgeneration{}", cache_format);
+}
+
+// cells a map call may be assembled from, larger areas aren't cached
+constexpr int64_t max_map_cells = 16;
+
+// cells erased for a changed area, larger areas start a new generation
+constexpr int64_t max_invalidated_cells = 1024;
+
+// largest value stored for a cell, larger cells are marked as not cacheable
+constexpr std::size_t max_map_cell_value = 1024 * 1024;
+
+// the generation has to outlive the cells, it is renewed if it is evicted
+constexpr std::chrono::seconds map_generation_ttl{7 * 24 * 3600};
+
+struct cell_range {
+  int64_t minx;
+  int64_t miny;
+  int64_t maxx;
+  int64_t maxy;
+
+  [[nodiscard]] int64_t size() const { return (maxx - minx + 1) * (maxy - miny + 1); }
+};
+
+/**
+ * grid of map cells, in the scaled coordinates nodes are stored in. cells
+ * include their edges, so that nodes on an edge are part of both cells.
+ */
+class map_grid {
+public:
+  explicit map_grid(double cell_size)
+    : m_scale(global_settings::get_scale()),
+      m_size(std::max<int64_t>(1, std::llround(cell_size * m_scale))),
+      m_lon_offset(180 * m_scale),
+      m_lat_offset(90 * m_scale) {}
+
+  // cells containing the nodes a map call for bounds selects, with the
+  // bounds converted as in the database query
+  [[nodiscard]] cell_range cells_for(const bbox &bounds) const {
+    return range(int(bounds.minlon * m_scale), int(bounds.minlat * m_scale),
+                 int(bounds.maxlon * m_scale), int(bounds.maxlat * m_scale));
+  }
+
+  // cells containing any node in area
+  [[nodiscard]] cell_range cells_touching(const bbox &area) const {
+    return range(std::llround(area.minlon * m_scale) - 1, std::llround(area.minlat * m_scale) - 1,
+                 std::llround(area.maxlon * m_scale) + 1, std::llround(area.maxlat * m_scale) + 1);
+  }
+
+  // bounds selecting all nodes of a cell, rounding outwards
+  [[nodiscard]] bbox bounds_of(int64_t x, int64_t y) const {
+    auto degrees = [&](int64_t cell, int64_t offset, double slack) {
+      const double limit = double(offset) / m_scale;
+      return std::clamp((cell * m_size - offset + slack) / m_scale, -limit, limit);
+    };
+    return {degrees(y, m_lat_offset, -0.5), degrees(x, m_lon_offset, -0.5),
+            degrees(y + 1, m_lat_offset, 0.5), degrees(x + 1, m_lon_offset, 0.5)};
+  }
+
+  [[nodiscard]] std::string key(int64_t x, int64_t y) const {
+    return fmt::format("map{}/{}/{}/{}", cache_format, m_size, x, y);
+  }
+
+private:
+  [[nodiscard]] cell_range range(int64_t minlon, int64_t minlat, int64_t maxlon,
+                                 int64_t maxlat) const {
+    auto cell = [&](int64_t v, int64_t offset) {
+      return std::clamp<int64_t>(v + offset, 0, 2 * offset) / m_size;
+    };
+    return {cell(minlon, m_lon_offset), cell(minlat, m_lat_offset),
+            cell(maxlon, m_lon_offset), cell(maxlat, m_lat_offset)};
+  }
+
+  int64_t m_scale;
+  int64_t m_size;
+  int64_t m_lon_offset;
+  int64_t m_lat_offset;
+};
+
+uint64_t new_map_generation(cache_store &cache) {
+  thread_local std::mt19937_64 gen(std::random_device{}());
+  const auto generation = gen();
+  cache.put(map_generation_key(), std::to_string(generation), map_generation_ttl);
+  return generation;
+}
+
+uint64_t map_generation(cache_store &cache) {
+  if (auto value = cache.get(map_generation_key())) {
+    uint64_t generation = 0;
+    const auto *end = value->data() + value->size();
+    auto [ptr, ec] = std::from_chars(value->data(), end, generation);
+    if (ec == std::errc() && ptr == end)
+      return generation;
+  }
+  return new_map_generation(cache);
+}
+
+// map cells can get large, so their values are compressed if possible
+std::string pack(std::string raw) {
+#ifdef HAVE_LIBZ
+  const uint64_t raw_size = raw.size();
+  constexpr auto header = 1 + sizeof(raw_size);
+  uLongf length = compressBound(raw.size());
+  std::string out(header + length, '\0');
+  out[0] = 'z';
+  std::memcpy(out.data() + 1, &raw_size, sizeof(raw_size));
+  if (compress2(reinterpret_cast<Bytef *>(out.data() + header), &length,
+                reinterpret_cast<const Bytef *>(raw.data()), raw.size(), Z_BEST_SPEED) == Z_OK) {
+    out.resize(header + length);
+    return out;
+  }
+#endif
+  raw.insert(raw.begin(), 'r');
+  return raw;
+}
+
+std::optional<std::string> unpack(std::string_view value) {
+  if (value.starts_with('r'))
+    return std::string(value.substr(1));
+#ifdef HAVE_LIBZ
+  uint64_t raw_size = 0;
+  constexpr auto header = 1 + sizeof(raw_size);
+  if (value.starts_with('z') && value.size() > header) {
+    std::memcpy(&raw_size, value.data() + 1, sizeof(raw_size));
+    // deflate doesn't compress by more than about 1000:1
+    if (raw_size > 1024 * value.size())
+      return {};
+    std::string raw(raw_size, '\0');
+    uLongf length = raw_size;
+    if (uncompress(reinterpret_cast<Bytef *>(raw.data()), &length,
+                   reinterpret_cast<const Bytef *>(value.data() + header),
+                   value.size() - header) == Z_OK &&
+        length == raw_size)
+      return raw;
+  }
+#endif
+  return {};
+}
+
+class value_writer {
+public:
+  template <typename T>
+  void number(T value) {
+    static_assert(std::is_arithmetic_v<T>);
+    m_out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void string(std::string_view value) {
+    number<uint64_t>(value.size());
+    m_out.append(value);
+  }
+
+  template <typename T>
+  void optional(const std::optional<T> &value) {
+    number<bool>(value.has_value());
+    if (value) {
+      if constexpr (std::is_arithmetic_v<T>)
+        number(*value);
+      else
+        string(*value);
+    }
+  }
+
+  void tags(const tags_t &tags) {
+    number<uint64_t>(tags.size());
+    for (const auto &[key, value] : tags) {
+      string(key);
+      string(value);
+    }
+  }
+
+  std::string str() && { return std::move(m_out); }
+
+private:
+  std::string m_out;
+};
+
+class value_reader {
+public:
+  explicit value_reader(std::string_view in) : m_in(in) {}
+
+  template <typename T>
+  T number() {
+    static_assert(std::is_arithmetic_v<T>);
+    T value;
+    std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+    return value;
+  }
+
+  std::string string() {
+    return std::string(take(number<uint64_t>()));
+  }
+
+  template <typename T>
+  std::optional<T> optional() {
+    if (!number<bool>())
+      return {};
+    if constexpr (std::is_arithmetic_v<T>)
+      return number<T>();
+    else
+      return string();
+  }
+
+  tags_t tags() {
+    tags_t tags(count());
+    for (auto &[key, value] : tags) {
+      key = string();
+      value = string();
+    }
+    return tags;
+  }
+
+  // number of items following, checked against the remaining input so that
+  // a corrupt value can't allocate huge vectors
+  std::size_t count() {
+    const auto n = number<uint64_t>();
+    if (n > m_in.size())
+      throw std::runtime_error("Corrupt cache value");
+    return n;
+  }
+
+  bool done() const { return m_in.empty(); }
+
+private:
+  std::string_view take(uint64_t n) {
+    if (n > m_in.size())
+      throw std::runtime_error("Truncated cache value");
+    auto result = m_in.substr(0, n);
+    m_in.remove_prefix(n);
+    return result;
+  }
+
+  std::string_view m_in;
+};
+
+struct element_record {
+  element_info info;
+  double lon = 0;
+  double lat = 0;
+  nodes_t nodes;
+  members_t members;
+  tags_t tags;
+};
+
+struct changeset_record {
+  changeset_info info;
+  tags_t tags;
+  // only if the changeset was written with its discussion
+  std::optional<comments_t> comments;
+};
+
+std::string encode_element(element_type type, const element_record &rec) {
+  value_writer out;
+  out.number(rec.info.id);
+  out.number(rec.info.version);
+  out.number(rec.info.changeset);
+  out.string(rec.info.timestamp);
+  out.optional(rec.info.uid);
+  out.optional(rec.info.display_name);
+  out.number(rec.info.visible);
+
+  switch (type) {
+  case element_type::node:
+    out.number(rec.lon);
+    out.number(rec.lat);
+    break;
+  case element_type::way:
+    out.number<uint64_t>(rec.nodes.size());
+    for (auto node : rec.nodes)
+      out.number(node);
+    break;
+  case element_type::relation:
+    out.number<uint64_t>(rec.members.size());
+    for (const auto &member : rec.members) {
+      out.number(static_cast<uint8_t>(member.type));
+      out.number(member.ref);
+      out.string(member.role);
+    }
+    break;
+  case element_type::changeset:
+    break;
+  }
+
+  out.tags(rec.tags);
+  return std::move(out).str();
+}
+
+std::optional<element_record> decode_element(element_type type, std::string_view value) {
+  try {
+    value_reader in(value);
+    element_record rec;
+    rec.info.id = in.number<osm_nwr_id_t>();
+    rec.info.version = in.number<osm_nwr_id_t>();
+    rec.info.changeset = in.number<osm_changeset_id_t>();
+    rec.info.timestamp = in.string();
+    rec.info.uid = in.optional<osm_user_id_t>();
+    rec.info.display_name = in.optional<std::string>();
+    rec.info.visible = in.number<bool>();
+
+    switch (type) {
+    case element_type::node:
+      rec.lon = in.number<double>();
+      rec.lat = in.number<double>();
+      break;
+    case element_type::way:
+      rec.nodes.resize(in.count());
+      for (auto &node : rec.nodes)
+        node = in.number<osm_nwr_id_t>();
+      break;
+    case element_type::relation:
+      rec.members.resize(in.count());
+      for (auto &member : rec.members) {
+        member.type = static_cast<element_type>(in.number<uint8_t>());
+        member.ref = in.number<osm_nwr_id_t>();
+        member.role = in.string();
+      }
+      break;
+    case element_type::changeset:
+      break;
+    }
+
+    rec.tags = in.tags();
+    if (!in.done())
+      return {};
+    return rec;
+  } catch (const std::runtime_error &) {
+    return {};
+  }
+}
+
+std::string encode_changeset(const changeset_record &rec) {
+  value_writer out;
+  out.number(rec.info.id);
+  out.string(rec.info.created_at);
+  out.string(rec.info.closed_at);
+  out.optional(rec.info.uid);
+  out.optional(rec.info.display_name);
+  out.number<bool>(rec.info.bounding_box.has_value());
+  if (rec.info.bounding_box) {
+    out.number(rec.info.bounding_box->minlat);
+    out.number(rec.info.bounding_box->minlon);
+    out.number(rec.info.bounding_box->maxlat);
+    out.number(rec.info.bounding_box->maxlon);
+  }
+  out.number<uint64_t>(rec.info.num_changes);
+  out.number<uint64_t>(rec.info.comments_count);
+  out.tags(rec.tags);
+
+  out.number<bool>(rec.comments.has_value());
+  if (rec.comments) {
+    out.number<uint64_t>(rec.comments->size());
+    for (const auto &comment : *rec.comments) {
+      out.number(comment.id);
+      out.number(comment.author_id);
+      out.string(comment.body);
+      out.string(comment.created_at);
+      out.string(comment.author_display_name);
+    }
+  }
+  return std::move(out).str();
+}
+
+std::optional<changeset_record> decode_changeset(std::string_view value) {
+  try {
+    value_reader in(value);
+    changeset_record rec;
+    rec.info.id = in.number<osm_changeset_id_t>();
+    rec.info.created_at = in.string();
+    rec.info.closed_at = in.string();
+    rec.info.uid = in.optional<osm_user_id_t>();
+    rec.info.display_name = in.optional<std::string>();
+    if (in.number<bool>()) {
+      bbox bounds;
+      bounds.minlat = in.number<double>();
+      bounds.minlon = in.number<double>();
+      bounds.maxlat = in.number<double>();
+      bounds.maxlon = in.number<double>();
+      rec.info.bounding_box = bounds;
+    }
+    rec.info.num_changes = in.number<uint64_t>();
+    rec.info.comments_count = in.number<uint64_t>();
+    rec.tags = in.tags();
+
+    if (in.number<bool>()) {
+      rec.comments.emplace(in.count());
+      for (auto &comment : *rec.comments) {
+        comment.id = in.number<osm_changeset_comment_id_t>();
+        comment.author_id = in.number<osm_user_id_t>();
+        comment.body = in.string();
+        comment.created_at = in.string();
+        comment.author_display_name = in.string();
+      }
+    }
+
+    if (!in.done())
+      return {};
+    return rec;
+  } catch (const std::runtime_error &) {
+    return {};
+  }
+}
+
+/**
+ * captures the elements and changesets written by the wrapped selection,
+ * so that they can be cached and merged with the cached ones.
+ */
+class recording_formatter : public output_formatter {
+public:
+  std::vector<element_record> elements;
+  std::vector<changeset_record> changesets;
+
+  mime::type mime_type() const override { return mime::type::unspecified_type; }
+
+  void start_document(const std::string &, const std::string &) override {}
+  void end_document() override {}
+  void write_bounds(const bbox &) override {}
+  void start_element() override {}
+  void end_element() override {}
+  void start_changeset(bool) override {}
+  void end_changeset(bool) override {}
+  void start_action(action_type) override {}
+  void end_action(action_type) override {}
+  void flush() override {}
+
+  void error(const std::exception &e) override { throw std::runtime_error(e.what()); }
+  void error(const std::string &str) override { throw std::runtime_error(str); }
+
+  void write_node(const element_info &elem, double lon, double lat,
+                  const tags_t &tags) override {
+    elements.push_back({elem, lon, lat, {}, {}, tags});
+  }
+
+  void write_way(const element_info &elem, const nodes_t &nodes,
+                 const tags_t &tags) override {
+    elements.push_back({elem, 0, 0, nodes, {}, tags});
+  }
+
+  void write_relation(const element_info &elem, const members_t &members,
+                      const tags_t &tags) override {
+    elements.push_back({elem, 0, 0, {}, members, tags});
+  }
+
+  void write_changeset(const changeset_info &elem, const tags_t &tags, bool include_comments,
+                       const comments_t &comments,
+                       const std::chrono::system_clock::time_point &) override {
+    changesets.push_back({elem, tags,
+                          include_comments ? std::optional<comments_t>(comments) : std::nullopt});
+  }
+
+  void write_diffresult_create_modify(const element_type, const osm_nwr_signed_id_t,
+                                      const osm_nwr_id_t, const osm_version_t) override {}
+  void write_diffresult_delete(const element_type, const osm_nwr_signed_id_t) override {}
+};
+
+struct map_cell {
+  uint64_t generation = 0;
+  // seconds since the epoch
+  int64_t filled_at = 0;
+  // false if the cell has too many nodes
+  bool cacheable = true;
+  std::vector<element_record> nodes;
+  std::vector<element_record> ways;
+  std::vector<element_record> relations;
+};
+
+std::string encode_map_cell(const map_cell &cell) {
+  value_writer out;
+  out.number(cell.generation);
+  out.number(cell.filled_at);
+  out.number(cell.cacheable);
+  for (const auto &[type, records] : {std::pair{element_type::node, &cell.nodes},
+                                      std::pair{element_type::way, &cell.ways},
+                                      std::pair{element_type::relation, &cell.relations}}) {
+    out.number<uint64_t>(records->size());
+    for (const auto &rec : *records)
+      out.string(encode_element(type, rec));
+  }
+  return pack(std::move(out).str());
+}
+
+std::optional<map_cell> decode_map_cell(std::string_view value) {
+  const auto raw = unpack(value);
+  if (!raw)
+    return {};
+
+  try {
+    value_reader in(*raw);
+    map_cell cell;
+    cell.generation = in.number<uint64_t>();
+    cell.filled_at = in.number<int64_t>();
+    cell.cacheable = in.number<bool>();
+    for (const auto &[type, records] : {std::pair{element_type::node, &cell.nodes},
+                                        std::pair{element_type::way, &cell.ways},
+                                        std::pair{element_type::relation, &cell.relations}}) {
+      records->resize(in.count());
+      for (auto &rec : *records) {
+        auto decoded = decode_element(type, in.string());
+        if (!decoded)
+          return {};
+        rec = std::move(*decoded);
+      }
+    }
+    if (!in.done())
+      return {};
+    return cell;
+  } catch (const std::runtime_error &) {
+    return {};
+  }
+}
+
+// what a map call for the whole cell returns, see map_responder
+map_cell select_map_cell(data_selection &sel, const bbox &bounds, int max_nodes) {
+  map_cell cell;
+
+  const int selected = sel.select_nodes_from_bbox(bounds, max_nodes);
+  if (selected > max_nodes) {
+    cell.cacheable = false;
+    return cell;
+  }
+
+  if (selected > 0) {
+    sel.select_ways_from_nodes();
+    sel.select_nodes_from_way_nodes();
+    sel.select_relations_from_ways();
+    sel.select_relations_from_nodes();
+    sel.select_relations_from_relations();
+  }
+
+  recording_formatter nodes;
+  recording_formatter ways;
+  recording_formatter relations;
+  sel.write_nodes(nodes);
+  sel.write_ways(ways);
+  sel.write_relations(relations);
+  cell.nodes = std::move(nodes.elements);
+  cell.ways = std::move(ways.elements);
+  cell.relations = std::move(relations.elements);
+  return cell;
+}
+
+void write_record(element_type type, const element_record &rec, output_formatter &formatter) {
+  switch (type) {
+  case element_type::node:
+    formatter.write_node(rec.info, rec.lon, rec.lat, rec.tags);
+    break;
+  case element_type::way:
+    formatter.write_way(rec.info, rec.nodes, rec.tags);
+    break;
+  case element_type::relation:
+    formatter.write_relation(rec.info, rec.members, rec.tags);
+    break;
+  case element_type::changeset:
+    break;
+  }
+}
+
+void write_records(element_type type, const std::map<osm_nwr_id_t, element_record> &records,
+                   output_formatter &formatter) {
+  for (const auto &[id, rec] : records)
+    write_record(type, rec, formatter);
+}
+
+} // anonymous namespace
+
+struct caching_data_selection::map_selection {
+  // nodes in the bounding box
+  int selected = 0;
+  std::map<osm_nwr_id_t, element_record> nodes;
+  std::map<osm_nwr_id_t, element_record> ways;
+  std::map<osm_nwr_id_t, element_record> relations;
+};
+
+caching_data_selection::caching_data_selection(
+    std::unique_ptr<data_selection> selection, cache_store &cache, settings s,
+    std::function<std::unique_ptr<data_selection>()> make_selection)
+  : m_selection(std::move(selection)),
+    m_cache(cache),
+    m_settings(s),
+    m_make_selection(std::move(make_selection)) {}
+
+caching_data_selection::~caching_data_selection() = default;
+
+void caching_data_selection::write_nodes(output_formatter &formatter) {
+  if (m_map)
+    write_records(element_type::node, m_map->nodes, formatter);
+  write_elements(m_nodes, formatter, &data_selection::write_nodes);
+}
+
+void caching_data_selection::write_ways(output_formatter &formatter) {
+  if (m_map)
+    write_records(element_type::way, m_map->ways, formatter);
+  write_elements(m_ways, formatter, &data_selection::write_ways);
+}
+
+void caching_data_selection::write_relations(output_formatter &formatter) {
+  if (m_map)
+    write_records(element_type::relation, m_map->relations, formatter);
+  write_elements(m_relations, formatter, &data_selection::write_relations);
+}
+
+void caching_data_selection::write_elements(historic_versions &versions,
+                                            output_formatter &formatter,
+                                            void (data_selection::*write)(output_formatter &)) {
+  if (versions.cached.empty() && versions.uncached.empty()) {
+    (m_selection.get()->*write)(formatter);
+    return;
+  }
+
+  recording_formatter recorder;
+  (m_selection.get()->*write)(recorder);
+
+  std::map<osm_edition_t, element_record> records;
+  for (auto &rec : recorder.elements) {
+    const osm_edition_t ed(rec.info.id, rec.info.version);
+    // moderators see the redacted versions, which must not end up in the
+    // cache for everyone else
+    if (!m_redactions_visible && versions.uncached.contains(ed))
+      m_cache.put(history_key(versions.type, ed), encode_element(versions.type, rec),
+                  m_settings.ttl);
+    records.try_emplace(ed, std::move(rec));
+  }
+
+  for (const auto &[ed, value] : versions.cached) {
+    if (auto rec = decode_element(versions.type, value))
+      records.try_emplace(ed, std::move(*rec));
+  }
+
+  for (const auto &[ed, rec] : records)
+    write_record(versions.type, rec, formatter);
+}
+
+void caching_data_selection::write_changesets(output_formatter &formatter,
+                                              const std::chrono::system_clock::time_point &now) {
+  if (m_cached_changesets.empty() && m_uncached_changesets.empty()) {
+    m_selection->write_changesets(formatter, now);
+    return;
+  }
+
+  std::map<osm_changeset_id_t, changeset_record> records;
+
+  // changesets cached without their discussion are selected after all
+  // when it is needed
+  std::vector<osm_changeset_id_t> without_discussion;
+  for (const auto &[id, value] : m_cached_changesets) {
+    auto rec = decode_changeset(value);
+    if (!rec)
+      continue;
+    if (m_include_discussions && !rec->comments)
+      without_discussion.push_back(id);
+    else
+      records.emplace(id, std::move(*rec));
+  }
+  if (!without_discussion.empty()) {
+    m_selection->select_changesets(without_discussion);
+    m_uncached_changesets.insert(without_discussion.begin(), without_discussion.end());
+  }
+
+  recording_formatter recorder;
+  m_selection->write_changesets(recorder, now);
+
+  for (auto &rec : recorder.changesets) {
+    // open changesets still change
+    if (m_uncached_changesets.contains(rec.info.id) && !rec.info.is_open_at(now))
+      m_cache.put(changeset_key(rec.info.id), encode_changeset(rec), m_settings.ttl);
+    records.insert_or_assign(rec.info.id, std::move(rec));
+  }
+
+  for (const auto &[id, rec] : records)
+    formatter.write_changeset(rec.info, rec.tags, m_include_discussions,
+                              rec.comments ? *rec.comments : comments_t{}, now);
+}
+
+data_selection::visibility_t caching_data_selection::check_node_visibility(osm_nwr_id_t id) {
+  return check_visibility(element_type::node, id, &data_selection::check_node_visibility);
+}
+
+data_selection::visibility_t caching_data_selection::check_way_visibility(osm_nwr_id_t id) {
+  return check_visibility(element_type::way, id, &data_selection::check_way_visibility);
+}
+
+data_selection::visibility_t caching_data_selection::check_relation_visibility(osm_nwr_id_t id) {
+  return check_visibility(element_type::relation, id, &data_selection::check_relation_visibility);
+}
+
+std::optional<osm_nwr_id_t> caching_data_selection::max_element_id(element_type type) {
+  return m_selection->max_element_id(type);
+}
+
+std::optional<data_selection::visibility_t>
+caching_data_selection::cached_visibility(element_type type, osm_nwr_id_t id) {
+  const auto value = m_cache.get(visibility_key(type, id));
+  if (value && value->size() == 1 && (*value)[0] >= '0' && (*value)[0] <= '2')
+    return static_cast<visibility_t>((*value)[0] - '0');
+  return {};
+}
+
+data_selection::visibility_t caching_data_selection::check_visibility(
+    element_type type, osm_nwr_id_t id, visibility_t (data_selection::*check)(osm_nwr_id_t)) {
+
+  if (m_settings.visibility_ttl.count() <= 0)
+    return (m_selection.get()->*check)(id);
+
+  const auto cached = cached_visibility(type, id);
+  metrics::count_cache_lookup("visibility", cached.has_value());
+  if (cached)
+    return *cached;
+
+  const auto result = (m_selection.get()->*check)(id);
+
+  // elements above the highest id may still be created, so only missing
+  // elements below it are cached
+  if (result == non_exist) {
+    const auto cached = cached_highest_id(type);
+    const auto max_id = cached ? *cached : lookup_highest_id(type);
+    if (!max_id || id >= *max_id)
+      return result;
+  }
+
+  m_cache.put(visibility_key(type, id),
+              std::string(1, static_cast<char>('0' + static_cast<int>(result))),
+              m_settings.visibility_ttl);
+  return result;
+}
+
+bool caching_data_selection::known_absent(element_type type, osm_nwr_id_t id) {
+  if (auto visibility = cached_visibility(type, id))
+    return *visibility == non_exist;
+
+  if (auto cached = cached_highest_id(type)) {
+    // the element may have been created since the highest id was cached,
+    // in which case looking it up again is still cheaper than the selection
+    if (!*cached || id <= **cached)
+      return false;
+  }
+
+  const auto max_id = lookup_highest_id(type);
+  return max_id && id > *max_id;
+}
+
+std::optional<std::optional<osm_nwr_id_t>>
+caching_data_selection::cached_highest_id(element_type type) {
+  const auto value = m_cache.get(max_id_key(type));
+  if (!value)
+    return {};
+
+  // empty if the wrapped selection doesn't know the highest id
+  if (value->empty())
+    return std::optional<osm_nwr_id_t>{};
+
+  osm_nwr_id_t max_id = 0;
+  const auto *end = value->data() + value->size();
+  auto [ptr, ec] = std::from_chars(value->data(), end, max_id);
+  if (ec != std::errc() || ptr != end)
+    return {};
+  return std::optional<osm_nwr_id_t>{max_id};
+}
+
+std::optional<osm_nwr_id_t> caching_data_selection::lookup_highest_id(element_type type) {
+  const auto max_id = m_selection->max_element_id(type);
+  m_cache.put(max_id_key(type), max_id ? std::to_string(*max_id) : std::string(),
+              m_settings.visibility_ttl);
+  return max_id;
+}
+
+int caching_data_selection::select_current(
+    element_type type, const std::vector<osm_nwr_id_t> &ids,
+    int (data_selection::*select)(const std::vector<osm_nwr_id_t> &),
+    visibility_t (data_selection::*check)(osm_nwr_id_t)) {
+
+  // only lookups of a single element, as made by the element and full
+  // handlers, are checked, rather than adding a cache lookup for each id
+  // of larger selections
+  if (m_settings.visibility_ttl.count() <= 0 || ids.size() != 1)
+    return (m_selection.get()->*select)(ids);
+
+  const bool absent = known_absent(type, ids.front());
+  metrics::count_cache_lookup("absent", absent);
+  if (absent)
+    return 0;
+
+  const int selected = (m_selection.get()->*select)(ids);
+  // nothing is selected either if the element doesn't exist or if it was
+  // selected before, so the visibility is checked to find out which
+  if (selected == 0)
+    check_visibility(type, ids.front(), check);
+  return selected;
+}
+
+int caching_data_selection::select_nodes(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::node, ids, &data_selection::select_nodes,
+                        &data_selection::check_node_visibility);
+}
+
+int caching_data_selection::select_ways(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::way, ids, &data_selection::select_ways,
+                        &data_selection::check_way_visibility);
+}
+
+int caching_data_selection::select_relations(const std::vector<osm_nwr_id_t> &ids) {
+  return select_current(element_type::relation, ids, &data_selection::select_relations,
+                        &data_selection::check_relation_visibility);
+}
+
+int caching_data_selection::select_nodes_from_bbox(const bbox &bounds, int max_nodes) {
+  if (m_settings.map_cell_size > 0 && m_make_selection && !m_map) {
+    m_map = select_map(bounds, max_nodes);
+    if (m_map)
+      return m_map->selected;
+  }
+  return m_selection->select_nodes_from_bbox(bounds, max_nodes);
+}
+
+std::unique_ptr<caching_data_selection::map_selection>
+caching_data_selection::select_map(const bbox &bounds, int max_nodes) {
+
+  const map_grid grid(m_settings.map_cell_size);
+  const auto cells = grid.cells_for(bounds);
+  if (cells.size() > max_map_cells)
+    return nullptr;
+
+  const auto generation = map_generation(m_cache);
+  const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+
+  // the latest version of each element, as cells may have been filled at
+  // different times
+  std::map<osm_nwr_id_t, element_record> nodes;
+  std::map<osm_nwr_id_t, element_record> ways;
+  std::map<osm_nwr_id_t, element_record> relations;
+  auto merge = [](std::map<osm_nwr_id_t, element_record> &into,
+                  std::vector<element_record> &records) {
+    for (auto &rec : records) {
+      auto itr = into.find(rec.info.id);
+      if (itr == into.end())
+        into.emplace(rec.info.id, std::move(rec));
+      else if (itr->second.info.version < rec.info.version)
+        itr->second = std::move(rec);
+    }
+  };
+
+  for (auto y = cells.miny; y <= cells.maxy; ++y) {
+    for (auto x = cells.minx; x <= cells.maxx; ++x) {
+      const auto key = grid.key(x, y);
+
+      std::optional<map_cell> cell;
+      if (auto value = m_cache.get(key)) {
+        cell = decode_map_cell(*value);
+        if (cell && cell->generation != generation)
+          cell.reset();
+      }
+      metrics::count_cache_lookup("map", cell.has_value());
+
+      if (cell) {
+        metrics::observe_cache_age("map", std::chrono::seconds(now - cell->filled_at));
+      } else {
+        auto sel = m_make_selection();
+        cell = select_map_cell(*sel, grid.bounds_of(x, y), max_nodes);
+        cell->generation = generation;
+        cell->filled_at = now;
+
+        auto value = encode_map_cell(*cell);
+        if (value.size() > max_map_cell_value) {
+          cell = map_cell{generation, now, false, {}, {}, {}};
+          value = encode_map_cell(*cell);
+        }
+        m_cache.put(key, value, m_settings.map_ttl);
+      }
+
+      if (!cell->cacheable)
+        return nullptr;
+
+      merge(nodes, cell->nodes);
+      merge(ways, cell->ways);
+      merge(relations, cell->relations);
+    }
+  }
+
+  // the same selections as the map call, applied to the cells' elements.
+  // elements are moved into the result, so they are looked up there first.
+  auto result = std::make_unique<map_selection>();
+
+  const auto scale = global_settings::get_scale();
+  const int64_t minlat = int(bounds.minlat * scale);
+  const int64_t maxlat = int(bounds.maxlat * scale);
+  const int64_t minlon = int(bounds.minlon * scale);
+  const int64_t maxlon = int(bounds.maxlon * scale);
+
+  for (auto &[id, rec] : nodes) {
+    const auto lat = std::llround(rec.lat * scale);
+    const auto lon = std::llround(rec.lon * scale);
+    if (rec.info.visible && lat >= minlat && lat <= maxlat && lon >= minlon && lon <= maxlon)
+      result->nodes.emplace(id, std::move(rec));
+  }
+
+  result->selected = static_cast<int>(result->nodes.size());
+  if (result->selected == 0 || result->selected > max_nodes)
+    return result;
+
+  // ways from nodes
+  for (auto &[id, rec] : ways) {
+    if (std::ranges::any_of(rec.nodes, [&](auto node) { return result->nodes.contains(node); }))
+      result->ways.emplace(id, std::move(rec));
+  }
+
+  // nodes from way nodes
+  for (const auto &[id, way] : result->ways) {
+    for (auto node : way.nodes) {
+      if (result->nodes.contains(node))
+        continue;
+      if (auto itr = nodes.find(node); itr != nodes.end())
+        result->nodes.emplace(node, std::move(itr->second));
+    }
+  }
+
+  // relations from ways and nodes
+  for (auto &[id, rec] : relations) {
+    const bool member = std::ranges::any_of(rec.members, [&](const auto &m) {
+      return (m.type == element_type::way && result->ways.contains(m.ref)) ||
+             (m.type == element_type::node && result->nodes.contains(m.ref));
+    });
+    if (member)
+      result->relations.emplace(id, std::move(rec));
+  }
+
+  // relations from relations
+  std::vector<osm_nwr_id_t> parents;
+  for (const auto &[id, rec] : relations) {
+    if (result->relations.contains(id))
+      continue;
+    const bool member = std::ranges::any_of(rec.members, [&](const auto &m) {
+      return m.type == element_type::relation && result->relations.contains(m.ref);
+    });
+    if (member)
+      parents.push_back(id);
+  }
+  for (auto id : parents)
+    result->relations.emplace(id, std::move(relations.at(id)));
+
+  return result;
+}
+
+void caching_data_selection::select_nodes_from_relations() {
+  m_selection->select_nodes_from_relations();
+}
+
+// the map call's selections are already part of a map selection assembled
+// from cached cells, and there is nothing to select them from in the
+// wrapped selection
+
+void caching_data_selection::select_ways_from_nodes() {
+  if (!m_map)
+    m_selection->select_ways_from_nodes();
+}
+
+void caching_data_selection::select_ways_from_relations() {
+  m_selection->select_ways_from_relations();
+}
+
+void caching_data_selection::select_relations_from_ways() {
+  if (!m_map)
+    m_selection->select_relations_from_ways();
+}
+
+void caching_data_selection::select_nodes_from_way_nodes() {
+  if (!m_map)
+    m_selection->select_nodes_from_way_nodes();
+}
+
+void caching_data_selection::select_relations_from_nodes() {
+  if (!m_map)
+    m_selection->select_relations_from_nodes();
+}
+
+void caching_data_selection::select_relations_from_relations(bool drop_relations) {
+  if (!m_map)
+    m_selection->select_relations_from_relations(drop_relations);
+}
+
+void caching_data_selection::select_relations_members_of_relations() {
+  m_selection->select_relations_members_of_relations();
+}
+
+int caching_data_selection::select_changesets(const std::vector<osm_changeset_id_t> &ids) {
+  if (!m_settings.changesets)
+    return m_selection->select_changesets(ids);
+
+  int selected = 0;
+  std::vector<osm_changeset_id_t> uncached;
+
+  for (auto id : ids) {
+    if (m_cached_changesets.contains(id) || m_uncached_changesets.contains(id))
+      continue;
+
+    auto value = m_cache.get(changeset_key(id));
+    const bool hit = value && decode_changeset(*value);
+    metrics::count_cache_lookup("changesets", hit);
+
+    if (hit) {
+      m_cached_changesets.emplace(id, std::move(*value));
+      ++selected;
+    } else {
+      uncached.push_back(id);
+    }
+  }
+
+  if (!uncached.empty()) {
+    selected += m_selection->select_changesets(uncached);
+    m_uncached_changesets.insert(uncached.begin(), uncached.end());
+  }
+  return selected;
+}
+
+void caching_data_selection::select_changeset_discussions() {
+  m_include_discussions = true;
+  m_selection->select_changeset_discussions();
+}
+
+void caching_data_selection::drop_nodes() {
+  m_selection->drop_nodes();
+  if (m_map)
+    m_map->nodes.clear();
+  m_nodes.cached.clear();
+  m_nodes.uncached.clear();
+}
+
+void caching_data_selection::drop_ways() {
+  m_selection->drop_ways();
+  if (m_map)
+    m_map->ways.clear();
+  m_ways.cached.clear();
+  m_ways.uncached.clear();
+}
+
+void caching_data_selection::drop_relations() {
+  m_selection->drop_relations();
+  if (m_map)
+    m_map->relations.clear();
+  m_relations.cached.clear();
+  m_relations.uncached.clear();
+}
+
+int caching_data_selection::select_historical_nodes(const std::vector<osm_edition_t> &eds) {
+  return select_historical(m_nodes, eds, &data_selection::select_historical_nodes);
+}
+
+int caching_data_selection::select_historical_ways(const std::vector<osm_edition_t> &eds) {
+  return select_historical(m_ways, eds, &data_selection::select_historical_ways);
+}
+
+int caching_data_selection::select_historical_relations(const std::vector<osm_edition_t> &eds) {
+  return select_historical(m_relations, eds, &data_selection::select_historical_relations);
+}
+
+int caching_data_selection::select_historical(
+    historic_versions &versions, const std::vector<osm_edition_t> &eds,
+    int (data_selection::*select)(const std::vector<osm_edition_t> &)) {
+
+  if (!m_settings.history)
+    return (m_selection.get()->*select)(eds);
+
+  int selected = 0;
+  std::vector<osm_edition_t> uncached;
+
+  for (const auto &ed : eds) {
+    if (versions.cached.contains(ed))
+      continue;
+
+    auto value = m_cache.get(history_key(versions.type, ed));
+    const bool hit = value && decode_element(versions.type, *value);
+    metrics::count_cache_lookup("history", hit);
+
+    if (hit) {
+      versions.cached.emplace(ed, std::move(*value));
+      ++selected;
+    } else {
+      uncached.push_back(ed);
+    }
+  }
+
+  if (!uncached.empty()) {
+    selected += (m_selection.get()->*select)(uncached);
+    versions.uncached.insert(uncached.begin(), uncached.end());
+  }
+  return selected;
+}
+
+int caching_data_selection::select_nodes_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return m_selection->select_nodes_with_history(ids);
+}
+
+int caching_data_selection::select_ways_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return m_selection->select_ways_with_history(ids);
+}
+
+int caching_data_selection::select_relations_with_history(const std::vector<osm_nwr_id_t> &ids) {
+  return m_selection->select_relations_with_history(ids);
+}
+
+void caching_data_selection::set_redactions_visible(bool visible) {
+  m_redactions_visible = visible;
+  m_selection->set_redactions_visible(visible);
+}
+
+int caching_data_selection::select_historical_by_changesets(
+    const std::vector<osm_changeset_id_t> &ids) {
+  return m_selection->select_historical_by_changesets(ids);
+}
+
+bool caching_data_selection::supports_user_details() const {
+  return m_selection->supports_user_details();
+}
+
+bool caching_data_selection::is_user_blocked(const osm_user_id_t id) {
+  return m_selection->is_user_blocked(id);
+}
+
+std::set<osm_user_role_t> caching_data_selection::get_roles_for_user(osm_user_id_t id) {
+  return m_selection->get_roles_for_user(id);
+}
+
+std::optional<osm_user_id_t> caching_data_selection::get_user_id_for_oauth2_token(
+    const std::string &token_id, bool &expired, bool &revoked, bool &allow_api_write) {
+  return m_selection->get_user_id_for_oauth2_token(token_id, expired, revoked, allow_api_write);
+}
+
+bool caching_data_selection::is_user_active(const osm_user_id_t id) {
+  return m_selection->is_user_active(id);
+}
+
+std::optional<std::chrono::system_clock::time_point>
+caching_data_selection::data_timestamp() const {
+  return m_selection->data_timestamp();
+}
+
+void caching_data_selection::invalidate(cache_store &cache, const settings &s,
+                                        const cache_invalidation::changes &changes) {
+  // created elements may be above the cached highest id of their type
+  std::set<element_type> current_types;
+  for (const auto &item : changes.items) {
+    if (item.type == element_type::changeset) {
+      cache.erase(changeset_key(item.id));
+    } else if (item.version == 0) {
+      cache.erase(visibility_key(item.type, item.id));
+      current_types.insert(item.type);
+    } else {
+      cache.erase(history_key(item.type, {item.id, item.version}));
+    }
+  }
+  for (auto type : current_types)
+    cache.erase(max_id_key(type));
+
+  if (s.map_cell_size <= 0)
+    return;
+
+  const map_grid grid(s.map_cell_size);
+  for (const auto &area : changes.areas) {
+    const auto cells = grid.cells_touching(area);
+    if (cells.size() > max_invalidated_cells) {
+      new_map_generation(cache);
+      return;
+    }
+    for (auto y = cells.miny; y <= cells.maxy; ++y) {
+      for (auto x = cells.minx; x <= cells.maxx; ++x)
+        cache.erase(grid.key(x, y));
+    }
+  }
+}
+
+caching_data_selection::factory::factory(std::unique_ptr<data_selection::factory> factory,
+                                         std::shared_ptr<cache_store> cache, settings s)
+  : m_factory(std::move(factory)), m_cache(std::move(cache)), m_settings(s) {}
+
+std::unique_ptr<data_selection>
+caching_data_selection::factory::make_selection(Transaction_Owner_Base &t) const {
+  return std::make_unique<caching_data_selection>(
+      m_factory->make_selection(t), *m_cache, m_settings,
+      [this, &t] { return m_factory->make_selection(t); });
+}
+
+std::unique_ptr<Transaction_Owner_Base> caching_data_selection::factory::get_default_transaction() {
+  return m_factory->get_default_transaction();
+}
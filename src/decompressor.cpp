@@ -0,0 +1,34 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/decompressor.hpp"
+
+#include <algorithm>
+
+char* Decompressor::grow_output(std::string& output, std::size_t min_size) {
+
+  const auto used = output.size();
+
+  if (output.capacity() - used < min_size)
+    output.reserve(std::max(2 * output.capacity(), used + min_size));
+
+  // only the requested window gets initialized, not the whole reserved
+  // capacity, as this would be repeated for each chunk of input
+  output.resize(used + min_size);
+
+  return output.data() + used;
+}
+
+void IdentityDecompressor::decompress(std::string_view input, std::string& output,
+                                      std::size_t max_output) {
+  if (output.size() >= max_output)
+    return;
+
+  output.append(input.substr(0, max_output - output.size()));
+}
@@ -0,0 +1,271 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Snapshot export
+ *
+ * Writes the current versions of all elements in an APIDB database, or
+ * all elements of an OSM file, to a snapshot file for the snapshot
+ * backend:
+ *
+ *   openstreetmap-cgimap-snapshot --dbname openstreetmap --output osm.snapshot
+ *   openstreetmap-cgimap-snapshot --osm-file extract.osm.pbf --output extract.snapshot
+ *
+ * The database is read in batches of ascending ids within a single
+ * repeatable read transaction, so the snapshot is consistent even while
+ * the database is being updated. The whole store is built in memory
+ * before it is written.
+ */
+
+#include "cgimap/backend/apidb/utils.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/backend/memory/osm_store.hpp"
+#include "cgimap/backend/memory/snapshot.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/types.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <pqxx/pqxx>
+
+namespace po = boost::program_options;
+
+namespace {
+
+std::string connect_db_str(const po::variables_map &options) {
+  std::ostringstream ostr;
+  ostr << "dbname=" << escape_pg_value(options["dbname"].as<std::string>());
+  if (options.contains("host"))
+    ostr << " host=" << escape_pg_value(options["host"].as<std::string>());
+  if (options.contains("username"))
+    ostr << " user=" << escape_pg_value(options["username"].as<std::string>());
+  if (options.contains("password"))
+    ostr << " password=" << escape_pg_value(options["password"].as<std::string>());
+  if (options.contains("dbport"))
+    ostr << " port=" << escape_pg_value(options["dbport"].as<std::string>());
+  ostr << " fallback_application_name=openstreetmap-cgimap-snapshot";
+  return ostr.str();
+}
+
+// the author is only shown for users with public edits, same as in the
+// apidb backend
+constexpr const char *element_columns = R"(
+    e.id, e.version, e.changeset_id, e.visible,
+    CAST(extract(epoch FROM e.timestamp) AS bigint) AS timestamp,
+    u.id AS uid, u.display_name, t.keys AS tag_k, t.values AS tag_v)";
+
+constexpr const char *author_join = R"(
+    JOIN changesets c ON c.id = e.changeset_id
+    LEFT JOIN users u ON u.id = c.user_id AND u.data_public)";
+
+void prepare_statements(pqxx::connection &conn) {
+  conn.prepare("export_nodes", fmt::format(R"(
+    SELECT {}, e.latitude, e.longitude
+    FROM current_nodes e {}
+      LEFT JOIN LATERAL
+        (SELECT array_agg(k ORDER BY k) AS keys, array_agg(v ORDER BY k) AS values
+          FROM current_node_tags WHERE e.id = node_id) t ON true
+    WHERE e.id > $1
+    ORDER BY e.id
+    LIMIT $2)", element_columns, author_join));
+
+  conn.prepare("export_ways", fmt::format(R"(
+    SELECT {}, wn.node_ids
+    FROM current_ways e {}
+      LEFT JOIN LATERAL
+        (SELECT array_agg(k ORDER BY k) AS keys, array_agg(v ORDER BY k) AS values
+          FROM current_way_tags WHERE e.id = way_id) t ON true
+      LEFT JOIN LATERAL
+        (SELECT array_agg(node_id ORDER BY sequence_id) AS node_ids
+          FROM current_way_nodes WHERE e.id = way_id) wn ON true
+    WHERE e.id > $1
+    ORDER BY e.id
+    LIMIT $2)", element_columns, author_join));
+
+  conn.prepare("export_relations", fmt::format(R"(
+    SELECT {}, rm.types AS member_types, rm.ids AS member_ids, rm.roles AS member_roles
+    FROM current_relations e {}
+      LEFT JOIN LATERAL
+        (SELECT array_agg(k ORDER BY k) AS keys, array_agg(v ORDER BY k) AS values
+          FROM current_relation_tags WHERE e.id = relation_id) t ON true
+      LEFT JOIN LATERAL
+        (SELECT array_agg(member_type ORDER BY sequence_id) AS types,
+                array_agg(member_id ORDER BY sequence_id) AS ids,
+                array_agg(member_role ORDER BY sequence_id) AS roles
+          FROM current_relation_members WHERE e.id = relation_id) rm ON true
+    WHERE e.id > $1
+    ORDER BY e.id
+    LIMIT $2)", element_columns, author_join));
+}
+
+element_type type_from_name(const std::string &name) {
+  if (name == "Node")
+    return element_type::node;
+  if (name == "Way")
+    return element_type::way;
+  if (name == "Relation")
+    return element_type::relation;
+  throw std::runtime_error(fmt::format("Unexpected member type {}", name));
+}
+
+class db_exporter {
+public:
+  db_exporter(pqxx::connection &conn, int batch_size)
+    : m_txn(conn), m_batch_size(batch_size) {}
+
+  std::unique_ptr<osm_store> run() {
+    export_table("export_nodes", "nodes", [this](const pqxx::row &row, const auto &e) {
+      const auto scale = static_cast<double>(global_settings::get_scale());
+      m_builder.add_node(e, row["latitude"].as<int64_t>() / scale,
+                         row["longitude"].as<int64_t>() / scale);
+    });
+
+    export_table("export_ways", "ways", [this](const pqxx::row &row, const auto &e) {
+      m_builder.add_way(e);
+      for (auto node : psql_array_ids_to_vector<osm_nwr_id_t>(row["node_ids"]))
+        m_builder.add_way_node(node);
+    });
+
+    export_table("export_relations", "relations", [this](const pqxx::row &row, const auto &e) {
+      m_builder.add_relation(e);
+      auto ids = psql_array_ids_to_vector<osm_nwr_id_t>(row["member_ids"]);
+      auto types = psql_array_to_vector(row["member_types"], ids.size());
+      auto roles = psql_array_to_vector(row["member_roles"], ids.size());
+      if (types.size() != ids.size() || roles.size() != ids.size())
+        throw std::runtime_error("Mismatch in members types, ids and roles size");
+      for (std::size_t i = 0; i < ids.size(); ++i)
+        m_builder.add_member(type_from_name(types[i]), ids[i], roles[i]);
+    });
+
+    return m_builder.finish();
+  }
+
+private:
+  template <typename F>
+  void export_table(const std::string &statement, const char *name, F add_element) {
+    osm_nwr_id_t last_id = 0;
+    std::size_t count = 0;
+
+    while (true) {
+      auto result = m_txn.exec_prepared(statement, last_id, m_batch_size);
+      if (result.empty())
+        break;
+
+      for (const auto &row : result) {
+        osm_store_builder::entity e;
+        e.id = row["id"].as<osm_nwr_id_t>();
+        e.version = row["version"].as<osm_version_t>();
+        e.changeset = row["changeset_id"].as<osm_changeset_id_t>();
+        e.timestamp = row["timestamp"].as<int64_t>();
+        e.visible = row["visible"].as<bool>();
+
+        std::string display_name;
+        if (!row["uid"].is_null()) {
+          e.uid = row["uid"].as<osm_user_id_t>();
+          display_name = row["display_name"].as<std::string>();
+          e.user = display_name;
+        }
+
+        add_element(row, e);
+
+        auto keys = psql_array_to_vector(row["tag_k"]);
+        auto values = psql_array_to_vector(row["tag_v"], keys.size());
+        if (keys.size() != values.size())
+          throw std::runtime_error("Mismatch in tag key and value size");
+        for (std::size_t i = 0; i < keys.size(); ++i)
+          m_builder.add_tag(keys[i], values[i]);
+
+        last_id = e.id;
+      }
+
+      count += result.size();
+      std::cout << fmt::format("\r{} {}", count, name) << std::flush;
+    }
+    std::cout << fmt::format("\r{} {}\n", count, name);
+  }
+
+  pqxx::transaction<pqxx::isolation_level::repeatable_read, pqxx::write_policy::read_only> m_txn;
+  int m_batch_size;
+  osm_store_builder m_builder;
+};
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+  po::options_description desc("Snapshot export options");
+  desc.add_options()
+    ("help", "show this help")
+    ("output", po::value<std::string>()->required(), "snapshot file to write")
+    ("osm-file", po::value<std::string>(), "read an OSM XML or PBF file instead of the database")
+    ("dbname", po::value<std::string>(), "database name")
+    ("host", po::value<std::string>(), "database server host")
+    ("username", po::value<std::string>(), "database user name")
+    ("password", po::value<std::string>(), "database password")
+    ("dbport", po::value<std::string>(), "database port number or UNIX socket file name")
+    ("batch-size", po::value<int>()->default_value(100'000), "elements read per query");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.contains("help")) {
+      std::cout << desc << '\n';
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+  } catch (const po::error &e) {
+    std::cerr << "Error: " << e.what() << "\n\n" << desc << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (vm.contains("osm-file") == vm.contains("dbname")) {
+    std::cerr << "Error: either --osm-file or --dbname is required\n";
+    return EXIT_FAILURE;
+  }
+  if (vm["batch-size"].as<int>() < 1) {
+    std::cerr << "Error: --batch-size must be at least 1\n";
+    return EXIT_FAILURE;
+  }
+
+  try {
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<osm_store> store;
+
+    if (vm.contains("osm-file")) {
+      store = load_osm_file(vm["osm-file"].as<std::string>());
+    } else {
+      pqxx::connection conn(connect_db_str(vm));
+      prepare_statements(conn);
+      store = db_exporter(conn, vm["batch-size"].as<int>()).run();
+    }
+
+    const auto output = vm["output"].as<std::string>();
+    write_snapshot(*store, output);
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    std::cout << fmt::format("wrote {} node, {} way and {} relation versions to {} in {:.1f} s\n",
+                             store->nodes.size(), store->ways.size(), store->relations.size(),
+                             output, elapsed.count());
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 #include "cgimap/http.hpp"
 #include "cgimap/options.hpp"
 #include "cgimap/output_buffer.hpp"
+#include "cgimap/request_timing.hpp"
 
 #include <fmt/core.h>
 
@@ -36,6 +37,7 @@ struct fcgi_buffer : public output_buffer {
 
   using output_buffer::write;
   int write(const char *buffer, int len) noexcept override {
+    auto span = request_timing::measure(request_timing::phase::write);
     int bytes = FCGX_PutStr(buffer, len, m_req.out);
     if (bytes >= 0) {
       m_written += bytes;
@@ -45,9 +47,15 @@ struct fcgi_buffer : public output_buffer {
 
   [[nodiscard]] int written() const override { return m_written; }
 
-  int close() noexcept override { return FCGX_FClose(m_req.out); }
+  int close() noexcept override {
+    auto span = request_timing::measure(request_timing::phase::write);
+    return FCGX_FClose(m_req.out);
+  }
 
-  int flush() noexcept override { return FCGX_FFlush(m_req.out); }
+  int flush() noexcept override {
+    auto span = request_timing::measure(request_timing::phase::write);
+    return FCGX_FFlush(m_req.out);
+  }
 
 private:
   FCGX_Request m_req;
@@ -94,17 +102,20 @@ std::string fcgi_request::get_payload() {
   if (content_length_str)
     content_length = http::parse_content_length(content_length_str);
 
+  // The result buffer grows with the data actually received, rather than
+  // trusting the client's Content-Length. Decompression stops one byte past
+  // the limit, so that a compressed body can't be inflated beyond it.
   std::string result{};
+  const auto max_output = std::size_t{global_settings::get_payload_max_size()} + 1;
 
   while ((curr_content_length = FCGX_GetStr(content_buffer.data(), BUFFER_LEN, m_impl->req.in)) > 0)
   {
-      std::string content(content_buffer.data(), curr_content_length);
-      result_length += content.length();
+      result_length += curr_content_length;
 
       // Decompression according to Content-Encoding header (null op, if header is not set)
       try {
-        std::string content_decompressed = content_encoding_handler->decompress(content);
-        result += content_decompressed;
+        content_encoding_handler->decompress(
+            std::string_view(content_buffer.data(), curr_content_length), result, max_output);
       } catch (std::bad_alloc& e) {
 	  throw http::server_error("Decompression failed due to memory issue");
       } catch (std::runtime_error& e) {
@@ -0,0 +1,915 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/fcgi_server.hpp"
+#include "cgimap/http.hpp"
+#include "cgimap/logger.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/output_buffer.hpp"
+#include "cgimap/request_memory.hpp"
+#include "cgimap/request_timing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// records, roles and flags of the FastCGI specification
+namespace fcgi {
+
+constexpr uint8_t version = 1;
+constexpr std::size_t header_size = 8;
+constexpr std::size_t max_content_size = 65535;
+
+enum class record_type : uint8_t {
+  begin_request = 1,
+  abort_request = 2,
+  end_request = 3,
+  params = 4,
+  stdin_stream = 5,
+  stdout_stream = 6,
+  stderr_stream = 7,
+  data = 8,
+  get_values = 9,
+  get_values_result = 10,
+  unknown_type = 11
+};
+
+constexpr uint16_t role_responder = 1;
+constexpr uint8_t flag_keep_conn = 1;
+
+enum class protocol_status : uint8_t {
+  request_complete = 0,
+  cant_mpx_conn = 1,
+  overloaded = 2,
+  unknown_role = 3
+};
+
+} // namespace fcgi
+
+// output is handed to the event loop in chunks of about this size
+constexpr std::size_t flush_size = fcgi::max_content_size;
+// output queued on a connection, above which workers wait for the web
+// server to read it
+constexpr std::size_t max_queued_output = 1024 * 1024;
+// limit on the encoded parameters of a request
+constexpr std::size_t max_params_size = 1024 * 1024;
+// time given to requests to complete when shutting down
+constexpr auto shutdown_timeout = 30s;
+constexpr int max_events = 64;
+
+void append_record(std::string &out, fcgi::record_type type, uint16_t id,
+                   std::string_view content) {
+  out += static_cast<char>(fcgi::version);
+  out += static_cast<char>(type);
+  out += static_cast<char>(id >> 8);
+  out += static_cast<char>(id & 0xff);
+  out += static_cast<char>(content.size() >> 8);
+  out += static_cast<char>(content.size() & 0xff);
+  out += '\0'; // padding length
+  out += '\0'; // reserved
+  out += content;
+}
+
+// content of a stream, split into records of the maximum size
+void append_stream(std::string &out, fcgi::record_type type, uint16_t id,
+                   std::string_view content) {
+  while (!content.empty()) {
+    const auto chunk = content.substr(0, fcgi::max_content_size);
+    append_record(out, type, id, chunk);
+    content.remove_prefix(chunk.size());
+  }
+}
+
+std::string end_request_record(uint16_t id, fcgi::protocol_status status) {
+  // application status (4 bytes), protocol status, reserved (3 bytes)
+  std::string body(8, '\0');
+  body[4] = static_cast<char>(status);
+
+  std::string out;
+  append_record(out, fcgi::record_type::end_request, id, body);
+  return out;
+}
+
+// name and value lengths take 1 byte below 128, 4 bytes otherwise
+bool read_length(std::string_view &s, std::size_t &length) {
+  if (s.empty())
+    return false;
+
+  const auto byte = [&s](std::size_t i) { return static_cast<std::size_t>(static_cast<unsigned char>(s[i])); };
+
+  if (byte(0) < 0x80) {
+    length = byte(0);
+    s.remove_prefix(1);
+    return true;
+  }
+
+  if (s.size() < 4)
+    return false;
+
+  length = ((byte(0) & 0x7f) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+  s.remove_prefix(4);
+  return true;
+}
+
+void append_length(std::string &out, std::size_t length) {
+  if (length < 0x80) {
+    out += static_cast<char>(length);
+  } else {
+    out += static_cast<char>((length >> 24) | 0x80);
+    out += static_cast<char>((length >> 16) & 0xff);
+    out += static_cast<char>((length >> 8) & 0xff);
+    out += static_cast<char>(length & 0xff);
+  }
+}
+
+using params_t = std::vector<std::pair<std::string, std::string>>;
+
+bool parse_params(std::string_view s, params_t &params) {
+  while (!s.empty()) {
+    std::size_t name_length = 0;
+    std::size_t value_length = 0;
+    if (!read_length(s, name_length) || !read_length(s, value_length) ||
+        s.size() < name_length + value_length)
+      return false;
+
+    params.emplace_back(s.substr(0, name_length), s.substr(name_length, value_length));
+    s.remove_prefix(name_length + value_length);
+  }
+  return true;
+}
+
+struct stream_request;
+
+struct connection {
+  explicit connection(int fd) : fd(fd) {}
+  // closed only once no worker refers to the connection anymore, so
+  // that the descriptor can't be reused by another connection before
+  ~connection() { ::close(fd); }
+
+  connection(const connection &) = delete;
+  connection &operator=(const connection &) = delete;
+
+  const int fd;
+
+  // used by the event loop only
+  std::string input;
+  // requests still being received, by id
+  std::map<uint16_t, std::shared_ptr<stream_request>> receiving;
+  bool waiting_writable = false;
+
+  // shared with the worker threads
+  std::mutex mutex;
+  std::deque<std::string> output;
+  // bytes of the first output chunk already written
+  std::size_t output_offset = 0;
+  // bytes of output not written yet
+  std::size_t output_bytes = 0;
+  // notified when output has been written, or the connection closed
+  std::condition_variable output_written;
+  // requests begun, but not completed
+  std::size_t active = 0;
+  // the web server didn't ask to keep the connection open
+  bool close_when_idle = false;
+  bool closed = false;
+
+  // waits until the output queued is below max_queued_output, false if
+  // the connection has been closed
+  bool wait_for_room() {
+    std::unique_lock lock(mutex);
+    output_written.wait(lock, [this] { return closed || output_bytes < max_queued_output; });
+    return !closed;
+  }
+
+  // with the mutex held
+  void set_closed() {
+    closed = true;
+    output.clear();
+    output_bytes = 0;
+    output_written.notify_all();
+  }
+};
+
+/**
+ * Connections with output queued by the worker threads, for the
+ * event loop to write out.
+ */
+class outbox {
+public:
+  explicit outbox(int wakeup_fd) : m_wakeup_fd(wakeup_fd) {}
+
+  // queues data on the connection, false if it has been closed
+  bool send(const std::shared_ptr<connection> &c, std::string data, bool completes_request) {
+    {
+      std::scoped_lock lock(c->mutex);
+      if (c->closed)
+        return false;
+      c->output_bytes += data.size();
+      c->output.push_back(std::move(data));
+      if (completes_request)
+        --c->active;
+    }
+    {
+      std::scoped_lock lock(m_mutex);
+      m_pending.push_back(c);
+    }
+    wake();
+    return true;
+  }
+
+  std::vector<std::shared_ptr<connection>> take() {
+    std::scoped_lock lock(m_mutex);
+    return std::exchange(m_pending, {});
+  }
+
+  void wake() const noexcept {
+    const uint64_t one = 1;
+    (void)::write(m_wakeup_fd, &one, sizeof(one));
+  }
+
+private:
+  const int m_wakeup_fd;
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<connection>> m_pending;
+};
+
+struct stream_buffer : public output_buffer {
+
+  stream_buffer(std::shared_ptr<connection> c, uint16_t id, outbox &out)
+    : m_connection(std::move(c)), m_id(id), m_outbox(out) {}
+
+  ~stream_buffer() override = default;
+
+  using output_buffer::write;
+  int write(const char *buffer, int len) noexcept override {
+    if (m_failed)
+      return -1;
+
+    try {
+      m_pending.append(buffer, len);
+    } catch (const std::bad_alloc &) {
+      return -1;
+    }
+    m_written += len;
+
+    if (m_pending.size() >= flush_size && flush() < 0)
+      return -1;
+
+    return len;
+  }
+
+  [[nodiscard]] int written() const override { return m_written; }
+
+  int close() noexcept override { return flush(); }
+
+  int flush() noexcept override {
+    if (!m_failed && !m_pending.empty())
+      m_failed = !send(false);
+    return m_failed ? -1 : 0;
+  }
+
+  // sends the remaining output, followed by the end of the stream
+  // and of the request
+  void end() noexcept { send(true); }
+
+private:
+  bool send(bool end_request) noexcept {
+    auto span = request_timing::measure(request_timing::phase::write);
+    try {
+      // a web server not reading the response as fast as it is produced
+      // holds up the worker, rather than the response piling up in memory
+      if (!m_connection->wait_for_room())
+        return false;
+
+      // released by the event loop once written, so not charged to the
+      // request, whose queued output is bounded by max_queued_output
+      request_memory unaccounted;
+      request_memory::scope scope(unaccounted);
+
+      std::string records;
+      append_stream(records, fcgi::record_type::stdout_stream, m_id, m_pending);
+      m_pending.clear();
+
+      if (end_request) {
+        // an empty record ends the stream
+        append_record(records, fcgi::record_type::stdout_stream, m_id, {});
+        records += end_request_record(m_id, fcgi::protocol_status::request_complete);
+      }
+
+      return m_outbox.send(m_connection, std::move(records), end_request);
+    } catch (const std::bad_alloc &) {
+      return false;
+    }
+  }
+
+  std::shared_ptr<connection> m_connection;
+  const uint16_t m_id;
+  outbox &m_outbox;
+  std::string m_pending;
+  int m_written{0};
+  // the connection was closed by the web server
+  bool m_failed{false};
+};
+
+struct stream_request : public request {
+
+  stream_request(std::shared_ptr<connection> c, uint16_t id, outbox &out)
+    : m_buffer(std::move(c), id, out) {}
+
+  const char *get_param(const char *key) const override {
+    for (const auto &[name, value] : params) {
+      if (name == key)
+        return value.c_str();
+    }
+    return nullptr;
+  }
+
+  std::string get_payload() override {
+    if (payload_too_large)
+      throw http::payload_too_large(fmt::format("Payload exceeds limit of {:d} bytes", global_settings::get_payload_max_size()));
+
+    const char *content_length_str = get_param("CONTENT_LENGTH");
+    const char *content_encoding = get_param("HTTP_CONTENT_ENCODING");
+
+    auto content_encoding_handler = http::get_content_encoding_handler(
+           std::string_view(content_encoding == nullptr ? "" : content_encoding));
+
+    unsigned long content_length = 0;
+    if (content_length_str)
+      content_length = http::parse_content_length(content_length_str);
+
+    // decompression stops one byte past the limit, so that a compressed
+    // body can't be inflated beyond it
+    const auto max_output = std::size_t{global_settings::get_payload_max_size()} + 1;
+    std::string result{};
+    result.reserve(std::min(payload.size(), max_output));
+
+    // Decompression according to Content-Encoding header (null op, if header is not set)
+    try {
+      content_encoding_handler->decompress(payload, result, max_output);
+    } catch (std::bad_alloc& e) {
+      throw http::server_error("Decompression failed due to memory issue");
+    } catch (std::runtime_error& e) {
+      throw http::bad_request("Payload cannot be decompressed according to Content-Encoding");
+    }
+
+    if (result.length() > global_settings::get_payload_max_size())
+      throw http::payload_too_large(fmt::format("Payload exceeds limit of {:d} bytes", global_settings::get_payload_max_size()));
+
+    if (content_length > 0 && payload.size() != content_length)
+      throw http::server_error("HTTP Header field 'Content-Length' differs from actual payload length");
+
+    return result;
+  }
+
+  [[nodiscard]] std::chrono::system_clock::time_point get_current_time() const override {
+    return now;
+  }
+
+  void dispose() override {}
+
+  // sends what's left of the response and ends the request
+  void complete() noexcept { m_buffer.end(); }
+
+  // filled in by the event loop while the request is received
+  std::string raw_params;
+  params_t params;
+  bool params_complete = false;
+  std::string payload;
+  bool payload_too_large = false;
+  std::chrono::system_clock::time_point now;
+
+protected:
+  void write_header_info(int status, const http::headers_t &headers) override {
+    m_buffer.write(http::format_header(status, headers));
+  }
+
+  output_buffer& get_buffer_internal() override { return m_buffer; }
+
+  void finish_internal() override { m_buffer.flush(); }
+
+private:
+  stream_buffer m_buffer;
+};
+
+} // anonymous namespace
+
+struct fcgi_server::impl {
+  explicit impl(int socket);
+  ~impl();
+
+  impl(const impl &) = delete;
+  impl &operator=(const impl &) = delete;
+
+  void start(std::vector<handler> handlers);
+  void run(const std::function<bool()> &proceed);
+
+private:
+  void serve(const handler &h);
+  void stop_workers();
+
+  void accept_connection();
+  void read_from(const std::shared_ptr<connection> &c);
+  bool parse_records(const std::shared_ptr<connection> &c);
+  bool handle_record(const std::shared_ptr<connection> &c, fcgi::record_type type,
+                     uint16_t id, std::string_view content);
+  void dispatch(const std::shared_ptr<connection> &c, uint16_t id);
+  void write_to(const std::shared_ptr<connection> &c);
+  void want_writable(connection &c, bool writable);
+  void close_connection(const std::shared_ptr<connection> &c);
+  bool drained();
+
+  const int m_socket;
+  int m_epoll = -1;
+  int m_wakeup = -1;
+  outbox m_outbox;
+  bool m_accepting = true;
+  std::unordered_map<int, std::shared_ptr<connection>> m_connections;
+
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cv;
+  std::deque<std::shared_ptr<stream_request>> m_queue;
+  bool m_stopping = false;
+  // requests handed to the workers, but not yet completed
+  std::atomic<std::size_t> m_outstanding{0};
+  std::vector<std::jthread> m_workers;
+};
+
+namespace {
+
+int create_wakeup_fd() {
+  const int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error(fmt::format("eventfd failed: {}", std::strerror(errno)));
+  return fd;
+}
+
+} // anonymous namespace
+
+fcgi_server::impl::impl(int socket)
+  : m_socket(socket), m_wakeup(create_wakeup_fd()), m_outbox(m_wakeup) {
+
+  m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  if (m_epoll < 0) {
+    ::close(m_wakeup);
+    throw std::runtime_error(fmt::format("epoll_create1 failed: {}", std::strerror(errno)));
+  }
+
+  // the listening socket is shared by all daemon instances, each of which
+  // is woken up on its own for a new connection
+  const int flags = ::fcntl(m_socket, F_GETFL);
+  epoll_event listen_event{.events = EPOLLIN | EPOLLEXCLUSIVE, .data = {.fd = m_socket}};
+  epoll_event wakeup_event{.events = EPOLLIN, .data = {.fd = m_wakeup}};
+
+  if (flags < 0 || ::fcntl(m_socket, F_SETFL, flags | O_NONBLOCK) < 0 ||
+      ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_socket, &listen_event) < 0 ||
+      ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &wakeup_event) < 0) {
+    const int error = errno;
+    ::close(m_epoll);
+    ::close(m_wakeup);
+    if (error == ENOTSOCK)
+      throw std::runtime_error("FCGI port or UNIX socket not set properly, please use the --socket option (caused by ENOTSOCK).");
+    throw std::runtime_error(fmt::format("Couldn't listen for FastCGI connections: {}", std::strerror(error)));
+  }
+}
+
+fcgi_server::impl::~impl() {
+  stop_workers();
+  for (auto &[fd, c] : m_connections) {
+    c->receiving.clear();
+    std::scoped_lock lock(c->mutex);
+    c->set_closed();
+  }
+  m_connections.clear();
+  ::close(m_epoll);
+  ::close(m_wakeup);
+}
+
+void fcgi_server::impl::start(std::vector<handler> handlers) {
+  // signals are left to the event loop thread, interrupting epoll_wait
+  sigset_t all;
+  sigset_t previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &previous);
+
+  for (auto &h : handlers)
+    m_workers.emplace_back([this, h = std::move(h)] { serve(h); });
+
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+void fcgi_server::impl::serve(const handler &h) {
+  while (true) {
+    std::shared_ptr<stream_request> req;
+    {
+      std::unique_lock lock(m_queue_mutex);
+      m_queue_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+      if (m_queue.empty())
+        return;
+      req = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    try {
+      h(*req);
+    } catch (const std::exception &e) {
+      logger::message(logger::level::error,
+                      fmt::format("Processing FastCGI request failed: {}", e.what()));
+    }
+
+    req->complete();
+    --m_outstanding;
+    m_outbox.wake();
+  }
+}
+
+void fcgi_server::impl::stop_workers() {
+  {
+    std::scoped_lock lock(m_queue_mutex);
+    m_stopping = true;
+  }
+  m_queue_cv.notify_all();
+  m_workers.clear();
+}
+
+void fcgi_server::impl::run(const std::function<bool()> &proceed) {
+  std::array<epoll_event, max_events> events;
+  std::chrono::steady_clock::time_point deadline;
+
+  while (true) {
+    if (m_accepting && !proceed()) {
+      m_accepting = false;
+      ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_socket, nullptr);
+      deadline = std::chrono::steady_clock::now() + shutdown_timeout;
+    }
+
+    if (!m_accepting && (drained() || std::chrono::steady_clock::now() > deadline))
+      break;
+
+    const int count = ::epoll_wait(m_epoll, events.data(), max_events, 1000);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error(fmt::format("epoll_wait failed: {}", std::strerror(errno)));
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+
+      if (fd == m_socket) {
+        accept_connection();
+      } else if (fd == m_wakeup) {
+        uint64_t value;
+        (void)::read(m_wakeup, &value, sizeof(value));
+      } else if (auto it = m_connections.find(fd); it != m_connections.end()) {
+        const auto c = it->second;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          read_from(c);
+        if (events[i].events & EPOLLOUT)
+          write_to(c);
+      }
+    }
+
+    for (const auto &c : m_outbox.take())
+      write_to(c);
+  }
+
+  // workers still waiting for their output to be read give up
+  for (const auto &[fd, c] : m_connections) {
+    std::scoped_lock lock(c->mutex);
+    c->set_closed();
+  }
+
+  stop_workers();
+}
+
+bool fcgi_server::impl::drained() {
+  if (m_outstanding > 0)
+    return false;
+
+  for (const auto &[fd, c] : m_connections) {
+    std::scoped_lock lock(c->mutex);
+    if (!c->output.empty())
+      return false;
+  }
+  return true;
+}
+
+void fcgi_server::impl::accept_connection() {
+  // a single connection at a time, so that connections waiting in the
+  // backlog are spread over the daemon instances
+  const int fd = ::accept4(m_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+      logger::message(logger::level::warning,
+                      fmt::format("Accepting FastCGI connection failed: {}", std::strerror(errno)));
+    return;
+  }
+
+  auto c = std::make_shared<connection>(fd);
+  epoll_event event{.events = EPOLLIN | EPOLLRDHUP, .data = {.fd = fd}};
+  if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+    logger::message(logger::level::warning,
+                    fmt::format("Watching FastCGI connection failed: {}", std::strerror(errno)));
+    return;
+  }
+  m_connections.emplace(fd, std::move(c));
+}
+
+void fcgi_server::impl::read_from(const std::shared_ptr<connection> &c) {
+  std::array<char, 16384> buffer;
+
+  while (true) {
+    const auto bytes = ::recv(c->fd, buffer.data(), buffer.size(), 0);
+    if (bytes > 0) {
+      c->input.append(buffer.data(), bytes);
+      if (!parse_records(c)) {
+        logger::message(logger::level::warning, "Closing FastCGI connection after a protocol error");
+        close_connection(c);
+        return;
+      }
+      continue;
+    }
+
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+
+    // closed by the web server, or failed
+    close_connection(c);
+    return;
+  }
+}
+
+bool fcgi_server::impl::parse_records(const std::shared_ptr<connection> &c) {
+  std::string_view input(c->input);
+
+  while (input.size() >= fcgi::header_size) {
+    const auto byte = [&input](std::size_t i) { return static_cast<unsigned char>(input[i]); };
+
+    if (byte(0) != fcgi::version)
+      return false;
+
+    const auto type = static_cast<fcgi::record_type>(byte(1));
+    const uint16_t id = (byte(2) << 8) | byte(3);
+    const std::size_t content_length = (byte(4) << 8) | byte(5);
+    const std::size_t padding_length = byte(6);
+
+    if (input.size() < fcgi::header_size + content_length + padding_length)
+      break;
+
+    if (!handle_record(c, type, id, input.substr(fcgi::header_size, content_length)))
+      return false;
+
+    input.remove_prefix(fcgi::header_size + content_length + padding_length);
+  }
+
+  c->input.erase(0, c->input.size() - input.size());
+  return true;
+}
+
+bool fcgi_server::impl::handle_record(const std::shared_ptr<connection> &c,
+                                      fcgi::record_type type, uint16_t id,
+                                      std::string_view content) {
+  const auto queue = [this, &c](std::string data) { m_outbox.send(c, std::move(data), false); };
+
+  const auto it = c->receiving.find(id);
+  stream_request *req = (it == c->receiving.end()) ? nullptr : it->second.get();
+
+  switch (type) {
+  case fcgi::record_type::get_values: {
+    params_t names;
+    if (!parse_params(content, names))
+      return false;
+
+    std::string values;
+    for (const auto &[name, value] : names) {
+      if (name == "FCGI_MPXS_CONNS") {
+        append_length(values, name.size());
+        append_length(values, 1);
+        values += name;
+        values += '1';
+      }
+    }
+
+    std::string out;
+    append_record(out, fcgi::record_type::get_values_result, 0, values);
+    queue(std::move(out));
+    return true;
+  }
+
+  case fcgi::record_type::begin_request: {
+    if (content.size() < 8 || id == 0 || req != nullptr)
+      return false;
+
+    const uint16_t role = (static_cast<unsigned char>(content[0]) << 8) |
+                          static_cast<unsigned char>(content[1]);
+    const auto flags = static_cast<unsigned char>(content[2]);
+
+    {
+      std::scoped_lock lock(c->mutex);
+      if (!(flags & fcgi::flag_keep_conn))
+        c->close_when_idle = true;
+    }
+
+    if (role != fcgi::role_responder) {
+      queue(end_request_record(id, fcgi::protocol_status::unknown_role));
+    } else if (!m_accepting) {
+      queue(end_request_record(id, fcgi::protocol_status::overloaded));
+    } else {
+      c->receiving.emplace(id, std::make_shared<stream_request>(c, id, m_outbox));
+      std::scoped_lock lock(c->mutex);
+      ++c->active;
+    }
+    return true;
+  }
+
+  case fcgi::record_type::abort_request:
+    // requests already handed to a worker are completed anyway
+    if (req != nullptr) {
+      c->receiving.erase(it);
+      m_outbox.send(c, end_request_record(id, fcgi::protocol_status::request_complete), true);
+    }
+    return true;
+
+  case fcgi::record_type::params:
+    if (req == nullptr)
+      return true;
+
+    if (content.empty()) {
+      req->params_complete = true;
+      return parse_params(req->raw_params, req->params);
+    }
+
+    if (req->params_complete || req->raw_params.size() + content.size() > max_params_size)
+      return false;
+
+    req->raw_params += content;
+    return true;
+
+  case fcgi::record_type::stdin_stream:
+    if (req == nullptr)
+      return true;
+
+    if (content.empty()) {
+      dispatch(c, id);
+      return true;
+    }
+
+    // the rest of the payload is discarded, get_payload reports the error
+    if (req->payload.size() + content.size() > global_settings::get_payload_max_size())
+      req->payload_too_large = true;
+    if (!req->payload_too_large)
+      req->payload += content;
+    return true;
+
+  case fcgi::record_type::data:
+    return true;
+
+  default:
+    // management records of an unknown type are answered, as required
+    if (id == 0) {
+      std::string body(8, '\0');
+      body[0] = static_cast<char>(type);
+
+      std::string out;
+      append_record(out, fcgi::record_type::unknown_type, 0, body);
+      queue(std::move(out));
+    }
+    return true;
+  }
+}
+
+void fcgi_server::impl::dispatch(const std::shared_ptr<connection> &c, uint16_t id) {
+  const auto it = c->receiving.find(id);
+  auto req = std::move(it->second);
+  c->receiving.erase(it);
+
+  req->now = std::chrono::system_clock::now();
+
+  ++m_outstanding;
+  {
+    std::scoped_lock lock(m_queue_mutex);
+    m_queue.push_back(std::move(req));
+  }
+  m_queue_cv.notify_one();
+}
+
+void fcgi_server::impl::write_to(const std::shared_ptr<connection> &c) {
+  std::unique_lock lock(c->mutex);
+  if (c->closed)
+    return;
+
+  const auto queued = c->output_bytes;
+  while (!c->output.empty()) {
+    const auto &chunk = c->output.front();
+    const auto bytes = ::send(c->fd, chunk.data() + c->output_offset,
+                              chunk.size() - c->output_offset, MSG_NOSIGNAL);
+    if (bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        want_writable(*c, true);
+        break;
+      }
+      lock.unlock();
+      close_connection(c);
+      return;
+    }
+
+    c->output_offset += bytes;
+    c->output_bytes -= bytes;
+    if (c->output_offset == chunk.size()) {
+      c->output.pop_front();
+      c->output_offset = 0;
+    }
+  }
+
+  if (c->output_bytes < queued)
+    c->output_written.notify_all();
+  if (!c->output.empty())
+    return;
+
+  want_writable(*c, false);
+
+  const bool done = c->active == 0 && c->close_when_idle;
+  lock.unlock();
+  if (done)
+    close_connection(c);
+}
+
+void fcgi_server::impl::want_writable(connection &c, bool writable) {
+  if (c.waiting_writable == writable)
+    return;
+
+  epoll_event event{.events = EPOLLIN | EPOLLRDHUP | (writable ? EPOLLOUT : 0u), .data = {.fd = c.fd}};
+  ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, c.fd, &event);
+  c.waiting_writable = writable;
+}
+
+void fcgi_server::impl::close_connection(const std::shared_ptr<connection> &c) {
+  {
+    std::scoped_lock lock(c->mutex);
+    if (c->closed)
+      return;
+    c->set_closed();
+  }
+
+  ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->fd, nullptr);
+  // the descriptor itself is closed with the last reference
+  ::shutdown(c->fd, SHUT_RDWR);
+  c->receiving.clear();
+  m_connections.erase(c->fd);
+}
+
+fcgi_server::fcgi_server(int socket, std::size_t workers, const handler_factory &make_handler)
+  : m_impl(std::make_unique<impl>(socket)) {
+
+  std::vector<handler> handlers;
+  for (std::size_t i = 0; i < workers; ++i)
+    handlers.push_back(make_handler());
+
+  m_impl->start(std::move(handlers));
+}
+
+fcgi_server::~fcgi_server() = default;
+
+void fcgi_server::run(const std::function<bool()> &proceed) {
+  m_impl->run(proceed);
+}
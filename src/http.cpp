@@ -237,7 +237,7 @@ std::unique_ptr<encoding> choose_encoding(const std::string &accept_encoding) {
   }
 }
 
-std::unique_ptr<ZLibBaseDecompressor> get_content_encoding_handler(std::string_view content_encoding) {
+std::unique_ptr<Decompressor> get_content_encoding_handler(std::string_view content_encoding) {
 
   if (content_encoding.empty())
     return std::make_unique<IdentityDecompressor>();
@@ -249,8 +249,16 @@ std::unique_ptr<ZLibBaseDecompressor> get_content_encoding_handler(std::string_v
     return std::make_unique<GZipDecompressor>();
   else if (content_encoding == "deflate")
     return std::make_unique<ZLibDecompressor>();
-  throw http::unsupported_media_type("Supported Content-Encodings include 'gzip' and 'deflate'");
+#endif
+#if HAVE_BROTLI
+  else if (content_encoding == "br")
+    return std::make_unique<BrotliDecompressor>();
+#endif
 
+#if defined(HAVE_LIBZ) && HAVE_BROTLI
+  throw http::unsupported_media_type("Supported Content-Encodings include 'gzip', 'deflate' and 'br'");
+#elif defined(HAVE_LIBZ)
+  throw http::unsupported_media_type("Supported Content-Encodings include 'gzip' and 'deflate'");
 #else
   throw http::unsupported_media_type("Supported Content-Encodings are 'identity'");
 #endif
@@ -7,35 +7,352 @@
  * For a full list of authors see the git log.
  */
 
+#include "cgimap/logger.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
-#include <unistd.h>
 #include <memory>
+#include <mutex>
+#include <thread>
 
-#include "cgimap/logger.hpp"
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
 
 namespace logger {
 
-static std::unique_ptr<std::ostream> stream;
-static pid_t pid;
+namespace {
 
-void initialise(const std::string &filename) {
-  if (filename.empty()) {
-    stream.reset();
-    return;
+// number of messages which can be queued, must be a power of two
+constexpr std::size_t queue_size = 4096;
+
+// how often the background thread writes pending messages
+constexpr std::chrono::milliseconds drain_interval{100};
+
+// size of the batches written to the log file
+constexpr std::size_t batch_size = 64 * 1024;
+
+/**
+ * Bounded multi producer queue, based on the sequence numbered ring
+ * buffer by Dmitry Vyukov. Each slot carries the position it is ready
+ * for, so that producers and the consumer only need to agree on the
+ * slot's sequence number and never block each other.
+ */
+class message_queue {
+public:
+  message_queue() {
+    for (std::size_t i = 0; i < queue_size; ++i)
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bool try_push(std::string &m) noexcept {
+    auto pos = m_enqueue.load(std::memory_order_relaxed);
+    while (true) {
+      auto &s = m_slots[pos & (queue_size - 1)];
+      const auto seq = s.sequence.load(std::memory_order_acquire);
+      if (seq == pos) {
+        if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          s.message = std::move(m);
+          s.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (seq < pos) {
+        return false; // full
+      } else {
+        pos = m_enqueue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // must only be called by one thread at a time
+  bool try_pop(std::string &m) noexcept {
+    const auto pos = m_dequeue.load(std::memory_order_relaxed);
+    auto &s = m_slots[pos & (queue_size - 1)];
+    if (s.sequence.load(std::memory_order_acquire) != pos + 1)
+      return false; // empty, or the producer is still busy with the slot
+    m = std::move(s.message);
+    m_dequeue.store(pos + 1, std::memory_order_relaxed);
+    s.sequence.store(pos + queue_size, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return m_enqueue.load(std::memory_order_relaxed) -
+           m_dequeue.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct slot {
+    std::atomic<std::size_t> sequence;
+    std::string message;
+  };
+
+  std::unique_ptr<slot[]> m_slots{new slot[queue_size]};
+  alignas(64) std::atomic<std::size_t> m_enqueue{0};
+  alignas(64) std::atomic<std::size_t> m_dequeue{0};
+};
+
+/**
+ * The log file, reopened in place by initialise, so that threads logging
+ * concurrently never see it go away. The file descriptor is only used with
+ * the drain mutex held.
+ */
+class log_file {
+public:
+  log_file() { m_batch.reserve(batch_size); }
+
+  ~log_file() {
+    if (m_thread.joinable()) {
+      m_thread.request_stop();
+      m_thread.join();
+    }
+    std::scoped_lock lock(m_drain_mutex);
+    drain_locked();
+    if (m_fd >= 0)
+      close(m_fd);
+  }
+
+  log_file(const log_file &) = delete;
+  log_file &operator=(const log_file &) = delete;
+
+  // replaces the file after writing all pending messages to the previous
+  // one. If the file can't be opened, messages are discarded.
+  void open(const std::string &filename, level min_level, format output, bool background) {
+    if (!background && m_thread.joinable()) {
+      m_thread.request_stop();
+      m_thread.join();
+    }
+
+    {
+      std::scoped_lock lock(m_drain_mutex);
+      drain_locked();
+      if (m_fd >= 0)
+        close(m_fd);
+
+      m_fd = filename.empty() ? -1
+                              : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      m_min_level.store(min_level, std::memory_order_relaxed);
+      m_format.store(output, std::memory_order_relaxed);
+      m_pid.store(getpid(), std::memory_order_relaxed);
+      m_background.store(background, std::memory_order_relaxed);
+      m_open.store(m_fd >= 0, std::memory_order_release);
+    }
+
+    if (background && m_open && !m_thread.joinable())
+      m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  }
+
+  [[nodiscard]] bool enabled(level l) const noexcept {
+    return m_open.load(std::memory_order_acquire) &&
+           l >= m_min_level.load(std::memory_order_relaxed);
+  }
+
+  void message(level l, std::string_view m) {
+    auto line = format_line(l, m);
+
+    if (!m_background.load(std::memory_order_relaxed) || !m_queue.try_push(line)) {
+      // without a background thread, or if it can't keep up, write
+      // synchronously rather than losing messages
+      std::scoped_lock lock(m_drain_mutex);
+      drain_locked();
+      write_all(line);
+      return;
+    }
+
+    if (m_queue.size() > queue_size / 2)
+      m_wakeup.notify_one();
+  }
+
+  void drain() noexcept {
+    std::scoped_lock lock(m_drain_mutex);
+    drain_locked();
   }
-  stream = std::make_unique<std::ofstream>(filename, std::ios_base::out | std::ios_base::app);
-  pid = getpid();
+
+  // held across fork, so that the child doesn't inherit it locked by a
+  // thread of the parent which was writing at the time
+  void lock_for_fork() { m_drain_mutex.lock(); }
+  void unlock_after_fork() { m_drain_mutex.unlock(); }
+
+private:
+  void drain_locked() noexcept {
+    std::string m;
+    while (m_queue.try_pop(m)) {
+      if (m_batch.size() + m.size() > batch_size)
+        write_batch();
+      if (m.size() > batch_size) {
+        write_all(m);
+        continue;
+      }
+      m_batch += m;
+    }
+    write_batch();
+  }
+
+  void run(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+      {
+        std::unique_lock lock(m_wakeup_mutex);
+        m_wakeup.wait_for(lock, stop, drain_interval, [] { return false; });
+      }
+      drain();
+    }
+  }
+
+  std::string format_line(level l, std::string_view m) const {
+    const time_t now = time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%FT%T", &tm);
+
+    const auto pid = m_pid.load(std::memory_order_relaxed);
+
+    if (m_format.load(std::memory_order_relaxed) == format::text)
+      return fmt::format("[{} #{}] {}\n", timestamp, pid, m);
+
+    return fmt::format(R"({{"time":"{}Z","pid":{},"level":"{}","message":"{}"}})" "\n",
+                       timestamp, pid, level_name(l), json_escape(m));
+  }
+
+  static std::string_view level_name(level l) {
+    switch (l) {
+    case level::debug:
+      return "debug";
+    case level::info:
+      return "info";
+    case level::warning:
+      return "warning";
+    case level::error:
+      return "error";
+    }
+    return "";
+  }
+
+  static std::string json_escape(std::string_view m) {
+    std::string result;
+    result.reserve(m.size());
+    for (char c : m) {
+      switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+          result += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        else
+          result += c;
+      }
+    }
+    return result;
+  }
+
+  void write_batch() noexcept {
+    write_all(m_batch);
+    m_batch.clear();
+  }
+
+  void write_all(std::string_view data) const noexcept {
+    if (m_fd < 0)
+      return;
+
+    while (!data.empty()) {
+      const auto written = write(m_fd, data.data(), data.size());
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        return; // nowhere left to report the error
+      }
+      data.remove_prefix(written);
+    }
+  }
+
+  std::atomic<bool> m_open{false};
+  std::atomic<level> m_min_level{level::info};
+  std::atomic<format> m_format{format::text};
+  std::atomic<pid_t> m_pid{0};
+  std::atomic<bool> m_background{true};
+
+  message_queue m_queue;
+
+  std::mutex m_drain_mutex;
+  int m_fd = -1;
+  // reserved up front, so that appending to it never allocates
+  std::string m_batch;
+
+  std::mutex m_wakeup_mutex;
+  std::condition_variable_any m_wakeup;
+  std::jthread m_thread;
+};
+
+log_file file;
+
+[[maybe_unused]] const int fork_handlers = pthread_atfork(
+    [] { file.lock_for_fork(); }, [] { file.unlock_after_fork(); }, [] { file.unlock_after_fork(); });
+
+} // anonymous namespace
+
+void initialise(const std::string &filename, level min_level, format output, bool background) {
+  file.open(filename, min_level, output, background);
+}
+
+bool enabled(level l) noexcept {
+  return file.enabled(l);
 }
 
 void message(std::string_view m) noexcept {
-  if (stream) {
-    time_t now = time(nullptr);
-    *stream << "[" << std::put_time( std::gmtime( &now ), "%FT%T") << " #" << pid << "] " << m
-            << std::endl;
+  message(level::info, m);
+}
+
+void message(level l, std::string_view m) noexcept {
+  if (!enabled(l))
+    return;
+
+  try {
+    file.message(l, m);
+  } catch (...) {
+    // logging must never cause a request to fail
   }
 }
 
+void flush() noexcept {
+  file.drain();
+}
+
+std::optional<level> parse_level(std::string_view s) {
+  if (s == "debug")
+    return level::debug;
+  if (s == "info")
+    return level::info;
+  if (s == "warning")
+    return level::warning;
+  if (s == "error")
+    return level::error;
+  return {};
+}
+
+std::optional<format> parse_format(std::string_view s) {
+  if (s == "text")
+    return format::text;
+  if (s == "json")
+    return format::json;
+  return {};
+}
+
 }
@@ -30,13 +30,22 @@
 using namespace std::chrono_literals;
 
 #include "cgimap/logger.hpp"
+#include "cgimap/metrics.hpp"
 #include "cgimap/routes.hpp"
 #include "cgimap/rate_limiter.hpp"
 #include "cgimap/backend.hpp"
+#include "cgimap/cache_store.hpp"
+#include "cgimap/caching_data_selection.hpp"
 #include "cgimap/fcgi_request.hpp"
+#include "cgimap/fcgi_server.hpp"
 #include "cgimap/options.hpp"
 #include "cgimap/process_request.hpp"
+#include "cgimap/request_capture.hpp"
+#include "cgimap/shm_cache.hpp"
 #include "cgimap/backend/apidb/apidb.hpp"
+#include "cgimap/backend/apidb/invalidation_listener.hpp"
+#include "cgimap/backend/apidb/pgsql_update.hpp"
+#include "cgimap/backend/memory/memory.hpp"
 
 
 namespace po = boost::program_options;
@@ -133,6 +142,8 @@ void get_options(int argc, char **argv, po::variables_map &options) {
     ("instances", po::value<int>()->default_value(5), "number of daemon instances to run")
     ("pidfile", po::value<std::string>(), "file to write pid to")
     ("logfile", po::value<std::string>(), "file to write log messages to")
+    ("log-level", po::value<std::string>()->default_value("info"), "minimum level of log messages (debug, info, warning, error)")
+    ("log-format", po::value<std::string>()->default_value("text"), "format of log messages (text, json)")
     ("memcache", po::value<std::string>(), "memcache server specification")
     ("ratelimit", po::value<long>(), "average number of bytes/s to allow each client")
     ("moderator-ratelimit", po::value<long>(), "average number of bytes/s to allow each moderator")
@@ -140,6 +151,8 @@ void get_options(int argc, char **argv, po::variables_map &options) {
     ("moderator-maxdebt", po::value<long>(), "maximum debt (in Mb) to allow each moderator before rate limiting")
     ("port", po::value<int>(), "FCGI port number (e.g. 8000) to listen on. This option is for backwards compatibility, please use --socket for new configurations.")
     ("socket", po::value<std::string>(), "FCGI socket (e.g. :8000, or 127.0.0.1:8000) or UNIX domain socket to listen on")
+    ("socket-backlog", po::value<int>()->default_value(SOCKET_BACKLOG), "max number of FCGI connections waiting to be accepted")
+    ("metrics-socket", po::value<std::string>(), "address (e.g. :9100, or 127.0.0.1:9100) to serve Prometheus metrics on, at /metrics")
     ("configfile", po::value<std::string>(), "Config file")
     ;
   // clang-format on
@@ -163,6 +176,21 @@ void get_options(int argc, char **argv, po::variables_map &options) {
     ("max-element-tags", po::value<int>(), "max number of tags per OSM element")
     ("ratelimit-upload", po::value<bool>(), "enable rate limiting for changeset upload")
     ("bbox-size-limit-upload", po::value<bool>(), "enable bbox size limit for changeset upload")
+    ("server-timing-clients", po::value<std::string>(), "comma separated list of client IP addresses receiving a Server-Timing response header")
+    ("max-request-memory", po::value<long>(), "max memory (in MB) allocated while processing a single request")
+    ("ratelimit-entries", po::value<int>()->default_value(65536), "number of clients tracked by the rate limiter in shared memory")
+    ("ratelimit-local", "rate limit clients per host, if no memcache server is configured")
+    ("shm-cache-size", po::value<long>()->default_value(0), "size (in MB) of the cache shared by all daemon instances, 0 to disable")
+    ("capture-file", po::value<std::string>(), "file to capture a sample of requests to, for replay_requests")
+    ("capture-sample-rate", po::value<double>()->default_value(0.01), "share of requests to capture, between 0 and 1")
+    ("selection-cache", po::value<std::string>()->default_value("none"), "cache for historic versions and closed changesets: none, lru, shm or memcache")
+    ("selection-cache-size", po::value<long>()->default_value(64), "max size (in MB) of the lru selection cache of each process")
+    ("selection-cache-ttl", po::value<int>()->default_value(3600), "seconds historic versions and closed changesets (with --cache-invalidation-channel only) are cached")
+    ("selection-cache-visibility-ttl", po::value<int>()->default_value(10), "seconds the visibility of current elements is cached, 0 to disable")
+    ("map-cache-cell-size", po::value<double>()->default_value(0), "size (in degrees) of the grid cells map call results are cached for, 0 to disable")
+    ("map-cache-ttl", po::value<int>()->default_value(300), "seconds map call results are cached for a grid cell")
+    ("cache-invalidation-channel", po::value<std::string>(), "PostgreSQL channel to send and listen for cache invalidation notifications on")
+    ("worker-threads", po::value<int>()->default_value(0), "number of threads of each instance processing requests received by the event driven FCGI front end, 0 to use libfcgi")
     ;
   // clang-format on
 
@@ -194,52 +222,159 @@ void get_options(int argc, char **argv, po::variables_map &options) {
   if (options.contains("daemon") && !options.contains("socket") && !options.contains("port")) {
     throw std::runtime_error("an FCGI port number or UNIX socket is required in daemon mode");
   }
+
+  if (!logger::parse_level(options["log-level"].as<std::string>())) {
+    throw po::validation_error(po::validation_error::invalid_option_value, "log-level");
+  }
+
+  if (!logger::parse_format(options["log-format"].as<std::string>())) {
+    throw po::validation_error(po::validation_error::invalid_option_value, "log-format");
+  }
+
+  if (const auto rate = options["capture-sample-rate"].as<double>(); rate <= 0 || rate > 1) {
+    throw po::validation_error(po::validation_error::invalid_option_value, "capture-sample-rate");
+  }
+}
+
+/**
+ * open the log file, if any. called again on reload to reopen the file
+ * after log rotation. processes forking children log without a background
+ * thread.
+ */
+void initialise_logger(const po::variables_map &options, bool background = true) {
+  if (options.contains("logfile")) {
+    logger::initialise(options["logfile"].as<std::string>(),
+                       *logger::parse_level(options["log-level"].as<std::string>()),
+                       *logger::parse_format(options["log-format"].as<std::string>()),
+                       background);
+  }
+}
+
+// with shm or memcache, the selection cache is shared by all daemon
+// instances and invalidated by a single listener in the parent process
+bool selection_cache_shared(const po::variables_map &options) {
+  const auto type = options["selection-cache"].as<std::string>();
+  return type == "shm" || type == "memcache";
+}
+
+caching_data_selection::settings selection_cache_settings(const po::variables_map &options) {
+  caching_data_selection::settings settings;
+  settings.ttl = std::chrono::seconds(options["selection-cache-ttl"].as<int>());
+  // redactions and changeset comments would otherwise be ignored until
+  // the cached versions and changesets expire
+  settings.history = options.contains("cache-invalidation-channel");
+  settings.changesets = settings.history;
+  settings.visibility_ttl =
+      std::chrono::seconds(options["selection-cache-visibility-ttl"].as<int>());
+  settings.map_cell_size = options["map-cache-cell-size"].as<double>();
+  settings.map_ttl = std::chrono::seconds(options["map-cache-ttl"].as<int>());
+  return settings;
+}
+
+std::unique_ptr<invalidation_listener>
+start_invalidation_listener(const po::variables_map &options,
+                            std::shared_ptr<cache_store> cache) {
+  if (!cache || !options.contains("cache-invalidation-channel"))
+    return {};
+
+  return std::make_unique<invalidation_listener>(
+      connect_update_db_str(options), options["cache-invalidation-channel"].as<std::string>(),
+      [cache, settings = selection_cache_settings(options)](
+          const cache_invalidation::changes &changes) {
+        caching_data_selection::invalidate(*cache, settings, changes);
+      });
+}
+
+// factories of a thread processing requests, which hold its
+// database connections
+struct backends {
+  std::unique_ptr<data_selection::factory> selection;
+  std::unique_ptr<data_update::factory> update;
+};
+
+backends create_backends(const po::variables_map &options, std::shared_ptr<cache_store> cache) {
+  // create a factory for data selections - the mechanism for actually
+  // getting at data.
+  backends b{create_backend(options), nullptr};
+  if (cache) {
+    b.selection = std::make_unique<caching_data_selection::factory>(
+        std::move(b.selection), cache, selection_cache_settings(options));
+  }
+  b.update = create_update_backend(options);
+  return b;
+}
+
+// process any reload request, returns false once termination is requested
+bool check_signals(const po::variables_map &options) {
+  if (reload_requested) {
+    initialise_logger(options);
+    reload_requested = false;
+  }
+  return !terminate_requested;
 }
 
 /**
  * loop processing fasctgi requests until are asked to stop by
  * somebody sending us a TERM signal.
  */
-void process_requests(int socket, const po::variables_map &options) {
+void process_requests(int socket, const po::variables_map &options,
+                      rate_limit_table &rate_limits, shm_cache *shared_cache) {
   // generator string - identifies the cgimap instance.
   auto generator = get_generator_string();
   // open any log file
-  if (options.contains("logfile")) {
-    logger::initialise(options["logfile"].as<std::string>());
-  }
+  initialise_logger(options);
 
-  // create the rate limiter
-  memcached_rate_limiter limiter(options);
+  // create the rate limiter, based on state shared by all instances. without
+  // memcached, clients are only limited if asked for explicitly, as each
+  // host would otherwise grant them the full rate limit on its own.
+  std::unique_ptr<rate_limiter> limiter;
+  if (options.contains("memcache") || options.contains("ratelimit-local"))
+    limiter = std::make_unique<shm_rate_limiter>(rate_limits, options);
+  else
+    limiter = std::make_unique<null_rate_limiter>();
 
   // create the routes map (from URIs to handlers)
   routes route;
 
+  auto cache = create_cache_store(options, shared_cache);
+  if (cache && !options.contains("cache-invalidation-channel"))
+    logger::message("Historic versions and changesets are not cached without --cache-invalidation-channel");
+
+  std::unique_ptr<invalidation_listener> listener;
+  if (cache && !selection_cache_shared(options))
+    listener = start_invalidation_listener(options, cache);
+
+  if (const int threads = options["worker-threads"].as<int>(); threads > 0) {
+    // each worker thread gets its own backends
+    fcgi_server server(socket, threads, [&]() -> fcgi_server::handler {
+      auto b = std::make_shared<backends>(create_backends(options, cache));
+      return [&, b](request &req) {
+        process_request(req, *limiter, generator, route, *b->selection, b->update.get());
+      };
+    });
+
+    logger::message(fmt::format("Initialised with {:d} worker threads", threads));
+
+    server.run([&options] { return check_signals(options); });
+    logger::flush();
+    return;
+  }
+
   // create the request object (persists over several calls)
   fcgi_request req(socket, std::chrono::system_clock::time_point());
 
-  // create a factory for data selections - the mechanism for actually
-  // getting at data.
-  auto factory = create_backend(options);
-  auto update_factory = create_update_backend(options);
+  auto b = create_backends(options, cache);
 
   logger::message("Initialised");
 
   // enter the main loop
-  while (!terminate_requested) {
-    // process any reload request
-    if (reload_requested) {
-      if (options.contains("logfile")) {
-        logger::initialise(options["logfile"].as<std::string>());
-      }
-      reload_requested = false;
-    }
-
+  while (check_signals(options)) {
     // get the next request
     if (req.accept_r() >= 0) {
       const auto now(std::chrono::system_clock::now());
       req.set_current_time(now);
       try {
-        process_request(req, limiter, generator, route, *factory, update_factory.get());
+        process_request(req, *limiter, generator, route, *b.selection, b.update.get());
       } catch (...) {
         // Attempt to properly finish up FCGI request (so that clients will see the error message)
         req.dispose();
@@ -250,6 +385,7 @@ void process_requests(int socket, const po::variables_map &options) {
 
   // finish up - dispose of the resources
   req.dispose();
+  logger::flush();
 }
 
 void install_signal_handlers() {
@@ -307,6 +443,32 @@ void validate_instances(const po::variables_map &options) {
   }
 }
 
+void validate_worker_threads(const po::variables_map &options) {
+  int opt = options["worker-threads"].as<int>();
+  if (opt < 0) {
+      throw std::runtime_error("Number of worker threads must not be negative.");
+  }
+  else if (opt > 256) {
+      throw std::runtime_error("Number of worker threads must not exceed 256.");
+  }
+}
+
+int get_socket_backlog(const po::variables_map &options) {
+  int opt = options["socket-backlog"].as<int>();
+  if (opt <= 0) {
+      throw std::runtime_error("Socket backlog must be strictly positive.");
+  }
+  return opt;
+}
+
+std::size_t get_ratelimit_entries(const po::variables_map &options) {
+  int opt = options["ratelimit-entries"].as<int>();
+  if (opt <= 0) {
+      throw std::runtime_error("Number of rate limit entries must be strictly positive.");
+  }
+  return opt;
+}
+
 void write_pidfile(const po::variables_map &options) {
   if (options.contains("pidfile")) {
       std::ofstream pidfile(options["pidfile"].as<std::string>().c_str());
@@ -317,6 +479,24 @@ void write_pidfile(const po::variables_map &options) {
   }
 }
 
+std::unique_ptr<metrics::server> start_metrics_server(const po::variables_map &options) {
+  if (options.contains("metrics-socket")) {
+      return std::make_unique<metrics::server>(options["metrics-socket"].as<std::string>());
+  }
+  return {};
+}
+
+std::unique_ptr<shm_cache> create_shm_cache(const po::variables_map &options) {
+  const auto size = options["shm-cache-size"].as<long>();
+  if (size < 0) {
+      throw std::runtime_error("--shm-cache-size must not be negative.");
+  }
+  if (size == 0) {
+      return nullptr;
+  }
+  return std::make_unique<shm_cache>(size * 1024 * 1024);
+}
+
 void remove_pidfile(const po::variables_map &options) {
   if (options.contains("pidfile")) {
       remove(options["pidfile"].as<std::string>().c_str());
@@ -324,10 +504,12 @@ void remove_pidfile(const po::variables_map &options) {
 }
 
 
-[[noreturn]] void handle_child_process(int socket, const po::variables_map &options) {
+[[noreturn]] void handle_child_process(int socket, const po::variables_map &options,
+                                      rate_limit_table &rate_limits,
+                                      shm_cache *shared_cache) {
   const auto start = std::chrono::steady_clock::now();
   try {
-      process_requests(socket, options);
+      process_requests(socket, options, rate_limits, shared_cache);
   } catch (...) {
       const auto end = std::chrono::steady_clock::now();
       const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -339,12 +521,13 @@ void remove_pidfile(const po::variables_map &options) {
   exit(0);
 }
 
-void spawn_children(int socket, const po::variables_map &options, std::set<pid_t> &children, int instances) {
+void spawn_children(int socket, const po::variables_map &options, rate_limit_table &rate_limits,
+                    shm_cache *shared_cache, std::set<pid_t> &children, int instances) {
   while (!terminate_requested && (children.size() < instances)) {
       if (pid_t pid = fork(); pid < 0) {
           throw std::runtime_error("fork failed.");
       } else if (pid == 0) {
-          handle_child_process(socket, options);
+          handle_child_process(socket, options, rate_limits, shared_cache);
       } else {
           children.insert(pid);
       }
@@ -365,7 +548,8 @@ void signal_children(const std::set<pid_t> &children, int signal) {
   }
 }
 
-void daemon_mode(const po::variables_map &options, int socket) {
+void daemon_mode(const po::variables_map &options, int socket, rate_limit_table &rate_limits,
+                 shm_cache *shared_cache) {
   validate_instances(options);
 
   const int instances = options["instances"].as<int>();
@@ -375,8 +559,19 @@ void daemon_mode(const po::variables_map &options, int socket) {
   daemonise();
   write_pidfile(options);
 
+  // for the threads of the parent process, the children open the log file
+  // again for themselves
+  initialise_logger(options, false);
+
+  // served by the parent process, which sees the metrics of all children
+  auto metrics_server = start_metrics_server(options);
+
+  std::unique_ptr<invalidation_listener> listener;
+  if (selection_cache_shared(options))
+    listener = start_invalidation_listener(options, create_cache_store(options, shared_cache));
+
   while (!terminate_requested || !children.empty()) {
-      spawn_children(socket, options, children, instances);
+      spawn_children(socket, options, rate_limits, shared_cache, children, instances);
       wait_for_children(children);
 
       if (terminate_requested && !children_terminated) {
@@ -385,6 +580,7 @@ void daemon_mode(const po::variables_map &options, int socket) {
       }
 
       if (reload_requested) {
+          initialise_logger(options, false);
           signal_children(children, SIGHUP);
           reload_requested = false;
       }
@@ -394,7 +590,8 @@ void daemon_mode(const po::variables_map &options, int socket) {
 }
 
 
-void non_daemon_mode(const po::variables_map &options, int socket)
+void non_daemon_mode(const po::variables_map &options, int socket, rate_limit_table &rate_limits,
+                     shm_cache *shared_cache)
 {
   if (options.contains("instances") && !options["instances"].defaulted()) {
     std::cerr << "[WARN] The --instances parameter is ignored in non-daemon mode, running as single process only.\n"
@@ -406,8 +603,17 @@ void non_daemon_mode(const po::variables_map &options, int socket)
   // record our pid if requested
   write_pidfile(options);
 
+  // before starting threads which may log
+  initialise_logger(options);
+
+  auto metrics_server = start_metrics_server(options);
+
+  std::unique_ptr<invalidation_listener> listener;
+  if (selection_cache_shared(options))
+    listener = start_invalidation_listener(options, create_cache_store(options, shared_cache));
+
   // do work here
-  process_requests(socket, options);
+  process_requests(socket, options, rate_limits, shared_cache);
 
   // remove any pid file
   remove_pidfile(options);
@@ -416,7 +622,7 @@ void non_daemon_mode(const po::variables_map &options, int socket)
 int init_socket(const po::variables_map &options)
 {
   if (options.contains("socket")) {
-    int socket = fcgi_request::open_socket(options["socket"].as<std::string>(), SOCKET_BACKLOG);
+    int socket = fcgi_request::open_socket(options["socket"].as<std::string>(), get_socket_backlog(options));
     if (socket < 0) {
       throw std::runtime_error("Couldn't open FCGX socket.");
     }
@@ -426,7 +632,7 @@ int init_socket(const po::variables_map &options)
   // fall back to the old --port option if socket isn't available.
   if (options.contains("port")) {
     auto sock_str = fmt::format(":{:d}", options["port"].as<int>());
-    int socket = fcgi_request::open_socket(sock_str, SOCKET_BACKLOG);
+    int socket = fcgi_request::open_socket(sock_str, get_socket_backlog(options));
     if (socket < 0) {
       throw std::runtime_error("Couldn't open FCGX socket (from port).");
     }
@@ -443,8 +649,10 @@ int main(int argc, char **argv) {
   try {
     po::variables_map options;
 
-    // set up the apidb backend
+    // set up the backends, selected via --backend
     register_backend(make_apidb_backend());
+    register_backend(make_memory_backend());
+    register_backend(make_snapshot_backend());
 
     // get options
     get_options(argc, argv, options);
@@ -452,21 +660,45 @@ int main(int argc, char **argv) {
     // set global_settings based on provided options
     global_settings::set_configuration(std::make_unique<global_settings_via_options>(options));
 
+    validate_worker_threads(options);
+
     // get the socket to use
     auto socket = init_socket(options);
 
+    // rate limiting state is shared by all daemon instances, hence it
+    // has to be set up before forking
+    rate_limit_table rate_limits(get_ratelimit_entries(options));
+
+    // as is the cache of --shm-cache-size, which also keeps its entries
+    // when daemon instances are restarted
+    auto shared_cache = create_shm_cache(options);
+
+    // likewise, metrics are collected from all daemon instances
+    if (options.contains("metrics-socket")) {
+      metrics::initialise();
+    }
+
+    // and all of them append to the same capture file
+    if (options.contains("capture-file")) {
+      request_capture::initialise(options["capture-file"].as<std::string>(),
+                                  options["capture-sample-rate"].as<double>());
+    }
+
+    // data loaded by the backend is shared by all daemon instances
+    prepare_backend(options);
+
     // are we supposed to run as a daemon?
     if (options.contains("daemon")) {
-      daemon_mode(options, socket);
+      daemon_mode(options, socket, rate_limits, shared_cache.get());
     } else {
-      non_daemon_mode(options, socket);
+      non_daemon_mode(options, socket, rate_limits, shared_cache.get());
     }
   } catch (const po::error & e) {
     std::cerr << "Error: " << e.what() << "\n(\"openstreetmap-cgimap --help\" for help)" << '\n';
     return 1;
 
   } catch (const pqxx::sql_error &er) {
-    logger::message(er.what());
+    logger::message(logger::level::error, er.what());
     // Catch-all for query related postgres exceptions
     std::cerr << "Error: " << er.what() << '\n'
               << "Caused by: " << er.query() << '\n';
@@ -476,14 +708,14 @@ int main(int argc, char **argv) {
 
   } catch (const pqxx::pqxx_exception &e) {
     // Catch-all for any other postgres exceptions
-    logger::message(e.base().what());
+    logger::message(logger::level::error, e.base().what());
     std::cerr << "Error: " << e.base().what() << '\n';
     return 1;
 
 #endif
 
   } catch (const std::exception &e) {
-    logger::message(e.what());
+    logger::message(logger::level::error, e.what());
     std::cerr << "Error: " << e.what() << '\n';
     return 1;
   }
@@ -0,0 +1,530 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace metrics {
+
+namespace {
+
+enum class kind : uint8_t { counter, histogram };
+
+using buckets_t = std::array<double, 14>;
+
+// upper bounds in seconds, shared by all latency histograms
+constexpr buckets_t latency_buckets{
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30
+};
+
+// upper bounds in seconds for the age of cache entries
+constexpr buckets_t age_buckets{
+  1, 5, 10, 30, 60, 120, 300, 600, 900, 1800, 3600, 7200, 21600, 86400
+};
+
+struct family {
+  std::string_view name;
+  std::string_view help;
+  kind type;
+  const buckets_t *buckets = nullptr;
+};
+
+enum family_id : uint8_t {
+  requests_total,
+  request_duration,
+  statement_duration,
+  response_bytes,
+  response_bytes_uncompressed,
+  ratelimit_rejections,
+  cache_lookups,
+  cache_evictions,
+  cache_entry_age,
+};
+
+constexpr std::array families{
+  family{"cgimap_requests_total", "Number of completed requests", kind::counter},
+  family{"cgimap_request_duration_seconds", "Request processing time", kind::histogram, &latency_buckets},
+  family{"cgimap_db_statement_duration_seconds", "Execution time of prepared statements", kind::histogram, &latency_buckets},
+  family{"cgimap_response_bytes_total", "Response body bytes sent, after content encoding", kind::counter},
+  family{"cgimap_response_bytes_uncompressed_total", "Response body bytes, before content encoding", kind::counter},
+  family{"cgimap_ratelimit_rejections_total", "Number of requests rejected by the rate limiter", kind::counter},
+  family{"cgimap_cache_lookups_total", "Number of cache lookups by result", kind::counter},
+  family{"cgimap_cache_evictions_total", "Number of unexpired cache entries evicted", kind::counter},
+  family{"cgimap_cache_entry_age_seconds", "Age of cache entries when they are used", kind::histogram, &age_buckets},
+};
+
+constexpr std::size_t max_labels_length = 160;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "metrics require lock free atomics in shared memory");
+
+/*
+ * A single time series. Entries are never removed, so once an entry is
+ * ready, its key doesn't change anymore and values can be updated without
+ * taking any locks.
+ */
+struct series {
+  enum : uint32_t { empty, claimed, ready };
+
+  std::atomic<uint32_t> state;
+  family_id family;
+  uint8_t labels_length;
+  char labels[max_labels_length];
+
+  // counter value, or number of observations for histograms
+  std::atomic<uint64_t> value;
+  // histogram only
+  std::atomic<uint64_t> sum_us;
+  std::array<std::atomic<uint64_t>, std::tuple_size_v<buckets_t>> buckets;
+
+  [[nodiscard]] std::string_view label_view() const {
+    return {labels, labels_length};
+  }
+};
+
+struct shared_header {
+  std::atomic<uint64_t> dropped_series;
+};
+
+class registry {
+public:
+  explicit registry(std::size_t capacity) : m_capacity(std::max<std::size_t>(capacity, 1)) {
+
+    m_mapping_size = sizeof(shared_header) + m_capacity * sizeof(series);
+
+    void *mapping = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+      throw std::runtime_error("Failed to allocate shared memory for metrics");
+
+    m_header = new (mapping) shared_header{};
+    m_series = reinterpret_cast<series *>(static_cast<char *>(mapping) + sizeof(shared_header));
+    for (std::size_t i = 0; i < m_capacity; ++i)
+      new (&m_series[i]) series{};
+  }
+
+  ~registry() { munmap(m_header, m_mapping_size); }
+
+  registry(const registry &) = delete;
+  registry &operator=(const registry &) = delete;
+
+  series *get(family_id family, std::string_view labels) {
+
+    std::string key;
+    key.reserve(labels.size() + 1);
+    key += static_cast<char>(family);
+    key += labels;
+
+    std::lock_guard lock(m_cache_mutex);
+
+    // the cache is process local, but points into the shared mapping
+    if (auto it = m_cache.find(key); it != m_cache.end())
+      return it->second;
+
+    auto *s = find_or_insert(family, labels, std::hash<std::string>{}(key));
+    if (s)
+      m_cache.emplace(std::move(key), s);
+    return s;
+  }
+
+  [[nodiscard]] std::vector<const series *> snapshot() const {
+    std::vector<const series *> result;
+    for (std::size_t i = 0; i < m_capacity; ++i) {
+      if (m_series[i].state.load(std::memory_order_acquire) == series::ready)
+        result.push_back(&m_series[i]);
+    }
+    return result;
+  }
+
+  [[nodiscard]] uint64_t dropped_series() const {
+    return m_header->dropped_series.load(std::memory_order_relaxed);
+  }
+
+private:
+  series *find_or_insert(family_id family, std::string_view labels, std::size_t hash) {
+
+    if (labels.size() > max_labels_length) {
+      m_header->dropped_series.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    // open addressing with linear probing, other processes may insert
+    // entries concurrently
+    for (std::size_t probe = 0; probe < m_capacity; ++probe) {
+      auto &s = m_series[(hash + probe) % m_capacity];
+
+      auto state = s.state.load(std::memory_order_acquire);
+
+      if (state == series::empty &&
+          s.state.compare_exchange_strong(state, series::claimed, std::memory_order_acquire)) {
+        s.family = family;
+        s.labels_length = static_cast<uint8_t>(labels.size());
+        std::memcpy(s.labels, labels.data(), labels.size());
+        s.state.store(series::ready, std::memory_order_release);
+        return &s;
+      }
+
+      // another process is just setting up this entry
+      while (state == series::claimed) {
+        std::this_thread::yield();
+        state = s.state.load(std::memory_order_acquire);
+      }
+
+      if (s.family == family && s.label_view() == labels)
+        return &s;
+    }
+
+    m_header->dropped_series.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  std::size_t m_capacity;
+  std::size_t m_mapping_size;
+  shared_header *m_header;
+  series *m_series;
+
+  std::mutex m_cache_mutex;
+  std::unordered_map<std::string, series *> m_cache;
+};
+
+static std::unique_ptr<registry> instance;
+
+std::string escape_label_value(std::string_view value) {
+  std::string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+    case '\\':
+      result += "\\\\";
+      break;
+    case '"':
+      result += "\\\"";
+      break;
+    case '\n':
+      result += "\\n";
+      break;
+    default:
+      result += c;
+    }
+  }
+  return result;
+}
+
+std::string label(std::string_view name, std::string_view value) {
+  return fmt::format("{}=\"{}\"", name, escape_label_value(value));
+}
+
+void add(family_id family, std::string_view labels, uint64_t value) {
+  if (!instance)
+    return;
+
+  if (auto *s = instance->get(family, labels))
+    s->value.fetch_add(value, std::memory_order_relaxed);
+}
+
+template <typename Duration>
+void observe(family_id family, std::string_view labels, Duration elapsed) {
+  if (!instance)
+    return;
+
+  auto *s = instance->get(family, labels);
+  if (s == nullptr)
+    return;
+
+  const auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  const double seconds = us / 1e6;
+
+  const auto &bounds = *families.at(family).buckets;
+  const auto bucket = std::ranges::lower_bound(bounds, seconds);
+  if (bucket != bounds.end())
+    s->buckets[bucket - bounds.begin()].fetch_add(1, std::memory_order_relaxed);
+
+  s->sum_us.fetch_add(std::max<int64_t>(us, 0), std::memory_order_relaxed);
+  s->value.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string with_label(std::string_view labels, std::string_view extra) {
+  if (labels.empty())
+    return fmt::format("{{{}}}", extra);
+  return fmt::format("{{{},{}}}", labels, extra);
+}
+
+std::string braced(std::string_view labels) {
+  if (labels.empty())
+    return {};
+  return fmt::format("{{{}}}", labels);
+}
+
+void render_series(std::string &out, const family &f, const series &s) {
+
+  const auto labels = s.label_view();
+
+  if (f.type == kind::counter) {
+    out += fmt::format("{}{} {}\n", f.name, braced(labels), s.value.load(std::memory_order_relaxed));
+    return;
+  }
+
+  uint64_t cumulative = 0;
+  for (std::size_t i = 0; i < f.buckets->size(); ++i) {
+    cumulative += s.buckets[i].load(std::memory_order_relaxed);
+    out += fmt::format("{}_bucket{} {}\n", f.name,
+                       with_label(labels, fmt::format("le=\"{}\"", (*f.buckets)[i])),
+                       cumulative);
+  }
+
+  // observations may have been recorded in between, the count includes
+  // at least all observations in the buckets.
+  const auto count = std::max(cumulative, s.value.load(std::memory_order_relaxed));
+
+  out += fmt::format("{}_bucket{} {}\n", f.name, with_label(labels, "le=\"+Inf\""), count);
+  out += fmt::format("{}_sum{} {}\n", f.name, braced(labels),
+                     s.sum_us.load(std::memory_order_relaxed) / 1e6);
+  out += fmt::format("{}_count{} {}\n", f.name, braced(labels), count);
+}
+
+std::string http_response(std::string_view status, std::string_view content_type,
+                          std::string_view body) {
+  return fmt::format("HTTP/1.0 {}\r\n"
+                     "Content-Type: {}\r\n"
+                     "Content-Length: {}\r\n"
+                     "Connection: close\r\n"
+                     "\r\n"
+                     "{}",
+                     status, content_type, body.size(), body);
+}
+
+void write_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    data.remove_prefix(n);
+  }
+}
+
+void handle_connection(int fd) {
+
+  timeval timeout{.tv_sec = 1, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // the request line is all that's needed, headers are ignored
+  std::string request;
+  std::array<char, 1024> buffer;
+  while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+    const auto n = ::recv(fd, buffer.data(), buffer.size(), 0);
+    if (n <= 0)
+      break;
+    request.append(buffer.data(), n);
+  }
+
+  if (request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?")) {
+    write_all(fd, http_response("200 OK", "text/plain; version=0.0.4; charset=utf-8", render()));
+  } else {
+    write_all(fd, http_response("404 Not Found", "text/plain", "Not found\n"));
+  }
+}
+
+} // anonymous namespace
+
+void initialise(std::size_t max_series) {
+  instance = std::make_unique<registry>(max_series);
+}
+
+void observe_request(std::string_view route, int status,
+                     std::chrono::steady_clock::duration elapsed) {
+  if (!instance)
+    return;
+
+  const auto route_label = label("route", route);
+  add(requests_total, fmt::format("{},{}", route_label, label("status", std::to_string(status))), 1);
+  observe(request_duration, route_label, elapsed);
+}
+
+void observe_statement(std::string_view statement,
+                       std::chrono::steady_clock::duration elapsed) {
+  if (!instance)
+    return;
+
+  observe(statement_duration, label("statement", statement), elapsed);
+}
+
+void add_response_bytes(std::string_view encoding, std::size_t uncompressed,
+                        std::size_t encoded) {
+  if (!instance)
+    return;
+
+  const auto labels = label("encoding", encoding);
+  add(response_bytes, labels, encoded);
+  add(response_bytes_uncompressed, labels, uncompressed);
+}
+
+void count_rate_limited() {
+  add(ratelimit_rejections, "", 1);
+}
+
+void count_cache_lookup(std::string_view cache, bool hit) {
+  if (!instance)
+    return;
+
+  add(cache_lookups, fmt::format("{},{}", label("cache", cache), label("result", hit ? "hit" : "miss")), 1);
+}
+
+void count_cache_eviction(std::string_view cache) {
+  if (!instance)
+    return;
+
+  add(cache_evictions, label("cache", cache), 1);
+}
+
+void observe_cache_age(std::string_view cache, std::chrono::seconds age) {
+  if (!instance)
+    return;
+
+  observe(cache_entry_age, label("cache", cache), std::max(age, std::chrono::seconds(0)));
+}
+
+std::string_view route_name(std::string_view log_name) {
+  return log_name.substr(0, log_name.find_first_of(" (?"));
+}
+
+std::string render() {
+
+  std::string out;
+
+  if (!instance)
+    return out;
+
+  auto all_series = instance->snapshot();
+
+  std::ranges::sort(all_series, [](const series *a, const series *b) {
+    return std::tuple(a->family, a->label_view()) < std::tuple(b->family, b->label_view());
+  });
+
+  std::optional<family_id> current;
+
+  for (const auto *s : all_series) {
+    const auto &f = families.at(s->family);
+    if (current != s->family) {
+      out += fmt::format("# HELP {} {}\n", f.name, f.help);
+      out += fmt::format("# TYPE {} {}\n", f.name, f.type == kind::counter ? "counter" : "histogram");
+      current = s->family;
+    }
+    render_series(out, f, *s);
+  }
+
+  out += "# HELP cgimap_metrics_dropped_series_total Number of series which didn't fit into the registry\n"
+         "# TYPE cgimap_metrics_dropped_series_total counter\n";
+  out += fmt::format("cgimap_metrics_dropped_series_total {}\n", instance->dropped_series());
+
+  return out;
+}
+
+server::server(const std::string &address) {
+
+  std::string host = "127.0.0.1";
+  std::string port = address;
+
+  if (const auto colon = address.rfind(':'); colon != std::string::npos) {
+    if (colon > 0)
+      host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr)
+    throw std::runtime_error(fmt::format("Invalid metrics socket address: {}", address));
+
+  std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addresses(result, &freeaddrinfo);
+
+  m_socket = ::socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+  if (m_socket < 0)
+    throw std::runtime_error("Couldn't create metrics socket.");
+
+  int yes = 1;
+  setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  if (::bind(m_socket, result->ai_addr, result->ai_addrlen) < 0 ||
+      ::listen(m_socket, 16) < 0) {
+    ::close(m_socket);
+    throw std::runtime_error(fmt::format("Couldn't listen on metrics socket {}.", address));
+  }
+
+  m_owner = getpid();
+  m_thread = std::make_unique<std::jthread>([this](std::stop_token stop) { run(stop); });
+}
+
+server::~server() {
+  if (getpid() != m_owner) {
+    // joining isn't possible here, as the thread isn't part of this process
+    (void)m_thread.release();
+  }
+  m_thread.reset();
+  ::close(m_socket);
+}
+
+int server::port() const {
+  sockaddr_storage addr{};
+  socklen_t length = sizeof(addr);
+  if (getsockname(m_socket, reinterpret_cast<sockaddr *>(&addr), &length) < 0)
+    return -1;
+
+  if (addr.ss_family == AF_INET6)
+    return ntohs(reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port);
+  return ntohs(reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+}
+
+void server::run(std::stop_token stop) {
+
+  while (!stop.stop_requested()) {
+    pollfd pfd{.fd = m_socket, .events = POLLIN, .revents = 0};
+
+    // wake up regularly to check for shutdown
+    if (poll(&pfd, 1, 200) <= 0)
+      continue;
+
+    const int fd = ::accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    handle_connection(fd);
+    ::close(fd);
+  }
+}
+
+} // namespace metrics
@@ -35,6 +35,8 @@ void global_settings_via_options::init_fallback_values(const global_settings_bas
   m_moderator_ratelimiter_maxdebt = def.get_ratelimiter_maxdebt(true);
   m_ratelimiter_upload = def.get_ratelimiter_upload();
   m_bbox_size_limiter_upload = def.get_bbox_size_limiter_upload();
+  m_server_timing_clients = def.get_server_timing_clients();
+  m_request_memory_max = def.get_request_memory_max();
 }
 
 void global_settings_via_options::set_new_options(const po::variables_map &options) {
@@ -53,6 +55,8 @@ void global_settings_via_options::set_new_options(const po::variables_map &optio
   set_ratelimiter_maxdebt(options);
   set_ratelimiter_upload(options);
   set_bbox_size_limiter_upload(options);
+  set_server_timing_clients(options);
+  set_request_memory_max(options);
 }
 
 void global_settings_via_options::set_payload_max_size(const po::variables_map &options)  {
@@ -196,6 +200,27 @@ void global_settings_via_options::set_bbox_size_limiter_upload(const po::variabl
   }
 }
 
+void global_settings_via_options::set_server_timing_clients(const po::variables_map &options) {
+  if (options.contains("server-timing-clients")) {
+    m_server_timing_clients.clear();
+    for (auto &&part : std::ranges::views::split(options["server-timing-clients"].as<std::string>(), ',')) {
+      std::string client(part.begin(), part.end());
+      std::erase(client, ' ');
+      if (!client.empty())
+        m_server_timing_clients.insert(client);
+    }
+  }
+}
+
+void global_settings_via_options::set_request_memory_max(const po::variables_map &options) {
+  if (options.contains("max-request-memory")) {
+    auto parsed_max_mb = options["max-request-memory"].as<long>();
+    if (parsed_max_mb <= 0)
+      throw std::invalid_argument("max-request-memory must be a positive number");
+    m_request_memory_max = static_cast<uint64_t>(parsed_max_mb) * 1024 * 1024;
+  }
+}
+
 /// @brief Simplified parser for Postgresql interval format
 /// @param timeout The format is a number followed by a space and a unit
 ///               (day, days, hour, hours, minute, minutes, second, seconds).
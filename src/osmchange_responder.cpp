@@ -7,10 +7,13 @@
  * For a full list of authors see the git log.
  */
 
+#include "cgimap/http.hpp"
 #include "cgimap/logger.hpp"
 #include "cgimap/osmchange_responder.hpp"
+#include "cgimap/request_memory.hpp"
 
 #include <chrono>
+#include <exception>
 #include <fmt/core.h>
 #include <algorithm>
 
@@ -51,7 +54,9 @@ std::strong_ordering operator<=>(const element &a, const element &b) {
   return a.m_info.id <=> b.m_info.id;
 }
 
-struct sorting_formatter : public output_formatter {
+} // anonymous namespace
+
+struct osmchange_responder::sorting_formatter : public output_formatter {
 
   ~sorting_formatter() override = default;
 
@@ -111,6 +116,7 @@ struct sorting_formatter : public output_formatter {
                   .m_members = members_t() };
 
     m_elements.emplace_back(std::move(node));
+    request_memory::check();
   }
 
   void write_way(
@@ -126,6 +132,7 @@ struct sorting_formatter : public output_formatter {
                  .m_members = members_t() };
 
     m_elements.emplace_back(std::move(way));
+    request_memory::check();
   }
 
   void write_relation(
@@ -141,6 +148,7 @@ struct sorting_formatter : public output_formatter {
                  .m_members = members };
 
     m_elements.emplace_back(std::move(rel));
+    request_memory::check();
   }
 
   // LCOV_EXCL_START
@@ -233,30 +241,52 @@ private:
   }
 };
 
-} // anonymous namespace
-
 osmchange_responder::osmchange_responder(mime::type mt, data_selection &s)
   : osm_responder(mt, {}),
     sel(s) {
 }
 
+osmchange_responder::~osmchange_responder() = default;
+
 std::vector<mime::type> osmchange_responder::types_available() const {
   return {mime::type::application_xml};
 }
 
+void osmchange_responder::prepare() {
+
+  // all elements are needed for sorting anyway
+  try {
+    auto elements = std::make_unique<sorting_formatter>();
+
+    sel.write_nodes(*elements);
+    sel.write_ways(*elements);
+    sel.write_relations(*elements);
+
+    sorter = std::move(elements);
+
+  } catch (const http::exception &) {
+    // e.g. exceeding the request memory limit, which gets its own status code
+    throw;
+
+  } catch (const std::exception &) {
+    // other errors are reported inside the document by write()
+    error = std::current_exception();
+  }
+}
+
 void osmchange_responder::write(output_formatter& fmt,
                                 const std::string &generator,
                                 const std::chrono::system_clock::time_point &now) {
 
+  if (!sorter && !error)
+    prepare();
+
   fmt.start_document(generator, "osmChange");
   try {
-    sorting_formatter sorter;
-
-    sel.write_nodes(sorter);
-    sel.write_ways(sorter);
-    sel.write_relations(sorter);
+    if (error)
+      std::rethrow_exception(error);
 
-    sorter.write(fmt);
+    sorter->write(fmt);
 
   } catch (const std::exception &e) {
     logger::message(fmt::format("Caught error in osmchange_responder: {}",
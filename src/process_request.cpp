@@ -10,6 +10,7 @@
 #include "cgimap/process_request.hpp"
 #include "cgimap/http.hpp"
 #include "cgimap/logger.hpp"
+#include "cgimap/metrics.hpp"
 #include "cgimap/request_helpers.hpp"
 #include "cgimap/request_context.hpp"
 #include "cgimap/choose_formatter.hpp"
@@ -17,7 +18,12 @@
 #include "cgimap/output_writer.hpp"
 #include "cgimap/util.hpp"
 #include "cgimap/oauth2.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/request_capture.hpp"
+#include "cgimap/request_memory.hpp"
+#include "cgimap/request_timing.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <tuple>
@@ -51,6 +57,21 @@ void validate_user_db_update_permission (
     throw http::unauthorized ("You have not granted the modify map permission");
 }
 
+// tells clients how far the data of a replicated copy of the database is
+// behind. only sent with successful responses, as errors may not have
+// been caused by the data.
+void add_replication_lag_header(request& req, const data_selection& selection)
+{
+  const auto timestamp = selection.data_timestamp();
+  if (!timestamp)
+    return;
+
+  const auto lag = std::chrono::duration_cast<std::chrono::seconds>(
+      req.get_current_time() - *timestamp);
+  req.add_success_header("X-Replication-Lag",
+                         std::to_string(std::max<int64_t>(lag.count(), 0)));
+}
+
 void check_db_readonly_mode (const data_update& data_update)
 {
   if (data_update.is_api_write_disabled())
@@ -182,6 +203,14 @@ std::size_t generate_response(request &req, responder &responder, const std::str
   // figure out best mime type
   const mime::type best_mime_type = choose_best_mime_type(req, responder);
 
+  // errors up to here are still reported with their own status code, so the
+  // memory limit is enforced before anything is sent
+  {
+    auto span = request_timing::measure(request_timing::phase::selection);
+    responder.prepare();
+  }
+  request_memory::check();
+
   // TODO: use handler/responder to setup response headers.
   // write the response header
   req.status(200)
@@ -190,13 +219,22 @@ std::size_t generate_response(request &req, responder &responder, const std::str
      .add_header("Content-Encoding", encoding->name())
      .add_header("Cache-Control", "private, max-age=0, must-revalidate");
 
+  // only phases up to here can be reported, as the header needs to be sent
+  // before the response body
+  if (const auto *timing = request_timing::current(); timing && timing->send_server_timing)
+    req.add_header("Server-Timing", timing->server_timing());
+
   // create the XML/JSON/text writer with the FCGI streams as output
-  auto out = encoding->buffer(req.get_buffer());
+  auto &buffer = req.get_buffer();
+  auto out = encoding->buffer(buffer);
+  const auto encoded_bytes_before = buffer.written();
 
   // create the correct mime type output formatter.
   auto o_formatter = create_formatter(best_mime_type, *out);
 
   try {
+    auto span = request_timing::measure(request_timing::phase::serialize);
+
     // call to write the response
     responder.write(*o_formatter, generator, req.get_current_time());
 
@@ -211,7 +249,7 @@ std::size_t generate_response(request &req, responder &responder, const std::str
 
   } catch (const output_writer::write_error &e) {
     // don't do anything - just go on to the next request.
-    logger::message(fmt::format("Caught write error, aborting request: {}", e.what()));
+    logger::message(logger::level::warning, fmt::format("Caught write error, aborting request: {}", e.what()));
 
   } catch (const std::exception &e) {
     // errors here are unrecoverable (fatal to the request but maybe
@@ -220,6 +258,9 @@ std::size_t generate_response(request &req, responder &responder, const std::str
     o_formatter->error(e.what());
   }
 
+  metrics::add_response_bytes(encoding->name(), out->written(),
+                              buffer.written() - encoded_bytes_before);
+
   return out->written();
 }
 
@@ -235,7 +276,13 @@ process_get_request(request& req, const handler& handler,
   logger::message(fmt::format("Started request for {} from {}", request_name, ip));
 
   // Collect all object ids (nodes/ways/relations/...) for the respective endpoint
-  responder_ptr_t responder = handler.responder(selection);
+  responder_ptr_t responder;
+  {
+    auto span = request_timing::measure(request_timing::phase::selection);
+    responder = handler.responder(selection);
+  }
+
+  add_replication_lag_header(req, selection);
 
   // Generate full XML/JSON/text response message for previously collected object ids
   std::size_t bytes_written = generate_response(req, *responder, generator);
@@ -272,7 +319,11 @@ process_post_put_request(RequestContext& req_ctx,
 
       // Executing the responder constructor parses the payload, performs db CRUD operations
       // and eventually calls db commit(), in case there are no issues with the data.
-      auto responder = pe_handler.responder(*data_update, payload, req_ctx);
+      responder_ptr_t responder;
+      {
+        auto span = request_timing::measure(request_timing::phase::selection);
+        responder = pe_handler.responder(*data_update, payload, req_ctx);
+      }
 
       // does the responder instance carry all the data which is needed to construct a response?
       if (!pe_handler.requires_selection_after_update())
@@ -295,7 +346,11 @@ process_post_put_request(RequestContext& req_ctx,
 
     // create a data selection for the request
     auto data_selection = factory.make_selection(*read_only_transaction);
-    auto sel_responder = pe_handler.responder(*data_selection);
+    responder_ptr_t sel_responder;
+    {
+      auto span = request_timing::measure(request_timing::phase::selection);
+      sel_responder = pe_handler.responder(*data_selection);
+    }
     bytes_written = generate_response(req_ctx.req, *sel_responder, generator);
 
   } catch(std::bad_cast&) {
@@ -325,7 +380,13 @@ process_head_request(request& req, const handler& handler,
   // them unmodified
 
   // constructor of responder handles dynamic validation (i.e: with db access).
-  responder_ptr_t responder = handler.responder(selection);
+  responder_ptr_t responder;
+  {
+    auto span = request_timing::measure(request_timing::phase::selection);
+    responder = handler.responder(selection);
+  }
+
+  add_replication_lag_header(req, selection);
 
   // get encoding to use
   auto encoding = get_encoding(req);
@@ -380,6 +441,26 @@ std::tuple<std::string, size_t> process_options_request(
   return {request_name, 0};
 }
 
+// Records request count and latency by route once the request has been
+// answered, including requests ending in an error response, and captures
+// the request for later replay if enabled.
+struct request_metrics {
+  explicit request_metrics(const request &req) : req(req) {}
+
+  ~request_metrics() {
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    metrics::observe_request(route, req.response_status(), elapsed);
+    request_capture::capture(req, route, elapsed);
+  }
+
+  request_metrics(const request_metrics &) = delete;
+  request_metrics &operator=(const request_metrics &) = delete;
+
+  const request &req;
+  std::string route{"unknown"};
+  const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+};
+
 const std::string addr_prefix("addr:");
 const std::string user_prefix("user:");
 
@@ -418,20 +499,28 @@ void process_request(request &req, rate_limiter &limiter,
                      data_selection::factory& factory,
                      data_update::factory* update_factory) {
 
+  request_metrics req_metrics(req);
+
   try {
 
     RequestContext req_ctx{.req=req};
+    request_timing::scope timing_scope(req_ctx.timing);
+    req_ctx.memory.limit = global_settings::get_request_memory_max();
+    request_memory::scope memory_scope(req_ctx.memory);
 
     std::setlocale(LC_ALL, "C.UTF-8");
 
     // get the client IP address
     const auto ip = fcgi_get_env(req, "REMOTE_ADDR");
 
+    req_ctx.timing.send_server_timing = global_settings::get_server_timing_clients().contains(ip);
+
     // fetch and parse the request method
     const auto maybe_method = http::parse_method(fcgi_get_env(req, "REQUEST_METHOD"));
 
     // figure how to handle the request
     auto handler = route(req);
+    req_metrics.route = metrics::route_name(handler->log_name());
 
     // if handler doesn't accept this method, then return method not
     // allowed.
@@ -451,7 +540,10 @@ void process_request(request &req, rate_limiter &limiter,
     // create a data selection for the request
     auto selection = factory.make_selection(*default_transaction);
 
-    const auto [user_id, allow_api_write] = determine_user_id(req, *selection);
+    const auto [user_id, allow_api_write] = [&] {
+      auto span = request_timing::measure(request_timing::phase::auth);
+      return determine_user_id(req, *selection);
+    }();
 
     // Initially assume IP based client key
     std::string client_key = addr_prefix + ip;
@@ -471,9 +563,14 @@ void process_request(request &req, rate_limiter &limiter,
     // skip check in case of HTTP OPTIONS since it interferes with CORS preflight requests
     // see https://github.com/facebook/Rapid/issues/1424 for context
     if (method != http::method::OPTIONS) {
-      if (auto [exceeded_limit, retry_seconds] = limiter.check(client_key, is_moderator);
-          exceeded_limit) {
+      auto [exceeded_limit, retry_seconds] = [&] {
+        auto span = request_timing::measure(request_timing::phase::ratelimit);
+        return limiter.check(client_key, is_moderator);
+      }();
+
+      if (exceeded_limit) {
         logger::message(fmt::format("Rate limiter rejected request from {}", client_key));
+        metrics::count_rate_limited();
         throw http::bandwidth_limit_exceeded(retry_seconds);
       }
     }
@@ -533,10 +630,14 @@ void process_request(request &req, rate_limiter &limiter,
     // logging twice when an error is thrown.)
     const auto end_time = std::chrono::high_resolution_clock::now();
     const auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-    logger::message(fmt::format("Completed request for {} from {} in {:d} ms returning {:d} bytes",
+    auto summary = req_ctx.timing.summary();
+    if (const auto memory = req_ctx.memory.summary(); !memory.empty())
+      summary += summary.empty() ? memory : " " + memory;
+    logger::message(fmt::format("Completed request for {} from {} in {:d} ms returning {:d} bytes ({})",
                     request_name, ip,
                     delta,
-                    bytes_written));
+                    bytes_written,
+                    summary));
 
   } catch (const http::not_found &e) {
     // most errors are passed back giving the client a choice of whether to
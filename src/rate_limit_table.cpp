@@ -0,0 +1,227 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/rate_limit_table.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t entries_per_bucket = 8;
+
+std::string_view truncate_key(std::string_view key) {
+  return key.substr(0, rate_limit_table::max_key_length);
+}
+
+bool process_alive(pid_t pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+} // anonymous namespace
+
+struct rate_limit_table::entry {
+  time_t last_update;
+  uint32_t bytes_served;
+  uint32_t pending_bytes;
+  uint8_t key_length;
+  char key[max_key_length];
+
+  [[nodiscard]] bool empty() const { return key_length == 0; }
+
+  [[nodiscard]] bool matches(std::string_view k) const {
+    return k == std::string_view(key, key_length);
+  }
+};
+
+struct rate_limit_table::bucket {
+  // the lock has to work across processes, so it must not rely on any
+  // process local state (such as a pthread mutex without attributes).
+  // holds the pid of the process holding it, 0 if free.
+  std::atomic<uint32_t> lock;
+  entry entries[entries_per_bucket];
+
+  entry *find(std::string_view key) {
+    for (auto &e : entries) {
+      if (!e.empty() && e.matches(key))
+        return &e;
+    }
+    return nullptr;
+  }
+
+  entry &find_or_insert(std::string_view key, time_t now) {
+    if (auto *e = find(key))
+      return *e;
+
+    // reuse an empty entry, or replace the least recently updated one
+    auto &e = *std::ranges::min_element(entries, {}, [](const entry &e) {
+      return e.empty() ? time_t{0} : e.last_update + 1;
+    });
+
+    e.last_update = now;
+    e.bytes_served = 0;
+    e.pending_bytes = 0;
+    e.key_length = static_cast<uint8_t>(key.size());
+    std::memcpy(e.key, key.data(), key.size());
+    return e;
+  }
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "rate_limit_table requires lock free atomics in shared memory");
+
+class rate_limit_table::bucket_lock {
+public:
+  explicit bucket_lock(bucket &b) : m_lock(b.lock) {
+    const auto self = static_cast<uint32_t>(getpid());
+
+    for (unsigned spins = 1;; ++spins) {
+      uint32_t holder = 0;
+      if (m_lock.compare_exchange_weak(holder, self, std::memory_order_acquire))
+        return;
+
+      // the holder may have died without releasing the lock. locks are only
+      // held for a few instructions, so checking now and then is enough.
+      if (holder != 0 && spins % 1024 == 0 &&
+          !process_alive(static_cast<pid_t>(holder)) &&
+          m_lock.compare_exchange_strong(holder, self, std::memory_order_acquire))
+        return;
+
+      // std::atomic::wait may use process private futexes, hence spin instead
+      std::this_thread::yield();
+    }
+  }
+
+  ~bucket_lock() { m_lock.store(0, std::memory_order_release); }
+
+  bucket_lock(const bucket_lock &) = delete;
+  bucket_lock &operator=(const bucket_lock &) = delete;
+
+private:
+  std::atomic<uint32_t> &m_lock;
+};
+
+rate_limit_table::rate_limit_table(std::size_t entries) {
+
+  m_bucket_count = std::max<std::size_t>(1, (entries + entries_per_bucket - 1) / entries_per_bucket);
+  m_mapping_size = m_bucket_count * sizeof(bucket);
+
+  void *mapping = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error("Failed to allocate shared memory for rate limiter");
+
+  m_buckets = static_cast<bucket *>(mapping);
+  for (std::size_t i = 0; i < m_bucket_count; ++i)
+    new (&m_buckets[i]) bucket{};
+}
+
+rate_limit_table::~rate_limit_table() {
+  munmap(m_buckets, m_mapping_size);
+}
+
+std::size_t rate_limit_table::size() const {
+  return m_bucket_count * entries_per_bucket;
+}
+
+uint32_t rate_limit_table::decay(uint32_t bytes_served, time_t last_update,
+                                 time_t now, uint32_t bytes_per_sec) {
+
+  const int64_t elapsed = std::max<int64_t>(0, now - last_update);
+
+  if (elapsed * bytes_per_sec < bytes_served)
+    return bytes_served - elapsed * bytes_per_sec;
+
+  return 0;
+}
+
+rate_limit_table::bucket &rate_limit_table::bucket_for(std::string_view key) const {
+  return m_buckets[std::hash<std::string_view>{}(key) % m_bucket_count];
+}
+
+uint32_t rate_limit_table::bytes_served(std::string_view key, time_t now,
+                                        uint32_t bytes_per_sec) {
+  key = truncate_key(key);
+  auto &b = bucket_for(key);
+  bucket_lock lock(b);
+
+  const auto *e = b.find(key);
+  if (e == nullptr)
+    return 0;
+
+  return decay(e->bytes_served, e->last_update, now, bytes_per_sec);
+}
+
+void rate_limit_table::add(std::string_view key, time_t now, uint32_t bytes,
+                           uint32_t bytes_per_sec) {
+  key = truncate_key(key);
+  auto &b = bucket_for(key);
+  bucket_lock lock(b);
+
+  auto &e = b.find_or_insert(key, now);
+  e.bytes_served = decay(e.bytes_served, e.last_update, now, bytes_per_sec) + bytes;
+  e.pending_bytes += bytes;
+  e.last_update = now;
+}
+
+uint32_t rate_limit_table::take_pending(std::string_view key) {
+  key = truncate_key(key);
+  auto &b = bucket_for(key);
+  bucket_lock lock(b);
+
+  auto *e = b.find(key);
+  if (e == nullptr)
+    return 0;
+
+  return std::exchange(e->pending_bytes, 0);
+}
+
+void rate_limit_table::restore_pending(std::string_view key, uint32_t bytes) {
+  key = truncate_key(key);
+  auto &b = bucket_for(key);
+  bucket_lock lock(b);
+
+  // if the entry was replaced in the meantime, the bytes are lost, as would
+  // have been the case with the entry itself
+  if (auto *e = b.find(key))
+    e->pending_bytes += bytes;
+}
+
+void rate_limit_table::merge(std::string_view key, time_t now,
+                             uint32_t global_bytes_served,
+                             uint32_t bytes_per_sec) {
+  key = truncate_key(key);
+  auto &b = bucket_for(key);
+  bucket_lock lock(b);
+
+  auto *e = b.find(key);
+  if (e == nullptr) {
+    // no need to take up an entry for clients without any recent usage
+    if (global_bytes_served == 0)
+      return;
+    e = &b.find_or_insert(key, now);
+  }
+
+  // memcached includes the bytes reported by this host so far, the pending
+  // bytes are those served since, which haven't been reported yet.
+  e->bytes_served = global_bytes_served + e->pending_bytes;
+  e->last_update = now;
+}
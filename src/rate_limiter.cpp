@@ -10,75 +10,67 @@
 #include <fmt/core.h>
 #include <libmemcached/memcached.h>
 
+#include <chrono>
+#include <cstring>
+
 #include "cgimap/logger.hpp"
 #include "cgimap/options.hpp"
 #include "cgimap/rate_limiter.hpp"
 
+namespace {
 
-std::tuple<bool, int> null_rate_limiter::check(const std::string &, bool) {
-  return {false, 0};
-}
-
-void null_rate_limiter::update(const std::string &, uint32_t, bool) {
-}
-
-struct memcached_rate_limiter::state {
+struct state {
   time_t last_update;
   uint32_t bytes_served;
 };
 
-memcached_rate_limiter::memcached_rate_limiter(
-    const boost::program_options::variables_map &options) {
+// how often shm_rate_limiter exchanges its state with memcached
+constexpr auto reconcile_interval = std::chrono::seconds(1);
+
+// number of attempts to store an update in memcached, when other hosts
+// update the same key concurrently
+constexpr int max_cas_attempts = 3;
+
+memcached_st *create_memcached(const boost::program_options::variables_map &options) {
 
   if (!options.contains("memcache"))
-    return;
+    return nullptr;
 
-  if ((ptr = memcached_create(nullptr)) != nullptr) {
+  memcached_st *ptr = memcached_create(nullptr);
+  if (ptr == nullptr)
+    return nullptr;
 
-    memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_NO_BLOCK, 1);
-    memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 1);
-    // memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_SUPPORT_CAS, 1);
+  memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_NO_BLOCK, 1);
+  memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 1);
+  memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_SUPPORT_CAS, 1);
 
-    const auto server = options["memcache"].as<std::string>();
+  const auto server = options["memcache"].as<std::string>();
 
-    memcached_server_st * server_list = memcached_servers_parse(server.c_str());
-    memcached_server_push(ptr, server_list);
-    memcached_server_list_free(server_list);
+  memcached_server_st * server_list = memcached_servers_parse(server.c_str());
+  memcached_server_push(ptr, server_list);
+  memcached_server_list_free(server_list);
 
-    logger::message(fmt::format("memcached rate limiting enabled ({})", server));
-  }
-}
+  logger::message(fmt::format("memcached rate limiting enabled ({})", server));
 
-memcached_rate_limiter::~memcached_rate_limiter() {
-  if (ptr)
-    memcached_free(ptr);
+  return ptr;
 }
 
-std::tuple<bool, int> memcached_rate_limiter::check(const std::string &key, bool moderator) {
+// calculate number of seconds after which the memcached entry is guaranteed
+// to be irrelevant (adding a bit of headroom).
+time_t memcached_expiration(uint32_t bytes, bool moderator) {
 
-  uint32_t bytes_served = 0;
-  state *sp = nullptr;
-  size_t length = 0;
-  uint32_t flags = 0;
-  memcached_return_t error{};
+  // upper limit in memcached for relative TTL values
+  // anything bigger is considered as absolute timestamp
+  constexpr auto REALTIME_MAXDELTA = 60L*60L*24L*30L;
 
-  const auto mc_key = "cgimap:" + key;
   const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(moderator);
+  const auto relevant_bytes = std::max(global_settings::get_ratelimiter_maxdebt(moderator), bytes);
+  return std::min(REALTIME_MAXDELTA, 2L * relevant_bytes / bytes_per_sec);
+}
 
-  if (ptr &&
-      (sp = (state *)memcached_get(ptr, mc_key.data(), mc_key.size(), &length,
-                                   &flags, &error)) != nullptr) {
-    assert(length == sizeof(state));
-
-    const int64_t elapsed = time(nullptr) - sp->last_update;
-
-    if (elapsed * bytes_per_sec < sp->bytes_served) {
-      bytes_served = sp->bytes_served - elapsed * bytes_per_sec;
-    }
-
-    free(sp);
-  }
+std::tuple<bool, int> check_limit(uint32_t bytes_served, bool moderator) {
 
+  const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(moderator);
   const auto max_bytes = global_settings::get_ratelimiter_maxdebt(moderator);
   if (bytes_served < max_bytes) {
     return {false, 0};
@@ -88,64 +80,212 @@ std::tuple<bool, int> memcached_rate_limiter::check(const std::string &key, bool
   }
 }
 
-void memcached_rate_limiter::update(const std::string &key, uint32_t bytes, bool moderator) {
+} // anonymous namespace
 
-  if (!ptr)
-    return;
 
-  const auto now = time(nullptr);
+std::tuple<bool, int> null_rate_limiter::check(const std::string &, bool) {
+  return {false, 0};
+}
+
+void null_rate_limiter::update(const std::string &, uint32_t, bool) {
+}
+
+struct shm_rate_limiter::pending_update {
+  std::string key;
+  std::string mc_key;
+  bool moderator;
+  uint32_t bytes;
+};
+
+shm_rate_limiter::shm_rate_limiter(
+    rate_limit_table &table,
+    const boost::program_options::variables_map &options)
+  : table(table),
+    ptr(create_memcached(options)) {
+
+  if (ptr)
+    reconciler = std::jthread([this](std::stop_token stop) { reconcile_loop(stop); });
+}
+
+shm_rate_limiter::~shm_rate_limiter() {
+
+  if (reconciler.joinable()) {
+    reconciler.request_stop();
+    reconciler.join();
+  }
+
+  // hand over whatever this process has served so far
+  if (ptr) {
+    reconcile();
+    memcached_free(ptr);
+  }
+}
 
-  state *sp = nullptr;
-  size_t length = 0;
-  uint32_t flags = 0;
-  memcached_return_t error{};
+std::tuple<bool, int> shm_rate_limiter::check(const std::string &key, bool moderator) {
 
-  const auto mc_key = "cgimap:" + key;
   const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(moderator);
+  const auto bytes_served = table.bytes_served(key, time(nullptr), bytes_per_sec);
 
-  // upper limit in memcached for relative TTL values
-  // anything bigger is considered as absolute timestamp
-  constexpr auto REALTIME_MAXDELTA = 60L*60L*24L*30L;
+  // fetch usage on other hosts in the next reconciliation
+  mark_dirty(key, moderator);
 
-  // calculate number of seconds after which the memcached entry is guaranteed
-  // to be irrelevant (adding a bit of headroom).
-  const auto relevant_bytes = std::max(global_settings::get_ratelimiter_maxdebt(moderator), bytes);
-  const auto memcached_expiration = std::min(REALTIME_MAXDELTA, 2L * relevant_bytes / bytes_per_sec);
+  return check_limit(bytes_served, moderator);
+}
 
-retry:
+void shm_rate_limiter::update(const std::string &key, uint32_t bytes, bool moderator) {
+
+  const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(moderator);
+  table.add(key, time(nullptr), bytes, bytes_per_sec);
+
+  mark_dirty(key, moderator);
+}
+
+void shm_rate_limiter::mark_dirty(const std::string &key, bool moderator) {
 
   if (!ptr)
     return;
 
-  if ((sp = (state *)memcached_get(ptr, mc_key.data(), mc_key.size(), &length,
-                                   &flags, &error)) != nullptr) {
-    assert(length == sizeof(state));
+  std::lock_guard lock(mutex);
+  dirty_keys.try_emplace(key, moderator);
+}
+
+void shm_rate_limiter::reconcile_loop(std::stop_token stop) {
+
+  while (!stop.stop_requested()) {
+    {
+      std::unique_lock lock(mutex);
+      cv.wait_for(lock, stop, reconcile_interval, [] { return false; });
+    }
+    if (!stop.stop_requested())
+      reconcile();
+  }
+}
+
+void shm_rate_limiter::reconcile() {
+
+  std::unordered_map<std::string, bool> keys;
+  {
+    std::lock_guard lock(mutex);
+    keys.swap(dirty_keys);
+  }
+
+  if (keys.empty() || !ptr)
+    return;
+
+  std::vector<pending_update> batch;
+  batch.reserve(keys.size());
 
-    const int64_t elapsed = now - sp->last_update;
+  for (const auto &[key, moderator] : keys) {
+    batch.push_back({ .key = key,
+                      .mc_key = "cgimap:" + key,
+                      .moderator = moderator,
+                      .bytes = table.take_pending(key) });
+  }
+
+  for (int attempt = 0; attempt < max_cas_attempts && !batch.empty(); ++attempt) {
+    batch = reconcile_batch(std::move(batch));
+  }
+
+  // keep the bytes for the next reconciliation, if other hosts kept
+  // winning the race for the same key
+  for (const auto &u : batch) {
+    table.restore_pending(u.key, u.bytes);
+    mark_dirty(u.key, u.moderator);
+  }
+}
+
+/*
+ * Fetch current values for all keys in one round trip, then store the
+ * merged values using CAS. Returns the updates which lost a race against
+ * another host and need to be retried.
+ */
+std::vector<shm_rate_limiter::pending_update>
+shm_rate_limiter::reconcile_batch(std::vector<pending_update> batch) {
+
+  std::vector<const char *> mc_keys;
+  std::vector<size_t> mc_key_lengths;
+  mc_keys.reserve(batch.size());
+  mc_key_lengths.reserve(batch.size());
+
+  for (const auto &u : batch) {
+    mc_keys.push_back(u.mc_key.data());
+    mc_key_lengths.push_back(u.mc_key.size());
+  }
+
+  std::unordered_map<std::string, std::pair<state, uint64_t>> current;
 
-    sp->last_update = now;
+  memcached_return_t rc = memcached_mget(ptr, mc_keys.data(), mc_key_lengths.data(), mc_keys.size());
 
-    if (elapsed * bytes_per_sec < sp->bytes_served) {
-      sp->bytes_served = sp->bytes_served - elapsed * bytes_per_sec + bytes;
-    } else {
-      sp->bytes_served = bytes;
+  if (rc != MEMCACHED_SUCCESS) {
+    logger::message(fmt::format("Rate limiter failed to fetch state from memcached: {}",
+                                memcached_strerror(ptr, rc)));
+    for (const auto &u : batch) {
+      table.restore_pending(u.key, u.bytes);
+      mark_dirty(u.key, u.moderator);
     }
+    return {};
+  }
 
-    // should use CAS but it's a right pain so we'll wing it for now...
-    auto rc = memcached_replace(ptr, mc_key.data(), mc_key.size(), (char *)sp,
-                      sizeof(state), memcached_expiration, 0);
-    free(sp);
+  memcached_result_st result{};
+  memcached_result_create(ptr, &result);
+
+  while (memcached_fetch_result(ptr, &result, &rc) != nullptr) {
+    if (memcached_result_length(&result) != sizeof(state))
+      continue;
 
-  } else {
     state s{};
+    std::memcpy(&s, memcached_result_value(&result), sizeof(state));
+    current.try_emplace(std::string(memcached_result_key_value(&result),
+                                    memcached_result_key_length(&result)),
+                        s, memcached_result_cas(&result));
+  }
+
+  memcached_result_free(&result);
+
+  std::vector<pending_update> retry;
 
-    s.last_update = now;
-    s.bytes_served = bytes;
+  for (auto &u : batch) {
 
-    auto rc = memcached_add(ptr, mc_key.data(), mc_key.size(), (char *)&s, sizeof(state), memcached_expiration, 0);
+    const auto now = time(nullptr);
+    const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(u.moderator);
 
-    if (rc == MEMCACHED_NOTSTORED) {
-      goto retry;
+    const auto it = current.find(u.mc_key);
+    uint32_t global_bytes_served = 0;
+
+    if (it != current.end()) {
+      const auto &[s, cas] = it->second;
+      global_bytes_served = rate_limit_table::decay(s.bytes_served, s.last_update, now, bytes_per_sec);
+    }
+
+    if (u.bytes > 0) {
+      state s{ .last_update = now, .bytes_served = global_bytes_served + u.bytes };
+      const auto expiration = memcached_expiration(u.bytes, u.moderator);
+
+      if (it != current.end()) {
+        rc = memcached_cas(ptr, u.mc_key.data(), u.mc_key.size(), (char *)&s,
+                           sizeof(state), expiration, 0, it->second.second);
+      } else {
+        rc = memcached_add(ptr, u.mc_key.data(), u.mc_key.size(), (char *)&s,
+                           sizeof(state), expiration, 0);
+      }
+
+      // another host changed, created or expired the key in the meantime
+      if (rc == MEMCACHED_DATA_EXISTS || rc == MEMCACHED_NOTSTORED || rc == MEMCACHED_NOTFOUND) {
+        retry.push_back(std::move(u));
+        continue;
+      }
+
+      if (rc != MEMCACHED_SUCCESS) {
+        table.restore_pending(u.key, u.bytes);
+        mark_dirty(u.key, u.moderator);
+        continue;
+      }
+
+      global_bytes_served = s.bytes_served;
     }
+
+    table.merge(u.key, now, global_bytes_served, bytes_per_sec);
   }
+
+  return retry;
 }
@@ -0,0 +1,220 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/request_capture.hpp"
+#include "cgimap/request_helpers.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace request_capture {
+
+namespace {
+
+constexpr std::string_view magic = "CGIMAPRQ";
+
+// fixed size part of a record, after the length
+constexpr std::size_t fixed_size = 8 + 4 + 2 + 1;
+
+constexpr uint8_t flag_authenticated = 0x1;
+
+int capture_fd = -1;
+double capture_rate = 0;
+
+template <typename T>
+void put(std::string &out, T value) {
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+    out += static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+}
+
+void put_string(std::string &out, std::string_view s) {
+  s = s.substr(0, std::numeric_limits<uint16_t>::max());
+  put<uint16_t>(out, s.size());
+  out += s;
+}
+
+template <typename T>
+T get(std::string_view &in) {
+  if (in.size() < sizeof(T))
+    throw std::runtime_error("Truncated request capture record");
+  uint64_t value = 0;
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+  in.remove_prefix(sizeof(T));
+  return static_cast<T>(value);
+}
+
+std::string get_string(std::string_view &in) {
+  const auto size = get<uint16_t>(in);
+  if (in.size() < size)
+    throw std::runtime_error("Truncated request capture record");
+  std::string result(in.substr(0, size));
+  in.remove_prefix(size);
+  return result;
+}
+
+std::string param(const request &req, const char *name) {
+  const char *value = req.get_param(name);
+  return value ? value : "";
+}
+
+bool sampled() {
+  if (capture_rate >= 1.0)
+    return true;
+  thread_local std::minstd_rand gen(std::random_device{}());
+  return std::uniform_real_distribution<double>(0.0, 1.0)(gen) < capture_rate;
+}
+
+void write_all(std::string_view data) {
+  while (!data.empty()) {
+    const auto written = write(capture_fd, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    data.remove_prefix(written);
+  }
+}
+
+} // anonymous namespace
+
+void initialise(const std::string &filename, double sample_rate) {
+  if (capture_fd >= 0) {
+    close(capture_fd);
+    capture_fd = -1;
+  }
+  if (filename.empty())
+    return;
+
+  capture_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (capture_fd < 0)
+    throw std::runtime_error(fmt::format("Failed to open request capture file {}: {}",
+                                         filename, std::strerror(errno)));
+  capture_rate = std::clamp(sample_rate, 0.0, 1.0);
+
+  struct stat st{};
+  if (fstat(capture_fd, &st) == 0 && st.st_size == 0)
+    write_all(file_header());
+}
+
+bool enabled() noexcept {
+  return capture_fd >= 0;
+}
+
+void capture(const request &req, std::string_view route,
+             std::chrono::steady_clock::duration elapsed) noexcept {
+  if (!enabled())
+    return;
+
+  try {
+    if (sampled())
+      write_all(encode(make_record(req, route, elapsed)));
+  } catch (...) {
+    // capturing must never cause a request to fail
+  }
+}
+
+record make_record(const request &req, std::string_view route,
+                   std::chrono::steady_clock::duration elapsed) {
+  record r;
+  r.time = req.get_current_time();
+  r.duration = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+  r.status = static_cast<uint16_t>(req.response_status());
+  // the token itself is never captured
+  r.authenticated = req.get_param("HTTP_AUTHORIZATION") != nullptr;
+  r.method = param(req, "REQUEST_METHOD");
+  r.route = route;
+  r.path = get_request_path(req);
+  r.query = get_query_string(req);
+  r.accept = param(req, "HTTP_ACCEPT");
+  r.accept_encoding = param(req, "HTTP_ACCEPT_ENCODING");
+  r.error_format = param(req, "HTTP_X_ERROR_FORMAT");
+  return r;
+}
+
+std::string encode(const record &r) {
+  std::string body;
+  body.reserve(fixed_size + 7 * 2 + r.path.size() + r.query.size() + 64);
+
+  const auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+      r.time.time_since_epoch()).count();
+  const auto duration = std::clamp<int64_t>(r.duration.count(), 0,
+                                            std::numeric_limits<uint32_t>::max());
+  put<uint64_t>(body, time);
+  put<uint32_t>(body, duration);
+  put<uint16_t>(body, r.status);
+  put<uint8_t>(body, r.authenticated ? flag_authenticated : 0);
+  for (const auto *s : { &r.method, &r.route, &r.path, &r.query, &r.accept,
+                         &r.accept_encoding, &r.error_format })
+    put_string(body, *s);
+
+  std::string result;
+  result.reserve(4 + body.size());
+  put<uint32_t>(result, body.size());
+  result += body;
+  return result;
+}
+
+std::string file_header() {
+  std::string result(magic);
+  put<uint32_t>(result, format_version);
+  return result;
+}
+
+reader::reader(const std::string &filename)
+  : m_in(filename, std::ios::in | std::ios::binary) {
+
+  if (!m_in)
+    throw std::runtime_error(fmt::format("Failed to open request capture file {}", filename));
+
+  std::string header(magic.size() + 4, '\0');
+  m_in.read(header.data(), header.size());
+  std::string_view in(header);
+  if (!m_in || in.substr(0, magic.size()) != magic)
+    throw std::runtime_error(fmt::format("{} is not a request capture file", filename));
+  in.remove_prefix(magic.size());
+  if (const auto version = get<uint32_t>(in); version != format_version)
+    throw std::runtime_error(fmt::format("Unsupported request capture format version {}", version));
+}
+
+std::optional<record> reader::next() {
+  char length_bytes[4];
+  if (!m_in.read(length_bytes, sizeof(length_bytes)))
+    return {};
+  std::string_view length_view(length_bytes, sizeof(length_bytes));
+  const auto length = get<uint32_t>(length_view);
+
+  std::string body(length, '\0');
+  if (!m_in.read(body.data(), length))
+    return {};
+
+  std::string_view in(body);
+  record r;
+  r.time = std::chrono::system_clock::time_point(std::chrono::microseconds(get<uint64_t>(in)));
+  r.duration = std::chrono::microseconds(get<uint32_t>(in));
+  r.status = get<uint16_t>(in);
+  r.authenticated = get<uint8_t>(in) & flag_authenticated;
+  for (auto *s : { &r.method, &r.route, &r.path, &r.query, &r.accept,
+                   &r.accept_encoding, &r.error_format })
+    *s = get_string(in);
+  return r;
+}
+
+} // namespace request_capture
@@ -0,0 +1,72 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/request_memory.hpp"
+#include "cgimap/http.hpp"
+
+#include <algorithm>
+
+#include <fmt/core.h>
+
+namespace {
+
+thread_local request_memory *current_memory = nullptr;
+
+constexpr double mebibyte = 1024.0 * 1024.0;
+
+} // anonymous namespace
+
+request_memory::scope::scope(request_memory &memory) noexcept : m_previous(current_memory) {
+  current_memory = &memory;
+}
+
+request_memory::scope::~scope() {
+  current_memory = m_previous;
+}
+
+void request_memory::allocated(std::size_t bytes) noexcept {
+  auto *memory = current_memory;
+  if (!memory)
+    return;
+  memory->m_in_use += static_cast<int64_t>(bytes);
+  if (memory->m_in_use > 0)
+    memory->m_peak = std::max(memory->m_peak, static_cast<std::size_t>(memory->m_in_use));
+}
+
+void request_memory::released(std::size_t bytes) noexcept {
+  if (auto *memory = current_memory)
+    memory->m_in_use -= static_cast<int64_t>(bytes);
+}
+
+void request_memory::check() {
+  auto *memory = current_memory;
+  if (!memory || !memory->limit || memory->m_exceeded)
+    return;
+
+  if (memory->m_peak > *memory->limit) {
+    memory->m_exceeded = true;
+    throw http::payload_too_large(fmt::format(
+        "Request exceeded the memory limit of {:.0f} MB, please request fewer elements",
+        *memory->limit / mebibyte));
+  }
+}
+
+request_memory *request_memory::current() noexcept {
+  return current_memory;
+}
+
+std::size_t request_memory::in_use() const noexcept {
+  return static_cast<std::size_t>(std::max<int64_t>(m_in_use, 0));
+}
+
+std::string request_memory::summary() const {
+  if (m_peak == 0)
+    return {};
+  return fmt::format("peak_memory={:.1f}MB", m_peak / mebibyte);
+}
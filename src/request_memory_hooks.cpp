@@ -0,0 +1,52 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Replacement global operator new and delete, reporting allocations to
+ * request_memory. Only linked into the executable, not into cgimap_core,
+ * so that tests and tools keep the default allocation functions.
+ *
+ * The other forms of operator new and delete (arrays, nothrow, sized)
+ * call the ones below by default. Over-aligned allocations aren't
+ * accounted.
+ */
+
+#include "cgimap/request_memory.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+
+#include <malloc.h>
+
+void *operator new(std::size_t size) {
+  void *p = nullptr;
+  while ((p = std::malloc(size == 0 ? 1 : size)) == nullptr) {
+    auto *handler = std::get_new_handler();
+    if (handler == nullptr)
+      throw std::bad_alloc();
+    handler();
+  }
+  request_memory::allocated(malloc_usable_size(p));
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if (p == nullptr)
+    return;
+  request_memory::released(malloc_usable_size(p));
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+#endif
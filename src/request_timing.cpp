@@ -0,0 +1,117 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/request_timing.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+#include <fmt/core.h>
+
+namespace {
+
+thread_local request_timing *current_timing = nullptr;
+
+constexpr std::array<std::string_view, request_timing::phase_count> phase_names{
+  "auth", "ratelimit", "selection", "fetch", "serialize", "compress", "write"
+};
+
+double to_ms(request_timing::clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // anonymous namespace
+
+request_timing::span::span(request_timing *timing, phase p) noexcept : m_timing(timing) {
+  if (m_timing)
+    m_timing->enter(p);
+}
+
+request_timing::span::~span() {
+  if (m_timing)
+    m_timing->leave();
+}
+
+request_timing::scope::scope(request_timing &timing) : m_previous(current_timing) {
+  current_timing = &timing;
+}
+
+request_timing::scope::~scope() {
+  current_timing = m_previous;
+}
+
+request_timing::request_timing() : m_start(clock::now()), m_last(m_start) {}
+
+request_timing::span request_timing::measure(phase p) {
+  return {current_timing, p};
+}
+
+request_timing::span request_timing::measure_statement() {
+  if (current_timing && current_timing->active() == phase::serialize)
+    return {current_timing, phase::fetch};
+
+  return {nullptr, phase::fetch};
+}
+
+request_timing *request_timing::current() {
+  return current_timing;
+}
+
+request_timing::clock::duration request_timing::elapsed(phase p) const {
+  return m_elapsed[static_cast<std::size_t>(p)];
+}
+
+std::string request_timing::summary() const {
+  std::string result;
+  for (std::size_t i = 0; i < phase_count; ++i) {
+    if (!m_measured[i])
+      continue;
+    if (!result.empty())
+      result += ' ';
+    result += fmt::format("{}={:.1f}ms", phase_names[i], to_ms(m_elapsed[i]));
+  }
+  return result;
+}
+
+std::string request_timing::server_timing() const {
+  std::string result;
+  for (std::size_t i = 0; i < phase_count; ++i) {
+    if (!m_measured[i])
+      continue;
+    result += fmt::format("{};dur={:.3f}, ", phase_names[i], to_ms(m_elapsed[i]));
+  }
+  result += fmt::format("total;dur={:.3f}", to_ms(clock::now() - m_start));
+  return result;
+}
+
+void request_timing::enter(phase p) noexcept {
+  charge(clock::now());
+  if (m_depth < max_depth) {
+    m_active[m_depth] = p;
+    m_measured[static_cast<std::size_t>(p)] = true;
+  }
+  ++m_depth;
+}
+
+void request_timing::leave() noexcept {
+  charge(clock::now());
+  --m_depth;
+}
+
+void request_timing::charge(clock::time_point now) noexcept {
+  if (auto p = active())
+    m_elapsed[static_cast<std::size_t>(*p)] += now - m_last;
+  m_last = now;
+}
+
+std::optional<request_timing::phase> request_timing::active() const noexcept {
+  if (m_depth == 0)
+    return {};
+  return m_active[std::min(m_depth, max_depth) - 1];
+}
@@ -0,0 +1,401 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/shm_cache.hpp"
+#include "cgimap/metrics.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t min_slot_size = 256;
+// slot sizes double from min_slot_size up to a whole slab
+constexpr std::size_t class_count = 13;
+constexpr std::size_t max_slots_per_slab = shm_cache::slab_size / min_slot_size;
+constexpr std::size_t lock_count = 1024;
+constexpr std::size_t page_size = 4096;
+
+static_assert((min_slot_size << (class_count - 1)) == shm_cache::slab_size);
+
+constexpr std::size_t slot_size(std::size_t cls) { return min_slot_size << cls; }
+
+constexpr std::size_t slots_per_slab(std::size_t cls) {
+  return shm_cache::slab_size / slot_size(cls);
+}
+
+// the smallest size class fitting size bytes, class_count if none does
+std::size_t class_for(std::size_t size) {
+  std::size_t cls = 0;
+  while (cls < class_count && slot_size(cls) < size)
+    ++cls;
+  return cls;
+}
+
+constexpr std::size_t align(std::size_t offset, std::size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+int64_t steady_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool process_alive(pid_t pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+uint64_t hash_key(std::string_view key) {
+  return std::hash<std::string_view>{}(key);
+}
+
+} // anonymous namespace
+
+struct shm_cache::slot {
+  // free, linked into a bucket, or being filled by the process whose pid
+  // is kept in the upper bits
+  static constexpr uint64_t free = 0;
+  static constexpr uint64_t linked = 1;
+  static constexpr uint64_t filling = 2;
+
+  static uint64_t filled_by(pid_t pid) { return (static_cast<uint64_t>(pid) << 2) | filling; }
+  static bool is_filling(uint64_t state) { return (state & 3) == filling; }
+  static pid_t filler(uint64_t state) { return static_cast<pid_t>(state >> 2); }
+
+  std::atomic<uint64_t> state;
+  std::atomic<uint64_t> hash;
+  // steady clock, in nanoseconds
+  std::atomic<int64_t> expires;
+  std::atomic<uint32_t> referenced;
+  // next slot in the bucket, 0 at the end
+  slot_ref next;
+  uint32_t key_length;
+  uint32_t value_length;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+
+  [[nodiscard]] std::string_view key() { return {data(), key_length}; }
+  [[nodiscard]] std::string_view value() { return {data() + key_length, value_length}; }
+};
+
+struct shm_cache::size_class {
+  // held while assigning a slab to the class
+  std::atomic<uint32_t> lock;
+  std::atomic<uint32_t> slab_count;
+  std::atomic<uint64_t> hand;
+  std::atomic<int64_t> free_slots;
+};
+
+struct shm_cache::header {
+  std::atomic<uint32_t> next_slab;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> stores;
+  std::atomic<uint64_t> evictions;
+  std::atomic<uint64_t> expirations;
+  std::atomic<uint64_t> rejected;
+  size_class classes[class_count];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shm_cache requires lock free atomics in shared memory");
+
+class shm_cache::spin_lock {
+public:
+  explicit spin_lock(std::atomic<uint32_t> &lock) : m_lock(lock) {
+    const auto self = static_cast<uint32_t>(getpid());
+
+    for (unsigned spins = 1;; ++spins) {
+      uint32_t holder = 0;
+      if (m_lock.compare_exchange_weak(holder, self, std::memory_order_acquire))
+        return;
+
+      // the holder may have died without releasing the lock. locks are only
+      // held for a few instructions, so checking now and then is enough.
+      if (holder != 0 && spins % 1024 == 0 &&
+          !process_alive(static_cast<pid_t>(holder)) &&
+          m_lock.compare_exchange_strong(holder, self, std::memory_order_acquire))
+        return;
+
+      // std::atomic::wait may use process private futexes, hence spin instead
+      std::this_thread::yield();
+    }
+  }
+
+  ~spin_lock() { m_lock.store(0, std::memory_order_release); }
+
+  spin_lock(const spin_lock &) = delete;
+  spin_lock &operator=(const spin_lock &) = delete;
+
+private:
+  std::atomic<uint32_t> &m_lock;
+};
+
+shm_cache::shm_cache(std::size_t bytes) {
+
+  m_slab_count = std::max<std::size_t>(1, bytes / slab_size);
+  if (m_slab_count * max_slots_per_slab >= UINT32_MAX)
+    throw std::runtime_error("Shared memory cache is too large");
+
+  // about one bucket per entry of 512 bytes
+  m_bucket_count = std::max(lock_count, m_slab_count * slab_size / 512);
+
+  std::size_t offset = sizeof(header);
+  const auto class_slabs_offset = align(offset, alignof(uint32_t));
+  offset = class_slabs_offset + class_count * m_slab_count * sizeof(uint32_t);
+  const auto slab_classes_offset = offset;
+  offset = slab_classes_offset + m_slab_count;
+  const auto locks_offset = align(offset, alignof(std::atomic<uint32_t>));
+  offset = locks_offset + lock_count * sizeof(std::atomic<uint32_t>);
+  const auto buckets_offset = align(offset, alignof(slot_ref));
+  offset = buckets_offset + m_bucket_count * sizeof(slot_ref);
+  const auto slabs_offset = align(offset, page_size);
+  m_mapping_size = slabs_offset + m_slab_count * slab_size;
+
+  m_mapping = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (m_mapping == MAP_FAILED)
+    throw std::runtime_error("Failed to allocate shared memory for cache");
+
+  // the mapping is zero filled, which is all the initialisation needed
+  // apart from the header. slots are set up once their slab is assigned.
+  auto *base = static_cast<char *>(m_mapping);
+  m_header = new (base) header{};
+  m_class_slabs = reinterpret_cast<uint32_t *>(base + class_slabs_offset);
+  m_slab_classes = reinterpret_cast<uint8_t *>(base + slab_classes_offset);
+  m_locks = reinterpret_cast<std::atomic<uint32_t> *>(base + locks_offset);
+  for (std::size_t i = 0; i < lock_count; ++i)
+    new (&m_locks[i]) std::atomic<uint32_t>{0};
+  m_buckets = reinterpret_cast<slot_ref *>(base + buckets_offset);
+  m_slabs = base + slabs_offset;
+}
+
+shm_cache::~shm_cache() {
+  munmap(m_mapping, m_mapping_size);
+}
+
+std::size_t shm_cache::max_entry_size() {
+  return slab_size - sizeof(slot);
+}
+
+shm_cache::slot &shm_cache::slot_at(slot_ref ref) const {
+  const auto slab = (ref - 1) / max_slots_per_slab;
+  const auto index = (ref - 1) % max_slots_per_slab;
+  return *reinterpret_cast<slot *>(m_slabs + slab * slab_size +
+                                   index * slot_size(m_slab_classes[slab]));
+}
+
+std::size_t shm_cache::bucket_for(uint64_t hash) const {
+  return hash % m_bucket_count;
+}
+
+std::atomic<uint32_t> &shm_cache::lock_for(std::size_t bucket) const {
+  return m_locks[bucket % lock_count];
+}
+
+bool shm_cache::grow(std::size_t cls) {
+  auto &c = m_header->classes[cls];
+  spin_lock lock(c.lock);
+
+  // another process may have assigned a slab in the meantime
+  if (c.free_slots.load(std::memory_order_relaxed) > 0)
+    return true;
+
+  auto slab = m_header->next_slab.load(std::memory_order_relaxed);
+  do {
+    if (slab >= m_slab_count)
+      return false;
+  } while (!m_header->next_slab.compare_exchange_weak(slab, slab + 1, std::memory_order_relaxed));
+
+  m_slab_classes[slab] = static_cast<uint8_t>(cls);
+  for (std::size_t i = 0; i < slots_per_slab(cls); ++i)
+    new (m_slabs + slab * slab_size + i * slot_size(cls)) slot{};
+
+  const auto count = c.slab_count.load(std::memory_order_relaxed);
+  m_class_slabs[cls * m_slab_count + count] = slab;
+  c.free_slots.fetch_add(slots_per_slab(cls), std::memory_order_relaxed);
+  c.slab_count.store(count + 1, std::memory_order_release);
+  return true;
+}
+
+shm_cache::slot_ref shm_cache::claim(std::size_t cls, int64_t now) {
+  auto &c = m_header->classes[cls];
+
+  if (c.free_slots.load(std::memory_order_relaxed) <= 0)
+    grow(cls);
+
+  const auto per_slab = slots_per_slab(cls);
+  const std::size_t count = c.slab_count.load(std::memory_order_acquire) * per_slab;
+  if (count == 0)
+    return 0;
+
+  const auto self = slot::filled_by(getpid());
+
+  // within two turns of the hand, every referenced flag has been cleared
+  for (std::size_t step = 0; step < 2 * count; ++step) {
+    const auto pos = c.hand.fetch_add(1, std::memory_order_relaxed) % count;
+    const auto slab = m_class_slabs[cls * m_slab_count + pos / per_slab];
+    const slot_ref ref = slab * max_slots_per_slab + pos % per_slab + 1;
+    auto &s = slot_at(ref);
+
+    auto state = s.state.load(std::memory_order_acquire);
+
+    if (state == slot::free) {
+      if (s.state.compare_exchange_strong(state, self, std::memory_order_acq_rel)) {
+        c.free_slots.fetch_sub(1, std::memory_order_relaxed);
+        return ref;
+      }
+    } else if (slot::is_filling(state)) {
+      // left behind by an instance which died while filling it
+      if (!process_alive(slot::filler(state)) &&
+          s.state.compare_exchange_strong(state, self, std::memory_order_acq_rel))
+        return ref;
+    } else {
+      const bool expired = s.expires.load(std::memory_order_relaxed) <= now;
+      if (!expired && s.referenced.exchange(0, std::memory_order_relaxed) != 0)
+        continue;
+
+      if (unlink(ref, s)) {
+        if (expired) {
+          m_header->expirations.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          m_header->evictions.fetch_add(1, std::memory_order_relaxed);
+          metrics::count_cache_eviction("shm");
+        }
+        return ref;
+      }
+    }
+  }
+
+  return 0;
+}
+
+bool shm_cache::unlink(slot_ref ref, slot &s) {
+  const auto hash = s.hash.load(std::memory_order_relaxed);
+  const auto bucket = bucket_for(hash);
+  spin_lock lock(lock_for(bucket));
+
+  // entries are only linked and unlinked while holding the lock of their
+  // bucket, but the slot may have been reused since reading its hash
+  if (s.state.load(std::memory_order_relaxed) != slot::linked ||
+      s.hash.load(std::memory_order_relaxed) != hash)
+    return false;
+
+  for (slot_ref *link = &m_buckets[bucket]; *link != 0; link = &slot_at(*link).next) {
+    if (*link == ref) {
+      *link = s.next;
+      s.state.store(slot::filled_by(getpid()), std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<std::string> shm_cache::get(std::string_view key) {
+  const auto hash = hash_key(key);
+  const auto bucket = bucket_for(hash);
+  const auto now = steady_now();
+
+  {
+    spin_lock lock(lock_for(bucket));
+
+    for (auto ref = m_buckets[bucket]; ref != 0;) {
+      auto &s = slot_at(ref);
+      if (s.hash.load(std::memory_order_relaxed) == hash && s.key() == key) {
+        if (s.expires.load(std::memory_order_relaxed) <= now)
+          break;
+        s.referenced.store(1, std::memory_order_relaxed);
+        m_header->hits.fetch_add(1, std::memory_order_relaxed);
+        return std::string(s.value());
+      }
+      ref = s.next;
+    }
+  }
+
+  m_header->misses.fetch_add(1, std::memory_order_relaxed);
+  return {};
+}
+
+void shm_cache::put(std::string_view key, std::string_view value, std::chrono::seconds ttl) {
+  const auto cls = class_for(sizeof(slot) + key.size() + value.size());
+  const auto now = steady_now();
+
+  const auto ref = cls < class_count ? claim(cls, now) : 0;
+  if (ref == 0) {
+    m_header->rejected.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // the slot is ours until it is linked
+  const auto hash = hash_key(key);
+  auto &s = slot_at(ref);
+  s.hash.store(hash, std::memory_order_relaxed);
+  s.expires.store(now + std::chrono::duration_cast<std::chrono::nanoseconds>(ttl).count(),
+                  std::memory_order_relaxed);
+  s.referenced.store(0, std::memory_order_relaxed);
+  s.key_length = static_cast<uint32_t>(key.size());
+  s.value_length = static_cast<uint32_t>(value.size());
+  std::memcpy(s.data(), key.data(), key.size());
+  std::memcpy(s.data() + key.size(), value.data(), value.size());
+
+  const auto bucket = bucket_for(hash);
+  spin_lock lock(lock_for(bucket));
+
+  // replace any entry for the same key
+  remove(bucket, hash, key);
+
+  s.next = m_buckets[bucket];
+  m_buckets[bucket] = ref;
+  s.state.store(slot::linked, std::memory_order_release);
+  m_header->stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void shm_cache::erase(std::string_view key) {
+  const auto hash = hash_key(key);
+  const auto bucket = bucket_for(hash);
+  spin_lock lock(lock_for(bucket));
+  remove(bucket, hash, key);
+}
+
+void shm_cache::remove(std::size_t bucket, uint64_t hash, std::string_view key) {
+  for (slot_ref *link = &m_buckets[bucket]; *link != 0;) {
+    auto &s = slot_at(*link);
+    if (s.hash.load(std::memory_order_relaxed) == hash && s.key() == key) {
+      const auto slab = (*link - 1) / max_slots_per_slab;
+      *link = s.next;
+      s.state.store(slot::free, std::memory_order_release);
+      m_header->classes[m_slab_classes[slab]].free_slots.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      link = &s.next;
+    }
+  }
+}
+
+shm_cache::statistics shm_cache::stats() const {
+  statistics result;
+  result.hits = m_header->hits.load(std::memory_order_relaxed);
+  result.misses = m_header->misses.load(std::memory_order_relaxed);
+  result.stores = m_header->stores.load(std::memory_order_relaxed);
+  result.evictions = m_header->evictions.load(std::memory_order_relaxed);
+  result.expirations = m_header->expirations.load(std::memory_order_relaxed);
+  result.rejected = m_header->rejected.load(std::memory_order_relaxed);
+  result.slabs = m_slab_count;
+  result.slabs_used = std::min<std::size_t>(
+      m_header->next_slab.load(std::memory_order_relaxed), m_slab_count);
+  return result;
+}
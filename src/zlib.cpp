@@ -10,10 +10,12 @@
 #include <cassert>
 #include <algorithm>
 #include <cstring>
+#include <stdexcept>
 
 #include "cgimap/zlib.hpp"
 #include "cgimap/logger.hpp"
 #include "cgimap/output_writer.hpp"
+#include "cgimap/request_timing.hpp"
 
 zlib_output_buffer::zlib_output_buffer(output_buffer& o,
                                        zlib_output_buffer::mode m)
@@ -45,6 +47,8 @@ zlib_output_buffer::zlib_output_buffer(output_buffer& o,
 }
 
 int zlib_output_buffer::write(const char *buffer, int len) noexcept {
+  auto span = request_timing::measure(request_timing::phase::compress);
+
   assert(stream.avail_in == 0);
 
   if (len > 0) {
@@ -60,7 +64,7 @@ int zlib_output_buffer::write(const char *buffer, int len) noexcept {
     }
 
     if (status != Z_OK) {
-      logger::message("deflate failed");
+      logger::message(logger::level::error, "deflate failed");
       return -1;
     }
 
@@ -75,6 +79,7 @@ int zlib_output_buffer::write(const char *buffer, int len) noexcept {
 }
 
 int zlib_output_buffer::close() noexcept {
+  auto span = request_timing::measure(request_timing::phase::compress);
   int status = 0;
 
   assert(stream.avail_in == 0);
@@ -87,12 +92,12 @@ int zlib_output_buffer::close() noexcept {
   if (status == Z_STREAM_END) {
     out.write(outbuf, sizeof(outbuf) - stream.avail_out);
   } else {
-    logger::message("deflate failed");
+    logger::message(logger::level::error, "deflate failed");
     return -1;
   }
 
   if (deflateEnd(&stream) != Z_OK) {
-    logger::message("deflateEnd failed");
+    logger::message(logger::level::error, "deflateEnd failed");
     return -1;
   }
 
@@ -126,64 +131,55 @@ ZLibBaseDecompressor::ZLibBaseDecompressor(int windowBits) {
   if (inflateInit2(&stream, windowBits) != Z_OK) {
     throw std::bad_alloc();
   }
-  use_decompression = true;
 }
 
 ZLibBaseDecompressor::~ZLibBaseDecompressor() {
-  if (use_decompression)
-    inflateEnd(&stream);
+  inflateEnd(&stream);
 }
 
-std::string ZLibBaseDecompressor::decompress(const std::string& input) {
-
-  std::string result;
-
-  if (!use_decompression)
-    return input;
-
-  for (std::size_t offset = 0; offset < input.length(); offset += ZLIB_COMPLETE_CHUNK) {
-
-    unsigned int bytes_left = input.length() - offset;
-    unsigned int bytes_wanted = std::min(ZLIB_COMPLETE_CHUNK, bytes_left);
-
-    std::memcpy(inbuf, input.data() + offset, bytes_wanted);
-
-    stream.avail_in = bytes_wanted;
-    stream.next_in = (Bytef *) inbuf;
-
-    if (stream.avail_in == 0) {
-      break;
+void ZLibBaseDecompressor::decompress(std::string_view input, std::string& output,
+                                      std::size_t max_output) {
+
+  // any data after the end of the compressed stream is ignored
+  if (stream_end || input.empty())
+    return;
+
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = input.size();
+
+  do {
+    // never inflate beyond max_output, the remaining input is left unused
+    if (output.size() >= max_output)
+      return;
+
+    const std::size_t window = std::min<std::size_t>(
+        std::max<std::size_t>(ZLIB_COMPLETE_CHUNK, 4 * stream.avail_in),
+        max_output - output.size());
+
+    stream.next_out = reinterpret_cast<Bytef *>(grow_output(output, window));
+    stream.avail_out = window;
+
+    int ret = inflate(&stream, Z_NO_FLUSH);
+    assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+
+    // drop the unused part of the output window
+    output.resize(output.size() - stream.avail_out);
+
+    switch (ret) {
+    case Z_NEED_DICT:
+    case Z_DATA_ERROR:
+    case Z_MEM_ERROR:
+        throw std::runtime_error("Zlib decompression failed");
+    case Z_STREAM_END:
+        stream_end = true;
+        return;
+    case Z_BUF_ERROR:
+        // no progress possible, inflate needs more input
+        return;
     }
-
-    do {
-      stream.avail_out = ZLIB_COMPLETE_CHUNK;
-      stream.next_out = (Bytef *) outbuf;
-      int ret = inflate(&stream, Z_NO_FLUSH);
-      assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-      switch (ret) {
-      case Z_NEED_DICT:
-          ret = Z_DATA_ERROR;
-          [[fallthrough]];
-          /* no break */
-      case Z_DATA_ERROR:
-      case Z_MEM_ERROR:
-          inflateEnd(&stream);
-          throw std::runtime_error("Zlib decompression failed");
-      }
-
-      unsigned int have = ZLIB_COMPLETE_CHUNK - stream.avail_out;
-      result += std::string(outbuf, have);
-    } while (stream.avail_out == 0);
-  }
-  return result;
+  } while (stream.avail_in > 0 || stream.avail_out == 0);
 }
 
 GZipDecompressor::GZipDecompressor() : ZLibBaseDecompressor(15+16) { }
 
 ZLibDecompressor::ZLibDecompressor() : ZLibBaseDecompressor(15) { }
-
-IdentityDecompressor::IdentityDecompressor() : ZLibBaseDecompressor() { }
-
-
-
-
@@ -0,0 +1,814 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Upload path benchmark
+ *
+ * Generates synthetic osmChange documents and runs them through
+ * changeset_upload_responder against a freshly created test database.
+ * Reports parse time, time spent in each updater (mostly SQL), commit
+ * time and peak RSS.
+ *
+ * Run offline via pg_virtualenv, like the database tests:
+ *
+ *   pg_virtualenv ./benchmark_changeset_upload --db-schema test/structure.sql \
+ *       --nodes 5000 --modifies 1000 --tags 5 --ways 500 --way-nodes 20 \
+ *       --relations 50 --relation-members 30 --deletes 400
+ *
+ * With --contention, several workers instead upload concurrently, each
+ * through its own connection, modifying and referencing a small set of
+ * existing nodes and ways they all share. Reports version conflicts,
+ * deadlocks and the time spent waiting for row locks. Deadlocks fail the
+ * run:
+ *
+ *   pg_virtualenv ./benchmark_changeset_upload --db-schema test/structure.sql \
+ *       --contention --workers 8 --uploads 100 --existing-nodes 50
+ */
+
+#include "cgimap/api06/changeset_upload_handler.hpp"
+#include "cgimap/api06/changeset_upload/osmchange_xml_input_format.hpp"
+#include "cgimap/api06/changeset_upload/parser_callback.hpp"
+#include "cgimap/data_update.hpp"
+#include "cgimap/http.hpp"
+#include "cgimap/logger.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/request_context.hpp"
+
+#include "test_database.hpp"
+#include "test_request.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct upload_params {
+  int nodes = 1000;            // created nodes
+  int modifies = 200;          // modified existing nodes
+  int tags = 3;                // tags per created or modified node
+  int ways = 100;              // created ways
+  int way_nodes = 10;          // nodes per created way
+  int relations = 10;          // created relations
+  int relation_members = 10;   // members per created relation
+  int deletes = 100;           // deleted existing nodes, half of them with if-unused
+  int iterations = 5;
+};
+
+struct contention_params {
+  int workers = 4;
+  int uploads = 50;           // uploads per worker
+  int existing_nodes = 100;   // existing nodes shared by all workers
+  int existing_ways = 20;     // existing ways shared by all workers
+  int node_modifies = 10;     // existing nodes modified per upload
+  int way_modifies = 2;       // existing ways modified per upload
+  int references = 10;        // existing nodes referenced by each created or modified way
+  double lock_wait_ms = 1.0;  // uploads locking for longer count as waiting
+  unsigned int seed = 42;
+};
+
+struct phase_timings {
+  clock_type::duration parse{};
+  clock_type::duration changeset{};
+  clock_type::duration node{};
+  clock_type::duration way{};
+  clock_type::duration relation{};
+  clock_type::duration commit{};
+  clock_type::duration total{};
+  clock_type::duration lock{};    // also included in node, way and relation
+};
+
+class scoped_timer {
+public:
+  explicit scoped_timer(clock_type::duration &d) : m_d(d), m_start(clock_type::now()) {}
+  ~scoped_timer() { m_d += clock_type::now() - m_start; }
+
+  scoped_timer(const scoped_timer &) = delete;
+  scoped_timer &operator=(const scoped_timer &) = delete;
+
+private:
+  clock_type::duration &m_d;
+  clock_type::time_point m_start;
+};
+
+// Layout of the existing data: nodes 1..modifies are modified, the following
+// nodes are deleted. Every other node in the if-unused half is still part of
+// way 1, so that its deletion gets skipped.
+osm_nwr_id_t first_deleted_node(const upload_params &p) { return p.modifies + 1; }
+
+osm_nwr_id_t first_if_unused_node(const upload_params &p) {
+  return first_deleted_node(p) + p.deletes / 2;
+}
+
+osm_nwr_id_t num_existing_nodes(const upload_params &p) {
+  return p.modifies + p.deletes;
+}
+
+std::string tags_xml(int count, int seed) {
+  std::string result;
+  for (int i = 0; i < count; ++i)
+    result += fmt::format(R"(<tag k="key_{}" v="value_{}"/>)", i, seed);
+  return result;
+}
+
+std::string generate_osmchange(const upload_params &p, osm_changeset_id_t changeset) {
+
+  std::string s = R"(<?xml version="1.0" encoding="UTF-8"?><osmChange version="0.6" generator="benchmark">)";
+
+  s += "<create>";
+
+  for (int i = 1; i <= p.nodes; ++i)
+    s += fmt::format(R"(<node id="{}" lat="{:.7f}" lon="{:.7f}" changeset="{}">{}</node>)",
+                     -i, 45.0 + (i % 1000) * 0.0001, 10.0 + (i / 1000) * 0.0001,
+                     changeset, tags_xml(p.tags, i));
+
+  for (int i = 1; i <= p.ways; ++i) {
+    s += fmt::format(R"(<way id="{}" changeset="{}">)", -i, changeset);
+    for (int n = 0; n < p.way_nodes; ++n) {
+      // placeholder nodes if available, existing modified nodes otherwise
+      if (p.nodes > 0)
+        s += fmt::format(R"(<nd ref="{}"/>)", -(1 + (i * p.way_nodes + n) % p.nodes));
+      else
+        s += fmt::format(R"(<nd ref="{}"/>)", 1 + (i * p.way_nodes + n) % std::max(p.modifies, 1));
+    }
+    s += R"(<tag k="highway" v="residential"/></way>)";
+  }
+
+  for (int i = 1; i <= p.relations; ++i) {
+    s += fmt::format(R"(<relation id="{}" changeset="{}">)", -i, changeset);
+    for (int m = 0; m < p.relation_members; ++m) {
+      if (m % 2 == 1 && p.ways > 0)
+        s += fmt::format(R"(<member type="way" ref="{}" role="outer"/>)", -(1 + (i + m) % p.ways));
+      else if (p.nodes > 0)
+        s += fmt::format(R"(<member type="node" ref="{}" role=""/>)", -(1 + (i + m) % p.nodes));
+    }
+    s += R"(<tag k="type" v="multipolygon"/></relation>)";
+  }
+
+  s += "</create><modify>";
+
+  for (int i = 1; i <= p.modifies; ++i)
+    s += fmt::format(R"(<node id="{}" lat="46" lon="11" version="1" changeset="{}">{}</node>)",
+                     i, changeset, tags_xml(p.tags, -i));
+
+  s += "</modify><delete>";
+
+  for (auto id = first_deleted_node(p); id < first_if_unused_node(p); ++id)
+    s += fmt::format(R"(<node id="{}" version="1" changeset="{}"/>)", id, changeset);
+
+  s += R"(</delete><delete if-unused="true">)";
+
+  for (auto id = first_if_unused_node(p); id <= num_existing_nodes(p); ++id)
+    s += fmt::format(R"(<node id="{}" version="1" changeset="{}"/>)", id, changeset);
+
+  s += "</delete></osmChange>";
+
+  return s;
+}
+
+void seed_database(test_database &tdb, const upload_params &p, osm_changeset_id_t changeset) {
+
+  tdb.testcase_starting();
+
+  tdb.run_sql(fmt::format(R"(
+      INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+      VALUES (1, 'user_1@example.com', '', '2013-11-14T02:10:00Z', 'user_1', true);
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at)
+      VALUES (1, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 hour' ::interval),
+             ({0}, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 hour' ::interval);
+
+      INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+      SELECT g, 450000000, 100000000, 1, true, now() at time zone 'utc', 3221225472, 1
+      FROM generate_series(1, {1}) AS g;
+
+      INSERT INTO current_ways (id, changeset_id, "timestamp", visible, version)
+      VALUES (1, 1, now() at time zone 'utc', true, 1);
+
+      INSERT INTO current_way_nodes (way_id, node_id, sequence_id)
+      SELECT 1, g, row_number() OVER ()
+      FROM generate_series({2}, {1}, 2) AS g;
+
+      SELECT setval('current_nodes_id_seq', {1} + 1, false);
+      SELECT setval('current_ways_id_seq', 2, false);
+      SELECT setval('current_relations_id_seq', 1, false);
+    )", changeset, num_existing_nodes(p), first_if_unused_node(p)));
+}
+
+// parser callback which doesn't do anything, to measure parsing on its own
+class null_callback : public api06::Parser_Callback {
+public:
+  void start_document() override {}
+  void end_document() override {}
+  void process_node(const api06::Node &, operation, bool) override {}
+  void process_way(const api06::Way &, operation, bool) override {}
+  void process_relation(const api06::Relation &, operation, bool) override {}
+};
+
+/*
+ * Decorators measuring the time spent in each updater. Apart from add_*,
+ * modify_* and delete_* which only fill buffers, this is database time.
+ */
+
+class timed_node_updater : public api06::Node_Updater {
+public:
+  timed_node_updater(std::unique_ptr<api06::Node_Updater> u, clock_type::duration &d,
+                     clock_type::duration &lock)
+    : u(std::move(u)), d(d), lock(lock) {}
+
+  void add_node(double lat, double lon, osm_changeset_id_t cs, osm_nwr_signed_id_t old_id,
+                const api06::TagList &tags) override {
+    scoped_timer t(d); u->add_node(lat, lon, cs, old_id, tags);
+  }
+  void modify_node(double lat, double lon, osm_changeset_id_t cs, osm_nwr_id_t id,
+                   osm_version_t version, const api06::TagList &tags) override {
+    scoped_timer t(d); u->modify_node(lat, lon, cs, id, version, tags);
+  }
+  void delete_node(osm_changeset_id_t cs, osm_nwr_id_t id, osm_version_t version,
+                   bool if_unused) override {
+    scoped_timer t(d); u->delete_node(cs, id, version, if_unused);
+  }
+  void lock_nodes(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                  const std::vector<osm_nwr_id_t> &shared_ids) override {
+    scoped_timer t(d), l(lock); u->lock_nodes(exclusive_ids, shared_ids);
+  }
+  void process_new_nodes() override { scoped_timer t(d); u->process_new_nodes(); }
+  void process_modify_nodes() override { scoped_timer t(d); u->process_modify_nodes(); }
+  void process_delete_nodes() override { scoped_timer t(d); u->process_delete_nodes(); }
+  uint32_t get_num_changes() const override { return u->get_num_changes(); }
+  bbox_t bbox() const override { return u->bbox(); }
+
+private:
+  std::unique_ptr<api06::Node_Updater> u;
+  clock_type::duration &d;
+  clock_type::duration &lock;
+};
+
+class timed_way_updater : public api06::Way_Updater {
+public:
+  timed_way_updater(std::unique_ptr<api06::Way_Updater> u, clock_type::duration &d,
+                    clock_type::duration &lock)
+    : u(std::move(u)), d(d), lock(lock) {}
+
+  void add_way(osm_changeset_id_t cs, osm_nwr_signed_id_t old_id,
+               const api06::WayNodeList &nodes, const api06::TagList &tags) override {
+    scoped_timer t(d); u->add_way(cs, old_id, nodes, tags);
+  }
+  void modify_way(osm_changeset_id_t cs, osm_nwr_id_t id, osm_version_t version,
+                  const api06::WayNodeList &nodes, const api06::TagList &tags) override {
+    scoped_timer t(d); u->modify_way(cs, id, version, nodes, tags);
+  }
+  void delete_way(osm_changeset_id_t cs, osm_nwr_id_t id, osm_version_t version,
+                  bool if_unused) override {
+    scoped_timer t(d); u->delete_way(cs, id, version, if_unused);
+  }
+  void lock_ways(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                 const std::vector<osm_nwr_id_t> &shared_ids) override {
+    scoped_timer t(d), l(lock); u->lock_ways(exclusive_ids, shared_ids);
+  }
+  void process_new_ways() override { scoped_timer t(d); u->process_new_ways(); }
+  void process_modify_ways() override { scoped_timer t(d); u->process_modify_ways(); }
+  void process_delete_ways() override { scoped_timer t(d); u->process_delete_ways(); }
+  uint32_t get_num_changes() const override { return u->get_num_changes(); }
+  bbox_t bbox() const override { return u->bbox(); }
+
+private:
+  std::unique_ptr<api06::Way_Updater> u;
+  clock_type::duration &d;
+  clock_type::duration &lock;
+};
+
+class timed_relation_updater : public api06::Relation_Updater {
+public:
+  timed_relation_updater(std::unique_ptr<api06::Relation_Updater> u, clock_type::duration &d,
+                         clock_type::duration &lock)
+    : u(std::move(u)), d(d), lock(lock) {}
+
+  void add_relation(osm_changeset_id_t cs, osm_nwr_signed_id_t old_id,
+                    const api06::RelationMemberList &members,
+                    const api06::TagList &tags) override {
+    scoped_timer t(d); u->add_relation(cs, old_id, members, tags);
+  }
+  void modify_relation(osm_changeset_id_t cs, osm_nwr_id_t id, osm_version_t version,
+                       const api06::RelationMemberList &members,
+                       const api06::TagList &tags) override {
+    scoped_timer t(d); u->modify_relation(cs, id, version, members, tags);
+  }
+  void delete_relation(osm_changeset_id_t cs, osm_nwr_id_t id, osm_version_t version,
+                       bool if_unused) override {
+    scoped_timer t(d); u->delete_relation(cs, id, version, if_unused);
+  }
+  void lock_relations(const std::vector<osm_nwr_id_t> &exclusive_ids,
+                      const std::vector<osm_nwr_id_t> &shared_ids) override {
+    scoped_timer t(d), l(lock); u->lock_relations(exclusive_ids, shared_ids);
+  }
+  void process_new_relations() override { scoped_timer t(d); u->process_new_relations(); }
+  void process_modify_relations() override { scoped_timer t(d); u->process_modify_relations(); }
+  void process_delete_relations() override { scoped_timer t(d); u->process_delete_relations(); }
+  uint32_t get_num_changes() const override { return u->get_num_changes(); }
+  bbox_t bbox() const override { return u->bbox(); }
+
+private:
+  std::unique_ptr<api06::Relation_Updater> u;
+  clock_type::duration &d;
+  clock_type::duration &lock;
+};
+
+class timed_changeset_updater : public api06::Changeset_Updater {
+public:
+  timed_changeset_updater(std::unique_ptr<api06::Changeset_Updater> u, clock_type::duration &d)
+    : u(std::move(u)), d(d) {}
+
+  void lock_current_changeset(bool check_max_elements_limit) override {
+    scoped_timer t(d); u->lock_current_changeset(check_max_elements_limit);
+  }
+  void update_changeset(uint32_t num_new_changes, bbox_t bbox) override {
+    scoped_timer t(d); u->update_changeset(num_new_changes, bbox);
+  }
+  bbox_t get_bbox() const override { return u->get_bbox(); }
+  osm_changeset_id_t api_create_changeset(const std::map<std::string, std::string> &tags) override {
+    return u->api_create_changeset(tags);
+  }
+  void api_update_changeset(const std::map<std::string, std::string> &tags) override {
+    u->api_update_changeset(tags);
+  }
+  void api_close_changeset() override { u->api_close_changeset(); }
+
+private:
+  std::unique_ptr<api06::Changeset_Updater> u;
+  clock_type::duration &d;
+};
+
+class timed_data_update : public data_update {
+public:
+  timed_data_update(std::unique_ptr<data_update> u, phase_timings &t)
+    : u(std::move(u)), t(t) {}
+
+  std::unique_ptr<api06::Changeset_Updater>
+  get_changeset_updater(const RequestContext &ctx, osm_changeset_id_t changeset) override {
+    return std::make_unique<timed_changeset_updater>(u->get_changeset_updater(ctx, changeset), t.changeset);
+  }
+
+  std::unique_ptr<api06::Node_Updater>
+  get_node_updater(const RequestContext &ctx, api06::OSMChange_Tracking &ct) override {
+    return std::make_unique<timed_node_updater>(u->get_node_updater(ctx, ct), t.node, t.lock);
+  }
+
+  std::unique_ptr<api06::Way_Updater>
+  get_way_updater(const RequestContext &ctx, api06::OSMChange_Tracking &ct) override {
+    return std::make_unique<timed_way_updater>(u->get_way_updater(ctx, ct), t.way, t.lock);
+  }
+
+  std::unique_ptr<api06::Relation_Updater>
+  get_relation_updater(const RequestContext &ctx, api06::OSMChange_Tracking &ct) override {
+    return std::make_unique<timed_relation_updater>(u->get_relation_updater(ctx, ct), t.relation, t.lock);
+  }
+
+  void notify_changes(const cache_invalidation::changes &changes) override {
+    u->notify_changes(changes);
+  }
+
+  void commit() override {
+    scoped_timer timer(t.commit);
+    u->commit();
+  }
+
+  bool is_api_write_disabled() const override { return u->is_api_write_disabled(); }
+
+  uint32_t get_rate_limit(osm_user_id_t uid) override { return u->get_rate_limit(uid); }
+
+  uint64_t get_bbox_size_limit(osm_user_id_t uid) override { return u->get_bbox_size_limit(uid); }
+
+private:
+  std::unique_ptr<data_update> u;
+  phase_timings &t;
+};
+
+class benchmark_settings : public global_settings_default {
+public:
+  // synthetic uploads may exceed the default changeset limit
+  uint32_t get_changeset_max_elements() const override { return 1000000; }
+};
+
+double ms(clock_type::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+long peak_rss_kb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void print_row(const std::string &label, const phase_timings &t) {
+  std::cout << fmt::format("{:<10} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f}\n",
+                           label, ms(t.parse), ms(t.changeset), ms(t.node), ms(t.way),
+                           ms(t.relation), ms(t.commit), ms(t.total));
+}
+
+phase_timings run_upload(test_database &tdb, const upload_params &p, const std::string &payload,
+                         osm_changeset_id_t changeset) {
+
+  phase_timings t;
+
+  {
+    null_callback cb;
+    scoped_timer timer(t.parse);
+    api06::OSMChangeXMLParser(cb).process_message(payload);
+  }
+
+  seed_database(tdb, p, changeset);
+
+  test_request req{};
+  UserInfo user{ .id = 1 };
+  RequestContext ctx{ .req = req, .user = user };
+
+  auto factory = tdb.get_data_update_factory();
+  auto txn = factory->get_default_transaction();
+  timed_data_update upd(factory->make_data_update(*txn), t);
+
+  {
+    scoped_timer timer(t.total);
+    api06::changeset_upload_responder responder(mime::type::application_xml, upd, changeset, payload, ctx);
+  }
+
+  tdb.testcase_ended();
+
+  return t;
+}
+
+
+/*
+ * Contention mode
+ */
+
+// nodes per existing way
+constexpr int existing_way_length = 10;
+
+void seed_contention_database(test_database &tdb, const contention_params &p) {
+
+  tdb.testcase_starting();
+
+  // one open changeset per worker, from 2 onwards
+  tdb.run_sql(fmt::format(R"(
+      INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+      VALUES (1, 'user_1@example.com', '', '2013-11-14T02:10:00Z', 'user_1', true);
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at)
+      SELECT g, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 day' ::interval
+      FROM generate_series(1, {0} + 1) AS g;
+
+      INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+      SELECT g, 450000000, 100000000, 1, true, now() at time zone 'utc', 3221225472, 1
+      FROM generate_series(1, {1}) AS g;
+
+      INSERT INTO current_ways (id, changeset_id, "timestamp", visible, version)
+      SELECT g, 1, now() at time zone 'utc', true, 1
+      FROM generate_series(1, {2}) AS g;
+
+      INSERT INTO current_way_nodes (way_id, node_id, sequence_id)
+      SELECT w, ((w - 1) * {3} + s - 1) % {1} + 1, s
+      FROM generate_series(1, {2}) AS w, generate_series(1, {3}) AS s;
+
+      SELECT setval('current_nodes_id_seq', {1} + 1, false);
+      SELECT setval('current_ways_id_seq', {2} + 1, false);
+      SELECT setval('current_relations_id_seq', 1, false);
+    )", p.workers, p.existing_nodes, p.existing_ways, existing_way_length));
+}
+
+/*
+ * Current versions of the existing elements. All writers are part of this
+ * process, so that a successful upload knows the versions it created.
+ * Versions read here may still be outdated by the time an upload gets to
+ * its locks, which then fails with a version conflict.
+ */
+class shared_versions {
+public:
+  explicit shared_versions(const contention_params &p)
+    : m_nodes(p.existing_nodes + 1, 1), m_ways(p.existing_ways + 1, 1) {}
+
+  osm_version_t node(osm_nwr_id_t id) const { std::scoped_lock l(m_mutex); return m_nodes[id]; }
+  osm_version_t way(osm_nwr_id_t id) const { std::scoped_lock l(m_mutex); return m_ways[id]; }
+
+  void committed(const std::vector<std::pair<osm_nwr_id_t, osm_version_t>> &nodes,
+                 const std::vector<std::pair<osm_nwr_id_t, osm_version_t>> &ways) {
+    std::scoped_lock l(m_mutex);
+    for (const auto &[id, version] : nodes)
+      m_nodes[id] = version + 1;
+    for (const auto &[id, version] : ways)
+      m_ways[id] = version + 1;
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::vector<osm_version_t> m_nodes;
+  std::vector<osm_version_t> m_ways;
+};
+
+struct planned_upload {
+  std::string payload;
+  std::vector<std::pair<osm_nwr_id_t, osm_version_t>> nodes;  // modified, with their old version
+  std::vector<std::pair<osm_nwr_id_t, osm_version_t>> ways;
+};
+
+std::vector<osm_nwr_id_t> random_ids(std::mt19937 &gen, int max, int count) {
+  std::vector<osm_nwr_id_t> all(max);
+  std::iota(all.begin(), all.end(), 1);
+  std::vector<osm_nwr_id_t> ids;
+  std::sample(all.begin(), all.end(), std::back_inserter(ids), count, gen);
+  // uploads list their changes in random order, the locks are still
+  // acquired in id order
+  std::ranges::shuffle(ids, gen);
+  return ids;
+}
+
+// modifies existing nodes and ways, and creates a way, all of the ways
+// referencing existing nodes
+planned_upload plan_upload(const contention_params &p, std::mt19937 &gen,
+                           const shared_versions &versions, osm_changeset_id_t changeset) {
+
+  planned_upload u;
+
+  const auto way_nodes = [&] {
+    std::string s;
+    for (auto id : random_ids(gen, p.existing_nodes, p.references))
+      s += fmt::format(R"(<nd ref="{}"/>)", id);
+    return s;
+  };
+
+  u.payload = R"(<?xml version="1.0" encoding="UTF-8"?><osmChange version="0.6" generator="benchmark"><modify>)";
+
+  for (auto id : random_ids(gen, p.existing_nodes, p.node_modifies)) {
+    u.nodes.emplace_back(id, versions.node(id));
+    u.payload += fmt::format(R"(<node id="{}" lat="46" lon="11" version="{}" changeset="{}"/>)",
+                             id, u.nodes.back().second, changeset);
+  }
+
+  for (auto id : random_ids(gen, p.existing_ways, p.way_modifies)) {
+    u.ways.emplace_back(id, versions.way(id));
+    u.payload += fmt::format(R"(<way id="{}" version="{}" changeset="{}">{}</way>)",
+                             id, u.ways.back().second, changeset, way_nodes());
+  }
+
+  u.payload += fmt::format(R"(</modify><create><way id="-1" changeset="{}">{}</way></create></osmChange>)",
+                           changeset, way_nodes());
+  return u;
+}
+
+enum class upload_outcome { committed, version_conflict, deadlock, error };
+
+struct upload_result {
+  upload_outcome outcome;
+  clock_type::duration lock;
+  clock_type::duration total;
+};
+
+upload_result run_contended_upload(data_update::factory &factory, const std::string &payload,
+                                   osm_changeset_id_t changeset) {
+
+  phase_timings t;
+  upload_outcome outcome = upload_outcome::committed;
+
+  try {
+    test_request req{};
+    UserInfo user{ .id = 1 };
+    RequestContext ctx{ .req = req, .user = user };
+
+    auto txn = factory.get_default_transaction();
+    timed_data_update upd(factory.make_data_update(*txn), t);
+
+    scoped_timer timer(t.total);
+    api06::changeset_upload_responder responder(mime::type::application_xml, upd, changeset, payload, ctx);
+
+  } catch (const http::conflict &) {
+    outcome = upload_outcome::version_conflict;
+
+  } catch (const pqxx::deadlock_detected &) {
+    outcome = upload_outcome::deadlock;
+
+  } catch (const std::exception &e) {
+    std::cerr << "Upload failed: " << e.what() << '\n';
+    outcome = upload_outcome::error;
+  }
+
+  return { outcome, t.lock, t.total };
+}
+
+int run_contention(test_database &tdb, const contention_params &p) {
+
+  seed_contention_database(tdb, p);
+
+  shared_versions versions(p);
+  std::vector<std::vector<upload_result>> results(p.workers);
+
+  const auto start = clock_type::now();
+  {
+    std::vector<std::jthread> workers;
+    for (int w = 0; w < p.workers; ++w) {
+      workers.emplace_back([&, w] {
+        try {
+          auto factory = tdb.get_new_data_update_factory();
+          std::mt19937 gen(p.seed + w);
+          const osm_changeset_id_t changeset = 2 + w;
+
+          for (int i = 0; i < p.uploads; ++i) {
+            const auto upload = plan_upload(p, gen, versions, changeset);
+            results[w].push_back(run_contended_upload(*factory, upload.payload, changeset));
+            if (results[w].back().outcome == upload_outcome::committed)
+              versions.committed(upload.nodes, upload.ways);
+          }
+        } catch (const std::exception &e) {
+          std::cerr << fmt::format("Worker {} failed: {}\n", w, e.what());
+        }
+      });
+    }
+  }
+  const auto elapsed = clock_type::now() - start;
+
+  std::map<upload_outcome, int> outcomes;
+  std::vector<double> lock_ms;
+  int lock_waits = 0;
+  for (const auto &worker : results) {
+    for (const auto &r : worker) {
+      ++outcomes[r.outcome];
+      lock_ms.push_back(ms(r.lock));
+      if (ms(r.lock) > p.lock_wait_ms)
+        ++lock_waits;
+    }
+  }
+  std::ranges::sort(lock_ms);
+
+  const auto percentile = [&lock_ms](double q) {
+    if (lock_ms.empty())
+      return 0.0;
+    return lock_ms[std::min(static_cast<std::size_t>(std::ceil(q * lock_ms.size())), lock_ms.size()) - 1];
+  };
+
+  std::cout << fmt::format("{} workers, {} uploads each, {} shared nodes, {} shared ways\n",
+                           p.workers, p.uploads, p.existing_nodes, p.existing_ways);
+  std::cout << fmt::format("{} uploads in {:.1f} s, {:.1f} uploads/s\n", lock_ms.size(),
+                           ms(elapsed) / 1000, lock_ms.size() / std::chrono::duration<double>(elapsed).count());
+  std::cout << fmt::format("committed: {}, version conflicts: {}, deadlocks: {}, errors: {}\n",
+                           outcomes[upload_outcome::committed], outcomes[upload_outcome::version_conflict],
+                           outcomes[upload_outcome::deadlock], outcomes[upload_outcome::error]);
+  std::cout << fmt::format("lock waits: {} uploads took longer than {:.1f} ms to lock their rows\n",
+                           lock_waits, p.lock_wait_ms);
+  std::cout << fmt::format("lock time [ms]: p50 {:.2f}, p99 {:.2f}, max {:.2f}\n",
+                           percentile(0.5), percentile(0.99), lock_ms.empty() ? 0.0 : lock_ms.back());
+
+  if (outcomes[upload_outcome::deadlock] > 0) {
+    std::cerr << fmt::format("Error: {} uploads were aborted by deadlocks\n",
+                             outcomes[upload_outcome::deadlock]);
+    return EXIT_FAILURE;
+  }
+
+  if (outcomes[upload_outcome::error] > 0 || lock_ms.size() != static_cast<std::size_t>(p.workers * p.uploads))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+  upload_params p;
+  std::string db_schema = "test/structure.sql";
+
+  po::options_description desc("Upload benchmark options");
+  desc.add_options()
+    ("help", "show this help")
+    ("db-schema", po::value(&db_schema), "test database schema file")
+    ("nodes", po::value(&p.nodes), "created nodes")
+    ("modifies", po::value(&p.modifies), "modified existing nodes")
+    ("tags", po::value(&p.tags), "tags per created or modified node")
+    ("ways", po::value(&p.ways), "created ways")
+    ("way-nodes", po::value(&p.way_nodes), "nodes per created way")
+    ("relations", po::value(&p.relations), "created relations")
+    ("relation-members", po::value(&p.relation_members), "members per created relation")
+    ("deletes", po::value(&p.deletes), "deleted existing nodes, half of them with if-unused")
+    ("iterations", po::value(&p.iterations), "number of measured uploads");
+
+  contention_params cp;
+
+  po::options_description contention("Contention mode options");
+  contention.add_options()
+    ("contention", "upload concurrently, modifying overlapping existing nodes and ways")
+    ("workers", po::value(&cp.workers), "concurrently uploading workers")
+    ("uploads", po::value(&cp.uploads), "uploads per worker")
+    ("existing-nodes", po::value(&cp.existing_nodes), "existing nodes shared by all workers")
+    ("existing-ways", po::value(&cp.existing_ways), "existing ways shared by all workers")
+    ("node-modifies", po::value(&cp.node_modifies), "existing nodes modified per upload")
+    ("way-modifies", po::value(&cp.way_modifies), "existing ways modified per upload")
+    ("references", po::value(&cp.references), "existing nodes referenced by each created or modified way")
+    ("lock-wait-ms", po::value(&cp.lock_wait_ms), "uploads locking for longer than this count as lock waits")
+    ("seed", po::value(&cp.seed), "random seed");
+  desc.add(contention);
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.contains("help")) {
+    std::cout << desc << '\n';
+    return EXIT_SUCCESS;
+  }
+
+  if (vm.contains("contention") &&
+      (cp.workers < 1 || cp.uploads < 1 || cp.references < 1 ||
+       cp.existing_nodes < 1 || cp.existing_ways < 1 ||
+       std::max(cp.node_modifies, cp.references) > cp.existing_nodes ||
+       cp.way_modifies > cp.existing_ways)) {
+    std::cerr << "Error: --workers, --uploads, --references and the number of existing elements "
+                 "must be at least 1, and no less than the elements modified or referenced per upload\n";
+    return EXIT_FAILURE;
+  }
+
+  global_settings::set_configuration(std::make_unique<benchmark_settings>());
+
+  try {
+    test_database tdb;
+    tdb.setup(db_schema);
+
+    // keep per statement logging out of the measurements
+    logger::initialise("/dev/null");
+
+    if (vm.contains("contention"))
+      return run_contention(tdb, cp);
+
+    const osm_changeset_id_t changeset = 2;
+    const auto payload = generate_osmchange(p, changeset);
+    const auto rss_before = peak_rss_kb();
+
+    std::cout << fmt::format("payload: {} bytes, {} elements\n", payload.size(),
+                             p.nodes + p.modifies + p.ways + p.relations + p.deletes);
+    std::cout << fmt::format("{:<10} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9}\n", "run [ms]",
+                             "parse", "changeset", "node", "way", "relation", "commit", "total");
+
+    phase_timings sum;
+
+    for (int i = 0; i <= p.iterations; ++i) {
+      auto t = run_upload(tdb, p, payload, changeset);
+
+      // first run warms up connection and prepared statements
+      if (i == 0) {
+        print_row("warmup", t);
+        continue;
+      }
+
+      print_row(fmt::format("#{}", i), t);
+
+      sum.parse += t.parse;
+      sum.changeset += t.changeset;
+      sum.node += t.node;
+      sum.way += t.way;
+      sum.relation += t.relation;
+      sum.commit += t.commit;
+      sum.total += t.total;
+    }
+
+    if (p.iterations > 0) {
+      const auto n = p.iterations;
+      print_row("mean", { sum.parse / n, sum.changeset / n, sum.node / n, sum.way / n,
+                          sum.relation / n, sum.commit / n, sum.total / n });
+    }
+
+    std::cout << fmt::format("peak RSS: {} kB (before uploads: {} kB)\n", peak_rss_kb(), rss_before);
+
+  } catch (const test_database::setup_error &e) {
+    std::cerr << "Unable to set up test database: " << e.what() << '\n';
+    return EXIT_FAILURE;
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,380 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Microbenchmarks for parsing and formatting primitives on the hot path
+ * of read requests.
+ *
+ * Not part of the test suite. Run via "make benchmark", which writes the
+ * results to benchmark_primitives.json, or directly, e.g.:
+ *
+ *   ./benchmark_primitives "[http]" --reporter benchmark-json::out=http.json
+ */
+
+#include "cgimap/backend/apidb/quad_tile.hpp"
+#include "cgimap/backend/apidb/utils.hpp"
+#include "cgimap/choose_formatter.hpp"
+#include "cgimap/http.hpp"
+#include "cgimap/json_formatter.hpp"
+#include "cgimap/output_buffer.hpp"
+#include "cgimap/routes.hpp"
+#include "cgimap/xml_formatter.hpp"
+
+#ifdef HAVE_LIBZ
+#include "cgimap/zlib.hpp"
+#endif
+
+#if HAVE_BROTLI
+#include "cgimap/brotli.hpp"
+#endif
+
+#include "test_request.hpp"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_case_info.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+#include <catch2/reporters/catch_reporter_streaming_base.hpp>
+
+namespace {
+
+/**
+ * Catch2's own JSON reporter doesn't include benchmark results. This one
+ * only reports benchmarks, in a format which is easy to compare across
+ * releases: one entry per benchmark, with all durations in nanoseconds.
+ */
+class benchmark_json_reporter : public Catch::StreamingReporterBase {
+public:
+  using StreamingReporterBase::StreamingReporterBase;
+
+  static std::string getDescription() {
+    return "Reports benchmark results as JSON";
+  }
+
+  void testCaseStarting(const Catch::TestCaseInfo &info) override {
+    StreamingReporterBase::testCaseStarting(info);
+    m_test_case = info.name;
+  }
+
+  void benchmarkEnded(const Catch::BenchmarkStats<> &stats) override {
+    m_results.push_back(fmt::format(
+        R"(    {{"test_case": "{}", "name": "{}", "samples": {}, "iterations": {}, )"
+        R"("mean": {:.3f}, "mean_lower": {:.3f}, "mean_upper": {:.3f}, "std_dev": {:.3f}}})",
+        escape(m_test_case), escape(stats.info.name), stats.info.samples,
+        stats.info.iterations, stats.mean.point.count(),
+        stats.mean.lower_bound.count(), stats.mean.upper_bound.count(),
+        stats.standardDeviation.point.count()));
+  }
+
+  void testRunEnded(const Catch::TestRunStats &stats) override {
+    StreamingReporterBase::testRunEnded(stats);
+
+    m_stream << "{\n"
+             << R"(  "version": ")" << PACKAGE_VERSION << "\",\n"
+             << R"(  "unit": "ns",)" << '\n'
+             << R"(  "benchmarks": [)" << '\n';
+    for (std::size_t i = 0; i < m_results.size(); ++i)
+      m_stream << m_results[i] << (i + 1 < m_results.size() ? ",\n" : "\n");
+    m_stream << "  ]\n}\n";
+  }
+
+private:
+  static std::string escape(std::string_view s) {
+    std::string result;
+    for (char c : s) {
+      if (c == '"' || c == '\\')
+        result += '\\';
+      result += c;
+    }
+    return result;
+  }
+
+  std::string m_test_case;
+  std::vector<std::string> m_results;
+};
+
+// discards the output, only counting the bytes
+class null_output_buffer : public output_buffer {
+public:
+  using output_buffer::write;
+
+  int write(const char *, int len) noexcept override {
+    m_written += len;
+    return len;
+  }
+  int written() const override { return m_written; }
+  int close() noexcept override { return 0; }
+  int flush() noexcept override { return 0; }
+
+private:
+  int m_written = 0;
+};
+
+std::string psql_id_array(int size) {
+  std::string result = "{";
+  for (int i = 0; i < size; ++i) {
+    if (i > 0)
+      result += ',';
+    result += std::to_string(1'000'000'000 + i * 7919);
+  }
+  result += '}';
+  return result;
+}
+
+std::string psql_text_array(int size) {
+  std::string result = "{";
+  for (int i = 0; i < size; ++i) {
+    if (i > 0)
+      result += ',';
+    // mix of plain, quoted and escaped values, as for tag keys and values
+    switch (i % 3) {
+    case 0:
+      result += fmt::format("highway{}", i);
+      break;
+    case 1:
+      result += fmt::format(R"("Main Street {}")", i);
+      break;
+    default:
+      result += fmt::format(R"("quote \" and backslash \\ {}")", i);
+    }
+  }
+  result += '}';
+  return result;
+}
+
+// tags as found on a typical feature
+const tags_t sample_tags = {
+  {"highway", "residential"},
+  {"name", "Rue de l'Église & \"Zentrum\""},
+  {"surface", "asphalt"},
+  {"maxspeed", "30"},
+  {"source", "survey"}
+};
+
+const element_info sample_element(
+    123456789, 3, 9876543, "2024-05-01T12:34:56Z", 42, std::string("mapper"), true);
+
+void write_elements(output_formatter &formatter, int nodes, int ways, int relations) {
+  formatter.start_document("benchmark", "osm");
+  formatter.start_element();
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> lon(-180.0, 180.0);
+  std::uniform_real_distribution<double> lat(-90.0, 90.0);
+
+  for (int i = 0; i < nodes; ++i)
+    formatter.write_node(sample_element, lon(gen), lat(gen), sample_tags);
+
+  nodes_t way_nodes;
+  for (osm_nwr_id_t n = 1; n <= 20; ++n)
+    way_nodes.push_back(1'000'000 + n);
+  for (int i = 0; i < ways; ++i)
+    formatter.write_way(sample_element, way_nodes, sample_tags);
+
+  members_t members;
+  for (osm_nwr_id_t m = 1; m <= 30; ++m)
+    members.emplace_back(m % 2 ? element_type::way : element_type::node, m, "outer");
+  for (int i = 0; i < relations; ++i)
+    formatter.write_relation(sample_element, members, sample_tags);
+
+  formatter.end_element();
+  formatter.end_document();
+}
+
+std::string random_payload(std::size_t size) {
+  // OSM XML compresses well, so random bytes would be misleading
+  std::string result;
+  result.reserve(size + 200);
+  int i = 0;
+  while (result.size() < size) {
+    result += fmt::format(
+        R"(<node id="{}" version="1" changeset="1" lat="51.{:07d}" lon="-0.{:07d}"/>)" "\n",
+        i, (i * 7919) % 10'000'000, (i * 104729) % 10'000'000);
+    ++i;
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+CATCH_REGISTER_REPORTER("benchmark-json", benchmark_json_reporter)
+
+TEST_CASE("psql array parsing", "[apidb]") {
+  const auto ids_small = psql_id_array(10);
+  const auto ids_large = psql_id_array(2000);
+  const auto text_small = psql_text_array(10);
+  const auto text_large = psql_text_array(2000);
+
+  BENCHMARK("psql_array_ids_to_vector 10") {
+    return psql_array_ids_to_vector<uint64_t>(ids_small);
+  };
+
+  BENCHMARK("psql_array_ids_to_vector 2000") {
+    return psql_array_ids_to_vector<uint64_t>(ids_large);
+  };
+
+  BENCHMARK("psql_array_to_vector 10") {
+    return psql_array_to_vector(text_small);
+  };
+
+  BENCHMARK("psql_array_to_vector 2000") {
+    return psql_array_to_vector(text_large, 2000);
+  };
+}
+
+TEST_CASE("tiles_for_area", "[apidb]") {
+  BENCHMARK("small bbox") {
+    return tiles_for_area(51.50, -0.13, 51.51, -0.12);
+  };
+
+  BENCHMARK("maximum map bbox") {
+    return tiles_for_area(51.0, -0.5, 51.5, 0.0);
+  };
+}
+
+TEST_CASE("HTTP parameters", "[http]") {
+  const std::string map_query = "bbox=-0.1280000,51.5000000,-0.1270000,51.5010000";
+  std::string nodes_query = "nodes=";
+  for (int i = 0; i < 500; ++i)
+    nodes_query += fmt::format("{}{}", i ? "," : "", 100'000 + i);
+  const std::string encoded = "name%3DStra%C3%9Fe+%26+Caf%C3%A9%20%22Zum+Gl%C3%BCck%22%2C+M%C3%BCnchen";
+
+  BENCHMARK("parse_params map") {
+    return http::parse_params(map_query);
+  };
+
+  BENCHMARK("parse_params 500 nodes") {
+    return http::parse_params(nodes_query);
+  };
+
+  BENCHMARK("urldecode") {
+    return http::urldecode(encoded);
+  };
+}
+
+TEST_CASE("Content negotiation", "[http]") {
+  const std::string_view browser_accept =
+      "text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8";
+  const std::string_view json_accept = "application/json";
+  const std::string browser_encoding = "gzip, deflate, br, zstd";
+  const std::string weighted_encoding = "br;q=1.0, gzip;q=0.8, *;q=0.1";
+
+  BENCHMARK("AcceptHeader browser") {
+    return AcceptHeader(browser_accept);
+  };
+
+  BENCHMARK("AcceptHeader json") {
+    return AcceptHeader(json_accept);
+  };
+
+  BENCHMARK("choose_encoding browser") {
+    return http::choose_encoding(browser_encoding);
+  };
+
+  BENCHMARK("choose_encoding weighted") {
+    return http::choose_encoding(weighted_encoding);
+  };
+}
+
+TEST_CASE("Routing", "[http]") {
+  const routes route;
+
+  const auto route_request = [&route](const std::string &method, const std::string &uri) {
+    test_request req;
+    req.set_header("REQUEST_METHOD", method);
+    req.set_header("REQUEST_URI", uri);
+    req.set_header("REMOTE_ADDR", "127.0.0.1");
+    return route(req);
+  };
+
+  BENCHMARK("node") {
+    return route_request("GET", "/api/0.6/node/123456789");
+  };
+
+  BENCHMARK("map") {
+    return route_request("GET", "/api/0.6/map?bbox=-0.1280000,51.5000000,-0.1270000,51.5010000");
+  };
+
+  BENCHMARK("way full json") {
+    return route_request("GET", "/api/0.6/way/123456/full.json");
+  };
+
+  BENCHMARK("changeset upload") {
+    return route_request("POST", "/api/0.6/changeset/1234/upload");
+  };
+}
+
+TEST_CASE("Formatters", "[formatter]") {
+  BENCHMARK("xml_formatter 1000 nodes 100 ways 10 relations") {
+    null_output_buffer out;
+    xml_formatter formatter(std::make_unique<xml_writer>(out, false));
+    write_elements(formatter, 1000, 100, 10);
+    return out.written();
+  };
+
+  BENCHMARK("json_formatter 1000 nodes 100 ways 10 relations") {
+    null_output_buffer out;
+    json_formatter formatter(std::make_unique<json_writer>(out, false));
+    write_elements(formatter, 1000, 100, 10);
+    return out.written();
+  };
+}
+
+TEST_CASE("Compression", "[compression]") {
+  const auto payload = random_payload(1024 * 1024);
+
+  // output writers hand over data in small chunks
+  constexpr std::size_t chunk_size = 4096;
+
+  const auto compress = [&payload](output_buffer &buffer) {
+    for (std::size_t pos = 0; pos < payload.size(); pos += chunk_size)
+      buffer.write(std::string_view(payload).substr(pos, chunk_size));
+    buffer.close();
+  };
+
+  BENCHMARK("identity 1 MiB") {
+    null_output_buffer out;
+    identity_output_buffer buffer(out);
+    compress(buffer);
+    return out.written();
+  };
+
+#ifdef HAVE_LIBZ
+  BENCHMARK("gzip 1 MiB") {
+    null_output_buffer out;
+    zlib_output_buffer buffer(out, zlib_output_buffer::mode::gzip);
+    compress(buffer);
+    return out.written();
+  };
+
+  BENCHMARK("deflate 1 MiB") {
+    null_output_buffer out;
+    zlib_output_buffer buffer(out, zlib_output_buffer::mode::zlib);
+    compress(buffer);
+    return out.written();
+  };
+#endif
+
+#if HAVE_BROTLI
+  BENCHMARK("brotli 1 MiB") {
+    null_output_buffer out;
+    brotli_output_buffer buffer(out);
+    compress(buffer);
+    return out.written();
+  };
+#endif
+}
@@ -0,0 +1,613 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * In-process load test
+ *
+ * Fills a freshly created test database with a grid of nodes, ways,
+ * relations, old versions and changesets, and replays a realistic mix of
+ * API requests through process_request at a given concurrency, without
+ * FastCGI or network in between. Reports throughput, latency percentiles
+ * and response sizes per request type.
+ *
+ * Run offline via pg_virtualenv, like the database tests:
+ *
+ *   pg_virtualenv ./benchmark_requests --db-schema test/structure.sql \
+ *       --grid 200 --requests 5000 --concurrency 8 --json results.json
+ *
+ * With --max-p99-ms, the run fails if the overall 99th percentile latency
+ * exceeds the given limit. Responses other than 200 OK always fail the
+ * run, so that it can be used to gate releases.
+ */
+
+#include "cgimap/backend/apidb/quad_tile.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/process_request.hpp"
+#include "cgimap/rate_limiter.hpp"
+#include "cgimap/routes.hpp"
+
+#include "test_database.hpp"
+#include "test_request.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const std::string bearer_token = "4f41f2328befed5a33bcabdf14483081c8df996cbafc41e313417776e8fafae8";
+
+// the grid starts here, nodes are spaced grid_step degrees apart
+constexpr double origin_lat = 45.0;
+constexpr double origin_lon = 10.0;
+constexpr double grid_step = 0.0005;
+
+// consecutive nodes in a grid row form a way
+constexpr int way_length = 10;
+
+// consecutive ways form a relation
+constexpr int relation_size = 10;
+
+// changesets above this id are used for uploads, one per worker
+constexpr osm_changeset_id_t upload_changeset_base = 1'000'000;
+
+struct load_params {
+  int grid = 100;          // nodes per grid row and column
+  int requests = 2000;     // measured requests, across all workers
+  int warmup = 20;         // unmeasured requests per worker
+  int concurrency = 4;
+  unsigned int seed = 42;
+  std::string encoding;    // Accept-Encoding header, if any
+  double max_p99_ms = 0;   // fail if exceeded, 0 to disable
+};
+
+enum class request_type {
+  map_small,
+  map_medium,
+  map_large,
+  node,
+  nodes,
+  way_full,
+  relation_full,
+  node_history,
+  way_history,
+  changeset_download,
+  upload
+};
+
+constexpr std::size_t request_type_count = 11;
+
+struct request_mix_entry {
+  request_type type;
+  std::string_view name;
+  int weight;
+};
+
+// roughly the mix seen on a production instance
+constexpr std::array<request_mix_entry, request_type_count> request_mix{{
+  { request_type::map_small, "map 0.005°", 15 },
+  { request_type::map_medium, "map 0.02°", 10 },
+  { request_type::map_large, "map 0.05°", 3 },
+  { request_type::node, "node", 15 },
+  { request_type::nodes, "nodes (50)", 5 },
+  { request_type::way_full, "way/full", 20 },
+  { request_type::relation_full, "relation/full", 10 },
+  { request_type::node_history, "node/history", 5 },
+  { request_type::way_history, "way/history", 5 },
+  { request_type::changeset_download, "changeset/download", 7 },
+  { request_type::upload, "changeset/upload", 5 }
+}};
+
+struct grid_layout {
+  explicit grid_layout(int grid) : grid(grid) {}
+
+  int grid;
+
+  [[nodiscard]] osm_nwr_id_t nodes() const { return grid * grid; }
+  [[nodiscard]] osm_nwr_id_t ways_per_row() const { return grid / way_length; }
+  [[nodiscard]] osm_nwr_id_t ways() const { return grid * ways_per_row(); }
+  [[nodiscard]] osm_nwr_id_t relations() const { return ways() / relation_size; }
+
+  // node ids are 1-based, row by row
+  [[nodiscard]] double lat(osm_nwr_id_t node) const {
+    return origin_lat + ((node - 1) / grid) * grid_step;
+  }
+  [[nodiscard]] double lon(osm_nwr_id_t node) const {
+    return origin_lon + ((node - 1) % grid) * grid_step;
+  }
+
+  // one changeset per grid row
+  [[nodiscard]] osm_changeset_id_t changeset(osm_nwr_id_t node) const {
+    return 1 + (node - 1) / grid;
+  }
+};
+
+/*
+ * Test data
+ */
+
+void run_batched(test_database &tdb, osm_nwr_id_t count,
+                 const std::function<std::string(osm_nwr_id_t)> &row,
+                 const std::string &insert) {
+  constexpr osm_nwr_id_t batch_size = 5000;
+
+  for (osm_nwr_id_t first = 1; first <= count; first += batch_size) {
+    std::string sql = insert;
+    for (auto id = first; id < std::min(first + batch_size, count + 1); ++id) {
+      if (id != first)
+        sql += ',';
+      sql += row(id);
+    }
+    sql += ';';
+    tdb.run_sql(sql);
+  }
+}
+
+void seed_database(test_database &tdb, const grid_layout &g, int workers) {
+
+  tdb.testcase_starting();
+
+  tdb.run_sql(fmt::format(R"(
+      INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public, status)
+      VALUES (1, 'user_1@example.com', '', '2013-11-14T02:10:00Z', 'user_1', true, 'confirmed');
+
+      INSERT INTO oauth_applications (id, owner_type, owner_id, name, uid, secret, redirect_uri, scopes, confidential, created_at, updated_at)
+      VALUES (3, 'User', 1, 'App 1', 'dHKmvGkmuoMjqhCNmTJkf-EcnA61Up34O1vOHwTSvU8', '965136b8fb8d00e2faa2faaaed99c0ec10225518d0c8d9fb1d2af701e87eb68c',
+              'http://demo.localhost:3000', 'write_api read_gpx', false, '2021-04-12 17:53:30', '2021-04-12 17:53:30');
+
+      INSERT INTO oauth_access_tokens (id, resource_owner_id, application_id, token, refresh_token, expires_in, revoked_at, created_at, scopes, previous_refresh_token)
+      VALUES (67, 1, 3, '{0}', NULL, NULL, NULL, '2021-04-14 19:38:21', 'write_api', '');
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at, num_changes)
+      SELECT g, 1, '2024-01-01T00:00:00Z', '2024-01-01T01:00:00Z', {1}
+      FROM generate_series(1, {2}) AS g;
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at, num_changes)
+      SELECT {3} + g, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 day' ::interval, 0
+      FROM generate_series(1, {4}) AS g;
+    )", bearer_token, g.grid, g.grid, upload_changeset_base, workers));
+
+  // nodes, every 10th of them with an older version in the history
+  run_batched(tdb, g.nodes(), [&g](osm_nwr_id_t id) {
+    const auto lat = g.lat(id);
+    const auto lon = g.lon(id);
+    return fmt::format("({},{},{},{},true,'2024-01-01T00:30:00Z',{},{})",
+                       id, std::lround(lat * 1e7), std::lround(lon * 1e7), g.changeset(id),
+                       xy2tile(lon2x(lon), lat2y(lat)), id % 10 == 0 ? 2 : 1);
+  }, "INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, \"timestamp\", tile, version) VALUES ");
+
+  tdb.run_sql(R"(
+      INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+      SELECT id, latitude, longitude, changeset_id, visible, "timestamp", tile, v
+      FROM current_nodes, generate_series(1, version) AS v;
+
+      INSERT INTO current_node_tags (node_id, k, v)
+      SELECT id, 'amenity', 'bench' FROM current_nodes WHERE id % 5 = 0;
+
+      INSERT INTO node_tags (node_id, version, k, v)
+      SELECT node_id, version, 'amenity', 'bench' FROM nodes WHERE node_id % 5 = 0;
+    )");
+
+  tdb.run_sql(fmt::format(R"(
+      INSERT INTO current_ways (id, changeset_id, "timestamp", visible, version)
+      SELECT w, 1 + (w - 1) / {0}, '2024-01-01T00:30:00Z', true, 1 + w % 2
+      FROM generate_series(1, {1}) AS w;
+
+      INSERT INTO current_way_nodes (way_id, node_id, sequence_id)
+      SELECT w, ((w - 1) / {0}) * {2} + ((w - 1) % {0}) * {3} + s, s
+      FROM generate_series(1, {1}) AS w, generate_series(1, {3}) AS s;
+
+      INSERT INTO current_way_tags (way_id, k, v)
+      SELECT id, 'highway', 'residential' FROM current_ways
+      UNION ALL
+      SELECT id, 'name', 'Street ' || id FROM current_ways;
+
+      INSERT INTO ways (way_id, changeset_id, "timestamp", version, visible)
+      SELECT id, changeset_id, "timestamp", v, true
+      FROM current_ways, generate_series(1, version) AS v;
+
+      INSERT INTO way_nodes (way_id, node_id, version, sequence_id)
+      SELECT wn.way_id, wn.node_id, w.version, wn.sequence_id
+      FROM current_way_nodes wn JOIN ways w ON w.way_id = wn.way_id;
+
+      INSERT INTO way_tags (way_id, k, v, version)
+      SELECT wt.way_id, wt.k, wt.v, w.version
+      FROM current_way_tags wt JOIN ways w ON w.way_id = wt.way_id;
+    )", g.ways_per_row(), g.ways(), g.grid, way_length));
+
+  tdb.run_sql(fmt::format(R"(
+      INSERT INTO current_relations (id, changeset_id, "timestamp", visible, version)
+      SELECT r, 1, '2024-01-01T00:30:00Z', true, 1
+      FROM generate_series(1, {0}) AS r;
+
+      INSERT INTO current_relation_members (relation_id, member_type, member_id, member_role, sequence_id)
+      SELECT r, 'Way', (r - 1) * {1} + s, 'outer', s
+      FROM generate_series(1, {0}) AS r, generate_series(1, {1}) AS s;
+
+      INSERT INTO current_relation_tags (relation_id, k, v)
+      SELECT id, 'type', 'multipolygon' FROM current_relations;
+
+      INSERT INTO relations (relation_id, changeset_id, "timestamp", version, visible)
+      SELECT id, changeset_id, "timestamp", version, visible FROM current_relations;
+
+      INSERT INTO relation_members (relation_id, member_type, member_id, member_role, version, sequence_id)
+      SELECT relation_id, member_type, member_id, member_role, 1, sequence_id FROM current_relation_members;
+
+      INSERT INTO relation_tags (relation_id, k, v, version)
+      SELECT relation_id, k, v, 1 FROM current_relation_tags;
+
+      SELECT setval('current_nodes_id_seq', {2} + 1, false);
+      SELECT setval('current_ways_id_seq', {3} + 1, false);
+      SELECT setval('current_relations_id_seq', {0} + 1, false);
+      SELECT setval('changesets_id_seq', {4}, false);
+
+      ANALYZE;
+    )", g.relations(), relation_size, g.nodes(), g.ways(), upload_changeset_base + 1000));
+}
+
+/*
+ * Request generation
+ */
+
+struct generated_request {
+  request_type type;
+  std::string method = "GET";
+  std::string uri;
+  std::string payload;
+};
+
+class request_generator {
+public:
+  request_generator(const grid_layout &g, unsigned int seed, osm_changeset_id_t upload_changeset)
+    : m_grid(g), m_gen(seed), m_upload_changeset(upload_changeset) {
+
+    std::vector<int> weights;
+    for (const auto &e : request_mix)
+      weights.push_back(e.weight);
+    m_type = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+  }
+
+  generated_request next() {
+    const auto type = request_mix[m_type(m_gen)].type;
+
+    switch (type) {
+    case request_type::map_small:
+      return { type, "GET", map_uri(0.005), {} };
+    case request_type::map_medium:
+      return { type, "GET", map_uri(0.02), {} };
+    case request_type::map_large:
+      return { type, "GET", map_uri(0.05), {} };
+    case request_type::node:
+      return { type, "GET", fmt::format("/api/0.6/node/{}", random_id(m_grid.nodes())), {} };
+    case request_type::nodes: {
+      std::string ids;
+      for (int i = 0; i < 50; ++i)
+        ids += fmt::format("{}{}", i ? "," : "", random_id(m_grid.nodes()));
+      return { type, "GET", "/api/0.6/nodes?nodes=" + ids, {} };
+    }
+    case request_type::way_full:
+      return { type, "GET", fmt::format("/api/0.6/way/{}/full", random_id(m_grid.ways())), {} };
+    case request_type::relation_full:
+      return { type, "GET", fmt::format("/api/0.6/relation/{}/full", random_id(m_grid.relations())), {} };
+    case request_type::node_history:
+      return { type, "GET", fmt::format("/api/0.6/node/{}/history", random_id(m_grid.nodes())), {} };
+    case request_type::way_history:
+      return { type, "GET", fmt::format("/api/0.6/way/{}/history", random_id(m_grid.ways())), {} };
+    case request_type::changeset_download:
+      return { type, "GET", fmt::format("/api/0.6/changeset/{}/download", random_id(m_grid.grid)), {} };
+    case request_type::upload:
+      return { type, "POST", fmt::format("/api/0.6/changeset/{}/upload", m_upload_changeset), upload_payload() };
+    }
+    return {};
+  }
+
+private:
+  osm_nwr_id_t random_id(osm_nwr_id_t max) {
+    return std::uniform_int_distribution<osm_nwr_id_t>(1, max)(m_gen);
+  }
+
+  std::string map_uri(double size) {
+    const double extent = (m_grid.grid - 1) * grid_step;
+    std::uniform_real_distribution<double> offset(0.0, std::max(extent - size, 0.0));
+    const double minlon = origin_lon + offset(m_gen);
+    const double minlat = origin_lat + offset(m_gen);
+    return fmt::format("/api/0.6/map?bbox={:.7f},{:.7f},{:.7f},{:.7f}",
+                       minlon, minlat, minlon + size, minlat + size);
+  }
+
+  // creates a short way with new nodes near the grid
+  std::string upload_payload() {
+    const double lat = origin_lat - 0.01;
+    const double lon = origin_lon + (m_uploads++ % 1000) * grid_step;
+
+    std::string s = R"(<osmChange version="0.6" generator="benchmark"><create>)";
+    for (int i = 1; i <= 5; ++i)
+      s += fmt::format(R"(<node id="-{}" lat="{:.7f}" lon="{:.7f}" changeset="{}"/>)",
+                       i, lat + i * grid_step, lon, m_upload_changeset);
+    s += fmt::format(R"(<way id="-1" changeset="{}">)", m_upload_changeset);
+    for (int i = 1; i <= 5; ++i)
+      s += fmt::format(R"(<nd ref="-{}"/>)", i);
+    s += R"(<tag k="highway" v="footway"/></way></create></osmChange>)";
+    return s;
+  }
+
+  const grid_layout &m_grid;
+  std::mt19937 m_gen;
+  std::discrete_distribution<std::size_t> m_type;
+  const osm_changeset_id_t m_upload_changeset;
+  int m_uploads = 0;
+};
+
+/*
+ * Measurements
+ */
+
+struct sample {
+  request_type type;
+  clock_type::duration elapsed;
+  std::size_t bytes;
+  int status;
+};
+
+struct summary {
+  std::string name;
+  std::size_t count = 0;
+  std::size_t errors = 0;
+  double p50 = 0;
+  double p99 = 0;
+  double p999 = 0;
+  double mean_bytes = 0;
+};
+
+double ms(clock_type::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+double percentile(const std::vector<double> &sorted, double q) {
+  if (sorted.empty())
+    return 0;
+  const auto rank = static_cast<std::size_t>(std::ceil(q * sorted.size()));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+summary summarise(const std::string &name, const std::vector<const sample *> &samples) {
+  summary s{ .name = name, .count = samples.size() };
+
+  std::vector<double> latencies;
+  std::size_t bytes = 0;
+  for (const auto *x : samples) {
+    latencies.push_back(ms(x->elapsed));
+    bytes += x->bytes;
+    if (x->status != 200)
+      ++s.errors;
+  }
+  std::ranges::sort(latencies);
+
+  s.p50 = percentile(latencies, 0.5);
+  s.p99 = percentile(latencies, 0.99);
+  s.p999 = percentile(latencies, 0.999);
+  s.mean_bytes = samples.empty() ? 0 : static_cast<double>(bytes) / samples.size();
+  return s;
+}
+
+sample run_request(const generated_request &r, const routes &route, rate_limiter &limiter,
+                   data_selection::factory &factory, data_update::factory &update_factory,
+                   const std::string &encoding) {
+  test_request req;
+  req.set_header("REQUEST_METHOD", r.method);
+  req.set_header("REQUEST_URI", r.uri);
+  req.set_header("REMOTE_ADDR", "127.0.0.1");
+  if (!encoding.empty())
+    req.set_header("HTTP_ACCEPT_ENCODING", encoding);
+  if (!r.payload.empty()) {
+    req.set_header("HTTP_AUTHORIZATION", "Bearer " + bearer_token);
+    req.set_payload(r.payload);
+  }
+  req.set_current_time(std::chrono::system_clock::now());
+
+  const auto start = clock_type::now();
+  process_request(req, limiter, "benchmark", route, factory, &update_factory);
+  const auto elapsed = clock_type::now() - start;
+
+  const auto bytes = static_cast<std::size_t>(std::streamoff(req.body().tellp()));
+  return { r.type, elapsed, bytes, req.response_status() };
+}
+
+class benchmark_settings : public global_settings_default {
+public:
+  // all uploads of a worker go to the same changeset
+  uint32_t get_changeset_max_elements() const override { return 10000000; }
+};
+
+void print_summary(const summary &s) {
+  std::cout << fmt::format("{:<20} {:>7} {:>6} {:>9.2f} {:>9.2f} {:>9.2f} {:>10.0f}\n",
+                           s.name, s.count, s.errors, s.p50, s.p99, s.p999, s.mean_bytes);
+}
+
+std::string to_json(const summary &s) {
+  return fmt::format(R"({{"name": "{}", "count": {}, "errors": {}, "p50_ms": {:.3f}, )"
+                     R"("p99_ms": {:.3f}, "p999_ms": {:.3f}, "mean_bytes": {:.1f}}})",
+                     s.name, s.count, s.errors, s.p50, s.p99, s.p999, s.mean_bytes);
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+  load_params p;
+  std::string db_schema = "test/structure.sql";
+  std::string json_file;
+
+  po::options_description desc("Load test options");
+  desc.add_options()
+    ("help", "show this help")
+    ("db-schema", po::value(&db_schema), "test database schema file")
+    ("grid", po::value(&p.grid), "nodes per row and column of the test data grid")
+    ("requests", po::value(&p.requests), "number of measured requests")
+    ("warmup", po::value(&p.warmup), "unmeasured requests per worker")
+    ("concurrency", po::value(&p.concurrency), "number of concurrent workers")
+    ("seed", po::value(&p.seed), "random seed for the request mix")
+    ("encoding", po::value(&p.encoding), "Accept-Encoding request header, e.g. gzip")
+    ("max-p99-ms", po::value(&p.max_p99_ms), "fail if the overall 99th percentile latency exceeds this")
+    ("json", po::value(&json_file), "write results as JSON to this file");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.contains("help")) {
+    std::cout << desc << '\n';
+    return EXIT_SUCCESS;
+  }
+
+  if (p.grid < way_length * relation_size || p.concurrency < 1 || p.requests < 1) {
+    std::cerr << fmt::format("Error: --grid must be at least {}, --concurrency and --requests at least 1\n",
+                             way_length * relation_size);
+    return EXIT_FAILURE;
+  }
+
+  global_settings::set_configuration(std::make_unique<benchmark_settings>());
+
+  try {
+    test_database tdb;
+    tdb.setup(db_schema);
+
+    const grid_layout g(p.grid);
+
+    std::cout << fmt::format("seeding {} nodes, {} ways, {} relations\n",
+                             g.nodes(), g.ways(), g.relations());
+    seed_database(tdb, g, p.concurrency);
+
+    std::vector<std::vector<sample>> worker_samples(p.concurrency);
+    std::atomic<int> remaining(p.requests);
+    std::atomic<bool> failed(false);
+
+    // measurements start once all workers are warmed up
+    std::latch warmed_up(p.concurrency);
+    clock_type::time_point start;
+    {
+      std::vector<std::jthread> workers;
+      for (int w = 0; w < p.concurrency; ++w) {
+        workers.emplace_back([&, w] {
+          bool ready = false;
+          try {
+            // each worker has its own database connections, like a
+            // cgimap instance
+            auto factory = tdb.get_new_data_selection_factory();
+            auto update_factory = tdb.get_new_data_update_factory();
+            const routes route;
+            null_rate_limiter limiter;
+            request_generator generator(g, p.seed + w, upload_changeset_base + 1 + w);
+
+            for (int i = 0; i < p.warmup; ++i)
+              run_request(generator.next(), route, limiter, *factory, *update_factory, p.encoding);
+
+            ready = true;
+            warmed_up.arrive_and_wait();
+
+            while (remaining.fetch_sub(1) > 0)
+              worker_samples[w].push_back(
+                run_request(generator.next(), route, limiter, *factory, *update_factory, p.encoding));
+
+          } catch (const std::exception &e) {
+            std::cerr << fmt::format("Worker {} failed: {}\n", w, e.what());
+            failed = true;
+            if (!ready)
+              warmed_up.count_down();
+          }
+        });
+      }
+
+      warmed_up.wait();
+      start = clock_type::now();
+    }
+    const auto elapsed = clock_type::now() - start;
+
+    if (failed)
+      return EXIT_FAILURE;
+
+    std::vector<const sample *> all;
+    std::map<request_type, std::vector<const sample *>> by_type;
+    for (const auto &samples : worker_samples) {
+      for (const auto &s : samples) {
+        all.push_back(&s);
+        by_type[s.type].push_back(&s);
+      }
+    }
+
+    std::vector<summary> summaries;
+    for (const auto &e : request_mix) {
+      if (by_type.contains(e.type))
+        summaries.push_back(summarise(std::string(e.name), by_type[e.type]));
+    }
+    const auto total = summarise("total", all);
+    const double throughput = all.size() / std::chrono::duration<double>(elapsed).count();
+
+    std::cout << fmt::format("{} requests, {} workers, {:.1f} s, {:.1f} requests/s\n",
+                             all.size(), p.concurrency, ms(elapsed) / 1000, throughput);
+    std::cout << fmt::format("{:<20} {:>7} {:>6} {:>9} {:>9} {:>9} {:>10}\n", "request",
+                             "count", "errors", "p50 [ms]", "p99 [ms]", "p999 [ms]", "bytes");
+    for (const auto &s : summaries)
+      print_summary(s);
+    print_summary(total);
+
+    if (!json_file.empty()) {
+      std::ofstream out(json_file);
+      out << "{\n"
+          << fmt::format(R"(  "version": "{}",)" "\n", PACKAGE_VERSION)
+          << fmt::format(R"(  "concurrency": {}, "grid": {}, "seconds": {:.3f}, "requests_per_second": {:.1f},)" "\n",
+                         p.concurrency, p.grid, ms(elapsed) / 1000, throughput)
+          << "  \"total\": " << to_json(total) << ",\n"
+          << "  \"requests\": [\n";
+      for (std::size_t i = 0; i < summaries.size(); ++i)
+        out << "    " << to_json(summaries[i]) << (i + 1 < summaries.size() ? ",\n" : "\n");
+      out << "  ]\n}\n";
+    }
+
+    if (total.errors > 0) {
+      std::cerr << fmt::format("Error: {} requests did not return 200 OK\n", total.errors);
+      return EXIT_FAILURE;
+    }
+
+    if (p.max_p99_ms > 0 && total.p99 > p.max_p99_ms) {
+      std::cerr << fmt::format("Error: p99 latency {:.2f} ms exceeds limit of {:.2f} ms\n",
+                               total.p99, p.max_p99_ms);
+      return EXIT_FAILURE;
+    }
+
+  } catch (const test_database::setup_error &e) {
+    std::cerr << "Unable to set up test database: " << e.what() << '\n';
+    return EXIT_FAILURE;
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1193 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Synthetic test database generator
+ *
+ * Fills an empty database with the structure.sql schema with city or
+ * country sized synthetic data: dense urban clusters and sparse rural
+ * areas, buildings, streets and a few very long ways, multipolygons,
+ * routes, route masters and a deeply nested chain of boundaries, tag
+ * values drawn from skewed distributions, and a handful of "hot"
+ * elements with thousands of versions. All tables are bulk loaded using
+ * COPY.
+ *
+ * Not part of the test suite. The output only depends on the options,
+ * so that results of different cgimap versions can be compared, e.g.:
+ *
+ *   createdb osm_city
+ *   ./generate_test_data --dbname osm_city --db-schema test/structure.sql --scale city
+ *
+ * Elements are generated on the fly from a per element random seed, so
+ * that every table can be streamed in a separate pass without keeping
+ * more than the way layout in memory.
+ */
+
+#include "cgimap/backend/apidb/quad_tile.hpp"
+#include "cgimap/backend/apidb/transaction_manager.hpp"
+#include "cgimap/backend/apidb/utils.hpp"
+#include "cgimap/output_formatter.hpp"
+#include "cgimap/types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+struct generator_params {
+  int64_t nodes = 200'000;
+  double min_lon = 6.9;
+  double min_lat = 50.9;
+  double max_lon = 7.1;
+  double max_lat = 51.05;
+  int cities = 3;              // dense urban clusters, sized by Zipf's law
+  double urban_share = 0.8;    // share of features inside urban clusters
+  int users = 1'000;
+  int hot_elements = 10;       // per element type
+  int hot_versions = 2'000;
+  int relation_depth = 10;     // length of the nested boundary chain
+  uint64_t seed = 42;
+};
+
+struct scale_preset {
+  std::string_view name;
+  int64_t nodes;
+  std::array<double, 4> bbox;  // min_lon, min_lat, max_lon, max_lat
+  int cities;
+  int users;
+};
+
+constexpr std::array<scale_preset, 3> scale_presets{{
+  { "town", 200'000, { 6.9, 50.9, 7.1, 51.05 }, 3, 1'000 },
+  { "city", 5'000'000, { 6.5, 50.6, 7.5, 51.3 }, 10, 20'000 },
+  { "country", 100'000'000, { 5.9, 47.3, 15.0, 55.0 }, 80, 500'000 }
+}};
+
+constexpr osm_changeset_id_t changes_per_changeset = 100;
+
+// coordinates are stored as integers, in units of 1e-7 degrees
+constexpr double coordinate_scale = 10'000'000.0;
+
+// history starts here, and covers history_span seconds
+constexpr int64_t history_start = 1'262'304'000;  // 2010-01-01
+constexpr int64_t history_span = 15 * 365 * 86'400;
+
+// longest way the API accepts
+constexpr int64_t max_way_length = 2'000;
+
+// share of all nodes which are part of ways, the rest are POIs
+constexpr double way_node_share = 0.9;
+
+/*
+ * Deterministic random numbers
+ */
+
+constexpr uint64_t mix(uint64_t x) {
+  // splitmix64 finaliser
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+enum class stream_kind : uint64_t {
+  layout = 1,
+  node,
+  way,
+  relation,
+  version,
+  changeset
+};
+
+/**
+ * Small and cheap to seed generator, so that each element can have its
+ * own stream of random numbers. Satisfies UniformRandomBitGenerator.
+ */
+class element_rng {
+public:
+  using result_type = uint64_t;
+
+  element_rng(uint64_t seed, stream_kind kind, uint64_t id, uint64_t sub = 0)
+    : m_state(mix(seed ^ mix((static_cast<uint64_t>(kind) << 56) ^ mix(id ^ (sub << 40))))) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+
+  result_type operator()() {
+    m_state += 0x9e3779b97f4a7c15ULL;
+    return mix(m_state);
+  }
+
+  double uniform() { return static_cast<double>((*this)() >> 11) * 0x1.0p-53; }
+
+  bool chance(double p) { return uniform() < p; }
+
+  int64_t between(int64_t lo, int64_t hi) {
+    return lo + static_cast<int64_t>((*this)() % static_cast<uint64_t>(hi - lo + 1));
+  }
+
+  double normal() {
+    // Box-Muller, one value is enough
+    const double u1 = std::max(uniform(), 1e-300);
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * std::numbers::pi * uniform());
+  }
+
+  // picks an index according to the weights
+  template <std::size_t N>
+  std::size_t weighted(const std::array<int, N> &weights) {
+    int total = 0;
+    for (auto w : weights)
+      total += w;
+    auto r = static_cast<int>((*this)() % total);
+    for (std::size_t i = 0; i < N; ++i) {
+      if (r < weights[i])
+        return i;
+      r -= weights[i];
+    }
+    return N - 1;
+  }
+
+private:
+  uint64_t m_state;
+};
+
+/*
+ * Tag distributions
+ */
+
+using tag_list = std::vector<std::pair<std::string, std::string>>;
+
+template <std::size_t N>
+struct tag_choice {
+  std::array<std::string_view, N> values;
+  std::array<int, N> weights;
+
+  std::string_view pick(element_rng &rng) const { return values[rng.weighted(weights)]; }
+};
+
+constexpr std::array<std::string_view, 16> name_words{
+  "Linden", "Kirch", "Bahnhof", "Markt", "Schiller", "Goethe", "Mühlen", "Berg",
+  "Garten", "Wald", "Rosen", "Schul", "Post", "Feld", "Brunnen", "Eichen"
+};
+
+constexpr tag_choice<6> street_suffix{
+  { "straße", "weg", "gasse", "allee", "platz", "ring" },
+  { 50, 25, 8, 7, 5, 5 }
+};
+
+std::string street_name(uint64_t h) {
+  element_rng rng(h, stream_kind::layout, 0);
+  return fmt::format("{}{}", name_words[rng() % name_words.size()], street_suffix.pick(rng));
+}
+
+constexpr tag_choice<12> poi_amenity{
+  { "bench", "restaurant", "parking", "cafe", "waste_basket", "fast_food",
+    "school", "pharmacy", "bank", "place_of_worship", "post_box", "fuel" },
+  { 20, 14, 12, 10, 10, 8, 5, 5, 4, 4, 4, 4 }
+};
+
+constexpr tag_choice<8> poi_shop{
+  { "convenience", "supermarket", "clothes", "hairdresser", "bakery", "car_repair",
+    "kiosk", "Ladengeschäft \"Zum Glück\"" },
+  { 25, 20, 15, 12, 12, 8, 6, 2 }
+};
+
+constexpr tag_choice<5> poi_kind{
+  { "amenity", "shop", "tree", "bus_stop", "address" },
+  { 35, 20, 20, 10, 15 }
+};
+
+constexpr tag_choice<4> way_node_kind{
+  { "crossing", "traffic_signals", "stop", "street_lamp" },
+  { 50, 25, 15, 10 }
+};
+
+constexpr tag_choice<5> building_value{
+  { "yes", "house", "residential", "apartments", "commercial" },
+  { 70, 15, 8, 4, 3 }
+};
+
+constexpr tag_choice<9> highway_value{
+  { "residential", "service", "footway", "track", "unclassified", "tertiary",
+    "secondary", "primary", "cycleway" },
+  { 45, 20, 12, 6, 5, 5, 3, 2, 2 }
+};
+
+constexpr tag_choice<5> long_way_kind{
+  { "river", "rail", "motorway", "coastline", "boundary" },
+  { 25, 20, 20, 5, 30 }
+};
+
+constexpr tag_choice<5> landuse_value{
+  { "residential", "forest", "farmland", "grass", "industrial" },
+  { 30, 25, 25, 12, 8 }
+};
+
+constexpr tag_choice<3> route_value{
+  { "bus", "bicycle", "hiking" },
+  { 50, 25, 25 }
+};
+
+/*
+ * Layout: which ways exist and which nodes belong to them. Nodes are
+ * allocated in contiguous blocks per way, followed by the POI nodes.
+ */
+
+enum class way_kind : uint8_t {
+  building,
+  highway,
+  long_way
+};
+
+struct lat_lon {
+  double lat;
+  double lon;
+};
+
+class layout {
+public:
+  explicit layout(const generator_params &p) : m_params(p) {
+    build_cities();
+    build_ways();
+
+    m_relations = std::max<osm_nwr_id_t>(m_ways / 25, p.relation_depth + 40);
+    // every element has at least one version, hot elements many more
+    const auto elements = m_params.nodes + m_ways + m_relations;
+    m_changesets = std::max<osm_changeset_id_t>(
+        1, (elements * 2 + 3 * p.hot_elements * p.hot_versions) / changes_per_changeset);
+  }
+
+  [[nodiscard]] const generator_params &params() const { return m_params; }
+
+  [[nodiscard]] osm_nwr_id_t nodes() const { return m_params.nodes; }
+  [[nodiscard]] osm_nwr_id_t ways() const { return m_ways; }
+  [[nodiscard]] osm_nwr_id_t relations() const { return m_relations; }
+  [[nodiscard]] osm_changeset_id_t changesets() const { return m_changesets; }
+
+  // first node not part of any way
+  [[nodiscard]] osm_nwr_id_t first_poi() const { return m_way_start.back(); }
+
+  [[nodiscard]] way_kind kind(osm_nwr_id_t way) const {
+    return static_cast<way_kind>(m_way_flags[way - 1] & kind_mask);
+  }
+
+  // whether the way starts at the last node of the previous way
+  [[nodiscard]] bool junction(osm_nwr_id_t way) const {
+    return m_way_flags[way - 1] & junction_flag;
+  }
+
+  [[nodiscard]] osm_nwr_id_t first_node(osm_nwr_id_t way) const { return m_way_start[way - 1]; }
+
+  [[nodiscard]] int64_t own_nodes(osm_nwr_id_t way) const {
+    return m_way_start[way] - m_way_start[way - 1];
+  }
+
+  [[nodiscard]] nodes_t way_nodes(osm_nwr_id_t way) const {
+    nodes_t result;
+    const auto first = first_node(way);
+    const auto own = own_nodes(way);
+    result.reserve(own + 1);
+    if (junction(way))
+      result.push_back(first - 1);
+    for (int64_t i = 0; i < own; ++i)
+      result.push_back(first + i);
+    if (kind(way) == way_kind::building)
+      result.push_back(first);
+    return result;
+  }
+
+  [[nodiscard]] lat_lon random_location(element_rng &rng, double urban_share) const {
+    if (rng.chance(urban_share)) {
+      const auto r = rng.uniform() * m_city_weights.back();
+      const auto c = std::lower_bound(m_city_weights.begin(), m_city_weights.end(), r) -
+                     m_city_weights.begin();
+      const auto &city = m_cities[c];
+      return clamp({ city.centre.lat + rng.normal() * city.sigma,
+                     city.centre.lon + rng.normal() * city.sigma * 1.5 });
+    }
+    return { m_params.min_lat + rng.uniform() * (m_params.max_lat - m_params.min_lat),
+             m_params.min_lon + rng.uniform() * (m_params.max_lon - m_params.min_lon) };
+  }
+
+  [[nodiscard]] lat_lon clamp(lat_lon p) const {
+    return { std::clamp(p.lat, m_params.min_lat, m_params.max_lat),
+             std::clamp(p.lon, m_params.min_lon, m_params.max_lon) };
+  }
+
+  /**
+   * Calls f(id, location) for all nodes in id order. Ways starting at a
+   * junction continue from where the previous way ended.
+   */
+  void for_each_node(const std::function<void(osm_nwr_id_t, lat_lon)> &f) const {
+    lat_lon end{};
+    for (osm_nwr_id_t way = 1; way <= m_ways; ++way) {
+      element_rng rng(m_params.seed, stream_kind::way, way, 1);
+      auto pos = junction(way) ? end : random_location(rng, m_params.urban_share);
+      const auto first = first_node(way);
+      const auto own = own_nodes(way);
+
+      if (kind(way) == way_kind::building) {
+        // rotated rectangle of 10 to 30 metres
+        const double angle = rng.uniform() * std::numbers::pi;
+        const double w = 0.0001 + rng.uniform() * 0.0002;
+        const double h = 0.0001 + rng.uniform() * 0.0002;
+        const std::array<std::pair<double, double>, 4> corners{{ {0, 0}, {w, 0}, {w, h}, {0, h} }};
+        for (int64_t i = 0; i < own; ++i) {
+          const auto [x, y] = corners[i % 4];
+          f(first + i, clamp({ pos.lat + x * std::sin(angle) + y * std::cos(angle),
+                               pos.lon + x * std::cos(angle) - y * std::sin(angle) }));
+        }
+        continue;
+      }
+
+      // random walk, with long ways taking larger steps
+      const double step = kind(way) == way_kind::long_way ? 0.002 : 0.0003;
+      double heading = rng.uniform() * 2 * std::numbers::pi;
+      for (int64_t i = 0; i < own; ++i) {
+        heading += rng.normal() * 0.3;
+        pos = clamp({ pos.lat + step * std::sin(heading), pos.lon + step * 1.5 * std::cos(heading) });
+        f(first + i, pos);
+      }
+      end = pos;
+    }
+
+    for (auto id = first_poi(); id <= nodes(); ++id) {
+      element_rng rng(m_params.seed, stream_kind::node, id, 1);
+      f(id, random_location(rng, std::min(1.0, m_params.urban_share + 0.1)));
+    }
+  }
+
+private:
+  static constexpr uint8_t kind_mask = 0x3;
+  static constexpr uint8_t junction_flag = 0x4;
+
+  struct city {
+    lat_lon centre;
+    double sigma;
+  };
+
+  void build_cities() {
+    const auto &p = m_params;
+    const double extent = std::min(p.max_lat - p.min_lat, p.max_lon - p.min_lon);
+    double total = 0;
+    for (int c = 0; c < std::max(p.cities, 1); ++c) {
+      element_rng rng(p.seed, stream_kind::layout, c, 1);
+      const double weight = 1.0 / (c + 1);
+      m_cities.push_back({ { p.min_lat + (0.1 + 0.8 * rng.uniform()) * (p.max_lat - p.min_lat),
+                             p.min_lon + (0.1 + 0.8 * rng.uniform()) * (p.max_lon - p.min_lon) },
+                           extent * 0.08 * std::sqrt(weight) / std::sqrt(std::max(p.cities, 1) / 3.0 + 1) });
+      total += weight;
+      m_city_weights.push_back(total);
+    }
+  }
+
+  void build_ways() {
+    const auto budget = static_cast<osm_nwr_id_t>(m_params.nodes * way_node_share);
+    osm_nwr_id_t next_node = 1;
+    way_kind previous = way_kind::building;
+    m_way_start.push_back(next_node);
+
+    for (osm_nwr_id_t way = 1; next_node <= budget; ++way) {
+      element_rng rng(m_params.seed, stream_kind::layout, way);
+      way_kind kind;
+      int64_t length;
+      const double r = rng.uniform();
+      if (r < 0.55) {
+        kind = way_kind::building;
+        length = 4;
+      } else if (r < 0.995) {
+        kind = way_kind::highway;
+        length = std::clamp<int64_t>(std::lround(std::exp(2.0 + rng.normal() * 0.7)), 2, 300);
+      } else {
+        kind = way_kind::long_way;
+        length = rng.between(200, max_way_length - 1);
+      }
+      length = std::min<int64_t>(length, budget - next_node + 1);
+      if (kind == way_kind::building && length < 4)
+        kind = way_kind::highway;
+      if (length < 2)
+        break;
+
+      const bool joins = kind != way_kind::building && previous != way_kind::building && rng.chance(0.5);
+      m_way_flags.push_back(static_cast<uint8_t>(kind) | (joins ? junction_flag : 0));
+      next_node += length;
+      m_way_start.push_back(next_node);
+      previous = kind;
+    }
+    m_ways = m_way_flags.size();
+  }
+
+  const generator_params m_params;
+  std::vector<city> m_cities;
+  std::vector<double> m_city_weights;  // cumulative
+  std::vector<osm_nwr_id_t> m_way_start;  // first node of each way, plus one past the last
+  std::vector<uint8_t> m_way_flags;
+  osm_nwr_id_t m_ways = 0;
+  osm_nwr_id_t m_relations = 0;
+  osm_changeset_id_t m_changesets = 0;
+};
+
+/*
+ * Versions and changesets
+ */
+
+class versions {
+public:
+  explicit versions(const layout &l) : m_layout(l) {}
+
+  [[nodiscard]] bool hot(osm_nwr_id_t id, osm_nwr_id_t count) const {
+    const auto hot_elements = m_layout.params().hot_elements;
+    if (hot_elements <= 0)
+      return false;
+    const auto stride = std::max<osm_nwr_id_t>(count / hot_elements, 1);
+    return id % stride == 0 && id / stride <= static_cast<osm_nwr_id_t>(hot_elements);
+  }
+
+  [[nodiscard]] int64_t count(stream_kind kind, osm_nwr_id_t id, osm_nwr_id_t elements) const {
+    if (hot(id, elements))
+      return m_layout.params().hot_versions;
+    // most elements are rarely edited
+    element_rng rng(m_layout.params().seed, stream_kind::version, id, static_cast<uint64_t>(kind));
+    int64_t v = 1;
+    while (v < 30 && rng.chance(0.45))
+      ++v;
+    return v;
+  }
+
+  // versions are spread evenly across the history, in increasing changesets
+  [[nodiscard]] osm_changeset_id_t changeset(stream_kind kind, osm_nwr_id_t id,
+                                             int64_t version, int64_t count) const {
+    element_rng rng(m_layout.params().seed, stream_kind::changeset, id,
+                    (static_cast<uint64_t>(kind) << 20) ^ version);
+    const double position = (version - 1 + rng.uniform()) / count;
+    return 1 + std::min<osm_changeset_id_t>(
+        static_cast<osm_changeset_id_t>(position * m_layout.changesets()),
+        m_layout.changesets() - 1);
+  }
+
+  [[nodiscard]] int64_t changeset_created(osm_changeset_id_t c) const {
+    return history_start + (c - 1) * history_span / m_layout.changesets();
+  }
+
+  // changesets stay open for up to an hour
+  [[nodiscard]] int64_t timestamp(osm_changeset_id_t c, osm_nwr_id_t id, int64_t version) const {
+    return changeset_created(c) + static_cast<int64_t>(mix(id ^ (version << 32)) % 3'600);
+  }
+
+  // frequent mappers create most changesets
+  [[nodiscard]] osm_user_id_t user(osm_changeset_id_t c) const {
+    element_rng rng(m_layout.params().seed, stream_kind::changeset, c);
+    const auto u = rng.uniform();
+    return 1 + static_cast<osm_user_id_t>(u * u * u * m_layout.params().users);
+  }
+
+private:
+  const layout &m_layout;
+};
+
+std::string format_timestamp(int64_t seconds) {
+  const time_t t = seconds;
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%F %T", &tm);
+  return buffer;
+}
+
+// older versions have one tag less every other version
+std::size_t tags_in_version(std::size_t tags, int64_t version, int64_t count) {
+  if (tags == 0 || (count - version) % 2 == 0)
+    return tags;
+  return tags - 1;
+}
+
+/*
+ * Elements
+ */
+
+class generator {
+public:
+  generator(const layout &l, pqxx::connection &conn) : m_layout(l), m_versions(l), m_conn(conn) {}
+
+  void run() {
+    load("users", [this](pqxx::work &txn) { write_users(txn); });
+    load("changesets", [this](pqxx::work &txn) { write_changesets(txn); });
+
+    load("current_nodes", [this](pqxx::work &txn) { write_nodes(txn, false); });
+    load("current_node_tags", [this](pqxx::work &txn) { write_node_tags(txn, false); });
+    load("nodes", [this](pqxx::work &txn) { write_nodes(txn, true); });
+    load("node_tags", [this](pqxx::work &txn) { write_node_tags(txn, true); });
+
+    load("current_ways", [this](pqxx::work &txn) { write_ways(txn, false); });
+    load("current_way_tags", [this](pqxx::work &txn) { write_way_tags(txn, false); });
+    load("current_way_nodes", [this](pqxx::work &txn) { write_way_nodes(txn, false); });
+    load("ways", [this](pqxx::work &txn) { write_ways(txn, true); });
+    load("way_tags", [this](pqxx::work &txn) { write_way_tags(txn, true); });
+    load("way_nodes", [this](pqxx::work &txn) { write_way_nodes(txn, true); });
+
+    load("current_relations", [this](pqxx::work &txn) { write_relations(txn, false); });
+    load("current_relation_tags", [this](pqxx::work &txn) { write_relation_tags(txn, false); });
+    load("current_relation_members", [this](pqxx::work &txn) { write_relation_members(txn, false); });
+    load("relations", [this](pqxx::work &txn) { write_relations(txn, true); });
+    load("relation_tags", [this](pqxx::work &txn) { write_relation_tags(txn, true); });
+    load("relation_members", [this](pqxx::work &txn) { write_relation_members(txn, true); });
+
+    finish();
+  }
+
+private:
+  void load(std::string_view table, const std::function<void(pqxx::work &)> &write) {
+    const auto start = std::chrono::steady_clock::now();
+    pqxx::work txn(m_conn);
+    m_rows = 0;
+    write(txn);
+    txn.commit();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    std::cout << fmt::format("{:<26} {:>12} rows {:>9.1f} s\n", table, m_rows, elapsed.count())
+              << std::flush;
+  }
+
+  template <typename... Ts>
+  void write(Stream_Wrapper &stream, Ts const &...fields) {
+    stream.write_values(fields...);
+    ++m_rows;
+  }
+
+  void write_users(pqxx::work &txn) {
+    Stream_Wrapper stream(txn, "users",
+        "id, email, pass_crypt, creation_time, display_name, data_public, status");
+    const auto created = format_timestamp(history_start - 86'400);
+    for (int u = 1; u <= m_layout.params().users; ++u)
+      write(stream, u, fmt::format("user_{}@example.com", u), "", created,
+            fmt::format("user_{}", u), u % 10 != 0, "confirmed");
+    stream.complete();
+  }
+
+  void write_changesets(pqxx::work &txn) {
+    Stream_Wrapper stream(txn, "changesets", "id, user_id, created_at, closed_at, num_changes");
+    for (osm_changeset_id_t c = 1; c <= m_layout.changesets(); ++c) {
+      const auto created = m_versions.changeset_created(c);
+      // num_changes and the bounding box are filled in at the end
+      write(stream, c, m_versions.user(c), format_timestamp(created),
+            format_timestamp(created + 3'600), 0);
+    }
+    stream.complete();
+  }
+
+  // nodes
+
+  [[nodiscard]] bool poi(osm_nwr_id_t id) const { return id >= m_layout.first_poi(); }
+
+  [[nodiscard]] int64_t node_versions(osm_nwr_id_t id) const {
+    return m_versions.count(stream_kind::node, id, m_layout.nodes());
+  }
+
+  // a few POIs have been deleted, leaving only their history
+  [[nodiscard]] bool deleted(osm_nwr_id_t id, int64_t count) const {
+    return poi(id) && count > 1 && mix(m_layout.params().seed ^ id) % 50 == 0;
+  }
+
+  [[nodiscard]] tag_list node_tags(osm_nwr_id_t id) const {
+    element_rng rng(m_layout.params().seed, stream_kind::node, id, 2);
+    tag_list tags;
+    if (!poi(id)) {
+      if (rng.chance(0.03)) {
+        const auto kind = way_node_kind.pick(rng);
+        if (kind == "crossing")
+          tags.emplace_back("highway", "crossing");
+        else if (kind == "traffic_signals")
+          tags.emplace_back("highway", "traffic_signals");
+        else if (kind == "stop")
+          tags.emplace_back("highway", "stop");
+        else
+          tags.emplace_back("highway", "street_lamp");
+      }
+      return tags;
+    }
+
+    const auto kind = poi_kind.pick(rng);
+    if (kind == "amenity") {
+      tags.emplace_back("amenity", poi_amenity.pick(rng));
+      if (rng.chance(0.6))
+        tags.emplace_back("name", fmt::format("{} {}", name_words[rng() % name_words.size()], id % 97));
+      if (rng.chance(0.3))
+        tags.emplace_back("opening_hours", "Mo-Fr 08:00-18:00; Sa 09:00-14:00");
+    } else if (kind == "shop") {
+      tags.emplace_back("shop", poi_shop.pick(rng));
+      tags.emplace_back("name", fmt::format("{} & Söhne", name_words[rng() % name_words.size()]));
+      if (rng.chance(0.5))
+        tags.emplace_back("addr:street", street_name(rng()));
+    } else if (kind == "tree") {
+      tags.emplace_back("natural", "tree");
+      if (rng.chance(0.2))
+        tags.emplace_back("leaf_type", rng.chance(0.7) ? "broadleaved" : "needleleaved");
+    } else if (kind == "bus_stop") {
+      tags.emplace_back("highway", "bus_stop");
+      tags.emplace_back("public_transport", "platform");
+      tags.emplace_back("name", fmt::format("{}platz", name_words[rng() % name_words.size()]));
+      tags.emplace_back("bus", "yes");
+    } else {
+      tags.emplace_back("addr:housenumber", std::to_string(rng.between(1, 200)));
+      tags.emplace_back("addr:street", street_name(rng()));
+      tags.emplace_back("addr:postcode", fmt::format("{:05d}", rng.between(1'000, 99'999)));
+    }
+    if (rng.chance(0.1))
+      tags.emplace_back("source", "survey");
+    return tags;
+  }
+
+  // older versions were slightly displaced
+  [[nodiscard]] lat_lon node_location(osm_nwr_id_t id, lat_lon current, int64_t version,
+                                      int64_t count) const {
+    if (version == count)
+      return current;
+    element_rng rng(m_layout.params().seed, stream_kind::node, id, 3 + version);
+    return m_layout.clamp({ current.lat + rng.normal() * 0.00005,
+                            current.lon + rng.normal() * 0.00005 });
+  }
+
+  void write_nodes(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "nodes" : "current_nodes",
+        history ? "node_id, latitude, longitude, changeset_id, visible, timestamp, tile, version"
+                : "id, latitude, longitude, changeset_id, visible, timestamp, tile, version");
+
+    m_layout.for_each_node([&](osm_nwr_id_t id, lat_lon location) {
+      const auto count = node_versions(id);
+      const auto first = history ? 1 : count;
+      for (auto v = first; v <= count; ++v) {
+        const auto pos = node_location(id, location, v, count);
+        const auto c = m_versions.changeset(stream_kind::node, id, v, count);
+        write(stream, id, std::lround(pos.lat * coordinate_scale), std::lround(pos.lon * coordinate_scale), c,
+              !(v == count && deleted(id, count)),
+              format_timestamp(m_versions.timestamp(c, id, v)),
+              static_cast<int64_t>(xy2tile(lon2x(pos.lon), lat2y(pos.lat))), v);
+      }
+    });
+    stream.complete();
+  }
+
+  void write_node_tags(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "node_tags" : "current_node_tags",
+                          history ? "node_id, version, k, v" : "node_id, k, v");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.nodes(); ++id) {
+      const auto count = node_versions(id);
+      const bool is_deleted = deleted(id, count);
+      if (!history && is_deleted)
+        continue;
+      const auto tags = node_tags(id);
+      if (tags.empty())
+        continue;
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        if (v == count && is_deleted)
+          continue;
+        const auto n = tags_in_version(tags.size(), v, count);
+        for (std::size_t i = 0; i < n; ++i) {
+          if (history)
+            write(stream, id, v, tags[i].first, tags[i].second);
+          else
+            write(stream, id, tags[i].first, tags[i].second);
+        }
+      }
+    }
+    stream.complete();
+  }
+
+  // ways
+
+  [[nodiscard]] int64_t way_versions(osm_nwr_id_t id) const {
+    return m_versions.count(stream_kind::way, id, m_layout.ways());
+  }
+
+  [[nodiscard]] tag_list way_tags(osm_nwr_id_t id) const {
+    element_rng rng(m_layout.params().seed, stream_kind::way, id, 2);
+    tag_list tags;
+
+    switch (m_layout.kind(id)) {
+    case way_kind::building:
+      tags.emplace_back("building", building_value.pick(rng));
+      if (rng.chance(0.4)) {
+        tags.emplace_back("addr:housenumber", std::to_string(rng.between(1, 200)));
+        tags.emplace_back("addr:street", street_name(rng()));
+      }
+      if (rng.chance(0.1))
+        tags.emplace_back("building:levels", std::to_string(rng.between(1, 8)));
+      break;
+
+    case way_kind::highway: {
+      const auto highway = highway_value.pick(rng);
+      tags.emplace_back("highway", highway);
+      if (highway != "service" && highway != "footway" && highway != "track" &&
+          highway != "cycleway" && rng.chance(0.8))
+        tags.emplace_back("name", street_name(rng()));
+      if (rng.chance(0.2))
+        tags.emplace_back("maxspeed", std::array{"30", "50", "70", "100"}[rng() % 4]);
+      if (rng.chance(0.25))
+        tags.emplace_back("surface", std::array{"asphalt", "paved", "gravel", "sett"}[rng() % 4]);
+      if (rng.chance(0.08))
+        tags.emplace_back("oneway", "yes");
+      if (rng.chance(0.1))
+        tags.emplace_back("lit", "yes");
+      break;
+    }
+
+    case way_kind::long_way: {
+      const auto kind = long_way_kind.pick(rng);
+      if (kind == "river") {
+        tags.emplace_back("waterway", "river");
+        tags.emplace_back("name", fmt::format("{}bach", name_words[rng() % name_words.size()]));
+      } else if (kind == "rail") {
+        tags.emplace_back("railway", "rail");
+        tags.emplace_back("usage", "main");
+        tags.emplace_back("electrified", "contact_line");
+        tags.emplace_back("gauge", "1435");
+      } else if (kind == "motorway") {
+        tags.emplace_back("highway", "motorway");
+        tags.emplace_back("ref", fmt::format("A {}", rng.between(1, 99)));
+        tags.emplace_back("oneway", "yes");
+        tags.emplace_back("lanes", std::to_string(rng.between(2, 4)));
+      } else if (kind == "coastline") {
+        tags.emplace_back("natural", "coastline");
+      }
+      // boundary segments are untagged, their relations carry the tags
+      break;
+    }
+    }
+    return tags;
+  }
+
+  // older versions of longer ways lacked their last node every other version
+  [[nodiscard]] std::size_t nodes_in_version(const nodes_t &nodes, osm_nwr_id_t id,
+                                             int64_t version, int64_t count) const {
+    if (nodes.size() <= 2 || m_layout.kind(id) == way_kind::building)
+      return nodes.size();
+    return tags_in_version(nodes.size(), version, count);
+  }
+
+  void write_ways(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "ways" : "current_ways",
+        history ? "way_id, changeset_id, timestamp, version, visible"
+                : "id, changeset_id, timestamp, version, visible");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.ways(); ++id) {
+      const auto count = way_versions(id);
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto c = m_versions.changeset(stream_kind::way, id, v, count);
+        write(stream, id, c, format_timestamp(m_versions.timestamp(c, id, v)), v, true);
+      }
+    }
+    stream.complete();
+  }
+
+  void write_way_tags(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "way_tags" : "current_way_tags",
+                          history ? "way_id, version, k, v" : "way_id, k, v");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.ways(); ++id) {
+      const auto count = way_versions(id);
+      const auto tags = way_tags(id);
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto n = tags_in_version(tags.size(), v, count);
+        for (std::size_t i = 0; i < n; ++i) {
+          if (history)
+            write(stream, id, v, tags[i].first, tags[i].second);
+          else
+            write(stream, id, tags[i].first, tags[i].second);
+        }
+      }
+    }
+    stream.complete();
+  }
+
+  void write_way_nodes(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "way_nodes" : "current_way_nodes",
+                          history ? "way_id, node_id, version, sequence_id"
+                                  : "way_id, node_id, sequence_id");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.ways(); ++id) {
+      const auto count = way_versions(id);
+      const auto nodes = m_layout.way_nodes(id);
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto n = nodes_in_version(nodes, id, v, count);
+        for (std::size_t i = 0; i < n; ++i) {
+          if (history)
+            write(stream, id, nodes[i], v, static_cast<int64_t>(i + 1));
+          else
+            write(stream, id, nodes[i], static_cast<int64_t>(i + 1));
+        }
+      }
+    }
+    stream.complete();
+  }
+
+  // relations
+
+  struct relation_data {
+    members_t members;
+    tag_list tags;
+  };
+
+  [[nodiscard]] int64_t relation_versions(osm_nwr_id_t id) const {
+    return m_versions.count(stream_kind::relation, id, m_layout.relations());
+  }
+
+  [[nodiscard]] bool route_master(osm_nwr_id_t id) const { return id % 20 == 0; }
+
+  [[nodiscard]] osm_nwr_id_t first_boundary() const {
+    return m_layout.relations() - m_layout.params().relation_depth + 1;
+  }
+
+  [[nodiscard]] relation_data relation(osm_nwr_id_t id) const {
+    element_rng rng(m_layout.params().seed, stream_kind::relation, id, 2);
+    relation_data r;
+    const auto ways = m_layout.ways();
+
+    if (id >= first_boundary()) {
+      // chain of administrative boundaries, each containing the next
+      // lower level, the lowest one containing route masters
+      const auto level = 2 + static_cast<int>(m_layout.relations() - id);
+      if (id == first_boundary()) {
+        for (auto sub = (id - 1) - (id - 1) % 20; sub > 0 && r.members.size() < 10; sub -= 20)
+          r.members.emplace_back(element_type::relation, sub, "subarea");
+      } else {
+        r.members.emplace_back(element_type::relation, id - 1, "subarea");
+      }
+      const auto first_way = 1 + rng() % ways;
+      for (osm_nwr_id_t w = 0; w < 20; ++w)
+        r.members.emplace_back(element_type::way, 1 + (first_way + w) % ways, "outer");
+      r.members.emplace_back(element_type::node, m_layout.first_node(first_way), "admin_centre");
+      r.tags = { { "type", "boundary" }, { "boundary", "administrative" },
+                 { "admin_level", std::to_string(level) },
+                 { "name", fmt::format("{}kreis {}", name_words[rng() % name_words.size()], level) } };
+      return r;
+    }
+
+    if (route_master(id)) {
+      for (auto sub = id - 19; sub < id; ++sub)
+        r.members.emplace_back(element_type::relation, sub, "");
+      r.tags = { { "type", "route_master" }, { "route_master", "bus" },
+                 { "name", fmt::format("Linie {}", id / 20) } };
+      return r;
+    }
+
+    const auto first_way = 1 + rng() % ways;
+    const double kind = rng.uniform();
+    if (kind < 0.45) {
+      r.members.emplace_back(element_type::way, first_way, "outer");
+      const auto inner = rng.between(0, 3);
+      for (int64_t i = 1; i <= inner; ++i)
+        r.members.emplace_back(element_type::way, 1 + (first_way + i - 1) % ways, "inner");
+      r.tags = { { "type", "multipolygon" }, { "landuse", std::string(landuse_value.pick(rng)) } };
+    } else if (kind < 0.85) {
+      const auto length = std::clamp<int64_t>(std::lround(std::exp(3.0 + rng.normal() * 0.8)), 5, 500);
+      for (int64_t i = 0; i < length; ++i) {
+        const auto way = 1 + (first_way + i - 1) % ways;
+        if (i % 10 == 0)
+          r.members.emplace_back(element_type::node, m_layout.first_node(way), "stop");
+        r.members.emplace_back(element_type::way, way, "");
+      }
+      r.tags = { { "type", "route" }, { "route", std::string(route_value.pick(rng)) },
+                 { "ref", std::to_string(rng.between(1, 999)) },
+                 { "name", fmt::format("{} – {}", street_name(rng()), street_name(rng())) } };
+    } else {
+      const auto to = 1 + first_way % ways;
+      r.members.emplace_back(element_type::way, first_way, "from");
+      r.members.emplace_back(element_type::node, m_layout.first_node(to), "via");
+      r.members.emplace_back(element_type::way, to, "to");
+      r.tags = { { "type", "restriction" },
+                 { "restriction", rng.chance(0.6) ? "no_left_turn" : "no_u_turn" } };
+    }
+    return r;
+  }
+
+  void write_relations(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "relations" : "current_relations",
+        history ? "relation_id, changeset_id, timestamp, version, visible"
+                : "id, changeset_id, timestamp, version, visible");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.relations(); ++id) {
+      const auto count = relation_versions(id);
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto c = m_versions.changeset(stream_kind::relation, id, v, count);
+        write(stream, id, c, format_timestamp(m_versions.timestamp(c, id, v)), v, true);
+      }
+    }
+    stream.complete();
+  }
+
+  void write_relation_tags(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "relation_tags" : "current_relation_tags",
+                          history ? "relation_id, version, k, v" : "relation_id, k, v");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.relations(); ++id) {
+      const auto count = relation_versions(id);
+      const auto tags = relation(id).tags;
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto n = tags_in_version(tags.size(), v, count);
+        for (std::size_t i = 0; i < n; ++i) {
+          if (history)
+            write(stream, id, v, tags[i].first, tags[i].second);
+          else
+            write(stream, id, tags[i].first, tags[i].second);
+        }
+      }
+    }
+    stream.complete();
+  }
+
+  void write_relation_members(pqxx::work &txn, bool history) {
+    Stream_Wrapper stream(txn, history ? "relation_members" : "current_relation_members",
+        history ? "relation_id, member_type, member_id, member_role, version, sequence_id"
+                : "relation_id, member_type, member_id, member_role, sequence_id");
+
+    for (osm_nwr_id_t id = 1; id <= m_layout.relations(); ++id) {
+      const auto count = relation_versions(id);
+      const auto members = relation(id).members;
+      for (auto v = history ? 1 : count; v <= count; ++v) {
+        const auto n = members.size() > 1 ? tags_in_version(members.size(), v, count) : members.size();
+        for (std::size_t i = 0; i < n; ++i) {
+          const auto &m = members[i];
+          const auto type = element_type_name(m.type);
+          if (history)
+            write(stream, id, type, m.ref, m.role, v, static_cast<int>(i + 1));
+          else
+            write(stream, id, type, m.ref, m.role, static_cast<int>(i + 1));
+        }
+      }
+    }
+    stream.complete();
+  }
+
+  static std::string_view element_type_name(element_type type) {
+    switch (type) {
+    case element_type::node:
+      return "Node";
+    case element_type::way:
+      return "Way";
+    case element_type::relation:
+      return "Relation";
+    default:
+      throw std::runtime_error("Unexpected member type");
+    }
+  }
+
+  void finish() {
+    const auto start = std::chrono::steady_clock::now();
+    pqxx::work txn(m_conn);
+    txn.exec(R"(
+      WITH changes AS (
+        SELECT changeset_id, count(*) AS num FROM (
+          SELECT changeset_id FROM nodes
+          UNION ALL SELECT changeset_id FROM ways
+          UNION ALL SELECT changeset_id FROM relations) AS c
+        GROUP BY changeset_id),
+      bbox AS (
+        SELECT changeset_id, min(latitude) AS min_lat, max(latitude) AS max_lat,
+               min(longitude) AS min_lon, max(longitude) AS max_lon
+        FROM nodes GROUP BY changeset_id)
+      UPDATE changesets
+      SET num_changes = changes.num,
+          min_lat = bbox.min_lat, max_lat = bbox.max_lat,
+          min_lon = bbox.min_lon, max_lon = bbox.max_lon
+      FROM changes LEFT JOIN bbox USING (changeset_id)
+      WHERE changesets.id = changes.changeset_id)");
+
+    txn.exec(R"(
+      SELECT setval('users_id_seq', (SELECT max(id) FROM users));
+      SELECT setval('changesets_id_seq', (SELECT max(id) FROM changesets));
+      SELECT setval('current_nodes_id_seq', (SELECT max(id) FROM current_nodes));
+      SELECT setval('current_ways_id_seq', (SELECT max(id) FROM current_ways));
+      SELECT setval('current_relations_id_seq', (SELECT max(id) FROM current_relations));
+      UPDATE users SET changesets_count = c.num
+      FROM (SELECT user_id, count(*) AS num FROM changesets GROUP BY user_id) AS c
+      WHERE users.id = c.user_id)");
+    txn.commit();
+
+    // ANALYZE can't run inside a transaction block
+    pqxx::nontransaction analyze(m_conn);
+    analyze.exec("ANALYZE");
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    std::cout << fmt::format("{:<26} {:>17} {:>9.1f} s\n", "changeset stats, ANALYZE", "", elapsed.count());
+  }
+
+  const layout &m_layout;
+  const versions m_versions;
+  pqxx::connection &m_conn;
+  int64_t m_rows = 0;
+};
+
+std::string connect_db_str(const po::variables_map &options) {
+  std::ostringstream ostr;
+  ostr << "dbname=" << escape_pg_value(options["dbname"].as<std::string>());
+  if (options.contains("host"))
+    ostr << " host=" << escape_pg_value(options["host"].as<std::string>());
+  if (options.contains("username"))
+    ostr << " user=" << escape_pg_value(options["username"].as<std::string>());
+  if (options.contains("password"))
+    ostr << " password=" << escape_pg_value(options["password"].as<std::string>());
+  if (options.contains("dbport"))
+    ostr << " port=" << escape_pg_value(options["dbport"].as<std::string>());
+  ostr << " fallback_application_name=cgimap-generate-test-data";
+  return ostr.str();
+}
+
+std::string read_file_contents(const std::filesystem::path &filename) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  if (!in)
+    throw std::runtime_error(fmt::format("Unable to open {}", filename.string()));
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+std::optional<generator_params> get_params(const po::variables_map &vm) {
+  generator_params p;
+
+  const auto scale = vm["scale"].as<std::string>();
+  const auto preset = std::ranges::find(scale_presets, scale, &scale_preset::name);
+  if (preset == scale_presets.end()) {
+    std::cerr << fmt::format("Error: unknown --scale {}, expected town, city or country\n", scale);
+    return {};
+  }
+  p.nodes = preset->nodes;
+  std::tie(p.min_lon, p.min_lat, p.max_lon, p.max_lat) =
+      std::tuple(preset->bbox[0], preset->bbox[1], preset->bbox[2], preset->bbox[3]);
+  p.cities = preset->cities;
+  p.users = preset->users;
+
+  if (vm.contains("nodes"))
+    p.nodes = vm["nodes"].as<int64_t>();
+  if (vm.contains("bbox")) {
+    const auto bbox = vm["bbox"].as<std::string>();
+    if (std::sscanf(bbox.c_str(), "%lf,%lf,%lf,%lf", &p.min_lon, &p.min_lat, &p.max_lon, &p.max_lat) != 4 ||
+        p.min_lon >= p.max_lon || p.min_lat >= p.max_lat) {
+      std::cerr << "Error: --bbox must be min_lon,min_lat,max_lon,max_lat\n";
+      return {};
+    }
+  }
+  if (vm.contains("cities"))
+    p.cities = vm["cities"].as<int>();
+  if (vm.contains("users"))
+    p.users = vm["users"].as<int>();
+  p.urban_share = vm["urban-share"].as<double>();
+  p.hot_elements = vm["hot-elements"].as<int>();
+  p.hot_versions = vm["hot-versions"].as<int>();
+  p.relation_depth = vm["relation-depth"].as<int>();
+  p.seed = vm["seed"].as<uint64_t>();
+
+  if (p.nodes < 1'000 || p.users < 1 || p.hot_versions < 1 || p.relation_depth < 1 ||
+      p.urban_share < 0 || p.urban_share > 1) {
+    std::cerr << "Error: --nodes must be at least 1000, --users, --hot-versions and "
+                 "--relation-depth at least 1, --urban-share between 0 and 1\n";
+    return {};
+  }
+  return p;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+  po::options_description desc("Test data generator options");
+  desc.add_options()
+    ("help", "show this help")
+    ("dbname", po::value<std::string>()->required(), "database name")
+    ("host", po::value<std::string>(), "database server host")
+    ("username", po::value<std::string>(), "database user name")
+    ("password", po::value<std::string>(), "database password")
+    ("dbport", po::value<std::string>(), "database port number or UNIX socket file name")
+    ("db-schema", po::value<std::string>(), "create the schema from this file first, e.g. test/structure.sql")
+    ("scale", po::value<std::string>()->default_value("town"), "preset: town, city or country")
+    ("nodes", po::value<int64_t>(), "number of nodes, overrides the preset")
+    ("bbox", po::value<std::string>(), "area as min_lon,min_lat,max_lon,max_lat, overrides the preset")
+    ("cities", po::value<int>(), "number of dense urban clusters, overrides the preset")
+    ("users", po::value<int>(), "number of users, overrides the preset")
+    ("urban-share", po::value<double>()->default_value(0.8), "share of features in urban clusters")
+    ("hot-elements", po::value<int>()->default_value(10), "elements per type with many versions")
+    ("hot-versions", po::value<int>()->default_value(2'000), "versions of each hot element")
+    ("relation-depth", po::value<int>()->default_value(10), "length of the nested boundary relation chain")
+    ("seed", po::value<uint64_t>()->default_value(42), "random seed");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.contains("help")) {
+      std::cout << desc << '\n';
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+  } catch (const po::error &e) {
+    std::cerr << "Error: " << e.what() << "\n\n" << desc << '\n';
+    return EXIT_FAILURE;
+  }
+
+  const auto params = get_params(vm);
+  if (!params)
+    return EXIT_FAILURE;
+
+  try {
+    pqxx::connection conn(connect_db_str(vm));
+
+    if (vm.contains("db-schema")) {
+      pqxx::work txn(conn);
+      txn.exec(read_file_contents(vm["db-schema"].as<std::string>()));
+      txn.commit();
+    }
+
+    {
+      pqxx::nontransaction txn(conn);
+      if (txn.exec("SELECT EXISTS (SELECT 1 FROM current_nodes) OR EXISTS (SELECT 1 FROM users)")[0][0].as<bool>()) {
+        std::cerr << "Error: the database already contains data\n";
+        return EXIT_FAILURE;
+      }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const layout l(*params);
+    std::cout << fmt::format("generating {} nodes ({} in ways), {} ways, {} relations, {} changesets\n",
+                             l.nodes(), l.first_poi() - 1, l.ways(), l.relations(), l.changesets());
+
+    generator(l, conn).run();
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    std::cout << fmt::format("done in {:.1f} s\n", elapsed.count());
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
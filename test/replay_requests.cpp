@@ -0,0 +1,336 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+/*
+ * Request replay
+ *
+ * Replays requests captured with --capture-file through process_request
+ * against a test or staging database, without FastCGI in between, and
+ * compares the latency distribution per route with the one originally
+ * captured.
+ *
+ * Not part of the test suite. Requests are replayed at their original
+ * pacing, faster or slower with --speed, or as fast as possible with
+ * --speed 0, e.g.:
+ *
+ *   ./replay_requests --capture cgimap.capture --dbname osm_staging \
+ *       --speed 2 --concurrency 8 --json replay.json
+ *
+ * Only GET and HEAD requests are replayed, as payloads aren't captured.
+ * Authenticated requests are replayed anonymously, since credentials
+ * aren't captured either.
+ */
+
+#include "cgimap/backend.hpp"
+#include "cgimap/backend/apidb/apidb.hpp"
+#include "cgimap/backend/memory/memory.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/process_request.hpp"
+#include "cgimap/rate_limiter.hpp"
+#include "cgimap/request_capture.hpp"
+#include "cgimap/routes.hpp"
+
+#include "test_request.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct replay_params {
+  double speed = 1.0;      // 0 to replay as fast as possible
+  int concurrency = 4;
+  std::size_t limit = 0;   // 0 to replay all requests
+};
+
+struct sample {
+  const request_capture::record *original;
+  clock_type::duration elapsed;
+  clock_type::duration lag;    // how late the request started
+  int status;
+};
+
+struct summary {
+  std::string name;
+  std::size_t count = 0;
+  std::size_t status_changed = 0;
+  double original_p50 = 0;
+  double original_p90 = 0;
+  double original_p99 = 0;
+  double replay_p50 = 0;
+  double replay_p90 = 0;
+  double replay_p99 = 0;
+};
+
+double ms(clock_type::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+double percentile(const std::vector<double> &sorted, double q) {
+  if (sorted.empty())
+    return 0;
+  const auto rank = static_cast<std::size_t>(std::ceil(q * sorted.size()));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+summary summarise(const std::string &name, const std::vector<const sample *> &samples) {
+  summary s{ .name = name, .count = samples.size() };
+
+  std::vector<double> original;
+  std::vector<double> replay;
+  for (const auto *x : samples) {
+    original.push_back(ms(x->original->duration));
+    replay.push_back(ms(x->elapsed));
+    if (x->status != x->original->status)
+      ++s.status_changed;
+  }
+  std::ranges::sort(original);
+  std::ranges::sort(replay);
+
+  s.original_p50 = percentile(original, 0.5);
+  s.original_p90 = percentile(original, 0.9);
+  s.original_p99 = percentile(original, 0.99);
+  s.replay_p50 = percentile(replay, 0.5);
+  s.replay_p90 = percentile(replay, 0.9);
+  s.replay_p99 = percentile(replay, 0.99);
+  return s;
+}
+
+std::vector<request_capture::record> read_capture(const std::string &filename,
+                                                  std::size_t limit,
+                                                  std::size_t &skipped) {
+  request_capture::reader reader(filename);
+  std::vector<request_capture::record> result;
+
+  while (auto r = reader.next()) {
+    if (r->method != "GET" && r->method != "HEAD") {
+      ++skipped;
+      continue;
+    }
+    result.push_back(std::move(*r));
+    if (limit > 0 && result.size() == limit)
+      break;
+  }
+
+  // all processes of a daemon append to the same file, so records are
+  // only roughly in order
+  std::ranges::stable_sort(result, {}, &request_capture::record::time);
+  return result;
+}
+
+sample run_request(const request_capture::record &r, const routes &route,
+                   rate_limiter &limiter, data_selection::factory &factory,
+                   clock_type::duration lag) {
+  test_request req;
+  req.set_header("REQUEST_METHOD", r.method);
+  req.set_header("REQUEST_URI", r.query.empty() ? r.path : r.path + "?" + r.query);
+  req.set_header("REMOTE_ADDR", "127.0.0.1");
+  if (!r.accept.empty())
+    req.set_header("HTTP_ACCEPT", r.accept);
+  if (!r.accept_encoding.empty())
+    req.set_header("HTTP_ACCEPT_ENCODING", r.accept_encoding);
+  if (!r.error_format.empty())
+    req.set_header("HTTP_X_ERROR_FORMAT", r.error_format);
+  req.set_current_time(std::chrono::system_clock::now());
+
+  const auto start = clock_type::now();
+  process_request(req, limiter, "replay", route, factory, nullptr);
+  const auto elapsed = clock_type::now() - start;
+
+  return { &r, elapsed, lag, req.response_status() };
+}
+
+void print_summary(const summary &s) {
+  std::cout << fmt::format("{:<28} {:>7} {:>7} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}\n",
+                           s.name, s.count, s.status_changed,
+                           s.original_p50, s.replay_p50, s.original_p90, s.replay_p90,
+                           s.original_p99, s.replay_p99);
+}
+
+std::string to_json(const summary &s) {
+  return fmt::format(R"({{"name": "{}", "count": {}, "status_changed": {}, )"
+                     R"("original_p50_ms": {:.3f}, "original_p90_ms": {:.3f}, "original_p99_ms": {:.3f}, )"
+                     R"("replay_p50_ms": {:.3f}, "replay_p90_ms": {:.3f}, "replay_p99_ms": {:.3f}}})",
+                     s.name, s.count, s.status_changed,
+                     s.original_p50, s.original_p90, s.original_p99,
+                     s.replay_p50, s.replay_p90, s.replay_p99);
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+  replay_params p;
+  std::string capture_file;
+  std::string json_file;
+
+  register_backend(make_apidb_backend());
+  register_backend(make_memory_backend());
+  register_backend(make_snapshot_backend());
+
+  po::options_description desc("Replay options");
+  desc.add_options()
+    ("help", "show this help")
+    ("capture", po::value(&capture_file)->required(), "file captured via --capture-file")
+    ("speed", po::value(&p.speed), "replay speed relative to the original pacing, 0 for as fast as possible")
+    ("concurrency", po::value(&p.concurrency), "number of concurrent workers")
+    ("limit", po::value(&p.limit), "replay at most this many requests")
+    ("json", po::value(&json_file), "write results as JSON to this file");
+
+  po::variables_map vm;
+  try {
+    // adds the database connection options
+    setup_backend_options(argc, argv, desc);
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.contains("help")) {
+      std::cout << desc << '\n';
+      output_backend_options(std::cout);
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+  } catch (const po::error &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (p.speed < 0 || p.concurrency < 1) {
+    std::cerr << "Error: --speed must not be negative, --concurrency must be at least 1\n";
+    return EXIT_FAILURE;
+  }
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+
+  try {
+    // loads the data of the memory backend once for all workers
+    prepare_backend(vm);
+
+    std::size_t skipped = 0;
+    const auto records = read_capture(capture_file, p.limit, skipped);
+    const auto authenticated = std::ranges::count_if(records, &request_capture::record::authenticated);
+
+    std::cout << fmt::format("replaying {} requests ({} authenticated ones anonymously), "
+                             "skipping {} other than GET or HEAD\n",
+                             records.size(), authenticated, skipped);
+    if (records.empty())
+      return EXIT_SUCCESS;
+
+    std::vector<std::vector<sample>> worker_samples(p.concurrency);
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    const auto first = records.front().time;
+    const auto start = clock_type::now();
+
+    // when each request is due, relative to the start of the replay
+    const auto due = [&](const request_capture::record &r) {
+      if (p.speed == 0)
+        return start;
+      return start + std::chrono::duration_cast<clock_type::duration>((r.time - first) / p.speed);
+    };
+
+    {
+      std::vector<std::jthread> workers;
+      for (int w = 0; w < p.concurrency; ++w) {
+        workers.emplace_back([&, w] {
+          try {
+            // each worker has its own database connection, like a
+            // cgimap instance
+            auto factory = create_backend(vm);
+            const routes route;
+            null_rate_limiter limiter;
+
+            for (auto i = next++; i < records.size() && !failed; i = next++) {
+              const auto when = due(records[i]);
+              std::this_thread::sleep_until(when);
+              const auto lag = std::max(clock_type::now() - when, clock_type::duration::zero());
+              worker_samples[w].push_back(run_request(records[i], route, limiter, *factory, lag));
+            }
+          } catch (const std::exception &e) {
+            std::cerr << fmt::format("Worker {} failed: {}\n", w, e.what());
+            failed = true;
+          }
+        });
+      }
+    }
+
+    if (failed)
+      return EXIT_FAILURE;
+
+    const auto wall = clock_type::now() - start;
+
+    std::map<std::string, std::vector<const sample *>> by_route;
+    std::vector<const sample *> all;
+    std::vector<double> lags;
+    for (const auto &samples : worker_samples) {
+      for (const auto &s : samples) {
+        by_route[s.original->route].push_back(&s);
+        all.push_back(&s);
+        lags.push_back(ms(s.lag));
+      }
+    }
+    std::ranges::sort(lags);
+
+    std::vector<summary> summaries;
+    for (const auto &[name, samples] : by_route)
+      summaries.push_back(summarise(name, samples));
+    const auto total = summarise("all", all);
+
+    std::cout << fmt::format("\n{:<28} {:>7} {:>7} {:>19} {:>19} {:>19}\n",
+                             "", "", "status", "p50 ms", "p90 ms", "p99 ms");
+    std::cout << fmt::format("{:<28} {:>7} {:>7} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9}\n",
+                             "route", "count", "changed", "original", "replay",
+                             "original", "replay", "original", "replay");
+    for (const auto &s : summaries)
+      print_summary(s);
+    print_summary(total);
+
+    // if requests start late, the replay can't keep up with the pacing,
+    // and latencies are not comparable
+    std::cout << fmt::format("\n{:.1f} requests/s over {:.1f} s, start lag p50 {:.2f} ms, p99 {:.2f} ms\n",
+                             all.size() / std::chrono::duration<double>(wall).count(),
+                             std::chrono::duration<double>(wall).count(),
+                             percentile(lags, 0.5), percentile(lags, 0.99));
+
+    if (!json_file.empty()) {
+      std::ofstream out(json_file);
+      out << "{\n"
+          << fmt::format(R"(  "version": "{}", "speed": {}, "concurrency": {}, "requests": {}, )",
+                         PACKAGE_VERSION, p.speed, p.concurrency, all.size())
+          << fmt::format(R"("lag_p50_ms": {:.3f}, "lag_p99_ms": {:.3f},)",
+                         percentile(lags, 0.5), percentile(lags, 0.99))
+          << "\n  \"total\": " << to_json(total) << ",\n"
+          << "  \"routes\": [\n";
+      for (std::size_t i = 0; i < summaries.size(); ++i)
+        out << "    " << to_json(summaries[i]) << (i + 1 < summaries.size() ? ",\n" : "\n");
+      out << "  ]\n}\n";
+    }
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
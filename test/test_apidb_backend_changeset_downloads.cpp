@@ -12,8 +12,14 @@
 #include <sys/time.h>
 #include <cstdio>
 
+#include "cgimap/options.hpp"
+#include "cgimap/process_request.hpp"
+#include "cgimap/rate_limiter.hpp"
+#include "cgimap/routes.hpp"
+
 #include "test_formatter.hpp"
 #include "test_database.hpp"
+#include "test_request.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/reporters/catch_reporter_event_listener.hpp>
@@ -21,6 +27,13 @@
 #include <catch2/catch_session.hpp>
 
 
+class global_settings_request_memory_test_class : public global_settings_default {
+
+public:
+  // enough for selecting the changeset, but not for its elements
+  std::optional<uint64_t> get_request_memory_max() const override { return 2 * 1024 * 1024; }
+};
+
 class DatabaseTestsFixture
 {
 public:
@@ -279,6 +292,61 @@ TEST_CASE_METHOD( DatabaseTestsFixture, "test_changeset_redacted", "[changeset][
   }
 }
 
+TEST_CASE_METHOD( DatabaseTestsFixture, "test_changeset_download_memory_limit", "[changeset][db]" ) {
+
+  global_settings::set_configuration(std::make_unique<global_settings_request_memory_test_class>());
+
+  const std::string generator = "Test";
+
+  auto sel_factory = tdb.get_data_selection_factory();
+  auto upd_factory = tdb.get_data_update_factory();
+
+  null_rate_limiter limiter;
+  routes route;
+
+  SECTION("Initialize test data") {
+
+    // 5000 nodes with 10 tags of 200 characters each, about 10 MB in total
+    tdb.run_sql(R"(
+      INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+      VALUES
+        (1, 'user_1@example.com', '', '2017-03-19T19:13:00Z', 'user_1', true);
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at, num_changes)
+      VALUES
+        (1, 1, '2017-03-19T19:13:00Z', '2017-03-19T19:13:00Z', 5000);
+
+      INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+      SELECT id, 90000000, 90000000, 1, true, '2017-03-19T19:13:00Z', 3229120632, 1
+      FROM generate_series(1, 5000) AS id;
+
+      INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible,
+                         "timestamp", tile, version, redaction_id)
+      SELECT id, 90000000, 90000000, 1, true, '2017-03-19T19:13:00Z', 3229120632, 1, NULL
+      FROM generate_series(1, 5000) AS id;
+
+      INSERT INTO node_tags (node_id, version, k, v)
+      SELECT id, 1, 'key_' || k, repeat('v', 200)
+      FROM generate_series(1, 5000) AS id, generate_series(1, 10) AS k;
+      )");
+  }
+
+  SECTION("Exceeding the limit results in a 413 response") {
+
+    test_request req;
+    req.set_header("REQUEST_METHOD", "GET");
+    req.set_header("REQUEST_URI", "/api/0.6/changeset/1/download");
+    req.set_header("REMOTE_ADDR", "127.0.0.1");
+
+    process_request(req, limiter, generator, route, *sel_factory, upd_factory.get());
+
+    CAPTURE(req.body().str());
+    CHECK(req.response_status() == 413);
+  }
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+}
+
 int main(int argc, char *argv[]) {
   Catch::Session session;
 
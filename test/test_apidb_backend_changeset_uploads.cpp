@@ -1981,14 +1981,16 @@ std::vector<api06::diffresult_t> process_payload(test_database &tdb, osm_changes
   auto way_updater = upd->get_way_updater(ctx, change_tracking);
   auto relation_updater = upd->get_relation_updater(ctx, change_tracking);
 
-  changeset_updater->lock_current_changeset(true);
-
   api06::OSMChange_Handler handler(*node_updater, *way_updater, *relation_updater, changeset);
 
   api06::OSMChangeXMLParser parser(handler);
 
   parser.process_message(payload);
 
+  changeset_updater->lock_current_changeset(true);
+
+  handler.process_changes();
+
   auto diffresult = change_tracking.assemble_diffresult();
 
   changeset_updater->update_changeset(handler.get_num_changes(),
@@ -2069,6 +2071,47 @@ TEST_CASE_METHOD( DatabaseTestsFixture, "test_osmchange_message", "[changeset][u
 
   }
 
+  // Validation happens on the complete upload, before the changeset gets
+  // locked. Changeset 2 is already closed.
+
+  SECTION("Duplicate placeholder ids are rejected before any database access") {
+
+    REQUIRE_THROWS_MATCHES(process_payload(tdb, 2, 1, R"(<?xml version="1.0" encoding="UTF-8"?>
+        <osmChange version="0.6" generator="iD">
+           <create>
+              <node id="-1" lon="11" lat="46" version="0" changeset="2"/>
+              <node id="-1" lon="12" lat="47" version="0" changeset="2"/>
+           </create>
+        </osmChange>
+      )"), http::bad_request, Catch::Matchers::Message("Placeholder IDs must be unique for created elements."));
+  }
+
+  SECTION("Unknown placeholder way nodes are rejected before any database access") {
+
+    REQUIRE_THROWS_MATCHES(process_payload(tdb, 2, 1, R"(<?xml version="1.0" encoding="UTF-8"?>
+        <osmChange version="0.6" generator="iD">
+           <create>
+              <node id="-1" lon="11" lat="46" version="0" changeset="2"/>
+              <way id="-1" version="0" changeset="2">
+                 <nd ref="-1"/>
+                 <nd ref="-2"/>
+              </way>
+           </create>
+        </osmChange>
+      )"), http::bad_request, Catch::Matchers::Message("Placeholder node not found for reference -2 in way -1"));
+  }
+
+  SECTION("Valid upload to closed changeset") {
+
+    REQUIRE_THROWS_AS(process_payload(tdb, 2, 1, R"(<?xml version="1.0" encoding="UTF-8"?>
+        <osmChange version="0.6" generator="iD">
+           <create>
+              <node id="-1" lon="11" lat="46" version="0" changeset="2"/>
+           </create>
+        </osmChange>
+      )"), http::conflict);
+  }
+
   // Test more complex examples, including XML parsing
 
   SECTION("Forward relation member declarations") {
@@ -2166,6 +2209,94 @@ TEST_CASE_METHOD( DatabaseTestsFixture, "test_osmchange_message", "[changeset][u
 
 
 
+TEST_CASE_METHOD( DatabaseTestsFixture, "test_osmchange_concurrent_uploads", "[changeset][upload][db]" ) {
+
+  SECTION("Initialize test data") {
+
+    tdb.run_sql(R"(
+      INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+      VALUES
+        (1, 'user_1@example.com', '', '2013-11-14T02:10:00Z', 'user_1', true);
+
+      INSERT INTO changesets (id, user_id, created_at, closed_at)
+      VALUES
+        (1, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 hour' ::interval),
+        (2, 1, now() at time zone 'utc', now() at time zone 'utc' + '1 hour' ::interval);
+
+      INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+      VALUES
+        (1, 10000000, 10000000, 1, true, '2017-03-19T19:13:00Z', 3221225472, 1),
+        (2, 20000000, 20000000, 1, true, '2017-03-19T19:13:00Z', 3221225472, 1),
+        (3, 30000000, 30000000, 1, true, '2017-03-19T19:13:00Z', 3221225472, 1);
+    )");
+  }
+
+  SECTION("Uploads with crossing lock order do not deadlock") {
+
+    logger::initialise(); // disable logger in this section, since it lacks multithreading support
+
+    // Upload into its own changeset, on its own database connection
+    auto upload = [&](osm_changeset_id_t changeset, const std::string &payload) {
+      test_request req{};
+      UserInfo user{ .id = 1 };
+      RequestContext ctx{ .req = req, .user = user };
+      api06::OSMChange_Tracking change_tracking{};
+
+      auto factory = tdb.get_new_data_update_factory();
+      auto txn = factory->get_default_transaction();
+      auto upd = factory->make_data_update(*txn);
+
+      auto changeset_updater = upd->get_changeset_updater(ctx, changeset);
+      auto node_updater = upd->get_node_updater(ctx, change_tracking);
+      auto way_updater = upd->get_way_updater(ctx, change_tracking);
+      auto relation_updater = upd->get_relation_updater(ctx, change_tracking);
+
+      api06::OSMChange_Handler handler(*node_updater, *way_updater, *relation_updater, changeset);
+      api06::OSMChangeXMLParser parser(handler);
+      parser.process_message(payload);
+
+      changeset_updater->lock_current_changeset(true);
+
+      handler.process_changes();
+
+      changeset_updater->update_changeset(handler.get_num_changes(), handler.get_bbox());
+      upd->commit();
+    };
+
+    // Both uploads reference the node the other one modifies. In document
+    // order, each one would first share lock the other's node and then
+    // exclusively lock its own node.
+    for (osm_version_t version = 1; version <= 10; ++version) {
+
+      auto upload_1 = std::async(std::launch::async, upload, 1, fmt::format(R"(
+        <osmChange>
+          <create>
+            <way id="-1" changeset="1"><nd ref="2"/><nd ref="3"/></way>
+          </create>
+          <modify>
+            <node id="1" lat="1" lon="1" version="{}" changeset="1"/>
+          </modify>
+        </osmChange>)", version));
+
+      auto upload_2 = std::async(std::launch::async, upload, 2, fmt::format(R"(
+        <osmChange>
+          <create>
+            <way id="-1" changeset="2"><nd ref="1"/><nd ref="3"/></way>
+          </create>
+          <modify>
+            <node id="2" lat="2" lon="2" version="{}" changeset="2"/>
+          </modify>
+        </osmChange>)", version));
+
+      REQUIRE_NOTHROW(upload_1.get());
+      REQUIRE_NOTHROW(upload_2.get());
+    }
+
+    auto sel = tdb.get_data_selection();
+    REQUIRE(sel->select_nodes({1, 2}) == 2);
+  }
+}
+
 TEST_CASE_METHOD( DatabaseTestsFixture, "test_osmchange_end_to_end", "[changeset][upload][db]" ) {
 
   const std::string bearertoken = "Bearer 4f41f2328befed5a33bcabdf14483081c8df996cbafc41e313417776e8fafae8";
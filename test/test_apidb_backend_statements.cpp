@@ -0,0 +1,188 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/bbox.hpp"
+#include "cgimap/backend/apidb/statement_catalog.hpp"
+
+#include "test_formatter.hpp"
+#include "test_database.hpp"
+
+#include <fmt/core.h>
+#include <pqxx/pqxx>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+#include <catch2/catch_session.hpp>
+
+namespace {
+
+class DatabaseTestsFixture
+{
+public:
+  static void setTestDatabaseSchema(const std::filesystem::path& db_sql) {
+    test_db_sql = db_sql;
+  }
+
+protected:
+  DatabaseTestsFixture() = default;
+  inline static std::filesystem::path test_db_sql{"test/structure.sql"};
+  static test_database tdb;
+};
+
+test_database DatabaseTestsFixture::tdb{};
+
+struct CGImapListener : Catch::EventListenerBase, DatabaseTestsFixture {
+
+    using Catch::EventListenerBase::EventListenerBase; // inherit constructor
+
+    void testRunStarting( Catch::TestRunInfo const& testRunInfo ) override {
+      // load database schema when starting up tests
+      tdb.setup(test_db_sql);
+    }
+
+    void testCaseStarting( Catch::TestCaseInfo const& testInfo ) override {
+      tdb.testcase_starting();
+    }
+
+    void testCaseEnded( Catch::TestCaseStats const& testCaseStats ) override {
+      tdb.testcase_ended();
+    }
+};
+
+CATCH_REGISTER_LISTENER( CGImapListener )
+
+} // anonymous namespace
+
+#if PQXX_VERSION_MAJOR >= 7
+
+TEST_CASE_METHOD( DatabaseTestsFixture, "Read statements are prepared on connecting", "[statements][db]" ) {
+
+  auto txn = tdb.get_data_selection_factory()->get_default_transaction();
+  const auto &prepared = txn->get_prep_stmt();
+
+  REQUIRE_FALSE(prepared_statement::catalog().empty());
+
+  for (const auto *s : prepared_statement::catalog()) {
+    INFO(s->name);
+    CHECK(prepared.contains(s->name) == (s->used_on == prepared_statement::read));
+  }
+}
+
+TEST_CASE_METHOD( DatabaseTestsFixture, "All statements are prepared on the update connection", "[statements][db]" ) {
+
+  auto txn = tdb.get_data_update_factory()->get_default_transaction();
+  const auto &prepared = txn->get_prep_stmt();
+
+  for (const auto *s : prepared_statement::catalog()) {
+    INFO(s->name);
+    CHECK(prepared.contains(s->name));
+  }
+}
+
+#endif
+
+TEST_CASE_METHOD( DatabaseTestsFixture, "Each statement prepares against the schema", "[statements][db]" ) {
+
+  // on a connection of its own, so that a failing statement is reported
+  // by its name rather than falling back to preparing on first use
+  std::string dbname;
+  {
+    auto txn = tdb.get_data_selection_factory()->get_default_transaction();
+    dbname = txn->get_transaction().conn().dbname();
+  }
+
+  pqxx::connection conn(fmt::format("dbname={}", dbname));
+
+  pqxx::nontransaction txn(conn);
+  for (const auto *s : prepared_statement::catalog()) {
+    INFO(s->name);
+    CHECK_NOTHROW(txn.exec(fmt::format("PREPARE {} AS {}", s->name, s->definition)));
+  }
+}
+
+TEST_CASE_METHOD( DatabaseTestsFixture, "Map calls run without merge and hash joins", "[statements][db]" ) {
+
+  tdb.run_sql(R"(
+    INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+    VALUES (1, 'user_1@example.com', '', '2013-11-14T02:10:00Z', 'user_1', true);
+
+    INSERT INTO changesets (id, user_id, created_at, closed_at)
+    VALUES (1, 1, '2013-11-14T02:10:00Z', '2013-11-14T03:10:00Z');
+
+    INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    VALUES (1,       0,       0, 1, true, '2013-11-14T02:10:00Z', 3221225472, 1),
+           (2, 1000000, 1000000, 1, true, '2013-11-14T02:10:00Z', 3221227032, 1);
+
+    INSERT INTO current_ways (id, changeset_id, "timestamp", visible, version)
+    VALUES (1, 1, '2013-11-14T02:10:00Z', true, 1);
+
+    INSERT INTO current_way_nodes (way_id, node_id, sequence_id)
+    VALUES (1, 1, 1), (1, 2, 2);
+
+    INSERT INTO current_relations (id, changeset_id, "timestamp", visible, version)
+    VALUES (1, 1, '2013-11-14T02:10:00Z', true, 1);
+
+    INSERT INTO current_relation_members (relation_id, member_type, member_id, member_role, sequence_id)
+    VALUES (1, 'Way', 1, '', 1);
+  )");
+
+  auto factory = tdb.get_data_selection_factory();
+  auto txn = factory->get_default_transaction();
+
+  // set once for the session of the read only connection
+  auto &t = txn->get_transaction();
+  CHECK(t.exec("SHOW enable_mergejoin")[0][0].as<std::string>() == "off");
+  CHECK(t.exec("SHOW enable_hashjoin")[0][0].as<std::string>() == "off");
+
+  auto sel = factory->make_selection(*txn);
+
+  // only node 1 is in the bounding box, node 2 is added by the way
+  REQUIRE(sel->select_nodes_from_bbox(bbox(-0.05, -0.05, 0.05, 0.05), 100) == 1);
+  sel->select_ways_from_nodes();
+  sel->select_nodes_from_way_nodes();
+  sel->select_relations_from_ways();
+  sel->select_relations_from_nodes();
+  sel->select_relations_from_relations();
+
+  test_formatter f;
+  sel->write_nodes(f);
+  sel->write_ways(f);
+  sel->write_relations(f);
+
+  CHECK(f.m_nodes.size() == 2);
+  REQUIRE(f.m_ways.size() == 1);
+  CHECK(f.m_ways[0].nodes == nodes_t{1, 2});
+  REQUIRE(f.m_relations.size() == 1);
+  CHECK(f.m_relations[0].elem.id == 1);
+}
+
+int main(int argc, char *argv[]) {
+  Catch::Session session;
+
+  std::filesystem::path test_db_sql{ "test/structure.sql" };
+
+  using namespace Catch::Clara;
+  auto cli =
+      session.cli()
+      | Opt(test_db_sql,
+            "db-schema")    // bind variable to a new option, with a hint string
+            ["--db-schema"] // the option names it will respond to
+      ("test database schema file"); // description string for the help output
+
+  session.cli(cli);
+
+  if (int returnCode = session.applyCommandLine(argc, argv); returnCode != 0)
+    return returnCode;
+
+  if (!test_db_sql.empty())
+    DatabaseTestsFixture::setTestDatabaseSchema(test_db_sql);
+
+  return session.run();
+}
@@ -0,0 +1,750 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/cache_invalidation.hpp"
+#include "cgimap/cache_store.hpp"
+#include "cgimap/caching_data_selection.hpp"
+#include "cgimap/backend/memory/memory_selection.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/options.hpp"
+
+#include "test_formatter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+const std::string test_xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<osm version="0.6" generator="test">
+  <changeset id="1" user="user_1" uid="1" created_at="2013-11-14T02:10:00Z" closed_at="2013-11-14T03:10:00Z" num_changes="2" min_lat="0" min_lon="0" max_lat="1" max_lon="1">
+    <tag k="comment" v="first"/>
+    <discussion>
+      <comment id="1" date="2013-11-14T04:00:00Z" uid="2" user="user_2">
+        <text>nice</text>
+      </comment>
+    </discussion>
+  </changeset>
+  <changeset id="2" user="user_1" uid="1" created_at="2013-11-14T02:10:00Z" closed_at="2099-01-01T00:00:00Z" num_changes="1"/>
+  <node id="1" version="1" changeset="1" lat="0" lon="0" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <tag k="name" v="one"/>
+  </node>
+  <node id="1" version="2" changeset="2" lat="0.5" lon="0.5" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:20:00Z" redaction="1"/>
+  <node id="1" version="3" changeset="2" lat="1" lon="1" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:30:00Z"/>
+  <node id="2" version="1" changeset="1" lat="0.1" lon="0.1" visible="true" timestamp="2013-11-14T02:10:01Z"/>
+  <node id="2" version="2" changeset="2" lat="0.1" lon="0.1" visible="false" timestamp="2013-11-14T02:40:00Z"/>
+  <way id="1" version="1" changeset="1" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <nd ref="1"/>
+    <nd ref="2"/>
+    <tag k="highway" v="residential"/>
+  </way>
+  <relation id="1" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <member type="node" ref="1" role="stop"/>
+    <member type="way" ref="1" role=""/>
+    <tag k="type" v="route"/>
+  </relation>
+</osm>
+)";
+
+// stands in for memcached, shared by all selections of a test
+class map_cache_store : public cache_store {
+public:
+  std::optional<std::string> get(std::string_view key) override {
+    auto itr = values.find(std::string(key));
+    if (itr == values.end())
+      return {};
+    return itr->second;
+  }
+
+  void put(std::string_view key, std::string_view value, std::chrono::seconds) override {
+    values.insert_or_assign(std::string(key), std::string(value));
+  }
+
+  void erase(std::string_view key) override {
+    values.erase(std::string(key));
+  }
+
+  std::map<std::string, std::string> values;
+};
+
+// counts what is selected in the wrapped selection
+class counting_selection : public memory_selection {
+public:
+  using memory_selection::memory_selection;
+
+  int select_historical_nodes(const std::vector<osm_edition_t> &eds) override {
+    historical_nodes += eds.size();
+    return memory_selection::select_historical_nodes(eds);
+  }
+
+  int select_historical_ways(const std::vector<osm_edition_t> &eds) override {
+    historical_ways += eds.size();
+    return memory_selection::select_historical_ways(eds);
+  }
+
+  int select_historical_relations(const std::vector<osm_edition_t> &eds) override {
+    historical_relations += eds.size();
+    return memory_selection::select_historical_relations(eds);
+  }
+
+  int select_changesets(const std::vector<osm_changeset_id_t> &ids) override {
+    changesets += ids.size();
+    return memory_selection::select_changesets(ids);
+  }
+
+  visibility_t check_node_visibility(osm_nwr_id_t id) override {
+    ++visibility_checks;
+    return memory_selection::check_node_visibility(id);
+  }
+
+  int select_nodes(const std::vector<osm_nwr_id_t> &ids) override {
+    current_nodes += ids.size();
+    return memory_selection::select_nodes(ids);
+  }
+
+  std::optional<osm_nwr_id_t> max_element_id(element_type type) override {
+    ++max_id_lookups;
+    return type == element_type::node ? max_node_id : std::nullopt;
+  }
+
+  std::optional<osm_nwr_id_t> max_node_id;
+  std::size_t current_nodes = 0;
+  std::size_t max_id_lookups = 0;
+  std::size_t historical_nodes = 0;
+  std::size_t historical_ways = 0;
+  std::size_t historical_relations = 0;
+  std::size_t changesets = 0;
+  std::size_t visibility_checks = 0;
+};
+
+struct fixture {
+  fixture() {
+    global_settings::set_configuration(std::make_unique<global_settings_default>());
+    settings.history = true;
+    settings.changesets = true;
+  }
+
+  // a new selection, as for the next request
+  caching_data_selection make_selection() {
+    auto inner = std::make_unique<counting_selection>(store);
+    inner->max_node_id = max_node_id;
+    counts = inner.get();
+    return caching_data_selection(std::move(inner), cache, settings);
+  }
+
+  std::shared_ptr<const osm_store> store = load_osm_xml(test_xml);
+  map_cache_store cache;
+  caching_data_selection::settings settings;
+  std::optional<osm_nwr_id_t> max_node_id;
+  counting_selection *counts = nullptr;
+};
+
+test_formatter write_elements(data_selection &sel) {
+  test_formatter f;
+  sel.write_nodes(f);
+  sel.write_ways(f);
+  sel.write_relations(f);
+  return f;
+}
+
+// elements spread over a grid of 0.1 degree cells
+const std::string map_xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<osm version="0.6" generator="test">
+  <changeset id="1" created_at="2013-11-14T02:10:00Z" closed_at="2013-11-14T03:10:00Z" num_changes="12"/>
+  <node id="10" version="1" changeset="1" lat="0.05" lon="0.05" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <tag k="name" v="ten"/>
+  </node>
+  <node id="11" version="1" changeset="1" lat="0.05" lon="0.15" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="12" version="1" changeset="1" lat="0.25" lon="0.25" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="13" version="1" changeset="1" lat="0.05" lon="0.35" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="14" version="1" changeset="1" lat="0.35" lon="0.05" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="15" version="1" changeset="1" lat="-0.05" lon="-0.05" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="16" version="1" changeset="1" lat="0.1" lon="0.1" visible="true" timestamp="2013-11-14T02:10:00Z"/>
+  <node id="17" version="1" changeset="1" lat="0.15" lon="0.05" visible="false" timestamp="2013-11-14T02:10:00Z"/>
+  <way id="20" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <nd ref="10"/>
+    <nd ref="11"/>
+    <nd ref="12"/>
+    <tag k="highway" v="residential"/>
+  </way>
+  <way id="21" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <nd ref="13"/>
+    <nd ref="14"/>
+  </way>
+  <relation id="30" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <member type="node" ref="12" role="stop"/>
+    <member type="way" ref="21" role=""/>
+  </relation>
+  <relation id="31" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <member type="relation" ref="30" role=""/>
+  </relation>
+  <relation id="32" version="1" changeset="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <member type="node" ref="15" role=""/>
+  </relation>
+</osm>
+)";
+
+struct map_fixture {
+  map_fixture() {
+    global_settings::set_configuration(std::make_unique<global_settings_default>());
+    // positions are scaled when loading
+    store = load_osm_xml(map_xml);
+    settings.map_cell_size = 0.1;
+  }
+
+  // a new selection, counting the selections made to fill cells
+  caching_data_selection make_selection() {
+    return caching_data_selection(std::make_unique<memory_selection>(store), cache, settings,
+                                  [this] {
+                                    ++fills;
+                                    return std::make_unique<memory_selection>(store);
+                                  });
+  }
+
+  std::shared_ptr<const osm_store> store;
+  map_cache_store cache;
+  caching_data_selection::settings settings;
+  int fills = 0;
+};
+
+// the selections made by map_responder
+std::pair<int, test_formatter> select_map(data_selection &sel, const bbox &bounds,
+                                          int max_nodes = 50000) {
+  const int selected = sel.select_nodes_from_bbox(bounds, max_nodes);
+  if (selected > 0 && selected <= max_nodes) {
+    sel.select_ways_from_nodes();
+    sel.select_nodes_from_way_nodes();
+    sel.select_relations_from_ways();
+    sel.select_relations_from_nodes();
+    sel.select_relations_from_relations();
+  }
+  return {selected, write_elements(sel)};
+}
+
+test_formatter check_map(map_fixture &fx, const bbox &bounds) {
+  memory_selection uncached(fx.store);
+  const auto [expected_selected, expected] = select_map(uncached, bounds);
+
+  auto sel = fx.make_selection();
+  const auto [selected, f] = select_map(sel, bounds);
+  CHECK(selected == expected_selected);
+  CHECK(f.m_nodes == expected.m_nodes);
+  CHECK(f.m_ways == expected.m_ways);
+  CHECK(f.m_relations == expected.m_relations);
+  return f;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Cache historic versions", "[cache]") {
+
+  fixture fx;
+  const std::vector<osm_edition_t> nodes{{1, 1}, {1, 3}, {2, 2}};
+
+  memory_selection uncached(fx.store);
+  CHECK(uncached.select_historical_nodes(nodes) == 3);
+  CHECK(uncached.select_historical_ways({{1, 1}}) == 1);
+  CHECK(uncached.select_historical_relations({{1, 1}}) == 1);
+  const auto expected = write_elements(uncached);
+
+  {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_historical_nodes(nodes) == 3);
+    CHECK(sel.select_historical_ways({{1, 1}}) == 1);
+    CHECK(sel.select_historical_relations({{1, 1}}) == 1);
+    CHECK(fx.counts->historical_nodes == 3);
+    const auto f = write_elements(sel);
+    CHECK(f.m_nodes == expected.m_nodes);
+    CHECK(f.m_ways == expected.m_ways);
+    CHECK(f.m_relations == expected.m_relations);
+  }
+  CHECK(fx.cache.values.size() == 5);
+
+  SECTION("Cached versions aren't selected again") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_historical_nodes(nodes) == 3);
+    CHECK(sel.select_historical_ways({{1, 1}}) == 1);
+    CHECK(sel.select_historical_relations({{1, 1}}) == 1);
+    CHECK(fx.counts->historical_nodes == 0);
+    CHECK(fx.counts->historical_ways == 0);
+    CHECK(fx.counts->historical_relations == 0);
+
+    const auto f = write_elements(sel);
+    CHECK(f.m_nodes == expected.m_nodes);
+    CHECK(f.m_ways == expected.m_ways);
+    CHECK(f.m_relations == expected.m_relations);
+  }
+
+  SECTION("Cached and current versions are merged") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1}) == 1);
+    CHECK(sel.select_historical_nodes({{1, 1}, {2, 1}}) == 2);
+    CHECK(fx.counts->historical_nodes == 1);
+
+    const auto f = write_elements(sel);
+    REQUIRE(f.m_nodes.size() == 3);
+    CHECK(f.m_nodes[0].elem.id == 1);
+    CHECK(f.m_nodes[0].elem.version == 1);
+    CHECK(f.m_nodes[1].elem.version == 3);
+    CHECK(f.m_nodes[2].elem.id == 2);
+    // along with the unknown highest node id
+    CHECK(fx.cache.values.size() == 7);
+  }
+
+  SECTION("Corrupt values are misses") {
+    for (auto &[key, value] : fx.cache.values)
+      value.resize(value.size() / 2);
+
+    auto sel = fx.make_selection();
+    CHECK(sel.select_historical_nodes(nodes) == 3);
+    CHECK(fx.counts->historical_nodes == 3);
+    CHECK(write_elements(sel).m_nodes == expected.m_nodes);
+  }
+}
+
+TEST_CASE("Don't cache historic versions without invalidation", "[cache]") {
+
+  fixture fx;
+  fx.settings.history = false;
+
+  for (int i = 0; i < 2; ++i) {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_historical_nodes({{1, 1}, {1, 3}}) == 2);
+    CHECK(fx.counts->historical_nodes == 2);
+    CHECK(write_elements(sel).m_nodes.size() == 2);
+  }
+  CHECK(fx.cache.values.empty());
+}
+
+TEST_CASE("Don't cache redacted versions", "[cache]") {
+
+  fixture fx;
+
+  auto sel = fx.make_selection();
+  CHECK(sel.select_historical_nodes({{1, 2}}) == 0);
+  sel.set_redactions_visible(true);
+  CHECK(sel.select_historical_nodes({{1, 2}}) == 1);
+  CHECK(write_elements(sel).m_nodes.size() == 1);
+  CHECK(fx.cache.values.empty());
+}
+
+TEST_CASE("Cache closed changesets", "[cache]") {
+
+  fixture fx;
+  const auto now = std::chrono::system_clock::now();
+
+  memory_selection uncached(fx.store);
+  CHECK(uncached.select_changesets({1, 2}) == 2);
+  test_formatter expected;
+  uncached.write_changesets(expected, now);
+
+  {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_changesets({1, 2}) == 2);
+    test_formatter f;
+    sel.write_changesets(f, now);
+    CHECK(f.m_changesets == expected.m_changesets);
+  }
+  // changeset 2 is still open
+  CHECK(fx.cache.values.size() == 1);
+
+  SECTION("Without discussion") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_changesets({1, 2}) == 2);
+    CHECK(fx.counts->changesets == 1);
+    test_formatter f;
+    sel.write_changesets(f, now);
+    CHECK(f.m_changesets == expected.m_changesets);
+  }
+
+  SECTION("The discussion is selected if it wasn't cached") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_changesets({1}) == 1);
+    sel.select_changeset_discussions();
+    test_formatter f;
+    sel.write_changesets(f, now);
+    REQUIRE(f.m_changesets.size() == 1);
+    CHECK(f.m_changesets[0].m_include_comments);
+    CHECK(f.m_changesets[0].m_comments.size() == 1);
+    CHECK(fx.counts->changesets == 1);
+
+    // and cached along with it
+    auto sel2 = fx.make_selection();
+    CHECK(sel2.select_changesets({1}) == 1);
+    sel2.select_changeset_discussions();
+    test_formatter f2;
+    sel2.write_changesets(f2, now);
+    CHECK(f2.m_changesets == f.m_changesets);
+    CHECK(fx.counts->changesets == 0);
+  }
+}
+
+TEST_CASE("Don't cache changesets without invalidation", "[cache]") {
+
+  fixture fx;
+  fx.settings.changesets = false;
+  const auto now = std::chrono::system_clock::now();
+
+  for (int i = 0; i < 2; ++i) {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_changesets({1}) == 1);
+    sel.select_changeset_discussions();
+    CHECK(fx.counts->changesets == 1);
+    test_formatter f;
+    sel.write_changesets(f, now);
+    REQUIRE(f.m_changesets.size() == 1);
+    CHECK(f.m_changesets[0].m_comments.size() == 1);
+  }
+  CHECK(fx.cache.values.empty());
+}
+
+TEST_CASE("Cache visibility", "[cache]") {
+
+  fixture fx;
+
+  // node 3 is a gap below the highest id
+  fx.max_node_id = 5;
+
+  auto sel = fx.make_selection();
+  CHECK(sel.check_node_visibility(1) == data_selection::exists);
+  CHECK(sel.check_node_visibility(2) == data_selection::deleted);
+  CHECK(sel.check_node_visibility(3) == data_selection::non_exist);
+  CHECK(sel.check_node_visibility(6) == data_selection::non_exist);
+  CHECK(fx.counts->visibility_checks == 4);
+
+  CHECK(sel.check_node_visibility(1) == data_selection::exists);
+  CHECK(sel.check_node_visibility(2) == data_selection::deleted);
+  CHECK(sel.check_node_visibility(3) == data_selection::non_exist);
+  CHECK(fx.counts->visibility_checks == 4);
+
+  // may still be created, so it isn't cached as missing
+  CHECK(sel.check_node_visibility(6) == data_selection::non_exist);
+  CHECK(fx.counts->visibility_checks == 5);
+}
+
+TEST_CASE("Don't look up missing elements again", "[cache]") {
+
+  fixture fx;
+  fx.max_node_id = 5;
+
+  {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({3}) == 0);
+    CHECK(fx.counts->current_nodes == 1);
+    CHECK(fx.counts->visibility_checks == 1);
+  }
+
+  SECTION("Missing elements aren't selected") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({3}) == 0);
+    CHECK(sel.check_node_visibility(3) == data_selection::non_exist);
+    CHECK(fx.counts->current_nodes == 0);
+    CHECK(fx.counts->visibility_checks == 0);
+  }
+
+  SECTION("Existing and deleted elements are selected") {
+    for (osm_nwr_id_t id : {1, 2}) {
+      auto sel = fx.make_selection();
+      CHECK(sel.select_nodes({id}) == 1);
+      CHECK(fx.counts->current_nodes == 1);
+      const auto f = write_elements(sel);
+      REQUIRE(f.m_nodes.size() == 1);
+      CHECK(f.m_nodes[0].elem.id == id);
+    }
+  }
+
+  SECTION("Elements selected twice aren't missing") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1}) == 1);
+    CHECK(sel.select_nodes({1}) == 0);
+    CHECK(sel.check_node_visibility(1) == data_selection::exists);
+  }
+
+  SECTION("Larger selections are passed through") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1, 3}) == 1);
+    CHECK(fx.counts->current_nodes == 2);
+  }
+
+  SECTION("Created elements are found once invalidated") {
+    caching_data_selection::invalidate(fx.cache, {}, {.items = {{element_type::node, 3}}});
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({3}) == 0);
+    CHECK(fx.counts->current_nodes == 1);
+  }
+}
+
+TEST_CASE("Don't look up elements above the highest id", "[cache]") {
+
+  fixture fx;
+
+  fx.max_node_id = 2;
+
+  {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1000}) == 0);
+    CHECK(sel.select_nodes({1}) == 1);
+    CHECK(fx.counts->current_nodes == 1);
+    CHECK(fx.counts->max_id_lookups == 1);
+  }
+
+  SECTION("The highest id is cached") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({2}) == 1);
+    CHECK(fx.counts->max_id_lookups == 0);
+  }
+
+  SECTION("Ids above the cached highest id look it up again") {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1001}) == 0);
+    CHECK(fx.counts->current_nodes == 0);
+    CHECK(fx.counts->max_id_lookups == 1);
+  }
+
+  SECTION("Elements created since the highest id was cached are found") {
+    // as if the invalidation was missed
+    fx.max_node_id = 1000;
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1000}) == 0);
+    CHECK(fx.counts->current_nodes == 1);
+    CHECK(fx.counts->max_id_lookups == 1);
+  }
+
+  SECTION("Creating elements drops the highest id") {
+    caching_data_selection::invalidate(fx.cache, {}, {.items = {{element_type::node, 1000}}});
+    fx.max_node_id = 1000;
+    auto sel = fx.make_selection();
+    CHECK(sel.select_nodes({1000}) == 0);
+    CHECK(fx.counts->current_nodes == 1);
+    CHECK(fx.counts->max_id_lookups == 1);
+  }
+
+  SECTION("Unknown highest ids are cached too") {
+    {
+      auto sel = fx.make_selection();
+      CHECK(sel.select_ways({1}) == 1);
+      CHECK(sel.select_ways({1000}) == 0);
+      CHECK(fx.counts->max_id_lookups == 1);
+    }
+    auto sel = fx.make_selection();
+    CHECK(sel.select_ways({1001}) == 0);
+    CHECK(fx.counts->max_id_lookups == 0);
+  }
+
+  SECTION("Disabled with the visibility cache") {
+    auto sel = caching_data_selection(std::make_unique<counting_selection>(fx.store), fx.cache,
+                                      {.visibility_ttl = std::chrono::seconds(0)});
+    CHECK(sel.select_nodes({1}) == 1);
+    CHECK(sel.select_nodes({3}) == 0);
+  }
+}
+
+TEST_CASE("Invalidate cached data", "[cache]") {
+
+  fixture fx;
+  const auto now = std::chrono::system_clock::now();
+
+  {
+    auto sel = fx.make_selection();
+    CHECK(sel.select_historical_nodes({{1, 1}, {1, 3}}) == 2);
+    write_elements(sel);
+    CHECK(sel.check_node_visibility(1) == data_selection::exists);
+    CHECK(sel.select_changesets({1}) == 1);
+    test_formatter f;
+    sel.write_changesets(f, now);
+  }
+  CHECK(fx.cache.values.size() == 4);
+
+  caching_data_selection::invalidate(fx.cache, {},
+                                     {.items = {{element_type::node, 1, 1},
+                                                {element_type::node, 1},
+                                                {element_type::changeset, 1}}});
+  CHECK(fx.cache.values.size() == 1);
+
+  auto sel = fx.make_selection();
+  CHECK(sel.select_historical_nodes({{1, 1}, {1, 3}}) == 2);
+  CHECK(fx.counts->historical_nodes == 1);
+  CHECK(sel.check_node_visibility(1) == data_selection::exists);
+  CHECK(fx.counts->visibility_checks == 1);
+  CHECK(sel.select_changesets({1}) == 1);
+  CHECK(fx.counts->changesets == 1);
+}
+
+TEST_CASE("Cache invalidation payloads", "[cache]") {
+
+  using cache_invalidation::changes;
+  using cache_invalidation::item;
+
+  const changes c{.items = {{element_type::node, 1},
+                            {element_type::way, 2, 3},
+                            {element_type::relation, 4},
+                            {element_type::changeset, 5}},
+                  .areas = {bbox(-1.5, -0.25, 2, 3.0000001)}};
+  const auto payloads = cache_invalidation::payloads(c);
+  REQUIRE(payloads.size() == 1);
+  CHECK(payloads[0] == "node/1 way/2/3 relation/4 changeset/5 "
+                       "area/-0.2500000,-1.5000000,3.0000001,2.0000000");
+  CHECK(cache_invalidation::parse(payloads[0]) == c);
+
+  SECTION("Long lists are split") {
+    changes many;
+    for (osm_nwr_id_t id = 1000000000; id < 1000002000; ++id)
+      many.items.push_back({element_type::node, id});
+
+    const auto split = cache_invalidation::payloads(many);
+    CHECK(split.size() > 1);
+    changes parsed;
+    for (const auto &payload : split) {
+      CHECK(payload.size() < 8000);
+      const auto p = cache_invalidation::parse(payload);
+      parsed.items.insert(parsed.items.end(), p.items.begin(), p.items.end());
+    }
+    CHECK(parsed == many);
+  }
+
+  SECTION("Invalid items are skipped") {
+    CHECK(cache_invalidation::parse("").empty());
+    CHECK(cache_invalidation::parse("node/1  tile/2 way/x node/2/0 node/-3 way node/4/ "
+                                    "area/1,2,3 area/3,0,1,1 area/x,0,1,1") ==
+          changes{.items = {{element_type::node, 1}}});
+  }
+
+  CHECK(cache_invalidation::payloads({}).empty());
+}
+
+TEST_CASE("Cache map calls per grid cell", "[cache]") {
+
+  map_fixture fx;
+  const std::vector<bbox> boxes{bbox(0, 0, 0.1, 0.1),     bbox(0.02, 0.02, 0.08, 0.12),
+                                bbox(0, 0, 0.4, 0.4),     bbox(0.1, 0.1, 0.3, 0.3),
+                                bbox(-0.1, -0.1, 0, 0),   bbox(0.3, 0.3, 0.35, 0.35),
+                                bbox(0.12, 0.02, 0.18, 0.08)};
+
+  // nodes 10 and 16, way 20 with nodes 11 and 12, relation 30 with node 12
+  // and its parent 31
+  const auto f = check_map(fx, bbox(0, 0, 0.1, 0.1));
+  CHECK(f.m_nodes.size() == 4);
+  CHECK(f.m_ways.size() == 1);
+  CHECK(f.m_relations.size() == 2);
+
+  for (const auto &bounds : boxes)
+    check_map(fx, bounds);
+  CHECK(fx.fills > 0);
+  CHECK(fx.fills == std::ranges::count_if(fx.cache.values, [](const auto &entry) {
+          return entry.first.starts_with("map") && !entry.first.starts_with("mapgeneration");
+        }));
+
+  SECTION("Cached cells are used") {
+    const auto fills = fx.fills;
+    for (const auto &bounds : boxes)
+      check_map(fx, bounds);
+    CHECK(fx.fills == fills);
+  }
+
+  SECTION("Changed areas are filled again") {
+    const auto fills = fx.fills;
+    caching_data_selection::invalidate(fx.cache, fx.settings,
+                                       {.areas = {bbox(0.05, 0.05, 0.05, 0.05)}});
+    check_map(fx, bbox(0.3, 0.3, 0.35, 0.35));
+    CHECK(fx.fills == fills);
+    check_map(fx, bbox(0.02, 0.02, 0.08, 0.08));
+    CHECK(fx.fills == fills + 1);
+  }
+
+  SECTION("Large changed areas start a new generation") {
+    const auto entries = fx.cache.values.size();
+    caching_data_selection::invalidate(fx.cache, fx.settings,
+                                       {.areas = {bbox(-10, -10, 10, 10)}});
+    CHECK(fx.cache.values.size() == entries);
+
+    const auto fills = fx.fills;
+    check_map(fx, bbox(0.3, 0.3, 0.35, 0.35));
+    CHECK(fx.fills == fills + 1);
+  }
+
+  SECTION("Corrupt cells are misses") {
+    for (auto &[key, value] : fx.cache.values) {
+      if (!key.starts_with("mapgeneration"))
+        value.resize(value.size() / 2);
+    }
+    const auto fills = fx.fills;
+    check_map(fx, bbox(0, 0, 0.1, 0.1));
+    CHECK(fx.fills > fills);
+  }
+}
+
+TEST_CASE("Map calls which aren't cached", "[cache]") {
+
+  map_fixture fx;
+
+  SECTION("Too many nodes") {
+    memory_selection uncached(fx.store);
+    const auto [expected_selected, expected] = select_map(uncached, bbox(0, 0, 0.4, 0.4), 2);
+
+    auto sel = fx.make_selection();
+    const auto [selected, f] = select_map(sel, bbox(0, 0, 0.4, 0.4), 2);
+    CHECK(selected == expected_selected);
+    CHECK(selected > 2);
+    CHECK(f.m_nodes == expected.m_nodes);
+  }
+
+  SECTION("Too many cells") {
+    check_map(fx, bbox(-1, -1, 1, 1));
+    CHECK(fx.fills == 0);
+  }
+
+  SECTION("Map cache disabled") {
+    fx.settings.map_cell_size = 0;
+    check_map(fx, bbox(0, 0, 0.1, 0.1));
+    CHECK(fx.fills == 0);
+  }
+}
+
+TEST_CASE("LRU cache store", "[cache]") {
+
+  lru_cache_store cache(20);
+
+  cache.put("a", "123456789", std::chrono::seconds(60));
+  cache.put("b", "123456789", std::chrono::seconds(60));
+  CHECK(cache.bytes() == 20);
+  CHECK(cache.get("a") == "123456789");
+
+  // b is the least recently used
+  cache.put("c", "1234", std::chrono::seconds(60));
+  CHECK(cache.get("b") == std::nullopt);
+  CHECK(cache.get("a") == "123456789");
+  CHECK(cache.get("c") == "1234");
+  CHECK(cache.bytes() == 15);
+
+  // replacing a value
+  cache.put("c", "12", std::chrono::seconds(60));
+  CHECK(cache.get("c") == "12");
+  CHECK(cache.bytes() == 13);
+
+  // too large to be cached at all
+  cache.put("d", std::string(20, 'x'), std::chrono::seconds(60));
+  CHECK(cache.get("d") == std::nullopt);
+  CHECK(cache.get("a") == "123456789");
+
+  // expired
+  cache.put("e", "1", std::chrono::seconds(0));
+  CHECK(cache.get("e") == std::nullopt);
+
+  // erased
+  cache.erase("a");
+  cache.erase("f");
+  CHECK(cache.get("a") == std::nullopt);
+  CHECK(cache.bytes() == 3);
+}
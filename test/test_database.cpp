@@ -166,6 +166,10 @@ std::shared_ptr<data_selection::factory> test_database::get_data_selection_facto
   return m_readonly_factory;
 }
 
+std::unique_ptr<data_selection::factory> test_database::get_new_data_selection_factory() {
+  return make_apidb_backend()->create(vm);
+}
+
 // return a data update factory pointing at the current database
 std::shared_ptr<data_update::factory> test_database:: get_data_update_factory() const {
   return m_update_factory;
@@ -65,6 +65,10 @@ struct test_database {
   // return a data selection factory pointing at the current database
   [[nodiscard]] std::shared_ptr<data_selection::factory> get_data_selection_factory() const;
 
+  // return a data selection factory pointing at the current database,
+  // with a fresh database connection
+  [[nodiscard]] std::unique_ptr<data_selection::factory> get_new_data_selection_factory();
+
   // return a data update factory pointing at the current database
   [[nodiscard]] std::shared_ptr<data_update::factory> get_data_update_factory() const;
 
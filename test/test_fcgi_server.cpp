@@ -0,0 +1,426 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/fcgi_server.hpp"
+#include "cgimap/http.hpp"
+#include "cgimap/options.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::ContainsSubstring;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr uint8_t begin_request = 1;
+constexpr uint8_t abort_request = 2;
+constexpr uint8_t end_request = 3;
+constexpr uint8_t params = 4;
+constexpr uint8_t stdin_stream = 5;
+constexpr uint8_t stdout_stream = 6;
+constexpr uint8_t get_values = 9;
+constexpr uint8_t get_values_result = 10;
+constexpr uint8_t unknown_type = 11;
+
+struct record {
+  uint8_t type;
+  uint16_t id;
+  std::string content;
+};
+
+std::string encode(uint8_t type, uint16_t id, std::string_view content) {
+  std::string out{char(1), char(type), char(id >> 8), char(id & 0xff),
+                  char(content.size() >> 8), char(content.size() & 0xff), 0, 0};
+  return out.append(content);
+}
+
+std::string encode_begin(uint16_t id, bool keep_conn, uint16_t role = 1) {
+  const std::string body{char(role >> 8), char(role & 0xff), char(keep_conn ? 1 : 0), 0, 0, 0, 0, 0};
+  return encode(begin_request, id, body);
+}
+
+// names and values below 128 bytes only
+std::string encode_param(std::string_view name, std::string_view value) {
+  return std::string{char(name.size()), char(value.size())}.append(name).append(value);
+}
+
+// a complete request, without its FCGI_BEGIN_REQUEST record
+std::string encode_request(uint16_t id, std::string_view uri, std::string_view payload = {}) {
+  std::string out = encode(params, id, encode_param("REQUEST_URI", uri));
+  out += encode(params, id, {});
+  if (!payload.empty())
+    out += encode(stdin_stream, id, payload);
+  out += encode(stdin_stream, id, {});
+  return out;
+}
+
+void send_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto bytes = send(fd, data.data(), data.size(), 0);
+    REQUIRE(bytes > 0);
+    data.remove_prefix(bytes);
+  }
+}
+
+// reads records until end_requests requests have ended, or the
+// connection is closed
+std::vector<record> read_records(int fd, std::size_t end_requests) {
+  std::vector<record> records;
+  std::string input;
+  std::array<char, 4096> buffer;
+
+  while (end_requests > 0) {
+    while (input.size() >= 8) {
+      const auto byte = [&input](std::size_t i) { return static_cast<unsigned char>(input[i]); };
+      const std::size_t length = (byte(4) << 8) | byte(5);
+      if (input.size() < 8 + length + byte(6))
+        break;
+
+      records.push_back({byte(1), uint16_t((byte(2) << 8) | byte(3)), input.substr(8, length)});
+      input.erase(0, 8 + length + byte(6));
+      if (records.back().type == end_request && --end_requests == 0)
+        return records;
+    }
+
+    const auto bytes = recv(fd, buffer.data(), buffer.size(), 0);
+    if (bytes <= 0)
+      break;
+    input.append(buffer.data(), bytes);
+  }
+  return records;
+}
+
+std::string stdout_of(const std::vector<record> &records, uint16_t id) {
+  std::string out;
+  for (const auto &r : records) {
+    if (r.type == stdout_stream && r.id == id)
+      out += r.content;
+  }
+  return out;
+}
+
+const record &end_of(const std::vector<record> &records, uint16_t id) {
+  for (const auto &r : records) {
+    if (r.type == end_request && r.id == id)
+      return r;
+  }
+  throw std::runtime_error("request didn't end");
+}
+
+bool closed(int fd) {
+  char c;
+  return recv(fd, &c, 1, 0) == 0;
+}
+
+// responds with the request URI and the payload
+void echo(request &req) {
+  const std::string uri = req.get_param("REQUEST_URI");
+  if (uri == "/fail")
+    throw std::runtime_error("failing as requested");
+
+  const auto payload = req.get_payload();
+  req.status(200).add_header("Content-Type", "text/plain");
+  if (uri == "/large") {
+    req.put(std::string(200000, 'x'));
+  } else {
+    req.put(uri + ":" + payload);
+  }
+  req.finish();
+}
+
+class test_server {
+public:
+  explicit test_server(fcgi_server::handler h = echo) {
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(m_socket >= 0);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(bind(m_socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    REQUIRE(listen(m_socket, 16) == 0);
+
+    socklen_t length = sizeof(addr);
+    REQUIRE(getsockname(m_socket, reinterpret_cast<sockaddr *>(&addr), &length) == 0);
+    m_port = ntohs(addr.sin_port);
+
+    m_server = std::make_unique<fcgi_server>(m_socket, 2, [h] { return h; });
+    m_thread = std::thread([this] { m_server->run([this] { return !m_stop; }); });
+  }
+
+  ~test_server() {
+    m_stop = true;
+    m_thread.join();
+    m_server.reset();
+    close(m_socket);
+  }
+
+  test_server(const test_server &) = delete;
+  test_server &operator=(const test_server &) = delete;
+
+  [[nodiscard]] int connect() const {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(fd >= 0);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    return fd;
+  }
+
+private:
+  int m_socket = -1;
+  int m_port = 0;
+  std::atomic<bool> m_stop = false;
+  std::unique_ptr<fcgi_server> m_server;
+  std::thread m_thread;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Responds to a request and closes the connection", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode_begin(1, false) + encode_request(1, "/api/0.6/node/1", "payload"));
+  const auto records = read_records(fd, 1);
+
+  const auto out = stdout_of(records, 1);
+  CHECK_THAT(out, ContainsSubstring("Status: 200 OK\r\n"));
+  CHECK_THAT(out, ContainsSubstring("Content-Type: text/plain\r\n"));
+  CHECK_THAT(out, ContainsSubstring("\r\n\r\n/api/0.6/node/1:payload"));
+
+  // the stream is ended by an empty record, followed by the end of the request
+  REQUIRE(records.size() >= 3);
+  CHECK(records[records.size() - 2].type == stdout_stream);
+  CHECK(records[records.size() - 2].content.empty());
+  CHECK(end_of(records, 1).content == std::string(8, '\0'));
+
+  CHECK(closed(fd));
+  close(fd);
+}
+
+TEST_CASE("Multiplexes requests on a connection kept open", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  // the second request is completed first
+  send_all(fd, encode_begin(1, true) + encode_begin(2, true) +
+               encode(params, 1, encode_param("REQUEST_URI", "/first")) +
+               encode_request(2, "/second", "two") +
+               encode(params, 1, {}) +
+               encode(stdin_stream, 1, "o") + encode(stdin_stream, 1, "ne") +
+               encode(stdin_stream, 1, {}));
+
+  auto records = read_records(fd, 2);
+  CHECK_THAT(stdout_of(records, 1), ContainsSubstring("/first:one"));
+  CHECK_THAT(stdout_of(records, 2), ContainsSubstring("/second:two"));
+
+  // the connection is used for the next request
+  send_all(fd, encode_begin(1, true) + encode_request(1, "/third"));
+  records = read_records(fd, 1);
+  CHECK_THAT(stdout_of(records, 1), ContainsSubstring("/third:"));
+
+  close(fd);
+}
+
+TEST_CASE("Splits large responses into records", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode_begin(1, false) + encode_request(1, "/large"));
+  const auto records = read_records(fd, 1);
+
+  for (const auto &r : records)
+    CHECK(r.content.size() <= 65535);
+
+  const auto out = stdout_of(records, 1);
+  CHECK(out.substr(out.find("\r\n\r\n") + 4) == std::string(200000, 'x'));
+
+  close(fd);
+}
+
+TEST_CASE("Ends requests whose handler fails", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode_begin(1, false) + encode_request(1, "/fail"));
+  const auto records = read_records(fd, 1);
+
+  CHECK(stdout_of(records, 1).empty());
+  CHECK(end_of(records, 1).content[4] == 0);
+
+  close(fd);
+}
+
+TEST_CASE("Ends aborted requests", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode_begin(1, true) + encode(params, 1, {}) + encode(abort_request, 1, {}));
+  const auto records = read_records(fd, 1);
+
+  CHECK(stdout_of(records, 1).empty());
+  CHECK(end_of(records, 1).content[4] == 0);
+
+  close(fd);
+}
+
+TEST_CASE("Rejects roles other than responder", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode_begin(1, false, 2));
+  const auto records = read_records(fd, 1);
+
+  // FCGI_UNKNOWN_ROLE
+  CHECK(end_of(records, 1).content[4] == 3);
+  CHECK(closed(fd));
+
+  close(fd);
+}
+
+TEST_CASE("Answers management records", "[fcgi_server]") {
+  test_server server;
+  const int fd = server.connect();
+
+  send_all(fd, encode(get_values, 0, encode_param("FCGI_MPXS_CONNS", "") +
+                                     encode_param("FCGI_MAX_CONNS", "")) +
+               encode(42, 0, {}) +
+               encode_begin(1, false) + encode_request(1, "/"));
+  const auto records = read_records(fd, 1);
+
+  REQUIRE(records.size() >= 2);
+  CHECK(records[0].type == get_values_result);
+  CHECK(records[0].content == encode_param("FCGI_MPXS_CONNS", "1"));
+  CHECK(records[1].type == unknown_type);
+  CHECK(records[1].content[0] == 42);
+
+  close(fd);
+}
+
+TEST_CASE("Holds up workers while the web server doesn't read", "[fcgi_server]") {
+  constexpr std::size_t chunk_size = 65536;
+  constexpr std::size_t total = 64 * 1024 * 1024;
+
+  struct progress_t {
+    std::atomic<std::size_t> written = 0;
+    std::atomic<bool> done = false;
+  };
+  auto progress = std::make_shared<progress_t>();
+
+  test_server server([progress](request &req) {
+    if (req.get_param("REQUEST_URI") != std::string_view("/huge")) {
+      echo(req);
+      return;
+    }
+
+    req.status(200).add_header("Content-Type", "text/plain");
+    const std::string chunk(chunk_size, 'x');
+    while (progress->written < total && req.put(chunk) >= 0)
+      progress->written += chunk_size;
+    progress->done = true;
+  });
+
+  const int fd = server.connect();
+  send_all(fd, encode_begin(1, false) + encode_request(1, "/huge"));
+
+  // wait for the worker to stop making progress
+  std::size_t written = 0;
+  for (int i = 0; i < 50; ++i) {
+    std::this_thread::sleep_for(100ms);
+    if (i > 0 && progress->written == written)
+      break;
+    written = progress->written;
+  }
+
+  // no more than the socket buffers and the queue take
+  CHECK(progress->written < total);
+  CHECK_FALSE(progress->done);
+
+  // the other worker still answers requests
+  const int other = server.connect();
+  send_all(other, encode_begin(1, false) + encode_request(1, "/other"));
+  CHECK_THAT(stdout_of(read_records(other, 1), 1), ContainsSubstring("/other:"));
+  close(other);
+
+  // closing the connection lets the worker give up
+  close(fd);
+  for (int i = 0; i < 50 && !progress->done; ++i)
+    std::this_thread::sleep_for(100ms);
+  CHECK(progress->done);
+  CHECK(progress->written < total);
+}
+
+#ifdef HAVE_LIBZ
+TEST_CASE("Rejects payloads which decompress beyond the limit", "[fcgi_server]") {
+
+  struct small_payload_settings : global_settings_default {
+    [[nodiscard]] uint32_t get_payload_max_size() const override { return 1000; }
+  };
+  global_settings::set_configuration(std::make_unique<small_payload_settings>());
+
+  test_server server([](request &req) {
+    try {
+      const auto payload = req.get_payload();
+      req.status(200).add_header("Content-Type", "text/plain");
+      req.put(std::to_string(payload.size()));
+    } catch (const http::exception &e) {
+      req.status(e.code()).add_header("Content-Type", "text/plain");
+    }
+    req.finish();
+  });
+
+  // 512 KB of zeros deflate to about 500 bytes, below the limit
+  const std::string zeros(512 * 1024, '\0');
+  uLongf compressed_size = compressBound(zeros.size());
+  std::string compressed(compressed_size, '\0');
+  REQUIRE(compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size,
+                    reinterpret_cast<const Bytef *>(zeros.data()), zeros.size(),
+                    Z_BEST_COMPRESSION) == Z_OK);
+  compressed.resize(compressed_size);
+  REQUIRE(compressed.size() < 1000);
+
+  const int fd = server.connect();
+  send_all(fd, encode_begin(1, false) +
+               encode(params, 1, encode_param("REQUEST_URI", "/api/0.6/changeset/1/upload") +
+                                 encode_param("HTTP_CONTENT_ENCODING", "deflate")) +
+               encode(params, 1, {}) +
+               encode(stdin_stream, 1, compressed) +
+               encode(stdin_stream, 1, {}));
+
+  CHECK_THAT(stdout_of(read_records(fd, 1), 1), ContainsSubstring("Status: 413 "));
+  close(fd);
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+}
+#endif
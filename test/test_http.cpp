@@ -11,6 +11,10 @@
 #include "cgimap/http.hpp"
 #include "cgimap/choose_formatter.hpp"
 
+#include <fmt/core.h>
+
+#include <limits>
+
 #include <catch2/catch_test_macros.hpp>
 
 struct test_responder : responder {
@@ -175,9 +179,121 @@ TEST_CASE("http_check_accept_header_parsing", "[http]") {
     CHECK(http::get_content_encoding_handler("identity"));
     CHECK(http::get_content_encoding_handler("gzip"));
     CHECK(http::get_content_encoding_handler("deflate"));
+#if HAVE_BROTLI
+    CHECK(http::get_content_encoding_handler("br"));
+#else
     CHECK_THROWS_AS(http::get_content_encoding_handler("br"), http::unsupported_media_type);
+#endif
     CHECK_THROWS_AS(http::get_content_encoding_handler("unknown"), http::unsupported_media_type);
   }
 }
 
+namespace {
+
+std::string sample_payload() {
+  std::string payload;
+  for (int i = 0; i < 20000; ++i)
+    payload += fmt::format(R"(<node id="-{}" lat="{}" lon="{}" changeset="1"/>)", i + 1, i % 90, i % 180);
+  return payload;
+}
+
+// Feed the compressed data in small, uneven chunks to simulate FastCGI reads
+std::string decompress_in_chunks(Decompressor& decompressor, std::string_view compressed, std::size_t chunk_size,
+                                 std::size_t max_output = std::numeric_limits<std::size_t>::max()) {
+  std::string result;
+  while (!compressed.empty()) {
+    auto chunk = compressed.substr(0, chunk_size);
+    decompressor.decompress(chunk, result, max_output);
+    compressed.remove_prefix(chunk.size());
+  }
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("http_content_decompression", "[http]") {
+
+  const auto payload = sample_payload();
+
+  SECTION("identity") {
+    IdentityDecompressor decompressor;
+    CHECK(decompress_in_chunks(decompressor, payload, 1000) == payload);
+  }
+
+  SECTION("identity stops at the output limit") {
+    IdentityDecompressor decompressor;
+    CHECK(decompress_in_chunks(decompressor, payload, 1000, 1001) == payload.substr(0, 1001));
+  }
+
+#ifdef HAVE_LIBZ
+  SECTION("deflate") {
+    uLongf compressed_size = compressBound(payload.size());
+    std::string compressed(compressed_size, '\0');
+    REQUIRE(compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size,
+                      reinterpret_cast<const Bytef *>(payload.data()), payload.size(),
+                      Z_BEST_COMPRESSION) == Z_OK);
+    compressed.resize(compressed_size);
+
+    for (std::size_t chunk_size : {1, 7, 4096, 65536}) {
+      ZLibDecompressor decompressor;
+      CHECK(decompress_in_chunks(decompressor, compressed, chunk_size) == payload);
+    }
+  }
+
+  SECTION("corrupt deflate stream") {
+    ZLibDecompressor decompressor;
+    std::string result;
+    CHECK_THROWS_AS(decompressor.decompress("not a zlib stream", result, 1000), std::runtime_error);
+  }
+
+  SECTION("deflate stops at the output limit") {
+    // 10 MB of zeros compress to about 10 KB
+    const std::string zeros(10 * 1024 * 1024, '\0');
+    uLongf compressed_size = compressBound(zeros.size());
+    std::string compressed(compressed_size, '\0');
+    REQUIRE(compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size,
+                      reinterpret_cast<const Bytef *>(zeros.data()), zeros.size(),
+                      Z_BEST_COMPRESSION) == Z_OK);
+    compressed.resize(compressed_size);
+
+    for (std::size_t chunk_size : {4096, 65536}) {
+      ZLibDecompressor decompressor;
+      const auto result = decompress_in_chunks(decompressor, compressed, chunk_size, 1024 * 1024 + 1);
+      CHECK(result.size() == 1024 * 1024 + 1);
+      CHECK(result.capacity() < 2 * 1024 * 1024 + 2);
+    }
+  }
+#endif
+
+#if HAVE_BROTLI
+  SECTION("brotli") {
+    std::size_t compressed_size = BrotliEncoderMaxCompressedSize(payload.size());
+    std::string compressed(compressed_size, '\0');
+    REQUIRE(BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                  payload.size(), reinterpret_cast<const uint8_t *>(payload.data()),
+                                  &compressed_size, reinterpret_cast<uint8_t *>(compressed.data())));
+    compressed.resize(compressed_size);
+
+    for (std::size_t chunk_size : {1, 7, 4096, 65536}) {
+      BrotliDecompressor decompressor;
+      CHECK(decompress_in_chunks(decompressor, compressed, chunk_size) == payload);
+    }
+  }
+
+  SECTION("brotli stops at the output limit") {
+    const std::string zeros(10 * 1024 * 1024, '\0');
+    std::size_t compressed_size = BrotliEncoderMaxCompressedSize(zeros.size());
+    std::string compressed(compressed_size, '\0');
+    REQUIRE(BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                                  zeros.size(), reinterpret_cast<const uint8_t *>(zeros.data()),
+                                  &compressed_size, reinterpret_cast<uint8_t *>(compressed.data())));
+    compressed.resize(compressed_size);
+
+    BrotliDecompressor decompressor;
+    const auto result = decompress_in_chunks(decompressor, compressed, 4096, 1024 * 1024 + 1);
+    CHECK(result.size() == 1024 * 1024 + 1);
+  }
+#endif
+}
+
 
@@ -0,0 +1,269 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::Matches;
+
+namespace {
+
+class temp_log_file {
+public:
+  temp_log_file() {
+    std::string tmpl = (std::filesystem::temp_directory_path() / "cgimap_test_log_XXXXXX").string();
+    const int fd = mkstemp(tmpl.data());
+    REQUIRE(fd >= 0);
+    close(fd);
+    m_path = tmpl;
+  }
+
+  ~temp_log_file() {
+    logger::initialise();
+    std::filesystem::remove(m_path);
+  }
+
+  [[nodiscard]] const std::string &path() const { return m_path; }
+
+  [[nodiscard]] std::vector<std::string> lines() const {
+    logger::flush();
+    std::ifstream in(m_path);
+    std::vector<std::string> result;
+    std::string line;
+    while (std::getline(in, line))
+      result.push_back(line);
+    return result;
+  }
+
+private:
+  std::string m_path;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Messages without log file are ignored", "[logger]") {
+  logger::initialise();
+  CHECK_FALSE(logger::enabled(logger::level::error));
+  logger::message("nothing happens");
+  logger::flush();
+}
+
+TEST_CASE("Text log format", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  logger::message("Started request for node/1 from 127.0.0.1");
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == 1);
+  CHECK_THAT(lines[0], Matches(R"(\[\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d #\d+\] Started request for node/1 from 127\.0\.0\.1)"));
+}
+
+TEST_CASE("JSON log format", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path(), logger::level::info, logger::format::json);
+
+  logger::message(logger::level::warning, "quote \" backslash \\ newline \n tab \t bell \a");
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == 1);
+  CHECK_THAT(lines[0], Matches(R"(\{"time":"\d{4}-\d\d-\d\dT\d\d:\d\d:\d\dZ","pid":\d+,"level":"warning",)"
+                               R"("message":"quote \\" backslash \\\\ newline \\n tab \\t bell \\u0007"\})"));
+}
+
+TEST_CASE("Log level filter", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path(), logger::level::warning);
+
+  CHECK_FALSE(logger::enabled(logger::level::debug));
+  CHECK_FALSE(logger::enabled(logger::level::info));
+  CHECK(logger::enabled(logger::level::warning));
+  CHECK(logger::enabled(logger::level::error));
+
+  logger::message(logger::level::debug, "debug");
+  logger::message("info");
+  logger::message(logger::level::warning, "warning");
+  logger::message(logger::level::error, "error");
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == 2);
+  CHECK(lines[0].ends_with("] warning"));
+  CHECK(lines[1].ends_with("] error"));
+}
+
+TEST_CASE("Messages are written by the background thread", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  logger::message("first");
+
+  for (int i = 0; i < 50 && std::filesystem::file_size(log.path()) == 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  CHECK(std::filesystem::file_size(log.path()) > 0);
+}
+
+TEST_CASE("Concurrent logging doesn't lose messages", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  constexpr int threads = 4;
+  constexpr int messages = 5000; // more than fit into the queue
+
+  {
+    std::vector<std::jthread> writers;
+    for (int t = 0; t < threads; ++t) {
+      writers.emplace_back([t] {
+        for (int i = 0; i < messages; ++i)
+          logger::message("thread " + std::to_string(t) + " message " + std::to_string(i));
+      });
+    }
+  }
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == threads * messages);
+
+  std::vector<int> counts(threads);
+  for (const auto &line : lines) {
+    const auto pos = line.find("] thread ");
+    REQUIRE(pos != std::string::npos);
+    ++counts.at(line[pos + 9] - '0');
+  }
+  for (int t = 0; t < threads; ++t)
+    CHECK(counts[t] == messages);
+}
+
+TEST_CASE("Reopening the log file writes pending messages", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  logger::message("before reopening");
+  logger::initialise(log.path());
+  logger::message("after reopening");
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == 2);
+  CHECK(lines[0].ends_with("] before reopening"));
+  CHECK(lines[1].ends_with("] after reopening"));
+}
+
+TEST_CASE("Reopening the log file while other threads log", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  constexpr int threads = 4;
+  constexpr int messages = 2000;
+
+  {
+    std::vector<std::jthread> writers;
+    for (int t = 0; t < threads; ++t) {
+      writers.emplace_back([] {
+        for (int i = 0; i < messages; ++i)
+          logger::message("message");
+      });
+    }
+
+    // as on SIGHUP, e.g. after the log file was rotated
+    for (int i = 0; i < 50; ++i)
+      logger::initialise(log.path());
+  }
+
+  CHECK(log.lines().size() == threads * messages);
+}
+
+TEST_CASE("A log file which can't be opened disables logging", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path());
+
+  REQUIRE_NOTHROW(logger::initialise("/nonexistent/cgimap.log"));
+  CHECK_FALSE(logger::enabled(logger::level::error));
+  logger::message("nothing happens");
+
+  logger::initialise(log.path());
+  logger::message("logging again");
+
+  const auto lines = log.lines();
+  REQUIRE(lines.size() == 1);
+  CHECK(lines[0].ends_with("] logging again"));
+}
+
+TEST_CASE("Messages are written right away without a background thread", "[logger]") {
+  temp_log_file log;
+  logger::initialise(log.path(), logger::level::info, logger::format::text, false);
+
+  logger::message("written right away");
+
+  // without flushing
+  std::ifstream in(log.path());
+  std::string line;
+  REQUIRE(std::getline(in, line));
+  CHECK(line.ends_with("] written right away"));
+}
+
+TEST_CASE("Forking while other threads log", "[logger]") {
+  temp_log_file log;
+  // as in the daemon's parent process
+  logger::initialise(log.path(), logger::level::info, logger::format::text, false);
+
+  constexpr int children = 20;
+
+  {
+    std::atomic<bool> stop = false;
+    std::jthread writer([&stop] {
+      while (!stop)
+        logger::message("parent");
+    });
+
+    for (int i = 0; i < children; ++i) {
+      const pid_t pid = fork();
+      REQUIRE(pid >= 0);
+      if (pid == 0) {
+        // a child inheriting a locked logger would never get past this
+        alarm(10);
+        logger::initialise(log.path());
+        logger::message("child");
+        logger::flush();
+        _exit(0);
+      }
+
+      int status = 0;
+      REQUIRE(waitpid(pid, &status, 0) == pid);
+      CHECK(WIFEXITED(status));
+    }
+
+    stop = true;
+  }
+
+  const auto lines = log.lines();
+  CHECK(std::count_if(lines.begin(), lines.end(),
+                      [](const auto &l) { return l.ends_with("] child"); }) == children);
+}
+
+TEST_CASE("Parse log settings", "[logger]") {
+  CHECK(logger::parse_level("debug") == logger::level::debug);
+  CHECK(logger::parse_level("error") == logger::level::error);
+  CHECK_FALSE(logger::parse_level("verbose"));
+  CHECK(logger::parse_format("json") == logger::format::json);
+  CHECK_FALSE(logger::parse_format("xml"));
+}
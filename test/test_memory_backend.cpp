@@ -0,0 +1,750 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/memory/memory_selection.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+#include "cgimap/backend/memory/replication.hpp"
+#include "cgimap/backend/memory/snapshot.hpp"
+#include "cgimap/options.hpp"
+#include "cgimap/time.hpp"
+
+#include "test_formatter.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <fmt/core.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+const std::string test_xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<osm version="0.6" generator="test">
+  <changeset id="1" user="user_1" uid="1" created_at="2013-11-14T02:10:00Z" closed_at="2013-11-14T03:10:00Z" num_changes="0">
+    <tag k="comment" v="first"/>
+    <tag k="created_by" v="test"/>
+    <discussion>
+      <comment id="1" date="2013-11-14T04:00:00Z" uid="2" user="user_2">
+        <text>nice</text>
+      </comment>
+    </discussion>
+  </changeset>
+  <node id="2" version="1" changeset="1" lat="0.1" lon="0.1" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:10:01Z"/>
+  <node id="1" version="1" changeset="1" lat="0" lon="0" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:10:00Z">
+    <tag k="name" v="one"/>
+    <tag k="amenity" v="cafe"/>
+  </node>
+  <node id="1" version="2" changeset="2" lat="0.0000001" lon="-0.0000001" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:20:00Z" redaction="1"/>
+  <node id="3" version="1" changeset="2" lat="10" lon="10" visible="true" timestamp="2015-03-02T18:27:00Z"/>
+  <node id="3" version="2" changeset="3" lat="10" lon="10" visible="false" timestamp="2015-03-02T18:28:00Z"/>
+  <node id="1" version="3" changeset="3" lat="0.0000001" lon="-0.0000001" user="user_1" uid="1" visible="true" timestamp="2013-11-14T02:30:00Z"/>
+  <way id="1" version="1" changeset="2" user="user_1" uid="1" visible="true" timestamp="2015-03-02T18:27:00Z">
+    <nd ref="1"/>
+    <nd ref="2"/>
+    <nd ref="1"/>
+    <tag k="highway" v="residential"/>
+  </way>
+  <way id="2" version="1" changeset="2" visible="true" timestamp="2015-03-02T18:27:00Z">
+    <nd ref="3"/>
+    <nd ref="2"/>
+  </way>
+  <way id="2" version="2" changeset="3" visible="false" timestamp="2015-03-02T18:28:00Z"/>
+  <relation id="1" version="1" changeset="2" user="user_1" uid="1" visible="true" timestamp="2015-03-02T18:27:00Z">
+    <member type="node" ref="2" role="stop"/>
+    <member type="way" ref="1" role=""/>
+    <tag k="type" v="route"/>
+  </relation>
+  <relation id="2" version="1" changeset="3" user="user_1" uid="1" visible="true" timestamp="2015-03-02T18:28:00Z">
+    <member type="relation" ref="1" role="child"/>
+  </relation>
+</osm>
+)";
+
+std::shared_ptr<const osm_store> load_test_xml() {
+  return load_osm_xml(test_xml);
+}
+
+std::string temp_snapshot_name() {
+  return (std::filesystem::temp_directory_path() /
+          ("cgimap-test-" + std::to_string(getpid()) + ".snapshot")).string();
+}
+
+std::string read_file(const std::string &filename) {
+  std::ifstream in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void write_file(const std::string &filename, const std::string &data) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out << data;
+}
+
+// minimal protobuf encoder, to build PBF test files
+struct pb_writer {
+  std::string data;
+
+  void varint(uint64_t value) {
+    while (value >= 0x80) {
+      data += static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    data += static_cast<char>(value);
+  }
+
+  void key(uint32_t field, int wire_type) { varint((uint64_t(field) << 3) | wire_type); }
+
+  void uint_field(uint32_t field, uint64_t value) {
+    key(field, 0);
+    varint(value);
+  }
+
+  void bytes_field(uint32_t field, std::string_view value) {
+    key(field, 2);
+    varint(value.size());
+    data.append(value);
+  }
+
+  void packed_uint(uint32_t field, const std::vector<uint64_t> &values) {
+    pb_writer p;
+    for (auto v : values)
+      p.varint(v);
+    bytes_field(field, p.data);
+  }
+
+  void packed_delta(uint32_t field, const std::vector<int64_t> &values) {
+    pb_writer p;
+    int64_t last = 0;
+    for (auto v : values) {
+      p.varint(zigzag(v - last));
+      last = v;
+    }
+    bytes_field(field, p.data);
+  }
+
+  static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+};
+
+std::string pbf_blob(std::string_view type, const std::string &payload, bool compress) {
+  pb_writer blob;
+  if (compress) {
+    std::string out(compressBound(payload.size()), '\0');
+    uLongf size = out.size();
+    compress2(reinterpret_cast<Bytef *>(out.data()), &size,
+              reinterpret_cast<const Bytef *>(payload.data()), payload.size(), 6);
+    out.resize(size);
+    blob.uint_field(2, payload.size());
+    blob.bytes_field(3, out);
+  } else {
+    blob.bytes_field(1, payload);
+  }
+
+  pb_writer header;
+  header.bytes_field(1, type);
+  header.uint_field(3, blob.data.size());
+
+  std::string result;
+  const auto size = static_cast<uint32_t>(header.data.size());
+  result += static_cast<char>(size >> 24);
+  result += static_cast<char>(size >> 16);
+  result += static_cast<char>(size >> 8);
+  result += static_cast<char>(size);
+  return result + header.data + blob.data;
+}
+
+// the current versions of the test XML, without changesets
+std::string test_pbf(bool compress) {
+  pb_writer header;
+  header.bytes_field(4, "OsmSchema-V0.6");
+  header.bytes_field(4, "DenseNodes");
+  header.bytes_field(16, "test");
+
+  // string table, index 0 is unused
+  pb_writer strings;
+  for (auto s : {"", "user_1", "highway", "residential", "stop", "type", "route"})
+    strings.bytes_field(1, s);
+
+  pb_writer dense;
+  dense.packed_delta(1, {1, 2});
+  pb_writer dense_info;
+  dense_info.packed_uint(1, {3, 1});
+  dense_info.packed_delta(2, {1384396200, 1384395001});
+  dense_info.packed_delta(3, {3, 1});
+  dense_info.packed_delta(4, {1, 1});
+  dense_info.packed_delta(5, {1, 1});
+  dense.bytes_field(5, dense_info.data);
+  dense.packed_delta(8, {1, 1000000});
+  dense.packed_delta(9, {-1, 1000000});
+  dense.packed_uint(10, {0, 0});
+
+  pb_writer info;
+  info.uint_field(1, 1);
+  info.uint_field(2, 1425320820);
+  info.uint_field(3, 2);
+  info.uint_field(4, 1);
+  info.uint_field(5, 1);
+
+  pb_writer way;
+  way.uint_field(1, 1);
+  way.packed_uint(2, {2});
+  way.packed_uint(3, {3});
+  way.bytes_field(4, info.data);
+  way.packed_delta(8, {1, 2, 1});
+
+  pb_writer relation;
+  relation.uint_field(1, 1);
+  relation.packed_uint(2, {5});
+  relation.packed_uint(3, {6});
+  relation.bytes_field(4, info.data);
+  relation.packed_uint(8, {4, 0});
+  relation.packed_delta(9, {2, 1});
+  relation.packed_uint(10, {0, 1});
+
+  pb_writer nodes_group;
+  nodes_group.bytes_field(2, dense.data);
+  pb_writer ways_group;
+  ways_group.bytes_field(3, way.data);
+  pb_writer relations_group;
+  relations_group.bytes_field(4, relation.data);
+
+  pb_writer block;
+  block.bytes_field(1, strings.data);
+  block.bytes_field(2, nodes_group.data);
+  block.bytes_field(2, ways_group.data);
+  block.bytes_field(2, relations_group.data);
+  block.uint_field(17, 100);
+  block.uint_field(18, 1000);
+
+  return pbf_blob("OSMHeader", header.data, compress) + pbf_blob("OSMData", block.data, compress);
+}
+
+std::string gzip(const std::string &data) {
+  z_stream stream{};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = out.size();
+  deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+// a replication directory in the temp directory, removed afterwards
+struct replication_dir {
+  std::filesystem::path path = std::filesystem::temp_directory_path() /
+                               ("cgimap-test-" + std::to_string(getpid()) + "-replication");
+
+  replication_dir() { std::filesystem::remove_all(path); }
+  ~replication_dir() { std::filesystem::remove_all(path); }
+
+  void add(uint64_t sequence, const std::string &timestamp, const std::string &osc,
+           bool compress) {
+    const auto state = replication_file(path, sequence, ".state.txt");
+    std::filesystem::create_directories(state.parent_path());
+    if (compress)
+      write_file(replication_file(path, sequence, ".osc.gz").string(), gzip(osc));
+    else
+      write_file(replication_file(path, sequence, ".osc").string(), osc);
+
+    std::string escaped;
+    for (char c : timestamp) {
+      if (c == ':')
+        escaped += '\\';
+      escaped += c;
+    }
+    write_file(state.string(), "#Fri Jan 01 00:00:02 UTC 2016\nsequenceNumber=" +
+                                   std::to_string(sequence) + "\ntimestamp=" + escaped + "\n");
+  }
+};
+
+} // anonymous namespace
+
+TEST_CASE("Load OSM XML into a store", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto store = load_test_xml();
+
+  SECTION("Element versions are sorted") {
+    CHECK(store->nodes.ids == column<osm_nwr_id_t>{1, 1, 1, 2, 3, 3});
+    CHECK(store->nodes.versions == column<osm_version_t>{1, 2, 3, 1, 1, 2});
+    CHECK(store->nodes.current(1) == 2);
+    CHECK(store->nodes.find(1, 2) == 1);
+    CHECK_FALSE(store->nodes.find(1, 4));
+    CHECK_FALSE(store->nodes.current(4));
+    CHECK(store->nodes.redacted(1));
+  }
+
+  SECTION("Tags and coordinates move with their element") {
+    auto i = *store->nodes.find(1, 1);
+    auto tags = store->nodes.tags_of(i);
+    REQUIRE(tags.size() == 2);
+    // sorted by key
+    CHECK(store->string(tags[0].key) == "amenity");
+    CHECK(store->string(tags[1].value) == "one");
+    CHECK(store->nodes.lats[store->nodes.find(1, 3).value()] == 1);
+    CHECK(store->nodes.lons[store->nodes.find(1, 3).value()] == -1);
+    CHECK(store->nodes.lats[store->nodes.current(2).value()] == 1000000);
+  }
+
+  SECTION("Indexes only cover current, visible elements") {
+    std::vector<osm_nwr_id_t> ways;
+    osm_store::for_each_parent(store->node_ways, 2, [&](auto id) { ways.push_back(id); });
+    CHECK(ways == std::vector<osm_nwr_id_t>{1});
+
+    // node 1 is used twice by way 1
+    CHECK(store->node_ways == osm_store::parent_index{{1, 1}, {2, 1}});
+    CHECK(store->node_relations == osm_store::parent_index{{2, 1}});
+    CHECK(store->way_relations == osm_store::parent_index{{1, 1}});
+    CHECK(store->relation_relations == osm_store::parent_index{{1, 2}});
+    CHECK(store->node_tiles.size() == 2);
+  }
+
+  SECTION("Changesets count their element versions") {
+    REQUIRE(store->changesets.contains(1));
+    const auto &cs = store->changesets.at(1);
+    CHECK(cs.info.num_changes == 2);
+    CHECK(cs.info.comments_count == 1);
+    REQUIRE(cs.comments.size() == 1);
+    CHECK(cs.comments[0].body == "nice");
+    CHECK(cs.tags == tags_t{{"comment", "first"}, {"created_by", "test"}});
+  }
+}
+
+TEST_CASE("Reject invalid OSM XML", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+
+  CHECK_THROWS_AS(load_osm_xml(R"(<osm><node id="1" version="1" lat="0" lon="0"/>)"
+                               R"(<node id="1" version="1" lat="0" lon="0"/></osm>)"),
+                  std::runtime_error);
+  CHECK_THROWS_AS(load_osm_xml(R"(<osm><node id="x" lat="0" lon="0"/></osm>)"),
+                  std::runtime_error);
+  CHECK_THROWS_AS(load_osm_xml(R"(<osm><node id="1" lat="91" lon="0"/></osm>)"),
+                  std::runtime_error);
+  CHECK_THROWS_AS(load_osm_xml(R"(<osm><node id="1")"), std::runtime_error);
+}
+
+TEST_CASE("Select current elements from a store", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto store = load_test_xml();
+  memory_selection sel(store);
+
+  SECTION("Visibility") {
+    CHECK(sel.check_node_visibility(1) == data_selection::exists);
+    CHECK(sel.check_node_visibility(3) == data_selection::deleted);
+    CHECK(sel.check_node_visibility(4) == data_selection::non_exist);
+    CHECK(sel.check_way_visibility(2) == data_selection::deleted);
+    CHECK(sel.check_relation_visibility(3) == data_selection::non_exist);
+  }
+
+  SECTION("Nodes") {
+    CHECK(sel.select_nodes({3, 2, 1, 4}) == 3);
+    CHECK(sel.select_nodes({1}) == 0);
+
+    test_formatter f;
+    sel.write_nodes(f);
+    REQUIRE(f.m_nodes.size() == 3);
+    CHECK(f.m_nodes[0] == test_formatter::node_t(
+        element_info(1, 3, 3, "2013-11-14T02:30:00Z", 1, std::string("user_1"), true),
+        -0.0000001, 0.0000001, {}));
+    CHECK(f.m_nodes[2] == test_formatter::node_t(
+        element_info(3, 2, 3, "2015-03-02T18:28:00Z", {}, {}, false),
+        10, 10, {}));
+  }
+
+  SECTION("Bounding box") {
+    CHECK(sel.select_nodes_from_bbox(bbox(-0.5, -0.5, 0.5, 0.5), 10) == 2);
+    sel.select_ways_from_nodes();
+    sel.select_nodes_from_way_nodes();
+    sel.select_relations_from_ways();
+    sel.select_relations_from_nodes();
+    sel.select_relations_from_relations();
+
+    test_formatter f;
+    sel.write_nodes(f);
+    sel.write_ways(f);
+    sel.write_relations(f);
+    CHECK(f.m_nodes.size() == 2);
+    REQUIRE(f.m_ways.size() == 1);
+    CHECK(f.m_ways[0].nodes == nodes_t{1, 2, 1});
+    CHECK(f.m_ways[0].tags == tags_t{{"highway", "residential"}});
+    REQUIRE(f.m_relations.size() == 2);
+    CHECK(f.m_relations[0].members ==
+          members_t{{element_type::node, 2, "stop"}, {element_type::way, 1, ""}});
+  }
+
+  SECTION("Bounding box limit") {
+    // one more than the limit is selected, so that the caller can tell
+    CHECK(sel.select_nodes_from_bbox(bbox(-0.5, -0.5, 0.5, 0.5), 0) == 1);
+    CHECK(sel.select_nodes_from_bbox(bbox(20, 20, 21, 21), 10) == 0);
+  }
+
+  SECTION("Relation members") {
+    CHECK(sel.select_relations({2}) == 1);
+    sel.select_relations_members_of_relations();
+    sel.select_nodes_from_relations();
+    sel.select_ways_from_relations();
+
+    test_formatter f;
+    sel.write_nodes(f);
+    sel.write_ways(f);
+    sel.write_relations(f);
+    CHECK(f.m_nodes.size() == 1);
+    CHECK(f.m_ways.size() == 1);
+    CHECK(f.m_relations.size() == 2);
+  }
+
+  SECTION("Changesets") {
+    CHECK(sel.select_changesets({1, 2}) == 1);
+    sel.select_changeset_discussions();
+
+    test_formatter f;
+    sel.write_changesets(f, std::chrono::system_clock::now());
+    REQUIRE(f.m_changesets.size() == 1);
+    CHECK(f.m_changesets[0].m_include_comments);
+    CHECK(f.m_changesets[0].m_comments.size() == 1);
+  }
+}
+
+TEST_CASE("Select historic elements from a store", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto store = load_test_xml();
+  memory_selection sel(store);
+
+  SECTION("Redacted versions are hidden by default") {
+    CHECK(sel.select_nodes_with_history({1}) == 2);
+    CHECK(sel.select_historical_nodes({{1, 2}}) == 0);
+    sel.set_redactions_visible(true);
+    CHECK(sel.select_historical_nodes({{1, 2}, {1, 9}}) == 1);
+  }
+
+  SECTION("By changeset") {
+    CHECK(sel.select_historical_by_changesets({2}) == 4);
+
+    test_formatter f;
+    sel.write_nodes(f);
+    sel.write_ways(f);
+    sel.write_relations(f);
+    CHECK(f.m_nodes.size() == 1);
+    CHECK(f.m_ways.size() == 2);
+    CHECK(f.m_relations.size() == 1);
+  }
+
+  SECTION("Current and historic versions") {
+    CHECK(sel.select_nodes({1}) == 1);
+    CHECK(sel.select_historical_nodes({{1, 1}}) == 1);
+
+    test_formatter f;
+    sel.write_nodes(f);
+    REQUIRE(f.m_nodes.size() == 2);
+    CHECK(f.m_nodes[0].elem.version == 1);
+    CHECK(f.m_nodes[1].elem.version == 3);
+  }
+}
+
+TEST_CASE("Load OSM PBF into a store", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto xml = load_test_xml();
+
+  for (bool compress : {false, true}) {
+    std::shared_ptr<const osm_store> pbf = load_osm_pbf(test_pbf(compress));
+
+    memory_selection from_xml(xml);
+    memory_selection from_pbf(pbf);
+    for (auto *sel : {&from_xml, &from_pbf}) {
+      sel->select_nodes({1, 2});
+      sel->select_ways({1});
+      sel->select_relations({1});
+    }
+
+    test_formatter f_xml;
+    test_formatter f_pbf;
+    from_xml.write_nodes(f_xml);
+    from_xml.write_ways(f_xml);
+    from_xml.write_relations(f_xml);
+    from_pbf.write_nodes(f_pbf);
+    from_pbf.write_ways(f_pbf);
+    from_pbf.write_relations(f_pbf);
+
+    CHECK(f_pbf.m_nodes == f_xml.m_nodes);
+    CHECK(f_pbf.m_ways == f_xml.m_ways);
+    CHECK(f_pbf.m_relations == f_xml.m_relations);
+    CHECK(pbf->node_ways == osm_store::parent_index{{1, 1}, {2, 1}});
+  }
+}
+
+TEST_CASE("Reject invalid OSM PBF", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  const auto pbf = test_pbf(true);
+
+  CHECK_THROWS_AS(load_osm_pbf(pbf.substr(0, pbf.size() - 10)), std::runtime_error);
+  CHECK_THROWS_AS(load_osm_pbf("garbage"), std::runtime_error);
+
+  pb_writer header;
+  header.bytes_field(4, "Sort.Type_then_ID");
+  header.bytes_field(4, "LocationsOnWays");
+  CHECK_THROWS_AS(load_osm_pbf(pbf_blob("OSMHeader", header.data, false)), std::runtime_error);
+}
+
+TEST_CASE("Write and map a snapshot", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto built = load_test_xml();
+
+  const auto filename = temp_snapshot_name();
+  write_snapshot(*built, filename);
+  std::shared_ptr<const osm_store> mapped = load_snapshot(filename);
+  // the mapping stays valid after the file is removed
+  std::filesystem::remove(filename);
+
+  SECTION("Columns are mapped, not copied") {
+    CHECK(mapped->memory_usage() == 0);
+    CHECK(mapped->nodes.ids == built->nodes.ids);
+    CHECK(mapped->nodes.lats == built->nodes.lats);
+    CHECK(mapped->ways.way_nodes == built->ways.way_nodes);
+    CHECK(mapped->node_tiles == built->node_tiles);
+    CHECK(mapped->relation_relations == built->relation_relations);
+    CHECK(mapped->changesets.empty());
+  }
+
+  SECTION("Selections are the same") {
+    memory_selection from_built(built);
+    memory_selection from_mapped(mapped);
+    for (auto *sel : {&from_built, &from_mapped}) {
+      CHECK(sel->select_nodes_from_bbox(bbox(-0.5, -0.5, 0.5, 0.5), 10) == 2);
+      sel->select_ways_from_nodes();
+      sel->select_nodes_from_way_nodes();
+      sel->select_relations_from_ways();
+      sel->select_relations_from_nodes();
+      sel->select_relations_from_relations();
+      sel->select_historical_nodes({{1, 1}});
+    }
+
+    test_formatter f_built;
+    test_formatter f_mapped;
+    from_built.write_nodes(f_built);
+    from_built.write_ways(f_built);
+    from_built.write_relations(f_built);
+    from_mapped.write_nodes(f_mapped);
+    from_mapped.write_ways(f_mapped);
+    from_mapped.write_relations(f_mapped);
+
+    CHECK(f_mapped.m_nodes.size() == 3);
+    CHECK(f_mapped.m_nodes == f_built.m_nodes);
+    CHECK(f_mapped.m_ways == f_built.m_ways);
+    CHECK(f_mapped.m_relations == f_built.m_relations);
+  }
+}
+
+TEST_CASE("Reject invalid snapshots", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto store = load_test_xml();
+
+  const auto filename = temp_snapshot_name();
+  write_snapshot(*store, filename);
+  const auto snapshot = read_file(filename);
+
+  SECTION("Truncated") {
+    write_file(filename, snapshot.substr(0, snapshot.size() / 2));
+    CHECK_THROWS_AS(load_snapshot(filename), std::runtime_error);
+  }
+
+  SECTION("Not a snapshot") {
+    write_file(filename, test_xml);
+    CHECK_THROWS_AS(load_snapshot(filename), std::runtime_error);
+  }
+
+  SECTION("Other format version") {
+    auto other = snapshot;
+    other[8] = static_cast<char>(snapshot_format_version + 1);
+    write_file(filename, other);
+    CHECK_THROWS_AS(load_snapshot(filename), std::runtime_error);
+  }
+
+  std::filesystem::remove(filename);
+}
+
+TEST_CASE("Parse replication state files", "[memory]") {
+
+  auto state = parse_replication_state(
+      "#Fri Jan 01 00:00:02 UTC 2016\r\n"
+      "sequenceNumber=1234567\r\n"
+      "timestamp=2016-01-01T00\\:00\\:00Z\r\n");
+  CHECK(state.sequence == 1234567);
+  CHECK(state.timestamp == parse_time("2016-01-01T00:00:00Z"));
+
+  CHECK(replication_file("minute", 1234567, ".osc.gz") ==
+        std::filesystem::path("minute/001/234/567.osc.gz"));
+  CHECK(replication_file("minute", 12, ".state.txt") ==
+        std::filesystem::path("minute/000/000/012.state.txt"));
+
+  CHECK_THROWS_AS(parse_replication_state("sequenceNumber=1\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_replication_state("sequenceNumber=x\ntimestamp=2016-01-01T00\\:00\\:00Z\n"),
+                  std::runtime_error);
+}
+
+TEST_CASE("Apply replication diffs", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto published = std::make_shared<published_dataset>(
+      std::make_shared<osm_dataset>(load_test_xml()));
+  memory_selection::factory factory(published);
+  Transaction_Owner_Memory owner;
+
+  replication_dir dir;
+  dir.add(100, "2016-01-01T00:00:00Z", R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6" generator="test">
+  <modify>
+    <node id="2" version="2" changeset="4" lat="20" lon="20" user="user_2" uid="2" timestamp="2016-01-01T00:00:00Z"/>
+    <way id="1" version="2" changeset="4" user="user_2" uid="2" timestamp="2016-01-01T00:00:00Z">
+      <nd ref="1"/>
+      <nd ref="4"/>
+      <tag k="highway" v="primary"/>
+    </way>
+  </modify>
+  <create>
+    <node id="4" version="1" changeset="4" lat="0.2" lon="0.2" user="user_2" uid="2" timestamp="2016-01-01T00:00:00Z">
+      <tag k="name" v="four"/>
+    </node>
+  </create>
+</osmChange>
+)", false);
+  dir.add(101, "2016-01-02T00:00:00Z", R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6" generator="test">
+  <modify>
+    <node id="1" version="3" changeset="3" lat="5" lon="5" timestamp="2013-11-14T02:30:00Z">
+      <tag k="stale" v="yes"/>
+    </node>
+  </modify>
+  <delete>
+    <relation id="2" version="2" changeset="5" timestamp="2016-01-02T00:00:00Z"/>
+  </delete>
+</osmChange>
+)", true);
+
+  // made before the diffs are applied, keeps the data it started with
+  auto before = factory.make_selection(owner);
+  CHECK_FALSE(before->data_timestamp());
+
+  replication_applier applier(dir.path, 100, published);
+  REQUIRE(applier.apply_available() == 2);
+  CHECK(applier.apply_available() == 0);
+
+  auto sel = factory.make_selection(owner);
+  CHECK(published->get()->sequence() == 101);
+  CHECK(sel->data_timestamp() == parse_time("2016-01-02T00:00:00Z"));
+
+  SECTION("Selections keep their dataset") {
+    CHECK(before->select_nodes_from_bbox(bbox(19.5, 19.5, 20.5, 20.5), 10) == 0);
+    CHECK(before->check_relation_visibility(2) == data_selection::exists);
+    CHECK(sel->select_nodes_from_bbox(bbox(19.5, 19.5, 20.5, 20.5), 10) == 1);
+  }
+
+  SECTION("Bounding box") {
+    CHECK(sel->select_nodes_from_bbox(bbox(-0.5, -0.5, 0.5, 0.5), 10) == 2);
+    sel->select_ways_from_nodes();
+    sel->select_nodes_from_way_nodes();
+    sel->select_relations_from_ways();
+    sel->select_relations_from_nodes();
+    sel->select_relations_from_relations();
+
+    test_formatter f;
+    sel->write_nodes(f);
+    sel->write_ways(f);
+    sel->write_relations(f);
+    REQUIRE(f.m_nodes.size() == 2);
+    CHECK(f.m_nodes[1] == test_formatter::node_t(
+        element_info(4, 1, 4, "2016-01-01T00:00:00Z", 2, std::string("user_2"), true),
+        0.2, 0.2, {{"name", "four"}}));
+    REQUIRE(f.m_ways.size() == 1);
+    CHECK(f.m_ways[0].elem.version == 2);
+    CHECK(f.m_ways[0].nodes == nodes_t{1, 4});
+    CHECK(f.m_ways[0].tags == tags_t{{"highway", "primary"}});
+    // relation 1 still refers to way 1, relation 2 is deleted
+    REQUIRE(f.m_relations.size() == 1);
+    CHECK(f.m_relations[0].elem.id == 1);
+  }
+
+  SECTION("Stale versions are skipped") {
+    CHECK(sel->select_nodes({1}) == 1);
+    test_formatter f;
+    sel->write_nodes(f);
+    REQUIRE(f.m_nodes.size() == 1);
+    CHECK(f.m_nodes[0].elem.version == 3);
+    CHECK(f.m_nodes[0].lat == 0.0000001);
+    CHECK(f.m_nodes[0].tags.empty());
+  }
+
+  SECTION("Deleted and historic versions") {
+    CHECK(sel->check_relation_visibility(2) == data_selection::deleted);
+    CHECK(sel->select_nodes_with_history({2}) == 2);
+    CHECK(sel->select_ways_with_history({1}) == 2);
+    // only node 4 wasn't selected already
+    CHECK(sel->select_historical_by_changesets({4}) == 1);
+
+    test_formatter f;
+    sel->write_nodes(f);
+    sel->write_ways(f);
+    REQUIRE(f.m_nodes.size() == 3);
+    CHECK(f.m_nodes[0].elem.version == 1);
+    CHECK(f.m_nodes[1].elem.version == 2);
+    CHECK(f.m_nodes[2].elem.id == 4);
+    REQUIRE(f.m_ways.size() == 2);
+    CHECK(f.m_ways[1].nodes == nodes_t{1, 4});
+  }
+}
+
+TEST_CASE("Merge stores of replication diffs", "[memory]") {
+
+  global_settings::set_configuration(std::make_unique<global_settings_default>());
+  auto published = std::make_shared<published_dataset>(
+      std::make_shared<osm_dataset>(load_test_xml()));
+
+  // moves node 2 by one degree with every diff
+  replication_dir dir;
+  for (int i = 1; i <= 50; ++i) {
+    dir.add(i, "2016-01-01T00:00:00Z", fmt::format(R"(<osmChange version="0.6">
+  <modify>
+    <node id="2" version="{}" changeset="4" lat="{}" lon="0.1" timestamp="2016-01-01T00:00:00Z"/>
+  </modify>
+</osmChange>
+)", i + 1, i % 2 == 0 ? 0.1 : 1.0), i % 2 == 0);
+  }
+
+  replication_applier applier(dir.path, 1, published);
+  REQUIRE(applier.apply_available() == 50);
+
+  const auto dataset = published->get();
+  CHECK(dataset->sequence() == 50);
+  CHECK(dataset->layers().size() <= 4);
+
+  memory_selection sel(dataset);
+  CHECK(sel.select_nodes_with_history({2}) == 51);
+  CHECK(sel.select_nodes_from_bbox(bbox(-0.5, -0.5, 0.5, 0.5), 10) == 2);
+  sel.select_ways_from_nodes();
+  CHECK(sel.select_ways({1}) == 0);
+}
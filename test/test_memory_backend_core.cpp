@@ -0,0 +1,116 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/process_request.hpp"
+#include "cgimap/backend/memory/memory_selection.hpp"
+#include "cgimap/backend/memory/osm_file.hpp"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "test_core_helper.hpp"
+#include "test_request.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_session.hpp>
+
+fs::path test_directory{};
+
+std::vector<fs::path> get_test_cases() {
+  std::vector<fs::path> test_cases;
+
+  for (const auto& entry : fs::directory_iterator(test_directory)) {
+    const fs::path& filename = entry.path();
+    // database errors can't be simulated for the memory backend
+    if (filename.extension() == ".case" &&
+        filename.filename().string().find("inject_db_error") == std::string::npos) {
+      test_cases.push_back(filename);
+    }
+  }
+  return test_cases;
+}
+
+// runs the same test cases as the apidb backend, but against an osm_store
+// loaded from the data.osm file of the test directory. test directories
+// relying on user accounts, roles or OAuth2 tokens are skipped, as the
+// memory backend doesn't support them.
+TEST_CASE( "memory core", "[core][memory]" ) {
+
+  if (test_directory.empty()) {
+    FAIL("No test directory specified. Missing --test-directory command line option.");
+  }
+
+  if (!fs::is_directory(test_directory)) {
+    FAIL("Test directory does not exist.");
+  }
+
+  fs::path data_file = test_directory / "data.osm";
+
+  if (!fs::is_regular_file(data_file)) {
+    FAIL("data.osm file does not exist in given test directory.");
+  }
+
+  if (fs::exists(test_directory / "oauth2.json") ||
+      fs::exists(test_directory / "roles.json")) {
+    SKIP("Test directory requires user accounts.");
+  }
+
+  std::shared_ptr<const osm_store> store;
+  REQUIRE_NOTHROW(store = load_osm_file(data_file.string()));
+
+  null_rate_limiter limiter;
+  routes route;
+  memory_selection::factory sel_factory(
+      std::make_shared<published_dataset>(std::make_shared<osm_dataset>(store)));
+
+  auto test_cases = get_test_cases();
+  if (test_cases.empty()) {
+    FAIL("No test cases found in the test directory.");
+  }
+
+  for (const fs::path& test_case : test_cases) {
+    SECTION("Execute single testcase " + test_case.filename().string()) {
+      std::string generator = fmt::format(PACKAGE_STRING " (test {})", test_case.string());
+      test_request req;
+
+      // set up request headers from test case
+      std::ifstream in(test_case, std::ios::binary);
+      setup_request_headers(req, in);
+
+      // execute the request
+      REQUIRE_NOTHROW(process_request(req, limiter, generator, route, sel_factory, nullptr));
+
+      CAPTURE(req.body().str());
+      REQUIRE_NOTHROW(check_response(in, req.buffer()));
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Catch::Session session;
+
+  using namespace Catch::Clara;
+  auto cli =
+      session.cli()
+      | Opt(test_directory,
+        "test-directory")
+        ["--test-directory"]
+        ("test case directory");
+
+  session.cli(cli);
+
+  if (int returnCode = session.applyCommandLine(argc, argv); returnCode != 0)
+    return returnCode;
+
+  return session.run();
+}
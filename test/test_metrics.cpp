@@ -0,0 +1,162 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/metrics.hpp"
+
+#include <array>
+#include <chrono>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::ContainsSubstring;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string http_get(int port, const std::string &path) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  REQUIRE(fd >= 0);
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+
+  const std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+  REQUIRE(send(fd, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+
+  std::string response;
+  std::array<char, 4096> buffer;
+  ssize_t n;
+  while ((n = recv(fd, buffer.data(), buffer.size(), 0)) > 0)
+    response.append(buffer.data(), n);
+
+  close(fd);
+  return response;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Route names", "[metrics]") {
+  CHECK(metrics::route_name("node") == "node");
+  CHECK(metrics::route_name("node/history") == "node/history");
+  CHECK(metrics::route_name("map(1.0000000,2.0000000,3.0000000,4.0000000)") == "map");
+  CHECK(metrics::route_name("nodes?nodes=1,2,3") == "nodes");
+  CHECK(metrics::route_name("changeset/upload 123") == "changeset/upload");
+}
+
+TEST_CASE("Metrics are ignored until initialised", "[metrics]") {
+  metrics::count_rate_limited();
+  CHECK(metrics::render().empty());
+}
+
+TEST_CASE("Metrics in Prometheus text format", "[metrics]") {
+
+  metrics::initialise(256);
+
+  metrics::observe_request("node", 200, 3ms);
+  metrics::observe_request("node", 200, 700ms);
+  metrics::observe_request("node", 404, 1ms);
+  metrics::observe_statement("objs_from_nodes", 20ms);
+  metrics::add_response_bytes("gzip", 1000, 200);
+  metrics::add_response_bytes("gzip", 500, 100);
+  metrics::count_rate_limited();
+  metrics::count_cache_lookup("prepared_statements", true);
+  metrics::count_cache_lookup("prepared_statements", true);
+  metrics::count_cache_lookup("prepared_statements", false);
+  metrics::observe_cache_age("map", std::chrono::seconds(45));
+
+  const auto out = metrics::render();
+
+  CHECK_THAT(out, ContainsSubstring("# TYPE cgimap_requests_total counter\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_requests_total{route=\"node\",status=\"200\"} 2\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_requests_total{route=\"node\",status=\"404\"} 1\n"));
+
+  CHECK_THAT(out, ContainsSubstring("# TYPE cgimap_request_duration_seconds histogram\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_bucket{route=\"node\",le=\"0.001\"} 1\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_bucket{route=\"node\",le=\"0.005\"} 2\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_bucket{route=\"node\",le=\"0.5\"} 2\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_bucket{route=\"node\",le=\"1\"} 3\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_bucket{route=\"node\",le=\"+Inf\"} 3\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_sum{route=\"node\"} 0.704\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_request_duration_seconds_count{route=\"node\"} 3\n"));
+
+  CHECK_THAT(out, ContainsSubstring("cgimap_db_statement_duration_seconds_count{statement=\"objs_from_nodes\"} 1\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_response_bytes_total{encoding=\"gzip\"} 300\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_response_bytes_uncompressed_total{encoding=\"gzip\"} 1500\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_ratelimit_rejections_total 1\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_cache_lookups_total{cache=\"prepared_statements\",result=\"hit\"} 2\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_cache_lookups_total{cache=\"prepared_statements\",result=\"miss\"} 1\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_cache_entry_age_seconds_bucket{cache=\"map\",le=\"30\"} 0\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_cache_entry_age_seconds_bucket{cache=\"map\",le=\"60\"} 1\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_cache_entry_age_seconds_sum{cache=\"map\"} 45\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_metrics_dropped_series_total 0\n"));
+}
+
+TEST_CASE("Metrics recorded in child processes", "[metrics]") {
+
+  metrics::initialise(256);
+
+  constexpr int children = 4;
+
+  for (int c = 0; c < children; ++c) {
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+      for (int i = 0; i < 100; ++i)
+        metrics::observe_request(c % 2 ? "way" : "relation", 200, 1ms);
+      _exit(0);
+    }
+  }
+
+  for (int c = 0; c < children; ++c) {
+    int status = 0;
+    REQUIRE(wait(&status) > 0);
+    REQUIRE(WIFEXITED(status));
+  }
+
+  const auto out = metrics::render();
+  CHECK_THAT(out, ContainsSubstring("cgimap_requests_total{route=\"relation\",status=\"200\"} 200\n"));
+  CHECK_THAT(out, ContainsSubstring("cgimap_requests_total{route=\"way\",status=\"200\"} 200\n"));
+}
+
+TEST_CASE("Full metrics registry", "[metrics]") {
+
+  metrics::initialise(4);
+
+  for (int i = 0; i < 10; ++i)
+    metrics::count_cache_lookup("cache" + std::to_string(i), true);
+
+  CHECK_THAT(metrics::render(), ContainsSubstring("cgimap_metrics_dropped_series_total 6\n"));
+}
+
+TEST_CASE("Metrics server", "[metrics]") {
+
+  metrics::initialise(256);
+  metrics::observe_request("node", 200, 1ms);
+
+  metrics::server server("127.0.0.1:0");
+  REQUIRE(server.port() > 0);
+
+  const auto response = http_get(server.port(), "/metrics");
+  CHECK(response.starts_with("HTTP/1.0 200 OK\r\n"));
+  CHECK_THAT(response, ContainsSubstring("Content-Type: text/plain; version=0.0.4"));
+  CHECK_THAT(response, ContainsSubstring("cgimap_requests_total{route=\"node\",status=\"200\"} 1\n"));
+
+  CHECK(http_get(server.port(), "/").starts_with("HTTP/1.0 404 Not Found\r\n"));
+}
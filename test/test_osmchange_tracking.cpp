@@ -0,0 +1,152 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/api06/changeset_upload/osmchange_tracking.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <stdexcept>
+
+namespace {
+
+// Tracking data as the updaters would report it for an upload with the
+// given number of created, modified and deleted elements per object type.
+// Half of the deletions use if-unused and get skipped.
+api06::OSMChange_Tracking synthetic_upload(int elements_per_type) {
+
+  api06::OSMChange_Tracking ct;
+
+  const osm_nwr_id_t base_id = 1000000;
+
+  for (auto type : { object_type::node, object_type::way, object_type::relation }) {
+
+    auto &created = (type == object_type::node) ? ct.created_node_ids :
+                    (type == object_type::way)  ? ct.created_way_ids :
+                                                  ct.created_relation_ids;
+    auto &modified = (type == object_type::node) ? ct.modified_node_ids :
+                     (type == object_type::way)  ? ct.modified_way_ids :
+                                                   ct.modified_relation_ids;
+    auto &deleted = (type == object_type::node) ? ct.deleted_node_ids :
+                    (type == object_type::way)  ? ct.deleted_way_ids :
+                                                  ct.deleted_relation_ids;
+    auto &skipped = (type == object_type::node) ? ct.skip_deleted_node_ids :
+                    (type == object_type::way)  ? ct.skip_deleted_way_ids :
+                                                  ct.skip_deleted_relation_ids;
+
+    for (int i = 1; i <= elements_per_type; ++i) {
+      created.push_back({ -i, base_id + i, 1 });
+      ct.osmchange_orig_sequence.push_back({ operation::op_create, type, -i, 0, false });
+    }
+
+    for (int i = 1; i <= elements_per_type; ++i) {
+      modified.push_back({ i, static_cast<osm_nwr_id_t>(i), 3 });
+      ct.osmchange_orig_sequence.push_back({ operation::op_modify, type, i, 2, false });
+    }
+
+    for (int i = 1; i <= elements_per_type; ++i) {
+      const osm_nwr_signed_id_t id = 2 * base_id + i;
+      const bool if_unused = (i % 2 == 0);
+      if (if_unused)
+        skipped.push_back({ id, static_cast<osm_nwr_id_t>(id), 4 });
+      else
+        deleted.push_back(id);
+      ct.osmchange_orig_sequence.push_back({ operation::op_delete, type, id, 3, if_unused });
+    }
+  }
+
+  return ct;
+}
+
+} // anonymous namespace
+
+TEST_CASE("diffResult follows osmChange sequence", "[osmchange][diffresult]") {
+
+  api06::OSMChange_Tracking ct;
+
+  ct.created_way_ids.push_back({ -1, 100, 1 });
+  ct.created_node_ids.push_back({ -1, 200, 1 });
+  ct.modified_node_ids.push_back({ 5, 5, 2 });
+  ct.modified_node_ids.push_back({ 5, 5, 3 });
+  ct.deleted_relation_ids.push_back(7);
+  ct.skip_deleted_way_ids.push_back({ 8, 8, 4 });
+
+  ct.osmchange_orig_sequence = {
+    { operation::op_create, object_type::node, -1, 0, false },
+    { operation::op_create, object_type::way, -1, 0, false },
+    { operation::op_modify, object_type::node, 5, 2, false },
+    { operation::op_modify, object_type::node, 5, 1, false },
+    { operation::op_delete, object_type::way, 8, 4, true },
+    { operation::op_delete, object_type::relation, 7, 1, true },
+  };
+
+  auto result = ct.assemble_diffresult();
+
+  REQUIRE(result.size() == 6);
+
+  CHECK(result[0].obj_type == object_type::node);
+  CHECK(result[0].new_id == 200);
+
+  CHECK(result[1].obj_type == object_type::way);
+  CHECK(result[1].new_id == 100);
+
+  CHECK(result[2].op == operation::op_modify);
+  CHECK(result[2].new_version == 3);
+  CHECK(result[3].new_version == 2);
+
+  CHECK(result[4].deletion_skipped);
+  CHECK(result[4].new_id == 8);
+  CHECK(result[4].new_version == 4);
+
+  CHECK_FALSE(result[5].deletion_skipped);
+  CHECK(result[5].old_id == 7);
+  CHECK(result[5].new_id == 0);
+}
+
+TEST_CASE("diffResult for synthetic upload", "[osmchange][diffresult]") {
+
+  auto ct = synthetic_upload(1000);
+  auto result = ct.assemble_diffresult();
+
+  REQUIRE(result.size() == ct.osmchange_orig_sequence.size());
+
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    const auto &item = ct.osmchange_orig_sequence[i];
+    CHECK(result[i].op == item.op);
+    CHECK(result[i].obj_type == item.obj_type);
+    CHECK(result[i].old_id == item.orig_id);
+    if (item.op == operation::op_delete)
+      CHECK(result[i].deletion_skipped == item.if_unused);
+  }
+}
+
+TEST_CASE("diffResult for unprocessed element", "[osmchange][diffresult]") {
+
+  api06::OSMChange_Tracking ct;
+  ct.created_node_ids.push_back({ -1, 200, 1 });
+
+  ct.osmchange_orig_sequence = {
+    { operation::op_create, object_type::node, -1, 0, false },
+    { operation::op_create, object_type::node, -2, 0, false },
+  };
+
+  REQUIRE_THROWS_AS(ct.assemble_diffresult(), std::runtime_error);
+}
+
+// Run with: test_osmchange_tracking "[benchmark]"
+TEST_CASE("diffResult assembly benchmark", "[.][benchmark]") {
+
+  for (int elements : { 1000, 10000, 100000 }) {
+    auto ct = synthetic_upload(elements / 9);
+
+    BENCHMARK("assemble_diffresult " + std::to_string(elements) + " elements") {
+      return ct.assemble_diffresult();
+    };
+  }
+}
@@ -115,6 +115,12 @@ TEST_CASE("Invalid max-element-tags", "[options]") {
   REQUIRE_THROWS_AS(check_options(vm), std::invalid_argument);
 }
 
+TEST_CASE("Invalid max-request-memory", "[options]") {
+  po::variables_map vm;
+  vm.emplace("max-request-memory", po::variable_value(0L, false));
+  REQUIRE_THROWS_AS(check_options(vm), std::invalid_argument);
+}
+
 TEST_CASE("Invalid maxdebt", "[options]") {
   po::variables_map vm;
   vm.emplace("maxdebt", po::variable_value(-500L, false));
@@ -154,6 +160,8 @@ TEST_CASE("Set all supported options" "[options]") {
   vm.emplace("moderator-maxdebt", po::variable_value(1000L, false));
   vm.emplace("ratelimit-upload", po::variable_value(true, false));
   vm.emplace("bbox-size-limit-upload", po::variable_value(true, false));
+  vm.emplace("server-timing-clients", po::variable_value(std::string("127.0.0.1, ::1"), false));
+  vm.emplace("max-request-memory", po::variable_value(512L, false));
   REQUIRE_NOTHROW(check_options(vm));
 
   REQUIRE( global_settings::get_payload_max_size() == 40000 );
@@ -172,4 +180,6 @@ TEST_CASE("Set all supported options" "[options]") {
   REQUIRE( global_settings::get_ratelimiter_maxdebt(true) == 1000l * 1024 * 1024 );
   REQUIRE( global_settings::get_ratelimiter_upload() == true );
   REQUIRE( global_settings::get_bbox_size_limiter_upload() == true );
+  REQUIRE( global_settings::get_server_timing_clients() == std::set<std::string>{"127.0.0.1", "::1"} );
+  REQUIRE( global_settings::get_request_memory_max() == 512ul * 1024 * 1024 );
 }
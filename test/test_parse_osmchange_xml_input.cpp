@@ -9,6 +9,7 @@
 
 
 #include "cgimap/options.hpp"
+#include "cgimap/api06/changeset_upload/lock_plan.hpp"
 #include "cgimap/api06/changeset_upload/osmchange_xml_input_format.hpp"
 #include "cgimap/api06/changeset_upload/parser_callback.hpp"
 #include "cgimap/http.hpp"
@@ -665,3 +666,48 @@ TEST_CASE("Create relation, members >= max members", "[osmchange][relation][xml]
       http::bad_request);
   }
 }
+
+// LOCK PLAN TESTS
+
+TEST_CASE("Lock plan, placeholder ids are not locked", "[osmchange][lock]") {
+  api06::Lock_Plan plan;
+  plan.add_exclusive(object_type::node, -1);
+  plan.add_shared(object_type::node, -2);
+
+  REQUIRE(plan.locks(object_type::node).empty());
+}
+
+TEST_CASE("Lock plan, ids are sorted and unique", "[osmchange][lock]") {
+  api06::Lock_Plan plan;
+  for (osm_nwr_signed_id_t id : {5, 3, 5, 1, 3})
+    plan.add_exclusive(object_type::way, id);
+  for (osm_nwr_signed_id_t id : {9, 7, 9})
+    plan.add_shared(object_type::way, id);
+
+  auto locks = plan.locks(object_type::way);
+  CHECK(locks.exclusive_ids == std::vector<osm_nwr_id_t>{1, 3, 5});
+  CHECK(locks.shared_ids == std::vector<osm_nwr_id_t>{7, 9});
+}
+
+TEST_CASE("Lock plan, exclusive lock covers shared lock", "[osmchange][lock]") {
+  api06::Lock_Plan plan;
+  plan.add_shared(object_type::relation, 2);
+  plan.add_shared(object_type::relation, 4);
+  plan.add_exclusive(object_type::relation, 2);
+
+  auto locks = plan.locks(object_type::relation);
+  CHECK(locks.exclusive_ids == std::vector<osm_nwr_id_t>{2});
+  CHECK(locks.shared_ids == std::vector<osm_nwr_id_t>{4});
+}
+
+TEST_CASE("Lock plan, tables are kept apart", "[osmchange][lock]") {
+  api06::Lock_Plan plan;
+  plan.add_exclusive(object_type::node, 1);
+  plan.add_shared(object_type::way, 1);
+
+  CHECK(plan.locks(object_type::node).exclusive_ids == std::vector<osm_nwr_id_t>{1});
+  CHECK(plan.locks(object_type::node).shared_ids.empty());
+  CHECK(plan.locks(object_type::way).exclusive_ids.empty());
+  CHECK(plan.locks(object_type::way).shared_ids == std::vector<osm_nwr_id_t>{1});
+  CHECK(plan.locks(object_type::relation).empty());
+}
@@ -0,0 +1,169 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/options.hpp"
+#include "cgimap/rate_limit_table.hpp"
+#include "cgimap/rate_limiter.hpp"
+
+#include <fmt/core.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Rate limit table decay", "[ratelimiter]") {
+  CHECK(rate_limit_table::decay(1000, 100, 100, 10) == 1000);
+  CHECK(rate_limit_table::decay(1000, 100, 150, 10) == 500);
+  CHECK(rate_limit_table::decay(1000, 100, 200, 10) == 0);
+  CHECK(rate_limit_table::decay(1000, 100, 300, 10) == 0);
+  // clock going backwards doesn't add to the debt
+  CHECK(rate_limit_table::decay(1000, 100, 50, 10) == 1000);
+}
+
+TEST_CASE("Rate limit table bookkeeping", "[ratelimiter]") {
+
+  rate_limit_table table(64);
+
+  SECTION("Unknown key") {
+    CHECK(table.bytes_served("addr:1.2.3.4", 100, 10) == 0);
+    CHECK(table.take_pending("addr:1.2.3.4") == 0);
+  }
+
+  SECTION("Bytes served decay over time") {
+    table.add("addr:1.2.3.4", 100, 1000, 10);
+    table.add("addr:1.2.3.4", 110, 500, 10);
+    CHECK(table.bytes_served("addr:1.2.3.4", 110, 10) == 1400);
+    CHECK(table.bytes_served("addr:1.2.3.4", 150, 10) == 1000);
+    CHECK(table.bytes_served("addr:5.6.7.8", 110, 10) == 0);
+  }
+
+  SECTION("Pending bytes are handed out once") {
+    table.add("user:1", 100, 1000, 10);
+    table.add("user:1", 100, 500, 10);
+    CHECK(table.take_pending("user:1") == 1500);
+    CHECK(table.take_pending("user:1") == 0);
+
+    table.restore_pending("user:1", 700);
+    CHECK(table.take_pending("user:1") == 700);
+
+    // taking pending bytes doesn't change the bytes served locally
+    CHECK(table.bytes_served("user:1", 100, 10) == 1500);
+  }
+
+  SECTION("Merge usage from memcached") {
+    table.add("user:1", 100, 1000, 10);
+
+    // the reported bytes are part of the usage of all hosts
+    CHECK(table.take_pending("user:1") == 1000);
+    table.merge("user:1", 100, 5000, 10);
+    CHECK(table.bytes_served("user:1", 100, 10) == 5000);
+
+    // bytes served while memcached was updated are added on top, and
+    // reported in the next round
+    table.add("user:1", 100, 1000, 10);
+    table.merge("user:1", 100, 2000, 10);
+    CHECK(table.bytes_served("user:1", 100, 10) == 3000);
+    CHECK(table.take_pending("user:1") == 1000);
+
+    // keys without recent usage don't take up space
+    table.merge("user:2", 100, 0, 10);
+    CHECK(table.bytes_served("user:2", 100, 10) == 0);
+
+    table.merge("user:3", 100, 300, 10);
+    CHECK(table.bytes_served("user:3", 100, 10) == 300);
+  }
+
+  SECTION("Long keys are truncated") {
+    const std::string long_key(200, 'x');
+    table.add(long_key, 100, 1000, 10);
+    CHECK(table.bytes_served(long_key, 100, 10) == 1000);
+    CHECK(table.bytes_served(long_key.substr(0, rate_limit_table::max_key_length), 100, 10) == 1000);
+  }
+
+  SECTION("Least recently updated entries are replaced") {
+    REQUIRE(table.size() >= 64);
+
+    for (int i = 0; i < 1000; ++i)
+      table.add(fmt::format("addr:{}", i), 100 + i, 1000, 1);
+
+    // most recent clients are still known
+    CHECK(table.bytes_served("addr:999", 1099, 1) == 1000);
+
+    int known = 0;
+    for (int i = 0; i < 1000; ++i)
+      if (table.bytes_served(fmt::format("addr:{}", i), 1099, 1) > 0)
+        ++known;
+
+    CHECK(known > 0);
+    CHECK(known <= static_cast<int>(table.size()));
+  }
+}
+
+TEST_CASE("Rate limit table is shared with child processes", "[ratelimiter]") {
+
+  rate_limit_table table(1024);
+
+  constexpr int children = 4;
+  constexpr int updates = 1000;
+
+  for (int c = 0; c < children; ++c) {
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+      for (int i = 0; i < updates; ++i)
+        table.add("user:1", 100, 1, 1);
+      _exit(0);
+    }
+  }
+
+  for (int c = 0; c < children; ++c) {
+    int status = 0;
+    REQUIRE(wait(&status) > 0);
+    REQUIRE(WIFEXITED(status));
+  }
+
+  CHECK(table.bytes_served("user:1", 100, 1) == children * updates);
+  CHECK(table.take_pending("user:1") == children * updates);
+}
+
+TEST_CASE("Shared memory rate limiter without memcached", "[ratelimiter]") {
+
+  rate_limit_table table(1024);
+  boost::program_options::variables_map options;
+  shm_rate_limiter limiter(table, options);
+
+  const auto max_bytes = global_settings::get_ratelimiter_maxdebt(false);
+  const auto bytes_per_sec = global_settings::get_ratelimiter_ratelimit(false);
+
+  auto [exceeded, retry] = limiter.check("addr:1.2.3.4", false);
+  CHECK_FALSE(exceeded);
+
+  limiter.update("addr:1.2.3.4", max_bytes / 2, false);
+  std::tie(exceeded, retry) = limiter.check("addr:1.2.3.4", false);
+  CHECK_FALSE(exceeded);
+
+  limiter.update("addr:1.2.3.4", max_bytes / 2 + 10 * bytes_per_sec, false);
+  std::tie(exceeded, retry) = limiter.check("addr:1.2.3.4", false);
+  CHECK(exceeded);
+  CHECK(retry >= 9);
+  CHECK(retry <= 11);
+
+  // moderators have a higher limit
+  std::tie(exceeded, retry) = limiter.check("addr:1.2.3.4", true);
+  CHECK_FALSE(exceeded);
+
+  // other clients are not affected
+  std::tie(exceeded, retry) = limiter.check("addr:5.6.7.8", false);
+  CHECK_FALSE(exceeded);
+
+  // without memcached, all bytes stay local
+  limiter.reconcile();
+  CHECK(table.take_pending("addr:1.2.3.4") == max_bytes + 10 * bytes_per_sec);
+}
@@ -63,13 +63,12 @@ std::string test_request::get_payload() {
 
   std::string result;
 
-  std::string content(m_payload);
-  result_length += content.length();
+  result_length += m_payload.length();
 
   // Decompression according to Content-Encoding header (null op, if header is not set)
   try {
-    std::string content_decompressed = content_encoding_handler->decompress(content);
-    result += content_decompressed;
+    content_encoding_handler->decompress(m_payload, result,
+                                       std::size_t{global_settings::get_payload_max_size()} + 1);
   } catch (std::bad_alloc&) {
       throw http::server_error("Decompression failed due to memory issue");
   } catch (std::runtime_error&) {
@@ -0,0 +1,94 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/http.hpp"
+#include "cgimap/request_memory.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Allocations without a current request are ignored", "[request_memory]") {
+  CHECK(request_memory::current() == nullptr);
+
+  request_memory memory;
+  request_memory::allocated(1000);
+  CHECK(memory.peak() == 0);
+  CHECK(memory.summary().empty());
+  CHECK_NOTHROW(request_memory::check());
+}
+
+TEST_CASE("Peak memory is tracked per request", "[request_memory]") {
+  request_memory memory;
+  {
+    request_memory::scope scope(memory);
+    CHECK(request_memory::current() == &memory);
+
+    request_memory::allocated(3 * 1024 * 1024);
+    request_memory::released(2 * 1024 * 1024);
+    request_memory::allocated(512 * 1024);
+  }
+  CHECK(request_memory::current() == nullptr);
+
+  // not accounted, the scope has ended
+  request_memory::allocated(1024 * 1024 * 1024);
+
+  CHECK(memory.in_use() == 1536 * 1024);
+  CHECK(memory.peak() == 3 * 1024 * 1024);
+  CHECK(memory.summary() == "peak_memory=3.0MB");
+}
+
+TEST_CASE("Memory allocated before the request may be released", "[request_memory]") {
+  request_memory memory;
+  request_memory::scope scope(memory);
+
+  request_memory::released(4096);
+  CHECK(memory.in_use() == 0);
+  request_memory::allocated(1024);
+  CHECK(memory.peak() == 0);
+  request_memory::allocated(4096);
+  CHECK(memory.peak() == 1024);
+}
+
+TEST_CASE("Exceeding the limit aborts the request once", "[request_memory]") {
+  request_memory memory;
+  memory.limit = 1024 * 1024;
+  request_memory::scope scope(memory);
+
+  request_memory::allocated(1024 * 1024);
+  CHECK_NOTHROW(request_memory::check());
+
+  request_memory::allocated(1);
+  CHECK_THROWS_AS(request_memory::check(), http::payload_too_large);
+
+  // the error response still needs to be written
+  CHECK_NOTHROW(request_memory::check());
+}
+
+TEST_CASE("Requests without a limit are never aborted", "[request_memory]") {
+  request_memory memory;
+  request_memory::scope scope(memory);
+
+  request_memory::allocated(std::size_t(64) * 1024 * 1024 * 1024);
+  CHECK_NOTHROW(request_memory::check());
+}
+
+#if defined(__GLIBC__)
+TEST_CASE("Allocations via operator new are accounted", "[request_memory]") {
+  request_memory memory;
+  {
+    request_memory::scope scope(memory);
+    std::vector<char> buffer(4 * 1024 * 1024);
+    auto element = std::make_unique<int>(42);
+  }
+  CHECK(memory.peak() >= 4 * 1024 * 1024);
+  CHECK(memory.in_use() == 0);
+}
+#endif
@@ -0,0 +1,132 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/request_timing.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::ContainsSubstring;
+using Catch::Matchers::Matches;
+using namespace std::chrono_literals;
+
+using phase = request_timing::phase;
+
+TEST_CASE("Spans without a current request are ignored", "[request_timing]") {
+  CHECK(request_timing::current() == nullptr);
+
+  request_timing timing;
+  {
+    auto span = request_timing::measure(phase::selection);
+    std::this_thread::sleep_for(2ms);
+  }
+  CHECK(timing.elapsed(phase::selection) == request_timing::clock::duration::zero());
+  CHECK(timing.summary().empty());
+}
+
+TEST_CASE("Scope sets the current request", "[request_timing]") {
+  request_timing outer;
+  request_timing inner;
+  {
+    request_timing::scope outer_scope(outer);
+    CHECK(request_timing::current() == &outer);
+    {
+      request_timing::scope inner_scope(inner);
+      CHECK(request_timing::current() == &inner);
+    }
+    CHECK(request_timing::current() == &outer);
+  }
+  CHECK(request_timing::current() == nullptr);
+}
+
+TEST_CASE("Time is attributed to the innermost span", "[request_timing]") {
+  request_timing timing;
+  request_timing::scope scope(timing);
+  {
+    auto serialize = request_timing::measure(phase::serialize);
+    std::this_thread::sleep_for(10ms);
+    {
+      auto compress = request_timing::measure(phase::compress);
+      std::this_thread::sleep_for(10ms);
+      {
+        auto write = request_timing::measure(phase::write);
+        std::this_thread::sleep_for(10ms);
+      }
+    }
+  }
+
+  const auto serialize = timing.elapsed(phase::serialize);
+  const auto compress = timing.elapsed(phase::compress);
+  const auto write = timing.elapsed(phase::write);
+
+  CHECK(serialize >= 10ms);
+  CHECK(compress >= 10ms);
+  CHECK(write >= 10ms);
+  // each phase only covers its own sleep, not the nested ones
+  CHECK(serialize < 20ms);
+  CHECK(compress < 20ms);
+}
+
+TEST_CASE("Statements are only reported separately while serializing", "[request_timing]") {
+  request_timing timing;
+  request_timing::scope scope(timing);
+  {
+    auto selection = request_timing::measure(phase::selection);
+    auto statement = request_timing::measure_statement();
+    std::this_thread::sleep_for(5ms);
+  }
+  CHECK(timing.elapsed(phase::selection) >= 5ms);
+  CHECK(timing.elapsed(phase::fetch) == request_timing::clock::duration::zero());
+
+  {
+    auto serialize = request_timing::measure(phase::serialize);
+    auto statement = request_timing::measure_statement();
+    std::this_thread::sleep_for(5ms);
+  }
+  CHECK(timing.elapsed(phase::fetch) >= 5ms);
+  CHECK(timing.elapsed(phase::serialize) < 5ms);
+}
+
+TEST_CASE("Deeply nested spans", "[request_timing]") {
+  request_timing timing;
+  request_timing::scope scope(timing);
+  {
+    auto s1 = request_timing::measure(phase::serialize);
+    auto s2 = request_timing::measure(phase::compress);
+    auto s3 = request_timing::measure(phase::write);
+    auto s4 = request_timing::measure(phase::compress);
+    auto s5 = request_timing::measure(phase::write);
+    auto s6 = request_timing::measure(phase::compress);
+    auto s7 = request_timing::measure(phase::write);
+    auto s8 = request_timing::measure(phase::compress);
+    auto s9 = request_timing::measure(phase::auth);
+    std::this_thread::sleep_for(5ms);
+  }
+  CHECK(timing.elapsed(phase::compress) >= 5ms);
+  CHECK(timing.elapsed(phase::auth) == request_timing::clock::duration::zero());
+}
+
+TEST_CASE("Summary and Server-Timing header", "[request_timing]") {
+  request_timing timing;
+  request_timing::scope scope(timing);
+
+  CHECK(timing.summary().empty());
+  CHECK_THAT(timing.server_timing(), Matches("total;dur=[0-9]+\\.[0-9]{3}"));
+
+  { auto auth = request_timing::measure(phase::auth); }
+  { auto selection = request_timing::measure(phase::selection); }
+
+  CHECK_THAT(timing.summary(), Matches("auth=[0-9]+\\.[0-9]ms selection=[0-9]+\\.[0-9]ms"));
+  CHECK_THAT(timing.server_timing(),
+             Matches("auth;dur=[0-9]+\\.[0-9]{3}, selection;dur=[0-9]+\\.[0-9]{3}, total;dur=[0-9]+\\.[0-9]{3}"));
+  CHECK_THAT(timing.server_timing(), !ContainsSubstring("ratelimit"));
+}
@@ -0,0 +1,140 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/shm_cache.hpp"
+
+#include <chrono>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Store and retrieve values", "[shm_cache]") {
+
+  shm_cache cache(8 * shm_cache::slab_size);
+
+  CHECK(cache.get("a") == std::nullopt);
+  cache.put("a", "1", 60s);
+  cache.put("b", std::string(1000, 'b'), 60s);
+  CHECK(cache.get("a") == "1");
+  CHECK(cache.get("b") == std::string(1000, 'b'));
+
+  // replacing a value, possibly in a different size class
+  cache.put("a", std::string(5000, 'a'), 60s);
+  CHECK(cache.get("a") == std::string(5000, 'a'));
+  cache.put("a", "2", 60s);
+  CHECK(cache.get("a") == "2");
+
+  // expired values are gone
+  cache.put("c", "3", 0s);
+  CHECK(cache.get("c") == std::nullopt);
+
+  // as are erased ones
+  cache.put("d", "4", 60s);
+  cache.erase("d");
+  cache.erase("e");
+  CHECK(cache.get("d") == std::nullopt);
+
+  const auto stats = cache.stats();
+  CHECK(stats.hits == 4);
+  CHECK(stats.misses == 3);
+  CHECK(stats.stores == 6);
+  CHECK(stats.slabs == 8);
+  // one slab for each size class used
+  CHECK(stats.slabs_used == 3);
+}
+
+TEST_CASE("Reject values larger than a slab", "[shm_cache]") {
+
+  shm_cache cache(4 * shm_cache::slab_size);
+
+  const std::string largest(shm_cache::max_entry_size() - 1, 'x');
+  cache.put("k", largest, 60s);
+  CHECK(cache.get("k") == largest);
+
+  cache.put("l", largest + "xx", 60s);
+  CHECK(cache.get("l") == std::nullopt);
+  CHECK(cache.stats().rejected == 1);
+}
+
+TEST_CASE("Evict entries once all slabs are used", "[shm_cache]") {
+
+  shm_cache cache(2 * shm_cache::slab_size);
+
+  cache.put("hot", "value", 60s);
+  for (int i = 0; i < 20000; ++i) {
+    cache.put("key" + std::to_string(i), "value", 60s);
+    // read entries get a second chance
+    CHECK(cache.get("hot") == "value");
+  }
+
+  auto stats = cache.stats();
+  CHECK(stats.slabs_used == 2);
+  CHECK(stats.evictions > 0);
+  CHECK(cache.get("key19999") == "value");
+  CHECK(cache.get("key0") == std::nullopt);
+
+  // no slab is left for larger values
+  cache.put("large", std::string(10000, 'x'), 60s);
+  CHECK(cache.get("large") == std::nullopt);
+  CHECK(cache.stats().rejected == 1);
+}
+
+TEST_CASE("Expired entries are replaced first", "[shm_cache]") {
+
+  shm_cache cache(shm_cache::slab_size);
+
+  for (int i = 0; i < 4096; ++i)
+    cache.put("old" + std::to_string(i), "value", 0s);
+  for (int i = 0; i < 100; ++i)
+    cache.put("new" + std::to_string(i), "value", 60s);
+
+  const auto stats = cache.stats();
+  CHECK(stats.expirations == 100);
+  CHECK(stats.evictions == 0);
+}
+
+TEST_CASE("Cache is shared with child processes", "[shm_cache]") {
+
+  shm_cache cache(4 * shm_cache::slab_size);
+
+  constexpr int children = 4;
+  constexpr int entries = 1000;
+
+  for (int c = 0; c < children; ++c) {
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+      for (int i = 0; i < entries; ++i)
+        cache.put(std::to_string(c) + "/" + std::to_string(i), std::to_string(i), 60s);
+      _exit(0);
+    }
+  }
+
+  for (int c = 0; c < children; ++c) {
+    int status = 0;
+    REQUIRE(wait(&status) > 0);
+    REQUIRE(WIFEXITED(status));
+  }
+
+  // entries outlive the processes which stored them
+  int found = 0;
+  for (int c = 0; c < children; ++c) {
+    for (int i = 0; i < entries; ++i) {
+      if (cache.get(std::to_string(c) + "/" + std::to_string(i)) == std::to_string(i))
+        ++found;
+    }
+  }
+  CHECK(found == children * entries);
+  CHECK(cache.stats().stores == children * entries);
+}
@@ -0,0 +1,97 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * This file is part of openstreetmap-cgimap (https://github.com/zerebubuth/openstreetmap-cgimap/).
+ *
+ * Copyright (C) 2009-2025 by the openstreetmap-cgimap developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "cgimap/backend/apidb/slow_query_log.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+class temp_log_file {
+public:
+  temp_log_file() {
+    std::string tmpl = (std::filesystem::temp_directory_path() / "cgimap_test_slow_query_XXXXXX").string();
+    const int fd = mkstemp(tmpl.data());
+    REQUIRE(fd >= 0);
+    close(fd);
+    m_path = tmpl;
+  }
+
+  ~temp_log_file() {
+    slow_query_log::initialise();
+    std::filesystem::remove(m_path);
+  }
+
+  [[nodiscard]] const std::string &path() const { return m_path; }
+
+  [[nodiscard]] std::string contents() const {
+    std::ifstream in(m_path);
+    return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+  }
+
+private:
+  std::string m_path;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Parameters are described without their values", "[slow_query_log]") {
+  const std::vector<int64_t> ids{ 1, 2, 3 };
+  const std::string name = "secret";
+
+  CHECK(slow_query_log::describe_parameters() == "");
+  CHECK(slow_query_log::describe_parameters(ids) == "$1 array[3]");
+  CHECK(slow_query_log::describe_parameters(ids, int64_t{ 42 }, name) ==
+        "$1 array[3], $2 scalar, $3 text");
+}
+
+TEST_CASE("Statements below the threshold are not slow", "[slow_query_log]") {
+  temp_log_file file;
+  slow_query_log::initialise(file.path(), 100ms, 0.0);
+
+  CHECK(slow_query_log::enabled());
+  CHECK_FALSE(slow_query_log::is_slow(99ms));
+  CHECK(slow_query_log::is_slow(100ms));
+  CHECK_FALSE(slow_query_log::sample_explain());
+}
+
+TEST_CASE("Slow statements are logged with their plan", "[slow_query_log]") {
+  temp_log_file file;
+  slow_query_log::initialise(file.path(), 100ms, 1.0);
+
+  slow_query_log::write("visible_node_in_bbox", 1234ms, 5000, "$1 array[12], $2 scalar",
+                        "Limit  (cost=0.57..1.23 rows=1)\n  ->  Index Scan using current_nodes_tile_idx\n");
+
+  const auto contents = file.contents();
+  CHECK(contents.find("] Slow statement visible_node_in_bbox took 1234 ms, returning 5000 rows, "
+                      "parameters: $1 array[12], $2 scalar\n"
+                      "    Limit  (cost=0.57..1.23 rows=1)\n"
+                      "      ->  Index Scan using current_nodes_tile_idx\n") != std::string::npos);
+}
+
+TEST_CASE("The slow query log is disabled without a file", "[slow_query_log]") {
+  slow_query_log::initialise();
+  CHECK_FALSE(slow_query_log::enabled());
+  CHECK_FALSE(slow_query_log::is_slow(1h));
+
+  // must not throw
+  slow_query_log::write("statement", 1h, 0, "", "");
+}